@@ -0,0 +1,273 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Maps timestamps of one clock, like a device's, into another.
+ * @ingroup aux_math
+ */
+
+#include "os/os_time.h"
+#include "os/os_seqlock.h"
+
+#include "util/u_misc.h"
+#include "util/u_var.h"
+
+#include "math/m_mathinclude.h"
+#include "math/m_clock_tracker.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/*
+ *
+ * Defines.
+ *
+ */
+
+//! Accepted samples before outliers are rejected and convergence is judged.
+#define WARMUP_SAMPLES 16
+
+//! Weight of new values in the smoothed statistics.
+#define STATS_ALPHA 0.02
+
+//! Sanity limit for the skew, cheap crystals are within a few hundred ppm.
+#define MAX_SLOPE_NS_PER_S (1000.0 * 1000.0)
+
+//! Spins before the reader starts sleeping, to let a preempted writer finish.
+#define MAX_READ_SPINS 1000
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+static void
+publish(struct m_clock_tracker *ct, const struct m_clock_tracker_mapping *m)
+{
+	os_seqlock_write_begin(&ct->seq);
+	ct->mapping = *m;
+	os_seqlock_write_end(&ct->seq);
+}
+
+//! Offset predicted by the fit @p dx_s seconds after the origin, relative to the origin offset.
+static inline double
+predict(const struct m_clock_tracker *ct, double dx_s)
+{
+	return ct->fit.intercept + ct->fit.slope * dx_s;
+}
+
+//! Throws away the fit and starts over from this sample.
+static void
+restart(struct m_clock_tracker *ct, timepoint_ns a, timepoint_ns b)
+{
+	U_ZERO(&ct->fit);
+	ct->fit.origin_a = a;
+	ct->fit.origin_offset = b - a;
+	ct->fit.s0 = 1.0;
+	ct->fit.accepted = 1;
+
+	ct->stats.converged = false;
+	ct->stats.jitter_ns = 0.0;
+	ct->stats.correction_ns = 0.0;
+	ct->stats.skew_ppm = 0.0;
+}
+
+/*!
+ * Decays the sums by the time passed, moves their origin to the new sample and
+ * adds it, which keeps the sums small however long the tracker runs.
+ */
+static void
+add_sample(struct m_clock_tracker *ct, double dx_s, double dy_ns, timepoint_ns a, time_duration_ns offset)
+{
+	double w = exp(-fabs(dx_s) / ct->time_constant_s);
+	double s0 = ct->fit.s0 * w;
+	double sx = ct->fit.sx * w;
+	double sxx = ct->fit.sxx * w;
+	double sy = ct->fit.sy * w;
+	double sxy = ct->fit.sxy * w;
+
+	// Shift x by dx_s and y by dy_ns.
+	sxx = sxx - 2.0 * dx_s * sx + dx_s * dx_s * s0;
+	sxy = sxy - dx_s * sy - dy_ns * sx + dx_s * dy_ns * s0;
+	sx = sx - dx_s * s0;
+	sy = sy - dy_ns * s0;
+
+	// The new sample sits at the origin.
+	s0 += 1.0;
+
+	ct->fit.s0 = s0;
+	ct->fit.sx = sx;
+	ct->fit.sxx = sxx;
+	ct->fit.sy = sy;
+	ct->fit.sxy = sxy;
+	ct->fit.origin_a = a;
+	ct->fit.origin_offset = offset;
+
+	// Keep the old slope until the samples span enough time to give a new one.
+	double denom = s0 * sxx - sx * sx;
+	if (denom > 1e-9 * s0 * s0) {
+		double slope = (s0 * sxy - sx * sy) / denom;
+		if (slope > MAX_SLOPE_NS_PER_S) {
+			slope = MAX_SLOPE_NS_PER_S;
+		} else if (slope < -MAX_SLOPE_NS_PER_S) {
+			slope = -MAX_SLOPE_NS_PER_S;
+		}
+		ct->fit.slope = slope;
+	}
+
+	ct->fit.intercept = (sy - ct->fit.slope * sx) / s0;
+	ct->fit.accepted++;
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+void
+m_clock_tracker_init(struct m_clock_tracker *ct, double time_constant_s)
+{
+	U_ZERO(ct);
+	ct->time_constant_s = time_constant_s;
+	ct->outlier_factor = 6.0;
+	ct->outlier_floor_ns = 250.0 * 1000.0;
+	ct->max_outlier_run = 32;
+	ct->converged_ns = 50.0 * 1000.0;
+}
+
+timepoint_ns
+m_clock_tracker_update(struct m_clock_tracker *ct, timepoint_ns a, timepoint_ns b)
+{
+	struct m_clock_tracker_mapping m = ct->mapping;
+	ct->stats.sample_count++;
+
+	if (!m.valid) {
+		restart(ct, a, b);
+
+		m.a_ref = a;
+		m.b_ref = b;
+		m.skew = 0.0;
+		m.valid = true;
+		publish(ct, &m);
+
+		return b;
+	}
+
+	double dx_s = (double)(a - ct->fit.origin_a) / (double)U_TIME_1S_IN_NS;
+	double dy_ns = (double)(b - a - ct->fit.origin_offset);
+	double residual = dy_ns - predict(ct, dx_s);
+
+	if (ct->fit.accepted >= WARMUP_SAMPLES) {
+		double threshold = ct->outlier_factor * ct->stats.jitter_ns;
+		if (threshold < ct->outlier_floor_ns) {
+			threshold = ct->outlier_floor_ns;
+		}
+
+		if (fabs(residual) > threshold) {
+			ct->stats.outlier_count++;
+
+			if (++ct->fit.outlier_run < ct->max_outlier_run) {
+				// Use the mapping as it is.
+				return m_clock_tracker_mapping_a2b(&m, a);
+			}
+
+			// The clocks jumped, start over.
+			ct->stats.reset_count++;
+			restart(ct, a, b);
+
+			m.a_ref = a;
+			m.b_ref = b;
+			m.skew = 0.0;
+			publish(ct, &m);
+
+			return b;
+		}
+	}
+	ct->fit.outlier_run = 0;
+
+	// Where the old mapping put this sample, used to judge convergence.
+	timepoint_ns old_b = m_clock_tracker_mapping_a2b(&m, a);
+
+	add_sample(ct, dx_s, dy_ns, a, b - a);
+
+	m.a_ref = a;
+	m.b_ref = a + ct->fit.origin_offset + (time_duration_ns)llround(ct->fit.intercept);
+	m.skew = ct->fit.slope / (double)U_TIME_1S_IN_NS;
+	publish(ct, &m);
+
+	// Diagnostics.
+	double correction = fabs((double)(m.b_ref - old_b));
+	if (ct->fit.accepted <= 2) {
+		ct->stats.jitter_ns = fabs(residual);
+		ct->stats.correction_ns = correction;
+	} else {
+		ct->stats.jitter_ns += (fabs(residual) - ct->stats.jitter_ns) * STATS_ALPHA;
+		ct->stats.correction_ns += (correction - ct->stats.correction_ns) * STATS_ALPHA;
+	}
+	ct->stats.skew_ppm = m.skew * 1e6;
+	ct->stats.converged = ct->fit.accepted >= WARMUP_SAMPLES && ct->stats.correction_ns < ct->converged_ns;
+
+	return m.b_ref;
+}
+
+void
+m_clock_tracker_get_mapping(struct m_clock_tracker *ct, struct m_clock_tracker_mapping *out_mapping)
+{
+	for (uint32_t tries = 0;; tries++) {
+		os_seqlock_read_backoff(tries, MAX_READ_SPINS);
+
+		int32_t begin = 0;
+		if (!os_seqlock_read_begin(&ct->seq, &begin)) {
+			continue;
+		}
+
+		struct m_clock_tracker_mapping m;
+		memcpy(&m, (const void *)&ct->mapping, sizeof(m));
+
+		if (os_seqlock_read_end(&ct->seq, begin)) {
+			*out_mapping = m;
+			return;
+		}
+	}
+}
+
+timepoint_ns
+m_clock_tracker_a2b(struct m_clock_tracker *ct, timepoint_ns a)
+{
+	struct m_clock_tracker_mapping m;
+	m_clock_tracker_get_mapping(ct, &m);
+	return m_clock_tracker_mapping_a2b(&m, a);
+}
+
+timepoint_ns
+m_clock_tracker_b2a(struct m_clock_tracker *ct, timepoint_ns b)
+{
+	struct m_clock_tracker_mapping m;
+	m_clock_tracker_get_mapping(ct, &m);
+	return m_clock_tracker_mapping_b2a(&m, b);
+}
+
+void
+m_clock_tracker_add_vars(struct m_clock_tracker *ct, void *root, const char *prefix)
+{
+	char tmp[512];
+	snprintf(tmp, sizeof(tmp), "%sconverged", prefix);
+	u_var_add_bool(root, &ct->stats.converged, tmp);
+	snprintf(tmp, sizeof(tmp), "%sjitter_ns", prefix);
+	u_var_add_ro_f64(root, &ct->stats.jitter_ns, tmp);
+	snprintf(tmp, sizeof(tmp), "%scorrection_ns", prefix);
+	u_var_add_ro_f64(root, &ct->stats.correction_ns, tmp);
+	snprintf(tmp, sizeof(tmp), "%sskew_ppm", prefix);
+	u_var_add_ro_f64(root, &ct->stats.skew_ppm, tmp);
+	snprintf(tmp, sizeof(tmp), "%ssample_count", prefix);
+	u_var_add_ro_u64(root, &ct->stats.sample_count, tmp);
+	snprintf(tmp, sizeof(tmp), "%soutlier_count", prefix);
+	u_var_add_ro_u64(root, &ct->stats.outlier_count, tmp);
+	snprintf(tmp, sizeof(tmp), "%sreset_count", prefix);
+	u_var_add_ro_u64(root, &ct->stats.reset_count, tmp);
+}
@@ -0,0 +1,216 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Maps timestamps of one clock, like a device's, into another.
+ * @ingroup aux_math
+ */
+
+#pragma once
+
+#include "xrt/xrt_compiler.h"
+#include "util/u_time.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*!
+ * A linear mapping from clock a to clock b, `b = b_ref + (a - a_ref) * (1 + skew)`.
+ *
+ * @ingroup aux_math
+ */
+struct m_clock_tracker_mapping
+{
+	timepoint_ns a_ref;
+	timepoint_ns b_ref;
+
+	//! Rate difference of the clocks, 1e-6 is one ppm.
+	double skew;
+
+	//! False until the first sample.
+	bool valid;
+};
+
+/*!
+ * Diagnostics, only written by the updating thread.
+ *
+ * @ingroup aux_math
+ */
+struct m_clock_tracker_stats
+{
+	uint64_t sample_count;
+	uint64_t outlier_count;
+
+	//! Number of times the model was thrown away, because of a clock jump.
+	uint64_t reset_count;
+
+	//! Smoothed absolute residual of accepted samples.
+	double jitter_ns;
+
+	//! Smoothed size of the corrections the last samples made to the mapping.
+	double correction_ns;
+
+	double skew_ppm;
+
+	//! Enough samples and the corrections have settled.
+	bool converged;
+};
+
+/*!
+ * Tracks the relation between two clocks from pairs of timestamps that were
+ * taken as close as possible, typically a device timestamp and the time the
+ * packet arrived on the host.
+ *
+ * The offset is fitted with an exponentially forgetting linear regression, so
+ * drift between the clocks is followed without lag, and the transport jitter
+ * is averaged over many samples. Samples far from the fit are rejected, a long
+ * run of them is taken as a clock jump and the fit is restarted.
+ *
+ * Only one thread may call @ref m_clock_tracker_update at a time, any number
+ * of threads may convert timestamps concurrently without locking.
+ *
+ * @ingroup aux_math
+ */
+struct m_clock_tracker
+{
+	//! Time constant of the forgetting, in seconds.
+	double time_constant_s;
+
+	//! Samples with a residual larger than this many times the jitter are outliers.
+	double outlier_factor;
+
+	//! Residuals below this are never outliers.
+	double outlier_floor_ns;
+
+	//! Outliers in a row that are taken as a clock jump.
+	uint32_t max_outlier_run;
+
+	//! Corrections below this count as converged.
+	double converged_ns;
+
+	//! Regression state, relative to the last accepted sample.
+	struct
+	{
+		timepoint_ns origin_a;
+		time_duration_ns origin_offset;
+
+		double s0, sx, sxx, sy, sxy;
+
+		//! Last fit, offset at origin in ns and slope in ns per s.
+		double intercept;
+		double slope;
+
+		uint32_t accepted;
+		uint32_t outlier_run;
+	} fit;
+
+	struct m_clock_tracker_stats stats;
+
+	//! Odd while the mapping is being written.
+	xrt_atomic_s32_t seq;
+	struct m_clock_tracker_mapping mapping;
+};
+
+/*!
+ * Sets up the tracker, @p time_constant_s is how long samples influence the
+ * fit, longer averages more jitter away but follows drift changes slower.
+ *
+ * @public @memberof m_clock_tracker
+ */
+void
+m_clock_tracker_init(struct m_clock_tracker *ct, double time_constant_s);
+
+/*!
+ * Adds a pair of timestamps @p a and @p b taken at about the same time, and
+ * returns @p a in clock b using the updated mapping.
+ *
+ * @public @memberof m_clock_tracker
+ */
+timepoint_ns
+m_clock_tracker_update(struct m_clock_tracker *ct, timepoint_ns a, timepoint_ns b);
+
+/*!
+ * Copies out the current mapping without locking, safe to call from any thread.
+ *
+ * @public @memberof m_clock_tracker
+ */
+void
+m_clock_tracker_get_mapping(struct m_clock_tracker *ct, struct m_clock_tracker_mapping *out_mapping);
+
+/*!
+ * Converts @p a into clock b, returns @p a unchanged if there is no mapping
+ * yet, safe to call from any thread.
+ *
+ * @public @memberof m_clock_tracker
+ */
+timepoint_ns
+m_clock_tracker_a2b(struct m_clock_tracker *ct, timepoint_ns a);
+
+/*!
+ * Converts @p b into clock a, returns @p b unchanged if there is no mapping
+ * yet, safe to call from any thread.
+ *
+ * @public @memberof m_clock_tracker
+ */
+timepoint_ns
+m_clock_tracker_b2a(struct m_clock_tracker *ct, timepoint_ns b);
+
+/*!
+ * Adds the diagnostics to the given u_var root, names prefixed with @p prefix.
+ *
+ * @public @memberof m_clock_tracker
+ */
+void
+m_clock_tracker_add_vars(struct m_clock_tracker *ct, void *root, const char *prefix);
+
+/*!
+ * Has the mapping settled, only to be called from the updating thread.
+ *
+ * @public @memberof m_clock_tracker
+ */
+static inline bool
+m_clock_tracker_is_converged(const struct m_clock_tracker *ct)
+{
+	return ct->stats.converged;
+}
+
+/*!
+ * Converts @p a into clock b with a mapping that was copied out earlier, lets
+ * several timestamps be converted consistently.
+ *
+ * @ingroup aux_math
+ */
+static inline timepoint_ns
+m_clock_tracker_mapping_a2b(const struct m_clock_tracker_mapping *m, timepoint_ns a)
+{
+	if (!m->valid) {
+		return a;
+	}
+
+	time_duration_ns da = a - m->a_ref;
+	return m->b_ref + da + (time_duration_ns)((double)da * m->skew);
+}
+
+/*!
+ * Converts @p b into clock a with a mapping that was copied out earlier.
+ *
+ * @ingroup aux_math
+ */
+static inline timepoint_ns
+m_clock_tracker_mapping_b2a(const struct m_clock_tracker_mapping *m, timepoint_ns b)
+{
+	if (!m->valid) {
+		return b;
+	}
+
+	time_duration_ns db = b - m->b_ref;
+	return m->a_ref + db - (time_duration_ns)((double)db * m->skew / (1.0 + m->skew));
+}
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -10,9 +10,93 @@
 #include "util/u_misc.h"
 #include "math/m_filter_fifo.h"
 
+#include <math.h>
 #include <assert.h>
 
 
+/*
+ *
+ * Shared ring helpers.
+ *
+ * Samples are written backwards in the ring, so going forward from latest
+ * walks from the newest to the oldest sample. Every sample also stores the
+ * running sum of all samples pushed up to and including it, the sum of any
+ * window is then the difference of two of these. The sums are recomputed
+ * every time the fifo has been filled so they don't grow without bound.
+ * Samples that are not finite are dropped on push, one would make every sum
+ * after it NaN or Inf.
+ *
+ */
+
+//! Storage position of the @p k-th newest sample.
+static inline size_t
+ring_pos(size_t num, size_t latest, size_t k)
+{
+	size_t pos = latest + k;
+	return pos >= num ? pos - num : pos;
+}
+
+//! Storage position for the next sample to be pushed.
+static inline size_t
+ring_next(size_t num, size_t latest)
+{
+	return latest == 0 ? num - 1 : latest - 1;
+}
+
+/*!
+ * Returns how many samples, counting from the newest, have a timestamp after
+ * @p timestamp_ns. Timestamps only go back in time so a binary search works.
+ */
+static size_t
+ring_count_after(const uint64_t *timestamps_ns, size_t num, size_t latest, uint64_t timestamp_ns)
+{
+	size_t lo = 0;
+	size_t hi = num;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (timestamps_ns[ring_pos(num, latest, mid)] > timestamp_ns) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+/*!
+ * Finds the samples between the two timepoints, they are the samples from
+ * @p out_first up to but not including @p out_end counting from the newest.
+ */
+static void
+ring_find_window(const uint64_t *timestamps_ns,
+                 size_t num,
+                 size_t latest,
+                 uint64_t start_ns,
+                 uint64_t stop_ns,
+                 size_t *out_first,
+                 size_t *out_end)
+{
+	// Error, skip averaging.
+	if (start_ns > stop_ns) {
+		*out_first = 0;
+		*out_end = 0;
+		return;
+	}
+
+	// First sample not after stop.
+	*out_first = ring_count_after(timestamps_ns, num, latest, stop_ns);
+
+	// First sample before start, nothing is before zero.
+	if (start_ns == 0) {
+		*out_end = num;
+	} else {
+		*out_end = ring_count_after(timestamps_ns, num, latest, start_ns - 1);
+	}
+}
+
+
 /*
  *
  * Filter fifo vec3_f32.
@@ -25,6 +109,15 @@ struct m_ff_vec3_f32
 	size_t latest;
 	struct xrt_vec3 *samples;
 	uint64_t *timestamps_ns;
+
+	//! Running sum up to and including each sample.
+	struct xrt_vec3_f64 *sums;
+
+	//! Running sum of the sample that was pushed out of the fifo last.
+	struct xrt_vec3_f64 sum_evicted;
+
+	//! Samples pushed since the running sums were last recomputed.
+	size_t pushed_since_rebase;
 };
 
 
@@ -39,10 +132,33 @@ vec3_f32_init(struct m_ff_vec3_f32 *ff, size_t num)
 {
 	ff->samples = U_TYPED_ARRAY_CALLOC(struct xrt_vec3, num);
 	ff->timestamps_ns = U_TYPED_ARRAY_CALLOC(uint64_t, num);
+	ff->sums = U_TYPED_ARRAY_CALLOC(struct xrt_vec3_f64, num);
 	ff->num = num;
 	ff->latest = 0;
 }
 
+static void
+vec3_f32_rebase(struct m_ff_vec3_f32 *ff)
+{
+	struct xrt_vec3_f64 sum = {0, 0, 0};
+	for (size_t k = ff->num; k-- > 0;) {
+		size_t pos = ring_pos(ff->num, ff->latest, k);
+		sum.x += ff->samples[pos].x;
+		sum.y += ff->samples[pos].y;
+		sum.z += ff->samples[pos].z;
+		ff->sums[pos] = sum;
+	}
+
+	U_ZERO(&ff->sum_evicted);
+	ff->pushed_since_rebase = 0;
+}
+
+static struct xrt_vec3_f64
+vec3_f32_sum_at(struct m_ff_vec3_f32 *ff, size_t k)
+{
+	return k >= ff->num ? ff->sum_evicted : ff->sums[ring_pos(ff->num, ff->latest, k)];
+}
+
 static void
 vec3_f32_destroy(struct m_ff_vec3_f32 *ff)
 {
@@ -56,6 +172,11 @@ vec3_f32_destroy(struct m_ff_vec3_f32 *ff)
 		ff->timestamps_ns = NULL;
 	}
 
+	if (ff->sums != NULL) {
+		free(ff->sums);
+		ff->sums = NULL;
+	}
+
 	ff->num = 0;
 	ff->latest = 0;
 }
@@ -99,12 +220,27 @@ m_ff_vec3_f32_push(struct m_ff_vec3_f32 *ff, const struct xrt_vec3 *sample, uint
 {
 	assert(ff->timestamps_ns[ff->latest] <= timestamp_ns);
 
+	if (!isfinite(sample->x) || !isfinite(sample->y) || !isfinite(sample->z)) {
+		return;
+	}
+
+	struct xrt_vec3_f64 sum = ff->sums[ff->latest];
+
 	// We write samples backwards in the queue.
-	size_t i = ff->latest == 0 ? ff->num - 1 : --ff->latest;
+	size_t i = ring_next(ff->num, ff->latest);
 	ff->latest = i;
 
+	ff->sum_evicted = ff->sums[i];
+	ff->sums[i].x = sum.x + sample->x;
+	ff->sums[i].y = sum.y + sample->y;
+	ff->sums[i].z = sum.z + sample->z;
+
 	ff->samples[i] = *sample;
 	ff->timestamps_ns[i] = timestamp_ns;
+
+	if (++ff->pushed_since_rebase >= ff->num) {
+		vec3_f32_rebase(ff);
+	}
 }
 
 bool
@@ -114,7 +250,7 @@ m_ff_vec3_f32_get(struct m_ff_vec3_f32 *ff, size_t num, struct xrt_vec3 *out_sam
 		return false;
 	}
 
-	size_t pos = (ff->latest + num) % ff->num;
+	size_t pos = ring_pos(ff->num, ff->latest, num);
 	*out_sample = ff->samples[pos];
 	*out_timestamp_ns = ff->timestamps_ns[pos];
 
@@ -124,50 +260,25 @@ m_ff_vec3_f32_get(struct m_ff_vec3_f32 *ff, size_t num, struct xrt_vec3 *out_sam
 size_t
 m_ff_vec3_f32_filter(struct m_ff_vec3_f32 *ff, uint64_t start_ns, uint64_t stop_ns, struct xrt_vec3 *out_average)
 {
-	size_t num_sampled = 0;
-	size_t count = 0;
-	// Use double precision internally.
-	double x = 0;
-	double y = 0;
-	double z = 0;
-
-	// Error, skip averaging.
-	if (start_ns > stop_ns) {
-		count = ff->num;
-	}
-
-	while (count < ff->num) {
-		size_t pos = (ff->latest + count) % ff->num;
+	size_t first = 0;
+	size_t end = 0;
+	ring_find_window(ff->timestamps_ns, ff->num, ff->latest, start_ns, stop_ns, &first, &end);
 
-		// We have not yet reached where to start.
-		if (ff->timestamps_ns[pos] > stop_ns) {
-			count++;
-			continue;
-		}
-
-		// If the sample is before the start we have reach the end.
-		if (ff->timestamps_ns[pos] < start_ns) {
-			count++;
-			break;
-		}
-
-		x += ff->samples[pos].x;
-		y += ff->samples[pos].y;
-		z += ff->samples[pos].z;
-		num_sampled++;
-		count++;
-	}
+	size_t num_sampled = end > first ? end - first : 0;
 
 	// Avoid division by zero.
-	if (num_sampled > 0) {
-		x /= num_sampled;
-		y /= num_sampled;
-		z /= num_sampled;
+	if (num_sampled == 0) {
+		U_ZERO(out_average);
+		return 0;
 	}
 
-	out_average->x = (float)x;
-	out_average->y = (float)y;
-	out_average->z = (float)z;
+	// Use double precision internally.
+	struct xrt_vec3_f64 newer = vec3_f32_sum_at(ff, first);
+	struct xrt_vec3_f64 older = vec3_f32_sum_at(ff, end);
+
+	out_average->x = (float)((newer.x - older.x) / num_sampled);
+	out_average->y = (float)((newer.y - older.y) / num_sampled);
+	out_average->z = (float)((newer.z - older.z) / num_sampled);
 
 	return num_sampled;
 }
@@ -185,6 +296,15 @@ struct m_ff_f64
 	size_t latest;
 	double *samples;
 	uint64_t *timestamps_ns;
+
+	//! Running sum up to and including each sample.
+	double *sums;
+
+	//! Running sum of the sample that was pushed out of the fifo last.
+	double sum_evicted;
+
+	//! Samples pushed since the running sums were last recomputed.
+	size_t pushed_since_rebase;
 };
 
 
@@ -199,10 +319,31 @@ ff_f64_init(struct m_ff_f64 *ff, size_t num)
 {
 	ff->samples = U_TYPED_ARRAY_CALLOC(double, num);
 	ff->timestamps_ns = U_TYPED_ARRAY_CALLOC(uint64_t, num);
+	ff->sums = U_TYPED_ARRAY_CALLOC(double, num);
 	ff->num = num;
 	ff->latest = 0;
 }
 
+static void
+ff_f64_rebase(struct m_ff_f64 *ff)
+{
+	double sum = 0;
+	for (size_t k = ff->num; k-- > 0;) {
+		size_t pos = ring_pos(ff->num, ff->latest, k);
+		sum += ff->samples[pos];
+		ff->sums[pos] = sum;
+	}
+
+	ff->sum_evicted = 0;
+	ff->pushed_since_rebase = 0;
+}
+
+static double
+ff_f64_sum_at(struct m_ff_f64 *ff, size_t k)
+{
+	return k >= ff->num ? ff->sum_evicted : ff->sums[ring_pos(ff->num, ff->latest, k)];
+}
+
 static void
 ff_f64_destroy(struct m_ff_f64 *ff)
 {
@@ -216,6 +357,11 @@ ff_f64_destroy(struct m_ff_f64 *ff)
 		ff->timestamps_ns = NULL;
 	}
 
+	if (ff->sums != NULL) {
+		free(ff->sums);
+		ff->sums = NULL;
+	}
+
 	ff->num = 0;
 	ff->latest = 0;
 }
@@ -259,12 +405,25 @@ m_ff_f64_push(struct m_ff_f64 *ff, const double *sample, uint64_t timestamp_ns)
 {
 	assert(ff->timestamps_ns[ff->latest] <= timestamp_ns);
 
+	if (!isfinite(*sample)) {
+		return;
+	}
+
+	double sum = ff->sums[ff->latest];
+
 	// We write samples backwards in the queue.
-	size_t i = ff->latest == 0 ? ff->num - 1 : --ff->latest;
+	size_t i = ring_next(ff->num, ff->latest);
 	ff->latest = i;
 
+	ff->sum_evicted = ff->sums[i];
+	ff->sums[i] = sum + *sample;
+
 	ff->samples[i] = *sample;
 	ff->timestamps_ns[i] = timestamp_ns;
+
+	if (++ff->pushed_since_rebase >= ff->num) {
+		ff_f64_rebase(ff);
+	}
 }
 
 bool
@@ -274,7 +433,7 @@ m_ff_f64_get(struct m_ff_f64 *ff, size_t num, double *out_sample, uint64_t *out_
 		return false;
 	}
 
-	size_t pos = (ff->latest + num) % ff->num;
+	size_t pos = ring_pos(ff->num, ff->latest, num);
 	*out_sample = ff->samples[pos];
 	*out_timestamp_ns = ff->timestamps_ns[pos];
 
@@ -284,41 +443,231 @@ m_ff_f64_get(struct m_ff_f64 *ff, size_t num, double *out_sample, uint64_t *out_
 size_t
 m_ff_f64_filter(struct m_ff_f64 *ff, uint64_t start_ns, uint64_t stop_ns, double *out_average)
 {
-	size_t num_sampled = 0;
-	size_t count = 0;
-	double val = 0;
+	size_t first = 0;
+	size_t end = 0;
+	ring_find_window(ff->timestamps_ns, ff->num, ff->latest, start_ns, stop_ns, &first, &end);
 
-	// Error, skip averaging.
-	if (start_ns > stop_ns) {
-		count = ff->num;
+	size_t num_sampled = end > first ? end - first : 0;
+
+	// Avoid division by zero.
+	if (num_sampled == 0) {
+		*out_average = 0;
+		return 0;
 	}
 
-	while (count < ff->num) {
-		size_t pos = (ff->latest + count) % ff->num;
+	*out_average = (ff_f64_sum_at(ff, first) - ff_f64_sum_at(ff, end)) / num_sampled;
 
-		// We have not yet reached where to start.
-		if (ff->timestamps_ns[pos] > stop_ns) {
-			count++;
-			continue;
-		}
+	return num_sampled;
+}
 
-		// If the sample is before the start we have reach the end.
-		if (ff->timestamps_ns[pos] < start_ns) {
-			count++;
-			break;
-		}
 
-		val += ff->samples[pos];
-		num_sampled++;
-		count++;
+/*
+ *
+ * Filter fifo quat_f32.
+ *
+ */
+
+struct quat_f64
+{
+	double x, y, z, w;
+};
+
+struct m_ff_quat_f32
+{
+	size_t num;
+	size_t latest;
+	struct xrt_quat *samples;
+	uint64_t *timestamps_ns;
+
+	//! Running sum up to and including each sample.
+	struct quat_f64 *sums;
+
+	//! Running sum of the sample that was pushed out of the fifo last.
+	struct quat_f64 sum_evicted;
+
+	//! Samples pushed since the running sums were last recomputed.
+	size_t pushed_since_rebase;
+};
+
+
+/*
+ *
+ * Internal functions.
+ *
+ */
+
+static void
+quat_f32_init(struct m_ff_quat_f32 *ff, size_t num)
+{
+	ff->samples = U_TYPED_ARRAY_CALLOC(struct xrt_quat, num);
+	ff->timestamps_ns = U_TYPED_ARRAY_CALLOC(uint64_t, num);
+	ff->sums = U_TYPED_ARRAY_CALLOC(struct quat_f64, num);
+	ff->num = num;
+	ff->latest = 0;
+}
+
+static void
+quat_f32_destroy(struct m_ff_quat_f32 *ff)
+{
+	if (ff->samples != NULL) {
+		free(ff->samples);
+		ff->samples = NULL;
 	}
 
-	// Avoid division by zero.
-	if (num_sampled > 0) {
-		val /= num_sampled;
+	if (ff->timestamps_ns != NULL) {
+		free(ff->timestamps_ns);
+		ff->timestamps_ns = NULL;
 	}
 
-	*out_average = val;
+	if (ff->sums != NULL) {
+		free(ff->sums);
+		ff->sums = NULL;
+	}
 
-	return num_sampled;
+	ff->num = 0;
+	ff->latest = 0;
+}
+
+static void
+quat_f32_rebase(struct m_ff_quat_f32 *ff)
+{
+	struct quat_f64 sum = {0, 0, 0, 0};
+	for (size_t k = ff->num; k-- > 0;) {
+		size_t pos = ring_pos(ff->num, ff->latest, k);
+		sum.x += ff->samples[pos].x;
+		sum.y += ff->samples[pos].y;
+		sum.z += ff->samples[pos].z;
+		sum.w += ff->samples[pos].w;
+		ff->sums[pos] = sum;
+	}
+
+	U_ZERO(&ff->sum_evicted);
+	ff->pushed_since_rebase = 0;
+}
+
+static struct quat_f64
+quat_f32_sum_at(struct m_ff_quat_f32 *ff, size_t k)
+{
+	return k >= ff->num ? ff->sum_evicted : ff->sums[ring_pos(ff->num, ff->latest, k)];
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+void
+m_ff_quat_f32_alloc(struct m_ff_quat_f32 **ff_out, size_t num)
+{
+	struct m_ff_quat_f32 *ff = U_TYPED_CALLOC(struct m_ff_quat_f32);
+	quat_f32_init(ff, num);
+	*ff_out = ff;
+}
+
+void
+m_ff_quat_f32_free(struct m_ff_quat_f32 **ff_ptr)
+{
+	struct m_ff_quat_f32 *ff = *ff_ptr;
+	if (ff == NULL) {
+		return;
+	}
+
+	quat_f32_destroy(ff);
+	free(ff);
+	*ff_ptr = NULL;
+}
+
+size_t
+m_ff_quat_f32_get_num(struct m_ff_quat_f32 *ff)
+{
+	return ff->num;
+}
+
+void
+m_ff_quat_f32_push(struct m_ff_quat_f32 *ff, const struct xrt_quat *sample, uint64_t timestamp_ns)
+{
+	assert(ff->timestamps_ns[ff->latest] <= timestamp_ns);
+
+	if (!isfinite(sample->x) || !isfinite(sample->y) || !isfinite(sample->z) || !isfinite(sample->w)) {
+		return;
+	}
+
+	struct xrt_quat prev = ff->samples[ff->latest];
+	struct quat_f64 sum = ff->sums[ff->latest];
+
+	// q and -q are the same rotation, keep neighbours in the same hemisphere so they can be averaged.
+	struct xrt_quat q = *sample;
+	if (prev.x * q.x + prev.y * q.y + prev.z * q.z + prev.w * q.w < 0.0f) {
+		q.x = -q.x;
+		q.y = -q.y;
+		q.z = -q.z;
+		q.w = -q.w;
+	}
+
+	// We write samples backwards in the queue.
+	size_t i = ring_next(ff->num, ff->latest);
+	ff->latest = i;
+
+	ff->sum_evicted = ff->sums[i];
+	ff->sums[i].x = sum.x + q.x;
+	ff->sums[i].y = sum.y + q.y;
+	ff->sums[i].z = sum.z + q.z;
+	ff->sums[i].w = sum.w + q.w;
+
+	ff->samples[i] = q;
+	ff->timestamps_ns[i] = timestamp_ns;
+
+	if (++ff->pushed_since_rebase >= ff->num) {
+		quat_f32_rebase(ff);
+	}
+}
+
+bool
+m_ff_quat_f32_get(struct m_ff_quat_f32 *ff, size_t num, struct xrt_quat *out_sample, uint64_t *out_timestamp_ns)
+{
+	if (num >= ff->num) {
+		return false;
+	}
+
+	size_t pos = ring_pos(ff->num, ff->latest, num);
+	*out_sample = ff->samples[pos];
+	*out_timestamp_ns = ff->timestamps_ns[pos];
+
+	return true;
+}
+
+size_t
+m_ff_quat_f32_filter(struct m_ff_quat_f32 *ff, uint64_t start_ns, uint64_t stop_ns, struct xrt_quat *out_average)
+{
+	size_t first = 0;
+	size_t end = 0;
+	ring_find_window(ff->timestamps_ns, ff->num, ff->latest, start_ns, stop_ns, &first, &end);
+
+	struct quat_f64 newer = quat_f32_sum_at(ff, first);
+	struct quat_f64 older = quat_f32_sum_at(ff, end);
+
+	// The mean of the samples only needs normalizing, skip the division.
+	double x = newer.x - older.x;
+	double y = newer.y - older.y;
+	double z = newer.z - older.z;
+	double w = newer.w - older.w;
+	double len = sqrt(x * x + y * y + z * z + w * w);
+
+	// No samples, or they cancel each other out.
+	if (end <= first || len < 1e-9) {
+		out_average->x = 0.0f;
+		out_average->y = 0.0f;
+		out_average->z = 0.0f;
+		out_average->w = 1.0f;
+		return 0;
+	}
+
+	out_average->x = (float)(x / len);
+	out_average->y = (float)(y / len);
+	out_average->z = (float)(z / len);
+	out_average->w = (float)(w / len);
+
+	return end - first;
 }
@@ -18,6 +18,7 @@ extern "C" {
 
 struct m_ff_f64;
 struct m_ff_vec3_f32;
+struct m_ff_quat_f32;
 
 /*!
  * Allocates a filter fifo tracking @p num samples and fills it with @p num
@@ -40,7 +41,8 @@ m_ff_vec3_f32_get_num(struct m_ff_vec3_f32 *ff);
 
 /*!
  * Pushes a sample at the given timepoint, pushing samples out of order yields
- * unspecified behaviour, so samples must be pushed in time order.
+ * unspecified behaviour, so samples must be pushed in time order. Samples that
+ * are not finite are dropped.
  */
 void
 m_ff_vec3_f32_push(struct m_ff_vec3_f32 *ff, const struct xrt_vec3 *sample, uint64_t timestamp_ns);
@@ -57,6 +59,9 @@ m_ff_vec3_f32_get(struct m_ff_vec3_f32 *ff, size_t num, struct xrt_vec3 *out_sam
  * of samples sampled, if no samples was found between the timpoints returns 0
  * and sets @p out_average to all zeros.
  *
+ * Takes O(log n) time in the size of the fifo, the window is found with a
+ * binary search and the average comes from running sums kept on push.
+ *
  * @param ff          Filter fifo to search in.
  * @param start_ns    Timepoint furthest in the past, to start searching for
  *                    samples.
@@ -88,7 +93,8 @@ m_ff_f64_get_num(struct m_ff_f64 *ff);
 
 /*!
  * Pushes a sample at the given timepoint, pushing samples out of order yields
- * unspecified behaviour, so samples must be pushed in time order.
+ * unspecified behaviour, so samples must be pushed in time order. Samples that
+ * are not finite are dropped.
  */
 void
 m_ff_f64_push(struct m_ff_f64 *ff, const double *sample, uint64_t timestamp_ns);
@@ -104,6 +110,9 @@ m_ff_f64_get(struct m_ff_f64 *ff, size_t num, double *out_sample, uint64_t *out_
  * of samples sampled, if no samples was found between the timpoints returns 0
  * and sets @p out_average to all zeros.
  *
+ * Takes O(log n) time in the size of the fifo, the window is found with a
+ * binary search and the average comes from running sums kept on push.
+ *
  * @param ff          Filter fifo to search in.
  * @param start_ns    Timepoint furthest in the past, to start searching for
  *                    samples.
@@ -114,6 +123,62 @@ m_ff_f64_get(struct m_ff_f64 *ff, size_t num, double *out_sample, uint64_t *out_
 size_t
 m_ff_f64_filter(struct m_ff_f64 *ff, uint64_t start_ns, uint64_t stop_ns, double *out_average);
 
+/*!
+ * Allocates a filter fifo tracking @p num samples and fills it with @p num
+ * samples at timepoint zero.
+ */
+void
+m_ff_quat_f32_alloc(struct m_ff_quat_f32 **ff_out, size_t num);
+
+/*!
+ * Frees the given filter fifo and all its samples.
+ */
+void
+m_ff_quat_f32_free(struct m_ff_quat_f32 **ff_ptr);
+
+/*!
+ * Return the number of samples that can fill the fifo.
+ */
+size_t
+m_ff_quat_f32_get_num(struct m_ff_quat_f32 *ff);
+
+/*!
+ * Pushes a sample at the given timepoint, pushing samples out of order yields
+ * unspecified behaviour, so samples must be pushed in time order. Samples that
+ * are not finite are dropped.
+ *
+ * The sample is negated if needed to be in the same hemisphere as the
+ * previous one, so what @ref m_ff_quat_f32_get returns might be the negated
+ * but equivalent rotation.
+ */
+void
+m_ff_quat_f32_push(struct m_ff_quat_f32 *ff, const struct xrt_quat *sample, uint64_t timestamp_ns);
+
+/*!
+ * Return the sample at the index, 0 means the last sample push, 1 second-to-last, etc.
+ */
+bool
+m_ff_quat_f32_get(struct m_ff_quat_f32 *ff, size_t num, struct xrt_quat *out_sample, uint64_t *out_timestamp_ns);
+
+/*!
+ * Averages all rotations in the fifo between the two timepoints, returns
+ * number of samples sampled, if no samples was found between the timepoints
+ * returns 0 and sets @p out_average to identity.
+ *
+ * The average is the normalized mean of the hemisphere aligned quaternions,
+ * which is a good approximation for rotations that are close to each other,
+ * like the ones in a short time window.
+ *
+ * @param ff          Filter fifo to search in.
+ * @param start_ns    Timepoint furthest in the past, to start searching for
+ *                    samples.
+ * @param stop_ns     Timepoint closest in the past, or now, to stop searching
+ *                    for samples.
+ * @param out_average Average of all samples in the given timeframe.
+ */
+size_t
+m_ff_quat_f32_filter(struct m_ff_quat_f32 *ff, uint64_t start_ns, uint64_t stop_ns, struct xrt_quat *out_average);
+
 
 #ifdef __cplusplus
 }
@@ -8,13 +8,14 @@
  */
 
 #include "math/m_api.h"
-#include <string>
+#include <string_view>
 
 
 extern "C" size_t
 math_hash_string(const char *str_c, size_t length)
 {
-	std::string str = std::string(str_c, length);
-	std::hash<std::string> str_hash;
+	// Hashes the same as std::string, but without copying the string.
+	std::string_view str = std::string_view(str_c, length);
+	std::hash<std::string_view> str_hash;
 	return str_hash(str);
 }
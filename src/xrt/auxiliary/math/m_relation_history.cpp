@@ -19,10 +19,10 @@
 #include "util/u_trace_marker.h"
 #include "xrt/xrt_defines.h"
 #include "os/os_threading.h"
-#include "util/u_template_historybuf.hpp"
 
 #include <memory>
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <stdio.h>
 #include <stdlib.h>
@@ -30,7 +30,6 @@
 #include <assert.h>
 #include <mutex>
 
-using namespace xrt::auxiliary::util;
 namespace os = xrt::auxiliary::os;
 
 struct relation_history_entry
@@ -41,13 +40,170 @@ struct relation_history_entry
 
 static constexpr size_t BufLen = 4096;
 
+/*!
+ * How many entries readers may use, the oldest slot in the ring is the one the
+ * writer overwrites next so it is never handed out.
+ */
+static constexpr uint64_t ReadableLen = BufLen - 1;
+
+//! Number of 64 bit words that make up a relation, so it can be copied with atomics.
+static constexpr size_t RelationWords = sizeof(struct xrt_space_relation) / sizeof(uint64_t);
+static_assert(sizeof(struct xrt_space_relation) % sizeof(uint64_t) == 0, "Relation must be a multiple of 64 bits");
+
+/*!
+ * One entry in the ring, every field is accessed with relaxed atomics so that
+ * readers racing with the writer are well defined and merely get discarded.
+ */
+struct relation_history_slot
+{
+	std::atomic<uint64_t> timestamp;
+	std::atomic<uint64_t> relation[RelationWords];
+};
+
+/*!
+ * Single-writer, multi-reader ring of relations.
+ *
+ * Entries are addressed by a logical index that only ever grows, entry @p i
+ * lives in slot `i % BufLen`. The writer fills in the slot for index @p count
+ * and then publishes it by bumping @p count, which doubles as the epoch that
+ * readers validate against: a reader that looked at index @p i knows the data
+ * was not being overwritten if, after reading, `i >= count - ReadableLen`.
+ * Readers never block and only retry when the writer lapped them.
+ *
+ * Writers are still serialized with a mutex, to keep pushing from several
+ * threads safe, but that lock is never taken by readers.
+ */
 struct m_relation_history
 {
-	HistoryBuffer<struct relation_history_entry, BufLen> impl;
-	os::Mutex mutex;
+	relation_history_slot slots[BufLen];
+
+	//! Number of entries ever pushed, the next logical index to be written.
+	std::atomic<uint64_t> count{0};
+
+	//! Logical index of the first entry after the last clear.
+	std::atomic<uint64_t> start{0};
+
+	//! Serializes pushers and clear.
+	os::Mutex write_mutex;
 };
 
 
+/*
+ *
+ * Helpers.
+ *
+ */
+
+static inline relation_history_slot &
+slot_at(struct m_relation_history *rh, uint64_t index)
+{
+	return rh->slots[index % BufLen];
+}
+
+static inline uint64_t
+load_timestamp(struct m_relation_history *rh, uint64_t index)
+{
+	return slot_at(rh, index).timestamp.load(std::memory_order_relaxed);
+}
+
+static inline void
+load_entry(struct m_relation_history *rh, uint64_t index, struct relation_history_entry *out_entry)
+{
+	relation_history_slot &slot = slot_at(rh, index);
+
+	uint64_t words[RelationWords];
+	for (size_t i = 0; i < RelationWords; i++) {
+		words[i] = slot.relation[i].load(std::memory_order_relaxed);
+	}
+	memcpy(&out_entry->relation, words, sizeof(out_entry->relation));
+	out_entry->timestamp = slot.timestamp.load(std::memory_order_relaxed);
+}
+
+static inline void
+store_entry(struct m_relation_history *rh, uint64_t index, const struct relation_history_entry *entry)
+{
+	relation_history_slot &slot = slot_at(rh, index);
+
+	uint64_t words[RelationWords];
+	memcpy(words, &entry->relation, sizeof(words));
+	for (size_t i = 0; i < RelationWords; i++) {
+		slot.relation[i].store(words[i], std::memory_order_relaxed);
+	}
+	slot.timestamp.store(entry->timestamp, std::memory_order_relaxed);
+}
+
+//! The range of logical indices currently readable, given @p count.
+static inline uint64_t
+readable_begin(struct m_relation_history *rh, uint64_t count)
+{
+	uint64_t begin = rh->start.load(std::memory_order_acquire);
+	if (count > ReadableLen && count - ReadableLen > begin) {
+		begin = count - ReadableLen;
+	}
+	return begin;
+}
+
+/*!
+ * Finish a read: returns true if nothing at or after @p min_index was
+ * overwritten while we were reading it.
+ */
+static inline bool
+validate_read(struct m_relation_history *rh, uint64_t min_index)
+{
+	// Pairs with the release fence in push: if we saw any data from a new
+	// write, we are guaranteed to also see the count that preceded it.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t count = rh->count.load(std::memory_order_relaxed);
+	return count <= ReadableLen || min_index >= count - ReadableLen;
+}
+
+//! Interpolate between two entries, @p at_timestamp_ns lies between their timestamps.
+static void
+interpolate(const struct relation_history_entry &predecessor,
+            const struct relation_history_entry &successor,
+            uint64_t at_timestamp_ns,
+            struct xrt_space_relation *out_relation)
+{
+	// Do the thing.
+	int64_t diff_before = static_cast<int64_t>(at_timestamp_ns) - predecessor.timestamp;
+	int64_t diff_after = static_cast<int64_t>(successor.timestamp) - at_timestamp_ns;
+
+	float amount_to_lerp = (float)diff_before / (float)(diff_before + diff_after);
+
+	// Copy relation flags
+	xrt_space_relation result{};
+	result.relation_flags =
+	    (enum xrt_space_relation_flags)(predecessor.relation.relation_flags & successor.relation.relation_flags);
+	// First-order implementation - lerp between the before and after
+	if (0 != (result.relation_flags & XRT_SPACE_RELATION_POSITION_VALID_BIT)) {
+		result.pose.position =
+		    m_vec3_lerp(predecessor.relation.pose.position, successor.relation.pose.position, amount_to_lerp);
+	}
+	if (0 != (result.relation_flags & XRT_SPACE_RELATION_ORIENTATION_VALID_BIT)) {
+
+		math_quat_slerp(&predecessor.relation.pose.orientation, &successor.relation.pose.orientation,
+		                amount_to_lerp, &result.pose.orientation);
+	}
+
+	//! @todo Does interpolating the velocities make any sense?
+	if (0 != (result.relation_flags & XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT)) {
+		result.angular_velocity = m_vec3_lerp(predecessor.relation.angular_velocity,
+		                                      successor.relation.angular_velocity, amount_to_lerp);
+	}
+	if (0 != (result.relation_flags & XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT)) {
+		result.linear_velocity =
+		    m_vec3_lerp(predecessor.relation.linear_velocity, successor.relation.linear_velocity, amount_to_lerp);
+	}
+	*out_relation = result;
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
 void
 m_relation_history_create(struct m_relation_history **rh_ptr)
 {
@@ -62,115 +218,130 @@ m_relation_history_push(struct m_relation_history *rh, struct xrt_space_relation
 	struct relation_history_entry rhe;
 	rhe.relation = *in_relation;
 	rhe.timestamp = timestamp;
-	bool ret = false;
-	std::unique_lock<os::Mutex> lock(rh->mutex);
-	try {
-		// if we aren't empty, we can compare against the latest timestamp.
-		if (rh->impl.empty() || rhe.timestamp > rh->impl.back().timestamp) {
-			// Everything explodes if the timestamps in relation_history aren't monotonically increasing. If
-			// we get a timestamp that's before the most recent timestamp in the buffer, don't put it
-			// in the history.
-			rh->impl.push_back(rhe);
-			ret = true;
-		}
-	} catch (std::exception const &e) {
-		U_LOG_E("Caught exception: %s", e.what());
+
+	std::unique_lock<os::Mutex> lock(rh->write_mutex);
+
+	uint64_t count = rh->count.load(std::memory_order_relaxed);
+	uint64_t begin = rh->start.load(std::memory_order_relaxed);
+
+	// Everything explodes if the timestamps in relation_history aren't monotonically increasing. If we get a
+	// timestamp that's before the most recent timestamp in the buffer, don't put it in the history.
+	if (count > begin && rhe.timestamp <= load_timestamp(rh, count - 1)) {
+		return false;
 	}
-	return ret;
+
+	// Any reader that sees a word of the new entry must also see the count
+	// from before we started overwriting the slot, so it can discard it.
+	std::atomic_thread_fence(std::memory_order_release);
+	store_entry(rh, count, &rhe);
+
+	// Publish.
+	rh->count.store(count + 1, std::memory_order_release);
+
+	return true;
 }
 
 enum m_relation_history_result
 m_relation_history_get(struct m_relation_history *rh, uint64_t at_timestamp_ns, struct xrt_space_relation *out_relation)
 {
 	XRT_TRACE_MARKER();
-	std::unique_lock<os::Mutex> lock(rh->mutex);
-	try {
-		if (rh->impl.empty() || at_timestamp_ns == 0) {
+
+	if (at_timestamp_ns == 0) {
+		*out_relation = {};
+		return M_RELATION_HISTORY_RESULT_INVALID;
+	}
+
+	while (true) {
+		const uint64_t count = rh->count.load(std::memory_order_acquire);
+		const uint64_t b = readable_begin(rh, count);
+		const uint64_t e = count;
+
+		if (b >= e) {
 			// Do nothing. You push nothing to the buffer you get nothing from the buffer.
 			*out_relation = {};
 			return M_RELATION_HISTORY_RESULT_INVALID;
 		}
-		const auto b = rh->impl.begin();
-		const auto e = rh->impl.end();
 
-		// find the first element *not less than* our value. the lambda we pass is the comparison
-		// function, to compare against timestamps.
-		const auto it =
-		    std::lower_bound(b, e, at_timestamp_ns, [](const relation_history_entry &rhe, uint64_t timestamp) {
-			    return rhe.timestamp < timestamp;
-		    });
+		// find the first element *not less than* our value, a std::lower_bound over logical
+		// indices that also remembers the oldest index it looked at.
+		uint64_t it = b;
+		uint64_t len = e - b;
+		uint64_t min_touched = e - 1;
+		while (len > 0) {
+			uint64_t half = len / 2;
+			uint64_t mid = it + half;
+			min_touched = std::min(min_touched, mid);
+			if (load_timestamp(rh, mid) < at_timestamp_ns) {
+				it = mid + 1;
+				len = len - half - 1;
+			} else {
+				len = half;
+			}
+		}
+
+		struct relation_history_entry predecessor;
+		struct relation_history_entry successor;
+		enum m_relation_history_result result;
 
 		if (it == e) {
 			// lower bound is at the end:
 			// The desired timestamp is after what our buffer contains.
 			// (pose-prediction)
-			int64_t diff_prediction_ns = static_cast<int64_t>(at_timestamp_ns) - rh->impl.back().timestamp;
+			load_entry(rh, e - 1, &predecessor);
+			result = M_RELATION_HISTORY_RESULT_PREDICTED;
+		} else {
+			load_entry(rh, it, &successor);
+			min_touched = std::min(min_touched, it);
+			if (at_timestamp_ns == successor.timestamp) {
+				// exact match
+				result = M_RELATION_HISTORY_RESULT_EXACT;
+			} else if (it == b) {
+				// lower bound is at the beginning (and it's not an exact match):
+				// The desired timestamp is before what our buffer contains.
+				// (an edge case where somebody asks for a really old pose and we do our best)
+				result = M_RELATION_HISTORY_RESULT_REVERSE_PREDICTED;
+			} else {
+				// We precede it and follow it - 1 (which we know exists because we already
+				// handled the it == b case)
+				load_entry(rh, it - 1, &predecessor);
+				min_touched = std::min(min_touched, it - 1);
+				result = M_RELATION_HISTORY_RESULT_INTERPOLATED;
+			}
+		}
+
+		if (!validate_read(rh, min_touched)) {
+			// The writer lapped us and overwrote what we read, try again.
+			continue;
+		}
+
+		switch (result) {
+		case M_RELATION_HISTORY_RESULT_PREDICTED: {
+			int64_t diff_prediction_ns = static_cast<int64_t>(at_timestamp_ns) - predecessor.timestamp;
 			double delta_s = time_ns_to_s(diff_prediction_ns);
 
 			U_LOG_T("Extrapolating %f s past the back of the buffer!", delta_s);
 
-			m_predict_relation(&rh->impl.back().relation, delta_s, out_relation);
-			return M_RELATION_HISTORY_RESULT_PREDICTED;
-		}
-		if (at_timestamp_ns == it->timestamp) {
-			// exact match
+			m_predict_relation(&predecessor.relation, delta_s, out_relation);
+		} break;
+		case M_RELATION_HISTORY_RESULT_EXACT: {
 			U_LOG_T("Exact match in the buffer!");
-			*out_relation = it->relation;
-			return M_RELATION_HISTORY_RESULT_EXACT;
-		}
-		if (it == b) {
-			// lower bound is at the beginning (and it's not an exact match):
-			// The desired timestamp is before what our buffer contains.
-			// (an edge case where somebody asks for a really old pose and we do our best)
-			int64_t diff_prediction_ns = static_cast<int64_t>(at_timestamp_ns) - rh->impl.front().timestamp;
+			*out_relation = successor.relation;
+		} break;
+		case M_RELATION_HISTORY_RESULT_REVERSE_PREDICTED: {
+			int64_t diff_prediction_ns = static_cast<int64_t>(at_timestamp_ns) - successor.timestamp;
 			double delta_s = time_ns_to_s(diff_prediction_ns);
+
 			U_LOG_T("Extrapolating %f s before the front of the buffer!", delta_s);
-			m_predict_relation(&rh->impl.front().relation, delta_s, out_relation);
-			return M_RELATION_HISTORY_RESULT_REVERSE_PREDICTED;
-		}
-		U_LOG_T("Interpolating within buffer!");
-
-		// We precede *it and follow *(it - 1) (which we know exists because we already handled
-		// the it = begin() case)
-		const auto &predecessor = *(it - 1);
-		const auto &successor = *it;
-
-		// Do the thing.
-		int64_t diff_before = static_cast<int64_t>(at_timestamp_ns) - predecessor.timestamp;
-		int64_t diff_after = static_cast<int64_t>(successor.timestamp) - at_timestamp_ns;
-
-		float amount_to_lerp = (float)diff_before / (float)(diff_before + diff_after);
-
-		// Copy relation flags
-		xrt_space_relation result{};
-		result.relation_flags = (enum xrt_space_relation_flags)(predecessor.relation.relation_flags &
-		                                                        successor.relation.relation_flags);
-		// First-order implementation - lerp between the before and after
-		if (0 != (result.relation_flags & XRT_SPACE_RELATION_POSITION_VALID_BIT)) {
-			result.pose.position = m_vec3_lerp(predecessor.relation.pose.position,
-			                                   successor.relation.pose.position, amount_to_lerp);
-		}
-		if (0 != (result.relation_flags & XRT_SPACE_RELATION_ORIENTATION_VALID_BIT)) {
 
-			math_quat_slerp(&predecessor.relation.pose.orientation, &successor.relation.pose.orientation,
-			                amount_to_lerp, &result.pose.orientation);
+			m_predict_relation(&successor.relation, delta_s, out_relation);
+		} break;
+		default: {
+			U_LOG_T("Interpolating within buffer!");
+			interpolate(predecessor, successor, at_timestamp_ns, out_relation);
+		} break;
 		}
 
-		//! @todo Does interpolating the velocities make any sense?
-		if (0 != (result.relation_flags & XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT)) {
-			result.angular_velocity = m_vec3_lerp(predecessor.relation.angular_velocity,
-			                                      successor.relation.angular_velocity, amount_to_lerp);
-		}
-		if (0 != (result.relation_flags & XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT)) {
-			result.linear_velocity = m_vec3_lerp(predecessor.relation.linear_velocity,
-			                                     successor.relation.linear_velocity, amount_to_lerp);
-		}
-		*out_relation = result;
-		return M_RELATION_HISTORY_RESULT_INTERPOLATED;
-
-	} catch (std::exception const &e) {
-		U_LOG_E("Caught exception: %s", e.what());
-		return M_RELATION_HISTORY_RESULT_INVALID;
+		return result;
 	}
 }
 
@@ -226,26 +397,38 @@ m_relation_history_get_latest(struct m_relation_history *rh,
                               uint64_t *out_time_ns,
                               struct xrt_space_relation *out_relation)
 {
-	std::unique_lock<os::Mutex> lock(rh->mutex);
-	if (rh->impl.empty()) {
-		return false;
+	while (true) {
+		const uint64_t count = rh->count.load(std::memory_order_acquire);
+		if (count <= readable_begin(rh, count)) {
+			return false;
+		}
+
+		struct relation_history_entry rhe;
+		load_entry(rh, count - 1, &rhe);
+
+		if (!validate_read(rh, count - 1)) {
+			continue;
+		}
+
+		*out_relation = rhe.relation;
+		*out_time_ns = rhe.timestamp;
+		return true;
 	}
-	*out_relation = rh->impl.back().relation;
-	*out_time_ns = rh->impl.back().timestamp;
-	return true;
 }
 
 uint32_t
 m_relation_history_get_size(const struct m_relation_history *rh)
 {
-	return (uint32_t)rh->impl.size();
+	auto *mrh = const_cast<struct m_relation_history *>(rh);
+	const uint64_t count = mrh->count.load(std::memory_order_acquire);
+	return (uint32_t)(count - readable_begin(mrh, count));
 }
 
 void
 m_relation_history_clear(struct m_relation_history *rh)
 {
-	std::unique_lock<os::Mutex> lock(rh->mutex);
-	rh->impl.clear();
+	std::unique_lock<os::Mutex> lock(rh->write_mutex);
+	rh->start.store(rh->count.load(std::memory_order_relaxed), std::memory_order_release);
 }
 
 void
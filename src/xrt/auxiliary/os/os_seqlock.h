@@ -0,0 +1,155 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Sequence lock helpers, for one writer and any number of readers.
+ *
+ * @ingroup aux_os
+ */
+
+#pragma once
+
+#include "xrt/xrt_compiler.h"
+
+#include "util/u_time.h"
+
+#include "os/os_time.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*!
+ * @defgroup aux_os_seqlock Sequence lock
+ * @ingroup aux_os
+ *
+ * The writer makes the sequence number odd, writes the data and makes it even
+ * again. Readers copy the data out and retry if the sequence number was odd or
+ * changed under them, so the writer never waits on readers. The sequence
+ * number can live in shared memory, the helpers only use real atomic
+ * operations on it.
+ *
+ * @code{.c}
+ * for (uint32_t tries = 0;; tries++) {
+ * 	os_seqlock_read_backoff(tries, MAX_READ_SPINS);
+ *
+ * 	int32_t begin = 0;
+ * 	if (!os_seqlock_read_begin(&obj->seq, &begin)) {
+ * 		continue;
+ * 	}
+ *
+ * 	copy = obj->data;
+ *
+ * 	if (os_seqlock_read_end(&obj->seq, begin)) {
+ * 		break;
+ * 	}
+ * }
+ * @endcode
+ */
+
+/*!
+ * Acquire load. Don't use a cmpxchg where we can, it writes the cache line and
+ * readers on different cores would fight over it.
+ *
+ * @ingroup aux_os_seqlock
+ */
+static inline int32_t
+os_seqlock_load_acquire(xrt_atomic_s32_t *p)
+{
+#if defined(__GNUC__)
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#else
+	return xrt_atomic_s32_cmpxchg(p, 0, 0);
+#endif
+}
+
+/*!
+ * Release store, only for values with a single writer.
+ *
+ * @ingroup aux_os_seqlock
+ */
+static inline void
+os_seqlock_store_release(xrt_atomic_s32_t *p, int32_t v)
+{
+#if defined(__GNUC__)
+	__atomic_store_n(p, v, __ATOMIC_RELEASE);
+#else
+	xrt_atomic_s32_cmpxchg(p, *p, v);
+#endif
+}
+
+/*!
+ * Start writing, readers will retry until @ref os_seqlock_write_end.
+ *
+ * @ingroup aux_os_seqlock
+ */
+static inline void
+os_seqlock_write_begin(xrt_atomic_s32_t *seq)
+{
+	// Odd, the increment is a full barrier so the data writes stay after it.
+	xrt_atomic_s32_inc_return(seq);
+}
+
+/*!
+ * Done writing, the data is visible to readers before this is.
+ *
+ * @ingroup aux_os_seqlock
+ */
+static inline void
+os_seqlock_write_end(xrt_atomic_s32_t *seq)
+{
+	// Even again.
+	xrt_atomic_s32_inc_return(seq);
+}
+
+/*!
+ * Start reading, returns false if a write is in progress and the read should
+ * be retried straight away.
+ *
+ * @ingroup aux_os_seqlock
+ */
+static inline bool
+os_seqlock_read_begin(xrt_atomic_s32_t *seq, int32_t *out_begin)
+{
+	*out_begin = os_seqlock_load_acquire(seq);
+	return (*out_begin & 1) == 0;
+}
+
+/*!
+ * Returns true if the data copied since @ref os_seqlock_read_begin is
+ * consistent, false if the writer got in the way and it must be copied again.
+ *
+ * @ingroup aux_os_seqlock
+ */
+static inline bool
+os_seqlock_read_end(xrt_atomic_s32_t *seq, int32_t begin)
+{
+#if defined(__GNUC__)
+	// The copy before this can't be moved past the load.
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(seq, __ATOMIC_RELAXED) == begin;
+#else
+	return xrt_atomic_s32_cmpxchg(seq, 0, 0) == begin;
+#endif
+}
+
+/*!
+ * Call at the top of each read try. The writer is only ever in there for a
+ * copy, but it can be preempted half way, so after @p max_spins tries this
+ * sleeps for 0.1 ms instead of spinning the core away from it.
+ *
+ * @ingroup aux_os_seqlock
+ */
+static inline void
+os_seqlock_read_backoff(uint32_t tries, uint32_t max_spins)
+{
+	if (tries >= max_spins) {
+		os_nanosleep(U_TIME_1MS_IN_NS / 10);
+	}
+}
+
+
+#ifdef __cplusplus
+}
+#endif
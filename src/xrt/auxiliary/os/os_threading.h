@@ -166,6 +166,18 @@ os_cond_signal(struct os_cond *oc)
 	pthread_cond_signal(&oc->cond);
 }
 
+/*!
+ * Signal all waiting threads.
+ *
+ * @public @memberof os_cond
+ */
+static inline void
+os_cond_broadcast(struct os_cond *oc)
+{
+	assert(oc->initialized);
+	pthread_cond_broadcast(&oc->cond);
+}
+
 /*!
  * Wait.
  *
@@ -188,6 +200,33 @@ os_cond_wait(struct os_cond *oc, struct os_mutex *om)
 	pthread_cond_wait(&oc->cond, &om->mutex);
 }
 
+// Defined in the semaphore section below, shared with the timed cond wait.
+static inline int
+os_semaphore_get_realtime_clock(struct timespec *ts, uint64_t timeout_ns);
+
+/*!
+ * Wait, but give up after @p timeout_ns nanoseconds.
+ *
+ * Same rules as @ref os_cond_wait apply: call in a loop testing the actual
+ * condition, with the mutex @p om locked.
+ *
+ * @return 0 if woken up, ETIMEDOUT if the timeout expired.
+ *
+ * @public @memberof os_cond
+ */
+static inline int
+os_cond_timedwait(struct os_cond *oc, struct os_mutex *om, uint64_t timeout_ns)
+{
+	assert(oc->initialized);
+
+	struct timespec abs_timeout;
+	if (os_semaphore_get_realtime_clock(&abs_timeout, timeout_ns) == -1) {
+		assert(false);
+	}
+
+	return pthread_cond_timedwait(&oc->cond, &om->mutex, &abs_timeout);
+}
+
 /*!
  * Clean up.
  *
@@ -10,16 +10,22 @@
 #include "t_euroc_recorder.h"
 
 #include "os/os_time.h"
+#include "util/u_debug.h"
 #include "util/u_frame.h"
-#include "util/u_sink.h"
+#include "util/u_logging.h"
 #include "util/u_var.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
 #include <ctime>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <queue>
 #include <iomanip>
 
@@ -27,38 +33,61 @@
 
 //! @todo: Now that IMU sinks support groundtruth, we could save it here as well.
 
+DEBUG_GET_ONCE_OPTION(format, "EUROC_RECORDER_FORMAT", "png")
+DEBUG_GET_ONCE_NUM_OPTION(png_level, "EUROC_RECORDER_PNG_LEVEL", 1)
+DEBUG_GET_ONCE_NUM_OPTION(thread_count, "EUROC_RECORDER_THREADS", 2)
+DEBUG_GET_ONCE_NUM_OPTION(queue_size, "EUROC_RECORDER_QUEUE_SIZE", 32)
+
+using std::atomic;
+using std::condition_variable;
+using std::deque;
 using std::lock_guard;
 using std::mutex;
 using std::ofstream;
 using std::queue;
 using std::string;
+using std::thread;
+using std::unique_lock;
 using std::vector;
 using std::filesystem::create_directories;
 
+//! A copied frame waiting to be written by one of the writer threads.
+struct euroc_recorder_job
+{
+	struct xrt_frame *frame;
+	bool is_left;
+};
+
 struct euroc_recorder
 {
 	struct xrt_frame_node node;
 	string path; //!< Destination path for the dataset
+	struct euroc_recorder_config config;
 
-	bool recording;                    //!< Whether samples are being recorded
+	atomic<bool> recording;            //!< Whether samples are being recorded, toggled from the UI
 	bool files_created;                //!< Whether the dataset directory structure has been created
 	struct u_var_button recording_btn; //!< UI button to start/stop `recording`
 
-	// Cloner sinks: copy frame to heap for quick release of the original
-	struct xrt_slam_sinks cloner_queues; //!< Queue sinks that write into cloner sinks
-	struct xrt_imu_sink cloner_imu_sink;
-	struct xrt_frame_sink cloner_left_sink;
-	struct xrt_frame_sink cloner_right_sink;
-
-	// Writer sinks: write copied frame to disk
-	struct xrt_slam_sinks writer_queues; //!< Queue sinks that write into writer sinks
-	struct xrt_imu_sink writer_imu_sink;
-	struct xrt_frame_sink writer_left_sink;
-	struct xrt_frame_sink writer_right_sink;
+	// Public sinks: copy frames and queue them for the writer threads
+	struct xrt_slam_sinks public_sinks;
+	struct xrt_imu_sink imu_sink;
+	struct xrt_frame_sink left_sink;
+	struct xrt_frame_sink right_sink;
 
-	queue<xrt_imu_sample> imu_queue{}; //!< IMU pushes get saved here and are delayed until left_frame pushes
+	queue<xrt_imu_sample> imu_queue{}; //!< IMU pushes get saved here and are delayed until left_frame writes
 	mutex imu_queue_lock{};            //!< Lock for imu_queue
 
+	// Writer threads, the queue is bounded by config.queue_size
+	deque<euroc_recorder_job> jobs{};
+	mutex jobs_lock{};              //!< Lock for jobs, running, the camera csv files and stats
+	condition_variable jobs_cond{}; //!< Signaled when a job is added or when stopping
+	vector<thread> writers{};
+	bool running;
+
+	struct euroc_recorder_stats stats; //!< Protected by jobs_lock
+
+	mutex imu_csv_lock{}; //!< Lock for imu_csv, held from taking samples off imu_queue until they are written
+
 	// CSV file handles, ofstream implementation is already buffered.
 	// Using pointers because of `container_of`
 	ofstream *imu_csv;
@@ -69,7 +98,7 @@ struct euroc_recorder
 
 /*
  *
- * Writer sinks functionality
+ * Writer threads functionality
  *
  */
 
@@ -99,12 +128,36 @@ euroc_recorder_try_mkfiles(struct euroc_recorder *er)
 	*er->right_cam_csv << "#timestamp [ns],filename" CSV_EOL;
 }
 
+static const char *
+euroc_recorder_extension(euroc_recorder *er, struct xrt_frame *frame)
+{
+	if (er->config.image_format == EUROC_RECORDER_IMAGE_PNG) {
+		return ".png";
+	}
+	return frame->format == XRT_FORMAT_L8 ? ".pgm" : ".ppm";
+}
+
 static void
-euroc_recorder_flush(struct euroc_recorder *er)
+euroc_recorder_save_imu(euroc_recorder *er, struct xrt_imu_sample *sample)
+{
+	timepoint_ns ts = sample->timestamp_ns;
+	xrt_vec3_f64 a = sample->accel_m_s2;
+	xrt_vec3_f64 w = sample->gyro_rad_secs;
+
+	*er->imu_csv << ts << ",";
+	*er->imu_csv << w.x << "," << w.y << "," << w.z << ",";
+	*er->imu_csv << a.x << "," << a.y << "," << a.z << CSV_EOL;
+}
+
+static void
+euroc_recorder_flush_imu(struct euroc_recorder *er)
 {
 	vector<xrt_imu_sample> samples;
 
-	{ // Move samples out of imu_queue into vector to minimize mutex contention
+	// Held until written, or two writers could write their batches out of order.
+	lock_guard csv_lock{er->imu_csv_lock};
+
+	{ // Move samples out of imu_queue into vector to minimize contention with the sink
 		lock_guard lock{er->imu_queue_lock};
 		samples.reserve(er->imu_queue.size());
 		while (!er->imu_queue.empty()) {
@@ -115,30 +168,15 @@ euroc_recorder_flush(struct euroc_recorder *er)
 
 	// Write queued IMU samples to csv stream.
 	for (xrt_imu_sample &sample : samples) {
-		xrt_sink_push_imu(&er->writer_imu_sink, &sample);
+		euroc_recorder_save_imu(er, &sample);
 	}
 
-	// Flush csv streams. Not necessary, doing it only to increase flush frequency
+	// Not necessary, doing it only to increase flush frequency
 	er->imu_csv->flush();
-	er->left_cam_csv->flush();
-	er->right_cam_csv->flush();
 }
 
-extern "C" void
-euroc_recorder_save_imu(xrt_imu_sink *sink, struct xrt_imu_sample *sample)
-{
-	euroc_recorder *er = container_of(sink, euroc_recorder, writer_imu_sink);
-
-	timepoint_ns ts = sample->timestamp_ns;
-	xrt_vec3_f64 a = sample->accel_m_s2;
-	xrt_vec3_f64 w = sample->gyro_rad_secs;
-
-	*er->imu_csv << ts << ",";
-	*er->imu_csv << w.x << "," << w.y << "," << w.z << ",";
-	*er->imu_csv << a.x << "," << a.y << "," << a.z << CSV_EOL;
-}
-
-static void
+//! Encode and write the image, the csv row was already written when queued.
+static bool
 euroc_recorder_save_frame(euroc_recorder *er, struct xrt_frame *frame, bool is_left)
 {
 	string cam_name = is_left ? "cam0" : "cam1";
@@ -146,43 +184,73 @@ euroc_recorder_save_frame(euroc_recorder *er, struct xrt_frame *frame, bool is_l
 
 	assert(frame->format == XRT_FORMAT_L8 || frame->format == XRT_FORMAT_R8G8B8); // Only formats supported
 	auto img_type = frame->format == XRT_FORMAT_L8 ? CV_8UC1 : CV_8UC3;
-	string img_path = er->path + "/mav0/" + cam_name + "/data/" + std::to_string(ts) + ".png";
+	string img_path = er->path + "/mav0/" + cam_name + "/data/" + std::to_string(ts) +
+	                  euroc_recorder_extension(er, frame);
 	cv::Mat img{(int)frame->height, (int)frame->width, img_type, frame->data, frame->stride};
-	cv::imwrite(img_path, img);
 
-	ofstream *cam_csv = is_left ? er->left_cam_csv : er->right_cam_csv;
-	*cam_csv << ts << "," << ts << ".png" CSV_EOL;
-}
+	vector<int> params{};
+	if (er->config.image_format == EUROC_RECORDER_IMAGE_PNG) {
+		params = {cv::IMWRITE_PNG_COMPRESSION, er->config.png_level};
+	} else {
+		params = {cv::IMWRITE_PXM_BINARY, 1};
+	}
 
-extern "C" void
-euroc_recorder_save_left(struct xrt_frame_sink *sink, struct xrt_frame *frame)
-{
-	euroc_recorder *er = container_of(sink, euroc_recorder, writer_left_sink);
-	euroc_recorder_flush(er);
-	euroc_recorder_save_frame(er, frame, true);
+	try {
+		return cv::imwrite(img_path, img, params);
+	} catch (const cv::Exception &e) {
+		U_LOG_E("Failed to write '%s': %s", img_path.c_str(), e.what());
+		return false;
+	}
 }
 
-extern "C" void
-euroc_recorder_save_right(struct xrt_frame_sink *sink, struct xrt_frame *frame)
+static void
+euroc_recorder_writer_run(struct euroc_recorder *er)
 {
-	euroc_recorder *er = container_of(sink, euroc_recorder, writer_right_sink);
-	euroc_recorder_save_frame(er, frame, false);
+	unique_lock lock{er->jobs_lock};
+
+	// Keep going until stopped and every queued frame has been written
+	while (er->running || !er->jobs.empty()) {
+		if (er->jobs.empty()) {
+			er->jobs_cond.wait(lock);
+			continue;
+		}
+
+		euroc_recorder_job job = er->jobs.front();
+		er->jobs.pop_front();
+		er->stats.queued = er->jobs.size();
+
+		lock.unlock();
+
+		// Same as before, IMU samples get written out along left frames
+		if (job.is_left) {
+			euroc_recorder_flush_imu(er);
+		}
+		bool ok = euroc_recorder_save_frame(er, job.frame, job.is_left);
+		xrt_frame_reference(&job.frame, NULL);
+
+		lock.lock();
+
+		if (ok) {
+			er->stats.written++;
+		} else {
+			er->stats.failed++;
+		}
+	}
 }
 
 
 /*
  *
- * Cloner sinks functionality
+ * Public sinks functionality
  *
  */
 
 extern "C" void
 euroc_recorder_receive_imu(xrt_imu_sink *sink, struct xrt_imu_sample *sample)
 {
-	// Contrary to frame sinks, we don't have separately threaded queues for IMU
-	// sinks so we use an std::queue to temporarily store IMU samples, later we
-	// write them to disk when writing left frames.
-	euroc_recorder *er = container_of(sink, euroc_recorder, cloner_imu_sink);
+	// Contrary to frames, we write IMU samples to disk in batches when
+	// writing left frames, until then they wait here.
+	euroc_recorder *er = container_of(sink, euroc_recorder, imu_sink);
 
 	if (!er->recording) {
 		return;
@@ -194,7 +262,6 @@ euroc_recorder_receive_imu(xrt_imu_sink *sink, struct xrt_imu_sample *sample)
 	}
 }
 
-
 static void
 euroc_recorder_receive_frame(euroc_recorder *er, struct xrt_frame *src_frame, bool is_left)
 {
@@ -202,26 +269,44 @@ euroc_recorder_receive_frame(euroc_recorder *er, struct xrt_frame *src_frame, bo
 		return;
 	}
 
-	// Let's clone the frame so that we can release the src_frame quickly
-	xrt_frame *copy = nullptr;
-	u_frame_clone(src_frame, &copy);
+	{
+		lock_guard lock{er->jobs_lock};
+
+		// Never block the caller on the disk, drop frames instead
+		if (!er->running || er->jobs.size() >= er->config.queue_size) {
+			er->stats.dropped++;
+			return;
+		}
+
+		// Let's clone the frame so that we can release the src_frame quickly
+		xrt_frame *copy = nullptr;
+		u_frame_clone(src_frame, &copy);
+
+		// Write the row here so it stays in timestamp order regardless of
+		// which writer thread finishes first.
+		uint64_t ts = copy->timestamp;
+		ofstream *cam_csv = is_left ? er->left_cam_csv : er->right_cam_csv;
+		*cam_csv << ts << "," << ts << euroc_recorder_extension(er, copy) << CSV_EOL;
 
-	xrt_sink_push_frame(is_left ? er->writer_queues.left : er->writer_queues.right, copy);
+		er->jobs.push_back({copy, is_left});
+		er->stats.queued = er->jobs.size();
+		er->stats.max_queued = std::max(er->stats.max_queued, er->stats.queued);
+	}
 
-	xrt_frame_reference(&copy, NULL);
+	er->jobs_cond.notify_one();
 }
 
 extern "C" void
 euroc_recorder_receive_left(struct xrt_frame_sink *sink, struct xrt_frame *frame)
 {
-	euroc_recorder *er = container_of(sink, euroc_recorder, cloner_left_sink);
+	euroc_recorder *er = container_of(sink, euroc_recorder, left_sink);
 	euroc_recorder_receive_frame(er, frame, true);
 }
 
 extern "C" void
 euroc_recorder_receive_right(struct xrt_frame_sink *sink, struct xrt_frame *frame)
 {
-	euroc_recorder *er = container_of(sink, euroc_recorder, cloner_right_sink);
+	euroc_recorder *er = container_of(sink, euroc_recorder, right_sink);
 	euroc_recorder_receive_frame(er, frame, false);
 }
 
@@ -234,7 +319,27 @@ euroc_recorder_receive_right(struct xrt_frame_sink *sink, struct xrt_frame *fram
 
 extern "C" void
 euroc_recorder_node_break_apart(struct xrt_frame_node *node)
-{}
+{
+	struct euroc_recorder *er = container_of(node, struct euroc_recorder, node);
+
+	{
+		lock_guard lock{er->jobs_lock};
+		er->running = false;
+	}
+	er->jobs_cond.notify_all();
+
+	// The writers drain the queue before returning
+	for (thread &t : er->writers) {
+		t.join();
+	}
+	er->writers.clear();
+
+	if (er->files_created) {
+		euroc_recorder_flush_imu(er);
+		er->left_cam_csv->flush();
+		er->right_cam_csv->flush();
+	}
+}
 
 extern "C" void
 euroc_recorder_node_destroy(struct xrt_frame_node *node)
@@ -253,12 +358,37 @@ euroc_recorder_node_destroy(struct xrt_frame_node *node)
  *
  */
 
+extern "C" void
+euroc_recorder_default_config(struct euroc_recorder_config *out_config)
+{
+	string format = debug_get_option_format();
+	out_config->image_format = format == "pnm" ? EUROC_RECORDER_IMAGE_PNM : EUROC_RECORDER_IMAGE_PNG;
+	out_config->png_level = (int)debug_get_num_option_png_level();
+	out_config->thread_count = (uint32_t)debug_get_num_option_thread_count();
+	out_config->queue_size = (uint32_t)debug_get_num_option_queue_size();
+}
+
 extern "C" xrt_slam_sinks *
 euroc_recorder_create(struct xrt_frame_context *xfctx, const char *record_path, bool record_from_start)
+{
+	struct euroc_recorder_config config;
+	euroc_recorder_default_config(&config);
+	return euroc_recorder_create_with_config(xfctx, record_path, record_from_start, &config);
+}
+
+extern "C" xrt_slam_sinks *
+euroc_recorder_create_with_config(struct xrt_frame_context *xfctx,
+                                  const char *record_path,
+                                  bool record_from_start,
+                                  const struct euroc_recorder_config *config)
 {
 	struct euroc_recorder *er = new euroc_recorder{};
 
 	er->recording = record_from_start;
+	er->config = *config;
+	er->config.png_level = std::clamp(er->config.png_level, 0, 9);
+	er->config.thread_count = std::max(er->config.thread_count, 1u);
+	er->config.queue_size = std::max(er->config.queue_size, 1u);
 
 	struct xrt_frame_node *xfn = &er->node;
 	xfn->break_apart = euroc_recorder_node_break_apart;
@@ -281,49 +411,59 @@ euroc_recorder_create(struct xrt_frame_context *xfctx, const char *record_path,
 		euroc_recorder_try_mkfiles(er);
 	}
 
-	// Setup sink pipeline
-
-	// First, make the public queues that will clone frames in memory so that
-	// original frames can be released as soon as possible. Not doing this could
-	// result in frame queues from the user being filled up.
-	u_sink_queue_create(xfctx, 0, &er->cloner_left_sink, &er->cloner_queues.left);
-	u_sink_queue_create(xfctx, 0, &er->cloner_right_sink, &er->cloner_queues.right);
-	er->cloner_queues.imu = &er->cloner_imu_sink;
-
-	// Clone samples into heap and release original samples right after
-	er->cloner_imu_sink.push_imu = euroc_recorder_receive_imu;
-	er->cloner_left_sink.push_frame = euroc_recorder_receive_left;
-	er->cloner_right_sink.push_frame = euroc_recorder_receive_right;
-
-	// Then, make a queue to save frame sinks to disk in a separate thread
-	u_sink_queue_create(xfctx, 0, &er->writer_left_sink, &er->writer_queues.left);
-	u_sink_queue_create(xfctx, 0, &er->writer_right_sink, &er->writer_queues.right);
-	er->writer_queues.imu = nullptr;
-
-	// Write cloned samples to disk with these
-	er->writer_imu_sink.push_imu = euroc_recorder_save_imu;
-	er->writer_left_sink.push_frame = euroc_recorder_save_left;
-	er->writer_right_sink.push_frame = euroc_recorder_save_right;
+	// Setup sinks, they copy the frames so that the originals can be released
+	// as soon as possible and queue them for the writer threads. Not doing
+	// this could result in frame queues from the user being filled up.
+	er->imu_sink.push_imu = euroc_recorder_receive_imu;
+	er->left_sink.push_frame = euroc_recorder_receive_left;
+	er->right_sink.push_frame = euroc_recorder_receive_right;
+	er->public_sinks.imu = &er->imu_sink;
+	er->public_sinks.left = &er->left_sink;
+	er->public_sinks.right = &er->right_sink;
+
+	er->running = true;
+	for (uint32_t i = 0; i < er->config.thread_count; i++) {
+		er->writers.emplace_back(euroc_recorder_writer_run, er);
+	}
 
-	xrt_slam_sinks *public_sinks = &er->cloner_queues;
+	xrt_slam_sinks *public_sinks = &er->public_sinks;
 	return public_sinks;
 }
 
+extern "C" void
+euroc_recorder_get_stats(struct xrt_slam_sinks *public_sinks, struct euroc_recorder_stats *out_stats)
+{
+	euroc_recorder *er = container_of(public_sinks, euroc_recorder, public_sinks);
+	lock_guard lock{er->jobs_lock};
+	*out_stats = er->stats;
+}
+
 static void
 euroc_recorder_btn_cb(void *ptr)
 {
 	euroc_recorder *er = (euroc_recorder *)ptr;
-	euroc_recorder_try_mkfiles(er);
-	er->recording = !er->recording;
+	{
+		lock_guard lock{er->jobs_lock};
+		euroc_recorder_try_mkfiles(er);
+	}
+	// Only the UI toggles it, the sinks just read it.
+	bool recording = !er->recording;
+	er->recording = recording;
 	snprintf(er->recording_btn.label, sizeof(er->recording_btn.label),
-	         er->recording ? "Stop recording" : "Record EuRoC dataset");
+	         recording ? "Stop recording" : "Record EuRoC dataset");
 }
 
 extern "C" void
 euroc_recorder_add_ui(struct xrt_slam_sinks *public_sinks, void *root)
 {
-	euroc_recorder *er = container_of(public_sinks, euroc_recorder, cloner_queues);
+	euroc_recorder *er = container_of(public_sinks, euroc_recorder, public_sinks);
 	er->recording_btn.cb = euroc_recorder_btn_cb;
 	er->recording_btn.ptr = er;
 	u_var_add_button(root, &er->recording_btn, er->recording ? "Stop recording" : "Record EuRoC dataset");
+
+	u_var_add_ro_u64(root, &er->stats.queued, "Queued frames");
+	u_var_add_ro_u64(root, &er->stats.max_queued, "Most queued frames");
+	u_var_add_ro_u64(root, &er->stats.written, "Written frames");
+	u_var_add_ro_u64(root, &er->stats.dropped, "Dropped frames");
+	u_var_add_ro_u64(root, &er->stats.failed, "Failed writes");
 }
@@ -19,6 +19,71 @@
 extern "C" {
 #endif
 
+/*!
+ * Image file format the recorder writes frames in, all of them lossless.
+ *
+ * @ingroup aux_tracking
+ */
+enum euroc_recorder_image_format
+{
+	//! PNG, compression level set by @ref euroc_recorder_config::png_level.
+	EUROC_RECORDER_IMAGE_PNG,
+	//! Uncompressed binary PGM/PPM, cheapest to write but biggest on disk.
+	EUROC_RECORDER_IMAGE_PNM,
+};
+
+/*!
+ * Recorder settings, see @ref euroc_recorder_default_config.
+ *
+ * @ingroup aux_tracking
+ */
+struct euroc_recorder_config
+{
+	enum euroc_recorder_image_format image_format;
+
+	//! PNG compression level 0-9, the lower ones are a lot faster to encode.
+	int png_level;
+
+	//! Number of threads encoding and writing frames.
+	uint32_t thread_count;
+
+	//! Frames waiting to be written, once full new frames are dropped.
+	uint32_t queue_size;
+};
+
+/*!
+ * Counters of a recorder, see @ref euroc_recorder_get_stats.
+ *
+ * @ingroup aux_tracking
+ */
+struct euroc_recorder_stats
+{
+	//! Frames currently waiting to be written.
+	uint64_t queued;
+
+	//! Most frames that have been waiting at once, how close we got to dropping.
+	uint64_t max_queued;
+
+	//! Frames written to disk.
+	uint64_t written;
+
+	//! Frames dropped because the queue was full.
+	uint64_t dropped;
+
+	//! Frames that failed to be written.
+	uint64_t failed;
+};
+
+/*!
+ * Fill out the default config, can be changed with the `EUROC_RECORDER_FORMAT`
+ * (png or pnm), `EUROC_RECORDER_PNG_LEVEL`, `EUROC_RECORDER_THREADS` and
+ * `EUROC_RECORDER_QUEUE_SIZE` environment variables.
+ *
+ * @ingroup aux_tracking
+ */
+void
+euroc_recorder_default_config(struct euroc_recorder_config *out_config);
+
 /*!
  * @brief Create SLAM sinks to record samples in EuRoC format.
  *
@@ -32,6 +97,33 @@ extern "C" {
 struct xrt_slam_sinks *
 euroc_recorder_create(struct xrt_frame_context *xfctx, const char *record_path, bool record_from_start);
 
+/*!
+ * Same as @ref euroc_recorder_create but with the given @p config instead of
+ * the default one.
+ *
+ * Frames pushed to the sinks are copied and queued, they are then encoded and
+ * written by a pool of threads. The pushing thread never waits on the disk,
+ * if the queue is full the frame is dropped and counted instead.
+ *
+ * @ingroup aux_tracking
+ */
+struct xrt_slam_sinks *
+euroc_recorder_create_with_config(struct xrt_frame_context *xfctx,
+                                  const char *record_path,
+                                  bool record_from_start,
+                                  const struct euroc_recorder_config *config);
+
+/*!
+ * Get the counters of the recorder.
+ *
+ * @param er The sinks returned by @ref euroc_recorder_create
+ * @param out_stats Where to write the counters to.
+ *
+ * @ingroup aux_tracking
+ */
+void
+euroc_recorder_get_stats(struct xrt_slam_sinks *er, struct euroc_recorder_stats *out_stats);
+
 /*!
  * Add EuRoC recorder UI button to start recording after creation.
  *
@@ -1,4 +1,4 @@
-// Copyright 2019, Collabora, Ltd.
+// Copyright 2019-2022, Collabora, Ltd.
 // SPDX-License-Identifier: BSL-1.0
 /*!
  * @file
@@ -7,12 +7,15 @@
  * @ingroup aux_tracking
  */
 
+#include "math/m_api.h"
+
 #include "util/u_var.h"
 #include "util/u_misc.h"
 #include "util/u_sink.h"
 #include "util/u_debug.h"
 #include "util/u_frame.h"
 #include "util/u_format.h"
+#include "util/u_worker.h"
 #include "util/u_trace_marker.h"
 
 #include "tracking/t_tracking.h"
@@ -124,6 +127,11 @@ t_hsv_build_optimized_table(struct t_hsv_filter_params *params, struct t_hsv_fil
 
 #define NUM_CHANNELS 4
 
+//! Don't bother splitting up bands smaller than this.
+#define MIN_BAND_ROWS (16)
+
+DEBUG_GET_ONCE_NUM_OPTION(band_count, "T_HSV_FILTER_BANDS", 8)
+
 /*!
  * An @ref xrt_frame_sink that splits the input based on hue.
  * @implements xrt_frame_sink
@@ -144,109 +152,67 @@ struct t_hsv_filter
 	struct u_sink_debug usds[NUM_CHANNELS];
 
 	struct t_hsv_filter_optimized_table table;
+
+	//! Row kernels, picked at creation.
+	const struct t_hsv_filter_funcs *funcs;
+
+	//! If not NULL the rows of a frame are filtered in bands on this group.
+	struct u_worker_group *group;
+
+	//! How many bands to split each frame into.
+	uint32_t band_count;
+};
+
+/*!
+ * A frame being filtered, shared by all row bands.
+ */
+struct hsv_rows
+{
+	struct t_hsv_filter *f;
+	t_hsv_filter_row_func_t func;
+	struct xrt_frame *xf;
 };
 
 static void
-process_sample(struct t_hsv_filter *f,
-               uint8_t y,
-               uint8_t cb,
-               uint8_t cr,
-               uint8_t *dst0,
-               uint8_t *dst1,
-               uint8_t *dst2,
-               uint8_t *dst3)
+hsv_process_rows(struct t_hsv_filter *f,
+                 t_hsv_filter_row_func_t func,
+                 struct xrt_frame *xf,
+                 uint32_t y_start,
+                 uint32_t y_end)
 {
-	uint8_t bits = t_hsv_filter_sample(&f->table, y, cb, cr);
-	uint8_t v0 = (bits & (1 << 0)) ? 0xff : 0x00;
-	uint8_t v1 = (bits & (1 << 1)) ? 0xff : 0x00;
-	uint8_t v2 = (bits & (1 << 2)) ? 0xff : 0x00;
-	uint8_t v3 = (bits & (1 << 3)) ? 0xff : 0x00;
-
-	*dst0 = v0;
-	*dst1 = v1;
-	*dst2 = v2;
-	*dst3 = v3;
+	for (uint32_t y = y_start; y < y_end; y++) {
+		const uint8_t *src = (const uint8_t *)xf->data + y * xf->stride;
+		uint8_t *const dst[NUM_CHANNELS] = {
+		    f->frames[0]->data + y * f->frames[0]->stride,
+		    f->frames[1]->data + y * f->frames[1]->stride,
+		    f->frames[2]->data + y * f->frames[2]->stride,
+		    f->frames[3]->data + y * f->frames[3]->stride,
+		};
+
+		func(&f->table, src, dst, xf->width);
+	}
 }
 
-XRT_NO_INLINE static void
-hsv_process_frame_yuv(struct t_hsv_filter *f, struct xrt_frame *xf)
+static void
+hsv_band_task(void *ptr, uint32_t y_start, uint32_t y_end)
 {
 	SINK_TRACE_MARKER();
 
-	struct xrt_frame *f0 = f->frames[0];
-	struct xrt_frame *f1 = f->frames[1];
-	struct xrt_frame *f2 = f->frames[2];
-	struct xrt_frame *f3 = f->frames[3];
-
-	for (uint32_t y = 0; y < xf->height; y++) {
-		uint8_t *src = (uint8_t *)xf->data + y * xf->stride;
-		uint8_t *dst0 = f0->data + y * f0->stride;
-		uint8_t *dst1 = f1->data + y * f1->stride;
-		uint8_t *dst2 = f2->data + y * f2->stride;
-		uint8_t *dst3 = f3->data + y * f3->stride;
-
-		for (uint32_t x = 0; x < xf->width; x += 1) {
-			uint8_t y = src[0];
-			uint8_t cb = src[1];
-			uint8_t cr = src[2];
-			src += 3;
-
-			process_sample(f, y, cb, cr, dst0, dst1, dst2, dst3);
-			dst0 += 1;
-			dst1 += 1;
-			dst2 += 1;
-			dst3 += 1;
-		}
-	}
+	struct hsv_rows *rows = (struct hsv_rows *)ptr;
+	hsv_process_rows(rows->f, rows->func, rows->xf, y_start, y_end);
 }
 
+/*!
+ * Filters all rows of a frame, split into bands over the worker group if the
+ * filter has one. Returns once all rows have been filtered.
+ */
 XRT_NO_INLINE static void
-hsv_process_frame_yuyv(struct t_hsv_filter *f, struct xrt_frame *xf)
+hsv_process_frame(struct t_hsv_filter *f, t_hsv_filter_row_func_t func, struct xrt_frame *xf)
 {
 	SINK_TRACE_MARKER();
 
-	struct xrt_frame *f0 = f->frames[0];
-	struct xrt_frame *f1 = f->frames[1];
-	struct xrt_frame *f2 = f->frames[2];
-	struct xrt_frame *f3 = f->frames[3];
-
-	for (uint32_t y = 0; y < xf->height; y++) {
-		uint8_t *src = (uint8_t *)xf->data + y * xf->stride;
-		uint8_t *dst0 = f0->data + y * f0->stride;
-		uint8_t *dst1 = f1->data + y * f1->stride;
-		uint8_t *dst2 = f2->data + y * f2->stride;
-		uint8_t *dst3 = f3->data + y * f3->stride;
-
-		for (uint32_t x = 0; x < xf->width; x += 2) {
-			uint8_t y1 = src[0];
-			uint8_t cb = src[1];
-			uint8_t y2 = src[2];
-			uint8_t cr = src[3];
-			src += 4;
-
-			uint8_t bits0 = t_hsv_filter_sample(&f->table, y1, cb, cr);
-			uint8_t bits1 = t_hsv_filter_sample(&f->table, y2, cb, cr);
-
-			uint8_t v0 = (bits0 & (1 << 0)) ? 0xff : 0x00;
-			uint8_t v1 = (bits0 & (1 << 1)) ? 0xff : 0x00;
-			uint8_t v2 = (bits0 & (1 << 2)) ? 0xff : 0x00;
-			uint8_t v3 = (bits0 & (1 << 3)) ? 0xff : 0x00;
-			uint8_t v4 = (bits1 & (1 << 0)) ? 0xff : 0x00;
-			uint8_t v5 = (bits1 & (1 << 1)) ? 0xff : 0x00;
-			uint8_t v6 = (bits1 & (1 << 2)) ? 0xff : 0x00;
-			uint8_t v7 = (bits1 & (1 << 3)) ? 0xff : 0x00;
-
-			*(uint16_t *)dst0 = v0 | v4 << 8;
-			*(uint16_t *)dst1 = v1 | v5 << 8;
-			*(uint16_t *)dst2 = v2 | v6 << 8;
-			*(uint16_t *)dst3 = v3 | v7 << 8;
-
-			dst0 += 2;
-			dst1 += 2;
-			dst2 += 2;
-			dst3 += 2;
-		}
-	}
+	struct hsv_rows rows = {f, func, xf};
+	u_worker_group_for_bands(f->group, xf->height, f->band_count, MIN_BAND_ROWS, hsv_band_task, &rows);
 }
 
 static void
@@ -291,11 +257,11 @@ hsv_frame(struct xrt_frame_sink *xsink, struct xrt_frame *xf)
 	switch (xf->format) {
 	case XRT_FORMAT_YUV888:
 		ensure_buf_allocated(f, xf);
-		hsv_process_frame_yuv(f, xf);
+		hsv_process_frame(f, f->funcs->yuv888, xf);
 		break;
 	case XRT_FORMAT_YUYV422:
 		ensure_buf_allocated(f, xf);
-		hsv_process_frame_yuyv(f, xf);
+		hsv_process_frame(f, f->funcs->yuyv422, xf);
 		break;
 	default: U_LOG_E("Bad format '%s'", u_format_str(xf->format)); return;
 	}
@@ -321,14 +287,32 @@ hsv_destroy(struct xrt_frame_node *node)
 		u_sink_debug_destroy(&f->usds[i]);
 	}
 
+	u_worker_group_reference(&f->group, NULL);
+
 	free(f);
 }
 
+uint32_t
+t_hsv_filter_get_band_count(void)
+{
+	return (uint32_t)CLAMP(debug_get_num_option_band_count(), 1, U_WORKER_MAX_BANDS);
+}
+
 int
 t_hsv_filter_create(struct xrt_frame_context *xfctx,
                     struct t_hsv_filter_params *params,
                     struct xrt_frame_sink *sinks[4],
                     struct xrt_frame_sink **out_sink)
+{
+	return t_hsv_filter_create_threaded(xfctx, params, NULL, sinks, out_sink);
+}
+
+int
+t_hsv_filter_create_threaded(struct xrt_frame_context *xfctx,
+                             struct t_hsv_filter_params *params,
+                             struct u_worker_thread_pool *uwtp,
+                             struct xrt_frame_sink *sinks[4],
+                             struct xrt_frame_sink **out_sink)
 {
 	struct t_hsv_filter *f = U_TYPED_CALLOC(struct t_hsv_filter);
 	f->base.push_frame = hsv_frame;
@@ -341,6 +325,12 @@ t_hsv_filter_create(struct xrt_frame_context *xfctx,
 	f->sinks[3] = sinks[3];
 
 	t_hsv_build_optimized_table(&f->params, &f->table);
+	f->funcs = t_hsv_filter_get_best();
+
+	if (uwtp != NULL) {
+		f->group = u_worker_group_create(uwtp);
+		f->band_count = (uint32_t)t_hsv_filter_get_band_count();
+	}
 
 	xrt_frame_context_add(xfctx, &f->node);
 
@@ -348,6 +338,7 @@ t_hsv_filter_create(struct xrt_frame_context *xfctx,
 		u_sink_debug_init(&f->usds[i]);
 	}
 	u_var_add_root(f, "HSV Filter", true);
+	u_var_add_ro_u32(f, &f->band_count, "Row bands");
 	u_var_add_sink_debug(f, &f->usds[0], "Red");
 	u_var_add_sink_debug(f, &f->usds[1], "Purple");
 	u_var_add_sink_debug(f, &f->usds[2], "Blue");
@@ -0,0 +1,344 @@
+// Copyright 2019-2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Row kernels for the HSV filter.
+ * @author Jakob Bornecrantz <jakob@collabora.com>
+ * @ingroup aux_tracking
+ *
+ * The scalar kernels are the reference, the SIMD kernels process blocks of
+ * pixels and hand the remainder of the row to the scalar ones.
+ *
+ * The optimized table is 32KiB, too big for any byte shuffle, so each block
+ * does one plain table load per pixel. Everything around that is vectorized:
+ * the table indices are computed for the whole block at once and the looked up
+ * bits are expanded into the four output planes with compares, sixteen bytes
+ * per store, instead of four byte stores per pixel.
+ */
+
+#include "xrt/xrt_compiler.h"
+
+#include "util/u_debug.h"
+
+#include "tracking/t_tracking.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+#define HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+
+DEBUG_GET_ONCE_BOOL_OPTION(force_scalar, "T_HSV_FILTER_FORCE_SCALAR", false)
+
+//! Pixels handled by one block of the SIMD kernels.
+#define BLOCK_SIZE (16)
+
+
+/*
+ *
+ * Scalar reference kernels.
+ *
+ */
+
+static inline uint32_t
+table_index(uint32_t y, uint32_t u, uint32_t v)
+{
+	return ((y / T_HSV_STEP) * T_HSV_SIZE + (u / T_HSV_STEP)) * T_HSV_SIZE + (v / T_HSV_STEP);
+}
+
+static inline const uint8_t *
+table_data(const struct t_hsv_filter_optimized_table *t)
+{
+	return &t->v[0][0][0];
+}
+
+static inline void
+write_bits(uint8_t bits, uint8_t *const dst[4], uint32_t x)
+{
+	dst[0][x] = (bits & (1 << 0)) ? 0xff : 0x00;
+	dst[1][x] = (bits & (1 << 1)) ? 0xff : 0x00;
+	dst[2][x] = (bits & (1 << 2)) ? 0xff : 0x00;
+	dst[3][x] = (bits & (1 << 3)) ? 0xff : 0x00;
+}
+
+static void
+scalar_yuv888(const struct t_hsv_filter_optimized_table *t, const uint8_t *src, uint8_t *const dst[4], uint32_t w)
+{
+	const uint8_t *table = table_data(t);
+
+	for (uint32_t x = 0; x < w; x++) {
+		write_bits(table[table_index(src[0], src[1], src[2])], dst, x);
+		src += 3;
+	}
+}
+
+static void
+scalar_yuyv422(const struct t_hsv_filter_optimized_table *t, const uint8_t *src, uint8_t *const dst[4], uint32_t w)
+{
+	const uint8_t *table = table_data(t);
+
+	for (uint32_t x = 0; x < w; x += 2) {
+		write_bits(table[table_index(src[0], src[1], src[3])], dst, x + 0);
+		write_bits(table[table_index(src[2], src[1], src[3])], dst, x + 1);
+		src += 4;
+	}
+}
+
+//! Hands the rest of the row, starting at pixel @p x, to a scalar kernel.
+static inline void
+scalar_tail(t_hsv_filter_row_func_t func,
+            const struct t_hsv_filter_optimized_table *t,
+            const uint8_t *src,
+            uint8_t *const dst[4],
+            uint32_t x,
+            uint32_t w)
+{
+	if (x >= w) {
+		return;
+	}
+
+	uint8_t *const rest[4] = {dst[0] + x, dst[1] + x, dst[2] + x, dst[3] + x};
+	func(t, src, rest, w - x);
+}
+
+static inline void
+lookup_block(const uint8_t *table, const uint16_t idx[BLOCK_SIZE], uint8_t bits[BLOCK_SIZE])
+{
+	for (int i = 0; i < BLOCK_SIZE; i++) {
+		bits[i] = table[idx[i]];
+	}
+}
+
+static const struct t_hsv_filter_funcs scalar_funcs = {
+    .impl = T_HSV_FILTER_IMPL_SCALAR,
+    .yuv888 = scalar_yuv888,
+    .yuyv422 = scalar_yuyv422,
+};
+
+
+/*
+ *
+ * SSE2 kernels, 16 pixels at a time.
+ *
+ */
+
+#ifdef HAVE_SSE2
+
+//! Writes one byte per pixel and channel, 0xff if the channel bit is set.
+static inline void
+sse2_expand(const uint8_t bits[BLOCK_SIZE], uint8_t *const dst[4], uint32_t x)
+{
+	__m128i b = _mm_loadu_si128((const __m128i *)bits);
+
+	for (int i = 0; i < 4; i++) {
+		__m128i m = _mm_set1_epi8((char)(1 << i));
+		_mm_storeu_si128((__m128i *)(dst[i] + x), _mm_cmpeq_epi8(_mm_and_si128(b, m), m));
+	}
+}
+
+//! Table indices of the 8 pixels in 16 bytes of YUYV.
+static inline __m128i
+sse2_yuyv_index(__m128i in)
+{
+	const __m128i mask = _mm_set1_epi16(0x00f8);
+
+	__m128i y = _mm_and_si128(in, mask);
+	__m128i c = _mm_and_si128(_mm_srli_epi16(in, 8), mask);
+
+	// Each pair of pixels share the chroma, copy it to both lanes.
+	__m128i u = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+	__m128i v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+
+	// With the low bits masked off, (y / 8) << 10 is y << 7 and so on.
+	__m128i idx = _mm_or_si128(_mm_slli_epi16(y, 7), _mm_slli_epi16(u, 2));
+	return _mm_or_si128(idx, _mm_srli_epi16(v, 3));
+}
+
+static void
+sse2_yuv888(const struct t_hsv_filter_optimized_table *t, const uint8_t *src, uint8_t *const dst[4], uint32_t w)
+{
+	const uint8_t *table = table_data(t);
+	uint8_t bits[BLOCK_SIZE];
+
+	// SSE2 has no byte shuffle, deinterleaving the planes costs more than
+	// computing the indices one by one.
+	uint32_t x = 0;
+	for (; x + BLOCK_SIZE <= w; x += BLOCK_SIZE) {
+		const uint8_t *in = src + (x * 3);
+		for (int i = 0; i < BLOCK_SIZE; i++) {
+			bits[i] = table[table_index(in[i * 3 + 0], in[i * 3 + 1], in[i * 3 + 2])];
+		}
+
+		sse2_expand(bits, dst, x);
+	}
+
+	scalar_tail(scalar_yuv888, t, src + (x * 3), dst, x, w);
+}
+
+static void
+sse2_yuyv422(const struct t_hsv_filter_optimized_table *t, const uint8_t *src, uint8_t *const dst[4], uint32_t w)
+{
+	const uint8_t *table = table_data(t);
+	uint16_t idx[BLOCK_SIZE];
+	uint8_t bits[BLOCK_SIZE];
+
+	uint32_t x = 0;
+	for (; x + BLOCK_SIZE <= w; x += BLOCK_SIZE) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + (x * 2)));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + (x * 2) + 16));
+		_mm_storeu_si128((__m128i *)&idx[0], sse2_yuyv_index(a));
+		_mm_storeu_si128((__m128i *)&idx[8], sse2_yuyv_index(b));
+
+		lookup_block(table, idx, bits);
+		sse2_expand(bits, dst, x);
+	}
+
+	scalar_tail(scalar_yuyv422, t, src + (x * 2), dst, x, w);
+}
+
+static const struct t_hsv_filter_funcs sse2_funcs = {
+    .impl = T_HSV_FILTER_IMPL_SSE2,
+    .yuv888 = sse2_yuv888,
+    .yuyv422 = sse2_yuyv422,
+};
+
+#endif
+
+
+/*
+ *
+ * NEON kernels, 16 pixels at a time.
+ *
+ */
+
+#ifdef HAVE_NEON
+
+static inline void
+neon_expand(const uint8_t bits[BLOCK_SIZE], uint8_t *const dst[4], uint32_t x)
+{
+	uint8x16_t b = vld1q_u8(bits);
+
+	// The test instruction gives 0xff for every lane with any bit in common.
+	vst1q_u8(dst[0] + x, vtstq_u8(b, vdupq_n_u8(1 << 0)));
+	vst1q_u8(dst[1] + x, vtstq_u8(b, vdupq_n_u8(1 << 1)));
+	vst1q_u8(dst[2] + x, vtstq_u8(b, vdupq_n_u8(1 << 2)));
+	vst1q_u8(dst[3] + x, vtstq_u8(b, vdupq_n_u8(1 << 3)));
+}
+
+//! Table indices of 8 pixels.
+static inline uint16x8_t
+neon_index(uint8x8_t y, uint8x8_t u, uint8x8_t v)
+{
+	uint16x8_t iy = vshlq_n_u16(vmovl_u8(vshr_n_u8(y, 3)), 10);
+	uint16x8_t iu = vshlq_n_u16(vmovl_u8(vshr_n_u8(u, 3)), 5);
+	uint16x8_t iv = vmovl_u8(vshr_n_u8(v, 3));
+	return vorrq_u16(vorrq_u16(iy, iu), iv);
+}
+
+static void
+neon_yuv888(const struct t_hsv_filter_optimized_table *t, const uint8_t *src, uint8_t *const dst[4], uint32_t w)
+{
+	const uint8_t *table = table_data(t);
+	uint16_t idx[BLOCK_SIZE];
+	uint8_t bits[BLOCK_SIZE];
+
+	uint32_t x = 0;
+	for (; x + BLOCK_SIZE <= w; x += BLOCK_SIZE) {
+		uint8x16x3_t in = vld3q_u8(src + (x * 3));
+		vst1q_u16(&idx[0], neon_index(vget_low_u8(in.val[0]), vget_low_u8(in.val[1]), vget_low_u8(in.val[2])));
+		vst1q_u16(&idx[8],
+		          neon_index(vget_high_u8(in.val[0]), vget_high_u8(in.val[1]), vget_high_u8(in.val[2])));
+
+		lookup_block(table, idx, bits);
+		neon_expand(bits, dst, x);
+	}
+
+	scalar_tail(scalar_yuv888, t, src + (x * 3), dst, x, w);
+}
+
+static void
+neon_yuyv422(const struct t_hsv_filter_optimized_table *t, const uint8_t *src, uint8_t *const dst[4], uint32_t w)
+{
+	const uint8_t *table = table_data(t);
+	uint16_t idx[BLOCK_SIZE];
+	uint8_t bits[BLOCK_SIZE];
+
+	uint32_t x = 0;
+	for (; x + BLOCK_SIZE <= w; x += BLOCK_SIZE) {
+		// Y0, U, Y1, V for eight pairs of pixels.
+		uint8x8x4_t in = vld4_u8(src + (x * 2));
+
+		// The interleaving store puts the indices back in pixel order.
+		uint16x8x2_t pairs;
+		pairs.val[0] = neon_index(in.val[0], in.val[1], in.val[3]);
+		pairs.val[1] = neon_index(in.val[2], in.val[1], in.val[3]);
+		vst2q_u16(idx, pairs);
+
+		lookup_block(table, idx, bits);
+		neon_expand(bits, dst, x);
+	}
+
+	scalar_tail(scalar_yuyv422, t, src + (x * 2), dst, x, w);
+}
+
+static const struct t_hsv_filter_funcs neon_funcs = {
+    .impl = T_HSV_FILTER_IMPL_NEON,
+    .yuv888 = neon_yuv888,
+    .yuyv422 = neon_yuyv422,
+};
+
+#endif
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+const struct t_hsv_filter_funcs *
+t_hsv_filter_get_funcs(enum t_hsv_filter_impl impl)
+{
+	switch (impl) {
+	case T_HSV_FILTER_IMPL_SCALAR: return &scalar_funcs;
+#ifdef HAVE_SSE2
+	case T_HSV_FILTER_IMPL_SSE2: return &sse2_funcs;
+#endif
+#ifdef HAVE_NEON
+	case T_HSV_FILTER_IMPL_NEON: return &neon_funcs;
+#endif
+	default: return NULL;
+	}
+}
+
+const struct t_hsv_filter_funcs *
+t_hsv_filter_get_best(void)
+{
+	if (debug_get_bool_option_force_scalar()) {
+		return &scalar_funcs;
+	}
+
+#if defined(HAVE_NEON)
+	return &neon_funcs;
+#elif defined(HAVE_SSE2)
+	return &sse2_funcs;
+#else
+	return &scalar_funcs;
+#endif
+}
+
+const char *
+t_hsv_filter_impl_str(enum t_hsv_filter_impl impl)
+{
+	switch (impl) {
+	case T_HSV_FILTER_IMPL_SCALAR: return "SCALAR";
+	case T_HSV_FILTER_IMPL_SSE2: return "SSE2";
+	case T_HSV_FILTER_IMPL_NEON: return "NEON";
+	default: return "UNKNOWN";
+	}
+}
@@ -390,7 +390,7 @@ struct TrackerSlam
 		//! Increasing it smooths out the tracking at the cost of adding delay.
 		double window = 66;
 		struct m_ff_vec3_f32 *pos_ff; //! Predicted positions fifo
-		struct m_ff_vec3_f32 *rot_ff; //! Predicted rotations fifo (only xyz components, w is inferred)
+		struct m_ff_quat_f32 *rot_ff; //! Predicted rotations fifo
 
 		// Exponential smoothing filter
 		bool use_exponential_smoothing_filter = false;
@@ -906,27 +906,19 @@ filter_pose(TrackerSlam &t, timepoint_ns when_ns, struct xrt_space_relation *out
 		}
 
 		if (out_relation->relation_flags & XRT_SPACE_RELATION_ORIENTATION_VALID_BIT) {
-			// Don't save w component as we can retrieve it knowing these are (almost) unit quaternions
-			xrt_vec3 rot = {out_relation->pose.orientation.x, out_relation->pose.orientation.y,
-			                out_relation->pose.orientation.z};
-			m_ff_vec3_f32_push(t.filter.rot_ff, &rot, when_ns);
+			xrt_quat rot = out_relation->pose.orientation;
+			m_ff_quat_f32_push(t.filter.rot_ff, &rot, when_ns);
 		}
 
 		// Get averages in time window
 		timepoint_ns window = t.filter.window * U_TIME_1MS_IN_NS;
 		xrt_vec3 avg_pos;
 		m_ff_vec3_f32_filter(t.filter.pos_ff, when_ns - window, when_ns, &avg_pos);
-		xrt_vec3 avg_rot; // Naive but good enough rotation average
-		m_ff_vec3_f32_filter(t.filter.rot_ff, when_ns - window, when_ns, &avg_rot);
+		xrt_quat avg_rot;
+		m_ff_quat_f32_filter(t.filter.rot_ff, when_ns - window, when_ns, &avg_rot);
 
-		// Considering the naive averaging this W is a bit wrong, but it feels reasonably well
-		float avg_rot_w = sqrtf(1 - (avg_rot.x * avg_rot.x + avg_rot.y * avg_rot.y + avg_rot.z * avg_rot.z));
-		out_relation->pose.orientation = xrt_quat{avg_rot.x, avg_rot.y, avg_rot.z, avg_rot_w};
+		out_relation->pose.orientation = avg_rot;
 		out_relation->pose.position = avg_pos;
-
-		//! @todo Implement the quaternion averaging with a m_ff_vec4_f32 and
-		//! normalization. Although it would be best to have a way of generalizing
-		//! types before so as to not have redundant copies of ff logic.
 	}
 
 	if (t.filter.use_exponential_smoothing_filter) {
@@ -959,7 +951,7 @@ setup_ui(TrackerSlam &t)
 	m_ff_vec3_f32_alloc(&t.gyro_ff, 1000);
 	m_ff_vec3_f32_alloc(&t.accel_ff, 1000);
 	m_ff_vec3_f32_alloc(&t.filter.pos_ff, 1000);
-	m_ff_vec3_f32_alloc(&t.filter.rot_ff, 1000);
+	m_ff_quat_f32_alloc(&t.filter.rot_ff, 1000);
 
 	u_var_add_root(&t, "SLAM Tracker", true);
 	u_var_add_log_level(&t, &t.log_level, "Log Level");
@@ -1236,7 +1228,7 @@ t_slam_node_destroy(struct xrt_frame_node *node)
 	m_ff_vec3_f32_free(&t.gyro_ff);
 	m_ff_vec3_f32_free(&t.accel_ff);
 	m_ff_vec3_f32_free(&t.filter.pos_ff);
-	m_ff_vec3_f32_free(&t.filter.rot_ff);
+	m_ff_quat_f32_free(&t.filter.rot_ff);
 	delete t_ptr->slam;
 	delete t_ptr->cv_wrapper;
 	delete t_ptr;
@@ -40,6 +40,7 @@ struct xrt_slam_sinks;
 struct xrt_tracked_psmv;
 struct xrt_tracked_psvr;
 struct xrt_tracked_slam;
+struct u_worker_thread_pool;
 
 
 /*
@@ -371,6 +372,60 @@ t_hsv_filter_sample(struct t_hsv_filter_optimized_table *t, uint32_t y, uint32_t
 	return t->v[y / T_HSV_STEP][u / T_HSV_STEP][v / T_HSV_STEP];
 }
 
+/*!
+ * The different implementations of the filter row kernels, the scalar one is
+ * always available and is the reference all others must match bit for bit.
+ */
+enum t_hsv_filter_impl
+{
+	T_HSV_FILTER_IMPL_SCALAR,
+	T_HSV_FILTER_IMPL_SSE2,
+	T_HSV_FILTER_IMPL_NEON,
+	T_HSV_FILTER_IMPL_COUNT,
+};
+
+/*!
+ * Filters @p w pixels of one row from @p src, writing one L8 row per channel
+ * to @p dst, 0xff where the pixel matched the channel and 0x00 otherwise.
+ */
+typedef void (*t_hsv_filter_row_func_t)(const struct t_hsv_filter_optimized_table *t,
+                                        const uint8_t *src,
+                                        uint8_t *const dst[4],
+                                        uint32_t w);
+
+/*!
+ * A set of filter row kernels, all produced by the same implementation.
+ */
+struct t_hsv_filter_funcs
+{
+	enum t_hsv_filter_impl impl;
+
+	t_hsv_filter_row_func_t yuv888;
+
+	//! @p w must be even.
+	t_hsv_filter_row_func_t yuyv422;
+};
+
+/*!
+ * Returns the kernels of the given implementation, or NULL if it was not
+ * built for this CPU.
+ */
+const struct t_hsv_filter_funcs *
+t_hsv_filter_get_funcs(enum t_hsv_filter_impl impl);
+
+/*!
+ * Returns the fastest kernels, the scalar ones can be forced with the
+ * `T_HSV_FILTER_FORCE_SCALAR` environment variable.
+ */
+const struct t_hsv_filter_funcs *
+t_hsv_filter_get_best(void);
+
+/*!
+ * Return string for this implementation.
+ */
+const char *
+t_hsv_filter_impl_str(enum t_hsv_filter_impl impl);
+
 /*!
  * Construct an HSV filter sink.
  * @public @memberof t_hsv_filter
@@ -383,6 +438,28 @@ t_hsv_filter_create(struct xrt_frame_context *xfctx,
                     struct xrt_frame_sink *sinks[4],
                     struct xrt_frame_sink **out_sink);
 
+/*!
+ * How many row bands @ref t_hsv_filter_create_threaded splits each frame
+ * into, set with the `T_HSV_FILTER_BANDS` environment variable. If this is one
+ * there is no point in creating a thread pool for the filter.
+ */
+uint32_t
+t_hsv_filter_get_band_count(void);
+
+/*!
+ * Construct an HSV filter sink that splits each frame into row bands which
+ * are filtered in parallel on the given thread pool, @p uwtp may be NULL.
+ * @public @memberof t_hsv_filter
+ *
+ * @see xrt_frame_context
+ */
+int
+t_hsv_filter_create_threaded(struct xrt_frame_context *xfctx,
+                             struct t_hsv_filter_params *params,
+                             struct u_worker_thread_pool *uwtp,
+                             struct xrt_frame_sink *sinks[4],
+                             struct xrt_frame_sink **out_sink);
+
 
 /*
  *
@@ -1,4 +1,4 @@
-// Copyright 2019-2021, Collabora, Ltd.
+// Copyright 2019-2022, Collabora, Ltd.
 // SPDX-License-Identifier: BSL-1.0
 /*!
  * @file
@@ -8,20 +8,49 @@
  * @ingroup aux_distortion
  */
 
+#include "xrt/xrt_config_os.h"
+
+#include "os/os_time.h"
+
 #include "util/u_misc.h"
+#include "util/u_file.h"
+#include "util/u_time.h"
 #include "util/u_frame.h"
 #include "util/u_debug.h"
 #include "util/u_format.h"
+#include "util/u_worker.h"
+#include "util/u_logging.h"
 #include "util/u_distortion_mesh.h"
 
 #include "math/m_vec2.h"
 #include "math/m_api.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
+#include <inttypes.h>
+
+#ifdef XRT_OS_LINUX
+#include <unistd.h>
+#define HAVE_GRID_CACHE
+#endif
 
 
 DEBUG_GET_ONCE_NUM_OPTION(mesh_size, "XRT_MESH_SIZE", 64)
+DEBUG_GET_ONCE_NUM_OPTION(mesh_threads, "XRT_MESH_THREADS", 4)
+DEBUG_GET_ONCE_BOOL_OPTION(mesh_cache, "XRT_MESH_CACHE", false)
+
+//! Don't bother splitting up bands smaller than this.
+#define MIN_BAND_ROWS (4)
+
+//! Grids smaller than this are quicker to evaluate than to load.
+#define MIN_CACHED_SAMPLES (1024)
+
+//! Points per side of the grid sampled to fingerprint the distortion.
+#define FINGERPRINT_SIZE (9)
+
+//! Bump when the layout or the sampling of the cached grids change.
+#define CACHE_MAGIC "XRTGRID1"
 
 
 typedef bool (*func_calc)(struct xrt_device *xdev, int view, float u, float v, struct xrt_uv_triplet *result);
@@ -32,8 +61,295 @@ index_for(int row, int col, uint32_t stride, uint32_t offset)
 	return row * stride + col + offset;
 }
 
+
+
+/*
+ *
+ * Grid sampling.
+ *
+ */
+
+/*!
+ * A grid being evaluated, shared by all row bands.
+ */
+struct grid_args
+{
+	struct xrt_device *xdev;
+	func_calc calc;
+	int view;
+	uint32_t cols;
+	uint32_t rows;
+	const struct xrt_matrix_2x2 *rot;
+	struct xrt_uv_triplet *out;
+
+	//! Not zero if the distortion function failed for any sample.
+	xrt_atomic_s32_t failed;
+};
+
+static inline struct xrt_vec2
+grid_uv(const struct xrt_matrix_2x2 *rot, uint32_t col, uint32_t row, uint32_t cols, uint32_t rows)
+{
+	// These go from 0 to 1.0 inclusive.
+	struct xrt_vec2 uv = {
+	    (float)col / (float)(cols - 1),
+	    (float)row / (float)(rows - 1),
+	};
+
+	if (rot == NULL) {
+		return uv;
+	}
+
+	// These need to go from -0.5 to 0.5 for the rotation
+	uv.x -= 0.5f;
+	uv.y -= 0.5f;
+	math_matrix_2x2_transform_vec2(rot, &uv, &uv);
+	uv.x += 0.5f;
+	uv.y += 0.5f;
+
+	return uv;
+}
+
+static void
+grid_band_task(void *ptr, uint32_t row_start, uint32_t row_end)
+{
+	struct grid_args *a = (struct grid_args *)ptr;
+
+	for (uint32_t r = row_start; r < row_end; r++) {
+		for (uint32_t c = 0; c < a->cols; c++) {
+			struct xrt_vec2 uv = grid_uv(a->rot, c, r, a->cols, a->rows);
+			if (!a->calc(a->xdev, a->view, uv.x, uv.y, &a->out[r * a->cols + c])) {
+				xrt_atomic_s32_inc_return(&a->failed);
+				return;
+			}
+		}
+	}
+}
+
+/*!
+ * Evaluates all samples of the grid, split into row bands over @p uwg if it is
+ * not NULL.
+ */
+static bool
+evaluate_grid(struct xrt_device *xdev,
+              func_calc calc,
+              int view,
+              uint32_t cols,
+              uint32_t rows,
+              const struct xrt_matrix_2x2 *rot,
+              struct u_worker_group *uwg,
+              struct xrt_uv_triplet *out)
+{
+	// A couple of bands per thread evens out rows that take longer.
+	uint32_t band_count = (uint32_t)CLAMP(debug_get_num_option_mesh_threads(), 1, U_WORKER_MAX_BANDS) * 2;
+
+	struct grid_args args = {xdev, calc, view, cols, rows, rot, out, 0};
+	u_worker_group_for_bands(uwg, rows, band_count, MIN_BAND_ROWS, grid_band_task, &args);
+
+	return args.failed == 0;
+}
+
+
+/*
+ *
+ * Grid cache.
+ *
+ */
+
+#ifdef HAVE_GRID_CACHE
+
+struct grid_cache_header
+{
+	char magic[8];
+	uint64_t key;
+	uint32_t cols;
+	uint32_t rows;
+};
+
+static uint64_t
+fnv1a(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/*!
+ * The device interface has no way to get at the distortion parameters, so the
+ * key is made from the device names, the grid layout and the distortion
+ * function sampled over a coarse grid. Any change to the parameters that
+ * changes the output will change the samples too.
+ */
+static bool
+make_cache_key(struct xrt_device *xdev,
+               func_calc calc,
+               int view,
+               uint32_t cols,
+               uint32_t rows,
+               const struct xrt_matrix_2x2 *rot,
+               uint64_t *out_key)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	hash = fnv1a(hash, CACHE_MAGIC, strlen(CACHE_MAGIC));
+	hash = fnv1a(hash, xdev->str, strnlen(xdev->str, sizeof(xdev->str)));
+	hash = fnv1a(hash, xdev->serial, strnlen(xdev->serial, sizeof(xdev->serial)));
+	hash = fnv1a(hash, &view, sizeof(view));
+	hash = fnv1a(hash, &cols, sizeof(cols));
+	hash = fnv1a(hash, &rows, sizeof(rows));
+
+	bool rotated = rot != NULL;
+	hash = fnv1a(hash, &rotated, sizeof(rotated));
+	if (rotated) {
+		hash = fnv1a(hash, rot->v, sizeof(rot->v));
+	}
+
+	for (uint32_t r = 0; r < FINGERPRINT_SIZE; r++) {
+		for (uint32_t c = 0; c < FINGERPRINT_SIZE; c++) {
+			struct xrt_vec2 uv = grid_uv(NULL, c, r, FINGERPRINT_SIZE, FINGERPRINT_SIZE);
+			struct xrt_uv_triplet sample;
+			if (!calc(xdev, view, uv.x, uv.y, &sample)) {
+				return false;
+			}
+			hash = fnv1a(hash, &sample, sizeof(sample));
+		}
+	}
+
+	*out_key = hash;
+
+	return true;
+}
+
+static void
+cache_filename(uint64_t key, char *out, size_t size)
+{
+	snprintf(out, size, "distortion_%016" PRIx64 ".bin", key);
+}
+
+static bool
+load_grid(uint64_t key, uint32_t cols, uint32_t rows, struct xrt_uv_triplet *out)
+{
+	char filename[64];
+	cache_filename(key, filename, sizeof(filename));
+
+	FILE *file = u_file_open_file_in_cache_dir(filename, "rb");
+	if (file == NULL) {
+		return false;
+	}
+
+	struct grid_cache_header header;
+	size_t count = (size_t)cols * rows;
+	bool ret = fread(&header, sizeof(header), 1, file) == 1 &&            //
+	           memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) == 0 && //
+	           header.key == key &&                                          //
+	           header.cols == cols &&                                        //
+	           header.rows == rows &&                                        //
+	           fread(out, sizeof(*out), count, file) == count;
+
+	fclose(file);
+
+	return ret;
+}
+
 static void
-run_func(struct xrt_device *xdev, func_calc calc, int view_count, struct xrt_hmd_parts *target, uint32_t num)
+store_grid(uint64_t key, uint32_t cols, uint32_t rows, const struct xrt_uv_triplet *out)
+{
+	char dir[1024];
+	if (u_file_get_cache_dir(dir, sizeof(dir)) <= 0) {
+		return;
+	}
+
+	char filename[64];
+	char tmp_filename[96];
+	cache_filename(key, filename, sizeof(filename));
+	snprintf(tmp_filename, sizeof(tmp_filename), "%s.%d.tmp", filename, (int)getpid());
+
+	FILE *file = u_file_open_file_in_cache_dir(tmp_filename, "wb");
+	if (file == NULL) {
+		return;
+	}
+
+	struct grid_cache_header header = {{0}, key, cols, rows};
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+
+	size_t count = (size_t)cols * rows;
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 && //
+	               fwrite(out, sizeof(*out), count, file) == count;
+	written &= fclose(file) == 0;
+
+	char tmp_path[1200];
+	char path[1200];
+	snprintf(tmp_path, sizeof(tmp_path), "%s/%s", dir, tmp_filename);
+	snprintf(path, sizeof(path), "%s/%s", dir, filename);
+
+	// Renaming is atomic, other processes never see a partial file.
+	if (!written || rename(tmp_path, path) != 0) {
+		U_LOG_W("Failed to write distortion cache '%s'", path);
+		remove(tmp_path);
+	}
+}
+
+#endif
+
+static bool
+sample_grid(struct xrt_device *xdev,
+            func_calc calc,
+            int view,
+            uint32_t cols,
+            uint32_t rows,
+            const struct xrt_matrix_2x2 *rot,
+            struct u_worker_group *uwg,
+            struct xrt_uv_triplet *out)
+{
+	assert(cols >= 2 && rows >= 2);
+
+	uint64_t start_ns = os_monotonic_get_ns();
+
+#ifdef HAVE_GRID_CACHE
+	uint64_t key = 0;
+	bool use_cache = debug_get_bool_option_mesh_cache() &&         //
+	                 (size_t)cols * rows >= MIN_CACHED_SAMPLES && //
+	                 make_cache_key(xdev, calc, view, cols, rows, rot, &key);
+
+	if (use_cache && load_grid(key, cols, rows, out)) {
+		U_LOG_D("Loaded %ux%u distortion grid for view %i from cache in %.2fms", cols, rows, view,
+		        time_ns_to_ms_f((time_duration_ns)(os_monotonic_get_ns() - start_ns)));
+		return true;
+	}
+#endif
+
+	if (!evaluate_grid(xdev, calc, view, cols, rows, rot, uwg, out)) {
+		return false;
+	}
+
+	U_LOG_D("Computed %ux%u distortion grid for view %i in %.2fms", cols, rows, view,
+	        time_ns_to_ms_f((time_duration_ns)(os_monotonic_get_ns() - start_ns)));
+
+#ifdef HAVE_GRID_CACHE
+	if (use_cache) {
+		store_grid(key, cols, rows, out);
+	}
+#endif
+
+	return true;
+}
+
+
+/*
+ *
+ * Mesh generation.
+ *
+ */
+
+static void
+run_func(struct xrt_device *xdev,
+         func_calc calc,
+         int view_count,
+         struct xrt_hmd_parts *target,
+         uint32_t num,
+         struct u_worker_group *uwg)
 {
 	assert(calc != NULL);
 	assert(view_count == 2);
@@ -55,12 +371,21 @@ run_func(struct xrt_device *xdev, func_calc calc, int view_count, struct xrt_hmd
 	uint32_t float_count = vertex_count * stride_in_floats;
 
 	float *verts = U_TYPED_ARRAY_CALLOC(float, float_count);
+	struct xrt_uv_triplet *grid = U_TYPED_ARRAY_CALLOC(struct xrt_uv_triplet, vertex_count_per_view);
 
 	// Setup the vertices for all views.
 	uint32_t i = 0;
 	for (int view = 0; view < view_count; view++) {
 		vertex_offsets[view] = i / stride_in_floats;
 
+		if (!sample_grid(xdev, calc, view, vert_cols, vert_rows, NULL, uwg, grid)) {
+			// bail on error, without updating
+			// distortion.preferred
+			free(grid);
+			free(verts);
+			return;
+		}
+
 		for (uint32_t r = 0; r < vert_rows; r++) {
 			// This goes from 0 to 1.0 inclusive.
 			float v = (float)r / (float)cells_rows;
@@ -73,17 +398,15 @@ run_func(struct xrt_device *xdev, func_calc calc, int view_count, struct xrt_hmd
 				verts[i + 0] = u * 2.0f - 1.0f;
 				verts[i + 1] = v * 2.0f - 1.0f;
 
-				if (!calc(xdev, view, u, v, (struct xrt_uv_triplet *)&verts[i + 2])) {
-					// bail on error, without updating
-					// distortion.preferred
-					return;
-				}
+				memcpy(&verts[i + 2], &grid[r * vert_cols + c], sizeof(*grid));
 
 				i += stride_in_floats;
 			}
 		}
 	}
 
+	free(grid);
+
 	uint32_t index_count_per_view = cells_rows * (vert_cols * 2 + 2);
 	uint32_t index_count_total = index_count_per_view * view_count;
 	int *indices = U_TYPED_ARRAY_CALLOC(int, index_count_total);
@@ -417,7 +740,7 @@ u_distortion_mesh_fill_in_none(struct xrt_device *xdev)
 	struct xrt_hmd_parts *target = xdev->hmd;
 
 	// Do the generation.
-	run_func(xdev, u_distortion_mesh_none, 2, target, 1);
+	run_func(xdev, u_distortion_mesh_none, 2, target, 1, NULL);
 
 	// Make the target mostly usable.
 	target->distortion.models |= XRT_DISTORTION_MODEL_NONE;
@@ -461,5 +784,39 @@ u_distortion_mesh_fill_in_compute(struct xrt_device *xdev)
 	struct xrt_hmd_parts *target = xdev->hmd;
 
 	uint32_t num = (uint32_t)debug_get_num_option_mesh_size();
-	run_func(xdev, calc, 2, target, num);
+
+	// Shared by both views.
+	struct u_worker_group *uwg = u_distortion_mesh_create_group(xdev);
+	run_func(xdev, calc, 2, target, num, uwg);
+	u_worker_group_reference(&uwg, NULL);
+}
+
+struct u_worker_group *
+u_distortion_mesh_create_group(struct xrt_device *xdev)
+{
+	uint32_t thread_count = (uint32_t)CLAMP(debug_get_num_option_mesh_threads(), 1, U_WORKER_MAX_BANDS);
+	if (xdev->hmd == NULL || !xdev->hmd->distortion.compute_thread_safe || thread_count <= 1) {
+		return NULL;
+	}
+
+	// The thread waiting on the group helps out, so one less worker.
+	struct u_worker_thread_pool *pool = u_worker_thread_pool_create(thread_count - 1, thread_count);
+	struct u_worker_group *uwg = u_worker_group_create(pool);
+	u_worker_thread_pool_reference(&pool, NULL);
+
+	return uwg;
+}
+
+bool
+u_distortion_mesh_sample_grid(struct xrt_device *xdev,
+                              int view,
+                              uint32_t cols,
+                              uint32_t rows,
+                              const struct xrt_matrix_2x2 *rot,
+                              struct u_worker_group *uwg,
+                              struct xrt_uv_triplet *out_grid)
+{
+	assert(xdev->compute_distortion != NULL);
+
+	return sample_grid(xdev, xdev->compute_distortion, view, cols, rows, rot, uwg, out_grid);
 }
@@ -20,6 +20,7 @@
 extern "C" {
 #endif
 
+struct u_worker_group;
 
 /*
  *
@@ -219,6 +220,48 @@ u_distortion_mesh_fill_in_none(struct xrt_device *xdev);
 void
 u_distortion_mesh_set_none(struct xrt_device *xdev);
 
+/*!
+ * Creates a worker group to evaluate the distortion of @p xdev on, for
+ * @ref u_distortion_mesh_sample_grid. Returns NULL, so that it is all done on
+ * the calling thread, unless the device has set
+ * `xrt_hmd_parts::distortion.compute_thread_safe`. `XRT_MESH_THREADS` sets the
+ * number of threads.
+ *
+ * @relatesalso xrt_device
+ * @ingroup aux_distortion
+ */
+struct u_worker_group *
+u_distortion_mesh_create_group(struct xrt_device *xdev);
+
+/*!
+ * Samples `xdev->compute_distortion()` of @p view over a grid of @p cols by
+ * @p rows points, with u and v going from 0 to 1 inclusive, and writes the
+ * result in row major order to @p out_grid. If @p rot is not NULL the
+ * coordinates are rotated by it around the center before being passed on.
+ *
+ * If @p uwg is not NULL the rows are evaluated in parallel on it, see
+ * @ref u_distortion_mesh_create_group.
+ *
+ * Larger grids can be cached on disk with `XRT_MESH_CACHE=true`, so later runs
+ * can skip evaluating them. The device interface has no way to get at the
+ * calibration, so the cache is keyed on the device's names and a fingerprint
+ * of the distortion over a coarse grid. A calibration change the fingerprint
+ * misses gives a stale grid, which is why the cache is off by default.
+ *
+ * Returns false if the distortion function failed for any point.
+ *
+ * @relatesalso xrt_device
+ * @ingroup aux_distortion
+ */
+bool
+u_distortion_mesh_sample_grid(struct xrt_device *xdev,
+                              int view,
+                              uint32_t cols,
+                              uint32_t rows,
+                              const struct xrt_matrix_2x2 *rot,
+                              struct u_worker_group *uwg,
+                              struct xrt_uv_triplet *out_grid);
+
 
 #ifdef __cplusplus
 }
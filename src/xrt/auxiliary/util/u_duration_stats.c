@@ -0,0 +1,74 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Running statistics and a plot for a repeated duration.
+ * @ingroup aux_util
+ */
+
+#include "util/u_misc.h"
+#include "util/u_time.h"
+#include "util/u_duration_stats.h"
+
+#include <ctype.h>
+#include <stdio.h>
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+void
+u_duration_stats_init(struct u_duration_stats *uds, float range_ms, bool dynamic_rescale)
+{
+	U_ZERO(uds);
+
+	uds->timing.values.data = uds->times_ms;
+	uds->timing.values.length = U_DURATION_STATS_COUNT;
+	uds->timing.values.index_ptr = &uds->index;
+	uds->timing.reference_timing = 0.f;
+	uds->timing.center_reference_timing = false;
+	uds->timing.range = range_ms;
+	uds->timing.dynamic_rescale = dynamic_rescale;
+	uds->timing.unit = "ms";
+}
+
+void
+u_duration_stats_add(struct u_duration_stats *uds, uint64_t duration_ns)
+{
+	float ms = (float)time_ns_to_ms_f((time_duration_ns)duration_ns);
+
+	uds->count++;
+	uds->last_ms = ms;
+	if (ms > uds->max_ms) {
+		uds->max_ms = ms;
+	}
+
+	if (uds->count == 1) {
+		uds->avg_ms = ms;
+	} else {
+		uds->avg_ms += (ms - uds->avg_ms) * 0.05f;
+	}
+
+	uds->index = (uds->index + 1) % U_DURATION_STATS_COUNT;
+	uds->times_ms[uds->index] = ms;
+}
+
+void
+u_duration_stats_add_vars(struct u_duration_stats *uds, void *root, const char *what)
+{
+	char name[U_VAR_NAME_STRING_SIZE];
+
+	snprintf(name, sizeof(name), "Last %s (ms)", what);
+	u_var_add_ro_f32(root, &uds->last_ms, name);
+	snprintf(name, sizeof(name), "Average %s (ms)", what);
+	u_var_add_ro_f32(root, &uds->avg_ms, name);
+	snprintf(name, sizeof(name), "Max %s (ms)", what);
+	u_var_add_ro_f32(root, &uds->max_ms, name);
+
+	snprintf(name, sizeof(name), "%s times", what);
+	name[0] = (char)toupper((unsigned char)name[0]);
+	u_var_add_f32_timing(root, &uds->timing, name);
+}
@@ -0,0 +1,84 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Running statistics and a plot for a repeated duration.
+ * @ingroup aux_util
+ */
+
+#pragma once
+
+#include "xrt/xrt_compiler.h"
+
+#include "util/u_var.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+//! Number of durations kept for the plot.
+#define U_DURATION_STATS_COUNT (128)
+
+/*!
+ * Last, running average and max of a duration that is measured over and over,
+ * like a per-frame wait, plus a plot of the latest ones for the debug UI.
+ *
+ * Not thread safe, only add durations from one thread.
+ *
+ * @ingroup aux_util
+ */
+struct u_duration_stats
+{
+	//! Number of durations added.
+	uint64_t count;
+
+	//! The last duration.
+	float last_ms;
+
+	//! Exponential moving average, seeded with the first duration.
+	float avg_ms;
+
+	//! Longest duration seen.
+	float max_ms;
+
+	//! Ring of the latest durations.
+	float times_ms[U_DURATION_STATS_COUNT];
+
+	//! Current index into @p times_ms.
+	int index;
+
+	//! Plot of @p times_ms for the debug UI.
+	struct u_var_timing timing;
+};
+
+/*!
+ * Init the stats, @p range_ms is the initial range of the plot.
+ *
+ * @public @memberof u_duration_stats
+ */
+void
+u_duration_stats_init(struct u_duration_stats *uds, float range_ms, bool dynamic_rescale);
+
+/*!
+ * Add a duration.
+ *
+ * @public @memberof u_duration_stats
+ */
+void
+u_duration_stats_add(struct u_duration_stats *uds, uint64_t duration_ns);
+
+/*!
+ * Add the last, average and max duration and the plot to the variable tracking
+ * under @p root, @p what names the duration, like "wait".
+ *
+ * @public @memberof u_duration_stats
+ */
+void
+u_duration_stats_add_vars(struct u_duration_stats *uds, void *root, const char *what);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -31,6 +31,12 @@ u_file_open_file_in_config_dir(const char *filename, const char *mode);
 ssize_t
 u_file_get_runtime_dir(char *out_path, size_t out_path_size);
 
+ssize_t
+u_file_get_cache_dir(char *out_path, size_t out_path_size);
+
+FILE *
+u_file_open_file_in_cache_dir(const char *filename, const char *mode);
+
 char *
 u_file_read_content(FILE *file);
 
@@ -0,0 +1,868 @@
+// Copyright 2019-2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Row based pixel format conversion kernels.
+ * @author Jakob Bornecrantz <jakob@collabora.com>
+ * @author Moses Turner <moses@collabora.com>
+ * @ingroup aux_util
+ *
+ * The scalar kernels, moved here from u_sink_converter.c, are the reference,
+ * the SIMD kernels process blocks of pixels and hand the remainder of the row
+ * to the scalar ones. All YUV math is done in 16 bit lanes with 32 bit
+ * products, exactly like the scalar code, so the output is bit exact.
+ *
+ * The x86 kernels store RGB triplets with 8 or 16 byte stores that write a
+ * few bytes past the block, which the next block or the scalar tail then
+ * overwrites. The block loops are arranged so that those extra bytes always
+ * fall within the row.
+ */
+
+#include "xrt/xrt_compiler.h"
+
+#include "util/u_debug.h"
+#include "util/u_format_convert.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HAVE_SSE2
+#include <emmintrin.h>
+
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+#define HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(HAVE_AVX2) && defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+
+DEBUG_GET_ONCE_BOOL_OPTION(force_scalar, "U_FORMAT_CONVERT_FORCE_SCALAR", false)
+
+
+/*
+ *
+ * Scalar reference kernels.
+ *
+ */
+
+static inline int
+clamp_to_byte(int v)
+{
+	if (v < 0) {
+		return 0;
+	}
+	if (v >= 255) {
+		return 255;
+	}
+	return v;
+}
+
+static inline void
+YUV444_to_R8G8B8(int y, int u, int v, uint8_t *dst)
+{
+	int C = y - 16;
+	int D = u - 128;
+	int E = v - 128;
+
+	dst[0] = (uint8_t)clamp_to_byte((298 * C + 409 * E + 128) >> 8);
+	dst[1] = (uint8_t)clamp_to_byte((298 * C - 100 * D - 209 * E + 128) >> 8);
+	dst[2] = (uint8_t)clamp_to_byte((298 * C + 516 * D + 128) >> 8);
+}
+
+static void
+scalar_l8_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	for (uint32_t x = 0; x < w; x++) {
+		dst[x * 3 + 2] = dst[x * 3 + 1] = dst[x * 3 + 0] = src[x];
+	}
+}
+
+static void
+scalar_yuyv422_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	for (uint32_t x = 0; x < w; x += 2) {
+		const uint8_t *in = src + (x * 2);
+		uint8_t y0 = in[0];
+		uint8_t u = in[1];
+		uint8_t y1 = in[2];
+		uint8_t v = in[3];
+
+		YUV444_to_R8G8B8(y0, u, v, dst + (x * 3));
+		YUV444_to_R8G8B8(y1, u, v, dst + (x * 3) + 3);
+	}
+}
+
+static void
+scalar_yuyv422_to_l8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	for (uint32_t x = 0; x < w; x++) {
+		dst[x] = src[x * 2];
+	}
+}
+
+static void
+scalar_uyvy422_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	for (uint32_t x = 0; x < w; x += 2) {
+		const uint8_t *in = src + (x * 2);
+		uint8_t u = in[0];
+		uint8_t y0 = in[1];
+		uint8_t v = in[2];
+		uint8_t y1 = in[3];
+
+		YUV444_to_R8G8B8(y0, u, v, dst + (x * 3));
+		YUV444_to_R8G8B8(y1, u, v, dst + (x * 3) + 3);
+	}
+}
+
+static void
+scalar_yuv888_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	for (uint32_t x = 0; x < w; x++) {
+		const uint8_t *in = src + (x * 3);
+		YUV444_to_R8G8B8(in[0], in[1], in[2], dst + (x * 3));
+	}
+}
+
+static void
+scalar_bayer_gr8_to_r8g8b8(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, uint32_t w)
+{
+	for (uint32_t x = 0; x < w; x++) {
+		uint8_t g0 = src0[0];
+		uint8_t r = src0[1];
+		uint8_t b = src1[0];
+		uint8_t g1 = src1[1];
+
+		dst[0] = r;
+		dst[1] = (g0 + g1) / 2;
+		dst[2] = b;
+
+		src0 += 2;
+		src1 += 2;
+		dst += 3;
+	}
+}
+
+static const struct u_format_convert_funcs scalar_funcs = {
+    .impl = U_FORMAT_CONVERT_IMPL_SCALAR,
+    .l8_to_r8g8b8 = scalar_l8_to_r8g8b8,
+    .yuyv422_to_r8g8b8 = scalar_yuyv422_to_r8g8b8,
+    .yuyv422_to_l8 = scalar_yuyv422_to_l8,
+    .uyvy422_to_r8g8b8 = scalar_uyvy422_to_r8g8b8,
+    .yuv888_to_r8g8b8 = scalar_yuv888_to_r8g8b8,
+    .bayer_gr8_to_r8g8b8 = scalar_bayer_gr8_to_r8g8b8,
+};
+
+
+/*
+ *
+ * SSE2 kernels, 8 pixels at a time.
+ *
+ */
+
+#ifdef HAVE_SSE2
+
+/*!
+ * YUV to RGB for 8 pixels, takes C = Y - 16, D = U - 128 and E = V - 128 as
+ * signed 16 bit lanes and returns R, G and B clamped to [0, 255].
+ */
+static inline void
+sse2_yuv_to_rgb(__m128i c, __m128i d, __m128i e, __m128i *out_r, __m128i *out_g, __m128i *out_b)
+{
+	const __m128i k_r_ce = _mm_set_epi16(409, 298, 409, 298, 409, 298, 409, 298);
+	const __m128i k_g_cd = _mm_set_epi16(-100, 298, -100, 298, -100, 298, -100, 298);
+	const __m128i k_g_e1 = _mm_set_epi16(128, -209, 128, -209, 128, -209, 128, -209);
+	const __m128i k_b_cd = _mm_set_epi16(516, 298, 516, 298, 516, 298, 516, 298);
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i round = _mm_set1_epi32(128);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i max = _mm_set1_epi16(255);
+
+	__m128i ce_lo = _mm_unpacklo_epi16(c, e);
+	__m128i ce_hi = _mm_unpackhi_epi16(c, e);
+	__m128i cd_lo = _mm_unpacklo_epi16(c, d);
+	__m128i cd_hi = _mm_unpackhi_epi16(c, d);
+	__m128i e1_lo = _mm_unpacklo_epi16(e, one);
+	__m128i e1_hi = _mm_unpackhi_epi16(e, one);
+
+	// 298 * C + 409 * E + 128
+	__m128i r_lo = _mm_add_epi32(_mm_madd_epi16(ce_lo, k_r_ce), round);
+	__m128i r_hi = _mm_add_epi32(_mm_madd_epi16(ce_hi, k_r_ce), round);
+
+	// 298 * C - 100 * D + (-209 * E + 128 * 1)
+	__m128i g_lo = _mm_add_epi32(_mm_madd_epi16(cd_lo, k_g_cd), _mm_madd_epi16(e1_lo, k_g_e1));
+	__m128i g_hi = _mm_add_epi32(_mm_madd_epi16(cd_hi, k_g_cd), _mm_madd_epi16(e1_hi, k_g_e1));
+
+	// 298 * C + 516 * D + 128
+	__m128i b_lo = _mm_add_epi32(_mm_madd_epi16(cd_lo, k_b_cd), round);
+	__m128i b_hi = _mm_add_epi32(_mm_madd_epi16(cd_hi, k_b_cd), round);
+
+	// The shifted values fit in 16 bits, so the saturating pack is exact.
+	__m128i r = _mm_packs_epi32(_mm_srai_epi32(r_lo, 8), _mm_srai_epi32(r_hi, 8));
+	__m128i g = _mm_packs_epi32(_mm_srai_epi32(g_lo, 8), _mm_srai_epi32(g_hi, 8));
+	__m128i b = _mm_packs_epi32(_mm_srai_epi32(b_lo, 8), _mm_srai_epi32(b_hi, 8));
+
+	*out_r = _mm_min_epi16(_mm_max_epi16(r, zero), max);
+	*out_g = _mm_min_epi16(_mm_max_epi16(g, zero), max);
+	*out_b = _mm_min_epi16(_mm_max_epi16(b, zero), max);
+}
+
+//! Packs 4 RGBX pixels into two 6 byte RGBRGB groups, one per 64 bit half.
+static inline __m128i
+sse2_rgbx_to_rgb_halves(__m128i rgbx)
+{
+	const __m128i mask_p0 = _mm_set_epi32(0, 0x00ffffff, 0, 0x00ffffff);
+	const __m128i mask_p1 = _mm_set_epi32(0x0000ffff, (int)0xff000000, 0x0000ffff, (int)0xff000000);
+
+	__m128i p0 = _mm_and_si128(rgbx, mask_p0);
+	__m128i p1 = _mm_and_si128(_mm_srli_epi64(rgbx, 8), mask_p1);
+	return _mm_or_si128(p0, p1);
+}
+
+/*!
+ * Stores 8 pixels of 16 bit R, G and B lanes as 24 bytes of RGB, writes 2
+ * bytes past the end.
+ */
+static inline void
+sse2_store_rgb(uint8_t *dst, __m128i r, __m128i g, __m128i b)
+{
+	__m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+	__m128i lo = sse2_rgbx_to_rgb_halves(_mm_unpacklo_epi16(rg, b));
+	__m128i hi = sse2_rgbx_to_rgb_halves(_mm_unpackhi_epi16(rg, b));
+
+	_mm_storel_epi64((__m128i *)(dst + 0), lo);
+	_mm_storel_epi64((__m128i *)(dst + 6), _mm_srli_si128(lo, 8));
+	_mm_storel_epi64((__m128i *)(dst + 12), hi);
+	_mm_storel_epi64((__m128i *)(dst + 18), _mm_srli_si128(hi, 8));
+}
+
+//! Unpacks 8 pixels of 4:2:2 chroma, given as U V pairs in 16 bit lanes.
+static inline void
+sse2_yuv422_to_rgb(uint8_t *dst, __m128i y, __m128i uv)
+{
+	const __m128i k16 = _mm_set1_epi16(16);
+	const __m128i k128 = _mm_set1_epi16(128);
+
+	// Duplicate the chroma of each pair to both of its pixels.
+	__m128i u = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+	__m128i v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+
+	__m128i r, g, b;
+	sse2_yuv_to_rgb(_mm_sub_epi16(y, k16), _mm_sub_epi16(u, k128), _mm_sub_epi16(v, k128), &r, &g, &b);
+	sse2_store_rgb(dst, r, g, b);
+}
+
+static void
+sse2_l8_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	uint32_t x = 0;
+	for (; x + 8 < w; x += 8) {
+		__m128i l = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + x)), zero);
+		sse2_store_rgb(dst + (x * 3), l, l, l);
+	}
+
+	scalar_l8_to_r8g8b8(src + x, dst + (x * 3), w - x);
+}
+
+static void
+sse2_yuyv422_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	const __m128i mask = _mm_set1_epi16(0x00ff);
+
+	uint32_t x = 0;
+	for (; x + 8 < w; x += 8) {
+		__m128i in = _mm_loadu_si128((const __m128i *)(src + (x * 2)));
+		sse2_yuv422_to_rgb(dst + (x * 3), _mm_and_si128(in, mask), _mm_srli_epi16(in, 8));
+	}
+
+	scalar_yuyv422_to_r8g8b8(src + (x * 2), dst + (x * 3), w - x);
+}
+
+static void
+sse2_yuyv422_to_l8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	const __m128i mask = _mm_set1_epi16(0x00ff);
+
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + (x * 2)));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + (x * 2) + 16));
+		__m128i y = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+		_mm_storeu_si128((__m128i *)(dst + x), y);
+	}
+
+	scalar_yuyv422_to_l8(src + (x * 2), dst + x, w - x);
+}
+
+static void
+sse2_uyvy422_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	const __m128i mask = _mm_set1_epi16(0x00ff);
+
+	uint32_t x = 0;
+	for (; x + 8 < w; x += 8) {
+		__m128i in = _mm_loadu_si128((const __m128i *)(src + (x * 2)));
+		sse2_yuv422_to_rgb(dst + (x * 3), _mm_srli_epi16(in, 8), _mm_and_si128(in, mask));
+	}
+
+	scalar_uyvy422_to_r8g8b8(src + (x * 2), dst + (x * 3), w - x);
+}
+
+static void
+sse2_yuv888_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	// SSE2 has no byte shuffle, deinterleave the planes with plain loads.
+	int16_t ys[8];
+	int16_t us[8];
+	int16_t vs[8];
+
+	uint32_t x = 0;
+	for (; x + 8 < w; x += 8) {
+		const uint8_t *in = src + (x * 3);
+		for (int i = 0; i < 8; i++) {
+			ys[i] = (int16_t)(in[i * 3 + 0] - 16);
+			us[i] = (int16_t)(in[i * 3 + 1] - 128);
+			vs[i] = (int16_t)(in[i * 3 + 2] - 128);
+		}
+
+		__m128i r, g, b;
+		sse2_yuv_to_rgb(_mm_loadu_si128((const __m128i *)ys), _mm_loadu_si128((const __m128i *)us),
+		                _mm_loadu_si128((const __m128i *)vs), &r, &g, &b);
+		sse2_store_rgb(dst + (x * 3), r, g, b);
+	}
+
+	scalar_yuv888_to_r8g8b8(src + (x * 3), dst + (x * 3), w - x);
+}
+
+static void
+sse2_bayer_gr8_to_r8g8b8(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, uint32_t w)
+{
+	const __m128i mask = _mm_set1_epi16(0x00ff);
+
+	uint32_t x = 0;
+	for (; x + 8 < w; x += 8) {
+		__m128i gr = _mm_loadu_si128((const __m128i *)(src0 + (x * 2)));
+		__m128i bg = _mm_loadu_si128((const __m128i *)(src1 + (x * 2)));
+
+		__m128i g0 = _mm_and_si128(gr, mask);
+		__m128i r = _mm_srli_epi16(gr, 8);
+		__m128i b = _mm_and_si128(bg, mask);
+		__m128i g1 = _mm_srli_epi16(bg, 8);
+		__m128i g = _mm_srli_epi16(_mm_add_epi16(g0, g1), 1);
+
+		sse2_store_rgb(dst + (x * 3), r, g, b);
+	}
+
+	scalar_bayer_gr8_to_r8g8b8(src0 + (x * 2), src1 + (x * 2), dst + (x * 3), w - x);
+}
+
+static const struct u_format_convert_funcs sse2_funcs = {
+    .impl = U_FORMAT_CONVERT_IMPL_SSE2,
+    .l8_to_r8g8b8 = sse2_l8_to_r8g8b8,
+    .yuyv422_to_r8g8b8 = sse2_yuyv422_to_r8g8b8,
+    .yuyv422_to_l8 = sse2_yuyv422_to_l8,
+    .uyvy422_to_r8g8b8 = sse2_uyvy422_to_r8g8b8,
+    .yuv888_to_r8g8b8 = sse2_yuv888_to_r8g8b8,
+    .bayer_gr8_to_r8g8b8 = sse2_bayer_gr8_to_r8g8b8,
+};
+
+#endif // HAVE_SSE2
+
+
+/*
+ *
+ * AVX2 kernels, 16 pixels at a time.
+ *
+ */
+
+#ifdef HAVE_AVX2
+
+/*!
+ * Same as @ref sse2_yuv_to_rgb but for 16 pixels. The unpacks and packs both
+ * work within 128 bit lanes so the pixel order is kept.
+ */
+TARGET_AVX2 static inline void
+avx2_yuv_to_rgb(__m256i c, __m256i d, __m256i e, __m256i *out_r, __m256i *out_g, __m256i *out_b)
+{
+	const __m256i k_r_ce = _mm256_set1_epi32((409 << 16) | 298);
+	const __m256i k_g_cd = _mm256_set1_epi32((int32_t)(((uint32_t)(uint16_t)-100 << 16) | 298));
+	const __m256i k_g_e1 = _mm256_set1_epi32((128 << 16) | (uint16_t)-209);
+	const __m256i k_b_cd = _mm256_set1_epi32((516 << 16) | 298);
+	const __m256i one = _mm256_set1_epi16(1);
+	const __m256i round = _mm256_set1_epi32(128);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i max = _mm256_set1_epi16(255);
+
+	__m256i ce_lo = _mm256_unpacklo_epi16(c, e);
+	__m256i ce_hi = _mm256_unpackhi_epi16(c, e);
+	__m256i cd_lo = _mm256_unpacklo_epi16(c, d);
+	__m256i cd_hi = _mm256_unpackhi_epi16(c, d);
+	__m256i e1_lo = _mm256_unpacklo_epi16(e, one);
+	__m256i e1_hi = _mm256_unpackhi_epi16(e, one);
+
+	__m256i r_lo = _mm256_add_epi32(_mm256_madd_epi16(ce_lo, k_r_ce), round);
+	__m256i r_hi = _mm256_add_epi32(_mm256_madd_epi16(ce_hi, k_r_ce), round);
+
+	__m256i g_lo = _mm256_add_epi32(_mm256_madd_epi16(cd_lo, k_g_cd), _mm256_madd_epi16(e1_lo, k_g_e1));
+	__m256i g_hi = _mm256_add_epi32(_mm256_madd_epi16(cd_hi, k_g_cd), _mm256_madd_epi16(e1_hi, k_g_e1));
+
+	__m256i b_lo = _mm256_add_epi32(_mm256_madd_epi16(cd_lo, k_b_cd), round);
+	__m256i b_hi = _mm256_add_epi32(_mm256_madd_epi16(cd_hi, k_b_cd), round);
+
+	__m256i r = _mm256_packs_epi32(_mm256_srai_epi32(r_lo, 8), _mm256_srai_epi32(r_hi, 8));
+	__m256i g = _mm256_packs_epi32(_mm256_srai_epi32(g_lo, 8), _mm256_srai_epi32(g_hi, 8));
+	__m256i b = _mm256_packs_epi32(_mm256_srai_epi32(b_lo, 8), _mm256_srai_epi32(b_hi, 8));
+
+	*out_r = _mm256_min_epi16(_mm256_max_epi16(r, zero), max);
+	*out_g = _mm256_min_epi16(_mm256_max_epi16(g, zero), max);
+	*out_b = _mm256_min_epi16(_mm256_max_epi16(b, zero), max);
+}
+
+/*!
+ * Stores 16 pixels of 16 bit R, G and B lanes as 48 bytes of RGB, writes 4
+ * bytes past the end.
+ */
+TARGET_AVX2 static inline void
+avx2_store_rgb(uint8_t *dst, __m256i r, __m256i g, __m256i b)
+{
+	const __m256i compact = _mm256_setr_epi8(                       //
+	    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -128, -128, -128, -128, //
+	    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -128, -128, -128, -128);
+
+	__m256i rg = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+
+	// Pixels 0-3 and 8-11, then 4-7 and 12-15.
+	__m256i lo = _mm256_shuffle_epi8(_mm256_unpacklo_epi16(rg, b), compact);
+	__m256i hi = _mm256_shuffle_epi8(_mm256_unpackhi_epi16(rg, b), compact);
+
+	_mm_storeu_si128((__m128i *)(dst + 0), _mm256_castsi256_si128(lo));
+	_mm_storeu_si128((__m128i *)(dst + 12), _mm256_castsi256_si128(hi));
+	_mm_storeu_si128((__m128i *)(dst + 24), _mm256_extracti128_si256(lo, 1));
+	_mm_storeu_si128((__m128i *)(dst + 36), _mm256_extracti128_si256(hi, 1));
+}
+
+TARGET_AVX2 static inline void
+avx2_yuv422_to_rgb(uint8_t *dst, __m256i y, __m256i uv)
+{
+	const __m256i k16 = _mm256_set1_epi16(16);
+	const __m256i k128 = _mm256_set1_epi16(128);
+
+	__m256i u =
+	    _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+	__m256i v =
+	    _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+
+	__m256i r, g, b;
+	avx2_yuv_to_rgb(_mm256_sub_epi16(y, k16), _mm256_sub_epi16(u, k128), _mm256_sub_epi16(v, k128), &r, &g, &b);
+	avx2_store_rgb(dst, r, g, b);
+}
+
+TARGET_AVX2 static void
+avx2_l8_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 18 <= w; x += 16) {
+		__m256i l = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src + x)));
+		avx2_store_rgb(dst + (x * 3), l, l, l);
+	}
+
+	scalar_l8_to_r8g8b8(src + x, dst + (x * 3), w - x);
+}
+
+TARGET_AVX2 static void
+avx2_yuyv422_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	const __m256i mask = _mm256_set1_epi16(0x00ff);
+
+	uint32_t x = 0;
+	for (; x + 18 <= w; x += 16) {
+		__m256i in = _mm256_loadu_si256((const __m256i *)(src + (x * 2)));
+		avx2_yuv422_to_rgb(dst + (x * 3), _mm256_and_si256(in, mask), _mm256_srli_epi16(in, 8));
+	}
+
+	scalar_yuyv422_to_r8g8b8(src + (x * 2), dst + (x * 3), w - x);
+}
+
+TARGET_AVX2 static void
+avx2_yuyv422_to_l8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	const __m256i mask = _mm256_set1_epi16(0x00ff);
+
+	uint32_t x = 0;
+	for (; x + 32 <= w; x += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(src + (x * 2)));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(src + (x * 2) + 32));
+		__m256i y = _mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+
+		// The pack interleaves the 128 bit lanes of a and b.
+		y = _mm256_permute4x64_epi64(y, _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i *)(dst + x), y);
+	}
+
+	scalar_yuyv422_to_l8(src + (x * 2), dst + x, w - x);
+}
+
+TARGET_AVX2 static void
+avx2_uyvy422_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	const __m256i mask = _mm256_set1_epi16(0x00ff);
+
+	uint32_t x = 0;
+	for (; x + 18 <= w; x += 16) {
+		__m256i in = _mm256_loadu_si256((const __m256i *)(src + (x * 2)));
+		avx2_yuv422_to_rgb(dst + (x * 3), _mm256_srli_epi16(in, 8), _mm256_and_si256(in, mask));
+	}
+
+	scalar_uyvy422_to_r8g8b8(src + (x * 2), dst + (x * 3), w - x);
+}
+
+//! Gathers one channel out of 16 pixels of packed 3 byte YUV.
+TARGET_AVX2 static inline __m128i
+avx2_deinterleave3(__m128i a, __m128i b, __m128i c, const int8_t masks[3][16])
+{
+	__m128i ra = _mm_shuffle_epi8(a, _mm_loadu_si128((const __m128i *)masks[0]));
+	__m128i rb = _mm_shuffle_epi8(b, _mm_loadu_si128((const __m128i *)masks[1]));
+	__m128i rc = _mm_shuffle_epi8(c, _mm_loadu_si128((const __m128i *)masks[2]));
+	return _mm_or_si128(_mm_or_si128(ra, rb), rc);
+}
+
+// clang-format off
+static const int8_t yuv888_y_masks[3][16] = {
+    {0, 3, 6, 9, 12, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+    {-128, -128, -128, -128, -128, -128, 2, 5, 8, 11, 14, -128, -128, -128, -128, -128},
+    {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 1, 4, 7, 10, 13},
+};
+static const int8_t yuv888_u_masks[3][16] = {
+    {1, 4, 7, 10, 13, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+    {-128, -128, -128, -128, -128, 0, 3, 6, 9, 12, 15, -128, -128, -128, -128, -128},
+    {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 2, 5, 8, 11, 14},
+};
+static const int8_t yuv888_v_masks[3][16] = {
+    {2, 5, 8, 11, 14, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+    {-128, -128, -128, -128, -128, 1, 4, 7, 10, 13, -128, -128, -128, -128, -128, -128},
+    {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0, 3, 6, 9, 12, 15},
+};
+// clang-format on
+
+TARGET_AVX2 static void
+avx2_yuv888_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	const __m256i k16 = _mm256_set1_epi16(16);
+	const __m256i k128 = _mm256_set1_epi16(128);
+
+	uint32_t x = 0;
+	for (; x + 18 <= w; x += 16) {
+		const uint8_t *in = src + (x * 3);
+		__m128i a = _mm_loadu_si128((const __m128i *)(in + 0));
+		__m128i b = _mm_loadu_si128((const __m128i *)(in + 16));
+		__m128i c = _mm_loadu_si128((const __m128i *)(in + 32));
+
+		__m256i y = _mm256_cvtepu8_epi16(avx2_deinterleave3(a, b, c, yuv888_y_masks));
+		__m256i u = _mm256_cvtepu8_epi16(avx2_deinterleave3(a, b, c, yuv888_u_masks));
+		__m256i v = _mm256_cvtepu8_epi16(avx2_deinterleave3(a, b, c, yuv888_v_masks));
+
+		__m256i r, g, bl;
+		avx2_yuv_to_rgb(_mm256_sub_epi16(y, k16), _mm256_sub_epi16(u, k128), _mm256_sub_epi16(v, k128), &r, &g,
+		                &bl);
+		avx2_store_rgb(dst + (x * 3), r, g, bl);
+	}
+
+	scalar_yuv888_to_r8g8b8(src + (x * 3), dst + (x * 3), w - x);
+}
+
+TARGET_AVX2 static void
+avx2_bayer_gr8_to_r8g8b8(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, uint32_t w)
+{
+	const __m256i mask = _mm256_set1_epi16(0x00ff);
+
+	uint32_t x = 0;
+	for (; x + 18 <= w; x += 16) {
+		__m256i gr = _mm256_loadu_si256((const __m256i *)(src0 + (x * 2)));
+		__m256i bg = _mm256_loadu_si256((const __m256i *)(src1 + (x * 2)));
+
+		__m256i g0 = _mm256_and_si256(gr, mask);
+		__m256i r = _mm256_srli_epi16(gr, 8);
+		__m256i b = _mm256_and_si256(bg, mask);
+		__m256i g1 = _mm256_srli_epi16(bg, 8);
+		__m256i g = _mm256_srli_epi16(_mm256_add_epi16(g0, g1), 1);
+
+		avx2_store_rgb(dst + (x * 3), r, g, b);
+	}
+
+	scalar_bayer_gr8_to_r8g8b8(src0 + (x * 2), src1 + (x * 2), dst + (x * 3), w - x);
+}
+
+static const struct u_format_convert_funcs avx2_funcs = {
+    .impl = U_FORMAT_CONVERT_IMPL_AVX2,
+    .l8_to_r8g8b8 = avx2_l8_to_r8g8b8,
+    .yuyv422_to_r8g8b8 = avx2_yuyv422_to_r8g8b8,
+    .yuyv422_to_l8 = avx2_yuyv422_to_l8,
+    .uyvy422_to_r8g8b8 = avx2_uyvy422_to_r8g8b8,
+    .yuv888_to_r8g8b8 = avx2_yuv888_to_r8g8b8,
+    .bayer_gr8_to_r8g8b8 = avx2_bayer_gr8_to_r8g8b8,
+};
+
+static bool
+cpu_has_avx2(void)
+{
+#if defined(__GNUC__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+	int regs[4];
+	__cpuid(regs, 1);
+	bool osxsave = (regs[2] & (1 << 27)) != 0;
+	bool avx = (regs[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx) {
+		return false;
+	}
+
+	// The OS must save the YMM registers.
+	if ((_xgetbv(0) & 0x6) != 0x6) {
+		return false;
+	}
+
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	return false;
+#endif
+}
+
+#endif // HAVE_AVX2
+
+
+/*
+ *
+ * NEON kernels, 16 pixels at a time.
+ *
+ */
+
+#ifdef HAVE_NEON
+
+//! (a * ka + b * kb + c * kc + 128) >> 8 for 8 pixels, narrowed to 16 bits.
+static inline int16x8_t
+neon_dot3(int16x8_t a, int16_t ka, int16x8_t b, int16_t kb, int16x8_t c, int16_t kc)
+{
+	int32x4_t lo = vmull_n_s16(vget_low_s16(a), ka);
+	int32x4_t hi = vmull_n_s16(vget_high_s16(a), ka);
+	lo = vmlal_n_s16(lo, vget_low_s16(b), kb);
+	hi = vmlal_n_s16(hi, vget_high_s16(b), kb);
+	lo = vmlal_n_s16(lo, vget_low_s16(c), kc);
+	hi = vmlal_n_s16(hi, vget_high_s16(c), kc);
+
+	// The rounding shift adds the 128.
+	return vcombine_s16(vrshrn_n_s32(lo, 8), vrshrn_n_s32(hi, 8));
+}
+
+static inline void
+neon_yuv_to_rgb(uint8x8_t y, uint8x8_t u, uint8x8_t v, uint8x8_t *out_r, uint8x8_t *out_g, uint8x8_t *out_b)
+{
+	int16x8_t c = vreinterpretq_s16_u16(vsubl_u8(y, vdup_n_u8(16)));
+	int16x8_t d = vreinterpretq_s16_u16(vsubl_u8(u, vdup_n_u8(128)));
+	int16x8_t e = vreinterpretq_s16_u16(vsubl_u8(v, vdup_n_u8(128)));
+
+	// The saturating narrow does the clamping.
+	*out_r = vqmovun_s16(neon_dot3(c, 298, e, 409, d, 0));
+	*out_g = vqmovun_s16(neon_dot3(c, 298, d, -100, e, -209));
+	*out_b = vqmovun_s16(neon_dot3(c, 298, d, 516, e, 0));
+}
+
+//! Converts 8 pairs of 4:2:2 pixels and stores them as 16 RGB pixels.
+static inline void
+neon_yuv422_to_rgb(uint8_t *dst, uint8x8_t y0, uint8x8_t y1, uint8x8_t u, uint8x8_t v)
+{
+	uint8x8_t r0, g0, b0, r1, g1, b1;
+	neon_yuv_to_rgb(y0, u, v, &r0, &g0, &b0);
+	neon_yuv_to_rgb(y1, u, v, &r1, &g1, &b1);
+
+	uint8x8x2_t r = vzip_u8(r0, r1);
+	uint8x8x2_t g = vzip_u8(g0, g1);
+	uint8x8x2_t b = vzip_u8(b0, b1);
+
+	uint8x16x3_t rgb;
+	rgb.val[0] = vcombine_u8(r.val[0], r.val[1]);
+	rgb.val[1] = vcombine_u8(g.val[0], g.val[1]);
+	rgb.val[2] = vcombine_u8(b.val[0], b.val[1]);
+	vst3q_u8(dst, rgb);
+}
+
+static void
+neon_l8_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		uint8x16_t l = vld1q_u8(src + x);
+		uint8x16x3_t rgb;
+		rgb.val[0] = l;
+		rgb.val[1] = l;
+		rgb.val[2] = l;
+		vst3q_u8(dst + (x * 3), rgb);
+	}
+
+	scalar_l8_to_r8g8b8(src + x, dst + (x * 3), w - x);
+}
+
+static void
+neon_yuyv422_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		uint8x8x4_t in = vld4_u8(src + (x * 2));
+		neon_yuv422_to_rgb(dst + (x * 3), in.val[0], in.val[2], in.val[1], in.val[3]);
+	}
+
+	scalar_yuyv422_to_r8g8b8(src + (x * 2), dst + (x * 3), w - x);
+}
+
+static void
+neon_yuyv422_to_l8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		uint8x16x2_t in = vld2q_u8(src + (x * 2));
+		vst1q_u8(dst + x, in.val[0]);
+	}
+
+	scalar_yuyv422_to_l8(src + (x * 2), dst + x, w - x);
+}
+
+static void
+neon_uyvy422_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		uint8x8x4_t in = vld4_u8(src + (x * 2));
+		neon_yuv422_to_rgb(dst + (x * 3), in.val[1], in.val[3], in.val[0], in.val[2]);
+	}
+
+	scalar_uyvy422_to_r8g8b8(src + (x * 2), dst + (x * 3), w - x);
+}
+
+static void
+neon_yuv888_to_r8g8b8(const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		uint8x16x3_t in = vld3q_u8(src + (x * 3));
+
+		uint8x8_t r0, g0, b0, r1, g1, b1;
+		neon_yuv_to_rgb(vget_low_u8(in.val[0]), vget_low_u8(in.val[1]), vget_low_u8(in.val[2]), &r0, &g0,
+		                &b0);
+		neon_yuv_to_rgb(vget_high_u8(in.val[0]), vget_high_u8(in.val[1]), vget_high_u8(in.val[2]), &r1, &g1,
+		                &b1);
+
+		uint8x16x3_t rgb;
+		rgb.val[0] = vcombine_u8(r0, r1);
+		rgb.val[1] = vcombine_u8(g0, g1);
+		rgb.val[2] = vcombine_u8(b0, b1);
+		vst3q_u8(dst + (x * 3), rgb);
+	}
+
+	scalar_yuv888_to_r8g8b8(src + (x * 3), dst + (x * 3), w - x);
+}
+
+static void
+neon_bayer_gr8_to_r8g8b8(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		uint8x16x2_t gr = vld2q_u8(src0 + (x * 2));
+		uint8x16x2_t bg = vld2q_u8(src1 + (x * 2));
+
+		uint8x16x3_t rgb;
+		rgb.val[0] = gr.val[1];
+		rgb.val[1] = vhaddq_u8(gr.val[0], bg.val[1]); // Truncating, like the scalar code.
+		rgb.val[2] = bg.val[0];
+		vst3q_u8(dst + (x * 3), rgb);
+	}
+
+	scalar_bayer_gr8_to_r8g8b8(src0 + (x * 2), src1 + (x * 2), dst + (x * 3), w - x);
+}
+
+static const struct u_format_convert_funcs neon_funcs = {
+    .impl = U_FORMAT_CONVERT_IMPL_NEON,
+    .l8_to_r8g8b8 = neon_l8_to_r8g8b8,
+    .yuyv422_to_r8g8b8 = neon_yuyv422_to_r8g8b8,
+    .yuyv422_to_l8 = neon_yuyv422_to_l8,
+    .uyvy422_to_r8g8b8 = neon_uyvy422_to_r8g8b8,
+    .yuv888_to_r8g8b8 = neon_yuv888_to_r8g8b8,
+    .bayer_gr8_to_r8g8b8 = neon_bayer_gr8_to_r8g8b8,
+};
+
+#endif // HAVE_NEON
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+const struct u_format_convert_funcs *
+u_format_convert_get_funcs(enum u_format_convert_impl impl)
+{
+	switch (impl) {
+	case U_FORMAT_CONVERT_IMPL_SCALAR: return &scalar_funcs;
+#ifdef HAVE_SSE2
+	case U_FORMAT_CONVERT_IMPL_SSE2: return &sse2_funcs;
+#endif
+#ifdef HAVE_AVX2
+	case U_FORMAT_CONVERT_IMPL_AVX2: return cpu_has_avx2() ? &avx2_funcs : NULL;
+#endif
+#ifdef HAVE_NEON
+	case U_FORMAT_CONVERT_IMPL_NEON: return &neon_funcs;
+#endif
+	default: return NULL;
+	}
+}
+
+const struct u_format_convert_funcs *
+u_format_convert_get_best(void)
+{
+	if (debug_get_bool_option_force_scalar()) {
+		return &scalar_funcs;
+	}
+
+	static const enum u_format_convert_impl order[] = {
+	    U_FORMAT_CONVERT_IMPL_AVX2,
+	    U_FORMAT_CONVERT_IMPL_NEON,
+	    U_FORMAT_CONVERT_IMPL_SSE2,
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(order); i++) {
+		const struct u_format_convert_funcs *funcs = u_format_convert_get_funcs(order[i]);
+		if (funcs != NULL) {
+			return funcs;
+		}
+	}
+
+	return &scalar_funcs;
+}
+
+const char *
+u_format_convert_impl_str(enum u_format_convert_impl impl)
+{
+	switch (impl) {
+	case U_FORMAT_CONVERT_IMPL_SCALAR: return "SCALAR";
+	case U_FORMAT_CONVERT_IMPL_SSE2: return "SSE2";
+	case U_FORMAT_CONVERT_IMPL_AVX2: return "AVX2";
+	case U_FORMAT_CONVERT_IMPL_NEON: return "NEON";
+	default: return "UNKNOWN";
+	}
+}
@@ -0,0 +1,103 @@
+// Copyright 2019-2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Row based pixel format conversion kernels.
+ * @ingroup aux_util
+ */
+
+#pragma once
+
+#include "xrt/xrt_defines.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*!
+ * The different implementations of the conversion kernels, the scalar one is
+ * always available and is the reference all others must match bit for bit.
+ *
+ * @ingroup aux_util
+ */
+enum u_format_convert_impl
+{
+	U_FORMAT_CONVERT_IMPL_SCALAR,
+	U_FORMAT_CONVERT_IMPL_SSE2,
+	U_FORMAT_CONVERT_IMPL_AVX2,
+	U_FORMAT_CONVERT_IMPL_NEON,
+	U_FORMAT_CONVERT_IMPL_COUNT,
+};
+
+/*!
+ * Converts @p w pixels of one row from @p src to @p dst.
+ *
+ * @ingroup aux_util
+ */
+typedef void (*u_format_convert_row_func_t)(const uint8_t *src, uint8_t *dst, uint32_t w);
+
+/*!
+ * Converts @p w pixels of one output row from the two source rows @p src0 and
+ * @p src1, used by the Bayer formats which are converted at half resolution.
+ *
+ * @ingroup aux_util
+ */
+typedef void (*u_format_convert_bayer_row_func_t)(const uint8_t *src0,
+                                                  const uint8_t *src1,
+                                                  uint8_t *dst,
+                                                  uint32_t w);
+
+/*!
+ * A set of conversion kernels, all produced by the same implementation.
+ *
+ * The YUV to RGB conversions use the BT.601 limited range integer
+ * approximation, and all kernels produce exactly the same output as the
+ * scalar ones.
+ *
+ * @ingroup aux_util
+ */
+struct u_format_convert_funcs
+{
+	enum u_format_convert_impl impl;
+
+	u_format_convert_row_func_t l8_to_r8g8b8;
+	u_format_convert_row_func_t yuyv422_to_r8g8b8;
+	u_format_convert_row_func_t yuyv422_to_l8;
+	u_format_convert_row_func_t uyvy422_to_r8g8b8;
+	u_format_convert_row_func_t yuv888_to_r8g8b8;
+
+	//! @p w is the output width, which is half the source width.
+	u_format_convert_bayer_row_func_t bayer_gr8_to_r8g8b8;
+};
+
+/*!
+ * Returns the kernels of the given implementation, or NULL if it was not
+ * built or the CPU we are running on doesn't support it.
+ *
+ * @ingroup aux_util
+ */
+const struct u_format_convert_funcs *
+u_format_convert_get_funcs(enum u_format_convert_impl impl);
+
+/*!
+ * Returns the fastest kernels the CPU supports, the scalar ones can be forced
+ * with the `U_FORMAT_CONVERT_FORCE_SCALAR` environment variable.
+ *
+ * @ingroup aux_util
+ */
+const struct u_format_convert_funcs *
+u_format_convert_get_best(void);
+
+/*!
+ * Return string for this implementation.
+ *
+ * @ingroup aux_util
+ */
+const char *
+u_format_convert_impl_str(enum u_format_convert_impl impl);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,590 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Pooled @ref xrt_frame allocator.
+ * @ingroup aux_util
+ */
+
+#include "os/os_threading.h"
+
+#include "util/u_var.h"
+#include "util/u_misc.h"
+#include "util/u_debug.h"
+#include "util/u_format.h"
+#include "util/u_logging.h"
+#include "util/u_frame_pool.h"
+
+#include <assert.h>
+
+
+/*
+ *
+ * Defines.
+ *
+ */
+
+//! The smallest size class, 4 KiB.
+#define MIN_CLASS_SHIFT (12)
+
+//! Frames of this size or bigger, 1 GiB, are not pooled.
+#define MAX_CLASS_SHIFT (30)
+
+//! Each power of two is split into this many classes, bounds the waste to 25%.
+#define STEPS_PER_SHIFT (4)
+
+//! Number of classes for frames with data.
+#define DATA_CLASS_COUNT (1 + (MAX_CLASS_SHIFT - MIN_CLASS_SHIFT) * STEPS_PER_SHIFT)
+
+//! Frames without any data of their own, ROI frames.
+#define HEADER_CLASS (DATA_CLASS_COUNT)
+
+//! Total number of free lists.
+#define CLASS_COUNT (DATA_CLASS_COUNT + 1)
+
+//! Frames too big to be pooled.
+#define NO_CLASS (-1)
+
+//! Default number of unused frames per class.
+#define DEFAULT_MAX_FREE_PER_CLASS (4)
+
+DEBUG_GET_ONCE_NUM_OPTION(max_free_mb, "U_FRAME_POOL_MAX_FREE_MB", 64)
+
+
+/*
+ *
+ * Structs.
+ *
+ */
+
+struct pool;
+
+/*!
+ * A frame handed out by the pool, data and frame are recycled together.
+ */
+struct pool_frame
+{
+	struct xrt_frame base;
+
+	struct pool *p;
+
+	//! Next in the free list.
+	struct pool_frame *next;
+
+	//! Size of the allocation of data, can be bigger then base.size.
+	size_t capacity;
+
+	int32_t size_class;
+};
+
+/*!
+ * Main implementation of @ref u_frame_pool.
+ */
+struct pool
+{
+	struct u_frame_pool base;
+
+	//! Protects all fields below.
+	struct os_mutex mutex;
+
+	struct pool_frame *free_lists[CLASS_COUNT];
+	uint32_t free_counts[CLASS_COUNT];
+
+	uint32_t max_free_per_class;
+	uint64_t max_free_bytes;
+
+	struct u_frame_pool_stats stats;
+
+	//! All references are gone, waiting for frames to be released.
+	bool destroyed;
+
+	//! Have the stats been added to u_var.
+	bool vars_added;
+};
+
+/*!
+ * Ties a pool to a @ref xrt_frame_context.
+ *
+ * @implements xrt_frame_node
+ */
+struct pool_node
+{
+	struct xrt_frame_node node;
+
+	struct u_frame_pool *ufp;
+};
+
+static inline struct pool *
+pool(struct u_frame_pool *ufp)
+{
+	return (struct pool *)ufp;
+}
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+static uint32_t
+floor_log2(uint64_t v)
+{
+	uint32_t r = 0;
+	while (v >>= 1) {
+		r++;
+	}
+	return r;
+}
+
+/*!
+ * Returns the size class for a data size and the size of the allocation to
+ * make for it.
+ */
+static int32_t
+size_to_class(size_t size, size_t *out_capacity)
+{
+	if (size <= ((size_t)1 << MIN_CLASS_SHIFT)) {
+		*out_capacity = (size_t)1 << MIN_CLASS_SHIFT;
+		return 0;
+	}
+
+	// Round up within the power of two, 5/4, 6/4, 7/4 and 8/4.
+	uint64_t v = (uint64_t)size - 1;
+	uint32_t shift = floor_log2(v);
+	if (shift >= MAX_CLASS_SHIFT) {
+		*out_capacity = size;
+		return NO_CLASS;
+	}
+
+	uint64_t base = (uint64_t)1 << shift;
+	uint64_t step = base / STEPS_PER_SHIFT;
+	uint64_t sub = (v - base) / step;
+
+	*out_capacity = (size_t)(base + (sub + 1) * step);
+	return (int32_t)(1 + (shift - MIN_CLASS_SHIFT) * STEPS_PER_SHIFT + sub);
+}
+
+//! Must be called with the mutex held, returns frames to free in @p list.
+static void
+pool_take_all_free(struct pool *p, struct pool_frame **list)
+{
+	for (uint32_t i = 0; i < CLASS_COUNT; i++) {
+		struct pool_frame *pf = p->free_lists[i];
+		while (pf != NULL) {
+			struct pool_frame *next = pf->next;
+
+			p->stats.free_bytes -= pf->capacity;
+			p->stats.allocated_bytes -= pf->capacity;
+
+			pf->next = *list;
+			*list = pf;
+			pf = next;
+		}
+
+		p->free_lists[i] = NULL;
+		p->free_counts[i] = 0;
+	}
+}
+
+static void
+pool_frame_free_list(struct pool_frame *pf)
+{
+	while (pf != NULL) {
+		struct pool_frame *next = pf->next;
+		if (pf->size_class != HEADER_CLASS) {
+			free(pf->base.data);
+		}
+		free(pf);
+		pf = next;
+	}
+}
+
+static void
+pool_final_free(struct pool *p)
+{
+	os_mutex_destroy(&p->mutex);
+	free(p);
+}
+
+/*!
+ * Gets a frame of the given class, data is allocated if @p capacity is not
+ * zero. The returned frame has every field cleared except the data, returns
+ * NULL if it could not be allocated.
+ */
+static struct pool_frame *
+pool_get(struct pool *p, int32_t size_class, size_t capacity)
+{
+	struct pool_frame *pf = NULL;
+
+	os_mutex_lock(&p->mutex);
+
+	if (size_class != NO_CLASS && p->free_lists[size_class] != NULL) {
+		pf = p->free_lists[size_class];
+		p->free_lists[size_class] = pf->next;
+		p->free_counts[size_class]--;
+		p->stats.free_bytes -= pf->capacity;
+		p->stats.hits++;
+	} else {
+		p->stats.misses++;
+		p->stats.allocated_bytes += capacity;
+	}
+	p->stats.outstanding_frames++;
+
+	os_mutex_unlock(&p->mutex);
+
+	// Reset everything but the data.
+	if (pf != NULL) {
+		uint8_t *data = pf->base.data;
+		U_ZERO(&pf->base);
+		pf->base.data = data;
+		pf->next = NULL;
+		return pf;
+	}
+
+	pf = U_TYPED_CALLOC(struct pool_frame);
+	if (pf != NULL && capacity > 0) {
+		pf->base.data = (uint8_t *)malloc(capacity);
+		if (pf->base.data == NULL) {
+			free(pf);
+			pf = NULL;
+		}
+	}
+
+	if (pf == NULL) {
+		U_LOG_E("Failed to allocate frame of %zu bytes!", capacity);
+
+		os_mutex_lock(&p->mutex);
+		p->stats.allocated_bytes -= capacity;
+		p->stats.outstanding_frames--;
+		os_mutex_unlock(&p->mutex);
+
+		return NULL;
+	}
+
+	pf->p = p;
+	pf->capacity = capacity;
+	pf->size_class = size_class;
+
+	return pf;
+}
+
+static void
+pool_frame_release(struct xrt_frame *xf)
+{
+	assert(xf->reference.count == 0);
+
+	struct pool_frame *pf = (struct pool_frame *)xf;
+	struct pool *p = pf->p;
+
+	// ROI frames hold a reference to the frame they point into.
+	if (pf->size_class == HEADER_CLASS) {
+		xrt_frame_reference((struct xrt_frame **)&xf->owner, NULL);
+	}
+
+	os_mutex_lock(&p->mutex);
+
+	bool keep = !p->destroyed &&                                          //
+	            pf->size_class != NO_CLASS &&                             //
+	            p->free_counts[pf->size_class] < p->max_free_per_class && //
+	            p->stats.free_bytes + pf->capacity <= p->max_free_bytes;
+
+	if (keep) {
+		pf->next = p->free_lists[pf->size_class];
+		p->free_lists[pf->size_class] = pf;
+		p->free_counts[pf->size_class]++;
+		p->stats.free_bytes += pf->capacity;
+	} else {
+		p->stats.allocated_bytes -= pf->capacity;
+	}
+
+	p->stats.outstanding_frames--;
+	bool last = p->destroyed && p->stats.outstanding_frames == 0;
+
+	os_mutex_unlock(&p->mutex);
+
+	if (!keep) {
+		pf->next = NULL;
+		pool_frame_free_list(pf);
+	}
+
+	if (last) {
+		pool_final_free(p);
+	}
+}
+
+static void
+pool_add_vars(struct pool *p, const char *name)
+{
+	u_var_add_root(p, name, true);
+	u_var_add_ro_u64(p, &p->stats.hits, "Hits");
+	u_var_add_ro_u64(p, &p->stats.misses, "Misses");
+	u_var_add_ro_u64(p, &p->stats.outstanding_frames, "Frames in use");
+	u_var_add_ro_u64(p, &p->stats.allocated_bytes, "Allocated bytes");
+	u_var_add_ro_u64(p, &p->stats.free_bytes, "Unused bytes");
+	p->vars_added = true;
+}
+
+
+/*
+ *
+ * Frame context node.
+ *
+ */
+
+static void
+pool_node_break_apart(struct xrt_frame_node *node)
+{
+	// Nothing to do, frames might still be in flight.
+}
+
+static void
+pool_node_destroy(struct xrt_frame_node *node)
+{
+	struct pool_node *pn = container_of(node, struct pool_node, node);
+
+	u_frame_pool_reference(&pn->ufp, NULL);
+
+	free(pn);
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+struct u_frame_pool *
+u_frame_pool_create(uint32_t max_free_per_class, size_t max_free_bytes)
+{
+	struct pool *p = U_TYPED_CALLOC(struct pool);
+
+	int ret = os_mutex_init(&p->mutex);
+	if (ret != 0) {
+		free(p);
+		return NULL;
+	}
+
+	p->base.reference.count = 1;
+	p->max_free_per_class = max_free_per_class;
+	p->max_free_bytes = max_free_bytes;
+
+	return &p->base;
+}
+
+struct u_frame_pool *
+u_frame_pool_get_for_context(struct xrt_frame_context *xfctx)
+{
+	for (struct xrt_frame_node *node = xfctx->nodes; node != NULL; node = node->next) {
+		if (node->destroy == pool_node_destroy) {
+			struct pool_node *pn = container_of(node, struct pool_node, node);
+			return pn->ufp;
+		}
+	}
+
+	return NULL;
+}
+
+struct u_frame_pool *
+u_frame_pool_create_for_context(struct xrt_frame_context *xfctx)
+{
+	// Only one pool per context.
+	struct u_frame_pool *ufp = u_frame_pool_get_for_context(xfctx);
+	if (ufp != NULL) {
+		return ufp;
+	}
+
+	size_t max_free_bytes = (size_t)debug_get_num_option_max_free_mb() * 1024 * 1024;
+	ufp = u_frame_pool_create(DEFAULT_MAX_FREE_PER_CLASS, max_free_bytes);
+	if (ufp == NULL) {
+		return NULL;
+	}
+
+	pool_add_vars(pool(ufp), "Frame pool");
+
+	struct pool_node *pn = U_TYPED_CALLOC(struct pool_node);
+	pn->node.break_apart = pool_node_break_apart;
+	pn->node.destroy = pool_node_destroy;
+	pn->ufp = ufp; // Takes the creation reference.
+
+	xrt_frame_context_add(xfctx, &pn->node);
+
+	return ufp;
+}
+
+void
+u_frame_pool_create_frame(
+    struct u_frame_pool *ufp, enum xrt_format f, uint32_t width, uint32_t height, struct xrt_frame **out_frame)
+{
+	assert(width > 0);
+	assert(height > 0);
+	assert(u_format_is_blocks(f));
+
+	size_t stride = 0;
+	size_t size = 0;
+	u_format_size_for_dimensions(f, width, height, &stride, &size);
+
+	size_t capacity = 0;
+	int32_t size_class = size_to_class(size, &capacity);
+
+	struct pool_frame *pf = pool_get(pool(ufp), size_class, capacity);
+	if (pf == NULL) {
+		return;
+	}
+	struct xrt_frame *xf = &pf->base;
+
+	xf->destroy = pool_frame_release;
+	xf->format = f;
+	xf->width = width;
+	xf->height = height;
+	xf->stride = stride;
+	xf->size = size;
+
+	xrt_frame_reference(out_frame, xf);
+}
+
+void
+u_frame_pool_clone_frame(struct u_frame_pool *ufp, struct xrt_frame *to_copy, struct xrt_frame **out_frame)
+{
+	size_t capacity = 0;
+	int32_t size_class = size_to_class(to_copy->size, &capacity);
+
+	struct pool_frame *pf = pool_get(pool(ufp), size_class, capacity);
+	if (pf == NULL) {
+		return;
+	}
+	struct xrt_frame *xf = &pf->base;
+
+	// Explicitly only copy the fields we want
+	xf->width = to_copy->width;
+	xf->height = to_copy->height;
+	xf->stride = to_copy->stride;
+	xf->size = to_copy->size;
+
+	xf->format = to_copy->format;
+	xf->stereo_format = to_copy->stereo_format;
+
+	xf->timestamp = to_copy->timestamp;
+	xf->source_timestamp = to_copy->source_timestamp;
+	xf->source_sequence = to_copy->source_sequence;
+	xf->source_id = to_copy->source_id;
+
+	xf->destroy = pool_frame_release;
+
+	memcpy(xf->data, to_copy->data, xf->size);
+
+	xrt_frame_reference(out_frame, xf);
+}
+
+void
+u_frame_pool_create_roi(struct u_frame_pool *ufp,
+                        struct xrt_frame *original,
+                        struct xrt_rect roi,
+                        struct xrt_frame **out_frame)
+{
+	assert(roi.offset.w >= 0 && roi.offset.h >= 0 && roi.extent.w > 0 && roi.extent.h > 0);
+	uint32_t x = roi.offset.w;
+	uint32_t y = roi.offset.h;
+	uint32_t w = roi.extent.w;
+	uint32_t h = roi.extent.h;
+	assert(x + w <= original->width && y + h <= original->height);
+
+	// Calculate size and offset in bytes
+
+	// Block dimensions
+	uint32_t bw = u_format_block_width(original->format);
+	uint32_t bh = u_format_block_height(original->format);
+	size_t bsz = u_format_block_size(original->format);
+
+	// Only allow x and w to be multiples of bw (same with y, h, and bh)
+	assert(w % bw == 0 && x % bw == 0 && h % bh == 0 && y % bh == 0);
+
+	// x, y, w, and h in blocks
+	uint32_t xb = x / bw;
+	uint32_t yb = y / bh;
+	uint32_t wb = w / bw;
+	uint32_t hb = h / bh;
+
+	// Compute offset in bytes
+	size_t offset = yb * original->stride + xb * bsz;
+
+	// Compute exact size in original to hold the entire ROI
+	size_t start_margin = xb * bsz;
+	size_t end_margin = original->stride - ((xb + wb) * bsz);
+	size_t size = hb * original->stride - start_margin - end_margin;
+
+	// Create and fill in ROI frame
+
+	struct pool_frame *pf = pool_get(pool(ufp), HEADER_CLASS, 0);
+	if (pf == NULL) {
+		return;
+	}
+	struct xrt_frame *xf = &pf->base;
+
+	xf->destroy = pool_frame_release;
+	xrt_frame_reference((struct xrt_frame **)&xf->owner, original);
+
+	xf->width = w;
+	xf->height = h;
+	xf->stride = original->stride;
+	xf->size = size;
+	xf->data = original->data + offset;
+
+	xf->format = original->format;
+	xf->stereo_format = XRT_STEREO_FORMAT_NONE; // Explicitly not-stereo
+
+	xf->timestamp = original->timestamp;
+	xf->source_timestamp = original->source_timestamp;
+	xf->source_sequence = original->source_sequence;
+	xf->source_id = original->source_id;
+
+	xrt_frame_reference(out_frame, xf);
+}
+
+void
+u_frame_pool_get_stats(struct u_frame_pool *ufp, struct u_frame_pool_stats *out_stats)
+{
+	struct pool *p = pool(ufp);
+
+	os_mutex_lock(&p->mutex);
+	*out_stats = p->stats;
+	os_mutex_unlock(&p->mutex);
+}
+
+void
+u_frame_pool_trim(struct u_frame_pool *ufp)
+{
+	struct pool *p = pool(ufp);
+	struct pool_frame *list = NULL;
+
+	os_mutex_lock(&p->mutex);
+	pool_take_all_free(p, &list);
+	os_mutex_unlock(&p->mutex);
+
+	pool_frame_free_list(list);
+}
+
+void
+u_frame_pool_destroy(struct u_frame_pool *ufp)
+{
+	struct pool *p = pool(ufp);
+	struct pool_frame *list = NULL;
+
+	if (p->vars_added) {
+		u_var_remove_root(p);
+	}
+
+	os_mutex_lock(&p->mutex);
+	p->destroyed = true;
+	pool_take_all_free(p, &list);
+	bool last = p->stats.outstanding_frames == 0;
+	os_mutex_unlock(&p->mutex);
+
+	pool_frame_free_list(list);
+
+	// Otherwise the last frame to be released frees the pool.
+	if (last) {
+		pool_final_free(p);
+	}
+}
@@ -0,0 +1,186 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Pooled @ref xrt_frame allocator.
+ * @ingroup aux_util
+ */
+
+#pragma once
+
+#include "xrt/xrt_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*!
+ * A pool of frames, when the last reference to a frame from the pool is
+ * dropped its memory goes back to the pool instead of being freed.
+ *
+ * Frame memory is grouped into size classes, four per power of two, so a
+ * released frame can be reused for any frame of a similar size regardless of
+ * format or dimensions. Each class keeps a limited number of unused frames and
+ * the pool as a whole a limited number of unused bytes, anything over that is
+ * freed straight away.
+ *
+ * Frames handed out keep the pool alive, so a pool can be released while its
+ * frames are still held downstream, they are then freed once released.
+ *
+ * @ingroup aux_util
+ */
+struct u_frame_pool
+{
+	struct xrt_reference reference;
+};
+
+/*!
+ * Counters of a @ref u_frame_pool.
+ *
+ * @ingroup aux_util
+ */
+struct u_frame_pool_stats
+{
+	//! Frames handed out that reused memory from the pool.
+	uint64_t hits;
+
+	//! Frames handed out that had to allocate memory.
+	uint64_t misses;
+
+	//! Frames currently handed out and not yet released.
+	uint64_t outstanding_frames;
+
+	//! Bytes of frame data currently allocated, both in use and unused.
+	uint64_t allocated_bytes;
+
+	//! Bytes of frame data sitting unused in the pool.
+	uint64_t free_bytes;
+};
+
+/*!
+ * Create a new pool.
+ *
+ * @param max_free_per_class Unused frames kept for each size class.
+ * @param max_free_bytes     Unused frame data bytes kept in total.
+ *
+ * @public @memberof u_frame_pool
+ */
+struct u_frame_pool *
+u_frame_pool_create(uint32_t max_free_per_class, size_t max_free_bytes);
+
+/*!
+ * Opt the frame context in to pooling, creates the pool shared by all users
+ * of the context or returns the one already created. It is released when the
+ * nodes of the context are destroyed. The returned pointer is borrowed, take a
+ * reference if it is kept around.
+ *
+ * The amount of unused memory it keeps can be set with the
+ * `U_FRAME_POOL_MAX_FREE_MB` environment variable, 0 turns off recycling.
+ *
+ * Not thread safe, call while setting up the frame graph.
+ *
+ * @public @memberof u_frame_pool
+ */
+struct u_frame_pool *
+u_frame_pool_create_for_context(struct xrt_frame_context *xfctx);
+
+/*!
+ * Get the pool of the given frame context, NULL if the context has not been
+ * opted in with @ref u_frame_pool_create_for_context. The returned pointer is
+ * borrowed.
+ *
+ * Not thread safe, call while setting up the frame graph.
+ *
+ * @public @memberof u_frame_pool
+ */
+struct u_frame_pool *
+u_frame_pool_get_for_context(struct xrt_frame_context *xfctx);
+
+/*!
+ * Get a frame, the data is uninitialized and the other fields are set up the
+ * same way as @ref u_frame_create_one_off does. @p out_frame is left untouched
+ * if the frame could not be allocated.
+ *
+ * @public @memberof u_frame_pool
+ */
+void
+u_frame_pool_create_frame(
+    struct u_frame_pool *ufp, enum xrt_format f, uint32_t width, uint32_t height, struct xrt_frame **out_frame);
+
+/*!
+ * Get a frame and copy @p to_copy into it, see @ref u_frame_clone.
+ *
+ * @public @memberof u_frame_pool
+ */
+void
+u_frame_pool_clone_frame(struct u_frame_pool *ufp, struct xrt_frame *to_copy, struct xrt_frame **out_frame);
+
+/*!
+ * Get a frame that refers to a region of @p original, see
+ * @ref u_frame_create_roi. Only the frame itself comes from the pool.
+ *
+ * @public @memberof u_frame_pool
+ */
+void
+u_frame_pool_create_roi(struct u_frame_pool *ufp,
+                        struct xrt_frame *original,
+                        struct xrt_rect roi,
+                        struct xrt_frame **out_frame);
+
+/*!
+ * Get a snapshot of the counters.
+ *
+ * @public @memberof u_frame_pool
+ */
+void
+u_frame_pool_get_stats(struct u_frame_pool *ufp, struct u_frame_pool_stats *out_stats);
+
+/*!
+ * Free all unused frames in the pool.
+ *
+ * @public @memberof u_frame_pool
+ */
+void
+u_frame_pool_trim(struct u_frame_pool *ufp);
+
+/*!
+ * Frees all unused frames and stops recycling, frames still in use are freed
+ * when released. Called by @ref u_frame_pool_reference.
+ *
+ * @private @memberof u_frame_pool
+ */
+void
+u_frame_pool_destroy(struct u_frame_pool *ufp);
+
+/*!
+ * Standard Monado reference function.
+ *
+ * @public @memberof u_frame_pool
+ */
+static inline void
+u_frame_pool_reference(struct u_frame_pool **dst, struct u_frame_pool *src)
+{
+	struct u_frame_pool *old_dst = *dst;
+
+	if (old_dst == src) {
+		return;
+	}
+
+	if (src) {
+		xrt_reference_inc(&src->reference);
+	}
+
+	*dst = src;
+
+	if (old_dst) {
+		if (xrt_reference_dec(&old_dst->reference)) {
+			u_frame_pool_destroy(old_dst);
+		}
+	}
+}
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,4 +1,4 @@
-// Copyright 2019-2020, Collabora, Ltd.
+// Copyright 2019-2022, Collabora, Ltd.
 // SPDX-License-Identifier: BSL-1.0
 /*!
  * @file
@@ -10,9 +10,9 @@
 #include "util/u_misc.h"
 #include "util/u_hashset.h"
 
+#include <cstdint>
 #include <cstring>
-#include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 
@@ -22,11 +22,156 @@
  *
  */
 
+/*!
+ * Open addressing table of item pointers with linear probing, the items
+ * themselves hold the string and its hash so a lookup never allocates and
+ * only touches the string of items whose hash matches.
+ *
+ * Erased slots are marked with a tombstone so probe chains stay intact, they
+ * are reused by inserts and dropped when the table is rehashed.
+ */
 struct u_hashset
 {
-	std::unordered_map<std::string, struct u_hashset_item *> map = {};
+	std::vector<struct u_hashset_item *> slots = {};
+
+	//! Number of live items.
+	size_t count = 0;
+
+	//! Number of live items plus tombstones.
+	size_t used = 0;
 };
 
+#define MIN_SLOTS 64
+
+//! Marks an erased slot, never dereferenced.
+static struct u_hashset_item tombstone = {};
+#define TOMBSTONE (&tombstone)
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+static inline size_t
+hash_str(const char *str, size_t length)
+{
+	// Same function as math_hash_string.
+	return std::hash<std::string_view>{}(std::string_view(str, length));
+}
+
+static inline bool
+item_matches(struct u_hashset_item *item, size_t hash, const char *str, size_t length)
+{
+	return item->hash == hash && item->length == length && memcmp(item->c_str(), str, length) == 0;
+}
+
+/*!
+ * Returns the slot holding the string, or if not found the slot it should be
+ * inserted into, the first tombstone on the chain if there was one.
+ */
+static size_t
+find_slot(const struct u_hashset *hs, size_t hash, const char *str, size_t length, bool *out_found)
+{
+	const size_t mask = hs->slots.size() - 1;
+	size_t insert = SIZE_MAX;
+
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		struct u_hashset_item *item = hs->slots[i];
+
+		if (item == NULL) {
+			*out_found = false;
+			return insert != SIZE_MAX ? insert : i;
+		}
+
+		if (item == TOMBSTONE) {
+			if (insert == SIZE_MAX) {
+				insert = i;
+			}
+			continue;
+		}
+
+		if (item_matches(item, hash, str, length)) {
+			*out_found = true;
+			return i;
+		}
+	}
+}
+
+static void
+rehash(struct u_hashset *hs, size_t slot_count)
+{
+	std::vector<struct u_hashset_item *> old(slot_count, nullptr);
+	old.swap(hs->slots);
+
+	const size_t mask = slot_count - 1;
+	for (struct u_hashset_item *item : old) {
+		if (item == NULL || item == TOMBSTONE) {
+			continue;
+		}
+
+		size_t i = item->hash & mask;
+		while (hs->slots[i] != NULL) {
+			i = (i + 1) & mask;
+		}
+		hs->slots[i] = item;
+	}
+
+	hs->used = hs->count;
+}
+
+//! Keeps the load, tombstones included, at or below 3/4 for one more item.
+static void
+ensure_space_for_one(struct u_hashset *hs)
+{
+	size_t slot_count = hs->slots.size();
+	if ((hs->used + 1) * 4 <= slot_count * 3) {
+		return;
+	}
+
+	// Only grow if live items need it, otherwise just drop the tombstones.
+	if ((hs->count + 1) * 2 > slot_count) {
+		slot_count *= 2;
+	}
+
+	rehash(hs, slot_count);
+}
+
+static void
+insert_hashed(struct u_hashset *hs, struct u_hashset_item *item)
+{
+	ensure_space_for_one(hs);
+
+	bool found = false;
+	size_t i = find_slot(hs, item->hash, item->c_str(), item->length, &found);
+
+	if (found) {
+		// Replace the existing item.
+		hs->slots[i] = item;
+		return;
+	}
+
+	if (hs->slots[i] == NULL) {
+		hs->used++;
+	}
+	hs->slots[i] = item;
+	hs->count++;
+}
+
+static void
+erase_hashed(struct u_hashset *hs, size_t hash, const char *str, size_t length)
+{
+	bool found = false;
+	size_t i = find_slot(hs, hash, str, length, &found);
+	if (!found) {
+		return;
+	}
+
+	hs->slots[i] = TOMBSTONE;
+	hs->count--;
+}
+
 
 /*
  *
@@ -38,6 +183,7 @@ extern "C" int
 u_hashset_create(struct u_hashset **out_hashset)
 {
 	auto *hs = new u_hashset;
+	hs->slots.resize(MIN_SLOTS, nullptr);
 	*out_hashset = hs;
 	return 0;
 }
@@ -53,11 +199,11 @@ u_hashset_destroy(struct u_hashset **hs)
 extern "C" int
 u_hashset_find_str(struct u_hashset *hs, const char *str, size_t length, struct u_hashset_item **out_item)
 {
-	std::string key = std::string(str, length);
-	auto search = hs->map.find(key);
+	bool found = false;
+	size_t i = find_slot(hs, hash_str(str, length), str, length, &found);
 
-	if (search != hs->map.end()) {
-		*out_item = search->second;
+	if (found) {
+		*out_item = hs->slots[i];
 		return 0;
 	}
 	return -1;
@@ -73,21 +219,21 @@ u_hashset_find_c_str(struct u_hashset *hs, const char *c_str, struct u_hashset_i
 extern "C" int
 u_hashset_insert_item(struct u_hashset *hs, struct u_hashset_item *item)
 {
-	std::string key = std::string(item->c_str(), item->length);
-	hs->map[key] = item;
+	item->hash = hash_str(item->c_str(), item->length);
+	insert_hashed(hs, item);
 	return 0;
 }
 
 extern "C" int
 u_hashset_create_and_insert_str(struct u_hashset *hs, const char *str, size_t length, struct u_hashset_item **out_item)
 {
-	struct u_hashset_item *unused = NULL;
 	struct u_hashset_item *item = NULL;
+	size_t hash = hash_str(str, length);
 	size_t size = 0;
-	int ret;
+	bool found = false;
 
-	ret = u_hashset_find_str(hs, str, length, &unused);
-	if (ret >= 0) {
+	find_slot(hs, hash, str, length, &found);
+	if (found) {
 		return -1;
 	}
 
@@ -101,16 +247,14 @@ u_hashset_create_and_insert_str(struct u_hashset *hs, const char *str, size_t le
 		return -1;
 	}
 
+	item->hash = hash;
 	item->length = length;
 	// Yes a const cast! D:
 	char *store = const_cast<char *>(item->c_str());
-	for (size_t i = 0; i < length; i++) {
-		store[i] = str[i];
-	}
+	memcpy(store, str, length);
 	store[length] = '\0';
 
-	std::string key = std::string(item->c_str(), item->length);
-	hs->map[key] = item;
+	insert_hashed(hs, item);
 
 	*out_item = item;
 
@@ -127,16 +271,14 @@ u_hashset_create_and_insert_str_c(struct u_hashset *hs, const char *c_str, struc
 extern "C" int
 u_hashset_erase_item(struct u_hashset *hs, struct u_hashset_item *item)
 {
-	std::string key = std::string(item->c_str(), item->length);
-	hs->map.erase(key);
+	erase_hashed(hs, item->hash, item->c_str(), item->length);
 	return 0;
 }
 
 extern "C" int
 u_hashset_erase_str(struct u_hashset *hs, const char *str, size_t length)
 {
-	std::string key = std::string(str, length);
-	hs->map.erase(key);
+	erase_hashed(hs, hash_str(str, length), str, length);
 	return 0;
 }
 
@@ -151,13 +293,17 @@ extern "C" void
 u_hashset_clear_and_call_for_each(struct u_hashset *hs, u_hashset_callback cb, void *priv)
 {
 	std::vector<struct u_hashset_item *> tmp;
-	tmp.reserve(hs->map.size());
+	tmp.reserve(hs->count);
 
-	for (auto &n : hs->map) {
-		tmp.push_back(n.second);
+	for (struct u_hashset_item *item : hs->slots) {
+		if (item != NULL && item != TOMBSTONE) {
+			tmp.push_back(item);
+		}
 	}
 
-	hs->map.clear();
+	hs->slots.assign(MIN_SLOTS, nullptr);
+	hs->count = 0;
+	hs->used = 0;
 
 	for (auto *n : tmp) {
 		cb(n, priv);
@@ -35,6 +35,7 @@ struct u_hashset;
  */
 struct u_hashset_item
 {
+	//! Hash of the string, filled in by the hashset when the item is inserted.
 	size_t hash;
 	size_t length;
 
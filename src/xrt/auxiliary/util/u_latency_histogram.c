@@ -0,0 +1,153 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Log scale histogram for latencies.
+ * @ingroup aux_util
+ */
+
+#include "util/u_latency_histogram.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+#define SUB_BITS 2 // log2 of U_LATENCY_HISTOGRAM_SUB_BUCKETS
+
+static_assert((1 << SUB_BITS) == U_LATENCY_HISTOGRAM_SUB_BUCKETS, "Sub bucket bits");
+
+static inline uint32_t
+highest_bit(uint64_t v)
+{
+#if defined(__GNUC__)
+	return 63 - (uint32_t)__builtin_clzll(v);
+#else
+	uint32_t bit = 0;
+	while (v >>= 1) {
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+static void
+print_ns(char *buf, size_t size, uint64_t ns)
+{
+	if (ns < 1000) {
+		snprintf(buf, size, "%uns", (uint32_t)ns);
+	} else if (ns < 1000 * 1000) {
+		snprintf(buf, size, "%.1fus", (double)ns / 1000.0);
+	} else {
+		snprintf(buf, size, "%.2fms", (double)ns / (1000.0 * 1000.0));
+	}
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+uint32_t
+u_latency_histogram_bucket_index(uint64_t value_ns)
+{
+	if (value_ns < (1ull << U_LATENCY_HISTOGRAM_MIN_SHIFT)) {
+		return 0;
+	}
+
+	uint32_t bit = highest_bit(value_ns);
+	uint32_t sub = (uint32_t)(value_ns >> (bit - SUB_BITS)) & (U_LATENCY_HISTOGRAM_SUB_BUCKETS - 1);
+	uint32_t index = 1 + (bit - U_LATENCY_HISTOGRAM_MIN_SHIFT) * U_LATENCY_HISTOGRAM_SUB_BUCKETS + sub;
+
+	if (index >= U_LATENCY_HISTOGRAM_BUCKET_COUNT) {
+		return U_LATENCY_HISTOGRAM_BUCKET_COUNT - 1;
+	}
+
+	return index;
+}
+
+uint64_t
+u_latency_histogram_bucket_max(uint32_t index)
+{
+	if (index == 0) {
+		return (1ull << U_LATENCY_HISTOGRAM_MIN_SHIFT) - 1;
+	}
+	if (index >= U_LATENCY_HISTOGRAM_BUCKET_COUNT - 1) {
+		return UINT64_MAX;
+	}
+
+	uint32_t bit = (index - 1) / U_LATENCY_HISTOGRAM_SUB_BUCKETS + U_LATENCY_HISTOGRAM_MIN_SHIFT;
+	uint64_t sub = (index - 1) % U_LATENCY_HISTOGRAM_SUB_BUCKETS;
+
+	// The next bucket starts right after this one.
+	return ((U_LATENCY_HISTOGRAM_SUB_BUCKETS + sub + 1) << (bit - SUB_BITS)) - 1;
+}
+
+void
+u_latency_histogram_add(struct u_latency_histogram *ulh, uint64_t value_ns)
+{
+	ulh->buckets[u_latency_histogram_bucket_index(value_ns)]++;
+	ulh->count++;
+	ulh->total_ns += value_ns;
+	if (value_ns > ulh->max_ns) {
+		ulh->max_ns = value_ns;
+	}
+}
+
+void
+u_latency_histogram_merge(struct u_latency_histogram *dst, const struct u_latency_histogram *src)
+{
+	for (uint32_t i = 0; i < U_LATENCY_HISTOGRAM_BUCKET_COUNT; i++) {
+		dst->buckets[i] += src->buckets[i];
+	}
+	dst->count += src->count;
+	dst->total_ns += src->total_ns;
+	if (src->max_ns > dst->max_ns) {
+		dst->max_ns = src->max_ns;
+	}
+}
+
+uint64_t
+u_latency_histogram_get_percentile(const struct u_latency_histogram *ulh, double fraction)
+{
+	if (ulh->count == 0) {
+		return 0;
+	}
+
+	// The rank of the value we are looking for, at least the first one.
+	uint64_t rank = (uint64_t)(fraction * (double)ulh->count + 0.5);
+	if (rank < 1) {
+		rank = 1;
+	}
+
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < U_LATENCY_HISTOGRAM_BUCKET_COUNT; i++) {
+		seen += ulh->buckets[i];
+		if (seen >= rank) {
+			uint64_t max = u_latency_histogram_bucket_max(i);
+			return max < ulh->max_ns ? max : ulh->max_ns;
+		}
+	}
+
+	return ulh->max_ns;
+}
+
+int
+u_latency_histogram_snprint(const struct u_latency_histogram *ulh, char *buf, size_t size)
+{
+	char p50[32], p99[32], p999[32], max[32];
+	print_ns(p50, sizeof(p50), u_latency_histogram_get_percentile(ulh, 0.5));
+	print_ns(p99, sizeof(p99), u_latency_histogram_get_percentile(ulh, 0.99));
+	print_ns(p999, sizeof(p999), u_latency_histogram_get_percentile(ulh, 0.999));
+	print_ns(max, sizeof(max), ulh->max_ns);
+
+	return snprintf(buf, size, "n %llu, p50 %s, p99 %s, p999 %s, max %s", (unsigned long long)ulh->count, p50,
+	                p99, p999, max);
+}
@@ -0,0 +1,104 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Log scale histogram for latencies.
+ * @ingroup aux_util
+ */
+
+#pragma once
+
+#include "xrt/xrt_compiler.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+//! Everything below 256ns goes into the first bucket.
+#define U_LATENCY_HISTOGRAM_MIN_SHIFT 8
+
+//! Buckets per power of two.
+#define U_LATENCY_HISTOGRAM_SUB_BUCKETS 4
+
+//! Up to 2^34ns, about 17 seconds, anything longer goes into the last bucket.
+#define U_LATENCY_HISTOGRAM_BUCKET_COUNT (2 + (34 - U_LATENCY_HISTOGRAM_MIN_SHIFT) * U_LATENCY_HISTOGRAM_SUB_BUCKETS)
+
+/*!
+ * A histogram of latencies with buckets on a log scale, four per power of two,
+ * so percentiles are within 25% of the real value. Adding a value is cheap and
+ * never allocates, so it can be used on hot paths.
+ *
+ * Not thread safe, use one per thread and merge them.
+ *
+ * @ingroup aux_util
+ */
+struct u_latency_histogram
+{
+	uint64_t buckets[U_LATENCY_HISTOGRAM_BUCKET_COUNT];
+
+	//! Number of values added.
+	uint64_t count;
+
+	//! Sum of all values added.
+	uint64_t total_ns;
+
+	//! Largest value added.
+	uint64_t max_ns;
+};
+
+/*!
+ * Add a value.
+ *
+ * @public @memberof u_latency_histogram
+ */
+void
+u_latency_histogram_add(struct u_latency_histogram *ulh, uint64_t value_ns);
+
+/*!
+ * Add all of the values of @p src to @p dst.
+ *
+ * @public @memberof u_latency_histogram
+ */
+void
+u_latency_histogram_merge(struct u_latency_histogram *dst, const struct u_latency_histogram *src);
+
+/*!
+ * Get the value below which the given fraction, 0 to 1, of the values are.
+ * Returns the upper bound of the bucket it falls in, but never more than the
+ * largest value added. Returns 0 if empty.
+ *
+ * @public @memberof u_latency_histogram
+ */
+uint64_t
+u_latency_histogram_get_percentile(const struct u_latency_histogram *ulh, double fraction);
+
+/*!
+ * Get the bucket a value goes in.
+ *
+ * @public @memberof u_latency_histogram
+ */
+uint32_t
+u_latency_histogram_bucket_index(uint64_t value_ns);
+
+/*!
+ * Get the largest value that goes in the given bucket.
+ *
+ * @public @memberof u_latency_histogram
+ */
+uint64_t
+u_latency_histogram_bucket_max(uint32_t index);
+
+/*!
+ * Print a one line summary, count and p50/p99/p999, into @p buf.
+ *
+ * @public @memberof u_latency_histogram
+ */
+int
+u_latency_histogram_snprint(const struct u_latency_histogram *ulh, char *buf, size_t size);
+
+
+#ifdef __cplusplus
+}
+#endif
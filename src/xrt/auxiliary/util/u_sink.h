@@ -19,6 +19,8 @@
 extern "C" {
 #endif
 
+struct u_worker_thread_pool;
+
 /*!
  * @see u_sink_quirk_create
  */
@@ -39,6 +41,23 @@ u_sink_create_format_converter(struct xrt_frame_context *xfctx,
                                struct xrt_frame_sink *downstream,
                                struct xrt_frame_sink **out_xfs);
 
+/*!
+ * Same as @ref u_sink_create_format_converter but splits the rows of each
+ * frame into bands that are converted on @p uwtp, the pushing thread helps out
+ * and the frame is pushed downstream once all bands are done. The number of
+ * bands is controlled with the `U_SINK_CONVERTER_BANDS` environment variable.
+ * If @p uwtp is NULL this is the same as the non-threaded version.
+ *
+ * @public @memberof xrt_frame_sink
+ * @see xrt_frame_context
+ */
+void
+u_sink_create_format_converter_threaded(struct xrt_frame_context *xfctx,
+                                        enum xrt_format f,
+                                        struct u_worker_thread_pool *uwtp,
+                                        struct xrt_frame_sink *downstream,
+                                        struct xrt_frame_sink **out_xfs);
+
 /*!
  * @public @memberof xrt_frame_sink
  * @see xrt_frame_context
@@ -9,11 +9,20 @@
  */
 
 #include "xrt/xrt_config_have.h"
+#include "os/os_time.h"
+#include "math/m_api.h"
+#include "util/u_var.h"
+#include "util/u_time.h"
+#include "util/u_debug.h"
+#include "util/u_duration_stats.h"
 #include "util/u_logging.h"
 #include "util/u_misc.h"
 #include "util/u_sink.h"
 #include "util/u_frame.h"
+#include "util/u_frame_pool.h"
 #include "util/u_format.h"
+#include "util/u_format_convert.h"
+#include "util/u_worker.h"
 #include "util/u_trace_marker.h"
 
 #include <stdio.h>
@@ -29,6 +38,14 @@
  *
  */
 
+//! Don't bother splitting up bands smaller than this.
+#define MIN_BAND_ROWS (16)
+
+DEBUG_GET_ONCE_NUM_OPTION(band_count, "U_SINK_CONVERTER_BANDS", 8)
+
+typedef void (*convert_rows_func_t)(
+    struct xrt_frame *dst_frame, uint32_t w, uint32_t y_start, uint32_t y_end, size_t stride, const uint8_t *data);
+
 /*!
  * An @ref xrt_frame_sink that converts frames.
  * @implements xrt_frame_sink
@@ -42,6 +59,36 @@ struct u_sink_converter
 	struct xrt_frame_sink *downstream;
 
 	enum xrt_format format;
+
+	//! Pool of the frame context if it has one, converted frames are then recycled.
+	struct u_frame_pool *frame_pool;
+
+	//! If not NULL the rows of a frame are converted in bands on this group.
+	struct u_worker_group *group;
+
+	//! How many bands to split each frame into.
+	uint32_t band_count;
+
+	struct
+	{
+		//! Have the variables been added to u_var.
+		bool added;
+
+		//! Time spent converting each frame.
+		struct u_duration_stats conversion;
+	} stats;
+};
+
+/*!
+ * A frame being converted, shared by all row bands.
+ */
+struct convert_rows_args
+{
+	convert_rows_func_t func;
+	struct xrt_frame *dst_frame;
+	uint32_t w;
+	size_t stride;
+	const uint8_t *data;
 };
 
 
@@ -52,19 +99,15 @@ struct u_sink_converter
  */
 
 static void
-from_L8_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
+from_L8_to_R8G8B8(
+    struct xrt_frame *dst_frame, uint32_t w, uint32_t y_start, uint32_t y_end, size_t stride, const uint8_t *data)
 {
 	SINK_TRACE_MARKER();
 
-	for (uint32_t y = 0; y < h; y++) {
-		for (uint32_t x = 0; x < w; x += 1) {
-			const uint8_t *src = data;
-			uint8_t *dst = dst_frame->data;
+	u_format_convert_row_func_t func = u_format_convert_get_best()->l8_to_r8g8b8;
 
-			src = src + (y * stride) + x;
-			dst = dst + (y * dst_frame->stride) + (x * 3);
-			dst[2] = dst[1] = dst[0] = src[0];
-		}
+	for (uint32_t y = y_start; y < y_end; y++) {
+		func(data + (y * stride), dst_frame->data + (y * dst_frame->stride), w);
 	}
 }
 
@@ -75,209 +118,55 @@ from_L8_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t st
  *
  */
 
-static inline int
-clamp_to_byte(int v)
-{
-	if (v < 0) {
-		return 0;
-	}
-	if (v >= 255) {
-		return 255;
-	}
-	return v;
-}
-
-static inline uint32_t
-YUV444_to_RGBX8888(int y, int u, int v)
-{
-	int C = y - 16;
-	int D = u - 128;
-	int E = v - 128;
-
-	int R = clamp_to_byte((298 * C + 409 * E + 128) >> 8);
-	int G = clamp_to_byte((298 * C - 100 * D - 209 * E + 128) >> 8);
-	int B = clamp_to_byte((298 * C + 516 * D + 128) >> 8);
-
-	return B << 16 | G << 8 | R;
-}
-
-#undef USE_TABLE
-#ifdef USE_TABLE
-static uint32_t lookup_YUV_to_RGBX[256][256][256] = {0};
-
-static void
-generate_lookup_YUV_to_RGBX()
-{
-	if (lookup_YUV_to_RGBX[255][255][255] != 0) {
-		return;
-	}
-
-	int y;
-	int u;
-	int v;
-
-	for (y = 0; y < 256; y++) {
-		for (u = 0; u < 256; u++) {
-			for (v = 0; v < 256; v++) {
-				lookup_YUV_to_RGBX[y][u][v] = YUV444_to_RGBX8888(y, u, v);
-			}
-		}
-	}
-}
-#endif
-
-XRT_MAYBE_UNUSED inline static void
-YUYV422_to_R8G8B8X8(const uint8_t *input, uint32_t *rgb1, uint32_t *rgb2)
-{
-	uint8_t y0 = input[0];
-	uint8_t u = input[1];
-	uint8_t y1 = input[2];
-	uint8_t v = input[3];
-
-#ifdef USE_TABLE
-	*rgb1 = lookup_YUV_to_RGBX[y0][u][v];
-	*rgb2 = lookup_YUV_to_RGBX[y1][u][v];
-#else
-	*rgb1 = YUV444_to_RGBX8888(y0, u, v);
-	*rgb2 = YUV444_to_RGBX8888(y1, u, v);
-#endif
-}
-
-inline static void
-YUYV422_to_R8G8B8(const uint8_t *input, uint8_t *dst)
-{
-	uint8_t y0 = input[0];
-	uint8_t u = input[1];
-	uint8_t y1 = input[2];
-	uint8_t v = input[3];
-
-#ifdef USE_TABLE
-	uint8_t *rgb1 = (uint8_t *)&lookup_YUV_to_RGBX[y0][u][v];
-	uint8_t *rgb2 = (uint8_t *)&lookup_YUV_to_RGBX[y1][u][v];
-#else
-	uint32_t rgb1v = YUV444_to_RGBX8888(y0, u, v);
-	uint32_t rgb2v = YUV444_to_RGBX8888(y1, u, v);
-	uint8_t *rgb1 = (uint8_t *)&rgb1v;
-	uint8_t *rgb2 = (uint8_t *)&rgb2v;
-#endif
-
-	dst[0] = rgb1[0];
-	dst[1] = rgb1[1];
-	dst[2] = rgb1[2];
-	dst[3] = rgb2[0];
-	dst[4] = rgb2[1];
-	dst[5] = rgb2[2];
-}
-
-inline static void
-UYVY422_to_R8G8B8(const uint8_t *input, uint8_t *dst)
-{
-	uint8_t u = input[0];
-	uint8_t y0 = input[1];
-	uint8_t v = input[2];
-	uint8_t y1 = input[3];
-
-#ifdef USE_TABLE
-	uint8_t *rgb1 = (uint8_t *)&lookup_YUV_to_RGBX[y0][u][v];
-	uint8_t *rgb2 = (uint8_t *)&lookup_YUV_to_RGBX[y1][u][v];
-#else
-	uint32_t rgb1v = YUV444_to_RGBX8888(y0, u, v);
-	uint32_t rgb2v = YUV444_to_RGBX8888(y1, u, v);
-	uint8_t *rgb1 = (uint8_t *)&rgb1v;
-	uint8_t *rgb2 = (uint8_t *)&rgb2v;
-#endif
-
-	dst[0] = rgb1[0];
-	dst[1] = rgb1[1];
-	dst[2] = rgb1[2];
-	dst[3] = rgb2[0];
-	dst[4] = rgb2[1];
-	dst[5] = rgb2[2];
-}
-
-inline static void
-YUV444_to_R8G8B8(const uint8_t *input, uint8_t *dst)
-{
-	uint8_t y = input[0];
-	uint8_t u = input[1];
-	uint8_t v = input[2];
-
-#ifdef USE_TABLE
-	uint8_t *rgb = (uint8_t *)&lookup_YUV_to_RGBX[y][u][v];
-#else
-	uint32_t rgbv = YUV444_to_RGBX8888(y, u, v);
-	uint8_t *rgb = (uint8_t *)&rgbv;
-#endif
-
-	dst[0] = rgb[0];
-	dst[1] = rgb[1];
-	dst[2] = rgb[2];
-}
-
 static void
-from_YUYV422_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
+from_YUYV422_to_R8G8B8(
+    struct xrt_frame *dst_frame, uint32_t w, uint32_t y_start, uint32_t y_end, size_t stride, const uint8_t *data)
 {
 	SINK_TRACE_MARKER();
 
-	for (uint32_t y = 0; y < h; y++) {
-		for (uint32_t x = 0; x < w; x += 2) {
-			const uint8_t *src = data;
-			uint8_t *dst = dst_frame->data;
+	u_format_convert_row_func_t func = u_format_convert_get_best()->yuyv422_to_r8g8b8;
 
-			src = src + (y * stride) + (x * 2);
-			dst = dst + (y * dst_frame->stride) + (x * 3);
-			YUYV422_to_R8G8B8(src, dst);
-		}
+	for (uint32_t y = y_start; y < y_end; y++) {
+		func(data + (y * stride), dst_frame->data + (y * dst_frame->stride), w);
 	}
 }
 
 static void
-from_YUYV422_to_L8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
+from_YUYV422_to_L8(
+    struct xrt_frame *dst_frame, uint32_t w, uint32_t y_start, uint32_t y_end, size_t stride, const uint8_t *data)
 {
 	SINK_TRACE_MARKER();
 
-	for (uint32_t y = 0; y < h; y++) {
-		const uint8_t *src = data + (y * stride);
-		uint8_t *dst = dst_frame->data + (y * dst_frame->stride);
+	u_format_convert_row_func_t func = u_format_convert_get_best()->yuyv422_to_l8;
 
-		for (uint32_t x = 0; x < w; x++) {
-			dst[x] = src[x * 2];
-		}
+	for (uint32_t y = y_start; y < y_end; y++) {
+		func(data + (y * stride), dst_frame->data + (y * dst_frame->stride), w);
 	}
 }
 
 static void
-from_UYVY422_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
+from_UYVY422_to_R8G8B8(
+    struct xrt_frame *dst_frame, uint32_t w, uint32_t y_start, uint32_t y_end, size_t stride, const uint8_t *data)
 {
 	SINK_TRACE_MARKER();
 
-	for (uint32_t y = 0; y < h; y++) {
-		for (uint32_t x = 0; x < w; x += 2) {
-			const uint8_t *src = data;
-			uint8_t *dst = dst_frame->data;
+	u_format_convert_row_func_t func = u_format_convert_get_best()->uyvy422_to_r8g8b8;
 
-			src = src + (y * stride) + (x * 2);
-			dst = dst + (y * dst_frame->stride) + (x * 3);
-			UYVY422_to_R8G8B8(src, dst);
-		}
+	for (uint32_t y = y_start; y < y_end; y++) {
+		func(data + (y * stride), dst_frame->data + (y * dst_frame->stride), w);
 	}
 }
 
-
 static void
-from_YUV888_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
+from_YUV888_to_R8G8B8(
+    struct xrt_frame *dst_frame, uint32_t w, uint32_t y_start, uint32_t y_end, size_t stride, const uint8_t *data)
 {
 	SINK_TRACE_MARKER();
 
-	for (uint32_t y = 0; y < h; y++) {
-		for (uint32_t x = 0; x < w; x++) {
-			const uint8_t *src = data;
-			uint8_t *dst = dst_frame->data;
+	u_format_convert_row_func_t func = u_format_convert_get_best()->yuv888_to_r8g8b8;
 
-			src = src + (y * stride) + (x * 3);
-			dst = dst + (y * dst_frame->stride) + (x * 3);
-			YUV444_to_R8G8B8(src, dst);
-		}
+	for (uint32_t y = y_start; y < y_end; y++) {
+		func(data + (y * stride), dst_frame->data + (y * dst_frame->stride), w);
 	}
 }
 
@@ -398,35 +287,17 @@ from_MJPEG_to_YUV888(struct xrt_frame *dst_frame, size_t size, const uint8_t *da
  */
 
 static void
-from_BAYER_GR8_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
+from_BAYER_GR8_to_R8G8B8(
+    struct xrt_frame *dst_frame, uint32_t w, uint32_t y_start, uint32_t y_end, size_t stride, const uint8_t *data)
 {
 	SINK_TRACE_MARKER();
 
-	const uint8_t *src_data = data;
-	size_t src_stride = stride;
-
-	uint8_t *dst_data = dst_frame->data;
-	size_t dst_stride = dst_frame->stride;
-
-	for (uint32_t y = 0; y < h; y++) {
-		const uint8_t *src0 = src_data + (y * 2) * src_stride;
-		const uint8_t *src1 = src_data + (y * 2 + 1) * src_stride;
-		uint8_t *dst = dst_data + (y * dst_stride);
+	u_format_convert_bayer_row_func_t func = u_format_convert_get_best()->bayer_gr8_to_r8g8b8;
 
-		for (uint32_t x = 0; x < w; x++) {
-			uint8_t g0 = src0[0];
-			uint8_t r = src0[1];
-			uint8_t b = src1[0];
-			uint8_t g1 = src1[1];
-
-			dst[0] = r;
-			dst[1] = (g0 + g1) / 2;
-			dst[2] = b;
-
-			src0 += 2;
-			src1 += 2;
-			dst += 3;
-		}
+	for (uint32_t y = y_start; y < y_end; y++) {
+		const uint8_t *src0 = data + (y * 2) * stride;
+		const uint8_t *src1 = data + (y * 2 + 1) * stride;
+		func(src0, src1, dst_frame->data + (y * dst_frame->stride), w);
 	}
 }
 
@@ -438,17 +309,63 @@ from_BAYER_GR8_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, si
  */
 
 
+static void
+convert_band_task(void *ptr, uint32_t y_start, uint32_t y_end)
+{
+	SINK_TRACE_MARKER();
+
+	struct convert_rows_args *args = (struct convert_rows_args *)ptr;
+	args->func(args->dst_frame, args->w, y_start, y_end, args->stride, args->data);
+}
+
+/*!
+ * Converts all rows of a frame, split into bands over the worker group if the
+ * converter has one. Returns once all rows have been converted.
+ */
+static void
+convert_rows(struct u_sink_converter *s,
+             convert_rows_func_t func,
+             struct xrt_frame *dst_frame,
+             uint32_t w,
+             uint32_t h,
+             size_t stride,
+             const uint8_t *data)
+{
+	struct convert_rows_args args = {func, dst_frame, w, stride, data};
+	u_worker_group_for_bands(s->group, h, s->band_count, MIN_BAND_ROWS, convert_band_task, &args);
+}
+
+/*!
+ * Records how long the conversion took and hands the frame downstream.
+ */
+static void
+push_converted(struct u_sink_converter *s, struct xrt_frame **converted_ptr, uint64_t start_ns)
+{
+	u_duration_stats_add(&s->stats.conversion, os_monotonic_get_ns() - start_ns);
+
+	s->downstream->push_frame(s->downstream, *converted_ptr);
+
+	// Refcount in case it's being held downstream.
+	xrt_frame_reference(converted_ptr, NULL);
+}
+
 /*!
  * Creates a frame that the conversion should happen to, allows to set the size.
- *
- * @todo Allocate from a pool of frames.
  */
 static bool
-create_frame_with_format_of_size(
-    struct xrt_frame *xf, uint32_t w, uint32_t h, enum xrt_format format, struct xrt_frame **out_frame)
+create_frame_with_format_of_size(struct u_sink_converter *s,
+                                 struct xrt_frame *xf,
+                                 uint32_t w,
+                                 uint32_t h,
+                                 enum xrt_format format,
+                                 struct xrt_frame **out_frame)
 {
 	struct xrt_frame *frame = NULL;
-	u_frame_create_one_off(format, w, h, &frame);
+	if (s->frame_pool != NULL) {
+		u_frame_pool_create_frame(s->frame_pool, format, w, h, &frame);
+	} else {
+		u_frame_create_one_off(format, w, h, &frame);
+	}
 	if (frame == NULL) {
 		U_LOG_E("Failed to create target frame!");
 		*out_frame = NULL;
@@ -470,9 +387,12 @@ create_frame_with_format_of_size(
  * Creates a frame that the conversion should happen to.
  */
 static bool
-create_frame_with_format(struct xrt_frame *xf, enum xrt_format format, struct xrt_frame **out_frame)
+create_frame_with_format(struct u_sink_converter *s,
+                         struct xrt_frame *xf,
+                         enum xrt_format format,
+                         struct xrt_frame **out_frame)
 {
-	return create_frame_with_format_of_size(xf, xf->width, xf->height, format, out_frame);
+	return create_frame_with_format_of_size(s, xf, xf->width, xf->height, format, out_frame);
 }
 
 static void
@@ -481,24 +401,22 @@ convert_frame_l8(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 	SINK_TRACE_MARKER();
 
 	struct u_sink_converter *s = (struct u_sink_converter *)xs;
+	uint64_t start_ns = os_monotonic_get_ns();
 
 	struct xrt_frame *converted = NULL;
 
 	switch (xf->format) {
 	case XRT_FORMAT_L8: s->downstream->push_frame(s->downstream, xf); return;
 	case XRT_FORMAT_YUYV422:
-		if (!create_frame_with_format(xf, XRT_FORMAT_L8, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_L8, &converted)) {
 			return;
 		}
-		from_YUYV422_to_L8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_YUYV422_to_L8, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	default: U_LOG_E("Can not convert from '%s' to L8!", u_format_str(xf->format)); return;
 	}
 
-	s->downstream->push_frame(s->downstream, converted);
-
-	// Refcount in case it's being held downstream.
-	xrt_frame_reference(&converted, NULL);
+	push_converted(s, &converted, start_ns);
 }
 
 static void
@@ -507,6 +425,7 @@ convert_frame_r8g8b8_or_l8(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 	SINK_TRACE_MARKER();
 
 	struct u_sink_converter *s = (struct u_sink_converter *)xs;
+	uint64_t start_ns = os_monotonic_get_ns();
 
 	struct xrt_frame *converted = NULL;
 
@@ -516,32 +435,32 @@ convert_frame_r8g8b8_or_l8(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 	case XRT_FORMAT_BAYER_GR8:;
 		uint32_t w = xf->width / 2;
 		uint32_t h = xf->height / 2;
-		if (!create_frame_with_format_of_size(xf, w, h, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format_of_size(s, xf, w, h, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_BAYER_GR8_to_R8G8B8(converted, w, h, xf->stride, xf->data);
+		convert_rows(s, from_BAYER_GR8_to_R8G8B8, converted, w, h, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_YUYV422:
-		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUYV422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_YUYV422_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_UYVY422:
-		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_UYVY422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_UYVY422_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_YUV888:
-		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUV888_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_YUV888_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 #ifdef XRT_HAVE_JPEG
 	case XRT_FORMAT_MJPEG:
-		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
 		if (!from_MJPEG_to_R8G8B8(converted, xf->size, xf->data)) {
@@ -554,10 +473,7 @@ convert_frame_r8g8b8_or_l8(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 	default: U_LOG_E("Can not convert from '%s' to R8G8B8 or L8!", u_format_str(xf->format)); return;
 	}
 
-	s->downstream->push_frame(s->downstream, converted);
-
-	// Refcount in case it's being held downstream.
-	xrt_frame_reference(&converted, NULL);
+	push_converted(s, &converted, start_ns);
 }
 
 static void
@@ -582,6 +498,7 @@ convert_frame_r8g8b8_bayer_or_l8(struct xrt_frame_sink *xs, struct xrt_frame *xf
 	SINK_TRACE_MARKER();
 
 	struct u_sink_converter *s = (struct u_sink_converter *)xs;
+	uint64_t start_ns = os_monotonic_get_ns();
 
 	struct xrt_frame *converted = NULL;
 
@@ -590,26 +507,26 @@ convert_frame_r8g8b8_bayer_or_l8(struct xrt_frame_sink *xs, struct xrt_frame *xf
 	case XRT_FORMAT_R8G8B8:
 	case XRT_FORMAT_BAYER_GR8:; s->downstream->push_frame(s->downstream, xf); return;
 	case XRT_FORMAT_YUYV422:
-		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUYV422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_YUYV422_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_UYVY422:
-		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_UYVY422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_UYVY422_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_YUV888:
-		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUV888_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_YUV888_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 #ifdef XRT_HAVE_JPEG
 	case XRT_FORMAT_MJPEG:
-		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
 		if (!from_MJPEG_to_R8G8B8(converted, xf->size, xf->data)) {
@@ -622,10 +539,7 @@ convert_frame_r8g8b8_bayer_or_l8(struct xrt_frame_sink *xs, struct xrt_frame *xf
 	default: U_LOG_E("Can not convert from '%s' to R8G8B8 or L8!", u_format_str(xf->format)); return;
 	}
 
-	s->downstream->push_frame(s->downstream, converted);
-
-	// Refcount in case it's being held downstream.
-	xrt_frame_reference(&converted, NULL);
+	push_converted(s, &converted, start_ns);
 }
 
 static void
@@ -634,46 +548,47 @@ convert_frame_r8g8b8(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 	SINK_TRACE_MARKER();
 
 	struct u_sink_converter *s = (struct u_sink_converter *)xs;
+	uint64_t start_ns = os_monotonic_get_ns();
 
 	struct xrt_frame *converted = NULL;
 
 	switch (xf->format) {
 	case XRT_FORMAT_R8G8B8: s->downstream->push_frame(s->downstream, xf); return;
 	case XRT_FORMAT_L8:
-		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_L8_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_L8_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_BAYER_GR8:;
 		uint32_t w = xf->width / 2;
 		uint32_t h = xf->height / 2;
-		if (!create_frame_with_format_of_size(xf, w, h, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format_of_size(s, xf, w, h, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_BAYER_GR8_to_R8G8B8(converted, w, h, xf->stride, xf->data);
+		convert_rows(s, from_BAYER_GR8_to_R8G8B8, converted, w, h, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_YUYV422:
-		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUYV422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_YUYV422_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_UYVY422:
-		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_UYVY422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_UYVY422_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_YUV888:
-		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUV888_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_YUV888_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 #ifdef XRT_HAVE_JPEG
 	case XRT_FORMAT_MJPEG:
-		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
 		if (!from_MJPEG_to_R8G8B8(converted, xf->size, xf->data)) {
@@ -686,10 +601,7 @@ convert_frame_r8g8b8(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 	default: U_LOG_E("Can not convert from '%s' to R8G8B8!", u_format_str(xf->format)); return;
 	}
 
-	s->downstream->push_frame(s->downstream, converted);
-
-	// Refcount in case it's being held downstream.
-	xrt_frame_reference(&converted, NULL);
+	push_converted(s, &converted, start_ns);
 }
 
 static void
@@ -698,6 +610,7 @@ convert_frame_rgb_yuv_yuyv_uyvy_or_l8(struct xrt_frame_sink *xs, struct xrt_fram
 	SINK_TRACE_MARKER();
 
 	struct u_sink_converter *s = (struct u_sink_converter *)xs;
+	uint64_t start_ns = os_monotonic_get_ns();
 
 	struct xrt_frame *converted = NULL;
 
@@ -709,10 +622,12 @@ convert_frame_rgb_yuv_yuyv_uyvy_or_l8(struct xrt_frame_sink *xs, struct xrt_fram
 	case XRT_FORMAT_YUV888: s->downstream->push_frame(s->downstream, xf); return;
 #ifdef XRT_HAVE_JPEG
 	case XRT_FORMAT_MJPEG:
-		if (!create_frame_with_format(xf, XRT_FORMAT_YUV888, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_YUV888, &converted)) {
 			return;
 		}
 		if (!from_MJPEG_to_YUV888(converted, xf->size, xf->data)) {
+			// Don't leak the frame if decoding failed.
+			xrt_frame_reference(&converted, NULL);
 			return;
 		}
 		break;
@@ -722,10 +637,7 @@ convert_frame_rgb_yuv_yuyv_uyvy_or_l8(struct xrt_frame_sink *xs, struct xrt_fram
 		return;
 	}
 
-	s->downstream->push_frame(s->downstream, converted);
-
-	// Refcount in case it's being held downstream.
-	xrt_frame_reference(&converted, NULL);
+	push_converted(s, &converted, start_ns);
 }
 
 static void
@@ -734,6 +646,7 @@ convert_frame_yuv_yuyv_uyvy_or_l8(struct xrt_frame_sink *xs, struct xrt_frame *x
 	SINK_TRACE_MARKER();
 
 	struct u_sink_converter *s = (struct u_sink_converter *)xs;
+	uint64_t start_ns = os_monotonic_get_ns();
 
 	struct xrt_frame *converted = NULL;
 
@@ -744,10 +657,12 @@ convert_frame_yuv_yuyv_uyvy_or_l8(struct xrt_frame_sink *xs, struct xrt_frame *x
 	case XRT_FORMAT_YUV888: s->downstream->push_frame(s->downstream, xf); return;
 #ifdef XRT_HAVE_JPEG
 	case XRT_FORMAT_MJPEG:
-		if (!create_frame_with_format(xf, XRT_FORMAT_YUV888, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_YUV888, &converted)) {
 			return;
 		}
 		if (!from_MJPEG_to_YUV888(converted, xf->size, xf->data)) {
+			// Don't leak the frame if decoding failed.
+			xrt_frame_reference(&converted, NULL);
 			return;
 		}
 		break;
@@ -760,10 +675,7 @@ convert_frame_yuv_yuyv_uyvy_or_l8(struct xrt_frame_sink *xs, struct xrt_frame *x
 		return;
 	}
 
-	s->downstream->push_frame(s->downstream, converted);
-
-	// Refcount in case it's being held downstream.
-	xrt_frame_reference(&converted, NULL);
+	push_converted(s, &converted, start_ns);
 }
 
 static void
@@ -772,6 +684,7 @@ convert_frame_yuv_or_yuyv(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 	SINK_TRACE_MARKER();
 
 	struct u_sink_converter *s = (struct u_sink_converter *)xs;
+	uint64_t start_ns = os_monotonic_get_ns();
 
 	struct xrt_frame *converted = NULL;
 
@@ -780,10 +693,12 @@ convert_frame_yuv_or_yuyv(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 	case XRT_FORMAT_YUV888: s->downstream->push_frame(s->downstream, xf); return;
 #ifdef XRT_HAVE_JPEG
 	case XRT_FORMAT_MJPEG:
-		if (!create_frame_with_format(xf, XRT_FORMAT_YUV888, &converted)) {
+		if (!create_frame_with_format(s, xf, XRT_FORMAT_YUV888, &converted)) {
 			return;
 		}
 		if (!from_MJPEG_to_YUV888(converted, xf->size, xf->data)) {
+			// Don't leak the frame if decoding failed.
+			xrt_frame_reference(&converted, NULL);
 			return;
 		}
 		break;
@@ -791,10 +706,7 @@ convert_frame_yuv_or_yuyv(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 	default: U_LOG_E("Can not convert from '%s' to either YUV or YUYV!", u_format_str(xf->format)); return;
 	}
 
-	s->downstream->push_frame(s->downstream, converted);
-
-	// Refcount in case it's being held downstream.
-	xrt_frame_reference(&converted, NULL);
+	push_converted(s, &converted, start_ns);
 }
 
 XRT_MAYBE_UNUSED static void
@@ -803,21 +715,19 @@ convert_frame_bayer(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 	SINK_TRACE_MARKER();
 
 	struct u_sink_converter *s = (struct u_sink_converter *)xs;
+	uint64_t start_ns = os_monotonic_get_ns();
 
 	uint32_t w = xf->width / 2;
 	uint32_t h = xf->height / 2;
 	struct xrt_frame *converted = NULL;
 
-	if (!create_frame_with_format_of_size(xf, w, h, XRT_FORMAT_R8G8B8, &converted)) {
+	if (!create_frame_with_format_of_size(s, xf, w, h, XRT_FORMAT_R8G8B8, &converted)) {
 		return;
 	}
 
-	from_BAYER_GR8_to_R8G8B8(converted, w, h, xf->stride, xf->data);
+	convert_rows(s, from_BAYER_GR8_to_R8G8B8, converted, w, h, xf->stride, xf->data);
 
-	s->downstream->push_frame(s->downstream, converted);
-
-	// Refcount in case it's being held downstream.
-	xrt_frame_reference(&converted, NULL);
+	push_converted(s, &converted, start_ns);
 }
 
 static void
@@ -829,6 +739,14 @@ destroy(struct xrt_frame_node *node)
 {
 	struct u_sink_converter *s = container_of(node, struct u_sink_converter, node);
 
+	if (s->stats.added) {
+		u_var_remove_root(s);
+	}
+
+	// Frames still held downstream keep the pool alive.
+	u_frame_pool_reference(&s->frame_pool, NULL);
+	u_worker_group_reference(&s->group, NULL);
+
 	free(s);
 }
 
@@ -844,6 +762,16 @@ u_sink_create_format_converter(struct xrt_frame_context *xfctx,
                                enum xrt_format format,
                                struct xrt_frame_sink *downstream,
                                struct xrt_frame_sink **out_xfs)
+{
+	u_sink_create_format_converter_threaded(xfctx, format, NULL, downstream, out_xfs);
+}
+
+void
+u_sink_create_format_converter_threaded(struct xrt_frame_context *xfctx,
+                                        enum xrt_format format,
+                                        struct u_worker_thread_pool *uwtp,
+                                        struct xrt_frame_sink *downstream,
+                                        struct xrt_frame_sink **out_xfs)
 {
 	assert(downstream != NULL);
 
@@ -855,15 +783,28 @@ u_sink_create_format_converter(struct xrt_frame_context *xfctx,
 	default: U_LOG_E("Format '%s' not supported", u_format_str(format)); return;
 	}
 
-#ifdef USE_TABLE
-	generate_lookup_YUV_to_RGBX();
-#endif
-
 	struct u_sink_converter *s = U_TYPED_CALLOC(struct u_sink_converter);
 	s->base.push_frame = func;
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
+	s->format = format;
+	u_frame_pool_reference(&s->frame_pool, u_frame_pool_get_for_context(xfctx));
+
+	if (uwtp != NULL) {
+		s->group = u_worker_group_create(uwtp);
+		s->band_count = (uint32_t)CLAMP(debug_get_num_option_band_count(), 1, U_WORKER_MAX_BANDS);
+	}
+
+	u_duration_stats_init(&s->stats.conversion, 5.f, true);
+
+	char name[64];
+	snprintf(name, sizeof(name), "Format converter (%s)", u_format_str(format));
+	u_var_add_root(s, name, true);
+	u_var_add_ro_u32(s, &s->band_count, "Row bands");
+	u_var_add_ro_u64(s, &s->stats.conversion.count, "Frames converted");
+	u_duration_stats_add_vars(&s->stats.conversion, s, "conversion");
+	s->stats.added = true;
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -882,10 +823,7 @@ u_sink_create_to_r8g8b8_or_l8(struct xrt_frame_context *xfctx,
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
-
-#ifdef USE_TABLE
-	generate_lookup_YUV_to_RGBX();
-#endif
+	u_frame_pool_reference(&s->frame_pool, u_frame_pool_get_for_context(xfctx));
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -904,10 +842,7 @@ u_sink_create_to_r8g8b8_r8g8b8a8_r8g8b8x8_or_l8(struct xrt_frame_context *xfctx,
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
-
-#ifdef USE_TABLE
-	generate_lookup_YUV_to_RGBX();
-#endif
+	u_frame_pool_reference(&s->frame_pool, u_frame_pool_get_for_context(xfctx));
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -926,6 +861,7 @@ u_sink_create_to_r8g8b8_bayer_or_l8(struct xrt_frame_context *xfctx,
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
+	u_frame_pool_reference(&s->frame_pool, u_frame_pool_get_for_context(xfctx));
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -944,6 +880,7 @@ u_sink_create_to_rgb_yuv_yuyv_uyvy_or_l8(struct xrt_frame_context *xfctx,
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
+	u_frame_pool_reference(&s->frame_pool, u_frame_pool_get_for_context(xfctx));
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -962,6 +899,7 @@ u_sink_create_to_yuv_yuyv_uyvy_or_l8(struct xrt_frame_context *xfctx,
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
+	u_frame_pool_reference(&s->frame_pool, u_frame_pool_get_for_context(xfctx));
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -980,6 +918,7 @@ u_sink_create_to_yuv_or_yuyv(struct xrt_frame_context *xfctx,
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
+	u_frame_pool_reference(&s->frame_pool, u_frame_pool_get_for_context(xfctx));
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -44,6 +44,9 @@ struct u_sink_queue
 	//! Back of the queue (newest frame, back->next is always null)
 	struct u_sink_queue_elem *back;
 
+	//! Unused elements, reused so that queueing doesn't allocate.
+	struct u_sink_queue_elem *free_elems;
+
 	//! Number of currently enqueued frames
 	uint64_t size;
 
@@ -84,7 +87,9 @@ queue_pop(struct u_sink_queue *q)
 	struct xrt_frame *frame = q->front->frame;
 	struct u_sink_queue_elem *old_front = q->front;
 	q->front = q->front->next;
-	free(old_front);
+	old_front->frame = NULL;
+	old_front->next = q->free_elems;
+	q->free_elems = old_front;
 	q->size--;
 	if (q->front == NULL) {
 		assert(queue_is_empty(q));
@@ -101,7 +106,12 @@ queue_try_refpush(struct u_sink_queue *q, struct xrt_frame *xf)
 	if (queue_is_full(q)) {
 		return false;
 	}
-	struct u_sink_queue_elem *elem = U_TYPED_CALLOC(struct u_sink_queue_elem);
+	struct u_sink_queue_elem *elem = q->free_elems;
+	if (elem != NULL) {
+		q->free_elems = elem->next;
+	} else {
+		elem = U_TYPED_CALLOC(struct u_sink_queue_elem);
+	}
 	xrt_frame_reference(&elem->frame, xf);
 	elem->next = NULL;
 	if (q->back == NULL) { // First frame
@@ -237,6 +247,13 @@ queue_destroy(struct xrt_frame_node *node)
 {
 	struct u_sink_queue *q = container_of(node, struct u_sink_queue, node);
 
+	// The queue has been cleared by break apart, only unused elements left.
+	while (q->free_elems != NULL) {
+		struct u_sink_queue_elem *elem = q->free_elems;
+		q->free_elems = elem->next;
+		free(elem);
+	}
+
 	// Destroy resources.
 	pthread_mutex_destroy(&q->mutex);
 	pthread_cond_destroy(&q->cond);
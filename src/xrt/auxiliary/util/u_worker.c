@@ -2,21 +2,39 @@
 // SPDX-License-Identifier: BSL-1.0
 /*!
  * @file
- * @brief  Simple worker pool.
+ * @brief  Work-stealing worker pool.
  * @author Jakob Bornecrantz <jakob@collabora.com>
  *
+ * Every worker thread owns a deque of tasks. Tasks pushed from a worker go on
+ * the back of its own deque and are popped from the back again (newest
+ * first, keeps caches warm for nested work), tasks pushed from any other
+ * thread go into a shared injector deque. A worker that runs out of work
+ * takes from the front of the injector and then steals from the front of the
+ * other workers' deques. Each deque has its own small lock, so there is no
+ * single lock that every push, pop and completion has to go through.
+ *
+ * Threads calling @ref u_worker_group_wait_all do not just sleep: they run
+ * the pending tasks of the group they wait on themselves until it is done,
+ * and only when there is nothing of it left to pick up do they block and
+ * "donate" their slot to the pool by raising the worker limit, as before.
+ * Tasks of other groups are left to the workers, a waiting thread never ends
+ * up running unrelated, possibly long, work.
+ *
  * @ingroup aux_util
  */
 
+#include "xrt/xrt_compiler.h"
+
 #include "os/os_threading.h"
 
+#include "util/u_misc.h"
 #include "util/u_logging.h"
 #include "util/u_worker.h"
 #include "util/u_trace_marker.h"
 
 
-#define MAX_TASK_COUNT (64)
-#define MAX_THREAD_COUNT (16)
+//! Starting size of every deque, they grow as needed.
+#define INITIAL_DEQUE_CAPACITY (64)
 
 struct group;
 struct pool;
@@ -33,11 +51,48 @@ struct task
 	void *data;
 };
 
+/*!
+ * A part of the items of @ref u_worker_group_for_bands, handed to a task.
+ */
+struct band
+{
+	u_worker_band_func_t func;
+	void *data;
+	uint32_t start;
+	uint32_t end;
+};
+
+/*!
+ * Growable ring buffer of tasks, the owner works on the back and thieves take
+ * from the front.
+ */
+struct deque
+{
+	struct os_mutex mutex;
+
+	//! Ring buffer, capacity is always a power of two.
+	struct task *tasks;
+
+	uint32_t capacity;
+
+	//! Index of the front element.
+	uint32_t head;
+
+	//! Number of tasks in the ring.
+	uint32_t count;
+};
+
 struct thread
 {
 	//! Pool this thread belongs to.
 	struct pool *p;
 
+	//! Where to start looking for a victim the next time we steal.
+	uint32_t steal_start;
+
+	//! Tasks pushed from this thread.
+	struct deque deque;
+
 	// Native thread.
 	struct os_thread thread;
 };
@@ -46,35 +101,33 @@ struct pool
 {
 	struct u_worker_thread_pool base;
 
-	//! Big contenious mutex.
-	struct os_mutex mutex;
+	//! Tasks pushed from threads not belonging to the pool.
+	struct deque injector;
 
-	//! Array of tasks.
-	struct task tasks[MAX_TASK_COUNT];
+	//! Number of tasks sitting in any of the deques.
+	xrt_atomic_s32_t pending_count;
 
-	//! Number of tasks in array.
-	size_t tasks_in_array_count;
+	//! Number of threads working on tasks.
+	xrt_atomic_s32_t working_count;
 
-	struct
-	{
-		size_t count;
-		struct os_cond cond;
-	} available; //!< For worker threads.
+	//! Currently the number of works that can work, waiting increases this.
+	xrt_atomic_s32_t worker_limit;
 
-	//! Given at creation.
-	uint32_t initial_worker_limit;
+	//! Number of threads waiting on @ref sleep_cond.
+	xrt_atomic_s32_t sleeping_count;
 
-	//! Currently the number of works that can work, waiting increases this.
-	uint32_t worker_limit;
+	//! Protects the sleeping, only taken when there is nothing to do.
+	struct os_mutex sleep_mutex;
+	struct os_cond sleep_cond;
 
-	//! Number of threads working on tasks.
-	size_t working_count;
+	//! Given at creation.
+	uint32_t initial_worker_limit;
 
 	//! Number of created threads.
-	size_t thread_count;
+	uint32_t thread_count;
 
 	//! The worker threads.
-	struct thread threads[MAX_THREAD_COUNT];
+	struct thread *threads;
 
 	//! Is the pool up and running?
 	bool running;
@@ -88,12 +141,12 @@ struct group
 	//! Pointer to poll of threads.
 	struct u_worker_thread_pool *uwtp;
 
+	//! Protects the fields below.
+	struct os_mutex mutex;
+
 	//! Number of tasks that is pending or being worked on in this group.
 	size_t current_submitted_tasks_count;
 
-	//! Number of threads that have been released or newly entered wait.
-	size_t released_count;
-
 	struct
 	{
 		size_t count;
@@ -101,6 +154,9 @@ struct group
 	} waiting; //!< For wait_all
 };
 
+//! The pool thread we are running on, if any.
+static XRT_THREAD_LOCAL struct thread *tl_current_thread;
+
 
 /*
  *
@@ -120,213 +176,397 @@ pool(struct u_worker_thread_pool *uwtp)
 	return (struct pool *)uwtp;
 }
 
+static inline int32_t
+load_s32(xrt_atomic_s32_t *p)
+{
+	// The increments are full barriers, which the sleep/wake handshake relies on, this only needs to load.
+#if defined(__GNUC__)
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#else
+	return *p;
+#endif
+}
+
+static inline struct thread *
+current_thread_in(struct pool *p)
+{
+	struct thread *t = tl_current_thread;
+	if (t == NULL || t->p != p) {
+		return NULL;
+	}
+	return t;
+}
+
 
 /*
  *
- * Internal pool functions.
+ * Deque functions.
  *
  */
 
+static int
+deque_init(struct deque *d)
+{
+	d->tasks = U_TYPED_ARRAY_CALLOC(struct task, INITIAL_DEQUE_CAPACITY);
+	if (d->tasks == NULL) {
+		return -1;
+	}
+	d->capacity = INITIAL_DEQUE_CAPACITY;
+	d->head = 0;
+	d->count = 0;
+
+	return os_mutex_init(&d->mutex);
+}
+
 static void
-locked_pool_pop_task(struct pool *p, struct task *out_task)
+deque_destroy(struct deque *d)
 {
-	assert(p->tasks_in_array_count > 0);
+	os_mutex_destroy(&d->mutex);
+	free(d->tasks);
+	d->tasks = NULL;
+}
 
-	for (size_t i = 0; i < MAX_TASK_COUNT; i++) {
-		if (p->tasks[i].func == NULL) {
-			continue;
-		}
+static bool
+locked_deque_grow(struct deque *d)
+{
+	uint32_t new_capacity = d->capacity * 2;
+	struct task *tasks = U_TYPED_ARRAY_CALLOC(struct task, new_capacity);
+	if (tasks == NULL) {
+		return false;
+	}
 
-		*out_task = p->tasks[i];
-		p->tasks[i] = (struct task){NULL, NULL, NULL};
-		p->tasks_in_array_count--;
-		return;
+	// Unroll the ring so the front ends up at index zero.
+	for (uint32_t i = 0; i < d->count; i++) {
+		tasks[i] = d->tasks[(d->head + i) & (d->capacity - 1)];
 	}
 
-	assert(false);
+	free(d->tasks);
+	d->tasks = tasks;
+	d->capacity = new_capacity;
+	d->head = 0;
+
+	return true;
 }
 
-static void
-locked_pool_push_task(struct pool *p, struct group *g, u_worker_group_func_t func, void *data)
+//! Returns false if the deque was full and could not grow.
+static bool
+deque_push_back(struct deque *d, const struct task *task)
 {
-	assert(p->tasks_in_array_count < MAX_TASK_COUNT);
-
-	for (size_t i = 0; i < MAX_TASK_COUNT; i++) {
-		if (p->tasks[i].func != NULL) {
-			continue;
-		}
+	os_mutex_lock(&d->mutex);
 
-		p->tasks[i] = (struct task){g, func, data};
-		p->tasks_in_array_count++;
-		g->current_submitted_tasks_count++;
-		return;
+	if (d->count == d->capacity && !locked_deque_grow(d)) {
+		os_mutex_unlock(&d->mutex);
+		return false;
 	}
 
-	assert(false);
+	d->tasks[(d->head + d->count) & (d->capacity - 1)] = *task;
+	d->count++;
+
+	os_mutex_unlock(&d->mutex);
+	return true;
 }
 
-static void
-locked_pool_wake_worker_if_allowed(struct pool *p)
+static bool
+deque_pop_back(struct deque *d, struct task *out_task)
 {
-	// No tasks in array, don't wake any thread.
-	if (p->tasks_in_array_count == 0) {
-		return;
+	os_mutex_lock(&d->mutex);
+
+	if (d->count == 0) {
+		os_mutex_unlock(&d->mutex);
+		return false;
 	}
 
-	// The number of working threads is at the limit.
-	if (p->working_count >= p->worker_limit) {
-		return;
+	d->count--;
+	*out_task = d->tasks[(d->head + d->count) & (d->capacity - 1)];
+
+	os_mutex_unlock(&d->mutex);
+	return true;
+}
+
+static bool
+deque_pop_front(struct deque *d, struct task *out_task)
+{
+	os_mutex_lock(&d->mutex);
+
+	if (d->count == 0) {
+		os_mutex_unlock(&d->mutex);
+		return false;
 	}
 
-	// No waiting thread.
-	if (p->available.count == 0) {
-		//! @todo Is this a error?
-		return;
+	*out_task = d->tasks[d->head];
+	d->head = (d->head + 1) & (d->capacity - 1);
+	d->count--;
+
+	os_mutex_unlock(&d->mutex);
+	return true;
+}
+
+//! Take the oldest task of group @p g out of the deque, wherever it is.
+static bool
+deque_take_group(struct deque *d, struct group *g, struct task *out_task)
+{
+	os_mutex_lock(&d->mutex);
+
+	uint32_t mask = d->capacity - 1;
+	for (uint32_t i = 0; i < d->count; i++) {
+		if (d->tasks[(d->head + i) & mask].g != g) {
+			continue;
+		}
+
+		*out_task = d->tasks[(d->head + i) & mask];
+
+		// Close the gap, the deques are short so this is cheap.
+		for (uint32_t k = i; k + 1 < d->count; k++) {
+			d->tasks[(d->head + k) & mask] = d->tasks[(d->head + k + 1) & mask];
+		}
+		d->count--;
+
+		os_mutex_unlock(&d->mutex);
+		return true;
 	}
 
-	os_cond_signal(&p->available.cond);
+	os_mutex_unlock(&d->mutex);
+	return false;
 }
 
 
 /*
  *
- * Thread group functions.
+ * Internal pool functions.
  *
  */
 
-static bool
-locked_group_should_enter_wait_loop(struct pool *p, struct group *g)
+static void
+pool_wake_worker(struct pool *p)
 {
-	if (g->current_submitted_tasks_count == 0) {
-		return false;
+	os_mutex_lock(&p->sleep_mutex);
+	os_cond_signal(&p->sleep_cond);
+	os_mutex_unlock(&p->sleep_mutex);
+}
+
+static void run_task(struct task *task);
+
+static void
+pool_push_task(struct pool *p, struct task *task)
+{
+	struct thread *t = current_thread_in(p);
+	bool pushed = deque_push_back(t != NULL ? &t->deque : &p->injector, task);
+	if (!pushed) {
+		// Out of memory, still get the work done.
+		U_LOG_E("Failed to grow task deque, running task on the pushing thread!");
+		run_task(task);
+		return;
 	}
 
-	// Enter the loop as a released thread.
-	g->released_count++;
+	/*
+	 * The increment is a full barrier, so either we see the sleeping
+	 * thread here or it sees the pending task in thread_sleep.
+	 */
+	xrt_atomic_s32_inc_return(&p->pending_count);
 
-	return true;
+	if (load_s32(&p->sleeping_count) > 0) {
+		pool_wake_worker(p);
+	}
 }
 
+/*!
+ * Find a task, @p t is the pool thread we are on or NULL.
+ */
 static bool
-locked_group_should_wait(struct pool *p, struct group *g)
+pool_find_task(struct pool *p, struct thread *t, struct task *out_task)
 {
-	/*
-	 * There are several cases that needs to be covered by this function.
-	 *
-	 * A thread is entering the wait_all function for the first time, and
-	 * work is outstanding what we should do then is increase the worker
-	 * limit and wait on the conditional.
-	 *
-	 * Similar to preceding, we were woken up, there are more work outstanding
-	 * on the group and we had been released, remove one released and up the
-	 * worker limit, then wait on the conditional.
-	 *
-	 * A thread (or more) has been woken up and no new tasks has been
-	 * submitted, then break out of the loop and decrement the released
-	 * count.
-	 *
-	 * As preceding, but we were one of many woken up but only one thread had
-	 * been released and that released count had been taken, then we should
-	 * do nothing and wait again.
-	 */
+	if (load_s32(&p->pending_count) <= 0) {
+		return false;
+	}
+
+	bool found = false;
 
-	// Tasks available.
-	if (g->current_submitted_tasks_count > 0) {
+	// Our own newest task first.
+	if (t != NULL) {
+		found = deque_pop_back(&t->deque, out_task);
+	}
 
-		// We have been released or newly entered the loop.
-		if (g->released_count > 0) {
-			g->released_count--;
-			p->worker_limit++;
+	// Then tasks from outside of the pool, oldest first.
+	if (!found) {
+		found = deque_pop_front(&p->injector, out_task);
+	}
 
-			// Wake a worker with the new worker limit.
-			locked_pool_wake_worker_if_allowed(p);
+	// Last steal the oldest task from another thread.
+	uint32_t start = t != NULL ? t->steal_start++ : 0;
+	for (uint32_t i = 0; !found && i < p->thread_count; i++) {
+		struct thread *victim = &p->threads[(start + i) % p->thread_count];
+		if (victim == t) {
+			continue;
 		}
 
-		return true;
+		found = deque_pop_front(&victim->deque, out_task);
 	}
 
-	// No tasks, and we have been released, party!
-	if (g->released_count > 0) {
-		g->released_count--;
-		return false;
+	if (found) {
+		xrt_atomic_s32_dec_return(&p->pending_count);
 	}
 
-	// We where woken up, but nothing had been released, loop again.
-	return true;
+	return found;
 }
 
-static void
-locked_group_wake_waiter_if_allowed(struct pool *p, struct group *g)
+/*!
+ * Find a task of group @p g only, for threads waiting on it. @p t is the pool
+ * thread we are on or NULL.
+ */
+static bool
+pool_find_group_task(struct pool *p, struct thread *t, struct group *g, struct task *out_task)
 {
-	// Are there still outstanding tasks?
-	if (g->current_submitted_tasks_count > 0) {
-		return;
+	if (load_s32(&p->pending_count) <= 0) {
+		return false;
 	}
 
-	// Is there a thread waiting or not?
-	if (g->waiting.count == 0) {
-		return;
+	bool found = false;
+
+	if (t != NULL) {
+		found = deque_take_group(&t->deque, g, out_task);
 	}
 
-	// Wake one waiting thread.
-	os_cond_signal(&g->waiting.cond);
+	if (!found) {
+		found = deque_take_group(&p->injector, g, out_task);
+	}
 
-	assert(p->worker_limit > p->initial_worker_limit);
+	for (uint32_t i = 0; !found && i < p->thread_count; i++) {
+		struct thread *victim = &p->threads[i];
+		if (victim == t) {
+			continue;
+		}
 
-	// Remove one waiting threads.
-	p->worker_limit--;
+		found = deque_take_group(&victim->deque, g, out_task);
+	}
+
+	if (found) {
+		xrt_atomic_s32_dec_return(&p->pending_count);
+	}
 
-	// We have released one thread.
-	g->released_count++;
+	return found;
+}
+
+//! Try to count this thread as working, fails if over the worker limit.
+static bool
+pool_try_start_working(struct pool *p)
+{
+	while (true) {
+		int32_t working = load_s32(&p->working_count);
+		if (working >= load_s32(&p->worker_limit)) {
+			return false;
+		}
+
+		if (xrt_atomic_s32_cmpxchg(&p->working_count, working, working + 1) == working) {
+			return true;
+		}
+	}
 }
 
 static void
-locked_group_wait(struct pool *p, struct group *g)
+pool_raise_worker_limit(struct pool *p)
 {
-	// Update tracking.
-	g->waiting.count++;
+	xrt_atomic_s32_inc_return(&p->worker_limit);
 
-	// The wait, also unlocks the mutex.
-	os_cond_wait(&g->waiting.cond, &p->mutex);
+	if (load_s32(&p->pending_count) > 0 && load_s32(&p->sleeping_count) > 0) {
+		pool_wake_worker(p);
+	}
+}
 
-	// Update tracking.
-	g->waiting.count--;
+static void
+pool_lower_worker_limit(struct pool *p)
+{
+	int32_t limit = xrt_atomic_s32_dec_return(&p->worker_limit);
+	assert(limit >= (int32_t)p->initial_worker_limit);
+	(void)limit;
 }
 
 
 /*
  *
- * Thread internal functions.
+ * Thread group functions.
  *
  */
 
-static bool
-locked_thread_allowed_to_work(struct pool *p)
+static void
+group_task_submitted(struct group *g)
 {
-	// No work for you!
-	if (p->tasks_in_array_count == 0) {
-		return false;
+	os_mutex_lock(&g->mutex);
+	g->current_submitted_tasks_count++;
+
+	// A waiting thread might be blocked, let it help with this task.
+	if (g->waiting.count > 0) {
+		os_cond_broadcast(&g->waiting.cond);
 	}
+	os_mutex_unlock(&g->mutex);
+}
 
-	// Reached the limit.
-	if (p->working_count >= p->worker_limit) {
-		return false;
+static void
+group_task_completed(struct group *g)
+{
+	/*
+	 * Don't touch the group after unlocking, a waiter seeing the count
+	 * reach zero is free to destroy the group.
+	 */
+	os_mutex_lock(&g->mutex);
+	g->current_submitted_tasks_count--;
+
+	if (g->current_submitted_tasks_count == 0 && g->waiting.count > 0) {
+		os_cond_broadcast(&g->waiting.cond);
 	}
+	os_mutex_unlock(&g->mutex);
+}
 
-	return true;
+static bool
+group_is_done(struct group *g)
+{
+	os_mutex_lock(&g->mutex);
+	bool done = g->current_submitted_tasks_count == 0;
+	os_mutex_unlock(&g->mutex);
+
+	return done;
+}
+
+static void
+run_task(struct task *task)
+{
+	task->func(task->data);
+	group_task_completed(task->g);
 }
 
 static void
-locked_thread_wait_for_work(struct pool *p)
+band_task(void *ptr)
 {
-	// Update tracking.
-	p->available.count++;
+	struct band *b = (struct band *)ptr;
+	b->func(b->data, b->start, b->end);
+}
 
-	// The wait, also unlocks the mutex.
-	os_cond_wait(&p->available.cond, &p->mutex);
 
-	// Update tracking.
-	p->available.count--;
+/*
+ *
+ * Thread internal functions.
+ *
+ */
+
+static void
+thread_sleep(struct pool *p)
+{
+	os_mutex_lock(&p->sleep_mutex);
+
+	// Announce first, then check for work, pairs with pool_push_task.
+	xrt_atomic_s32_inc_return(&p->sleeping_count);
+
+	while (p->running) {
+		if (load_s32(&p->pending_count) > 0 &&
+		    load_s32(&p->working_count) < load_s32(&p->worker_limit)) {
+			break;
+		}
+
+		os_cond_wait(&p->sleep_cond, &p->sleep_mutex);
+	}
+
+	xrt_atomic_s32_dec_return(&p->sleeping_count);
+
+	os_mutex_unlock(&p->sleep_mutex);
 }
 
 static void *
@@ -335,46 +575,39 @@ run_func(void *ptr)
 	struct thread *t = (struct thread *)ptr;
 	struct pool *p = t->p;
 
-	os_mutex_lock(&p->mutex);
+	tl_current_thread = t;
 
-	while (p->running) {
-
-		if (!locked_thread_allowed_to_work(p)) {
-			locked_thread_wait_for_work(p);
+	while (true) {
+		os_mutex_lock(&p->sleep_mutex);
+		bool running = p->running;
+		os_mutex_unlock(&p->sleep_mutex);
 
-			// Check running first when woken up.
-			continue;
+		if (!running) {
+			break;
 		}
 
-		// Pop a task from the pool.
-		struct task task = {NULL, NULL, NULL};
-		locked_pool_pop_task(p, &task);
-
-		// We are now counting as working, needed for wake below.
-		p->working_count++;
+		bool did_work = false;
+		if (pool_try_start_working(p)) {
+			struct task task;
+			while (pool_find_task(p, t, &task)) {
+				run_task(&task);
+				did_work = true;
 
-		// Signal another thread if conditions are met.
-		locked_pool_wake_worker_if_allowed(p);
+				// Somebody might have lowered the limit while we worked.
+				if (load_s32(&p->working_count) > load_s32(&p->worker_limit)) {
+					break;
+				}
+			}
 
-		// Do the actual work here.
-		os_mutex_unlock(&p->mutex);
-		task.func(task.data);
-		os_mutex_lock(&p->mutex);
-
-		// No longer working.
-		p->working_count--;
-
-		// Only now decrement the task count on the owning group.
-		task.g->current_submitted_tasks_count--;
+			xrt_atomic_s32_dec_return(&p->working_count);
+		}
 
-		// Wake up any waiter.
-		locked_group_wake_waiter_if_allowed(p, task.g);
+		if (!did_work) {
+			thread_sleep(p);
+		}
 	}
 
-	// Make sure all threads are woken up.
-	os_cond_signal(&p->available.cond);
-
-	os_mutex_unlock(&p->mutex);
+	tl_current_thread = NULL;
 
 	return NULL;
 }
@@ -397,30 +630,44 @@ u_worker_thread_pool_create(uint32_t starting_worker_count, uint32_t thread_coun
 		return NULL;
 	}
 
-	assert(thread_count <= MAX_THREAD_COUNT);
-	if (thread_count > MAX_THREAD_COUNT) {
-		return NULL;
-	}
-
 	struct pool *p = U_TYPED_CALLOC(struct pool);
 	p->base.reference.count = 1;
 	p->initial_worker_limit = starting_worker_count;
-	p->worker_limit = starting_worker_count;
+	p->worker_limit = (int32_t)starting_worker_count;
 	p->thread_count = thread_count;
 	p->running = true;
 
-	ret = os_mutex_init(&p->mutex);
-	if (ret != 0) {
+	p->threads = U_TYPED_ARRAY_CALLOC(struct thread, thread_count);
+	if (p->threads == NULL) {
 		goto err_alloc;
 	}
 
-	ret = os_cond_init(&p->available.cond);
+	ret = deque_init(&p->injector);
+	if (ret != 0) {
+		goto err_threads;
+	}
+
+	ret = os_mutex_init(&p->sleep_mutex);
+	if (ret != 0) {
+		goto err_injector;
+	}
+
+	ret = os_cond_init(&p->sleep_cond);
 	if (ret != 0) {
 		goto err_mutex;
 	}
 
-	for (size_t i = 0; i < thread_count; i++) {
+	for (uint32_t i = 0; i < thread_count; i++) {
+		ret = deque_init(&p->threads[i].deque);
+		if (ret != 0) {
+			U_LOG_E("Failed to init deque!");
+			abort();
+		}
+	}
+
+	for (uint32_t i = 0; i < thread_count; i++) {
 		p->threads[i].p = p;
+		p->threads[i].steal_start = i + 1;
 		os_thread_init(&p->threads[i].thread);
 		os_thread_start(&p->threads[i].thread, run_func, &p->threads[i]);
 	}
@@ -429,7 +676,13 @@ u_worker_thread_pool_create(uint32_t starting_worker_count, uint32_t thread_coun
 
 
 err_mutex:
-	os_mutex_destroy(&p->mutex);
+	os_mutex_destroy(&p->sleep_mutex);
+
+err_injector:
+	deque_destroy(&p->injector);
+
+err_threads:
+	free(p->threads);
 
 err_alloc:
 	free(p);
@@ -444,21 +697,27 @@ u_worker_thread_pool_destroy(struct u_worker_thread_pool *uwtp)
 
 	struct pool *p = pool(uwtp);
 
-	os_mutex_lock(&p->mutex);
-
+	os_mutex_lock(&p->sleep_mutex);
 	p->running = false;
-	os_cond_signal(&p->available.cond);
-	os_mutex_unlock(&p->mutex);
+	os_cond_broadcast(&p->sleep_cond);
+	os_mutex_unlock(&p->sleep_mutex);
 
 	// Wait for all threads.
-	for (size_t i = 0; i < p->thread_count; i++) {
+	for (uint32_t i = 0; i < p->thread_count; i++) {
 		os_thread_join(&p->threads[i].thread);
 		os_thread_destroy(&p->threads[i].thread);
 	}
 
-	os_mutex_destroy(&p->mutex);
-	os_cond_destroy(&p->available.cond);
+	// Only now, the threads still running above might be stealing.
+	for (uint32_t i = 0; i < p->thread_count; i++) {
+		deque_destroy(&p->threads[i].deque);
+	}
+
+	deque_destroy(&p->injector);
+	os_mutex_destroy(&p->sleep_mutex);
+	os_cond_destroy(&p->sleep_cond);
 
+	free(p->threads);
 	free(p);
 }
 
@@ -478,6 +737,7 @@ u_worker_group_create(struct u_worker_thread_pool *uwtp)
 	g->base.reference.count = 1;
 	u_worker_thread_pool_reference(&g->uwtp, uwtp);
 
+	os_mutex_init(&g->mutex);
 	os_cond_init(&g->waiting.cond);
 
 	return (struct u_worker_group *)g;
@@ -491,24 +751,11 @@ u_worker_group_push(struct u_worker_group *uwg, u_worker_group_func_t f, void *d
 	struct group *g = group(uwg);
 	struct pool *p = pool(g->uwtp);
 
-	os_mutex_lock(&p->mutex);
-	while (p->tasks_in_array_count >= MAX_TASK_COUNT) {
-		os_mutex_unlock(&p->mutex);
-
-		//! @todo Don't wait all, wait one.
-		u_worker_group_wait_all(uwg);
-
-		os_mutex_lock(&p->mutex);
-	}
-
-	locked_pool_push_task(p, g, f, data);
+	// Count it before it is visible to the workers, or it could complete first.
+	group_task_submitted(g);
 
-	// There are worker threads available, wake one up.
-	if (p->available.count > 0) {
-		os_cond_signal(&p->available.cond);
-	}
-
-	os_mutex_unlock(&p->mutex);
+	struct task task = {g, f, data};
+	pool_push_task(p, &task);
 }
 
 void
@@ -518,22 +765,80 @@ u_worker_group_wait_all(struct u_worker_group *uwg)
 
 	struct group *g = group(uwg);
 	struct pool *p = pool(g->uwtp);
+	struct thread *t = current_thread_in(p);
+
+	while (true) {
+		// Help out, only with this group's tasks.
+		struct task task;
+		while (pool_find_group_task(p, t, g, &task)) {
+			run_task(&task);
+
+			if (group_is_done(g)) {
+				return;
+			}
+		}
+
+		os_mutex_lock(&g->mutex);
+
+		if (g->current_submitted_tasks_count == 0) {
+			os_mutex_unlock(&g->mutex);
+			return;
+		}
+
+		/*
+		 * Everything left is being worked on by other threads, block
+		 * and let the pool use one more thread while we do.
+		 */
+		pool_raise_worker_limit(p);
+
+		g->waiting.count++;
+		os_cond_wait(&g->waiting.cond, &g->mutex);
+		g->waiting.count--;
+
+		pool_lower_worker_limit(p);
 
-	os_mutex_lock(&p->mutex);
+		os_mutex_unlock(&g->mutex);
+	}
+}
 
-	// Can we early out?
-	if (!locked_group_should_enter_wait_loop(p, g)) {
-		os_mutex_unlock(&p->mutex);
+void
+u_worker_group_for_bands(struct u_worker_group *uwg,
+                         uint32_t count,
+                         uint32_t band_count,
+                         uint32_t min_band_size,
+                         u_worker_band_func_t func,
+                         void *data)
+{
+	uint32_t max_band_count = min_band_size > 0 ? count / min_band_size : count;
+	if (band_count > U_WORKER_MAX_BANDS) {
+		band_count = U_WORKER_MAX_BANDS;
+	}
+	if (band_count > max_band_count) {
+		band_count = max_band_count;
+	}
+	if (uwg == NULL) {
+		band_count = 1;
+	}
+
+	if (band_count <= 1) {
+		func(data, 0, count);
 		return;
 	}
 
-	// Wait here until all work been started and completed.
-	while (locked_group_should_wait(p, g)) {
-		// Do the wait.
-		locked_group_wait(p, g);
+	struct band bands[U_WORKER_MAX_BANDS];
+	uint32_t start = 0;
+	for (uint32_t i = 0; i < band_count; i++) {
+		// Spread the remainder over the first bands.
+		uint32_t size = count / band_count + (i < count % band_count ? 1 : 0);
+
+		bands[i] = (struct band){func, data, start, start + size};
+		start += size;
+
+		u_worker_group_push(uwg, band_task, &bands[i]);
 	}
+	assert(start == count);
 
-	os_mutex_unlock(&p->mutex);
+	u_worker_group_wait_all(uwg);
 }
 
 void
@@ -549,6 +854,7 @@ u_worker_group_destroy(struct u_worker_group *uwg)
 	u_worker_thread_pool_reference(&g->uwtp, NULL);
 
 	os_cond_destroy(&g->waiting.cond);
+	os_mutex_destroy(&g->mutex);
 
 	free(uwg);
 }
@@ -133,6 +133,40 @@ u_worker_group_push(struct u_worker_group *uwg, u_worker_group_func_t f, void *d
 void
 u_worker_group_wait_all(struct u_worker_group *uwg);
 
+/*!
+ * Upper limit of bands @ref u_worker_group_for_bands splits work into.
+ *
+ * @ingroup aux_util
+ */
+#define U_WORKER_MAX_BANDS (32)
+
+/*!
+ * Function typedef for bands, called for the items from @p start up to but
+ * not including @p end.
+ *
+ * @ingroup aux_util
+ */
+typedef void (*u_worker_band_func_t)(void *data, uint32_t start, uint32_t end);
+
+/*!
+ * Splits @p count items, like the rows of a frame, into at most
+ * @p band_count bands of at least @p min_band_size items each and runs them
+ * on the group. Returns once all bands are done, this thread helps out while
+ * waiting like @ref u_worker_group_wait_all does.
+ *
+ * If @p uwg is NULL or the items don't make more than one band, @p func is
+ * called once for all of them on this thread.
+ *
+ * @ingroup aux_util
+ */
+void
+u_worker_group_for_bands(struct u_worker_group *uwg,
+                         uint32_t count,
+                         uint32_t band_count,
+                         uint32_t min_band_size,
+                         u_worker_band_func_t func,
+                         void *data);
+
 /*!
  * Destroy a worker pool.
  *
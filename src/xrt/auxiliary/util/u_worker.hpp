@@ -131,9 +131,7 @@ public:
 
 
 private:
-	static constexpr size_t kSize = 16;
-
-	Functor mFunctors[kSize] = {};
+	std::vector<Functor> mFunctors = {};
 	u_worker_group *mGroup = nullptr;
 
 
@@ -144,13 +142,13 @@ public:
 	 */
 	TaskCollection(SharedThreadGroup const &stc, std::vector<Functor> const &funcs)
 	{
-		assert(funcs.size() <= kSize);
-
 		u_worker_group_reference(&mGroup, stc.mGroup);
 
-		for (size_t i = 0; i < kSize && i < funcs.size(); i++) {
-			mFunctors[i] = funcs[i];
-			u_worker_group_push(mGroup, &cCallback, &mFunctors[i]);
+		// Copy all of them first, the tasks point into the vector.
+		mFunctors = funcs;
+
+		for (Functor &f : mFunctors) {
+			u_worker_group_push(mGroup, &cCallback, &f);
 		}
 	}
 
@@ -917,7 +917,9 @@ dispatch_graphics(struct comp_renderer *r, struct render_gfx *rr)
 	}
 
 	// COMP_SPEW(c, "Layer renderer calling ILLIXR at %ld ms", illixr_get_now_ns()/1000000);
-	illixr_write_frame(0, 0, render_pose);
+	if (!illixr_write_frame(0, 0, render_pose)) {
+		COMP_WARN(c, "ILLIXR timewarp did not consume the frame in time");
+	}
 	
 	// COMP_SPEW(c, "Layer renderer FINISH at %ld ms", illixr_get_now_ns()/1000000);
 
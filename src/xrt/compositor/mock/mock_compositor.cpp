@@ -9,8 +9,11 @@
 
 #include "mock_compositor.h"
 
+#include "os/os_time.h"
+
 #include "util/u_misc.h"
 #include "util/u_handles.h"
+#include "util/u_time.h"
 
 static void
 mock_compositor_swapchain_destroy(struct xrt_swapchain *xsc)
@@ -52,6 +55,7 @@ mock_compositor_swapchain_acquire_image(struct xrt_swapchain *xsc, uint32_t *out
 	uint32_t index = mcsc->next_to_acquire;
 	mcsc->next_to_acquire = (mcsc->next_to_acquire + 1) % mcsc->base.base.image_count;
 	mcsc->acquired[index] = true;
+	*out_index = index;
 
 	return XRT_SUCCESS;
 }
@@ -62,7 +66,7 @@ mock_compositor_swapchain_release_image(struct xrt_swapchain *xsc, uint32_t inde
 	struct mock_compositor_swapchain *mcsc = mock_compositor_swapchain(xsc);
 	struct mock_compositor *mc = mcsc->mc;
 
-	if (mc->swapchain_hooks.acquire_image) {
+	if (mc->swapchain_hooks.release_image) {
 		return mc->swapchain_hooks.release_image(mc, mcsc, index);
 	}
 	mcsc->acquired[index] = false;
@@ -163,6 +167,239 @@ mock_compositor_get_swapchain_create_properties(struct xrt_compositor *xc,
 	return XRT_SUCCESS;
 }
 
+static xrt_result_t
+mock_compositor_poll_events(struct xrt_compositor *xc, union xrt_compositor_event *out_xce)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.poll_events) {
+		return mc->compositor_hooks.poll_events(mc, out_xce);
+	}
+
+	if (!mc->state_change_pending) {
+		out_xce->type = XRT_COMPOSITOR_EVENT_NONE;
+		return XRT_SUCCESS;
+	}
+
+	// A running session is always shown and focused.
+	out_xce->type = XRT_COMPOSITOR_EVENT_STATE_CHANGE;
+	out_xce->state.visible = mc->session_active;
+	out_xce->state.focused = mc->session_active;
+	mc->state_change_pending = false;
+
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+mock_compositor_begin_session(struct xrt_compositor *xc, enum xrt_view_type view_type)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.begin_session) {
+		return mc->compositor_hooks.begin_session(mc, view_type);
+	}
+	mc->session_active = true;
+	mc->state_change_pending = true;
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+mock_compositor_end_session(struct xrt_compositor *xc)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.end_session) {
+		return mc->compositor_hooks.end_session(mc);
+	}
+	mc->session_active = false;
+	mc->state_change_pending = true;
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+mock_compositor_wait_frame(struct xrt_compositor *xc,
+                           int64_t *out_frame_id,
+                           uint64_t *out_predicted_display_time,
+                           uint64_t *out_predicted_display_period)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.wait_frame) {
+		return mc->compositor_hooks.wait_frame(mc, out_frame_id, out_predicted_display_time,
+		                                       out_predicted_display_period);
+	}
+
+	// Never blocks, the frame is displayed one period from now.
+	*out_frame_id = ++mc->frame_id;
+	*out_predicted_display_time = os_monotonic_get_ns() + mc->frame_period_ns;
+	*out_predicted_display_period = mc->frame_period_ns;
+
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+mock_compositor_begin_frame(struct xrt_compositor *xc, int64_t frame_id)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.begin_frame) {
+		return mc->compositor_hooks.begin_frame(mc, frame_id);
+	}
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+mock_compositor_discard_frame(struct xrt_compositor *xc, int64_t frame_id)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.discard_frame) {
+		return mc->compositor_hooks.discard_frame(mc, frame_id);
+	}
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+mock_compositor_layer_begin(struct xrt_compositor *xc,
+                            int64_t frame_id,
+                            uint64_t display_time_ns,
+                            enum xrt_blend_mode env_blend_mode)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.layer_begin) {
+		return mc->compositor_hooks.layer_begin(mc, frame_id, display_time_ns, env_blend_mode);
+	}
+	mc->layer_count = 0;
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+mock_compositor_layer_stereo_projection(struct xrt_compositor *xc,
+                                        struct xrt_device *xdev,
+                                        struct xrt_swapchain *l_xsc,
+                                        struct xrt_swapchain *r_xsc,
+                                        const struct xrt_layer_data *data)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.layer_stereo_projection) {
+		return mc->compositor_hooks.layer_stereo_projection(mc, xdev, l_xsc, r_xsc, data);
+	}
+	mc->layer_count++;
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+mock_compositor_layer_stereo_projection_depth(struct xrt_compositor *xc,
+                                              struct xrt_device *xdev,
+                                              struct xrt_swapchain *l_xsc,
+                                              struct xrt_swapchain *r_xsc,
+                                              struct xrt_swapchain *l_d_xsc,
+                                              struct xrt_swapchain *r_d_xsc,
+                                              const struct xrt_layer_data *data)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.layer_stereo_projection_depth) {
+		return mc->compositor_hooks.layer_stereo_projection_depth(mc, xdev, l_xsc, r_xsc, l_d_xsc, r_d_xsc,
+		                                                          data);
+	}
+	mc->layer_count++;
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+mock_compositor_layer_quad(struct xrt_compositor *xc,
+                           struct xrt_device *xdev,
+                           struct xrt_swapchain *xsc,
+                           const struct xrt_layer_data *data)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.layer_quad) {
+		return mc->compositor_hooks.layer_quad(mc, xdev, xsc, data);
+	}
+	mc->layer_count++;
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+mock_compositor_layer_cube(struct xrt_compositor *xc,
+                           struct xrt_device *xdev,
+                           struct xrt_swapchain *xsc,
+                           const struct xrt_layer_data *data)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.layer_cube) {
+		return mc->compositor_hooks.layer_cube(mc, xdev, xsc, data);
+	}
+	mc->layer_count++;
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+mock_compositor_layer_cylinder(struct xrt_compositor *xc,
+                               struct xrt_device *xdev,
+                               struct xrt_swapchain *xsc,
+                               const struct xrt_layer_data *data)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.layer_cylinder) {
+		return mc->compositor_hooks.layer_cylinder(mc, xdev, xsc, data);
+	}
+	mc->layer_count++;
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+mock_compositor_layer_equirect1(struct xrt_compositor *xc,
+                                struct xrt_device *xdev,
+                                struct xrt_swapchain *xsc,
+                                const struct xrt_layer_data *data)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.layer_equirect1) {
+		return mc->compositor_hooks.layer_equirect1(mc, xdev, xsc, data);
+	}
+	mc->layer_count++;
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+mock_compositor_layer_equirect2(struct xrt_compositor *xc,
+                                struct xrt_device *xdev,
+                                struct xrt_swapchain *xsc,
+                                const struct xrt_layer_data *data)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.layer_equirect2) {
+		return mc->compositor_hooks.layer_equirect2(mc, xdev, xsc, data);
+	}
+	mc->layer_count++;
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+mock_compositor_layer_commit(struct xrt_compositor *xc, int64_t frame_id, xrt_graphics_sync_handle_t sync_handle)
+{
+	struct mock_compositor *mc = mock_compositor(xc);
+
+	if (mc->compositor_hooks.layer_commit) {
+		return mc->compositor_hooks.layer_commit(mc, frame_id, sync_handle);
+	}
+
+	// We own the handle now, nothing to wait for.
+	u_graphics_sync_unref(&sync_handle);
+	mc->commit_count++;
+
+	return XRT_SUCCESS;
+}
+
 static void
 mock_compositor_destroy(struct xrt_compositor *xc)
 {
@@ -182,23 +419,24 @@ mock_create_native_compositor()
 	mc->base.base.create_swapchain = mock_compositor_swapchain_create;
 	mc->base.base.import_swapchain = mock_compositor_swapchain_import;
 	// mc->base.base.create_semaphore = mock_compositor_semaphore_create;
-	// mc->base.base.begin_session = mock_compositor_begin_session;
-	// mc->base.base.end_session = mock_compositor_end_session;
-	// mc->base.base.wait_frame = mock_compositor_wait_frame;
-	// mc->base.base.begin_frame = mock_compositor_begin_frame;
-	// mc->base.base.discard_frame = mock_compositor_discard_frame;
-	// mc->base.base.layer_begin = mock_compositor_layer_begin;
-	// mc->base.base.layer_stereo_projection = mock_compositor_layer_stereo_projection;
-	// mc->base.base.layer_stereo_projection_depth = mock_compositor_layer_stereo_projection_depth;
-	// mc->base.base.layer_quad = mock_compositor_layer_quad;
-	// mc->base.base.layer_cube = mock_compositor_layer_cube;
-	// mc->base.base.layer_cylinder = mock_compositor_layer_cylinder;
-	// mc->base.base.layer_equirect1 = mock_compositor_layer_equirect1;
-	// mc->base.base.layer_equirect2 = mock_compositor_layer_equirect2;
-	// mc->base.base.layer_commit = mock_compositor_layer_commit;
+	mc->base.base.begin_session = mock_compositor_begin_session;
+	mc->base.base.end_session = mock_compositor_end_session;
+	mc->base.base.wait_frame = mock_compositor_wait_frame;
+	mc->base.base.begin_frame = mock_compositor_begin_frame;
+	mc->base.base.discard_frame = mock_compositor_discard_frame;
+	mc->base.base.layer_begin = mock_compositor_layer_begin;
+	mc->base.base.layer_stereo_projection = mock_compositor_layer_stereo_projection;
+	mc->base.base.layer_stereo_projection_depth = mock_compositor_layer_stereo_projection_depth;
+	mc->base.base.layer_quad = mock_compositor_layer_quad;
+	mc->base.base.layer_cube = mock_compositor_layer_cube;
+	mc->base.base.layer_cylinder = mock_compositor_layer_cylinder;
+	mc->base.base.layer_equirect1 = mock_compositor_layer_equirect1;
+	mc->base.base.layer_equirect2 = mock_compositor_layer_equirect2;
+	mc->base.base.layer_commit = mock_compositor_layer_commit;
 	// mc->base.base.layer_commit_with_semaphore = mock_compositor_layer_commit_with_semaphore;
-	// mc->base.base.poll_events = mock_compositor_poll_events;
+	mc->base.base.poll_events = mock_compositor_poll_events;
 	mc->base.base.destroy = mock_compositor_destroy;
+	mc->frame_period_ns = U_TIME_1S_IN_NS / 90;
 
 	return &mc->base;
 }
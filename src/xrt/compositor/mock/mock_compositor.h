@@ -34,6 +34,24 @@ struct mock_compositor
 	//! Mock users can populate this pointer to use data from hooks
 	void *userdata;
 
+	//! The frame id last handed out by wait_frame, a new one for every frame.
+	int64_t frame_id;
+
+	//! Predicted display period given out by the default wait_frame.
+	uint64_t frame_period_ns;
+
+	//! Layers given since the last layer_begin, counted by the default layer implementations.
+	uint32_t layer_count;
+
+	//! Frames committed by the default layer_commit.
+	uint64_t commit_count;
+
+	//! Set by the default begin and end session, reported as visible and focused by the default poll_events.
+	bool session_active;
+
+	//! The session state changed and has not been polled yet.
+	bool state_change_pending;
+
 	/*!
 	 * Optional function pointers you can populate to hook into the behavior of the mock compositor implementation.
 	 *
@@ -93,6 +111,8 @@ struct mock_compositor
 		                                 xrt_graphics_sync_handle_t *out_handle,
 		                                 struct xrt_compositor_semaphore **out_xcsem);
 
+#endif
+
 		/*!
 		 * Optional function pointer for mock compositor, called during @ref xrt_comp_poll_events
 		 */
@@ -108,6 +128,8 @@ struct mock_compositor
 		 */
 		xrt_result_t (*end_session)(struct mock_compositor *mc);
 
+		// Mocks for the following not yet implemented
+#if 0
 		/*!
 		 * Optional function pointer for mock compositor, called during @ref xrt_comp_predict_frame
 		 */
@@ -126,6 +148,7 @@ struct mock_compositor
 		                           int64_t frame_id,
 		                           enum xrt_compositor_frame_point point,
 		                           uint64_t when_ns);
+#endif
 
 		/*!
 		 * Optional function pointer for mock compositor, called during @ref xrt_comp_wait_frame
@@ -222,6 +245,8 @@ struct mock_compositor
 		                             int64_t frame_id,
 		                             xrt_graphics_sync_handle_t sync_handle);
 
+		// Mocks for the following not yet implemented
+#if 0
 		/*!
 		 * Optional function pointer for mock compositor, called during @ref
 		 * xrt_comp_layer_commit_with_semaphore
@@ -11,6 +11,9 @@
 #include "xrt/xrt_device.h"
 #include "math/m_api.h"
 #include "math/m_vec2.h"
+#include "util/u_misc.h"
+#include "util/u_worker.h"
+#include "util/u_distortion_mesh.h"
 #include "render/render_interface.h"
 
 #include <stdio.h>
@@ -585,7 +588,8 @@ create_and_fill_in_distortion_buffer_for_view(struct vk_bundle *vk,
                                               struct render_buffer *g_buffer,
                                               struct render_buffer *b_buffer,
                                               uint32_t view,
-                                              bool pre_rotate)
+                                              bool pre_rotate,
+                                              struct u_worker_group *uwg)
 {
 	VkBufferUsageFlags usage_flags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
@@ -618,31 +622,25 @@ create_and_fill_in_distortion_buffer_for_view(struct vk_bundle *vk,
 	struct texture *g = g_buffer->mapped;
 	struct texture *b = b_buffer->mapped;
 
-	const double dim_minus_one_f64 = COMP_DISTORTION_IMAGE_DIMENSIONS - 1;
+	const uint32_t dim = COMP_DISTORTION_IMAGE_DIMENSIONS;
+	struct xrt_uv_triplet *grid = U_TYPED_ARRAY_CALLOC(struct xrt_uv_triplet, dim * dim);
 
-	for (int row = 0; row < COMP_DISTORTION_IMAGE_DIMENSIONS; row++) {
-		// This goes from 0 to 1.0 inclusive.
-		float v = (float)(row / dim_minus_one_f64);
-
-		for (int col = 0; col < COMP_DISTORTION_IMAGE_DIMENSIONS; col++) {
-			// This goes from 0 to 1.0 inclusive.
-			float u = (float)(col / dim_minus_one_f64);
-
-			// These need to go from -0.5 to 0.5 for the rotation
-			struct xrt_vec2 uv = {u - 0.5f, v - 0.5f};
-			math_matrix_2x2_transform_vec2(&rot, &uv, &uv);
-			uv.x += 0.5f;
-			uv.y += 0.5f;
+	if (!u_distortion_mesh_sample_grid(xdev, view, dim, dim, &rot, uwg, grid)) {
+		VK_WARN(vk, "Distortion function failed for view %u", view);
+	}
 
-			struct xrt_uv_triplet result;
-			xrt_device_compute_distortion(xdev, view, uv.x, uv.y, &result);
+	for (uint32_t row = 0; row < dim; row++) {
+		for (uint32_t col = 0; col < dim; col++) {
+			const struct xrt_uv_triplet *result = &grid[row * dim + col];
 
-			r->pixels[row][col] = result.r;
-			g->pixels[row][col] = result.g;
-			b->pixels[row][col] = result.b;
+			r->pixels[row][col] = result->r;
+			g->pixels[row][col] = result->g;
+			b->pixels[row][col] = result->b;
 		}
 	}
 
+	free(grid);
+
 	render_buffer_unmap(vk, r_buffer);
 	render_buffer_unmap(vk, g_buffer);
 	render_buffer_unmap(vk, b_buffer);
@@ -1163,8 +1161,13 @@ render_distortion_buffer_init(struct render_resources *r,
 	calc_uv_to_tanangle(xdev, 0, &r->distortion.uv_to_tanangle[0]);
 	calc_uv_to_tanangle(xdev, 1, &r->distortion.uv_to_tanangle[1]);
 
-	create_and_fill_in_distortion_buffer_for_view(vk, xdev, &buffers[0], &buffers[2], &buffers[4], 0, pre_rotate);
-	create_and_fill_in_distortion_buffer_for_view(vk, xdev, &buffers[1], &buffers[3], &buffers[5], 1, pre_rotate);
+	// NULL if the distortion has to be evaluated on this thread.
+	struct u_worker_group *uwg = u_distortion_mesh_create_group(xdev);
+	create_and_fill_in_distortion_buffer_for_view( //
+	    vk, xdev, &buffers[0], &buffers[2], &buffers[4], 0, pre_rotate, uwg);
+	create_and_fill_in_distortion_buffer_for_view( //
+	    vk, xdev, &buffers[1], &buffers[3], &buffers[5], 1, pre_rotate, uwg);
+	u_worker_group_reference(&uwg, NULL);
 
 	VkCommandBuffer upload_buffer = VK_NULL_HANDLE;
 	C(vk_cmd_buffer_create_and_begin(vk, &upload_buffer));
@@ -24,10 +24,13 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <cstring>
 #include <stdio.h>
 #include <fstream>
 #include <future>
+#include <mutex>
 #include <thread>
 
 //! @see euroc_player_playback_config
@@ -45,17 +48,24 @@ DEBUG_GET_ONCE_BOOL_OPTION(send_all_imus_first, "EUROC_SEND_ALL_IMUS_FIRST", fal
 DEBUG_GET_ONCE_BOOL_OPTION(use_source_ts, "EUROC_USE_SOURCE_TS", false)
 DEBUG_GET_ONCE_BOOL_OPTION(play_from_start, "EUROC_PLAY_FROM_START", false)
 DEBUG_GET_ONCE_BOOL_OPTION(print_progress, "EUROC_PRINT_PROGRESS", false)
+DEBUG_GET_ONCE_NUM_OPTION(prefetch_frames, "EUROC_PREFETCH_FRAMES", 8)
+DEBUG_GET_ONCE_NUM_OPTION(decode_threads, "EUROC_DECODE_THREADS", 2)
 
 #define EUROC_PLAYER_STR "Euroc Player"
 
 using std::async;
+using std::condition_variable;
 using std::find_if;
 using std::ifstream;
 using std::is_same_v;
 using std::launch;
+using std::lock_guard;
+using std::mutex;
 using std::pair;
 using std::stof;
 using std::string;
+using std::thread;
+using std::unique_lock;
 using std::vector;
 
 using img_sample = pair<timepoint_ns, string>;
@@ -65,6 +75,49 @@ using imu_samples = vector<xrt_imu_sample>;
 using img_samples = vector<img_sample>;
 using gt_trajectory = vector<gt_entry>;
 
+/*!
+ * A decoded stereo frame in the prefetch ring.
+ */
+struct euroc_prefetch_slot
+{
+	uint64_t seq;            //!< The `img_seq` this slot was decoded for
+	bool ready;              //!< Whether the frames are decoded and not yet pushed
+	struct xrt_frame *left;  //!< Decoded left frame, timestamp set when pushed
+	struct xrt_frame *right; //!< Decoded right frame if stereo
+};
+
+/*!
+ * Decodes frames ahead of playback on a few threads so that the streaming
+ * thread only has to hand them out when their time comes. Slot `seq % size`
+ * holds frame `seq`, the decoders never get more than the ring size ahead of
+ * the next frame to push.
+ */
+struct euroc_prefetcher
+{
+	mutex lock{};
+	condition_variable cond{}; //!< Signaled when a slot is filled, emptied or when stopping
+	vector<euroc_prefetch_slot> slots{};
+	vector<thread> decoders{};
+	uint64_t next_decode = 0; //!< Next frame to hand to a decoder
+	uint64_t next_push = 0;   //!< Next frame the streaming thread will take
+	uint64_t end = 0;         //!< Number of frames in the dataset
+	bool running = false;
+};
+
+/*!
+ * Throughput and timing error of a stream, only touched by its streaming thread.
+ */
+struct euroc_player_stream_stats
+{
+	uint64_t pushed;           //!< Samples pushed
+	timepoint_ns first_ts;     //!< When the first sample was pushed
+	float rate_hz;             //!< Average samples pushed per second
+	float timing_error_ms;     //!< How late the last sample was pushed with respect to its mapped timestamp
+	float avg_timing_error_ms; //!< Average of the absolute timing error
+	float max_timing_error_ms; //!< Biggest absolute timing error
+	double sum_timing_error_ms;
+};
+
 enum euroc_player_ui_state
 {
 	UNINITIALIZED = 0,
@@ -110,6 +163,11 @@ struct euroc_player
 	img_samples *right_imgs; //!< List of all image names to read from the dataset
 	gt_trajectory *gt;       //!< List of all groundtruth poses read from the dataset
 
+	struct euroc_prefetcher *prefetcher; //!< Null if not decoding ahead
+	uint64_t prefetch_misses;            //!< Frames that weren't decoded yet when it was time to push them
+	struct euroc_player_stream_stats img_stats;
+	struct euroc_player_stream_stats imu_stats;
+
 	// Timestamp correction fields (can be disabled through `use_source_ts`)
 	timepoint_ns base_ts;   //!< First sample timestamp, stream timestamps are relative to this
 	timepoint_ns start_ts;  //!< When did the dataset started to be played
@@ -408,21 +466,20 @@ euroc_player_mapped_playback_ts(struct euroc_player *ep, timepoint_ns ts)
 	return euroc_player_mapped_ts(ep, ts);
 }
 
+//! Decodes frame number `seq`, its timestamp gets set by @ref euroc_player_push_next_frame.
 static void
-euroc_player_load_next_frame(struct euroc_player *ep, bool is_left, struct xrt_frame *&xf)
+euroc_player_load_frame(struct euroc_player *ep, uint64_t seq, bool is_left, struct xrt_frame *&xf)
 {
 	using xrt::auxiliary::tracking::FrameMat;
-	img_sample sample = is_left ? ep->left_imgs->at(ep->img_seq) : ep->right_imgs->at(ep->img_seq);
-	ep->playback.scale = CLAMP(ep->playback.scale, 1.0 / 16, 4);
+	img_sample sample = is_left ? ep->left_imgs->at(seq) : ep->right_imgs->at(seq);
 
 	// Load will be influenced by these playback options
 	bool allow_color = ep->playback.color;
-	float scale = ep->playback.scale;
+	float scale = CLAMP(ep->playback.scale, 1.0 / 16, 4);
 
 	// Load image from disk
-	timepoint_ns timestamp = euroc_player_mapped_playback_ts(ep, sample.first);
 	string img_name = sample.second;
-	EUROC_TRACE(ep, "%s img t = %ld filename = %s", is_left ? "left" : "right", timestamp, img_name.c_str());
+	EUROC_TRACE(ep, "%s img t = %ld filename = %s", is_left ? "left" : "right", sample.first, img_name.c_str());
 	cv::ImreadModes read_mode = allow_color ? cv::IMREAD_ANYCOLOR : cv::IMREAD_GRAYSCALE;
 	cv::Mat img = cv::imread(img_name, read_mode); // If colored, reads in BGR order
 
@@ -434,36 +491,209 @@ euroc_player_load_next_frame(struct euroc_player *ep, bool is_left, struct xrt_f
 
 	// Create xrt_frame, it will be freed by FrameMat destructor
 	EUROC_ASSERT(xf == NULL || xf->reference.count > 0, "Must be given a valid or NULL frame ptr");
-	EUROC_ASSERT(timestamp >= 0, "Unexpected negative timestamp");
 	//! @todo Not using xrt_stereo_format because we use two sinks. It would
 	//! probably be better to refactor everything to use stereo frames instead.
-	FrameMat::Params params{XRT_STEREO_FORMAT_NONE, static_cast<uint64_t>(timestamp)};
+	FrameMat::Params params{XRT_STEREO_FORMAT_NONE, 0};
 	auto wrap = img.channels() == 3 ? FrameMat::wrapR8G8B8 : FrameMat::wrapL8;
 	wrap(img, &xf, params);
 
 	// Fields that aren't set by FrameMat
 	xf->owner = ep;
 	xf->source_timestamp = sample.first;
-	xf->source_sequence = ep->img_seq;
+	xf->source_sequence = seq;
 	xf->source_id = ep->base.source_id;
 }
 
+static void
+euroc_player_load_stereo_frame(struct euroc_player *ep,
+                               uint64_t seq,
+                               struct xrt_frame *&left_xf,
+                               struct xrt_frame *&right_xf)
+{
+	euroc_player_load_frame(ep, seq, true, left_xf);
+	if (ep->playback.stereo) {
+		// TODO: Some SLAM systems expect synced frames, but that's not an
+		// EuRoC requirement. Adapt to work with unsynced datasets too.
+		euroc_player_load_frame(ep, seq, false, right_xf);
+		EUROC_ASSERT(left_xf->source_timestamp == right_xf->source_timestamp, "Unsynced stereo frames");
+	}
+}
+
+
+// Decode ahead functionality
+
+static void
+euroc_prefetcher_run(struct euroc_player *ep)
+{
+	struct euroc_prefetcher *pf = ep->prefetcher;
+	unique_lock lock{pf->lock};
+
+	while (true) {
+		// Wait for a free slot or for the end
+		pf->cond.wait(lock, [pf] {
+			bool has_work = pf->next_decode < pf->end && pf->next_decode < pf->next_push + pf->slots.size();
+			return !pf->running || has_work;
+		});
+		if (!pf->running) {
+			break;
+		}
+
+		uint64_t seq = pf->next_decode++;
+
+		lock.unlock();
+		struct xrt_frame *left_xf = NULL;
+		struct xrt_frame *right_xf = NULL;
+		euroc_player_load_stereo_frame(ep, seq, left_xf, right_xf);
+		lock.lock();
+
+		euroc_prefetch_slot &slot = pf->slots[seq % pf->slots.size()];
+		slot.seq = seq;
+		slot.ready = true;
+		slot.left = left_xf;
+		slot.right = right_xf;
+		pf->cond.notify_all();
+	}
+}
+
+static void
+euroc_prefetcher_start(struct euroc_player *ep)
+{
+	int frames = ep->playback.prefetch_frames;
+	if (frames <= 0) {
+		return;
+	}
+
+	struct euroc_prefetcher *pf = new euroc_prefetcher{};
+	pf->slots.resize(frames, euroc_prefetch_slot{UINT64_MAX, false, NULL, NULL});
+	pf->next_decode = ep->img_seq;
+	pf->next_push = ep->img_seq;
+	pf->end = ep->left_imgs->size();
+	pf->running = true;
+	ep->prefetcher = pf;
+
+	int threads = MAX(ep->playback.decode_threads, 1);
+	for (int i = 0; i < threads; i++) {
+		pf->decoders.emplace_back(euroc_prefetcher_run, ep);
+	}
+}
+
+static void
+euroc_prefetcher_stop(struct euroc_player *ep)
+{
+	struct euroc_prefetcher *pf = ep->prefetcher;
+	if (pf == NULL) {
+		return;
+	}
+
+	{
+		lock_guard lock{pf->lock};
+		pf->running = false;
+	}
+	pf->cond.notify_all();
+
+	for (thread &t : pf->decoders) {
+		t.join();
+	}
+
+	// Frames decoded but never pushed
+	for (euroc_prefetch_slot &slot : pf->slots) {
+		xrt_frame_reference(&slot.left, NULL);
+		xrt_frame_reference(&slot.right, NULL);
+	}
+
+	ep->prefetcher = NULL;
+	delete pf;
+}
+
+//! Takes frame `seq` out of the ring, waits for it if it is still being decoded.
+//! @returns false if playback was stopped while waiting.
+static bool
+euroc_prefetcher_take(struct euroc_player *ep, uint64_t seq, struct xrt_frame *&left_xf, struct xrt_frame *&right_xf)
+{
+	struct euroc_prefetcher *pf = ep->prefetcher;
+	unique_lock lock{pf->lock};
+	euroc_prefetch_slot &slot = pf->slots[seq % pf->slots.size()];
+
+	if (!slot.ready || slot.seq != seq) {
+		ep->prefetch_misses++;
+	}
+
+	// Playback might get stopped without the decoders knowing
+	while (!slot.ready || slot.seq != seq) {
+		if (!ep->is_running) {
+			return false;
+		}
+		pf->cond.wait_for(lock, std::chrono::milliseconds(15));
+	}
+
+	// Hand over the references
+	left_xf = slot.left;
+	right_xf = slot.right;
+	slot.left = NULL;
+	slot.right = NULL;
+	slot.ready = false;
+	pf->next_push = seq + 1;
+	pf->cond.notify_all();
+
+	return true;
+}
+
+
+// Streaming functionality
+
+//! Updates the throughput and timing error of a stream, called right before pushing a sample.
+static void
+euroc_player_record_push(struct euroc_player *ep, struct euroc_player_stream_stats *stats, timepoint_ns euroc_ts)
+{
+	timepoint_ns now = os_monotonic_get_ts();
+
+	if (stats->pushed++ == 0) {
+		stats->first_ts = now;
+	} else if (now > stats->first_ts) {
+		stats->rate_hz = (stats->pushed - 1) / ((now - stats->first_ts) / (double)U_TIME_1S_IN_NS);
+	}
+
+	// There is no schedule to keep when going as fast as possible
+	if (ep->playback.max_speed) {
+		return;
+	}
+
+	float error_ms = (now - euroc_player_mapped_ts(ep, euroc_ts)) / (double)U_TIME_1MS_IN_NS;
+	stats->timing_error_ms = error_ms;
+	stats->sum_timing_error_ms += fabs(error_ms);
+	stats->avg_timing_error_ms = stats->sum_timing_error_ms / stats->pushed;
+	stats->max_timing_error_ms = MAX(stats->max_timing_error_ms, fabsf(error_ms));
+}
+
 static void
 euroc_player_push_next_frame(struct euroc_player *ep)
 {
-	bool stereo = ep->playback.stereo;
+	uint64_t seq = ep->img_seq;
 
 	struct xrt_frame *left_xf = NULL;
 	struct xrt_frame *right_xf = NULL;
-	euroc_player_load_next_frame(ep, true, left_xf);
-	if (stereo) {
-		// TODO: Some SLAM systems expect synced frames, but that's not an
-		// EuRoC requirement. Adapt to work with unsynced datasets too.
-		euroc_player_load_next_frame(ep, false, right_xf);
-		EUROC_ASSERT(left_xf->timestamp == right_xf->timestamp, "Unsynced stereo frames");
+	if (ep->prefetcher != NULL) {
+		if (!euroc_prefetcher_take(ep, seq, left_xf, right_xf)) {
+			return;
+		}
+	} else {
+		euroc_player_load_stereo_frame(ep, seq, left_xf, right_xf);
 	}
 	ep->img_seq++;
 
+	// Stereo might have been toggled after this frame was decoded
+	bool stereo = right_xf != NULL;
+
+	timepoint_ns euroc_ts = ep->left_imgs->at(seq).first;
+	timepoint_ns timestamp = euroc_player_mapped_playback_ts(ep, euroc_ts);
+	EUROC_ASSERT(timestamp >= 0, "Unexpected negative timestamp");
+	left_xf->timestamp = timestamp;
+	if (stereo) {
+		right_xf->timestamp = timestamp;
+	}
+
+	euroc_player_record_push(ep, &ep->img_stats, euroc_ts);
+
 	xrt_sink_push_frame(ep->in_sinks.left, left_xf);
 	if (stereo) {
 		xrt_sink_push_frame(ep->in_sinks.right, right_xf);
@@ -486,7 +716,9 @@ static void
 euroc_player_push_next_imu(struct euroc_player *ep)
 {
 	xrt_imu_sample sample = ep->imus->at(ep->imu_seq++);
-	sample.timestamp_ns = euroc_player_mapped_playback_ts(ep, sample.timestamp_ns);
+	timepoint_ns euroc_ts = sample.timestamp_ns;
+	sample.timestamp_ns = euroc_player_mapped_playback_ts(ep, euroc_ts);
+	euroc_player_record_push(ep, &ep->imu_stats, euroc_ts);
 	xrt_sink_push_imu(ep->in_sinks.imu, &sample);
 }
 
@@ -605,6 +837,9 @@ euroc_player_stream(void *ptr)
 		euroc_player_push_all_gt(ep);
 	}
 
+	// Start decoding frames ahead, from where the skip left us
+	euroc_prefetcher_start(ep);
+
 	// Launch image and IMU producers
 	auto serve_imus = async(launch::async, [ep] { euroc_player_stream_samples<imu_samples>(ep); });
 	auto serve_imgs = async(launch::async, [ep] { euroc_player_stream_samples<img_samples>(ep); });
@@ -615,9 +850,16 @@ euroc_player_stream(void *ptr)
 	serve_imgs.get();
 	serve_imus.get();
 
+	euroc_prefetcher_stop(ep);
+
 	ep->is_running = false;
 
 	EUROC_INFO(ep, "Euroc dataset playback finished");
+	EUROC_INFO(ep, "frames: %lu at %.1fHz, timing error avg %.2fms max %.2fms, %lu not decoded in time",
+	           ep->img_stats.pushed, ep->img_stats.rate_hz, ep->img_stats.avg_timing_error_ms,
+	           ep->img_stats.max_timing_error_ms, ep->prefetch_misses);
+	EUROC_INFO(ep, "imu: %lu at %.1fHz, timing error avg %.2fms max %.2fms", ep->imu_stats.pushed,
+	           ep->imu_stats.rate_hz, ep->imu_stats.avg_timing_error_ms, ep->imu_stats.max_timing_error_ms);
 	euroc_player_set_ui_state(ep, STREAM_ENDED);
 
 	return NULL;
@@ -887,12 +1129,26 @@ euroc_player_setup_gui(struct euroc_player *ep)
 	u_var_add_f64(ep, &ep->playback.speed, "Speed");
 	u_var_add_bool(ep, &ep->playback.send_all_imus_first, "Send all IMU samples first");
 	u_var_add_bool(ep, &ep->playback.use_source_ts, "Use original timestamps");
+	// Only read when the decoders are created, set with EUROC_PREFETCH_FRAMES and EUROC_DECODE_THREADS
+	u_var_add_ro_i32(ep, &ep->playback.prefetch_frames, "Frames to decode ahead");
+	u_var_add_ro_i32(ep, &ep->playback.decode_threads, "Decoding threads");
 
 	u_var_add_gui_header(ep, NULL, "Streams");
 	u_var_add_ro_ff_vec3_f32(ep, ep->gyro_ff, "Gyroscope");
 	u_var_add_ro_ff_vec3_f32(ep, ep->accel_ff, "Accelerometer");
 	u_var_add_sink_debug(ep, &ep->ui_left_sink, "Left Camera");
 	u_var_add_sink_debug(ep, &ep->ui_right_sink, "Right Camera");
+
+	u_var_add_gui_header(ep, NULL, "Throughput");
+	u_var_add_ro_f32(ep, &ep->img_stats.rate_hz, "Frames (Hz)");
+	u_var_add_ro_f32(ep, &ep->img_stats.timing_error_ms, "Frame timing error (ms)");
+	u_var_add_ro_f32(ep, &ep->img_stats.avg_timing_error_ms, "Frame avg timing error (ms)");
+	u_var_add_ro_f32(ep, &ep->img_stats.max_timing_error_ms, "Frame max timing error (ms)");
+	u_var_add_ro_u64(ep, &ep->prefetch_misses, "Frames not decoded in time");
+	u_var_add_ro_f32(ep, &ep->imu_stats.rate_hz, "IMU (Hz)");
+	u_var_add_ro_f32(ep, &ep->imu_stats.timing_error_ms, "IMU timing error (ms)");
+	u_var_add_ro_f32(ep, &ep->imu_stats.avg_timing_error_ms, "IMU avg timing error (ms)");
+	u_var_add_ro_f32(ep, &ep->imu_stats.max_timing_error_ms, "IMU max timing error (ms)");
 }
 
 extern "C" void
@@ -920,6 +1176,8 @@ euroc_player_fill_default_config_for(struct euroc_player_config *config, const c
 	playback.use_source_ts = debug_get_bool_option_use_source_ts();
 	playback.play_from_start = debug_get_bool_option_play_from_start();
 	playback.print_progress = debug_get_bool_option_print_progress();
+	playback.prefetch_frames = debug_get_num_option_prefetch_frames();
+	playback.decode_threads = debug_get_num_option_decode_threads();
 
 	config->log_level = debug_get_log_option_euroc_log();
 	config->dataset = dataset;
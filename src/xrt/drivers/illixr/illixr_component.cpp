@@ -9,6 +9,11 @@ extern "C" {
 #include <array>
 
 #include "os/os_threading.h"
+#include "util/u_debug.h"
+#include "util/u_time.h"
+#include "util/u_var.h"
+
+#include "illixr_frame_sync.h"
 
 #include "common/plugin.hpp"
 #include "common/phonebook.hpp"
@@ -19,6 +24,8 @@ extern "C" {
 
 using namespace ILLIXR;
 
+DEBUG_GET_ONCE_NUM_OPTION(illixr_frame_timeout_ms, "ILLIXR_FRAME_TIMEOUT_MS", 100)
+
 /// Dummy plugin class for an instance during phonebook registration
 class illixr_plugin : public plugin {
 public:
@@ -30,10 +37,25 @@ public:
 		, sb_image_handle{sb->get_writer<image_handle>("image_handle")}
 		, sb_eyebuffer{sb->get_writer<rendered_frame>("eyebuffer")}
 		, sb_vsync_estimate{sb->get_writer<switchboard::event_wrapper<time_point>>("vsync_estimate")}
-		, sb_signal_quad{sb->get_reader<signal_to_quad>("signal_quad")}
-//		, ullong signal_quad{0}
 	{
-		signal_quad = 0;
+		uint64_t timeout_ms = (uint64_t)debug_get_num_option_illixr_frame_timeout_ms();
+		illixr_frame_sync_init(&frame_sync, timeout_ms * U_TIME_1MS_IN_NS);
+
+		u_var_add_root(&frame_sync, "ILLIXR Compositor", true);
+		illixr_frame_sync_add_vars(&frame_sync, &frame_sync);
+
+		// Timewarp bumps the sequence number once it has consumed a frame,
+		// the switchboard delivers it on its own thread.
+		sb->schedule<signal_to_quad>(id, "signal_quad",
+		                             [this](switchboard::ptr<const signal_to_quad> signal, std::size_t) {
+			                             illixr_frame_sync_signal(&frame_sync, signal->seq);
+		                             });
+	}
+
+	~illixr_plugin()
+	{
+		u_var_remove_root(&frame_sync);
+		illixr_frame_sync_destroy(&frame_sync);
 	}
 
 	const std::shared_ptr<switchboard> sb;
@@ -42,8 +64,7 @@ public:
 	switchboard::writer<image_handle> sb_image_handle;
 	switchboard::writer<rendered_frame> sb_eyebuffer;
 	switchboard::writer<switchboard::event_wrapper<time_point>> sb_vsync_estimate;
-	switchboard::reader<signal_to_quad> sb_signal_quad;
-	ullong signal_quad;
+	struct illixr_frame_sync frame_sync;
 	fast_pose_type prev_pose; /* stores a copy of pose each time illixr_read_pose() is called */
 	time_point sample_time; /* when prev_pose was stored */
 };
@@ -58,30 +79,44 @@ extern "C" plugin* illixr_monado_create_plugin(phonebook* pb) {
 }
 
 extern "C" struct xrt_pose illixr_read_pose() {
+	struct xrt_pose ret;
+	illixr_read_fast_pose(&ret);
+	return ret;
+}
+
+extern "C" uint64_t illixr_read_fast_pose(struct xrt_pose *out_pose) {
 	assert(illixr_plugin_obj && "illixr_plugin_obj must be initialized first.");
 
 	if (!illixr_plugin_obj->sb_pose->fast_pose_reliable()) {
 		std::cerr << "Pose not reliable yet; returning best guess" << std::endl;
 	}
-	struct xrt_pose ret;
 	const fast_pose_type fast_pose = illixr_plugin_obj->sb_pose->get_fast_pose();
 	const pose_type pose = fast_pose.pose;
 
 	// record when the pose was read for use in write_frame
-	illixr_plugin_obj->sample_time = illixr_plugin_obj->_m_clock->now();
-
-	ret.orientation.x = pose.orientation.x();
-	ret.orientation.y = pose.orientation.y();
-	ret.orientation.z = pose.orientation.z();
-	ret.orientation.w = pose.orientation.w();
-	ret.position.x = pose.position.x();
-	ret.position.y = pose.position.y();
-	ret.position.z = pose.position.z();
+	const time_point now = illixr_plugin_obj->_m_clock->now();
+	const uint64_t now_ns = os_monotonic_get_ns();
+	illixr_plugin_obj->sample_time = now;
+
+	out_pose->orientation.x = pose.orientation.x();
+	out_pose->orientation.y = pose.orientation.y();
+	out_pose->orientation.z = pose.orientation.z();
+	out_pose->orientation.w = pose.orientation.w();
+	out_pose->position.x = pose.position.x();
+	out_pose->position.y = pose.position.y();
+	out_pose->position.z = pose.position.z();
 
 	// store pose in static variable for use in write_frame
 	// illixr_plugin_obj->prev_pose = fast_pose; // copy member variables
 
-	return ret;
+	// The fast pose is predicted to predict_target_time on ILLIXR's relative
+	// clock, move that into Monado's monotonic clock domain.
+	if (fast_pose.predict_target_time == time_point{}) {
+		return now_ns;
+	}
+	const int64_t age_ns =
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(now - fast_pose.predict_target_time).count();
+	return (uint64_t)((int64_t)now_ns - age_ns);
 }
 
 extern "C" void illixr_publish_vk_image_handle(int fd, int64_t format, size_t size, uint32_t width, uint32_t height, uint32_t num_images, int usage) {
@@ -124,7 +159,7 @@ extern "C" void illixr_publish_vk_image_handle(int fd, int64_t format, size_t si
 	));
 }
 
-extern "C" void illixr_write_frame(GLuint left,
+extern "C" bool illixr_write_frame(GLuint left,
 								   GLuint right,
 								   struct xrt_pose render_pose) {
 	assert(illixr_plugin_obj != nullptr && "illixr_plugin_obj must be initialized first.");
@@ -152,11 +187,8 @@ extern "C" void illixr_write_frame(GLuint left,
 
     buffer_to_use = (buffer_to_use == 0U) ? 1U : 0U;
 
-	switchboard::ptr<const signal_to_quad> signal = illixr_plugin_obj->sb_signal_quad.get_ro_nullable();
-	while(signal == nullptr || signal->seq <= illixr_plugin_obj->signal_quad ) {
-		signal = illixr_plugin_obj->sb_signal_quad.get_ro_nullable();
-	}
-	illixr_plugin_obj->signal_quad = signal->seq;
+	// Sleep until timewarp has picked up the frame, instead of spinning on the switchboard.
+	return illixr_frame_sync_wait(&illixr_plugin_obj->frame_sync);
 }
 
 extern "C" void illixr_estimate_vsync_ns(uint64_t estimated_vsync) {
@@ -6,12 +6,27 @@ extern "C" {
 
 #include "GL/gl.h"
 
+#include <stdbool.h>
+#include <stdint.h>
+
 void* illixr_monado_create_plugin(void* pb);
 struct xrt_pose illixr_read_pose();
 
+/*!
+ * Read the latest fast pose from ILLIXR's pose prediction plugin.
+ *
+ * @return the time the pose is valid for, in the monotonic clock domain.
+ */
+uint64_t illixr_read_fast_pose(struct xrt_pose *out_pose);
+
 void illixr_publish_vk_image_handle(int fd, int64_t format, size_t size, uint32_t width, uint32_t height, uint32_t num_images, uint32_t swapchain_index);
 
-void illixr_write_frame(unsigned int left,
+/*!
+ * Hand a frame to ILLIXR and block until timewarp has consumed it.
+ *
+ * @return false if timewarp did not pick the frame up within the timeout.
+ */
+bool illixr_write_frame(unsigned int left,
                         unsigned int right,
                         struct xrt_pose render_pose);
 int64_t illixr_estimate_vsync_ns(uint64_t estimated_vsync);
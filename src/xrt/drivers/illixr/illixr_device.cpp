@@ -15,6 +15,7 @@
 #include <assert.h>
 #include <dlfcn.h>
 #include <alloca.h>
+#include <inttypes.h>
 #include <string>
 #include <sstream>
 
@@ -28,6 +29,7 @@
 #include "util/u_distortion_mesh.h"
 
 #include "illixr_component.h"
+#include "illixr_pose_history.h"
 #include "common/dynamic_lib.hpp"
 #include "common/global_module_defs.hpp"
 #include "common/runtime.hpp"
@@ -44,6 +46,9 @@ struct illixr_hmd
 
 	struct xrt_pose pose;
 
+	//! Fast poses read from ILLIXR, used to predict to the requested time.
+	struct illixr_pose_history pose_history;
+
 	bool print_spew;
 	bool print_debug;
 
@@ -105,6 +110,8 @@ illixr_hmd_destroy(struct xrt_device *xdev)
 	// Remove the variable tracking.
 	u_var_remove_root(dh);
 
+	illixr_pose_history_destroy(&dh->pose_history);
+
 	u_device_free(&dh->base);
 }
 
@@ -120,14 +127,31 @@ illixr_hmd_get_tracked_pose(struct xrt_device *xdev,
                             uint64_t at_timestamp_ns,
                             struct xrt_space_relation *out_relation)
 {
+	struct illixr_hmd *dh = illixr_hmd(xdev);
+
 	if (name != XRT_INPUT_GENERIC_HEAD_POSE) {
-		DH_ERROR(illixr_hmd(xdev), "unknown input name");
+		DH_ERROR(dh, "unknown input name");
 		return;
 	}
-	out_relation->pose = illixr_read_pose();
-	out_relation->relation_flags = (enum xrt_space_relation_flags)(
-	    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT |
-	    XRT_SPACE_RELATION_POSITION_VALID_BIT | XRT_SPACE_RELATION_POSITION_TRACKED_BIT);
+
+	// Feed the latest fast pose into the history, then predict to the requested time.
+	struct xrt_pose pose;
+	uint64_t pose_timestamp_ns = illixr_read_fast_pose(&pose);
+	if (illixr_pose_history_push(&dh->pose_history, &pose, pose_timestamp_ns)) {
+		dh->pose = pose;
+	}
+
+	enum m_relation_history_result res = illixr_pose_history_get(&dh->pose_history, at_timestamp_ns, out_relation);
+	if (res == M_RELATION_HISTORY_RESULT_INVALID) {
+		// Only happens for a zero timestamp, hand out the raw pose.
+		out_relation->pose = pose;
+		out_relation->relation_flags = (enum xrt_space_relation_flags)(
+		    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT |
+		    XRT_SPACE_RELATION_POSITION_VALID_BIT | XRT_SPACE_RELATION_POSITION_TRACKED_BIT);
+	}
+
+	DH_SPEW(dh, "pose at %" PRIu64 ", requested %" PRIu64 ", result %d", pose_timestamp_ns, at_timestamp_ns,
+	        (int)res);
 }
 
 static void
@@ -186,6 +210,7 @@ illixr_hmd_create(const char *path_in, const char *comp_in)
 	dh->base.hmd->blend_mode_count = idx;
 
 	dh->pose.orientation.w = 1.0f; // All other values set to zero.
+	illixr_pose_history_init(&dh->pose_history);
 	dh->print_spew = debug_get_bool_option_illixr_spew();
 	dh->print_debug = debug_get_bool_option_illixr_debug();
 	dh->path = path_in;
@@ -218,6 +243,8 @@ illixr_hmd_create(const char *path_in, const char *comp_in)
 	// Setup variable tracker.
 	u_var_add_root(dh, "ILLIXR", true);
 	u_var_add_pose(dh, &dh->pose, "pose");
+	u_var_add_ro_u64(dh, &dh->pose_history.pushed, "Poses pushed");
+	u_var_add_ro_u64(dh, &dh->pose_history.stale, "Poses stale");
 
 	if (dh->base.hmd->distortion.preferred == XRT_DISTORTION_MODEL_NONE) {
 		// Setup the distortion mesh.
@@ -0,0 +1,110 @@
+// Copyright 2020-2022, The Board of Trustees of the University of Illinois.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Blocking handoff between the Monado compositor and ILLIXR timewarp.
+ * @ingroup drv_illixr
+ */
+
+#include "os/os_time.h"
+#include "util/u_misc.h"
+#include "util/u_time.h"
+
+#include "illixr_frame_sync.h"
+
+#include <errno.h>
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+int
+illixr_frame_sync_init(struct illixr_frame_sync *ifs, uint64_t timeout_ns)
+{
+	assert(timeout_ns > 0);
+
+	U_ZERO(ifs);
+
+	int ret = os_mutex_init(&ifs->mutex);
+	if (ret != 0) {
+		return ret;
+	}
+
+	ret = os_cond_init(&ifs->cond);
+	if (ret != 0) {
+		os_mutex_destroy(&ifs->mutex);
+		return ret;
+	}
+
+	ifs->timeout_ns = timeout_ns;
+
+	u_duration_stats_init(&ifs->stats.wait, (float)time_ns_to_ms_f((time_duration_ns)timeout_ns), false);
+
+	return 0;
+}
+
+void
+illixr_frame_sync_add_vars(struct illixr_frame_sync *ifs, void *root)
+{
+	u_var_add_gui_header(root, NULL, "Timewarp handoff");
+	u_var_add_ro_u64(root, &ifs->stats.wait.count, "Frames");
+	u_var_add_ro_u64(root, &ifs->stats.timeouts, "Timeouts");
+	u_duration_stats_add_vars(&ifs->stats.wait, root, "wait");
+}
+
+void
+illixr_frame_sync_signal(struct illixr_frame_sync *ifs, uint64_t seq)
+{
+	os_mutex_lock(&ifs->mutex);
+	if (seq > ifs->published_seq) {
+		ifs->published_seq = seq;
+		os_cond_signal(&ifs->cond);
+	}
+	os_mutex_unlock(&ifs->mutex);
+}
+
+bool
+illixr_frame_sync_wait(struct illixr_frame_sync *ifs)
+{
+	uint64_t start_ns = os_monotonic_get_ns();
+	uint64_t deadline_ns = start_ns + ifs->timeout_ns;
+	bool timed_out = false;
+
+	os_mutex_lock(&ifs->mutex);
+	while (ifs->published_seq <= ifs->consumed_seq) {
+		uint64_t now_ns = os_monotonic_get_ns();
+		if (now_ns >= deadline_ns) {
+			timed_out = true;
+			break;
+		}
+
+		// Spurious wakeups and the realtime clock jumping are handled by the loop.
+		if (os_cond_timedwait(&ifs->cond, &ifs->mutex, deadline_ns - now_ns) == ETIMEDOUT &&
+		    ifs->published_seq <= ifs->consumed_seq) {
+			timed_out = true;
+			break;
+		}
+	}
+
+	if (!timed_out) {
+		ifs->consumed_seq = ifs->published_seq;
+	}
+	os_mutex_unlock(&ifs->mutex);
+
+	if (timed_out) {
+		ifs->stats.timeouts++;
+	}
+	u_duration_stats_add(&ifs->stats.wait, os_monotonic_get_ns() - start_ns);
+
+	return !timed_out;
+}
+
+void
+illixr_frame_sync_destroy(struct illixr_frame_sync *ifs)
+{
+	os_cond_destroy(&ifs->cond);
+	os_mutex_destroy(&ifs->mutex);
+}
@@ -0,0 +1,109 @@
+// Copyright 2020-2022, The Board of Trustees of the University of Illinois.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Blocking handoff between the Monado compositor and ILLIXR timewarp.
+ * @ingroup drv_illixr
+ */
+
+#pragma once
+
+#include "xrt/xrt_compiler.h"
+
+#include "os/os_threading.h"
+#include "util/u_duration_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*!
+ * Hands a rendered frame from the compositor thread over to ILLIXR and blocks
+ * until timewarp has picked it up, which it signals by publishing a new
+ * @p signal_to_quad sequence number on the switchboard.
+ *
+ * The producer side (@ref illixr_frame_sync_signal) is called from a
+ * switchboard callback, the consumer side (@ref illixr_frame_sync_wait) from
+ * the compositor thread. The consumer sleeps on a condition variable instead
+ * of polling the switchboard, and gives up after a bounded timeout so a
+ * stalled timewarp can't wedge the compositor.
+ *
+ * @ingroup drv_illixr
+ */
+struct illixr_frame_sync
+{
+	struct os_mutex mutex;
+	struct os_cond cond;
+
+	//! Latest sequence number published by timewarp, protected by mutex.
+	uint64_t published_seq;
+
+	//! Last sequence number the compositor has consumed, protected by mutex.
+	uint64_t consumed_seq;
+
+	//! How long @ref illixr_frame_sync_wait blocks at most.
+	uint64_t timeout_ns;
+
+	//! Statistics, only touched by the consumer thread.
+	struct
+	{
+		//! Number of waits that hit the timeout.
+		uint64_t timeouts;
+
+		//! Time spent in each wait.
+		struct u_duration_stats wait;
+	} stats;
+};
+
+/*!
+ * Init the sync object, @p timeout_ns must be non-zero.
+ *
+ * @public @memberof illixr_frame_sync
+ */
+int
+illixr_frame_sync_init(struct illixr_frame_sync *ifs, uint64_t timeout_ns);
+
+/*!
+ * Add the statistics to the variable tracking under @p root.
+ *
+ * @public @memberof illixr_frame_sync
+ */
+void
+illixr_frame_sync_add_vars(struct illixr_frame_sync *ifs, void *root);
+
+/*!
+ * Producer side: timewarp has published sequence number @p seq, wakes up the
+ * compositor thread if it is waiting. Older or repeated sequence numbers are
+ * ignored.
+ *
+ * @public @memberof illixr_frame_sync
+ */
+void
+illixr_frame_sync_signal(struct illixr_frame_sync *ifs, uint64_t seq);
+
+/*!
+ * Consumer side: block until a sequence number newer than the last consumed
+ * one has been signalled, or until the timeout expires. Records the time
+ * spent waiting.
+ *
+ * @return true if a new sequence number arrived, false on timeout.
+ *
+ * @public @memberof illixr_frame_sync
+ */
+bool
+illixr_frame_sync_wait(struct illixr_frame_sync *ifs);
+
+/*!
+ * Clean up, the caller must make sure that no more signals are delivered and
+ * remove any variable tracking root first.
+ *
+ * @public @memberof illixr_frame_sync
+ */
+void
+illixr_frame_sync_destroy(struct illixr_frame_sync *ifs);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,68 @@
+// Copyright 2020-2022, The Board of Trustees of the University of Illinois.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Timestamped history of ILLIXR fast poses, for prediction.
+ * @ingroup drv_illixr
+ */
+
+#include "util/u_misc.h"
+
+#include "illixr_pose_history.h"
+
+
+void
+illixr_pose_history_init(struct illixr_pose_history *iph)
+{
+	U_ZERO(iph);
+	m_relation_history_create(&iph->relation_hist);
+}
+
+bool
+illixr_pose_history_push(struct illixr_pose_history *iph, const struct xrt_pose *pose, uint64_t timestamp_ns)
+{
+	struct xrt_space_relation relation = XRT_SPACE_RELATION_ZERO;
+	relation.pose = *pose;
+	relation.relation_flags = (enum xrt_space_relation_flags)(
+	    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT |
+	    XRT_SPACE_RELATION_POSITION_VALID_BIT | XRT_SPACE_RELATION_POSITION_TRACKED_BIT);
+
+	uint64_t last_ns = 0;
+	struct xrt_space_relation last_relation;
+	bool have_last = m_relation_history_get_latest(iph->relation_hist, &last_ns, &last_relation);
+
+	// The pose is polled, so the same sample is usually read several times.
+	if (have_last && timestamp_ns <= last_ns) {
+		iph->stale++;
+		return false;
+	}
+
+	if (have_last) {
+		// Adds finite-difference velocities and their flags.
+		m_relation_history_estimate_motion(iph->relation_hist, &relation, timestamp_ns, &relation);
+	}
+
+	if (!m_relation_history_push(iph->relation_hist, &relation, timestamp_ns)) {
+		// Lost a race against another thread pushing a newer sample.
+		iph->stale++;
+		return false;
+	}
+
+	iph->pushed++;
+
+	return true;
+}
+
+enum m_relation_history_result
+illixr_pose_history_get(struct illixr_pose_history *iph,
+                        uint64_t at_timestamp_ns,
+                        struct xrt_space_relation *out_relation)
+{
+	return m_relation_history_get(iph->relation_hist, at_timestamp_ns, out_relation);
+}
+
+void
+illixr_pose_history_destroy(struct illixr_pose_history *iph)
+{
+	m_relation_history_destroy(&iph->relation_hist);
+}
@@ -0,0 +1,79 @@
+// Copyright 2020-2022, The Board of Trustees of the University of Illinois.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Timestamped history of ILLIXR fast poses, for prediction.
+ * @ingroup drv_illixr
+ */
+
+#pragma once
+
+#include "xrt/xrt_defines.h"
+
+#include "math/m_relation_history.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*!
+ * Keeps the poses read from ILLIXR's pose_prediction plugin in a
+ * @ref m_relation_history, with velocities estimated by finite differences
+ * between consecutive samples, so that the HMD can be queried at any
+ * timestamp the same way as other Monado devices.
+ *
+ * @ingroup drv_illixr
+ */
+struct illixr_pose_history
+{
+	struct m_relation_history *relation_hist;
+
+	//! Number of samples added to the history.
+	uint64_t pushed;
+
+	//! Number of samples dropped because they were not newer than the latest one.
+	uint64_t stale;
+};
+
+/*!
+ * Create the underlying history.
+ *
+ * @public @memberof illixr_pose_history
+ */
+void
+illixr_pose_history_init(struct illixr_pose_history *iph);
+
+/*!
+ * Add a pose that ILLIXR reported for @p timestamp_ns, in the monotonic clock
+ * domain. Velocities are estimated against the previous sample.
+ *
+ * @return false if the sample was not newer than the latest one and dropped.
+ *
+ * @public @memberof illixr_pose_history
+ */
+bool
+illixr_pose_history_push(struct illixr_pose_history *iph, const struct xrt_pose *pose, uint64_t timestamp_ns);
+
+/*!
+ * Interpolate or extrapolate the history to @p at_timestamp_ns.
+ *
+ * @public @memberof illixr_pose_history
+ */
+enum m_relation_history_result
+illixr_pose_history_get(struct illixr_pose_history *iph,
+                        uint64_t at_timestamp_ns,
+                        struct xrt_space_relation *out_relation);
+
+/*!
+ * Free the underlying history.
+ *
+ * @public @memberof illixr_pose_history
+ */
+void
+illixr_pose_history_destroy(struct illixr_pose_history *iph);
+
+
+#ifdef __cplusplus
+}
+#endif
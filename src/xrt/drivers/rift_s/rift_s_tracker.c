@@ -303,6 +303,9 @@ rift_s_tracker_add_debug_ui(struct rift_s_tracker *t, void *root)
 	u_var_add_gui_header(root, NULL, "3DoF Tracking");
 	m_imu_3dof_add_vars(&t->fusion.i3dof, root, "");
 
+	u_var_add_gui_header(root, NULL, "Clock");
+	m_clock_tracker_add_vars(&t->hw2mono, root, "hw2mono.");
+
 	u_var_add_gui_header(root, NULL, "SLAM Tracking");
 	u_var_add_ro_text(root, t->gui.slam_status, "Tracker status");
 
@@ -333,6 +336,8 @@ rift_s_tracker_create(struct xrt_tracking_origin *origin,
 	t->base.tracking_origin = origin;
 	t->base.get_tracked_pose = rift_s_tracker_get_tracked_pose_imu;
 
+	m_clock_tracker_init(&t->hw2mono, 5.0);
+
 	// Pose / state lock
 	int ret = os_mutex_init(&t->mutex);
 	if (ret != 0) {
@@ -465,39 +470,15 @@ rift_s_tracker_get_hand_tracking_device(struct rift_s_tracker *t)
 	return t->handtracker;
 }
 
-//! Given a sample from two timestamp domains a and b that should have been
-//! sampled as close as possible, together with an estimate of the offset
-//! between a clock and b clock (or zero), it applies a smoothing average on the
-//! estimated offset and returns a in b clock.
-//! @todo Copy of clock_hw2mono in wmr_source.c and vive_source.c, unify into a utility.
-static inline timepoint_ns
-clock_offset_a2b(double freq, timepoint_ns a, timepoint_ns b, time_duration_ns *inout_a2b)
-{
-	// Totally arbitrary way of computing alpha, if you have a better one, replace it
-	const double alpha = 1.0 - 12.5 / freq; // Weight to put on accumulated a2b
-	time_duration_ns old_a2b = *inout_a2b;
-	time_duration_ns got_a2b = b - a;
-	time_duration_ns new_a2b = old_a2b * alpha + got_a2b * (1.0 - alpha);
-	if (old_a2b == 0) { // a2b has not been set yet
-		new_a2b = got_a2b;
-	}
-	*inout_a2b = new_a2b;
-	return a + new_a2b;
-}
-
 void
 rift_s_tracker_clock_update(struct rift_s_tracker *t, uint64_t device_timestamp_ns, timepoint_ns local_timestamp_ns)
 {
 	os_mutex_lock(&t->mutex);
-	time_duration_ns last_hw2mono = t->hw2mono;
-	clock_offset_a2b(25000, device_timestamp_ns, local_timestamp_ns, &t->hw2mono);
+	m_clock_tracker_update(&t->hw2mono, device_timestamp_ns, local_timestamp_ns);
 
-	if (!t->have_hw2mono) {
-		time_duration_ns change_ns = last_hw2mono - t->hw2mono;
-		if (change_ns >= -U_TIME_HALF_MS_IN_NS && change_ns <= U_TIME_HALF_MS_IN_NS) {
-			RIFT_S_INFO("HMD device to local clock map stabilised");
-			t->have_hw2mono = true;
-		}
+	if (!t->have_hw2mono && m_clock_tracker_is_converged(&t->hw2mono)) {
+		RIFT_S_INFO("HMD device to local clock map stabilised");
+		t->have_hw2mono = true;
 	}
 	os_mutex_unlock(&t->mutex);
 }
@@ -506,7 +487,7 @@ rift_s_tracker_clock_update(struct rift_s_tracker *t, uint64_t device_timestamp_
 static void
 clock_hw2mono_get(struct rift_s_tracker *t, uint64_t device_ts, timepoint_ns *out)
 {
-	*out = t->hw2mono + device_ts;
+	*out = m_clock_tracker_a2b(&t->hw2mono, device_ts);
 }
 
 void
@@ -538,7 +519,8 @@ rift_s_tracker_imu_update(struct rift_s_tracker *t,
 	RIFT_S_TRACE("IMU timestamp %" PRIu64 " (dt %f) hw2mono local ts %" PRIu64 " (dt %f) offset %" PRId64,
 	             device_timestamp_ns,
 	             (double)(device_timestamp_ns - t->fusion.last_imu_timestamp_ns) / 1000000000.0, local_timestamp_ns,
-	             (double)(local_timestamp_ns - t->fusion.last_imu_local_timestamp_ns) / 1000000000.0, t->hw2mono);
+	             (double)(local_timestamp_ns - t->fusion.last_imu_local_timestamp_ns) / 1000000000.0,
+	             (int64_t)(local_timestamp_ns - device_timestamp_ns));
 
 	t->fusion.last_angular_velocity = *gyro;
 	t->fusion.last_imu_timestamp_ns = device_timestamp_ns;
@@ -15,6 +15,7 @@
 
 #pragma once
 
+#include "math/m_clock_tracker.h"
 #include "math/m_imu_3dof.h"
 #include "os/os_threading.h"
 #include "util/u_var.h"
@@ -83,9 +84,10 @@ struct rift_s_tracker
 	struct xrt_pose device_from_imu;
 	struct xrt_pose left_cam_from_imu;
 
-	//!< Estimated offset from HMD device timestamp to local monotonic clock
+	//! Whether hw2mono has settled enough to use
 	bool have_hw2mono;
-	time_duration_ns hw2mono;
+	//! Mapping from HMD device timestamp to local monotonic clock
+	struct m_clock_tracker hw2mono;
 	timepoint_ns last_frame_time;
 
 	//! Adjustment to apply to camera timestamps to bring them into the
@@ -892,6 +892,7 @@ vive_device_create(struct os_hid_device *mainboard_dev,
 
 	d->base.hmd->distortion.models = XRT_DISTORTION_MODEL_COMPUTE;
 	d->base.hmd->distortion.preferred = XRT_DISTORTION_MODEL_COMPUTE;
+	d->base.hmd->distortion.compute_thread_safe = true; // Only reads the config.
 	d->base.compute_distortion = compute_distortion;
 
 	if (d->mainboard_dev) {
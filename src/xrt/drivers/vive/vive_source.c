@@ -8,6 +8,7 @@
  */
 
 #include "os/os_threading.h"
+#include "math/m_clock_tracker.h"
 #include "util/u_deque.h"
 #include "util/u_logging.h"
 #include "xrt/xrt_frame.h"
@@ -41,30 +42,13 @@ struct vive_source
 	uint32_t last_frame_ticks;                    //! Last frame timestamp in device ticks
 	timepoint_ns last_frame_ts_ns;                //! Last frame timestamp in device nanoseconds
 
-	// Clock offsets
-	time_duration_ns hw2mono; //!< Estimated offset from IMU to monotonic clock
-	time_duration_ns hw2v4l2; //!< Estimated offset from IMU to V4L2 clock
+	// Clock mappings
+	struct m_clock_tracker hw2mono; //!< IMU to monotonic clock, updated from IMU samples
+	struct m_clock_tracker hw2v4l2; //!< IMU to V4L2 clock, updated from frames
 };
 
-//! Given a sample from two timestamp domains a and b that should have been
-//! sampled as close as possible, together with an estimate of the offset
-//! between a clock and b clock (or zero), it applies a smoothing average on the
-//! estimated offset and returns a in b clock.
-//! @todo Copy of clock_hw2mono in wmr_source.c, unify into a utility.
-static inline timepoint_ns
-clock_offset_a2b(double freq, timepoint_ns a, timepoint_ns b, time_duration_ns *inout_a2b)
-{
-	// Totally arbitrary way of computing alpha, if you have a better one, replace it
-	const double alpha = 1.0 - 12.5 / freq; // Weight to put on accumulated a2b
-	time_duration_ns old_a2b = *inout_a2b;
-	time_duration_ns got_a2b = b - a;
-	time_duration_ns new_a2b = old_a2b * alpha + got_a2b * (1.0 - alpha);
-	if (old_a2b == 0) { // a2b has not been set yet
-		new_a2b = got_a2b;
-	}
-	*inout_a2b = new_a2b;
-	return a + new_a2b;
-}
+//! How long samples influence the clock mappings.
+#define CLOCK_TIME_CONSTANT_S 5.0
 
 /*
  *
@@ -105,7 +89,7 @@ vive_source_try_convert_v4l2_timestamp(struct vive_source *vs, struct xrt_frame
 	time_duration_ns min_distance = INT64_MAX;
 	for (size_t i = 0; i < vive_ts_count; i++) {
 		vive_ts = u_deque_timepoint_ns_at(vive_timestamps, i);
-		timepoint_ns v4l2_ts_est = vive_ts + vs->hw2v4l2;
+		timepoint_ns v4l2_ts_est = m_clock_tracker_a2b(&vs->hw2v4l2, vive_ts);
 		time_duration_ns distance = llabs(v4l2_ts_est - v4l2_ts);
 		if (distance < min_distance) {
 			closer_i = i;
@@ -125,11 +109,11 @@ vive_source_try_convert_v4l2_timestamp(struct vive_source *vs, struct xrt_frame
 	assert(min_distance < U_TIME_1S_IN_NS / CAMERA_FREQUENCY || vs->waiting_for_first_nonempty_frame);
 	vs->waiting_for_first_nonempty_frame = false;
 
-	// Update estimate of hw2v4l2 clock offset, only used for matching timestamps
-	clock_offset_a2b(CAMERA_FREQUENCY, vive_timestamp, xf->timestamp, &vs->hw2v4l2);
+	// Update estimate of hw2v4l2 clock mapping, only used for matching timestamps
+	m_clock_tracker_update(&vs->hw2v4l2, vive_timestamp, xf->timestamp);
 
-	// Use vive_timestamp and put it in monotonic clock
-	xf->timestamp = vive_timestamp + vs->hw2mono; // Notice that we don't use hw2v4l2
+	// Use vive_timestamp and put it in monotonic clock, hw2mono is updated from the IMU thread
+	xf->timestamp = m_clock_tracker_a2b(&vs->hw2mono, vive_timestamp); // Notice that we don't use hw2v4l2
 
 	return true;
 }
@@ -156,7 +140,7 @@ static void
 vive_source_receive_imu_sample(struct xrt_imu_sink *sink, struct xrt_imu_sample *s)
 {
 	struct vive_source *vs = container_of(sink, struct vive_source, imu_sink);
-	s->timestamp_ns = clock_offset_a2b(IMU_FREQUENCY, s->timestamp_ns, os_monotonic_get_ns(), &vs->hw2mono);
+	s->timestamp_ns = m_clock_tracker_update(&vs->hw2mono, s->timestamp_ns, os_monotonic_get_ns());
 	timepoint_ns ts = s->timestamp_ns;
 	struct xrt_vec3_f64 a = s->accel_m_s2;
 	struct xrt_vec3_f64 w = s->gyro_rad_secs;
@@ -207,6 +191,9 @@ vive_source_create(struct xrt_frame_context *xfctx)
 	vs->frame_timestamps = u_deque_timepoint_ns_create();
 	os_mutex_init(&vs->frame_timestamps_lock);
 
+	m_clock_tracker_init(&vs->hw2mono, CLOCK_TIME_CONSTANT_S);
+	m_clock_tracker_init(&vs->hw2v4l2, CLOCK_TIME_CONSTANT_S);
+
 	// Setup node
 	struct xrt_frame_node *xfn = &vs->node;
 	xfn->break_apart = vive_source_node_break_apart;
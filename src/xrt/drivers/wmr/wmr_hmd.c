@@ -1874,6 +1874,7 @@ wmr_hmd_create(enum wmr_headset_type hmd_type,
 
 	wh->base.hmd->distortion.models = XRT_DISTORTION_MODEL_COMPUTE;
 	wh->base.hmd->distortion.preferred = XRT_DISTORTION_MODEL_COMPUTE;
+	wh->base.hmd->distortion.compute_thread_safe = true; // Only reads the config.
 	wh->base.compute_distortion = compute_distortion_wmr;
 	u_distortion_mesh_fill_in_compute(&wh->base);
 
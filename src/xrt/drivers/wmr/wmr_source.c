@@ -12,6 +12,7 @@
 #include "wmr_protocol.h"
 
 #include "math/m_api.h"
+#include "math/m_clock_tracker.h"
 #include "math/m_filter_fifo.h"
 #include "util/u_debug.h"
 #include "util/u_sink.h"
@@ -74,10 +75,13 @@ struct wmr_source
 
 	bool is_running;              //!< Whether the device is streaming
 	bool first_imu_received;      //!< Don't send frames until first IMU sample
-	time_duration_ns hw2mono;     //!< Estimated offset from IMU to monotonic clock
-	time_duration_ns cam_hw2mono; //!< Cache for hw2mono used in last left frame
+	struct m_clock_tracker hw2mono;             //!< IMU to monotonic clock mapping
+	struct m_clock_tracker_mapping cam_hw2mono; //!< Cache for hw2mono used in last left frame
 };
 
+//! How long samples influence the hw2mono mapping.
+#define CLOCK_TIME_CONSTANT_S 5.0
+
 /*
  *
  * Sinks functionality
@@ -94,17 +98,7 @@ struct wmr_source
 static inline void
 clock_hw2mono(struct wmr_source *ws, timepoint_ns *ts)
 {
-	const double alpha = 0.95; // Weight to put on accumulated hw2mono clock offset
-	timepoint_ns mono = os_monotonic_get_ns();
-	timepoint_ns hw = *ts;
-	time_duration_ns old_hw2mono = ws->hw2mono;
-	time_duration_ns got_hw2mono = mono - hw;
-	time_duration_ns new_hw2mono = old_hw2mono * alpha + got_hw2mono * (1.0 - alpha);
-	if (old_hw2mono == 0) { // hw2mono was not set for the first time yet
-		new_hw2mono = got_hw2mono;
-	}
-	ws->hw2mono = new_hw2mono;
-	*ts = hw + new_hw2mono;
+	*ts = m_clock_tracker_update(&ws->hw2mono, *ts, os_monotonic_get_ns());
 }
 
 //! Camera specific logic for clock conversion
@@ -112,9 +106,10 @@ static inline void
 clock_cam_hw2mono(struct wmr_source *ws, struct xrt_frame *xf, bool is_left)
 {
 	if (is_left) {
-		ws->cam_hw2mono = ws->hw2mono; // Cache last hw2mono used for right frame
+		// Cache last hw2mono used for right frame, updated from the IMU thread
+		m_clock_tracker_get_mapping(&ws->hw2mono, &ws->cam_hw2mono);
 	}
-	xf->timestamp += ws->cam_hw2mono;
+	xf->timestamp = m_clock_tracker_mapping_a2b(&ws->cam_hw2mono, xf->timestamp);
 }
 
 static void
@@ -322,6 +317,8 @@ wmr_source_create(struct xrt_frame_context *xfctx, struct xrt_prober_device *dev
 	snprintf(xfs->serial, sizeof(xfs->serial), WMR_SOURCE_STR " Serial");
 	xfs->source_id = 0x574d522d53524300; // WMR_SRC\0 in hex
 
+	m_clock_tracker_init(&ws->hw2mono, CLOCK_TIME_CONSTANT_S);
+
 	// Setup sinks
 	ws->left_sink.push_frame = receive_left_frame;
 	ws->right_sink.push_frame = receive_right_frame;
@@ -343,6 +340,7 @@ wmr_source_create(struct xrt_frame_context *xfctx, struct xrt_prober_device *dev
 	u_var_add_ro_ff_vec3_f32(ws, ws->accel_ff, "Accelerometer");
 	u_var_add_sink_debug(ws, &ws->ui_left_sink, "Left Camera");
 	u_var_add_sink_debug(ws, &ws->ui_right_sink, "Right Camera");
+	m_clock_tracker_add_vars(&ws->hw2mono, ws, "hw2mono.");
 
 	// Setup node
 	struct xrt_frame_node *xfn = &ws->node;
@@ -81,6 +81,18 @@
 #endif
 
 
+/*
+ * Thread local storage, for C code that can't use C11 or C++11 keywords.
+ */
+#if defined(__GNUC__)
+#define XRT_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#define XRT_THREAD_LOCAL __declspec(thread)
+#else
+#error "compiler not supported"
+#endif
+
+
 #ifdef XRT_DOXYGEN
 /*!
  * To trigger a trap/break in the debugger.
@@ -123,6 +123,9 @@ struct xrt_hmd_parts
 		//! Preferred disortion model, single value.
 		enum xrt_distortion_model preferred;
 
+		//! @ref xrt_device::compute_distortion can be called from multiple threads at once.
+		bool compute_thread_safe;
+
 		struct
 		{
 			//! Data.
@@ -42,6 +42,54 @@
 struct xrt_compositor_native;
 
 
+/*!
+ * A call added to a @ref ipc_batch.
+ */
+struct ipc_batch_call
+{
+	//! The @ref ipc_command of the call.
+	uint32_t cmd;
+
+	//! Size of the reply struct of the call.
+	uint32_t reply_size;
+
+	//! Where the out arguments of the call go.
+	void *out_args[IPC_BATCH_MAX_OUT_ARGS];
+};
+
+/*!
+ * Several calls that are sent to the service in one message and get their
+ * replies back in one message. Only calls that have no handles can be
+ * batched, the calls are added with the generated `ipc_batch_*` functions
+ * and sent with @ref ipc_batch_submit.
+ *
+ * The calls are run in order, a failing call stops the rest of the batch
+ * from being run and leaves their out arguments untouched. Calls in a batch
+ * can not depend on the out arguments of earlier calls in the same batch.
+ *
+ * The client compositor does not build batches itself, it only defers
+ * calls whose results it doesn't need, see @ref ipc_connection::deferred.
+ * Explicit batches are not used by anything in the tree besides the tests.
+ */
+struct ipc_batch
+{
+	uint32_t call_count;
+	struct ipc_batch_call calls[IPC_BATCH_MAX_CALLS];
+
+	/*!
+	 * The first calls that were deferred, a failure in one of them is only
+	 * logged and doesn't stop the calls after it.
+	 */
+	uint32_t deferred_count;
+
+	//! The message structs of the calls, one after the other.
+	uint8_t msgs[IPC_BATCH_MAX_MSG_SIZE];
+	uint32_t msg_size;
+
+	//! Total size of the replies of the calls.
+	uint32_t reply_size;
+};
+
 /*!
  * Connection.
  */
@@ -52,8 +100,19 @@ struct ipc_connection
 	struct ipc_shared_memory *ism;
 	xrt_shmem_handle_t ism_handle;
 
+	//! Id of this client in the service, indexes the per client state in @ref ism.
+	uint32_t client_id;
+
 	struct os_mutex mutex;
 
+	/*!
+	 * Calls whose results are not needed straight away, sent together with
+	 * the next call made on the connection, protected by @ref mutex. Their
+	 * failures are logged when the replies come back, they are not returned
+	 * from the call they were sent with.
+	 */
+	struct ipc_batch deferred;
+
 #ifdef XRT_OS_ANDROID
 	struct ipc_client_android *ica;
 #endif // XRT_OS_ANDROID
@@ -87,3 +146,52 @@ ipc_client_hmd_create(struct ipc_connection *ipc_c, struct xrt_tracking_origin *
 
 struct xrt_device *
 ipc_client_device_create(struct ipc_connection *ipc_c, struct xrt_tracking_origin *xtrack, uint32_t device_id);
+
+/*!
+ * Add a call to a batch, used by the generated `ipc_batch_*` functions.
+ * Returns false if the batch is full, the batch is then left unchanged.
+ *
+ * @public @memberof ipc_batch
+ */
+bool
+ipc_batch_add(struct ipc_batch *batch,
+              const void *msg,
+              uint32_t msg_size,
+              uint32_t reply_size,
+              void **out_args,
+              uint32_t out_arg_count);
+
+/*!
+ * Send all calls in the batch in one message and wait for their replies,
+ * the batch is then empty again. Returns the result of the first call that
+ * failed or @ref XRT_SUCCESS.
+ *
+ * Deferred calls on the connection are sent first.
+ *
+ * @public @memberof ipc_batch
+ */
+xrt_result_t
+ipc_batch_submit(struct ipc_connection *ipc_c, struct ipc_batch *batch);
+
+/*!
+ * Send the deferred calls of the connection, if any, the connection mutex
+ * must be held. Called by all generated `ipc_call_*` functions, which might
+ * have added their own call at the end of the deferred calls. Failing
+ * deferred calls are logged, only the result of such an added call or a
+ * failure to talk to the service is returned.
+ */
+xrt_result_t
+ipc_client_flush_deferred_locked(struct ipc_connection *ipc_c);
+
+/*!
+ * Look up a pose of a device in the poses the service published to the
+ * shared memory, see @ref ipc_shared_pose_history. Returns false if the pose
+ * has to be asked for with a call instead.
+ */
+bool
+ipc_client_get_shared_pose(struct ipc_connection *ipc_c,
+                           struct xrt_device *xdev,
+                           uint32_t device_id,
+                           enum xrt_input_name name,
+                           uint64_t at_timestamp_ns,
+                           struct xrt_space_relation *out_relation);
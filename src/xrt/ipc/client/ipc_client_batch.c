@@ -0,0 +1,152 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Sending several calls in one message.
+ * @ingroup ipc_client
+ */
+
+#include "client/ipc_client.h"
+#include "ipc_client_generated.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+static void
+reset(struct ipc_batch *batch)
+{
+	batch->call_count = 0;
+	batch->deferred_count = 0;
+	batch->msg_size = 0;
+	batch->reply_size = 0;
+}
+
+static xrt_result_t
+send_and_unpack(struct ipc_connection *ipc_c, struct ipc_batch *batch)
+{
+	IPC_TRACE(ipc_c, "Sending batch of %u calls", batch->call_count);
+
+	struct ipc_batch_msg msg;
+	msg.cmd = IPC_BATCH;
+	msg.call_count = batch->call_count;
+	msg.deferred_count = batch->deferred_count;
+	msg.size = batch->msg_size;
+	msg.reply_size = batch->reply_size;
+	memcpy(msg.data, batch->msgs, batch->msg_size);
+
+	size_t msg_size = offsetof(struct ipc_batch_msg, data) + batch->msg_size;
+	xrt_result_t ret = ipc_send(&ipc_c->imc, &msg, msg_size);
+	if (ret != XRT_SUCCESS) {
+		return ret;
+	}
+
+	struct ipc_batch_reply reply;
+	size_t reply_size = offsetof(struct ipc_batch_reply, data) + batch->reply_size;
+	ret = ipc_receive(&ipc_c->imc, &reply, reply_size);
+	if (ret != XRT_SUCCESS) {
+		return ret;
+	}
+
+	if (reply.call_count > batch->call_count) {
+		IPC_ERROR(ipc_c, "Batch reply has %u calls, sent %u!", reply.call_count, batch->call_count);
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	// Only the calls that were run get their out arguments written.
+	uint32_t offset = 0;
+	for (uint32_t i = 0; i < reply.call_count; i++) {
+		struct ipc_batch_call *call = &batch->calls[i];
+		xrt_result_t result = ipc_batch_unpack_reply(call->cmd, reply.data + offset, call->out_args);
+		offset += call->reply_size;
+
+		// Nobody is waiting on it, so this is the only place it can be reported.
+		if (result != XRT_SUCCESS && i < batch->deferred_count) {
+			IPC_ERROR(ipc_c, "Deferred call %s failed: %d", ipc_cmd_to_str(call->cmd), result);
+		} else if (result != XRT_SUCCESS) {
+			return result;
+		}
+	}
+
+	return reply.result;
+}
+
+static xrt_result_t
+submit_locked(struct ipc_connection *ipc_c, struct ipc_batch *batch)
+{
+	if (batch->call_count == 0) {
+		return XRT_SUCCESS;
+	}
+
+	xrt_result_t ret = send_and_unpack(ipc_c, batch);
+	reset(batch);
+
+	return ret;
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+bool
+ipc_batch_add(struct ipc_batch *batch,
+              const void *msg,
+              uint32_t msg_size,
+              uint32_t reply_size,
+              void **out_args,
+              uint32_t out_arg_count)
+{
+	assert(out_arg_count <= IPC_BATCH_MAX_OUT_ARGS);
+
+	if (batch->call_count >= IPC_BATCH_MAX_CALLS ||                //
+	    batch->msg_size + msg_size > IPC_BATCH_MAX_MSG_SIZE ||       //
+	    batch->reply_size + reply_size > IPC_BATCH_MAX_REPLY_SIZE) { //
+		return false;
+	}
+
+	struct ipc_batch_call *call = &batch->calls[batch->call_count++];
+	call->cmd = *(const uint32_t *)msg;
+	call->reply_size = reply_size;
+	for (uint32_t i = 0; i < out_arg_count; i++) {
+		call->out_args[i] = out_args[i];
+	}
+
+	memcpy(batch->msgs + batch->msg_size, msg, msg_size);
+	batch->msg_size += msg_size;
+	batch->reply_size += reply_size;
+
+	return true;
+}
+
+xrt_result_t
+ipc_batch_submit(struct ipc_connection *ipc_c, struct ipc_batch *batch)
+{
+	os_mutex_lock(&ipc_c->mutex);
+
+	xrt_result_t ret = ipc_client_flush_deferred_locked(ipc_c);
+	if (ret == XRT_SUCCESS) {
+		ret = submit_locked(ipc_c, batch);
+	} else {
+		reset(batch);
+	}
+
+	os_mutex_unlock(&ipc_c->mutex);
+
+	return ret;
+}
+
+xrt_result_t
+ipc_client_flush_deferred_locked(struct ipc_connection *ipc_c)
+{
+	return submit_locked(ipc_c, &ipc_c->deferred);
+}
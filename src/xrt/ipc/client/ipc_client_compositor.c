@@ -215,7 +215,8 @@ ipc_compositor_swapchain_release_image(struct xrt_swapchain *xsc, uint32_t index
 	struct ipc_client_swapchain *ics = ipc_client_swapchain(xsc);
 	struct ipc_client_compositor *icc = ics->icc;
 
-	IPC_CALL_CHK(ipc_call_swapchain_release_image(icc->ipc_c, ics->id, index));
+	// Nothing waits on this, so send it along with the next call.
+	IPC_CALL_CHK(ipc_defer_swapchain_release_image(icc->ipc_c, ics->id, index));
 
 	return res;
 }
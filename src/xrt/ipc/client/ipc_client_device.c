@@ -25,6 +25,7 @@
 #include "util/u_debug.h"
 #include "util/u_device.h"
 
+#include "shared/ipc_pose_history.h"
 #include "client/ipc_client.h"
 #include "ipc_client_generated.h"
 
@@ -35,6 +36,8 @@
  *
  */
 
+DEBUG_GET_ONCE_BOOL_OPTION(shared_poses, "IPC_SHARED_POSES", true)
+
 /*!
  * An IPC client proxy for an @ref xrt_device.
  * @implements xrt_device
@@ -46,6 +49,12 @@ struct ipc_client_device
 	struct ipc_connection *ipc_c;
 
 	uint32_t device_id;
+
+	//! Poses looked up in shared memory.
+	uint64_t shared_pose_hits;
+
+	//! Poses that had to be asked for.
+	uint64_t shared_pose_misses;
 };
 
 
@@ -96,6 +105,12 @@ ipc_client_device_get_tracked_pose(struct xrt_device *xdev,
 {
 	struct ipc_client_device *icd = ipc_client_device(xdev);
 
+	if (ipc_client_get_shared_pose(icd->ipc_c, xdev, icd->device_id, name, at_timestamp_ns, out_relation)) {
+		icd->shared_pose_hits++;
+		return;
+	}
+	icd->shared_pose_misses++;
+
 	xrt_result_t r =
 	    ipc_call_device_get_tracked_pose(icd->ipc_c, icd->device_id, name, at_timestamp_ns, out_relation);
 	if (r != XRT_SUCCESS) {
@@ -143,6 +158,49 @@ ipc_client_device_set_output(struct xrt_device *xdev, enum xrt_output_name name,
 	}
 }
 
+bool
+ipc_client_get_shared_pose(struct ipc_connection *ipc_c,
+                           struct xrt_device *xdev,
+                           uint32_t device_id,
+                           enum xrt_input_name name,
+                           uint64_t at_timestamp_ns,
+                           struct xrt_space_relation *out_relation)
+{
+	struct ipc_shared_memory *ism = ipc_c->ism;
+
+	if (!debug_get_bool_option_shared_poses()) {
+		return false;
+	}
+
+	// The service gates everything but the head pose on IO being active.
+	if (name != XRT_INPUT_GENERIC_HEAD_POSE) {
+		if (ism->poses.io_gated[device_id]) {
+			return false;
+		}
+		if (ipc_c->client_id >= IPC_MAX_CLIENTS || ism->poses.client_io_gated[ipc_c->client_id]) {
+			return false;
+		}
+
+		struct xrt_input *input = NULL;
+		for (uint32_t i = 0; i < xdev->input_count; i++) {
+			if (xdev->inputs[i].name == name) {
+				input = &xdev->inputs[i];
+				break;
+			}
+		}
+		if (input == NULL || !input->active) {
+			return false;
+		}
+	}
+
+	struct ipc_shared_pose_history *iph = ipc_pose_history_find(ism, device_id, name);
+	if (iph == NULL) {
+		return false;
+	}
+
+	return ipc_pose_history_get(ism, iph, at_timestamp_ns, os_monotonic_get_ns(), out_relation);
+}
+
 /*!
  * @public @memberof ipc_client_device
  */
@@ -210,6 +268,8 @@ ipc_client_device_create(struct ipc_connection *ipc_c, struct xrt_tracking_origi
 	// Setup variable tracker.
 	u_var_add_root(icd, icd->base.str, true);
 	u_var_add_ro_u32(icd, &icd->device_id, "device_id");
+	u_var_add_ro_u64(icd, &icd->shared_pose_hits, "Poses from shared memory");
+	u_var_add_ro_u64(icd, &icd->shared_pose_misses, "Poses asked for");
 
 	icd->base.orientation_tracking_supported = isdev->orientation_tracking_supported;
 	icd->base.position_tracking_supported = isdev->position_tracking_supported;
@@ -22,6 +22,7 @@
 
 #include "util/u_var.h"
 #include "util/u_misc.h"
+#include "util/u_time.h"
 #include "util/u_debug.h"
 #include "util/u_device.h"
 #include "util/u_distortion_mesh.h"
@@ -36,6 +37,9 @@
  *
  */
 
+//! How long the fovs and eye poses of a view poses call get reused.
+#define VIEW_CACHE_MAX_AGE_NS (100 * U_TIME_1MS_IN_NS)
+
 /*!
  * An IPC client proxy for an HMD @ref xrt_device.
  * @implements xrt_device
@@ -47,6 +51,27 @@ struct ipc_client_hmd
 	struct ipc_connection *ipc_c;
 
 	uint32_t device_id;
+
+	/*!
+	 * The fovs and eye poses only change when IPD or similar do, so they
+	 * are reused for a little while together with head poses from shared
+	 * memory instead of calling the service for every view poses call.
+	 */
+	struct
+	{
+		struct os_mutex mutex;
+		bool valid;
+		uint64_t fetched_ns;
+		struct xrt_vec3 default_eye_relation;
+		struct xrt_fov fovs[2];
+		struct xrt_pose poses[2];
+	} view_cache;
+
+	//! Poses looked up in shared memory.
+	uint64_t shared_pose_hits;
+
+	//! Poses that had to be asked for.
+	uint64_t shared_pose_misses;
 };
 
 
@@ -70,6 +95,8 @@ ipc_client_hmd_destroy(struct xrt_device *xdev)
 	// Remove the variable tracking.
 	u_var_remove_root(ich);
 
+	os_mutex_destroy(&ich->view_cache.mutex);
+
 	// We do not own these, so don't free them.
 	ich->base.inputs = NULL;
 	ich->base.outputs = NULL;
@@ -97,6 +124,12 @@ ipc_client_hmd_get_tracked_pose(struct xrt_device *xdev,
 {
 	struct ipc_client_hmd *ich = ipc_client_hmd(xdev);
 
+	if (ipc_client_get_shared_pose(ich->ipc_c, xdev, ich->device_id, name, at_timestamp_ns, out_relation)) {
+		ich->shared_pose_hits++;
+		return;
+	}
+	ich->shared_pose_misses++;
+
 	xrt_result_t r =
 	    ipc_call_device_get_tracked_pose(ich->ipc_c, ich->device_id, name, at_timestamp_ns, out_relation);
 	if (r != XRT_SUCCESS) {
@@ -104,6 +137,58 @@ ipc_client_hmd_get_tracked_pose(struct xrt_device *xdev,
 	}
 }
 
+static bool
+get_cached_view_poses(struct ipc_client_hmd *ich,
+                      const struct xrt_vec3 *default_eye_relation,
+                      uint64_t at_timestamp_ns,
+                      struct xrt_space_relation *out_head_relation,
+                      struct xrt_fov *out_fovs,
+                      struct xrt_pose *out_poses)
+{
+	uint64_t now_ns = os_monotonic_get_ns();
+	bool hit = false;
+
+	os_mutex_lock(&ich->view_cache.mutex);
+
+	struct xrt_vec3 cached = ich->view_cache.default_eye_relation;
+	bool same_eyes = cached.x == default_eye_relation->x && cached.y == default_eye_relation->y &&
+	                 cached.z == default_eye_relation->z;
+
+	if (ich->view_cache.valid && same_eyes && now_ns - ich->view_cache.fetched_ns < VIEW_CACHE_MAX_AGE_NS) {
+		hit = ipc_client_get_shared_pose(ich->ipc_c, &ich->base, ich->device_id, XRT_INPUT_GENERIC_HEAD_POSE,
+		                                 at_timestamp_ns, out_head_relation);
+	}
+
+	if (hit) {
+		for (int i = 0; i < 2; i++) {
+			out_fovs[i] = ich->view_cache.fovs[i];
+			out_poses[i] = ich->view_cache.poses[i];
+		}
+	}
+
+	os_mutex_unlock(&ich->view_cache.mutex);
+
+	return hit;
+}
+
+static void
+update_cached_view_poses(struct ipc_client_hmd *ich,
+                         const struct xrt_vec3 *default_eye_relation,
+                         const struct ipc_info_get_view_poses_2 *info)
+{
+	os_mutex_lock(&ich->view_cache.mutex);
+
+	ich->view_cache.valid = true;
+	ich->view_cache.fetched_ns = os_monotonic_get_ns();
+	ich->view_cache.default_eye_relation = *default_eye_relation;
+	for (int i = 0; i < 2; i++) {
+		ich->view_cache.fovs[i] = info->fovs[i];
+		ich->view_cache.poses[i] = info->poses[i];
+	}
+
+	os_mutex_unlock(&ich->view_cache.mutex);
+}
+
 static void
 ipc_client_hmd_get_view_poses(struct xrt_device *xdev,
                               const struct xrt_vec3 *default_eye_relation,
@@ -118,6 +203,13 @@ ipc_client_hmd_get_view_poses(struct xrt_device *xdev,
 	struct ipc_info_get_view_poses_2 info = {0};
 
 	if (view_count == 2) {
+		if (get_cached_view_poses(ich, default_eye_relation, at_timestamp_ns, out_head_relation, out_fovs,
+		                          out_poses)) {
+			ich->shared_pose_hits++;
+			return;
+		}
+		ich->shared_pose_misses++;
+
 		xrt_result_t r = ipc_call_device_get_view_poses_2( //
 		    ich->ipc_c,                                    //
 		    ich->device_id,                                //
@@ -126,6 +218,8 @@ ipc_client_hmd_get_view_poses(struct xrt_device *xdev,
 		    &info);                                        //
 		if (r != XRT_SUCCESS) {
 			IPC_ERROR(ich->ipc_c, "Error calling view poses!");
+		} else {
+			update_cached_view_poses(ich, default_eye_relation, &info);
 		}
 
 		*out_head_relation = info.head_relation;
@@ -155,6 +249,7 @@ ipc_client_hmd_create(struct ipc_connection *ipc_c, struct xrt_tracking_origin *
 	struct ipc_client_hmd *ich = U_DEVICE_ALLOCATE(struct ipc_client_hmd, flags, 0, 0);
 	ich->ipc_c = ipc_c;
 	ich->device_id = device_id;
+	os_mutex_init(&ich->view_cache.mutex);
 	ich->base.update_inputs = ipc_client_hmd_update_inputs;
 	ich->base.get_tracked_pose = ipc_client_hmd_get_tracked_pose;
 	ich->base.get_view_poses = ipc_client_hmd_get_view_poses;
@@ -207,6 +302,8 @@ ipc_client_hmd_create(struct ipc_connection *ipc_c, struct xrt_tracking_origin *
 	// Setup variable tracker.
 	u_var_add_root(ich, ich->base.str, true);
 	u_var_add_ro_u32(ich, &ich->device_id, "device_id");
+	u_var_add_ro_u64(ich, &ich->shared_pose_hits, "Poses from shared memory");
+	u_var_add_ro_u64(ich, &ich->shared_pose_misses, "Poses asked for");
 
 	ich->base.orientation_tracking_supported = isdev->orientation_tracking_supported;
 	ich->base.position_tracking_supported = isdev->position_tracking_supported;
@@ -329,6 +329,13 @@ ipc_instance_create(struct xrt_instance_info *i_info, struct xrt_instance **out_
 		return xret;
 	}
 
+	xret = ipc_call_instance_get_client_id(&ii->ipc_c, &ii->ipc_c.client_id);
+	if (xret != XRT_SUCCESS) {
+		IPC_ERROR((&ii->ipc_c), "Failed to retrieve client id!");
+		free(ii);
+		return xret;
+	}
+
 	struct ipc_app_state desc = {0};
 	desc.info = *i_info;
 	desc.pid = getpid(); // Extra info.
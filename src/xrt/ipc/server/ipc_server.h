@@ -52,6 +52,9 @@ extern "C" {
 struct xrt_instance;
 struct xrt_compositor;
 struct xrt_compositor_native;
+struct u_worker_group;
+struct u_worker_thread_pool;
+struct ipc_client_latency;
 
 
 /*!
@@ -124,6 +127,25 @@ struct ipc_thread
 };
 
 
+/*!
+ * A client served by the event loop, see @ref ipc_server_event_loop_init.
+ *
+ * @ingroup ipc_server
+ */
+struct ipc_event_loop_client
+{
+	volatile struct ipc_client_state *ics;
+
+	//! Latency stats, if enabled when the client connected.
+	struct ipc_client_latency *latency;
+
+	//! Events from the last wakeup, only touched by the worker that got them.
+	uint32_t events;
+
+	//! Is the socket registered with the event loop.
+	bool registered;
+};
+
 /*!
  *
  */
@@ -302,6 +324,9 @@ struct ipc_server
 	// Should we exit when a client disconnects.
 	bool exit_on_disconnect;
 
+	//! Record how long each call takes per client, shown in the debug UI.
+	bool latency_stats;
+
 	enum u_logging_level log_level;
 
 	struct ipc_thread threads[IPC_MAX_CLIENTS];
@@ -315,6 +340,52 @@ struct ipc_server
 
 		struct os_mutex lock;
 	} global_state;
+
+	/*!
+	 * Publishes device poses into the shared memory, both the ones clients
+	 * ask for and ones sampled by a thread ahead of time.
+	 */
+	struct
+	{
+		struct os_thread_helper oth;
+
+		//! Only one writer of the histories at a time.
+		struct os_mutex lock;
+
+		//! How often the thread samples, zero if there is no thread.
+		uint64_t interval_ns;
+
+		//! How far ahead of now clients last asked for each history.
+		int64_t lead_ns[XRT_SYSTEM_MAX_DEVICES][IPC_SHARED_MAX_POSE_HISTORIES];
+
+		//! When clients last asked, the thread stops sampling unused histories.
+		uint64_t last_request_ns[XRT_SYSTEM_MAX_DEVICES][IPC_SHARED_MAX_POSE_HISTORIES];
+	} pose_publisher;
+
+	/*!
+	 * Serves all clients from one thread waiting on their sockets and a
+	 * small pool of workers handling the calls, instead of a thread per
+	 * client. Each client is armed for one message at a time, so its calls
+	 * are still handled in order.
+	 */
+	struct
+	{
+		struct os_thread_helper oth;
+
+		//! Number of workers, zero if every client gets its own thread.
+		uint32_t worker_count;
+
+		//! All client sockets, armed with EPOLLONESHOT.
+		int epoll_fd;
+
+		//! Written to stop the thread.
+		int stop_fd;
+
+		struct u_worker_thread_pool *pool;
+		struct u_worker_group *group;
+
+		struct ipc_event_loop_client clients[IPC_MAX_CLIENTS];
+	} event_loop;
 };
 
 
@@ -375,6 +446,28 @@ ipc_server_deactivate_session(volatile struct ipc_client_state *ics);
 void
 ipc_server_update_state(struct ipc_server *s);
 
+/*!
+ * Publish a relation that was gotten from a device for a client, so other
+ * calls close to @p at_timestamp_ns can be answered from shared memory.
+ *
+ * @ingroup ipc_server
+ */
+void
+ipc_server_publish_pose(struct ipc_server *s,
+                        uint32_t device_id,
+                        enum xrt_input_name name,
+                        uint64_t at_timestamp_ns,
+                        const struct xrt_space_relation *relation);
+
+/*!
+ * Called when the IO of a client or device is toggled, updates which poses
+ * clients may look up in shared memory. Takes the global state lock.
+ *
+ * @ingroup ipc_server
+ */
+void
+ipc_server_update_pose_gating(struct ipc_server *s);
+
 /*!
  * Thread function for the client side dispatching.
  *
@@ -390,6 +483,72 @@ ipc_server_client_thread(void *_ics);
 void
 ipc_server_client_destroy_compositor(volatile struct ipc_client_state *ics);
 
+/*!
+ * Creates per call latency stats for a client, shown in the debug UI.
+ *
+ * @ingroup ipc_server
+ */
+struct ipc_client_latency *
+ipc_server_client_latency_create(void);
+
+/*!
+ * Destroys the latency stats, does NULL checking.
+ *
+ * @ingroup ipc_server
+ */
+void
+ipc_server_client_latency_destroy(struct ipc_client_latency **cl_ptr);
+
+/*!
+ * Receives one message waiting on the socket of the client and dispatches it,
+ * @p latency may be NULL.
+ *
+ * @return false if the client should be disconnected.
+ * @ingroup ipc_server
+ */
+bool
+ipc_server_client_handle_message(volatile struct ipc_client_state *ics, struct ipc_client_latency *latency);
+
+/*!
+ * Closes the socket of a client and releases everything it held, leaves its
+ * slot in the @ref IPC_THREAD_STOPPING state.
+ *
+ * @ingroup ipc_server
+ */
+void
+ipc_server_client_disconnected(volatile struct ipc_client_state *ics);
+
+/*!
+ * Starts the event loop thread and @p worker_count workers, only called when
+ * the server serves clients from the event loop. Clients waiting on swapchain
+ * images hold a worker while waiting, so @p worker_count needs to be larger
+ * than the number of clients that do so at the same time.
+ *
+ * @return <0 on error.
+ * @ingroup ipc_server
+ */
+int
+ipc_server_event_loop_init(struct ipc_server *s, uint32_t worker_count);
+
+/*!
+ * Registers a client whose slot has been claimed with the event loop, must be
+ * called with the global state lock held.
+ *
+ * @return <0 on error, the caller then closes the socket.
+ * @ingroup ipc_server
+ */
+int
+ipc_server_event_loop_add_client(struct ipc_server *s, volatile struct ipc_client_state *ics);
+
+/*!
+ * Stops the event loop, waits for the workers and disconnects the clients that
+ * are still connected, safe to call if it was never started.
+ *
+ * @ingroup ipc_server
+ */
+void
+ipc_server_event_loop_fini(struct ipc_server *s);
+
 /*!
  * @defgroup ipc_server_internals Server Internals
  * @brief These are only called by the platform-specific mainloop polling code.
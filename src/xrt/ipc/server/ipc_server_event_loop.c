@@ -0,0 +1,291 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Serves all clients from one event loop and a small worker pool.
+ * @ingroup ipc_server
+ *
+ * The thread waits on the sockets of all clients, a client with a message
+ * waiting is handed to a worker that receives and dispatches it. The sockets
+ * are registered with EPOLLONESHOT and only re-armed once the worker is done,
+ * so at most one message per client is in flight and the calls of a client
+ * are handled in the order they were sent.
+ *
+ * A call is handled on the worker from start to end, so a client blocked in
+ * @ref ipc_handle_swapchain_wait_image holds its worker until the image is
+ * ready or the wait times out. With as many clients blocked as there are
+ * workers no other client is served, so there should be more workers than
+ * clients that wait on images at the same time.
+ */
+
+#include "util/u_misc.h"
+#include "util/u_worker.h"
+
+#include "server/ipc_server.h"
+
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+
+/*
+ *
+ * Defines.
+ *
+ */
+
+//! Put in the epoll data of the stop fd, never a client index.
+#define STOP_ID UINT32_MAX
+
+#define MAX_EVENTS 16
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+static uint32_t
+client_index(struct ipc_server *s, struct ipc_event_loop_client *elc)
+{
+	return (uint32_t)(elc - s->event_loop.clients);
+}
+
+static void
+disconnect(struct ipc_server *s, struct ipc_event_loop_client *elc)
+{
+	volatile struct ipc_client_state *ics = elc->ics;
+
+	IPC_INFO(s, "Client disconnected.");
+
+	// Before the socket is closed and the fd number can be reused.
+	if (elc->registered) {
+		epoll_ctl(s->event_loop.epoll_fd, EPOLL_CTL_DEL, ics->imc.socket_fd, NULL);
+		elc->registered = false;
+	}
+
+	ipc_server_client_latency_destroy(&elc->latency);
+
+	ipc_server_client_disconnected(ics);
+
+	// All done, the slot can be given to a new client.
+	os_mutex_lock(&s->global_state.lock);
+	s->threads[client_index(s, elc)].state = IPC_THREAD_READY;
+	os_mutex_unlock(&s->global_state.lock);
+}
+
+static void
+client_task(void *ptr)
+{
+	struct ipc_event_loop_client *elc = (struct ipc_event_loop_client *)ptr;
+	volatile struct ipc_client_state *ics = elc->ics;
+	struct ipc_server *s = ics->server;
+
+	// Detect clients disconnecting gracefully.
+	if ((elc->events & (EPOLLHUP | EPOLLERR)) != 0 || !s->running) {
+		disconnect(s, elc);
+		return;
+	}
+
+	if (!ipc_server_client_handle_message(ics, elc->latency)) {
+		disconnect(s, elc);
+		return;
+	}
+
+	// Done with this message, let the loop hand us the next one.
+	struct epoll_event ev = {0};
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.u32 = client_index(s, elc);
+
+	int ret = epoll_ctl(s->event_loop.epoll_fd, EPOLL_CTL_MOD, ics->imc.socket_fd, &ev);
+	if (ret < 0) {
+		IPC_ERROR(s, "Error epoll_ctl(client) re-arm failed '%i', disconnecting client.", errno);
+		disconnect(s, elc);
+	}
+}
+
+static void *
+event_loop_thread(void *ptr)
+{
+	struct ipc_server *s = (struct ipc_server *)ptr;
+	struct os_thread_helper *oth = &s->event_loop.oth;
+
+	os_thread_helper_name(oth, "IPC: Event loop");
+
+	struct epoll_event events[MAX_EVENTS];
+
+	while (os_thread_helper_is_running(oth)) {
+		int ret = epoll_wait(s->event_loop.epoll_fd, events, MAX_EVENTS, -1);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret < 0) {
+			IPC_ERROR(s, "Failed epoll_wait '%i', stopping server.", errno);
+			ipc_server_handle_failure(s);
+			break;
+		}
+
+		for (int i = 0; i < ret; i++) {
+			uint32_t index = events[i].data.u32;
+			if (index == STOP_ID) {
+				return NULL;
+			}
+
+			// Disarmed until the worker is done with it.
+			struct ipc_event_loop_client *elc = &s->event_loop.clients[index];
+			elc->events = events[i].events;
+			u_worker_group_push(s->event_loop.group, client_task, elc);
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+int
+ipc_server_event_loop_init(struct ipc_server *s, uint32_t worker_count)
+{
+	assert(worker_count > 0);
+
+	s->event_loop.epoll_fd = -1;
+	s->event_loop.stop_fd = -1;
+
+	int ret = epoll_create1(EPOLL_CLOEXEC);
+	if (ret < 0) {
+		IPC_ERROR(s, "Failed to create event loop epoll fd '%i'.", errno);
+		return ret;
+	}
+	s->event_loop.epoll_fd = ret;
+
+	ret = eventfd(0, EFD_CLOEXEC);
+	if (ret < 0) {
+		IPC_ERROR(s, "Failed to create event loop stop fd '%i'.", errno);
+		return ret;
+	}
+	s->event_loop.stop_fd = ret;
+
+	struct epoll_event ev = {0};
+	ev.events = EPOLLIN;
+	ev.data.u32 = STOP_ID;
+	ret = epoll_ctl(s->event_loop.epoll_fd, EPOLL_CTL_ADD, s->event_loop.stop_fd, &ev);
+	if (ret < 0) {
+		IPC_ERROR(s, "Error epoll_ctl(stop_fd) failed '%i'.", errno);
+		return ret;
+	}
+
+	// The extra thread only takes over while the group is being waited on.
+	s->event_loop.pool = u_worker_thread_pool_create(worker_count, worker_count + 1);
+	if (s->event_loop.pool == NULL) {
+		IPC_ERROR(s, "Failed to create event loop worker pool.");
+		return -1;
+	}
+
+	s->event_loop.group = u_worker_group_create(s->event_loop.pool);
+	if (s->event_loop.group == NULL) {
+		IPC_ERROR(s, "Failed to create event loop worker group.");
+		return -1;
+	}
+
+	ret = os_thread_helper_init(&s->event_loop.oth);
+	if (ret < 0) {
+		return ret;
+	}
+
+	// Only non-zero once everything is set up.
+	s->event_loop.worker_count = worker_count;
+
+	ret = os_thread_helper_start(&s->event_loop.oth, event_loop_thread, s);
+	if (ret != 0) {
+		IPC_ERROR(s, "Failed to start event loop thread '%i'.", ret);
+		return -1;
+	}
+
+	IPC_INFO(s, "Serving clients from an event loop with %u workers.", worker_count);
+
+	return 0;
+}
+
+int
+ipc_server_event_loop_add_client(struct ipc_server *s, volatile struct ipc_client_state *ics)
+{
+	uint32_t index = (uint32_t)ics->server_thread_index;
+	assert(index < IPC_MAX_CLIENTS);
+
+	struct ipc_event_loop_client *elc = &s->event_loop.clients[index];
+	assert(!elc->registered);
+
+	elc->ics = ics;
+	elc->events = 0;
+	elc->latency = NULL;
+	if (s->latency_stats) {
+		elc->latency = ipc_server_client_latency_create();
+	}
+
+	struct epoll_event ev = {0};
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.u32 = index;
+
+	int ret = epoll_ctl(s->event_loop.epoll_fd, EPOLL_CTL_ADD, ics->imc.socket_fd, &ev);
+	if (ret < 0) {
+		IPC_ERROR(s, "Error epoll_ctl(client) failed '%i'.", errno);
+		ipc_server_client_latency_destroy(&elc->latency);
+		return ret;
+	}
+
+	elc->registered = true;
+
+	IPC_INFO(s, "Client connected");
+
+	return 0;
+}
+
+void
+ipc_server_event_loop_fini(struct ipc_server *s)
+{
+	if (s->event_loop.oth.initialized) {
+		// Wake the thread up, it exits when it sees the stop fd.
+		uint64_t one = 1;
+		ssize_t written = write(s->event_loop.stop_fd, &one, sizeof(one));
+		(void)written;
+
+		os_thread_helper_destroy(&s->event_loop.oth);
+	}
+
+	if (s->event_loop.group != NULL) {
+		// Calls that are being handled finish and re-arm, nothing picks them up.
+		u_worker_group_wait_all(s->event_loop.group);
+
+		for (uint32_t i = 0; i < IPC_MAX_CLIENTS; i++) {
+			struct ipc_event_loop_client *elc = &s->event_loop.clients[i];
+			if (elc->registered) {
+				disconnect(s, elc);
+			}
+		}
+	}
+
+	u_worker_group_reference(&s->event_loop.group, NULL);
+	u_worker_thread_pool_reference(&s->event_loop.pool, NULL);
+
+	// The server is zero initialized, and zero is stdin and never ours.
+	if (s->event_loop.stop_fd > 0) {
+		close(s->event_loop.stop_fd);
+		s->event_loop.stop_fd = -1;
+	}
+
+	if (s->event_loop.epoll_fd > 0) {
+		close(s->event_loop.epoll_fd);
+		s->event_loop.epoll_fd = -1;
+	}
+
+	s->event_loop.worker_count = 0;
+}
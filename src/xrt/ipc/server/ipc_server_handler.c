@@ -69,6 +69,16 @@ set_swapchain_info(volatile struct ipc_client_state *ics,
  *
  */
 
+xrt_result_t
+ipc_handle_instance_get_client_id(volatile struct ipc_client_state *ics, uint32_t *out_id)
+{
+	IPC_TRACE_MARKER();
+
+	*out_id = (uint32_t)ics->server_thread_index;
+
+	return XRT_SUCCESS;
+}
+
 xrt_result_t
 ipc_handle_instance_get_shm_fd(volatile struct ipc_client_state *ics,
                                uint32_t max_handle_capacity,
@@ -713,6 +723,8 @@ ipc_handle_system_toggle_io_client(volatile struct ipc_client_state *_ics, uint3
 
 	ics->io_active = !ics->io_active;
 
+	ipc_server_update_pose_gating(ics->server);
+
 	return XRT_SUCCESS;
 }
 
@@ -727,6 +739,8 @@ ipc_handle_system_toggle_io_device(volatile struct ipc_client_state *ics, uint32
 
 	idev->io_active = !idev->io_active;
 
+	ipc_server_update_pose_gating(ics->server);
+
 	return XRT_SUCCESS;
 }
 
@@ -1086,6 +1100,9 @@ ipc_handle_device_get_tracked_pose(volatile struct ipc_client_state *ics,
 	// Get the pose.
 	xrt_device_get_tracked_pose(xdev, name, at_timestamp, out_relation);
 
+	// Let other calls close to this one be answered from shared memory.
+	ipc_server_publish_pose(ics->server, device_id, name, at_timestamp, out_relation);
+
 	return XRT_SUCCESS;
 }
 
@@ -1128,6 +1145,10 @@ ipc_handle_device_get_view_poses_2(volatile struct ipc_client_state *ics,
 	    out_info->fovs,           //
 	    out_info->poses);         //
 
+	// The head relation is the pose clients will look up in shared memory.
+	ipc_server_publish_pose(ics->server, device_id, XRT_INPUT_GENERIC_HEAD_POSE, at_timestamp_ns,
+	                        &out_info->head_relation);
+
 	return XRT_SUCCESS;
 }
 
@@ -10,7 +10,12 @@
 
 #include "xrt/xrt_gfx_native.h"
 
+#include "os/os_time.h"
+
 #include "util/u_misc.h"
+#include "util/u_time.h"
+#include "util/u_var.h"
+#include "util/u_latency_histogram.h"
 
 #include "server/ipc_server.h"
 #include "ipc_server_generated.h"
@@ -25,12 +30,87 @@
 #include <sys/socket.h>
 
 
+/*
+ *
+ * Structs and defines.
+ *
+ */
+
+//! How often the latency text in the debug UI is updated.
+#define LATENCY_UI_INTERVAL_NS (U_TIME_1S_IN_NS)
+
+//! Calls taking longer than this are counted as stalls.
+#define LATENCY_STALL_NS (2 * U_TIME_1MS_IN_NS)
+
+#define COMMAND_COUNT (IPC_BATCH + 1)
+
+/*!
+ * Time taken to handle each call from a client, including sending the reply.
+ */
+struct ipc_client_latency
+{
+	uint64_t last_ui_update_ns;
+
+	//! Calls that took longer than @ref LATENCY_STALL_NS.
+	uint64_t stalls;
+
+	//! All calls together.
+	struct u_latency_histogram all;
+	float all_values[U_LATENCY_HISTOGRAM_BUCKET_COUNT];
+	struct u_var_histogram_f32 all_ui;
+	char all_text[128];
+
+	struct u_latency_histogram calls[COMMAND_COUNT];
+	char texts[COMMAND_COUNT][128];
+};
+
+
 /*
  *
  * Helper functions.
  *
  */
 
+static void
+latency_update_ui(struct ipc_client_latency *cl)
+{
+	u_latency_histogram_snprint(&cl->all, cl->all_text, sizeof(cl->all_text));
+
+	for (uint32_t i = 0; i < U_LATENCY_HISTOGRAM_BUCKET_COUNT; i++) {
+		cl->all_values[i] = (float)cl->all.buckets[i];
+	}
+
+	for (uint32_t i = 0; i < COMMAND_COUNT; i++) {
+		if (cl->calls[i].count > 0) {
+			u_latency_histogram_snprint(&cl->calls[i], cl->texts[i], sizeof(cl->texts[i]));
+		}
+	}
+}
+
+static void
+latency_record(volatile struct ipc_client_state *ics,
+               struct ipc_client_latency *cl,
+               ipc_command_t cmd,
+               uint64_t start_ns,
+               uint64_t end_ns)
+{
+	uint64_t duration_ns = end_ns - start_ns;
+	uint32_t index = (uint32_t)cmd < COMMAND_COUNT ? (uint32_t)cmd : IPC_ERR;
+
+	u_latency_histogram_add(&cl->calls[index], duration_ns);
+	u_latency_histogram_add(&cl->all, duration_ns);
+
+	if (duration_ns > LATENCY_STALL_NS) {
+		cl->stalls++;
+		IPC_DEBUG(ics->server, "%s took %.2fms", ipc_cmd_to_str(cmd), time_ns_to_ms_f((int64_t)duration_ns));
+	}
+
+	if (end_ns - cl->last_ui_update_ns > LATENCY_UI_INTERVAL_NS) {
+		cl->last_ui_update_ns = end_ns;
+		latency_update_ui(cl);
+	}
+}
+
 static int
 setup_epoll(volatile struct ipc_client_state *ics)
 {
@@ -75,7 +155,10 @@ client_loop(volatile struct ipc_client_state *ics)
 		return;
 	}
 
-	uint8_t buf[IPC_BUF_SIZE] = {0};
+	struct ipc_client_latency *latency = NULL;
+	if (ics->server->latency_stats) {
+		latency = ipc_server_client_latency_create();
+	}
 
 	while (ics->server->running) {
 		const int half_a_second_ms = 500;
@@ -99,19 +182,7 @@ client_loop(volatile struct ipc_client_state *ics)
 			break;
 		}
 
-		// Finally get the data that is waiting for us.
-		//! @todo replace this call
-		ssize_t len = recv(ics->imc.socket_fd, &buf, IPC_BUF_SIZE, 0);
-		if (len < 4) {
-			IPC_ERROR(ics->server, "Invalid packet received, disconnecting client.");
-			break;
-		}
-
-		// Check the first 4 bytes of the message and dispatch.
-		ipc_command_t *ipc_command = (uint32_t *)buf;
-		xrt_result_t result = ipc_dispatch(ics, ipc_command);
-		if (result != XRT_SUCCESS) {
-			IPC_ERROR(ics->server, "During packet handling, disconnecting client.");
+		if (!ipc_server_client_handle_message(ics, latency)) {
 			break;
 		}
 	}
@@ -119,6 +190,86 @@ client_loop(volatile struct ipc_client_state *ics)
 	close(epoll_fd);
 	epoll_fd = -1;
 
+	ipc_server_client_latency_destroy(&latency);
+
+	ipc_server_client_disconnected(ics);
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+struct ipc_client_latency *
+ipc_server_client_latency_create(void)
+{
+	struct ipc_client_latency *cl = U_TYPED_CALLOC(struct ipc_client_latency);
+	cl->last_ui_update_ns = os_monotonic_get_ns();
+	cl->all_ui.values = cl->all_values;
+	cl->all_ui.count = U_LATENCY_HISTOGRAM_BUCKET_COUNT;
+
+	u_var_add_root(cl, "IPC client latency", true);
+	u_var_add_ro_u64(cl, &cl->stalls, "Calls over 2ms");
+	u_var_add_ro_text(cl, cl->all_text, "All calls");
+	u_var_add_histogram_f32(cl, &cl->all_ui, "All calls (log scale)");
+	for (uint32_t i = 0; i < COMMAND_COUNT; i++) {
+		snprintf(cl->texts[i], sizeof(cl->texts[i]), "-");
+		u_var_add_ro_text(cl, cl->texts[i], ipc_cmd_to_str((ipc_command_t)i));
+	}
+
+	return cl;
+}
+
+void
+ipc_server_client_latency_destroy(struct ipc_client_latency **cl_ptr)
+{
+	struct ipc_client_latency *cl = *cl_ptr;
+	if (cl == NULL) {
+		return;
+	}
+
+	u_var_remove_root(cl);
+	free(cl);
+	*cl_ptr = NULL;
+}
+
+bool
+ipc_server_client_handle_message(volatile struct ipc_client_state *ics, struct ipc_client_latency *latency)
+{
+	uint8_t buf[IPC_BUF_SIZE] = {0};
+
+	// Finally get the data that is waiting for us.
+	//! @todo replace this call
+	ssize_t len = recv(ics->imc.socket_fd, &buf, IPC_BUF_SIZE, 0);
+	if (len < 4) {
+		IPC_ERROR(ics->server, "Invalid packet received, disconnecting client.");
+		return false;
+	}
+
+	// Check the first 4 bytes of the message and dispatch.
+	ipc_command_t *ipc_command = (uint32_t *)buf;
+	ipc_command_t cmd = *ipc_command;
+	uint64_t start_ns = latency != NULL ? os_monotonic_get_ns() : 0;
+
+	xrt_result_t result = ipc_dispatch(ics, ipc_command);
+
+	if (latency != NULL) {
+		latency_record(ics, latency, cmd, start_ns, os_monotonic_get_ns());
+	}
+
+	if (result != XRT_SUCCESS) {
+		IPC_ERROR(ics->server, "During packet handling, disconnecting client.");
+		return false;
+	}
+
+	return true;
+}
+
+void
+ipc_server_client_disconnected(volatile struct ipc_client_state *ics)
+{
 	// Multiple threads might be looking at these fields.
 	os_mutex_lock(&ics->server->global_state.lock);
 
@@ -140,13 +291,6 @@ client_loop(volatile struct ipc_client_state *ics)
 	ipc_server_deactivate_session(ics);
 }
 
-
-/*
- *
- * 'Exported' functions.
- *
- */
-
 void
 ipc_server_client_destroy_compositor(volatile struct ipc_client_state *ics)
 {
@@ -27,6 +27,7 @@
 #include "util/u_git_tag.h"
 
 #include "shared/ipc_shmem.h"
+#include "shared/ipc_pose_history.h"
 #include "server/ipc_server.h"
 
 #include <stdlib.h>
@@ -63,7 +64,13 @@ oxr_sdl2_hack_stop(void **hack_ptr);
  */
 
 DEBUG_GET_ONCE_BOOL_OPTION(exit_on_disconnect, "IPC_EXIT_ON_DISCONNECT", false)
+DEBUG_GET_ONCE_BOOL_OPTION(latency_stats, "IPC_LATENCY_STATS", false)
 DEBUG_GET_ONCE_LOG_OPTION(ipc_log, "IPC_LOG", U_LOGGING_WARN)
+DEBUG_GET_ONCE_NUM_OPTION(pose_publish_interval_us, "IPC_POSE_PUBLISH_INTERVAL_US", 2000)
+DEBUG_GET_ONCE_NUM_OPTION(worker_threads, "IPC_WORKER_THREADS", 0)
+
+//! Histories no client has asked for in this long are not sampled.
+#define POSE_PUBLISH_IDLE_NS (U_TIME_1S_IN_NS)
 
 
 /*
@@ -137,11 +144,30 @@ teardown_idevs(struct ipc_server *s)
  *
  */
 
+static void
+teardown_pose_publisher(struct ipc_server *s)
+{
+	if (s->pose_publisher.oth.initialized) {
+		// Stops and waits for the thread.
+		os_thread_helper_destroy(&s->pose_publisher.oth);
+	}
+
+	if (s->pose_publisher.lock.initialized) {
+		os_mutex_destroy(&s->pose_publisher.lock);
+	}
+}
+
 static void
 teardown_all(struct ipc_server *s)
 {
 	u_var_remove_root(s);
 
+	// Disconnects the clients, they use the compositor and devices.
+	ipc_server_event_loop_fini(s);
+
+	// Uses the devices.
+	teardown_pose_publisher(s);
+
 	xrt_syscomp_destroy(&s->xsysc);
 
 	teardown_idevs(s);
@@ -248,6 +274,13 @@ init_shm(struct ipc_server *s)
 
 	ism->startup_timestamp = os_monotonic_get_ns();
 
+	// Limits for clients using the published poses, scaled to how often they are sampled.
+	uint64_t interval_ns = debug_get_num_option_pose_publish_interval_us() * 1000;
+	s->pose_publisher.interval_ns = interval_ns;
+	ism->poses.max_age_ns = 2 * interval_ns + 2 * U_TIME_1MS_IN_NS;
+	ism->poses.max_extrapolation_ns = 2 * interval_ns;
+	ism->poses.max_gap_ns = 4 * interval_ns;
+
 	// Setup the tracking origins.
 	count = 0;
 	for (size_t i = 0; i < XRT_SYSTEM_MAX_DEVICES; i++) {
@@ -404,6 +437,10 @@ ipc_server_start_client_listener_thread(struct ipc_server *vs, int fd)
 	for (uint32_t i = 0; i < IPC_MAX_CLIENTS; i++) {
 		volatile struct ipc_client_state *_cs = &vs->threads[i].ics;
 		if (_cs->server_thread_index < 0) {
+			// With the event loop the slot is free once a worker has torn the old client down.
+			if (vs->event_loop.worker_count > 0 && vs->threads[i].state != IPC_THREAD_READY) {
+				continue;
+			}
 			ics = _cs;
 			cs_index = i;
 			break;
@@ -442,12 +479,108 @@ ipc_server_start_client_listener_thread(struct ipc_server *vs, int fd)
 	ics->server = vs;
 	ics->server_thread_index = cs_index;
 	ics->io_active = true;
-	os_thread_start(&it->thread, ipc_server_client_thread, (void *)ics);
+	vs->ism->poses.client_io_gated[cs_index] = false;
+
+	if (vs->event_loop.worker_count > 0) {
+		// No thread, the workers handle its calls.
+		it->state = IPC_THREAD_RUNNING;
+		if (ipc_server_event_loop_add_client(vs, ics) < 0) {
+			close(fd);
+			ics->imc.socket_fd = -1;
+			ics->server_thread_index = -1;
+			it->state = IPC_THREAD_READY;
+		}
+	} else {
+		os_thread_start(&it->thread, ipc_server_client_thread, (void *)ics);
+	}
 
 	// Unlock when we are done.
 	os_mutex_unlock(&vs->global_state.lock);
 }
 
+static void
+sample_pose_locked(struct ipc_server *s, uint32_t device_id, uint32_t index, uint64_t now_ns)
+{
+	struct ipc_shared_pose_history *iph = &s->ism->poses.histories[device_id][index];
+	struct xrt_device *xdev = s->idevs[device_id].xdev;
+	enum xrt_input_name name = iph->name;
+
+	if (name == 0 || xdev == NULL) {
+		return;
+	}
+
+	// Nobody is asking for it.
+	if (now_ns - s->pose_publisher.last_request_ns[device_id][index] > POSE_PUBLISH_IDLE_NS) {
+		return;
+	}
+
+	// Clients will ask the service anyways.
+	if (name != XRT_INPUT_GENERIC_HEAD_POSE && s->ism->poses.io_gated[device_id]) {
+		return;
+	}
+
+	// Sample where clients have been asking, usually the predicted display time.
+	uint64_t at_timestamp_ns = now_ns + s->pose_publisher.lead_ns[device_id][index];
+
+	// Don't hold the lock while talking to the device.
+	os_mutex_unlock(&s->pose_publisher.lock);
+
+	struct xrt_space_relation relation = XRT_SPACE_RELATION_ZERO;
+	xrt_device_get_tracked_pose(xdev, name, at_timestamp_ns, &relation);
+	uint64_t sampled_ns = os_monotonic_get_ns();
+
+	os_mutex_lock(&s->pose_publisher.lock);
+
+	ipc_pose_history_push(iph, at_timestamp_ns, sampled_ns, &relation);
+}
+
+static void *
+pose_publisher_thread(void *ptr)
+{
+	struct ipc_server *s = (struct ipc_server *)ptr;
+	struct os_thread_helper *oth = &s->pose_publisher.oth;
+
+	os_thread_helper_name(oth, "IPC: Pose publisher");
+
+	while (os_thread_helper_is_running(oth)) {
+		os_mutex_lock(&s->pose_publisher.lock);
+
+		uint64_t now_ns = os_monotonic_get_ns();
+		for (uint32_t device_id = 0; device_id < XRT_SYSTEM_MAX_DEVICES; device_id++) {
+			for (uint32_t i = 0; i < IPC_SHARED_MAX_POSE_HISTORIES; i++) {
+				sample_pose_locked(s, device_id, i, now_ns);
+			}
+		}
+
+		os_mutex_unlock(&s->pose_publisher.lock);
+
+		os_nanosleep((int64_t)s->pose_publisher.interval_ns);
+	}
+
+	return NULL;
+}
+
+static int
+init_pose_publisher(struct ipc_server *s)
+{
+	int ret = os_mutex_init(&s->pose_publisher.lock);
+	if (ret < 0) {
+		return ret;
+	}
+
+	// Only the poses clients ask for get published.
+	if (s->pose_publisher.interval_ns == 0) {
+		return 0;
+	}
+
+	ret = os_thread_helper_init(&s->pose_publisher.oth);
+	if (ret < 0) {
+		return ret;
+	}
+
+	return os_thread_helper_start(&s->pose_publisher.oth, pose_publisher_thread, s);
+}
+
 static int
 init_all(struct ipc_server *s)
 {
@@ -465,6 +598,7 @@ init_all(struct ipc_server *s)
 	// Yes we should be running.
 	s->running = true;
 	s->exit_on_disconnect = debug_get_bool_option_exit_on_disconnect();
+	s->latency_stats = debug_get_bool_option_latency_stats();
 	s->log_level = debug_get_log_option_ipc_log();
 
 	xret = xrt_instance_create(NULL, &s->xinst);
@@ -502,6 +636,13 @@ init_all(struct ipc_server *s)
 		return ret;
 	}
 
+	ret = init_pose_publisher(s);
+	if (ret < 0) {
+		IPC_ERROR(s, "Failed to start pose publisher!");
+		teardown_all(s);
+		return ret;
+	}
+
 	ret = ipc_server_mainloop_init(&s->ml);
 	if (ret < 0) {
 		IPC_ERROR(s, "Failed to init ipc main loop!");
@@ -516,10 +657,22 @@ init_all(struct ipc_server *s)
 		return ret;
 	}
 
+	uint32_t worker_count = (uint32_t)debug_get_num_option_worker_threads();
+	if (worker_count > 0) {
+		ret = ipc_server_event_loop_init(s, worker_count);
+		if (ret < 0) {
+			IPC_ERROR(s, "Failed to start the event loop!");
+			teardown_all(s);
+			return ret;
+		}
+	}
+
 	u_var_add_root(s, "IPC Server", false);
 	u_var_add_log_level(s, &s->log_level, "Log level");
 	u_var_add_bool(s, &s->exit_on_disconnect, "exit_on_disconnect");
+	u_var_add_bool(s, &s->latency_stats, "Latency stats for new clients");
 	u_var_add_bool(s, (void *)&s->running, "running");
+	u_var_add_ro_u32(s, &s->event_loop.worker_count, "Event loop workers");
 
 	return 0;
 }
@@ -783,6 +936,48 @@ ipc_server_update_state(struct ipc_server *s)
 	os_mutex_unlock(&s->global_state.lock);
 }
 
+void
+ipc_server_publish_pose(struct ipc_server *s,
+                        uint32_t device_id,
+                        enum xrt_input_name name,
+                        uint64_t at_timestamp_ns,
+                        const struct xrt_space_relation *relation)
+{
+	uint64_t now_ns = os_monotonic_get_ns();
+
+	os_mutex_lock(&s->pose_publisher.lock);
+
+	struct ipc_shared_pose_history *iph = ipc_pose_history_claim(s->ism, device_id, name);
+	if (iph != NULL) {
+		uint32_t index = (uint32_t)(iph - s->ism->poses.histories[device_id]);
+		s->pose_publisher.lead_ns[device_id][index] = (int64_t)(at_timestamp_ns - now_ns);
+		s->pose_publisher.last_request_ns[device_id][index] = now_ns;
+
+		ipc_pose_history_push(iph, at_timestamp_ns, now_ns, relation);
+	}
+
+	os_mutex_unlock(&s->pose_publisher.lock);
+}
+
+void
+ipc_server_update_pose_gating(struct ipc_server *s)
+{
+	// Clients connecting and disconnecting change the slots.
+	os_mutex_lock(&s->global_state.lock);
+
+	// Each client only looks at its own flag, one client can't gate the others.
+	for (uint32_t i = 0; i < IPC_MAX_CLIENTS; i++) {
+		volatile struct ipc_client_state *ics = &s->threads[i].ics;
+		s->ism->poses.client_io_gated[i] = ics->imc.socket_fd > 0 && !ics->io_active;
+	}
+
+	for (uint32_t i = 0; i < XRT_SYSTEM_MAX_DEVICES; i++) {
+		s->ism->poses.io_gated[i] = !s->idevs[i].io_active;
+	}
+
+	os_mutex_unlock(&s->global_state.lock);
+}
+
 #ifndef XRT_OS_ANDROID
 int
 ipc_server_main(int argc, char **argv)
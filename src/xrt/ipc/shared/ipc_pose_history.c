@@ -0,0 +1,180 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Device poses published in shared memory.
+ * @ingroup ipc_shared
+ */
+
+#include "os/os_time.h"
+#include "os/os_seqlock.h"
+
+#include "util/u_time.h"
+
+#include "math/m_space.h"
+#include "math/m_predict.h"
+
+#include "shared/ipc_pose_history.h"
+
+#include <string.h>
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+//! Spins before the reader starts sleeping, to let a preempted writer finish.
+#define MAX_READ_SPINS 100
+
+//! Tries before giving up, the ones after the spins sleep for 0.1 ms each.
+#define MAX_READ_TRIES 200
+
+/*!
+ * Copies out the samples, retries if the writer got in the way. Gives up and
+ * returns no samples after a while, in case the writer died half way.
+ */
+static uint32_t
+read_samples(struct ipc_shared_pose_history *iph, struct ipc_shared_pose_sample *out_samples)
+{
+	for (uint32_t tries = 0; tries < MAX_READ_TRIES; tries++) {
+		os_seqlock_read_backoff(tries, MAX_READ_SPINS);
+
+		int32_t begin = 0;
+		if (!os_seqlock_read_begin(&iph->seq, &begin)) {
+			continue;
+		}
+
+		uint32_t count = iph->count;
+		if (count > IPC_SHARED_POSE_HISTORY_SIZE) {
+			count = IPC_SHARED_POSE_HISTORY_SIZE;
+		}
+		memcpy(out_samples, (const void *)iph->samples, sizeof(*out_samples) * count);
+
+		if (os_seqlock_read_end(&iph->seq, begin)) {
+			return count;
+		}
+	}
+
+	return 0;
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+struct ipc_shared_pose_history *
+ipc_pose_history_find(struct ipc_shared_memory *ism, uint32_t device_id, enum xrt_input_name name)
+{
+	if (device_id >= XRT_SYSTEM_MAX_DEVICES) {
+		return NULL;
+	}
+
+	for (uint32_t i = 0; i < IPC_SHARED_MAX_POSE_HISTORIES; i++) {
+		struct ipc_shared_pose_history *iph = &ism->poses.histories[device_id][i];
+		if (iph->name == name) {
+			return iph;
+		}
+	}
+
+	return NULL;
+}
+
+struct ipc_shared_pose_history *
+ipc_pose_history_claim(struct ipc_shared_memory *ism, uint32_t device_id, enum xrt_input_name name)
+{
+	struct ipc_shared_pose_history *iph = ipc_pose_history_find(ism, device_id, name);
+	if (iph != NULL || device_id >= XRT_SYSTEM_MAX_DEVICES) {
+		return iph;
+	}
+
+	for (uint32_t i = 0; i < IPC_SHARED_MAX_POSE_HISTORIES; i++) {
+		iph = &ism->poses.histories[device_id][i];
+		if (iph->name == 0) {
+			iph->name = name;
+			return iph;
+		}
+	}
+
+	return NULL;
+}
+
+void
+ipc_pose_history_push(struct ipc_shared_pose_history *iph,
+                      uint64_t at_timestamp_ns,
+                      uint64_t now_ns,
+                      const struct xrt_space_relation *relation)
+{
+	os_seqlock_write_begin(&iph->seq);
+
+	struct ipc_shared_pose_sample *sample = &iph->samples[iph->count % IPC_SHARED_POSE_HISTORY_SIZE];
+	sample->timestamp_ns = at_timestamp_ns;
+	sample->sampled_ns = now_ns;
+	sample->relation = *relation;
+	iph->count++;
+
+	os_seqlock_write_end(&iph->seq);
+}
+
+bool
+ipc_pose_history_get(struct ipc_shared_memory *ism,
+                     struct ipc_shared_pose_history *iph,
+                     uint64_t at_timestamp_ns,
+                     uint64_t now_ns,
+                     struct xrt_space_relation *out_relation)
+{
+	struct ipc_shared_pose_sample samples[IPC_SHARED_POSE_HISTORY_SIZE];
+	uint32_t count = read_samples(iph, samples);
+
+	const uint64_t max_age_ns = ism->poses.max_age_ns;
+	const struct ipc_shared_pose_sample *before = NULL;
+	const struct ipc_shared_pose_sample *after = NULL;
+
+	// Find the closest fresh samples on either side.
+	for (uint32_t i = 0; i < count; i++) {
+		const struct ipc_shared_pose_sample *sample = &samples[i];
+		if (sample->sampled_ns + max_age_ns < now_ns) {
+			continue;
+		}
+
+		if (sample->timestamp_ns <= at_timestamp_ns &&
+		    (before == NULL || sample->timestamp_ns > before->timestamp_ns)) {
+			before = sample;
+		}
+		if (sample->timestamp_ns >= at_timestamp_ns &&
+		    (after == NULL || sample->timestamp_ns < after->timestamp_ns)) {
+			after = sample;
+		}
+	}
+
+	if (before != NULL && before->timestamp_ns == at_timestamp_ns) {
+		*out_relation = before->relation;
+		return true;
+	}
+
+	if (before != NULL && after != NULL) {
+		uint64_t gap_ns = after->timestamp_ns - before->timestamp_ns;
+		if (gap_ns > ism->poses.max_gap_ns) {
+			return false;
+		}
+
+		struct xrt_space_relation a = before->relation;
+		struct xrt_space_relation b = after->relation;
+		float t = (float)((double)(at_timestamp_ns - before->timestamp_ns) / (double)gap_ns);
+		enum xrt_space_relation_flags flags = (enum xrt_space_relation_flags)(a.relation_flags & b.relation_flags);
+		m_space_relation_interpolate(&a, &b, t, flags, out_relation);
+		return true;
+	}
+
+	if (before != NULL && at_timestamp_ns - before->timestamp_ns <= ism->poses.max_extrapolation_ns) {
+		double delta_s = time_ns_to_s((int64_t)(at_timestamp_ns - before->timestamp_ns));
+		m_predict_relation(&before->relation, delta_s, out_relation);
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,71 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Device poses published in shared memory.
+ * @ingroup ipc_shared
+ */
+
+#pragma once
+
+#include "shared/ipc_protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*!
+ * Find the history for the given input of a device, returns NULL if the
+ * service hasn't published any poses for it.
+ *
+ * @ingroup ipc_shared
+ */
+struct ipc_shared_pose_history *
+ipc_pose_history_find(struct ipc_shared_memory *ism, uint32_t device_id, enum xrt_input_name name);
+
+/*!
+ * Find the history for the given input of a device, taking a free one if it
+ * has none yet. Returns NULL if all histories of the device are taken.
+ *
+ * Service only, must be serialized with @ref ipc_pose_history_push.
+ *
+ * @ingroup ipc_shared
+ */
+struct ipc_shared_pose_history *
+ipc_pose_history_claim(struct ipc_shared_memory *ism, uint32_t device_id, enum xrt_input_name name);
+
+/*!
+ * Publish a relation that was gotten from the device for @p at_timestamp_ns.
+ *
+ * Service only, there can only be one writer at a time.
+ *
+ * @ingroup ipc_shared
+ */
+void
+ipc_pose_history_push(struct ipc_shared_pose_history *iph,
+                      uint64_t at_timestamp_ns,
+                      uint64_t now_ns,
+                      const struct xrt_space_relation *relation);
+
+/*!
+ * Look up the relation at @p at_timestamp_ns, interpolating between or
+ * predicting from the published samples, using the limits in
+ * @ref ipc_shared_memory::poses. Never blocks on the writer.
+ *
+ * @return false if there are no samples close enough, the caller should then
+ *         ask the service.
+ *
+ * @ingroup ipc_shared
+ */
+bool
+ipc_pose_history_get(struct ipc_shared_memory *ism,
+                     struct ipc_shared_pose_history *iph,
+                     uint64_t at_timestamp_ns,
+                     uint64_t now_ns,
+                     struct xrt_space_relation *out_relation);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -25,18 +25,25 @@
 #define IPC_MSG_SOCK_FILE "monado_comp_ipc"
 #define IPC_MAX_SWAPCHAIN_HANDLES 8
 #define IPC_CRED_SIZE 1    // auth not implemented
-#define IPC_BUF_SIZE 512   // must be >= largest message length in bytes
+#define IPC_BUF_SIZE 1024  // must be >= largest message length in bytes
 #define IPC_MAX_VIEWS 8    // max views we will return configs for
 #define IPC_MAX_FORMATS 32 // max formats our server-side compositor supports
 #define IPC_MAX_DEVICES 8  // max number of devices we will map using shared mem
 #define IPC_MAX_LAYERS 16
 #define IPC_MAX_SLOTS 128
-#define IPC_MAX_CLIENTS 8
+#define IPC_MAX_CLIENTS 64
 #define IPC_EVENT_QUEUE_SIZE 32
 
 #define IPC_SHARED_MAX_INPUTS 1024
 #define IPC_SHARED_MAX_OUTPUTS 128
 #define IPC_SHARED_MAX_BINDINGS 64
+#define IPC_SHARED_MAX_POSE_HISTORIES 4 // pose inputs per device that get published
+#define IPC_SHARED_POSE_HISTORY_SIZE 16
+
+#define IPC_BATCH_MAX_CALLS 16
+#define IPC_BATCH_MAX_OUT_ARGS 4
+#define IPC_BATCH_MAX_MSG_SIZE (IPC_BUF_SIZE - 16) // room for the batch header
+#define IPC_BATCH_MAX_REPLY_SIZE 4096
 
 // example: v21.0.0-560-g586d33b5
 #define IPC_VERSION_NAME_LEN 64
@@ -122,6 +129,46 @@ struct ipc_shared_device
 	bool force_feedback_supported;
 };
 
+/*!
+ * A pose of a device as returned by the service.
+ *
+ * @ingroup ipc
+ */
+struct ipc_shared_pose_sample
+{
+	//! The time the relation was asked for.
+	uint64_t timestamp_ns;
+
+	//! When the service got the relation from the device.
+	uint64_t sampled_ns;
+
+	struct xrt_space_relation relation;
+};
+
+/*!
+ * The poses of one input of a device recently returned by the service, for
+ * clients to look up and interpolate instead of making a call.
+ *
+ * Only written by the service, readers go through the sequence lock, see
+ * @ref ipc_pose_history_get.
+ *
+ * @ingroup ipc
+ */
+struct ipc_shared_pose_history
+{
+	//! Odd while the samples are being written.
+	xrt_atomic_s32_t seq;
+
+	//! Which input this history is for, zero if unused.
+	enum xrt_input_name name;
+
+	//! Number of samples ever pushed, the next one goes in `count % IPC_SHARED_POSE_HISTORY_SIZE`.
+	uint32_t count;
+
+	//! Not ordered by time, requests can come in any order.
+	struct ipc_shared_pose_sample samples[IPC_SHARED_POSE_HISTORY_SIZE];
+};
+
 /*!
  * Data for a single composition layer.
  *
@@ -262,6 +309,35 @@ struct ipc_shared_memory
 	struct ipc_layer_slot slots[IPC_MAX_SLOTS];
 
 	uint64_t startup_timestamp;
+
+	/*!
+	 * Device poses published by the service.
+	 */
+	struct
+	{
+		//! Samples that were gotten longer ago than this are not used.
+		uint64_t max_age_ns;
+
+		//! How far to predict past the newest sample.
+		uint64_t max_extrapolation_ns;
+
+		//! Biggest time between two samples to interpolate between.
+		uint64_t max_gap_ns;
+
+		/*!
+		 * Set when the IO of the device has been turned off, then only
+		 * the head pose may be looked up locally.
+		 */
+		volatile bool io_gated[XRT_SYSTEM_MAX_DEVICES];
+
+		/*!
+		 * Set when the IO of the client has been turned off, indexed by
+		 * the id of the client, then it may only look up the head pose.
+		 */
+		volatile bool client_io_gated[IPC_MAX_CLIENTS];
+
+		struct ipc_shared_pose_history histories[XRT_SYSTEM_MAX_DEVICES][IPC_SHARED_MAX_POSE_HISTORIES];
+	} poses;
 };
 
 struct ipc_client_list
@@ -175,6 +175,9 @@ class HandleType:
 class Call:
     """A single IPC call."""
 
+    # Keep synchronized with IPC_BATCH_MAX_OUT_ARGS in ipc_protocol.h
+    MAX_BATCH_OUT_ARGS = 4
+
     def dump(self):
         """Dump human-readable output to standard out."""
         print("Call " + self.name)
@@ -209,11 +212,38 @@ class Call:
             args.extend(self.in_handles.const_arg_decls)
         write_decl(f, 'xrt_result_t', 'ipc_handle_' + self.name, args)
 
+    def write_batch_decl(self, f):
+        """Write declaration of ipc_batch_CALLNAME."""
+        args = ["struct ipc_batch *batch"]
+        args.extend(arg.get_func_argument_in() for arg in self.in_args)
+        args.extend(arg.get_func_argument_out() for arg in self.out_args)
+        write_decl(f, 'bool', 'ipc_batch_' + self.name, args)
+
+    def write_defer_decl(self, f):
+        """Write declaration of ipc_defer_CALLNAME."""
+        args = ["struct ipc_connection *ipc_c"]
+        args.extend(arg.get_func_argument_in() for arg in self.in_args)
+        write_decl(f, 'xrt_result_t', 'ipc_defer_' + self.name, args)
+
     @property
     def needs_msg_struct(self):
         """Decide whether this call needs a msg struct."""
         return self.in_args or self.in_handles
 
+    @property
+    def batchable(self):
+        """Decide whether this call can be sent as part of a batch.
+
+        Handles are sent out of band so those calls can't be batched.
+        """
+        return (not self.in_handles and not self.out_handles and
+                len(self.out_args) <= self.MAX_BATCH_OUT_ARGS)
+
+    @property
+    def deferrable(self):
+        """Decide whether this call can be deferred to the next call."""
+        return self.batchable and not self.out_args
+
     def __init__(self, name, data):
         """Construct a call from call name and call data dictionary."""
         self.id = None
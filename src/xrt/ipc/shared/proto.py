@@ -40,6 +40,7 @@ typedef enum ipc_command
 \tIPC_ERR = 0,''')
     for call in p.calls:
         f.write("\n\t" + call.id + ",")
+    f.write("\n\tIPC_BATCH,")
     f.write("\n} ipc_command_t;\n")
 
     f.write('''
@@ -63,6 +64,7 @@ ipc_cmd_to_str(ipc_command_t id)
 \tcase IPC_ERR: return "IPC_ERR";''')
     for call in p.calls:
         f.write("\n\tcase " + call.id + ": return \"" + call.id + "\";")
+    f.write("\n\tcase IPC_BATCH: return \"IPC_BATCH\";")
     f.write("\n\tdefault: return \"IPC_UNKNOWN\";")
     f.write("\n\t}\n}\n")
 
@@ -89,18 +91,153 @@ ipc_cmd_to_str(ipc_command_t id)
                 f.write("\t" + arg.get_struct_field() + ";\n")
             f.write("};\n")
 
+    f.write('''
+/*!
+ * Several calls sent in one message, each call's message struct packed one
+ * after the other in @p data, only the used part of @p data is sent. The
+ * first @p deferred_count calls were deferred, nobody waits on their results.
+ */
+struct ipc_batch_msg
+{
+\tenum ipc_command cmd;
+\tuint32_t call_count;
+\tuint32_t deferred_count;
+\tuint32_t size;
+\tuint32_t reply_size;
+\tuint8_t data[IPC_BATCH_MAX_MSG_SIZE];
+};
+
+/*!
+ * The replies to a @ref ipc_batch_msg, the calls are run in order and the
+ * first call that fails stops the rest from being run, unless it is one of
+ * the deferred calls. The replies of the calls not run are zeroed, so it
+ * always has the size the client expects.
+ */
+struct ipc_batch_reply
+{
+\txrt_result_t result;
+\tuint32_t call_count;
+\tuint8_t data[IPC_BATCH_MAX_REPLY_SIZE];
+};
+''')
+
     f.write("#pragma pack (pop)\n")
 
     f.close()
 
 
+def write_msg_struct(f, call):
+    """Write the message struct of a call, filled in from the arguments."""
+    if call.needs_msg_struct:
+        f.write("\tstruct ipc_" + call.name + "_msg _msg = {\n")
+    else:
+        f.write("\tstruct ipc_command_msg _msg = {\n")
+    f.write("\t    .cmd = " + str(call.id) + ",\n")
+    for arg in call.in_args:
+        if arg.is_aggregate:
+            f.write("\t    ." + arg.name + " = *" + arg.name + ",\n")
+        else:
+            f.write("\t    ." + arg.name + " = " + arg.name + ",\n")
+    if call.in_handles:
+        f.write("\t    ." + call.in_handles.count_arg_name +
+                " = " + call.in_handles.count_arg_name + ",\n")
+    f.write("\t};\n")
+
+
+def reply_struct_name(call):
+    """Get the name of the reply struct of a call."""
+    if call.out_args:
+        return "struct ipc_" + call.name + "_reply"
+    return "struct ipc_result_reply"
+
+
+def generate_client_batch_c(f, p):
+    """Generate the batching part of the IPC client proxy source."""
+    # Adding calls to a batch.
+    for call in p.calls:
+        if not call.batchable:
+            continue
+
+        call.write_batch_decl(f)
+        f.write("\n{\n")
+        write_msg_struct(f, call)
+
+        if call.out_args:
+            f.write("\tvoid *_out_args[] = {\n")
+            for arg in call.out_args:
+                f.write("\t    out_" + arg.name + ",\n")
+            f.write("\t};\n")
+            out_args = ["_out_args", str(len(call.out_args))]
+        else:
+            out_args = ["NULL", "0"]
+
+        f.write("\n\treturn ipc_batch_add(batch, &_msg, sizeof(_msg), sizeof(" +
+                reply_struct_name(call) + "), " + ", ".join(out_args) +
+                ");\n}\n")
+
+    # Deferring calls until the next call is made.
+    for call in p.calls:
+        if not call.deferrable:
+            continue
+
+        args = ["&ipc_c->deferred"]
+        args.extend(arg.name for arg in call.in_args)
+
+        call.write_defer_decl(f)
+        f.write("\n{\n")
+        f.write("\tIPC_TRACE(ipc_c, \"Deferring " + call.name + "\");\n")
+        f.write("""
+\tos_mutex_lock(&ipc_c->mutex);
+
+\t// Always fits once the batch has been sent.
+\tif (!ipc_batch_{name}({args})) {{
+\t\txrt_result_t ret = ipc_client_flush_deferred_locked(ipc_c);
+\t\tif (ret != XRT_SUCCESS) {{
+\t\t\tos_mutex_unlock(&ipc_c->mutex);
+\t\t\treturn ret;
+\t\t}}
+\t\tipc_batch_{name}({args});
+\t}}
+\tipc_c->deferred.deferred_count = ipc_c->deferred.call_count;
+
+\tos_mutex_unlock(&ipc_c->mutex);
+\treturn XRT_SUCCESS;
+}}
+""".format(name=call.name, args=", ".join(args)))
+
+    # Getting the replies out of a batch.
+    f.write('''
+xrt_result_t
+ipc_batch_unpack_reply(uint32_t cmd, const uint8_t *data, void **out_args)
+{
+\tswitch (cmd) {
+''')
+    for call in p.calls:
+        if not call.batchable:
+            continue
+        f.write("\tcase " + call.id + ": {\n")
+        f.write("\t\t" + reply_struct_name(call) + " _reply;\n")
+        f.write("\t\tmemcpy(&_reply, data, sizeof(_reply));\n")
+        for i, arg in enumerate(call.out_args):
+            f.write("\t\t*(%s *)out_args[%i] = _reply.%s;\n" %
+                    (arg.typename, i, arg.name))
+        f.write("\t\treturn _reply.result;\n")
+        f.write("\t}\n")
+    f.write('''\tdefault: return XRT_ERROR_IPC_FAILURE;
+\t}
+}
+''')
+
+
 def generate_client_c(file, p):
     """Generate IPC client proxy source."""
     f = open(file, "w")
     f.write(header.format(brief='Generated IPC client code', suffix='_client'))
     f.write('''
 #include "client/ipc_client.h"
-#include "ipc_protocol_generated.h"
+#include "ipc_client_generated.h"
+
+#include <string.h>
 
 
 \n''')
@@ -113,20 +250,7 @@ def generate_client_c(file, p):
         f.write("\tIPC_TRACE(ipc_c, \"Calling " + call.name + "\");\n\n")
 
         # Message struct
-        if call.needs_msg_struct:
-            f.write("\tstruct ipc_" + call.name + "_msg _msg = {\n")
-        else:
-            f.write("\tstruct ipc_command_msg _msg = {\n")
-        f.write("\t    .cmd = " + str(call.id) + ",\n")
-        for arg in call.in_args:
-            if arg.is_aggregate:
-                f.write("\t    ." + arg.name + " = *" + arg.name + ",\n")
-            else:
-                f.write("\t    ." + arg.name + " = " + arg.name + ",\n")
-        if call.in_handles:
-            f.write("\t    ." + call.in_handles.count_arg_name +
-                    " = " + call.in_handles.count_arg_name + ",\n")
-        f.write("\t};\n")
+        write_msg_struct(f, call)
 
         # Reply struct
         if call.out_args:
@@ -142,11 +266,38 @@ def generate_client_c(file, p):
 """)
         cleanup = "os_mutex_unlock(&ipc_c->mutex);"
 
+        if call.batchable:
+            # Send it along with any deferred calls.
+            args = ["&ipc_c->deferred"]
+            args.extend(arg.name for arg in call.in_args)
+            args.extend("out_" + arg.name for arg in call.out_args)
+            f.write("""
+\t// Send this together with the deferred calls if there are any.
+\tif (ipc_c->deferred.call_count > 0) {""")
+            write_invocation(f, "bool added", "ipc_batch_" + call.name,
+                             args, indent="\t\t")
+            f.write(""";
+\t\txrt_result_t ret = ipc_client_flush_deferred_locked(ipc_c);
+\t\tif (added || ret != XRT_SUCCESS) {
+\t\t\tos_mutex_unlock(&ipc_c->mutex);
+\t\t\treturn ret;
+\t\t}
+\t}
+""")
+        else:
+            f.write("\n\t// The deferred calls go first.")
+            write_invocation(f, 'xrt_result_t ret',
+                             'ipc_client_flush_deferred_locked', ['ipc_c'],
+                             indent="\t")
+            f.write(';')
+            write_result_handler(f, 'ret', cleanup, indent="\t")
+
         # Prepare initial sending
         func = 'ipc_send'
         args = ['&ipc_c->imc', '&_msg', 'sizeof(_msg)']
         f.write("\n\t// Send our request")
-        write_invocation(f, 'xrt_result_t ret', func, args, indent="\t")
+        write_invocation(f, 'xrt_result_t ret' if call.batchable else 'ret',
+                         func, args, indent="\t")
         f.write(';')
         write_result_handler(f, 'ret', cleanup, indent="\t")
 
@@ -204,6 +355,8 @@ def generate_client_c(file, p):
             f.write("\t*out_" + arg.name + " = _reply." + arg.name + ";\n")
         f.write("\n\t" + cleanup)
         f.write("\n\treturn _reply.result;\n}\n")
+
+    generate_client_batch_c(f, p)
     f.close()
 
 
@@ -228,9 +381,152 @@ def generate_client_h(file, p):
     for call in p.calls:
         call.write_call_decl(f)
         f.write(";\n")
+
+    f.write('''
+
+/*
+ *
+ * Batching, see @ref ipc_batch.
+ *
+ */
+''')
+    for call in p.calls:
+        if call.batchable:
+            call.write_batch_decl(f)
+            f.write(";\n")
+    for call in p.calls:
+        if call.deferrable:
+            call.write_defer_decl(f)
+            f.write(";\n")
+    write_decl(f, "xrt_result_t", "ipc_batch_unpack_reply",
+               ["uint32_t cmd", "const uint8_t *data", "void **out_args"])
+    f.write(";\n")
     f.close()
 
 
+def generate_server_batch_c(f, p):
+    """Generate the running of batched calls for the server."""
+    f.write('''
+/*!
+ * Runs one call of a batch, the reply is written to @p reply_data.
+ */
+static xrt_result_t
+dispatch_batched_call(volatile struct ipc_client_state *ics,
+                      const uint8_t *msg_data,
+                      uint32_t msg_left,
+                      uint8_t *reply_data,
+                      uint32_t reply_left,
+                      uint32_t *out_msg_size,
+                      uint32_t *out_reply_size,
+                      xrt_result_t *out_result)
+{
+\tipc_command_t cmd;
+\tif (msg_left < sizeof(cmd)) {
+\t\treturn XRT_ERROR_IPC_FAILURE;
+\t}
+\tmemcpy(&cmd, msg_data, sizeof(cmd));
+
+\tswitch (cmd) {
+''')
+    for call in p.calls:
+        if not call.batchable:
+            continue
+
+        msg_type = ("struct ipc_" + call.name + "_msg"
+                    if call.needs_msg_struct
+                    else "struct ipc_command_msg")
+        f.write("\tcase " + call.id + ": {\n")
+        f.write("\t\tIPC_TRACE(ics->server, \"Dispatching batched " +
+                call.name + "\");\n\n")
+        f.write("\t\t%s msg;\n" % msg_type)
+        f.write("\t\t%s reply = {0};\n" % reply_struct_name(call))
+        f.write("""\t\tif (msg_left < sizeof(msg) || reply_left < sizeof(reply)) {
+\t\t\treturn XRT_ERROR_IPC_FAILURE;
+\t\t}
+\t\tmemcpy(&msg, msg_data, sizeof(msg));
+""")
+
+        args = ["ics"]
+        for arg in call.in_args:
+            args.append(("&msg." + arg.name)
+                        if arg.is_aggregate
+                        else ("msg." + arg.name))
+        args.extend("&reply." + arg.name for arg in call.out_args)
+        write_invocation(f, 'reply.result', 'ipc_handle_' +
+                         call.name, args, indent="\t\t")
+        f.write(""";
+
+\t\tmemcpy(reply_data, &reply, sizeof(reply));
+\t\t*out_msg_size = sizeof(msg);
+\t\t*out_reply_size = sizeof(reply);
+\t\t*out_result = reply.result;
+\t\treturn XRT_SUCCESS;
+\t}
+""")
+
+    f.write('''\tdefault:
+\t\tU_LOG_E("Can not batch IPC message %d!", cmd);
+\t\treturn XRT_ERROR_IPC_FAILURE;
+\t}
+}
+
+/*!
+ * Runs the calls of a batch in order, stopping at the first one that fails
+ * that isn't a deferred call, and sends all of the replies back in one message.
+ */
+static xrt_result_t
+dispatch_batch(volatile struct ipc_client_state *ics, struct ipc_batch_msg *msg)
+{
+\tIPC_TRACE(ics->server, "Dispatching batch of %u calls", msg->call_count);
+
+\tif (msg->call_count > IPC_BATCH_MAX_CALLS || msg->size > IPC_BATCH_MAX_MSG_SIZE ||
+\t    msg->reply_size > IPC_BATCH_MAX_REPLY_SIZE) {
+\t\tU_LOG_E("Invalid IPC batch!");
+\t\treturn XRT_ERROR_IPC_FAILURE;
+\t}
+
+\tstruct ipc_batch_reply reply;
+\treply.result = XRT_SUCCESS;
+\treply.call_count = 0;
+\tmemset(reply.data, 0, msg->reply_size);
+
+\tuint32_t msg_offset = 0;
+\tuint32_t reply_offset = 0;
+\tfor (uint32_t i = 0; i < msg->call_count; i++) {
+\t\tuint32_t msg_size = 0;
+\t\tuint32_t reply_size = 0;
+\t\txrt_result_t result = XRT_SUCCESS;
+
+\t\txrt_result_t ret = dispatch_batched_call( //
+\t\t    ics,                                  //
+\t\t    msg->data + msg_offset,               //
+\t\t    msg->size - msg_offset,               //
+\t\t    reply.data + reply_offset,            //
+\t\t    msg->reply_size - reply_offset,       //
+\t\t    &msg_size,                            //
+\t\t    &reply_size,                          //
+\t\t    &result);                             //
+\t\tif (ret != XRT_SUCCESS) {
+\t\t\treturn ret;
+\t\t}
+
+\t\tmsg_offset += msg_size;
+\t\treply_offset += reply_size;
+\t\treply.call_count++;
+
+\t\t// The client reports failed deferred calls, the calls after them still run.
+\t\tif (result != XRT_SUCCESS && i >= msg->deferred_count) {
+\t\t\treply.result = result;
+\t\t\tbreak;
+\t\t}
+\t}
+
+\tsize_t reply_size = offsetof(struct ipc_batch_reply, data) + msg->reply_size;
+\treturn ipc_send((struct ipc_message_channel *)&ics->imc, &reply, reply_size);
+}
+''')
+
+
 def generate_server_c(file, p):
     """Generate IPC server stub/dispatch source."""
     f = open(file, "w")
@@ -243,16 +539,22 @@ def generate_server_c(file, p):
 
 #include "server/ipc_server.h"
 
+#include <stddef.h>
+#include <string.h>
+
 
 
 #define MAX_HANDLES 16
 ''')
 
+    generate_server_batch_c(f, p)
+
     f.write('''
 xrt_result_t
 ipc_dispatch(volatile struct ipc_client_state *ics, ipc_command_t *ipc_command)
 {
 \tswitch (*ipc_command) {
+\tcase IPC_BATCH: return dispatch_batch(ics, (struct ipc_batch_msg *)ipc_command);
 ''')
 
     for call in p.calls:
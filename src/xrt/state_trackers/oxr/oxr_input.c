@@ -53,7 +53,8 @@ oxr_action_cache_update(struct oxr_logger *log,
                         struct oxr_action_cache *cache,
                         int64_t time,
                         struct oxr_subaction_paths *subaction_path,
-                        bool select);
+                        bool select,
+                        bool full);
 
 static void
 oxr_action_attachment_update(struct oxr_logger *log,
@@ -62,7 +63,8 @@ oxr_action_attachment_update(struct oxr_logger *log,
                              const XrActiveActionSet *actionSets,
                              struct oxr_action_attachment *act_attached,
                              int64_t time,
-                             struct oxr_subaction_paths subaction_paths);
+                             struct oxr_subaction_paths subaction_paths,
+                             bool full);
 
 static void
 oxr_action_bind_io(struct oxr_logger *log,
@@ -894,13 +896,45 @@ oxr_input_supressed(struct oxr_session *sess,
 	return false;
 }
 
+/*!
+ * Compares the input with how it was at the last sync and remembers it. The
+ * timestamp is left out, most drivers stamp every update and with the same
+ * value the action keeps its old timestamp anyway.
+ *
+ * @returns true if the input changed since the last sync.
+ */
 static bool
-oxr_input_combine_input(struct oxr_session *sess,
-                        uint32_t countActionSets,
-                        const XrActiveActionSet *actionSets,
-                        struct oxr_action_attachment *act_attached,
-                        struct oxr_subaction_paths *subaction_path,
-                        struct oxr_action_cache *cache,
+oxr_input_refresh(const struct xrt_input *input, struct xrt_input *last)
+{
+	if (input == NULL) {
+		return false;
+	}
+
+	bool changed = input->active != last->active || memcmp(&input->value, &last->value, sizeof(input->value)) != 0;
+	*last = *input;
+
+	return changed;
+}
+
+/*!
+ * Refreshes the snapshots of all inputs of the cache.
+ *
+ * @returns true if any of them changed since the last sync.
+ */
+static bool
+oxr_action_cache_refresh_inputs(struct oxr_action_cache *cache)
+{
+	bool changed = false;
+	for (size_t i = 0; i < cache->input_count; i++) {
+		struct oxr_action_input *action_input = &cache->inputs[i];
+		changed |= oxr_input_refresh(action_input->input, &action_input->last_input);
+		changed |= oxr_input_refresh(action_input->dpad_activate, &action_input->last_dpad_activate);
+	}
+	return changed;
+}
+
+static bool
+oxr_input_combine_input(struct oxr_action_cache *cache,
                         struct oxr_input_value_tagged *out_input,
                         int64_t *timestamp,
                         bool *is_active)
@@ -923,8 +957,7 @@ oxr_input_combine_input(struct oxr_session *sess,
 
 		// suppress input if it is also bound to action in set with
 		// higher priority
-		if (oxr_input_supressed(sess, countActionSets, actionSets, subaction_path, act_attached,
-		                        action_input)) {
+		if (action_input->suppressed) {
 			continue;
 		}
 
@@ -1015,7 +1048,8 @@ oxr_action_cache_update(struct oxr_logger *log,
                         struct oxr_action_cache *cache,
                         int64_t time,
                         struct oxr_subaction_paths *subaction_path,
-                        bool selected)
+                        bool selected,
+                        bool full)
 {
 	struct oxr_action_state last = cache->current;
 
@@ -1038,9 +1072,28 @@ oxr_action_cache_update(struct oxr_logger *log,
 			oxr_action_cache_stop_output(log, sess, cache);
 		}
 	} else if (cache->input_count > 0) {
+		// Always refreshed, so the next sync compares against this one.
+		bool inputs_changed = oxr_action_cache_refresh_inputs(cache);
+
+		if (full) {
+			for (size_t i = 0; i < cache->input_count; i++) {
+				struct oxr_action_input *action_input = &cache->inputs[i];
+				action_input->suppressed = oxr_input_supressed(sess, countActionSets, actionSets,
+				                                               subaction_path, act_attached, action_input);
+			}
+		} else if (!inputs_changed) {
+			/*
+			 * Same inputs and same action sets give the same state, the
+			 * transforms settle after one sync. Only the change is over.
+			 */
+			cache->current.changed = false;
+			sess->action_sync.cache_skips++;
+			return;
+		}
 
-		if (!oxr_input_combine_input(sess, countActionSets, actionSets, act_attached, subaction_path, cache,
-		                             &combined, &timestamp, &is_active)) {
+		sess->action_sync.cache_updates++;
+
+		if (!oxr_input_combine_input(cache, &combined, &timestamp, &is_active)) {
 			oxr_log(log, "Failed to get/combine input values '%s'", act_attached->act_ref->name);
 			return;
 		}
@@ -1151,7 +1204,8 @@ oxr_action_attachment_update(struct oxr_logger *log,
                              const XrActiveActionSet *actionSets,
                              struct oxr_action_attachment *act_attached,
                              int64_t time,
-                             struct oxr_subaction_paths subaction_paths)
+                             struct oxr_subaction_paths subaction_paths,
+                             bool full)
 {
 	// This really shouldn't be happening.
 	if (act_attached == NULL) {
@@ -1165,7 +1219,7 @@ oxr_action_attachment_update(struct oxr_logger *log,
 	subaction_paths_##X.X = true;                                                                                  \
 	bool select_##X = subaction_paths.X || subaction_paths.any;                                                    \
 	oxr_action_cache_update(log, sess, countActionSets, actionSets, act_attached, &act_attached->X, time,          \
-	                        &subaction_paths_##X, select_##X);
+	                        &subaction_paths_##X, select_##X, full);
 
 	OXR_FOR_EACH_VALID_SUBACTION_PATH(UPDATE_SELECT)
 #undef UPDATE_SELECT
@@ -1550,34 +1604,20 @@ oxr_session_attach_action_sets(struct oxr_logger *log,
 	return oxr_session_success_result(sess);
 }
 
-XrResult
-oxr_action_sync_data(struct oxr_logger *log,
-                     struct oxr_session *sess,
-                     uint32_t countActionSets,
-                     const XrActiveActionSet *actionSets)
+/*!
+ * Resets the requested sub-action paths and recomputes every action cache,
+ * used when the synced action sets are not the same as last time.
+ */
+static XrResult
+oxr_action_sync_data_full(struct oxr_logger *log,
+                          struct oxr_session *sess,
+                          uint32_t countActionSets,
+                          const XrActiveActionSet *actionSets,
+                          int64_t now)
 {
 	struct oxr_action_set *act_set = NULL;
 	struct oxr_action_set_attachment *act_set_attached = NULL;
 
-	// Check that all action sets has been attached.
-	for (uint32_t i = 0; i < countActionSets; i++) {
-		oxr_session_get_action_set_attachment(sess, actionSets[i].actionSet, &act_set_attached, &act_set);
-		if (act_set_attached == NULL) {
-			return oxr_error(log, XR_ERROR_ACTIONSET_NOT_ATTACHED,
-			                 "(actionSets[%i].actionSet) action set '%s' has "
-			                 "not been attached to this session",
-			                 i, act_set != NULL ? act_set->data->name : "NULL");
-		}
-	}
-
-	// Synchronize outputs to this time.
-	int64_t now = time_state_get_now(sess->sys->inst->timekeeping);
-
-	// Loop over all xdev devices.
-	for (size_t i = 0; i < sess->sys->xsysd->xdev_count; i++) {
-		oxr_xdev_update(sess->sys->xsysd->xdevs[i]);
-	}
-
 	// Reset all action set attachments.
 	for (size_t i = 0; i < sess->action_set_attachment_count; ++i) {
 		act_set_attached = &sess->act_set_attachments[i];
@@ -1630,7 +1670,6 @@ oxr_action_sync_data(struct oxr_logger *log,
 		act_set_attached = &sess->act_set_attachments[i];
 		struct oxr_subaction_paths subaction_paths = act_set_attached->requested_subaction_paths;
 
-
 		for (uint32_t k = 0; k < act_set_attached->action_attachment_count; k++) {
 			struct oxr_action_attachment *act_attached = &act_set_attached->act_attachments[k];
 
@@ -1639,7 +1678,77 @@ oxr_action_sync_data(struct oxr_logger *log,
 			}
 
 			oxr_action_attachment_update(log, sess, countActionSets, actionSets, act_attached, now,
-			                             subaction_paths);
+			                             subaction_paths, true);
+		}
+	}
+
+	// Remember the sets, the next sync with the same ones can skip all of the above.
+	if (sess->action_sync.capacity < countActionSets) {
+		U_ARRAY_REALLOC_OR_FREE(sess->action_sync.action_sets, XrActiveActionSet, countActionSets);
+		sess->action_sync.capacity = sess->action_sync.action_sets != NULL ? countActionSets : 0;
+	}
+	if (sess->action_sync.capacity >= countActionSets) {
+		if (countActionSets > 0) {
+			memcpy(sess->action_sync.action_sets, actionSets, sizeof(*actionSets) * countActionSets);
+		}
+		sess->action_sync.count = countActionSets;
+		sess->action_sync.valid = true;
+	}
+
+	return oxr_session_success_focused_result(sess);
+}
+
+XrResult
+oxr_action_sync_data(struct oxr_logger *log,
+                     struct oxr_session *sess,
+                     uint32_t countActionSets,
+                     const XrActiveActionSet *actionSets)
+{
+	struct oxr_action_set *act_set = NULL;
+	struct oxr_action_set_attachment *act_set_attached = NULL;
+
+	// Check that all action sets has been attached.
+	for (uint32_t i = 0; i < countActionSets; i++) {
+		oxr_session_get_action_set_attachment(sess, actionSets[i].actionSet, &act_set_attached, &act_set);
+		if (act_set_attached == NULL) {
+			return oxr_error(log, XR_ERROR_ACTIONSET_NOT_ATTACHED,
+			                 "(actionSets[%i].actionSet) action set '%s' has "
+			                 "not been attached to this session",
+			                 i, act_set != NULL ? act_set->data->name : "NULL");
+		}
+	}
+
+	// Synchronize outputs to this time.
+	int64_t now = time_state_get_now(sess->sys->inst->timekeeping);
+
+	// Loop over all xdev devices.
+	for (size_t i = 0; i < sess->sys->xsysd->xdev_count; i++) {
+		oxr_xdev_update(sess->sys->xsysd->xdevs[i]);
+	}
+
+	// The devices have new data, so cached relations are stale.
+	oxr_pose_cache_invalidate(&sess->pose_cache);
+
+	/*
+	 * With the same action sets as last time only the inputs can have
+	 * changed, the requested sub-action paths and suppression are the same.
+	 */
+	bool same = sess->action_sync.incremental && sess->action_sync.valid &&
+	            sess->action_sync.count == countActionSets &&
+	            (countActionSets == 0 ||
+	             memcmp(sess->action_sync.action_sets, actionSets, sizeof(*actionSets) * countActionSets) == 0);
+	if (!same) {
+		sess->action_sync.valid = false;
+		return oxr_action_sync_data_full(log, sess, countActionSets, actionSets, now);
+	}
+
+	for (size_t i = 0; i < sess->action_set_attachment_count; ++i) {
+		act_set_attached = &sess->act_set_attachments[i];
+		struct oxr_subaction_paths subaction_paths = act_set_attached->requested_subaction_paths;
+
+		for (uint32_t k = 0; k < act_set_attached->action_attachment_count; k++) {
+			oxr_action_attachment_update(log, sess, countActionSets, actionSets,
+			                             &act_set_attached->act_attachments[k], now, subaction_paths, false);
 		}
 	}
 
@@ -275,6 +275,10 @@ oxr_instance_create(struct oxr_logger *log,
 
 	struct oxr_system *sys = &inst->system;
 
+	// Sets the enabled extensions, this is where we should do any extra validation.
+	// Before the system is created, it needs to know if we are headless.
+	inst->extensions = *extensions;
+
 	// Create the compositor if we are not headless.
 	if (!inst->extensions.MND_headless) {
 		xret = xrt_instance_create_system(inst->xinst, &sys->xsysd, &sys->xsysc);
@@ -318,9 +322,6 @@ oxr_instance_create(struct oxr_logger *log,
 	u_device_setup_tracking_origins(dev, GET_XDEV_BY_ROLE(sys, left), GET_XDEV_BY_ROLE(sys, right),
 	                                &global_tracking_origin_offset);
 
-	// Sets the enabled extensions, this is where we should do any extra validation.
-	inst->extensions = *extensions;
-
 	ret = oxr_system_fill_in(log, inst, 1, &inst->system);
 	if (ret != XR_SUCCESS) {
 		oxr_instance_destroy(log, &inst->handle);
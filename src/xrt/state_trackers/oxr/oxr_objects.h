@@ -131,6 +131,7 @@ struct oxr_interaction_profile;
 struct oxr_action_set_ref;
 struct oxr_action_ref;
 struct oxr_hand_tracker;
+struct oxr_pose_cache;
 
 #define XRT_MAX_HANDLE_CHILDREN 256
 #define OXR_MAX_SWAPCHAIN_IMAGES 8
@@ -1077,6 +1078,54 @@ oxr_xdev_get_space_relation(struct oxr_logger *log,
                             XrTime at_time,
                             struct xrt_space_relation *out_relation);
 
+/*!
+ * Same as @ref oxr_xdev_get_space_relation but goes through the given cache,
+ * the device is only asked on a miss.
+ *
+ * @public @memberof oxr_pose_cache
+ */
+void
+oxr_xdev_get_space_relation_cached(struct oxr_logger *log,
+                                   struct oxr_instance *inst,
+                                   struct oxr_pose_cache *cache,
+                                   struct xrt_device *xdev,
+                                   enum xrt_input_name name,
+                                   XrTime at_time,
+                                   struct xrt_space_relation *out_relation);
+
+/*!
+ * @public @memberof oxr_pose_cache
+ */
+void
+oxr_pose_cache_init(struct oxr_pose_cache *cache, bool enabled);
+
+/*!
+ * @public @memberof oxr_pose_cache
+ */
+void
+oxr_pose_cache_fini(struct oxr_pose_cache *cache);
+
+/*!
+ * Drops all entries, called when new device data might be available.
+ *
+ * @public @memberof oxr_pose_cache
+ */
+void
+oxr_pose_cache_invalidate(struct oxr_pose_cache *cache);
+
+/*!
+ * Adds a relation that was gotten from the device some other way, like the
+ * head relation from @ref xrt_device_get_view_poses.
+ *
+ * @public @memberof oxr_pose_cache
+ */
+void
+oxr_pose_cache_insert(struct oxr_pose_cache *cache,
+                      struct xrt_device *xdev,
+                      enum xrt_input_name name,
+                      XrTime at_time,
+                      const struct xrt_space_relation *relation);
+
 /*!
  * Returns the hand tracking value of the named input from the device.
  * Does NOT apply tracking origin offset to each joint.
@@ -1454,6 +1503,8 @@ struct oxr_instance
 	size_t path_array_length;
 	//! Number of paths in the array (0 is always null).
 	size_t path_num;
+	//! Memory the paths are allocated from, freed all at once.
+	struct oxr_path_chunk *path_chunks;
 
 	// Event queue.
 	struct
@@ -1524,6 +1575,59 @@ struct oxr_instance
 #endif
 };
 
+/*!
+ * Maximum number of relations kept in a @ref oxr_pose_cache.
+ *
+ * @ingroup oxr_main
+ */
+#define OXR_POSE_CACHE_SIZE 32
+
+/*!
+ * A single relation of a device input at a time.
+ *
+ * @ingroup oxr_main
+ */
+struct oxr_pose_cache_entry
+{
+	struct xrt_device *xdev;
+	enum xrt_input_name name;
+	XrTime at_time;
+
+	//! With the tracking origin offset applied.
+	struct xrt_space_relation relation;
+};
+
+/*!
+ * Per session cache of device relations, apps tend to locate many spaces
+ * against the same devices at the same time each frame, each of which would
+ * otherwise run the device's prediction or do an IPC round-trip.
+ *
+ * Invalidated on xrSyncActions and xrWaitFrame.
+ *
+ * @ingroup oxr_main
+ */
+struct oxr_pose_cache
+{
+	//! Spaces may be located from multiple threads.
+	struct os_mutex mutex;
+
+	//! Disabled with OXR_POSE_CACHE=false.
+	bool enabled;
+
+	struct oxr_pose_cache_entry entries[OXR_POSE_CACHE_SIZE];
+	uint32_t entry_count;
+
+	//! Slot to replace next when full.
+	uint32_t next;
+
+	//! Bumped on invalidate, relations asked for before that aren't inserted after it.
+	uint64_t generation;
+
+	//! Counters, exposed via u_var.
+	uint64_t hits;
+	uint64_t misses;
+};
+
 /*!
  * Object that client program interact with.
  *
@@ -1649,6 +1753,29 @@ struct oxr_session
 	/*! initial relation of head in "global" space.
 	 * Used as reference for local space.  */
 	struct xrt_space_relation local_space_pure_relation;
+
+	//! Device relations for the current frame.
+	struct oxr_pose_cache pose_cache;
+
+	/*!
+	 * The action sets given to the last xrSyncActions. While the same sets
+	 * are synced, only action caches whose inputs changed are recomputed.
+	 */
+	struct
+	{
+		XrActiveActionSet *action_sets;
+		uint32_t count;
+		uint32_t capacity;
+
+		//! The sets above were synced successfully.
+		bool valid;
+
+		//! Off recomputes every action cache on every sync.
+		bool incremental;
+
+		uint64_t cache_updates;
+		uint64_t cache_skips;
+	} action_sync;
 };
 
 /*!
@@ -1919,6 +2046,13 @@ struct oxr_action_input
 	struct oxr_input_transform *transforms;
 	size_t transform_count;
 	XrPath bound_path;
+
+	//! The inputs as they were at the last sync, unchanged inputs give the same action state.
+	struct xrt_input last_input;
+	struct xrt_input last_dpad_activate;
+
+	//! Bound in an action set with higher priority, only changes with the synced action sets.
+	bool suppressed;
 };
 
 /*!
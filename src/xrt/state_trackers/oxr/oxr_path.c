@@ -11,7 +11,6 @@
 #include <string.h>
 #include <stdlib.h>
 
-#include "math/m_api.h"
 #include "util/u_misc.h"
 
 #include "oxr_objects.h"
@@ -31,6 +30,22 @@ struct oxr_path
 	void *attached;
 };
 
+/*!
+ * Paths live as long as the instance, so they are bump allocated out of
+ * chunks that are all freed at once in @ref oxr_path_destroy.
+ *
+ * @ingroup oxr_main
+ */
+struct oxr_path_chunk
+{
+	struct oxr_path_chunk *next;
+	size_t used;
+	size_t size;
+	uint64_t data[];
+};
+
+#define OXR_PATH_CHUNK_SIZE (16 * 1024)
+
 
 /*
  *
@@ -63,6 +78,33 @@ from_item(struct u_hashset_item *item)
  *
  */
 
+static void *
+oxr_path_chunk_alloc(struct oxr_instance *inst, size_t size)
+{
+	// Keep every allocation aligned for the struct oxr_path at its start.
+	size = (size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+
+	struct oxr_path_chunk *chunk = inst->path_chunks;
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		size_t chunk_size = size > OXR_PATH_CHUNK_SIZE ? size : OXR_PATH_CHUNK_SIZE;
+
+		chunk = (struct oxr_path_chunk *)malloc(sizeof(struct oxr_path_chunk) + chunk_size);
+		if (chunk == NULL) {
+			return NULL;
+		}
+
+		chunk->next = inst->path_chunks;
+		chunk->used = 0;
+		chunk->size = chunk_size;
+		inst->path_chunks = chunk;
+	}
+
+	void *ptr = (uint8_t *)chunk->data + chunk->used;
+	chunk->used += size;
+
+	return ptr;
+}
+
 static XrResult
 oxr_ensure_array_length(struct oxr_logger *log, struct oxr_instance *inst, XrPath *out_id)
 {
@@ -75,7 +117,7 @@ oxr_ensure_array_length(struct oxr_logger *log, struct oxr_instance *inst, XrPat
 
 	size_t new_size = inst->path_array_length;
 	while (new_size < num) {
-		new_size += 64;
+		new_size *= 2;
 	}
 
 	U_ARRAY_REALLOC_OR_FREE(inst->path_array, struct oxr_path *, new_size);
@@ -100,29 +142,26 @@ oxr_allocate_path(
 	size += length;                        // String.
 	size += 1;                             // Null terminate it.
 
-	// Now allocate and setup the path.
-	path = U_CALLOC_WITH_CAST(struct oxr_path, size);
+	// Now allocate and setup the path, freed with the chunk.
+	path = (struct oxr_path *)oxr_path_chunk_alloc(inst, size);
 	if (path == NULL) {
 		return oxr_error(log, XR_ERROR_RUNTIME_FAILURE, "Failed to allocate path");
 	}
 	path->debug = OXR_XR_DEBUG_PATH;
+	path->attached = NULL;
 
-	// Setup the item.
+	// Setup the item, the hash is filled in by the hashset.
 	item = get_item(path);
-	item->hash = math_hash_string(str, length);
 	item->length = length;
 
 	// Yes a const cast! D:
 	char *store = (char *)item->c_str;
-	for (size_t i = 0; i < length; i++) {
-		store[i] = str[i];
-	}
+	memcpy(store, str, length);
 	store[length] = '\0';
 
 	// Insert and return.
 	ret = u_hashset_insert_item(inst->path_store, item);
 	if (ret) {
-		free(path);
 		return oxr_error(log, XR_ERROR_RUNTIME_FAILURE, "Failed to insert item");
 	}
 
@@ -137,7 +176,8 @@ oxr_allocate_path(
 struct oxr_path *
 get_path_or_null(struct oxr_logger *log, struct oxr_instance *inst, XrPath xr_path)
 {
-	if (xr_path >= inst->path_array_length) {
+	// Slots past path_num have not been written yet.
+	if (xr_path == XR_NULL_PATH || xr_path >= inst->path_num) {
 		return NULL;
 	}
 
@@ -227,14 +267,6 @@ oxr_path_get_string(
 	return XR_SUCCESS;
 }
 
-void
-destroy_callback(struct u_hashset_item *item, void *priv)
-{
-	struct oxr_path *path = from_item(item);
-
-	free(path);
-}
-
 XrResult
 oxr_path_init(struct oxr_logger *log, struct oxr_instance *inst)
 {
@@ -262,10 +294,14 @@ oxr_path_destroy(struct oxr_logger *log, struct oxr_instance *inst)
 	inst->path_num = 0;
 	inst->path_array_length = 0;
 
-	if (inst->path_store == NULL) {
-		return;
+	if (inst->path_store != NULL) {
+		u_hashset_destroy(&inst->path_store);
 	}
 
-	u_hashset_clear_and_call_for_each(inst->path_store, destroy_callback, inst);
-	u_hashset_destroy(&inst->path_store);
+	// All paths are freed with their chunks.
+	while (inst->path_chunks != NULL) {
+		struct oxr_path_chunk *chunk = inst->path_chunks;
+		inst->path_chunks = chunk->next;
+		free(chunk);
+	}
 }
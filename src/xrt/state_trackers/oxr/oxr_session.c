@@ -25,6 +25,7 @@
 #include "util/u_debug.h"
 #include "util/u_misc.h"
 #include "util/u_time.h"
+#include "util/u_var.h"
 #include "util/u_verify.h"
 
 #include "math/m_api.h"
@@ -49,6 +50,8 @@
 DEBUG_GET_ONCE_NUM_OPTION(ipd, "OXR_DEBUG_IPD_MM", 63)
 DEBUG_GET_ONCE_NUM_OPTION(wait_frame_sleep, "OXR_DEBUG_WAIT_FRAME_EXTRA_SLEEP_MS", 0)
 DEBUG_GET_ONCE_BOOL_OPTION(frame_timing_spew, "OXR_FRAME_TIMING_SPEW", false)
+DEBUG_GET_ONCE_BOOL_OPTION(pose_cache, "OXR_POSE_CACHE", true)
+DEBUG_GET_ONCE_BOOL_OPTION(incremental_action_sync, "OXR_INCREMENTAL_ACTION_SYNC", true)
 
 #define CALL_CHK(call)                                                                                                 \
 	if ((call) == XRT_ERROR_IPC_FAILURE) {                                                                         \
@@ -359,6 +362,10 @@ oxr_session_locate_views(struct oxr_logger *log,
 	m_relation_chain_push_pose_if_not_identity(&xrc, &xdev->tracking_origin->offset);
 	m_relation_chain_resolve(&xrc, &pure_head_relation);
 
+	// Spaces located at the display time, VIEW and LOCAL, can reuse it.
+	oxr_pose_cache_insert(&sess->pose_cache, xdev, XRT_INPUT_GENERIC_HEAD_POSE, viewLocateInfo->displayTime,
+	                      &pure_head_relation);
+
 	// Clear here and filled in loop.
 	viewState->viewStateFlags = 0;
 
@@ -484,6 +491,9 @@ oxr_session_frame_wait(struct oxr_logger *log, struct oxr_session *sess, XrFrame
 	//! more than one session per instance.
 	XRT_MAYBE_UNUSED timepoint_ns now = time_state_get_now_and_update(sess->sys->inst->timekeeping);
 
+	// New frame, devices might have new data for old times too.
+	oxr_pose_cache_invalidate(&sess->pose_cache);
+
 	struct xrt_compositor *xc = sess->compositor;
 	if (xc == NULL) {
 		frameState->shouldRender = XR_FALSE;
@@ -599,6 +609,8 @@ oxr_session_destroy(struct oxr_logger *log, struct oxr_handle_base *hb)
 
 	XrResult ret = oxr_event_remove_session_events(log, sess);
 
+	u_var_remove_root((void *)sess);
+
 	for (size_t i = 0; i < sess->action_set_attachment_count; ++i) {
 		oxr_action_set_attachment_teardown(&sess->act_set_attachments[i]);
 	}
@@ -619,6 +631,8 @@ oxr_session_destroy(struct oxr_logger *log, struct oxr_handle_base *hb)
 	os_precise_sleeper_deinit(&sess->sleeper);
 	os_semaphore_destroy(&sess->sem);
 	os_mutex_destroy(&sess->active_wait_frames_lock);
+	oxr_pose_cache_fini(&sess->pose_cache);
+	free(sess->action_sync.action_sets);
 
 	free(sess);
 
@@ -648,6 +662,19 @@ oxr_session_allocate_and_init(struct oxr_logger *log, struct oxr_system *sys, st
 	sess->frame_timing_spew = debug_get_bool_option_frame_timing_spew();
 	sess->frame_timing_wait_sleep_ms = debug_get_num_option_wait_frame_sleep();
 
+	// Device relations shared by all spaces located in a frame.
+	oxr_pose_cache_init(&sess->pose_cache, debug_get_bool_option_pose_cache());
+
+	u_var_add_root((void *)sess, "XrSession", true);
+	u_var_add_bool((void *)sess, &sess->pose_cache.enabled, "Pose cache enabled");
+	u_var_add_ro_u64((void *)sess, &sess->pose_cache.hits, "Pose cache hits");
+	u_var_add_ro_u64((void *)sess, &sess->pose_cache.misses, "Pose cache misses");
+
+	sess->action_sync.incremental = debug_get_bool_option_incremental_action_sync();
+	u_var_add_bool((void *)sess, &sess->action_sync.incremental, "Incremental action sync");
+	u_var_add_ro_u64((void *)sess, &sess->action_sync.cache_updates, "Action cache updates");
+	u_var_add_ro_u64((void *)sess, &sess->action_sync.cache_skips, "Action cache skips");
+
 	// Action system hashmaps.
 	u_hashmap_int_create(&sess->act_sets_attachments_by_key);
 	u_hashmap_int_create(&sess->act_attachments_by_key);
@@ -117,7 +117,8 @@ set_up_local_space(struct oxr_logger *log, struct oxr_session *sess, XrTime time
 {
 	struct xrt_device *head_xdev = GET_XDEV_BY_ROLE(sess->sys, head);
 	struct xrt_space_relation head_relation;
-	oxr_xdev_get_space_relation(log, sess->sys->inst, head_xdev, XRT_INPUT_GENERIC_HEAD_POSE, time, &head_relation);
+	oxr_xdev_get_space_relation_cached(log, sess->sys->inst, &sess->pose_cache, head_xdev,
+	                                   XRT_INPUT_GENERIC_HEAD_POSE, time, &head_relation);
 
 	if ((head_relation.relation_flags & XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT) == 0) {
 		return false;
@@ -177,8 +178,8 @@ oxr_space_ref_get_pure_relation(struct oxr_logger *log,
 		return true;
 	}
 	case OXR_SPACE_TYPE_REFERENCE_VIEW: {
-		oxr_xdev_get_space_relation(log, sess->sys->inst, ref_xdev, XRT_INPUT_GENERIC_HEAD_POSE, time,
-		                            out_relation);
+		oxr_xdev_get_space_relation_cached(log, sess->sys->inst, &sess->pose_cache, ref_xdev,
+		                                   XRT_INPUT_GENERIC_HEAD_POSE, time, out_relation);
 		return true;
 	}
 
@@ -287,8 +288,8 @@ oxr_space_get_pure_relation(struct oxr_logger *log,
 		}
 
 		*out_xdev = input->xdev;
-		oxr_xdev_get_space_relation(log, spc->sess->sys->inst, input->xdev, input->input->name, time,
-		                            out_relation);
+		oxr_xdev_get_space_relation_cached(log, spc->sess->sys->inst, &spc->sess->pose_cache, input->xdev,
+		                                   input->input->name, time, out_relation);
 
 		return true;
 	}
@@ -130,3 +130,122 @@ oxr_xdev_get_space_relation(struct oxr_logger *log,
 	oxr_xdev_get_relation_chain(log, inst, xdev, name, at_time, &xrc);
 	m_relation_chain_resolve(&xrc, out_relation);
 }
+
+
+/*
+ *
+ * Pose cache.
+ *
+ */
+
+static struct oxr_pose_cache_entry *
+pose_cache_find(struct oxr_pose_cache *cache, struct xrt_device *xdev, enum xrt_input_name name, XrTime at_time)
+{
+	for (uint32_t i = 0; i < cache->entry_count; i++) {
+		struct oxr_pose_cache_entry *e = &cache->entries[i];
+		if (e->xdev == xdev && e->name == name && e->at_time == at_time) {
+			return e;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+pose_cache_insert_locked(struct oxr_pose_cache *cache,
+                         struct xrt_device *xdev,
+                         enum xrt_input_name name,
+                         XrTime at_time,
+                         const struct xrt_space_relation *relation)
+{
+	struct oxr_pose_cache_entry *e = pose_cache_find(cache, xdev, name, at_time);
+
+	if (e == NULL && cache->entry_count < OXR_POSE_CACHE_SIZE) {
+		e = &cache->entries[cache->entry_count++];
+	} else if (e == NULL) {
+		e = &cache->entries[cache->next];
+		cache->next = (cache->next + 1) % OXR_POSE_CACHE_SIZE;
+	}
+
+	e->xdev = xdev;
+	e->name = name;
+	e->at_time = at_time;
+	e->relation = *relation;
+}
+
+void
+oxr_pose_cache_init(struct oxr_pose_cache *cache, bool enabled)
+{
+	U_ZERO(cache);
+	os_mutex_init(&cache->mutex);
+	cache->enabled = enabled;
+}
+
+void
+oxr_pose_cache_fini(struct oxr_pose_cache *cache)
+{
+	os_mutex_destroy(&cache->mutex);
+}
+
+void
+oxr_pose_cache_invalidate(struct oxr_pose_cache *cache)
+{
+	os_mutex_lock(&cache->mutex);
+	cache->entry_count = 0;
+	cache->next = 0;
+	cache->generation++;
+	os_mutex_unlock(&cache->mutex);
+}
+
+void
+oxr_pose_cache_insert(struct oxr_pose_cache *cache,
+                      struct xrt_device *xdev,
+                      enum xrt_input_name name,
+                      XrTime at_time,
+                      const struct xrt_space_relation *relation)
+{
+	if (!cache->enabled) {
+		return;
+	}
+
+	os_mutex_lock(&cache->mutex);
+	pose_cache_insert_locked(cache, xdev, name, at_time, relation);
+	os_mutex_unlock(&cache->mutex);
+}
+
+void
+oxr_xdev_get_space_relation_cached(struct oxr_logger *log,
+                                   struct oxr_instance *inst,
+                                   struct oxr_pose_cache *cache,
+                                   struct xrt_device *xdev,
+                                   enum xrt_input_name name,
+                                   XrTime at_time,
+                                   struct xrt_space_relation *out_relation)
+{
+	if (!cache->enabled) {
+		oxr_xdev_get_space_relation(log, inst, xdev, name, at_time, out_relation);
+		return;
+	}
+
+	os_mutex_lock(&cache->mutex);
+	struct oxr_pose_cache_entry *e = pose_cache_find(cache, xdev, name, at_time);
+	if (e != NULL) {
+		*out_relation = e->relation;
+		cache->hits++;
+		os_mutex_unlock(&cache->mutex);
+		return;
+	}
+	cache->misses++;
+	uint64_t generation = cache->generation;
+	os_mutex_unlock(&cache->mutex);
+
+	// Don't hold the lock while the device predicts, or over IPC.
+	oxr_xdev_get_space_relation(log, inst, xdev, name, at_time, out_relation);
+
+	// Invalidated meanwhile, the relation might be older than the new device data.
+	os_mutex_lock(&cache->mutex);
+	if (cache->generation == generation) {
+		pose_cache_insert_locked(cache, xdev, name, at_time, out_relation);
+	}
+	os_mutex_unlock(&cache->mutex);
+}
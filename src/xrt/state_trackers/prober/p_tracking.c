@@ -22,6 +22,8 @@
 #include "util/u_var.h"
 #include "util/u_misc.h"
 #include "util/u_sink.h"
+#include "util/u_frame_pool.h"
+#include "util/u_worker.h"
 #include "util/u_config_json.h"
 #include "p_prober.h"
 
@@ -180,11 +182,17 @@ p_factory_ensure_frameserver(struct p_factory *fact)
 	fact->xtmv[0]->origin = &fact->origin;
 	fact->xtmv[1]->origin = &fact->origin;
 
-	// We create the default multi-channel hsv filter.
+	// We create the default multi-channel hsv filter, filtering row bands in parallel if frames are split.
 	struct t_hsv_filter_params params = T_HSV_DEFAULT_PARAMS();
-	t_hsv_filter_create(&fact->xfctx, &params, xsinks, &xsink);
+	struct u_worker_thread_pool *uwtp = NULL;
+	if (t_hsv_filter_get_band_count() > 1) {
+		uwtp = u_worker_thread_pool_create(2, 3);
+	}
+	t_hsv_filter_create_threaded(&fact->xfctx, &params, uwtp, xsinks, &xsink);
+	u_worker_thread_pool_reference(&uwtp, NULL);
 
-	// The filter only supports yuv or yuyv formats.
+	// The filter only supports yuv or yuyv formats, recycle the converted frames.
+	u_frame_pool_create_for_context(&fact->xfctx);
 	u_sink_create_to_yuv_or_yuyv(&fact->xfctx, xsink, &xsink);
 
 	// Put a queue before it to multi-thread the filter.
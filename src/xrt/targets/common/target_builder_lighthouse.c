@@ -20,6 +20,7 @@
 #include "util/u_debug.h"
 #include "util/u_device.h"
 #include "util/u_sink.h"
+#include "util/u_frame_pool.h"
 #include "util/u_system_helpers.h"
 
 #include "target_builder_interface.h"
@@ -410,6 +411,9 @@ valve_index_setup_visual_trackers(struct lighthouse_system *lhs,
 	struct xrt_frame_sink *entry_sbs_sink = NULL;
 	bool old_rgb_ht = debug_get_bool_option_ht_use_old_rgb();
 
+	// Recycle the frames of the format converters.
+	u_frame_pool_create_for_context(&lhs->devices->xfctx);
+
 	if (slam_enabled && hand_enabled && !old_rgb_ht) {
 		u_sink_split_create(&lhs->devices->xfctx, slam_sinks->left, hand_sinks->left, &entry_left_sink);
 		u_sink_split_create(&lhs->devices->xfctx, slam_sinks->right, hand_sinks->right, &entry_right_sink);
@@ -15,6 +15,8 @@
 #include "xrt/xrt_frameserver.h"
 
 #include "util/u_sink.h"
+#include "util/u_frame_pool.h"
+#include "util/u_worker.h"
 #include "util/u_misc.h"
 #include "util/u_device.h"
 #include "util/u_logging.h"
@@ -141,11 +143,17 @@ setup_pipeline(struct xrt_prober *xp, struct build_state *build)
 	build->psmv_red->origin = build->origin;
 	build->psmv_purple->origin = build->origin;
 
-	// We create the default multi-channel hsv filter.
+	// We create the default multi-channel hsv filter, filtering row bands in parallel if frames are split.
 	struct t_hsv_filter_params params = T_HSV_DEFAULT_PARAMS();
-	t_hsv_filter_create(build->xfctx, &params, xsinks, &xsink);
+	struct u_worker_thread_pool *uwtp = NULL;
+	if (t_hsv_filter_get_band_count() > 1) {
+		uwtp = u_worker_thread_pool_create(2, 3);
+	}
+	t_hsv_filter_create_threaded(build->xfctx, &params, uwtp, xsinks, &xsink);
+	u_worker_thread_pool_reference(&uwtp, NULL);
 
-	// The filter only supports yuv or yuyv formats.
+	// The filter only supports yuv or yuyv formats, recycle the converted frames.
+	u_frame_pool_create_for_context(build->xfctx);
 	u_sink_create_to_yuv_or_yuyv(build->xfctx, xsink, &xsink);
 
 	// Put a queue before it to multi-thread the filter.
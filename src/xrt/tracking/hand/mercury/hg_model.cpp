@@ -690,19 +690,9 @@ make_keypoint_heatmap_output(int camera_idx, int hand_idx, int grid_pt_x, int gr
 }
 
 
-void
-run_keypoint_estimation_new(void *ptr)
+static void
+crop_keypoint_input(keypoint_estimation_run_info *info, float *input)
 {
-	XRT_TRACE_MARKER();
-	keypoint_estimation_run_info *info = (keypoint_estimation_run_info *)ptr;
-
-	onnx_wrap *wrap = &info->view->keypoint[info->hand_idx];
-	struct HandTracking *hgt = info->view->hgt;
-
-	// Factor out starting here
-
-	cv::Mat &debug = info->view->debug_out_to_this;
-
 	hand_bounding_box *output = &info->view->bboxes_this_frame[info->hand_idx];
 
 	cv::Point2f src_tri[3];
@@ -724,38 +714,23 @@ run_keypoint_estimation_new(void *ptr)
 	dst_tri[2] = {128, 0};
 
 	cv::Matx23f go_there = getAffineTransform(src_tri, dst_tri);
-	cv::Matx23f go_back = getAffineTransform(dst_tri, src_tri);
-
-	cv::Mat data_128x128_uint8;
-
-	{
-		XRT_TRACE_IDENT(transforms);
-
-		cv::warpAffine(info->view->run_model_on_this, data_128x128_uint8, go_there, cv::Size(128, 128),
-		               cv::INTER_LINEAR);
+	info->go_back = getAffineTransform(dst_tri, src_tri);
 
-		cv::Mat data_128x128_float(cv::Size(128, 128), CV_32FC1, wrap->data, 128 * sizeof(float));
-
-		normalizeGrayscaleImage(data_128x128_uint8, data_128x128_float);
-	}
-
-	// Ending here
-
-	const char *output_names[2] = {"heatmap"};
-
-	OrtValue *output_tensor = nullptr;
+	XRT_TRACE_IDENT(transforms);
 
-	{
-		XRT_TRACE_IDENT(model);
-		ORT(Run(wrap->session, nullptr, &wrap->input_name, &wrap->tensor, 1, output_names, 1, &output_tensor));
-	}
+	cv::warpAffine(info->view->run_model_on_this, info->crop, go_there, cv::Size(128, 128), cv::INTER_LINEAR);
 
-	// To here
+	cv::Mat data_128x128_float(cv::Size(128, 128), CV_32FC1, input, 128 * sizeof(float));
 
-	float *out_data = nullptr;
+	normalizeGrayscaleImage(info->crop, data_128x128_float);
+}
 
+static void
+decode_keypoint_output(keypoint_estimation_run_info *info, float *out_data)
+{
+	struct HandTracking *hgt = info->view->hgt;
 
-	ORT(GetTensorMutableData(output_tensor, (void **)&out_data));
+	cv::Mat &debug = info->view->debug_out_to_this;
 
 	Hand2D &px_coord = info->view->keypoint_outputs[info->hand_idx].hand_px_coord;
 	Hand2D &tan_space = info->view->keypoint_outputs[info->hand_idx].hand_tan_space;
@@ -778,7 +753,7 @@ run_keypoint_estimation_new(void *ptr)
 		loc.x *= 128.0f / 22.0f;
 		loc.y *= 128.0f / 22.0f;
 
-		loc = transformVecBy2x3(loc, go_back);
+		loc = transformVecBy2x3(loc, info->go_back);
 
 		confidences[i] = data[out_idx];
 		px_coord.kps[i] = loc;
@@ -794,7 +769,7 @@ run_keypoint_estimation_new(void *ptr)
 
 		cv::Rect p = cv::Rect(root_x, root_y, 128, 128);
 
-		data_128x128_uint8.copyTo(hgt->visualizers.mat(p));
+		info->crop.copyTo(hgt->visualizers.mat(p));
 
 		make_keypoint_heatmap_output(info->view->view, info->hand_idx, 0, 0,
 		                             out_data + (data_acc_idx * plane_size), hgt->visualizers.mat);
@@ -830,13 +805,204 @@ run_keypoint_estimation_new(void *ptr)
 			}
 		}
 	}
+}
+
+void
+run_keypoint_estimation_new(void *ptr)
+{
+	XRT_TRACE_MARKER();
+	keypoint_estimation_run_info *info = (keypoint_estimation_run_info *)ptr;
+
+	onnx_wrap *wrap = &info->view->keypoint[info->hand_idx];
+	struct HandTracking *hgt = info->view->hgt;
+
+	crop_keypoint_input(info, wrap->data);
+
+	const char *output_names[2] = {"heatmap"};
+
+	OrtValue *output_tensor = nullptr;
+
+	{
+		XRT_TRACE_IDENT(model);
+		ORT(Run(wrap->session, nullptr, &wrap->input_name, &wrap->tensor, 1, output_names, 1, &output_tensor));
+	}
+
+	float *out_data = nullptr;
+
+	ORT(GetTensorMutableData(output_tensor, (void **)&out_data));
+
+	decode_keypoint_output(info, out_data);
 
 	wrap->api->ReleaseValue(output_tensor);
 }
 
+/*
+ *
+ * Batched keypoint estimation.
+ *
+ */
+
+static const char *keypoint_batch_input_name = "inputImg";
+static const char *keypoint_batch_output_name = "heatmap";
+static const size_t keypoint_batch_input_floats = 1 * 128 * 128;
+static const size_t keypoint_batch_output_floats = 21 * 22 * 22;
+
+void
+init_keypoint_batch(HandTracking *hgt, keypoint_batch *wrap, int num_threads)
+{
+	std::filesystem::path path = hgt->models_folder;
+
+	path /= "grayscale_keypoint_new.onnx";
+
+	wrap->api = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+
+	OrtSessionOptions *opts = nullptr;
+	ORT(CreateSessionOptions(&opts));
+
+	ORT(SetSessionGraphOptimizationLevel(opts, ORT_ENABLE_ALL));
+	// Takes the place of the crops running in parallel on the pool.
+	ORT(SetIntraOpNumThreads(opts, num_threads));
+
+	ORT(CreateEnv(ORT_LOGGING_LEVEL_FATAL, "monado_ht", &wrap->env));
+
+	ORT(CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &wrap->meminfo));
+
+	ORT(CreateSession(wrap->env, path.c_str(), opts, &wrap->session));
+	assert(wrap->session != NULL);
+
+	wrap->api->ReleaseSessionOptions(opts);
+
+	// Older exports of the model have the batch size baked in.
+	OrtTypeInfo *type_info = nullptr;
+	const OrtTensorTypeAndShapeInfo *tensor_info = nullptr;
+	int64_t dims[4] = {};
+	size_t num_dims = 0;
+
+	ORT(SessionGetInputTypeInfo(wrap->session, 0, &type_info));
+	ORT(CastTypeInfoToTensorInfo(type_info, &tensor_info));
+	ORT(GetDimensionsCount(tensor_info, &num_dims));
+	if (num_dims == 4) {
+		ORT(GetDimensions(tensor_info, dims, 4));
+	}
+	wrap->api->ReleaseTypeInfo(type_info);
+
+	if (num_dims != 4 || dims[0] > 0) {
+		HG_INFO(hgt, "Keypoint model has a fixed batch size, not batching crops.");
+		return;
+	}
+
+	wrap->input_data = (float *)malloc(HG_MAX_KEYPOINT_BATCH * keypoint_batch_input_floats * sizeof(float));
+	wrap->output_data = (float *)malloc(HG_MAX_KEYPOINT_BATCH * keypoint_batch_output_floats * sizeof(float));
+
+	for (int i = 0; i < HG_MAX_KEYPOINT_BATCH; i++) {
+		int64_t count = i + 1;
+		int64_t input_shape[4] = {count, 1, 128, 128};
+		int64_t output_shape[4] = {count, 21, 22, 22};
+
+		ORT(CreateTensorWithDataAsOrtValue(wrap->meminfo,                                       //
+		                                   wrap->input_data,                                    //
+		                                   count * keypoint_batch_input_floats * sizeof(float), //
+		                                   input_shape,                                         //
+		                                   4,                                                   //
+		                                   ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT,                 //
+		                                   &wrap->input_tensors[i]));
+		ORT(CreateTensorWithDataAsOrtValue(wrap->meminfo,                                        //
+		                                   wrap->output_data,                                    //
+		                                   count * keypoint_batch_output_floats * sizeof(float), //
+		                                   output_shape,                                         //
+		                                   4,                                                    //
+		                                   ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT,                  //
+		                                   &wrap->output_tensors[i]));
+	}
+
+	ORT(CreateIoBinding(wrap->session, &wrap->binding));
+
+	wrap->supported = true;
+}
+
+void
+keypoint_batch_add(keypoint_batch *wrap, keypoint_estimation_run_info *info)
+{
+	assert(wrap->count < HG_MAX_KEYPOINT_BATCH);
+
+	int idx = wrap->count++;
+	info->input = wrap->input_data + idx * keypoint_batch_input_floats;
+	info->output = wrap->output_data + idx * keypoint_batch_output_floats;
+	wrap->infos[idx] = info;
+}
+
+void
+run_keypoint_batch_crop(void *ptr)
+{
+	XRT_TRACE_MARKER();
+	keypoint_estimation_run_info *info = (keypoint_estimation_run_info *)ptr;
+
+	crop_keypoint_input(info, info->input);
+}
+
+void
+run_keypoint_batch(HandTracking *hgt, keypoint_batch *wrap)
+{
+	XRT_TRACE_MARKER();
+
+	if (wrap->count == 0) {
+		return;
+	}
+
+	// Only rebind when the number of hands changes, which is rare.
+	if (wrap->bound_count != wrap->count) {
+		wrap->api->ClearBoundInputs(wrap->binding);
+		wrap->api->ClearBoundOutputs(wrap->binding);
+		ORT(BindInput(wrap->binding, keypoint_batch_input_name, wrap->input_tensors[wrap->count - 1]));
+		ORT(BindOutput(wrap->binding, keypoint_batch_output_name, wrap->output_tensors[wrap->count - 1]));
+		wrap->bound_count = wrap->count;
+	}
+
+	ORT(RunWithBinding(wrap->session, nullptr, wrap->binding));
+}
+
+void
+run_keypoint_batch_decode(void *ptr)
+{
+	XRT_TRACE_MARKER();
+	keypoint_estimation_run_info *info = (keypoint_estimation_run_info *)ptr;
+
+	decode_keypoint_output(info, info->output);
+}
+
+void
+release_keypoint_batch(keypoint_batch *wrap)
+{
+	if (wrap->api == nullptr) {
+		return;
+	}
+
+	for (int i = 0; i < HG_MAX_KEYPOINT_BATCH; i++) {
+		if (wrap->input_tensors[i] != nullptr) {
+			wrap->api->ReleaseValue(wrap->input_tensors[i]);
+		}
+		if (wrap->output_tensors[i] != nullptr) {
+			wrap->api->ReleaseValue(wrap->output_tensors[i]);
+		}
+	}
+	if (wrap->binding != nullptr) {
+		wrap->api->ReleaseIoBinding(wrap->binding);
+	}
+	wrap->api->ReleaseMemoryInfo(wrap->meminfo);
+	wrap->api->ReleaseSession(wrap->session);
+	wrap->api->ReleaseEnv(wrap->env);
+	free(wrap->input_data);
+	free(wrap->output_data);
+}
+
 void
 release_onnx_wrap(onnx_wrap *wrap)
 {
+	// Not created when batching, see init_keypoint_batch.
+	if (wrap->api == nullptr) {
+		return;
+	}
+
 	wrap->api->ReleaseMemoryInfo(wrap->meminfo);
 	wrap->api->ReleaseSession(wrap->session);
 	wrap->api->ReleaseValue(wrap->tensor);
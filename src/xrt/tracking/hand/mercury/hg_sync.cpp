@@ -15,6 +15,7 @@
 #include "math/m_vec2.h"
 #include "util/u_misc.h"
 #include "xrt/xrt_frame.h"
+#include "os/os_time.h"
 
 
 #include <numeric>
@@ -25,6 +26,8 @@ namespace xrt::tracking::hand::mercury {
 
 DEBUG_GET_ONCE_LOG_OPTION(mercury_log, "MERCURY_LOG", U_LOGGING_WARN)
 DEBUG_GET_ONCE_BOOL_OPTION(mercury_use_simdr_keypoint, "MERCURY_USE_SIMDR_KEYPOINT", false)
+DEBUG_GET_ONCE_BOOL_OPTION(mercury_pipelined, "MERCURY_PIPELINED", false)
+DEBUG_GET_ONCE_BOOL_OPTION(mercury_batch_keypoints, "MERCURY_BATCH_KEYPOINTS", false)
 
 // Flags to tell state tracker that these are indeed valid joints
 static const enum xrt_space_relation_flags valid_flags_ht = (enum xrt_space_relation_flags)(
@@ -562,6 +565,239 @@ predict_new_regions_of_interest(struct HandTracking *hgt)
 	}
 }
 
+static float
+ns_to_ms_f(uint64_t start_ns, uint64_t end_ns)
+{
+	return (float)time_ns_to_ms_f((time_duration_ns)(end_ns - start_ns));
+}
+
+/*!
+ * Gather what the kinematic optimizers need from the keypoint model outputs
+ * of this frame, and do the hand size bookkeeping that comes before them.
+ */
+void
+prepare_kinematics(struct HandTracking *hgt, struct kinematic_frame *kf, bool pipelined)
+{
+	kf->hgt = hgt;
+	kf->timestamp = hgt->current_frame_timestamp;
+	kf->valid = true;
+	kf->use_ccdik = hgt->tuneable_values.use_ccdik;
+	kf->scribble = !pipelined && hgt->tuneable_values.scribble_optimizer_outputs && hgt->debug_scribble;
+
+	// Spaghetti logic for optimizing hand size
+	bool any_hands_are_only_visible_in_one_view = false;
+
+	for (int hand_idx = 0; hand_idx < 2; hand_idx++) {
+		any_hands_are_only_visible_in_one_view =                //
+		    any_hands_are_only_visible_in_one_view ||           //
+		    (hgt->views[0].bboxes_this_frame[hand_idx].found != //
+		     hgt->views[1].bboxes_this_frame[hand_idx].found);
+	}
+
+	constexpr float mul_max = 1.0;
+	constexpr float frame_max = 100;
+	bool optimize_hand_size;
+
+	if ((hgt->refinement.hand_size_refinement_schedule_x > frame_max)) {
+		hgt->refinement.hand_size_refinement_schedule_y = mul_max;
+		optimize_hand_size = false;
+	} else {
+		hgt->refinement.hand_size_refinement_schedule_y =
+		    powf((hgt->refinement.hand_size_refinement_schedule_x / frame_max), 2) * mul_max;
+		optimize_hand_size = true;
+	}
+
+	if (any_hands_are_only_visible_in_one_view) {
+		optimize_hand_size = false;
+	}
+
+
+	// if either hand was not visible before the last new-user event but is visible now, reset the schedule
+	// a bit.
+	if ((hgt->this_frame_hand_detected[0] && !hgt->hand_seen_before[0]) ||
+	    (hgt->this_frame_hand_detected[1] && !hgt->hand_seen_before[1])) {
+		hgt->refinement.hand_size_refinement_schedule_x =
+		    std::min(hgt->refinement.hand_size_refinement_schedule_x, frame_max / 2);
+	}
+
+	kf->any_hands_are_only_visible_in_one_view = any_hands_are_only_visible_in_one_view;
+	kf->optimize_hand_size = optimize_hand_size;
+	kf->hand_size_refinement_schedule_y = hgt->refinement.hand_size_refinement_schedule_y;
+	kf->target_hand_size = hgt->target_hand_size;
+
+	for (int hand_idx = 0; hand_idx < 2; hand_idx++) {
+		kf->detected[hand_idx] = hgt->this_frame_hand_detected[hand_idx];
+		kf->first_frame[hand_idx] = !hgt->last_frame_hand_detected[hand_idx];
+		kf->hands[hand_idx] = {};
+		kf->have_hand_size[hand_idx] = false;
+		kf->confidence[hand_idx] = 0.0f;
+
+		if (!kf->detected[hand_idx]) {
+			continue;
+		}
+
+		one_frame_input &input = kf->inputs[hand_idx];
+
+		for (int view = 0; view < 2; view++) {
+			keypoint_output *from_model = &hgt->views[view].keypoint_outputs[hand_idx];
+			input.views[view].active = hgt->views[view].bboxes_this_frame[hand_idx].found;
+			if (!input.views[view].active) {
+				continue;
+			}
+			for (int i = 0; i < 21; i++) {
+				input.views[view].confidences[i] = from_model->hand_tan_space.confidences[i];
+				// std::cout << input.views[view].confidences[i] << std::endl;
+				input.views[view].rays[i] = correct_direction(from_model->hand_tan_space.kps[i]);
+			}
+		}
+	}
+}
+
+/*!
+ * Run the kinematic optimizers, only touches the @ref kinematic_frame and the
+ * optimizers themselves so it can run on a worker thread.
+ */
+void
+run_kinematics(void *ptr)
+{
+	XRT_TRACE_MARKER();
+
+	struct kinematic_frame *kf = (struct kinematic_frame *)ptr;
+	struct HandTracking *hgt = kf->hgt;
+
+	uint64_t start_ns = os_monotonic_get_ns();
+
+	// Dispatch the optimizers!
+	for (int hand_idx = 0; hand_idx < 2; hand_idx++) {
+		if (!kf->detected[hand_idx]) {
+			continue;
+		}
+
+		one_frame_input &input = kf->inputs[hand_idx];
+		struct xrt_hand_joint_set *put_in_set = &kf->hands[hand_idx];
+
+		if (__builtin_expect(!kf->use_ccdik, true)) {
+			lm::KinematicHandLM *hand = hgt->kinematic_hands[hand_idx];
+
+			//!@todo
+			// ABOUT TWO MINUTES OF THOUGHT WERE PUT INTO THIS VALUE
+			float reprojection_error_threshold = 0.35f;
+
+			float out_hand_size;
+
+			//!@optimize We can have one of these on each thread
+			float reprojection_error;
+			lm::optimizer_run(hand,                                 //
+			                  input,                                //
+			                  kf->first_frame[hand_idx],            //
+			                  kf->optimize_hand_size,               //
+			                  kf->target_hand_size,                 //
+			                  kf->hand_size_refinement_schedule_y, //
+			                  *put_in_set,                          //
+			                  out_hand_size,                        //
+			                  reprojection_error);
+
+			kf->hand_size[hand_idx] = out_hand_size;
+			kf->have_hand_size[hand_idx] = true;
+
+			if (reprojection_error > reprojection_error_threshold) {
+				HG_DEBUG(hgt, "Reprojection error above threshold!");
+				kf->detected[hand_idx] = false;
+
+				continue;
+			}
+			if (!kf->any_hands_are_only_visible_in_one_view) {
+				kf->confidence[hand_idx] = hand_confidence_value(reprojection_error, input);
+			}
+
+		} else {
+			ccdik::KinematicHandCCDIK *hand = hgt->kinematic_hands_ccdik[hand_idx];
+			if (kf->first_frame[hand_idx]) {
+				ccdik::init_hardcoded_statics(hand, kf->target_hand_size);
+			}
+			ccdik::optimize_new_frame(hand, input, *put_in_set);
+		}
+
+
+
+		u_hand_joints_apply_joint_width(put_in_set);
+
+		// Just debug scribbling - remove this in hard production environment
+		if (kf->scribble) {
+			back_project(hgt, put_in_set, true, NULL, NULL, NULL);
+		}
+
+		put_in_set->hand_pose.pose = hgt->hand_pose_camera_offset;
+		put_in_set->hand_pose.relation_flags = valid_flags_ht;
+	}
+
+	kf->duration_ns = os_monotonic_get_ns() - start_ns;
+}
+
+//! Worker side of the pipelined kinematics, lets the tracking thread wait on just this frame.
+void
+run_kinematics_pipelined(void *ptr)
+{
+	struct kinematic_frame *kf = (struct kinematic_frame *)ptr;
+
+	run_kinematics(kf);
+	os_semaphore_release(&kf->hgt->kinematics_done);
+}
+
+/*!
+ * Take the results of the optimizers and update the tracking state with them,
+ * on the thread calling process.
+ */
+void
+finish_kinematics(struct HandTracking *hgt, struct kinematic_frame *kf, struct xrt_hand_joint_set *out_xrt_hands[2])
+{
+	int num_hands = 0;
+	float avg_hand_size = 0;
+
+	for (int hand_idx = 0; hand_idx < 2; hand_idx++) {
+		if (kf->have_hand_size[hand_idx]) {
+			avg_hand_size += kf->hand_size[hand_idx];
+			num_hands++;
+		}
+
+		hgt->refinement.hand_size_refinement_schedule_x += kf->confidence[hand_idx];
+
+		*out_xrt_hands[hand_idx] = kf->hands[hand_idx];
+
+		if (!kf->detected[hand_idx]) {
+			continue;
+		}
+
+		hgt->histories[hand_idx].hands.push_back(kf->hands[hand_idx]);
+		hgt->histories[hand_idx].timestamps.push_back(kf->timestamp);
+	}
+
+	// More hand-size-optimization spaghetti
+	if (num_hands > 0) {
+		hgt->target_hand_size = (float)avg_hand_size / (float)num_hands;
+	}
+
+	// State tracker tweaks
+	for (int hand_idx = 0; hand_idx < 2; hand_idx++) {
+		hgt->this_frame_hand_detected[hand_idx] = kf->detected[hand_idx];
+		out_xrt_hands[hand_idx]->is_active = hgt->this_frame_hand_detected[hand_idx];
+		hgt->last_frame_hand_detected[hand_idx] = hgt->this_frame_hand_detected[hand_idx];
+
+		hgt->hand_seen_before[hand_idx] =
+		    hgt->hand_seen_before[hand_idx] || hgt->this_frame_hand_detected[hand_idx];
+
+		if (!hgt->last_frame_hand_detected[hand_idx]) {
+			hgt->views[0].bboxes_this_frame[hand_idx].found = false;
+			hgt->views[1].bboxes_this_frame[hand_idx].found = false;
+			hgt->histories[hand_idx].hands.clear();
+			hgt->histories[hand_idx].timestamps.clear();
+		}
+	}
+
+	hgt->stage_timing.kinematics_ms = ns_to_ms_f(0, kf->duration_ns);
+	kf->valid = false;
+}
+
 void
 scribble_image_boundary(struct HandTracking *hgt)
 {
@@ -593,6 +829,7 @@ HandTracking::HandTracking()
 	this->base.destroy = &HandTracking::cCallbackDestroy;
 	u_sink_debug_init(&this->debug_sink_ann);
 	u_sink_debug_init(&this->debug_sink_model);
+	os_semaphore_init(&this->kinematics_done, 0);
 }
 
 HandTracking::~HandTracking()
@@ -611,7 +848,11 @@ HandTracking::~HandTracking()
 	release_onnx_wrap(&this->views[1].keypoint[1]);
 	release_onnx_wrap(&this->views[1].detection);
 
+	release_keypoint_batch(&this->keypoint_batch);
+
+	u_worker_group_reference(&this->kinematics_group, NULL);
 	u_worker_group_reference(&this->group, NULL);
+	os_semaphore_destroy(&this->kinematics_done);
 
 	t_stereo_camera_calibration_reference(&this->calib, NULL);
 
@@ -729,6 +970,18 @@ HandTracking::cCallbackProcess(struct t_hand_tracking_sync *ht_sync,
 		}
 	}
 
+	uint64_t detection_start_ns = os_monotonic_get_ns();
+
+	// Can be changed from the debug UI at any time.
+	bool pipelined = hgt->pipelined;
+
+	// The kinematics of the last frame run alongside the models of this one.
+	struct kinematic_frame *pending = &hgt->kinematic_frames[hgt->pending_kinematic_frame];
+	if (pipelined && pending->valid) {
+		u_worker_group_push(hgt->kinematics_group, run_kinematics_pipelined, pending);
+		hgt->kinematics_in_flight = true;
+	}
+
 	check_new_user_event(hgt);
 
 	// Every now and then if we're not already tracking both hands, try to detect new hands.
@@ -737,7 +990,8 @@ HandTracking::cCallbackProcess(struct t_hand_tracking_sync *ht_sync,
 	}
 	// For already-tracked hands, predict where we think they should be in image space based on the past two
 	// frames. Note that this always happens We want to pose-predict already tracked hands but not mess with
-	// just-detected hands
+	// just-detected hands. When pipelined the last frame is still being worked on, so this predicts from the
+	// two before it.
 	if (!hgt->tuneable_values.always_run_detection_model) {
 		predict_new_regions_of_interest(hgt);
 	}
@@ -751,8 +1005,12 @@ HandTracking::cCallbackProcess(struct t_hand_tracking_sync *ht_sync,
 		}
 	}
 
+	uint64_t keypoints_start_ns = os_monotonic_get_ns();
 
 	// Dispatch keypoint estimator neural nets
+	bool batched = hgt->batch_keypoints && hgt->keypoint_batch.supported;
+	hgt->keypoint_batch.count = 0;
+
 	for (int hand_idx = 0; hand_idx < 2; hand_idx++) {
 		for (int view_idx = 0; view_idx < 2; view_idx++) {
 
@@ -763,157 +1021,67 @@ HandTracking::cCallbackProcess(struct t_hand_tracking_sync *ht_sync,
 			struct keypoint_estimation_run_info &inf = hgt->views[view_idx].run_info[hand_idx];
 			inf.view = &hgt->views[view_idx];
 			inf.hand_idx = hand_idx;
-			u_worker_group_push(hgt->group, hgt->keypoint_estimation_run_func,
-			                    &hgt->views[view_idx].run_info[hand_idx]);
+
+			if (batched) {
+				keypoint_batch_add(&hgt->keypoint_batch, &inf);
+				u_worker_group_push(hgt->group, run_keypoint_batch_crop, &inf);
+			} else {
+				u_worker_group_push(hgt->group, hgt->keypoint_estimation_run_func, &inf);
+			}
 		}
 	}
 	u_worker_group_wait_all(hgt->group);
 
+	// All crops in one go, then read them back out in parallel again.
+	if (batched && hgt->keypoint_batch.count > 0) {
+		run_keypoint_batch(hgt, &hgt->keypoint_batch);
 
-	// Spaghetti logic for optimizing hand size
-	bool any_hands_are_only_visible_in_one_view = false;
-
-	for (int hand_idx = 0; hand_idx < 2; hand_idx++) {
-		any_hands_are_only_visible_in_one_view =                //
-		    any_hands_are_only_visible_in_one_view ||           //
-		    (hgt->views[0].bboxes_this_frame[hand_idx].found != //
-		     hgt->views[1].bboxes_this_frame[hand_idx].found);
+		for (int i = 0; i < hgt->keypoint_batch.count; i++) {
+			u_worker_group_push(hgt->group, run_keypoint_batch_decode, hgt->keypoint_batch.infos[i]);
+		}
+		u_worker_group_wait_all(hgt->group);
 	}
 
-	constexpr float mul_max = 1.0;
-	constexpr float frame_max = 100;
-	bool optimize_hand_size;
+	uint64_t keypoints_end_ns = os_monotonic_get_ns();
 
-	if ((hgt->refinement.hand_size_refinement_schedule_x > frame_max)) {
-		hgt->refinement.hand_size_refinement_schedule_y = mul_max;
-		optimize_hand_size = false;
+	if (!pipelined) {
+		prepare_kinematics(hgt, pending, pipelined);
+		run_kinematics(pending);
+		finish_kinematics(hgt, pending, out_xrt_hands);
+		hgt->stage_timing.waiting_for_kinematics_ms = 0;
 	} else {
-		hgt->refinement.hand_size_refinement_schedule_y =
-		    powf((hgt->refinement.hand_size_refinement_schedule_x / frame_max), 2) * mul_max;
-		optimize_hand_size = true;
-	}
-
-	if (any_hands_are_only_visible_in_one_view) {
-		optimize_hand_size = false;
-	}
-
-
-	// if either hand was not visible before the last new-user event but is visible now, reset the schedule
-	// a bit.
-	if ((hgt->this_frame_hand_detected[0] && !hgt->hand_seen_before[0]) ||
-	    (hgt->this_frame_hand_detected[1] && !hgt->hand_seen_before[1])) {
-		hgt->refinement.hand_size_refinement_schedule_x =
-		    std::min(hgt->refinement.hand_size_refinement_schedule_x, frame_max / 2);
-	}
-
-	int num_hands = 0;
-	float avg_hand_size = 0;
-
-	// Dispatch the optimizers!
-	for (int hand_idx = 0; hand_idx < 2; hand_idx++) {
-		if (!hgt->this_frame_hand_detected[hand_idx]) {
-			continue;
+		// Not u_worker_group_wait_all, it would run the task here if no worker has picked it up yet.
+		if (hgt->kinematics_in_flight) {
+			os_semaphore_wait(&hgt->kinematics_done, 0);
+			hgt->kinematics_in_flight = false;
 		}
+		hgt->stage_timing.waiting_for_kinematics_ms = ns_to_ms_f(keypoints_end_ns, os_monotonic_get_ns());
 
-		one_frame_input input;
+		// This frame goes into the other slot, its kinematics run during the next call.
+		struct kinematic_frame *next = &hgt->kinematic_frames[hgt->pending_kinematic_frame ^ 1];
+		prepare_kinematics(hgt, next, pipelined);
 
-		for (int view = 0; view < 2; view++) {
-			keypoint_output *from_model = &hgt->views[view].keypoint_outputs[hand_idx];
-			input.views[view].active = hgt->views[view].bboxes_this_frame[hand_idx].found;
-			if (!input.views[view].active) {
-				continue;
-			}
-			for (int i = 0; i < 21; i++) {
-				input.views[view].confidences[i] = from_model->hand_tan_space.confidences[i];
-				// std::cout << input.views[view].confidences[i] << std::endl;
-				input.views[view].rays[i] = correct_direction(from_model->hand_tan_space.kps[i]);
-			}
-		}
-
-
-
-		struct xrt_hand_joint_set *put_in_set = out_xrt_hands[hand_idx];
-
-		if (__builtin_expect(!hgt->tuneable_values.use_ccdik, true)) {
-			lm::KinematicHandLM *hand = hgt->kinematic_hands[hand_idx];
-
-			//!@todo
-			// ABOUT TWO MINUTES OF THOUGHT WERE PUT INTO THIS VALUE
-			float reprojection_error_threshold = 0.35f;
-
-			float out_hand_size;
-
-			//!@optimize We can have one of these on each thread
-			float reprojection_error;
-			lm::optimizer_run(hand,                                            //
-			                  input,                                           //
-			                  !hgt->last_frame_hand_detected[hand_idx],        //
-			                  optimize_hand_size,                              //
-			                  hgt->target_hand_size,                           //
-			                  hgt->refinement.hand_size_refinement_schedule_y, //
-			                  *put_in_set,                                     //
-			                  out_hand_size,                                   //
-			                  reprojection_error);
+		if (pending->valid) {
+			finish_kinematics(hgt, pending, out_xrt_hands);
+			*out_timestamp_ns = pending->timestamp;
 
-			avg_hand_size += out_hand_size;
-			num_hands++;
-
-			if (reprojection_error > reprojection_error_threshold) {
-				HG_DEBUG(hgt, "Reprojection error above threshold!");
-				hgt->this_frame_hand_detected[hand_idx] = false;
-
-				continue;
-			}
-			if (!any_hands_are_only_visible_in_one_view) {
-				hgt->refinement.hand_size_refinement_schedule_x +=
-				    hand_confidence_value(reprojection_error, input);
+			// Prepared before the last frame was finished, the optimizers start
+			// over only if the hand was lost in it.
+			for (int hand_idx = 0; hand_idx < 2; hand_idx++) {
+				next->first_frame[hand_idx] = !hgt->last_frame_hand_detected[hand_idx];
 			}
-
 		} else {
-			ccdik::KinematicHandCCDIK *hand = hgt->kinematic_hands_ccdik[hand_idx];
-			if (!hgt->last_frame_hand_detected[hand_idx]) {
-				ccdik::init_hardcoded_statics(hand, hgt->target_hand_size);
-			}
-			ccdik::optimize_new_frame(hand, input, *put_in_set);
+			// Nothing to return yet.
+			out_xrt_hands[0]->is_active = false;
+			out_xrt_hands[1]->is_active = false;
 		}
 
-
-
-		u_hand_joints_apply_joint_width(put_in_set);
-
-		// Just debug scribbling - remove this in hard production environment
-		if (hgt->tuneable_values.scribble_optimizer_outputs && hgt->debug_scribble) {
-			back_project(hgt, put_in_set, true, NULL, NULL, NULL);
-		}
-
-		put_in_set->hand_pose.pose = hgt->hand_pose_camera_offset;
-		put_in_set->hand_pose.relation_flags = valid_flags_ht;
-
-
-		hgt->histories[hand_idx].hands.push_back(*put_in_set);
-		hgt->histories[hand_idx].timestamps.push_back(hgt->current_frame_timestamp);
-	}
-
-	// More hand-size-optimization spaghetti
-	if (num_hands > 0) {
-		hgt->target_hand_size = (float)avg_hand_size / (float)num_hands;
+		hgt->pending_kinematic_frame ^= 1;
 	}
 
-	// State tracker tweaks
-	for (int hand_idx = 0; hand_idx < 2; hand_idx++) {
-		out_xrt_hands[hand_idx]->is_active = hgt->this_frame_hand_detected[hand_idx];
-		hgt->last_frame_hand_detected[hand_idx] = hgt->this_frame_hand_detected[hand_idx];
-
-		hgt->hand_seen_before[hand_idx] =
-		    hgt->hand_seen_before[hand_idx] || hgt->this_frame_hand_detected[hand_idx];
-
-		if (!hgt->last_frame_hand_detected[hand_idx]) {
-			hgt->views[0].bboxes_this_frame[hand_idx].found = false;
-			hgt->views[1].bboxes_this_frame[hand_idx].found = false;
-			hgt->histories[hand_idx].hands.clear();
-			hgt->histories[hand_idx].timestamps.clear();
-		}
-	}
+	hgt->stage_timing.detection_ms = ns_to_ms_f(detection_start_ns, keypoints_start_ns);
+	hgt->stage_timing.keypoints_ms = ns_to_ms_f(keypoints_start_ns, keypoints_end_ns);
+	hgt->stage_timing.total_ms = ns_to_ms_f(detection_start_ns, os_monotonic_get_ns());
 
 	// If the debug UI is active, push to the frame-timing widget
 	u_frame_times_widget_push_sample(&hgt->ft_widget, hgt->current_frame_timestamp);
@@ -1011,6 +1179,8 @@ t_hand_tracking_sync_mercury_create(struct t_stereo_camera_calibration *calib,
 	init_hand_detection(hgt, &hgt->views[0].detection);
 	init_hand_detection(hgt, &hgt->views[1].detection);
 
+	int num_threads = 4;
+
 	if (use_simdr) {
 		init_keypoint_estimation(hgt, &hgt->views[0].keypoint[0]);
 		init_keypoint_estimation(hgt, &hgt->views[0].keypoint[1]);
@@ -1019,20 +1189,32 @@ t_hand_tracking_sync_mercury_create(struct t_stereo_camera_calibration *calib,
 		init_keypoint_estimation(hgt, &hgt->views[1].keypoint[1]);
 		hgt->keypoint_estimation_run_func = xrt::tracking::hand::mercury::run_keypoint_estimation;
 	} else {
-		init_keypoint_estimation_new(hgt, &hgt->views[0].keypoint[0]);
-		init_keypoint_estimation_new(hgt, &hgt->views[0].keypoint[1]);
-
-		init_keypoint_estimation_new(hgt, &hgt->views[1].keypoint[0]);
-		init_keypoint_estimation_new(hgt, &hgt->views[1].keypoint[1]);
 		hgt->keypoint_estimation_run_func = xrt::tracking::hand::mercury::run_keypoint_estimation_new;
+
+		// Off by default until measured against running the crops in parallel on the pool.
+		hgt->batch_keypoints = xrt::tracking::hand::mercury::debug_get_bool_option_mercury_batch_keypoints();
+		if (hgt->batch_keypoints) {
+			init_keypoint_batch(hgt, &hgt->keypoint_batch, num_threads);
+			hgt->batch_keypoints = hgt->keypoint_batch.supported;
+		}
+
+		// The per crop sessions are only needed when not batching.
+		if (!hgt->batch_keypoints) {
+			init_keypoint_estimation_new(hgt, &hgt->views[0].keypoint[0]);
+			init_keypoint_estimation_new(hgt, &hgt->views[0].keypoint[1]);
+
+			init_keypoint_estimation_new(hgt, &hgt->views[1].keypoint[0]);
+			init_keypoint_estimation_new(hgt, &hgt->views[1].keypoint[1]);
+		}
 	}
 
 	hgt->views[0].view = 0;
 	hgt->views[1].view = 1;
 
-	int num_threads = 4;
 	hgt->pool = u_worker_thread_pool_create(num_threads - 1, num_threads);
 	hgt->group = u_worker_group_create(hgt->pool);
+	hgt->kinematics_group = u_worker_group_create(hgt->pool);
+	hgt->pipelined = xrt::tracking::hand::mercury::debug_get_bool_option_mercury_pipelined();
 
 	lm::optimizer_create(hgt->left_in_right, false, hgt->log_level, &hgt->kinematic_hands[0]);
 	lm::optimizer_create(hgt->left_in_right, true, hgt->log_level, &hgt->kinematic_hands[1]);
@@ -1048,6 +1230,15 @@ t_hand_tracking_sync_mercury_create(struct t_stereo_camera_calibration *calib,
 	u_var_add_ro_f32(hgt, &hgt->ft_widget.fps, "FPS!");
 	u_var_add_f32_timing(hgt, hgt->ft_widget.debug_var, "Frame timing!");
 
+	u_var_add_bool(hgt, &hgt->pipelined, "Pipeline kinematics with the next frame");
+	// Fixed at creation, only the sessions for one way are created.
+	u_var_add_ro_text(hgt, hgt->batch_keypoints ? "Yes" : "No", "Run keypoint model once for all hands");
+	u_var_add_ro_f32(hgt, &hgt->stage_timing.detection_ms, "Detection and regions of interest (ms)");
+	u_var_add_ro_f32(hgt, &hgt->stage_timing.keypoints_ms, "Keypoint estimation (ms)");
+	u_var_add_ro_f32(hgt, &hgt->stage_timing.kinematics_ms, "Kinematic optimizers (ms)");
+	u_var_add_ro_f32(hgt, &hgt->stage_timing.waiting_for_kinematics_ms, "Waiting for optimizers (ms)");
+	u_var_add_ro_f32(hgt, &hgt->stage_timing.total_ms, "Whole frame (ms)");
+
 	u_var_add_ro_f32(hgt, &hgt->target_hand_size, "Hand size (Meters between wrist and middle-proximal joint)");
 	u_var_add_ro_f32(hgt, &hgt->refinement.hand_size_refinement_schedule_x, "Schedule (X value)");
 	u_var_add_ro_f32(hgt, &hgt->refinement.hand_size_refinement_schedule_y, "Schedule (Y value)");
@@ -23,6 +23,8 @@
 #include "math/m_vec3.h"
 #include "math/m_mathinclude.h"
 
+#include "os/os_threading.h"
+
 #include "util/u_frame_times_widget.h"
 #include "util/u_logging.h"
 #include "util/u_sink.h"
@@ -124,6 +126,46 @@ struct keypoint_estimation_run_info
 {
 	ht_view *view;
 	bool hand_idx;
+
+	//! Slots in @ref keypoint_batch, only used when batched.
+	float *input;
+	float *output;
+
+	//! From the crop back to the image, kept from cropping to decoding.
+	cv::Matx23f go_back;
+	cv::Mat crop;
+};
+
+//! Two hands in two views.
+#define HG_MAX_KEYPOINT_BATCH 4
+
+/*!
+ * Runs the keypoint model once on all hand crops of a frame. The buffers are
+ * allocated up front, with one input and output tensor per batch size all
+ * pointing into them, bound to the session so nothing is allocated per frame.
+ */
+struct keypoint_batch
+{
+	const OrtApi *api = nullptr;
+	OrtEnv *env = nullptr;
+
+	OrtMemoryInfo *meminfo = nullptr;
+	OrtSession *session = nullptr;
+	OrtIoBinding *binding = nullptr;
+
+	//! The model has a fixed batch size, use the per crop sessions.
+	bool supported = false;
+
+	float *input_data = nullptr;
+	float *output_data = nullptr;
+	OrtValue *input_tensors[HG_MAX_KEYPOINT_BATCH] = {};
+	OrtValue *output_tensors[HG_MAX_KEYPOINT_BATCH] = {};
+
+	//! Batch size the tensors currently bound are for, zero if none.
+	int bound_count = 0;
+
+	int count = 0;
+	keypoint_estimation_run_info *infos[HG_MAX_KEYPOINT_BATCH] = {};
 };
 
 struct ht_view
@@ -172,6 +214,46 @@ struct hand_size_refinement
 	float hand_size_refinement_schedule_y = 0;
 };
 
+/*!
+ * Everything the kinematic optimizers need for one frame and what they give
+ * back, so they can run on a worker thread while the models look at the next
+ * frame when pipelined.
+ */
+struct kinematic_frame
+{
+	HandTracking *hgt;
+
+	uint64_t timestamp;
+
+	//! Has been prepared and not yet finished.
+	bool valid;
+
+	//! The models found the hand, after the optimizer if it was accepted.
+	bool detected[2];
+
+	//! The hand wasn't tracked the frame before, start the optimizer from scratch.
+	bool first_frame[2];
+
+	one_frame_input inputs[2];
+
+	bool any_hands_are_only_visible_in_one_view;
+	bool optimize_hand_size;
+	float hand_size_refinement_schedule_y;
+	float target_hand_size;
+
+	bool use_ccdik;
+
+	//! Draw the optimizer output into the debug image, only when not pipelined.
+	bool scribble;
+
+	// Outputs.
+	xrt_hand_joint_set hands[2];
+	bool have_hand_size[2];
+	float hand_size[2];
+	float confidence[2];
+	uint64_t duration_ns;
+};
+
 struct model_output_visualizers
 {
 	// After setup, these reference the same piece of memory.
@@ -221,6 +303,41 @@ public:
 
 	u_worker_group *group;
 
+	//! Runs the kinematic optimizers alongside @ref group when pipelined.
+	u_worker_group *kinematics_group;
+
+	/*!
+	 * When pipelined the kinematics of a frame run at the same time as the
+	 * models of the next one, and the results of a frame are returned when
+	 * the next one is processed. Never more than two frames in flight. Can
+	 * be toggled at any time, turning it off drops the pending frame.
+	 */
+	bool pipelined = false;
+
+	struct kinematic_frame kinematic_frames[2] = {};
+	int pending_kinematic_frame = 0;
+
+	//! The pending frame has been pushed to @ref kinematics_group and not waited on yet.
+	bool kinematics_in_flight = false;
+
+	//! Released by the worker when the kinematics of the pending frame are done.
+	struct os_semaphore kinematics_done;
+
+	struct keypoint_batch keypoint_batch = {};
+
+	//! Run the keypoint model once for all crops, set at creation with MERCURY_BATCH_KEYPOINTS.
+	bool batch_keypoints = false;
+
+	//! Time spent in each stage of the last frame, for the debug UI.
+	struct
+	{
+		float detection_ms;
+		float keypoints_ms;
+		float kinematics_ms;
+		float waiting_for_kinematics_ms;
+		float total_ms;
+	} stage_timing = {};
+
 
 	float baseline = {};
 	xrt_pose hand_pose_camera_offset = {};
@@ -318,6 +435,26 @@ init_keypoint_estimation_new(HandTracking *hgt, onnx_wrap *wrap);
 void
 run_keypoint_estimation_new(void *ptr);
 
+void
+init_keypoint_batch(HandTracking *hgt, keypoint_batch *wrap, int num_threads);
+
+void
+keypoint_batch_add(keypoint_batch *wrap, keypoint_estimation_run_info *info);
+
+//! Crops the hand into its slot of the batch, for the thread pool.
+void
+run_keypoint_batch_crop(void *ptr);
+
+void
+run_keypoint_batch(HandTracking *hgt, keypoint_batch *wrap);
+
+//! Reads the keypoints of the hand out of its slot of the batch, for the thread pool.
+void
+run_keypoint_batch_decode(void *ptr);
+
+void
+release_keypoint_batch(keypoint_batch *wrap);
+
 void
 release_onnx_wrap(onnx_wrap *wrap);
 
@@ -19,6 +19,14 @@ namespace xrt::tracking::hand::mercury::lm {
 // Opaque struct.
 struct KinematicHandLM;
 
+//! How the last call to @ref optimizer_run went.
+struct optimizer_stats
+{
+	int iterations;
+	uint64_t duration_ns;
+	float final_cost;
+};
+
 // Constructor
 void
 optimizer_create(xrt_pose left_in_right,
@@ -55,6 +63,17 @@ optimizer_run(KinematicHandLM *hand,
               float &out_hand_size,
               float &out_reprojection_error);
 
+/*!
+ * Picks between the block-sparse solver that is kept across frames, the
+ * default, and the dense autodiff solver that is made for every frame.
+ * MERCURY_LM_BLOCK_SOLVER=false picks the latter for all hands.
+ */
+void
+optimizer_use_block_solver(KinematicHandLM *hand, bool enable);
+
+void
+optimizer_get_stats(KinematicHandLM *hand, optimizer_stats &out_stats);
+
 // Destructor
 void
 optimizer_destroy(KinematicHandLM **hand);
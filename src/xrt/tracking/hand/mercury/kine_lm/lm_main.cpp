@@ -11,6 +11,7 @@
 #include "math/m_api.h"
 #include "math/m_vec3.h"
 #include "os/os_time.h"
+#include "util/u_debug.h"
 #include "util/u_logging.h"
 #include "util/u_misc.h"
 #include "util/u_trace_marker.h"
@@ -35,12 +36,48 @@ Everything templated with <typename T> is basically just a scalar template, usua
 
 namespace xrt::tracking::hand::mercury::lm {
 
+DEBUG_GET_ONCE_BOOL_OPTION(mercury_lm_block_solver, "MERCURY_LM_BLOCK_SOLVER", true)
+
 template <typename T> struct StereographicObservation
 {
 	// T obs[kNumNNJoints][2];
 	Vec2<T> obs[kNumNNJoints];
 };
 
+struct KinematicHandLM;
+
+/*!
+ * The same residuals as @ref CostFunctor, with the Jacobian filled in block by
+ * block instead of by autodiffing the whole hand with a Jet as wide as the
+ * parameter vector. Every finger only depends on the wrist, the hand size and
+ * itself, so each finger is differentiated on its own with a Jet of
+ * @ref kBlockDim. The stability residuals are cheap and still done in one go.
+ */
+template <bool optimize_hand_size> struct BlockCostFunction
+{
+	using Scalar = HandScalar;
+	enum
+	{
+		NUM_RESIDUALS = Eigen::Dynamic,
+		NUM_PARAMETERS = calc_input_size(optimize_hand_size),
+	};
+
+	//! Wrist translation and orientation, hand size and the largest finger.
+	static constexpr int kBlockDim = kHandTranslationDim + kHandOrientationDim + kHandSizeDim + kFingerDim;
+
+	KinematicHandLM *state = nullptr;
+	int num_residuals = 0;
+
+	bool
+	operator()(const Scalar *x, Scalar *residuals, Scalar *jacobian) const;
+
+	int
+	NumResiduals() const
+	{
+		return num_residuals;
+	}
+};
+
 struct KinematicHandLM
 {
 	bool first_frame = true;
@@ -70,6 +107,15 @@ struct KinematicHandLM
 	Quat<HandScalar> left_in_right_orientation;
 
 	Eigen::Matrix<HandScalar, calc_input_size(true), 1> TinyOptimizerInput;
+
+	//! Use @ref BlockCostFunction and the solvers below, instead of a dense autodiff solver made every frame.
+	bool use_block_solver = true;
+
+	// Kept alive across frames so their storage is only allocated when the number of residuals changes.
+	ceres::TinySolver<BlockCostFunction<true>> block_solver_hand_size;
+	ceres::TinySolver<BlockCostFunction<false>> block_solver;
+
+	optimizer_stats stats = {};
 };
 
 template <typename T> struct Translations55
@@ -104,204 +150,217 @@ template <bool optimize_hand_size> struct CostFunctor
 
 template <typename T>
 static inline void
-eval_hand_set_rel_translations(const OptimizerHand<T> &opt, Translations55<T> &rel_translations)
+eval_finger_set_rel_translations(int finger, Vec3<T> rel_translations[kNumJointsInFinger])
 {
-	// Basically, we're walking up rel_translations, writing strictly sequentially. Hopefully this is fast.
-
-	// Thumb metacarpal translation.
-	rel_translations.t[0][0] = {(T)0.33097, T(-0.1), (T)-0.25968};
-
-	// Comes after the invisible joint.
-	rel_translations.t[0][1] = {T(0), T(0), T(0)};
-	// prox, distal, tip
-	rel_translations.t[0][2] = {T(0), T(0), T(-0.389626)};
-	rel_translations.t[0][3] = {T(0), T(0), T(-0.311176)};
-	rel_translations.t[0][4] = {T(0), T(0), (T)-0.232195};
+	if (finger == 0) {
+		// Thumb metacarpal translation.
+		rel_translations[0] = {(T)0.33097, T(-0.1), (T)-0.25968};
+
+		// Comes after the invisible joint.
+		rel_translations[1] = {T(0), T(0), T(0)};
+		// prox, distal, tip
+		rel_translations[2] = {T(0), T(0), T(-0.389626)};
+		rel_translations[3] = {T(0), T(0), T(-0.311176)};
+		rel_translations[4] = {T(0), T(0), (T)-0.232195};
+		return;
+	}
 
-	// What's the best place to put this? Here works, but is there somewhere we could put it where it gets accessed
-	// faster?
-	T finger_joint_lengths[4][4] = {
+	static constexpr HandScalar finger_joint_lengths[4][4] = {
 	    {
-	        T(-0.66),
-	        T(-0.365719),
-	        T(-0.231581),
-	        T(-0.201790),
+	        -0.66,
+	        -0.365719,
+	        -0.231581,
+	        -0.201790,
 	    },
 	    {
-	        T(-0.645),
-	        T(-0.404486),
-	        T(-0.247749),
-	        T(-0.210121),
+	        -0.645,
+	        -0.404486,
+	        -0.247749,
+	        -0.210121,
 	    },
 	    {
-	        T(-0.58),
-	        T(-0.365639),
-	        T(-0.225666),
-	        T(-0.187089),
+	        -0.58,
+	        -0.365639,
+	        -0.225666,
+	        -0.187089,
 	    },
 	    {
-	        T(-0.52),
-	        T(-0.278197),
-	        T(-0.176178),
-	        T(-0.157566),
+	        -0.52,
+	        -0.278197,
+	        -0.176178,
+	        -0.157566,
 	    },
 	};
 
-	// Index metacarpal
-	rel_translations.t[1][0] = {T(0.16926), T(0), T(-0.34437)};
-	// Middle
-	rel_translations.t[2][0] = {T(0.034639), T(0.01), T(-0.35573)};
-	// Ring
-	rel_translations.t[3][0] = {T(-0.063625), T(0.005), T(-0.34164)};
-	// Little
-	rel_translations.t[4][0] = {T(-0.1509), T(-0.005), T(-0.30373)};
-
-	// Index to little finger
-	for (int finger = 0; finger < 4; finger++) {
-		for (int i = 0; i < 4; i++) {
-			int bone = i + 1;
-			rel_translations.t[finger + 1][bone] = {T(0), T(0), T(finger_joint_lengths[finger][i])};
-		}
-	}
+	static constexpr HandScalar metacarpal_translations[4][3] = {
+	    // Index
+	    {0.16926, 0, -0.34437},
+	    // Middle
+	    {0.034639, 0.01, -0.35573},
+	    // Ring
+	    {-0.063625, 0.005, -0.34164},
+	    // Little
+	    {-0.1509, -0.005, -0.30373},
+	};
 
-	// This is done in UnitQuaternionRotateAndScale now.
-	// for (int finger = 0; finger < 5; finger++) {
-	// 	for (int bone = 0; bone < 5; bone++) {
-	// 		rel_translations[finger][bone][0] *= opt.hand_size;
-	// 		rel_translations[finger][bone][1] *= opt.hand_size;
-	// 		rel_translations[finger][bone][2] *= opt.hand_size;
-	// 	}
-	// }
-}
+	const HandScalar *metacarpal = metacarpal_translations[finger - 1];
+	rel_translations[0] = {T(metacarpal[0]), T(metacarpal[1]), T(metacarpal[2])};
 
+	for (int i = 0; i < 4; i++) {
+		int bone = i + 1;
+		rel_translations[bone] = {T(0), T(0), T(finger_joint_lengths[finger - 1][i])};
+	}
 
+	// The hand size is applied in UnitQuaternionRotateAndScalePoint.
+}
 
 template <typename T>
-inline void
-eval_hand_set_rel_orientations(const OptimizerHand<T> &opt, Orientations54<T> &rel_orientations)
+static inline void
+eval_finger_set_rel_orientations(const OptimizerHand<T> &opt,
+                                 int finger,
+                                 Quat<T> rel_orientations[kNumOrientationsInFinger])
 {
-
+	if (finger == 0) {
 // Thumb MCP hidden orientation
 #if 0
-	Vec2<T> mcp_root_swing;
-	
-	mcp_root_swing.x = rad<T>((T)(-10));
-	mcp_root_swing.y = rad<T>((T)(-40));
+		Vec2<T> mcp_root_swing;
 
-	T mcp_root_twist = rad<T>((T)(-80));
+		mcp_root_swing.x = rad<T>((T)(-10));
+		mcp_root_swing.y = rad<T>((T)(-40));
 
-	SwingTwistToQuaternion(mcp_root_swing, mcp_root_twist, rel_orientations.q[0][0]);
+		T mcp_root_twist = rad<T>((T)(-80));
 
-	std::cout << "\n\n\n\nHIDDEN ORIENTATION\n";
-	std::cout << std::setprecision(100);
-	std::cout << rel_orientations.q[0][0].w << std::endl;
-	std::cout << rel_orientations.q[0][0].x << std::endl;
-	std::cout << rel_orientations.q[0][0].y << std::endl;
-	std::cout << rel_orientations.q[0][0].z << std::endl;
+		SwingTwistToQuaternion(mcp_root_swing, mcp_root_twist, rel_orientations[0]);
+
+		std::cout << "\n\n\n\nHIDDEN ORIENTATION\n";
+		std::cout << std::setprecision(100);
+		std::cout << rel_orientations[0].w << std::endl;
+		std::cout << rel_orientations[0].x << std::endl;
+		std::cout << rel_orientations[0].y << std::endl;
+		std::cout << rel_orientations[0].z << std::endl;
 #else
-	// This should be exactly equivalent to the above
-	rel_orientations.q[0][0].w = T(0.716990172863006591796875);
-	rel_orientations.q[0][0].x = T(0.1541481912136077880859375);
-	rel_orientations.q[0][0].y = T(-0.31655871868133544921875);
-	rel_orientations.q[0][0].z = T(-0.6016261577606201171875);
+		// This should be exactly equivalent to the above
+		rel_orientations[0].w = T(0.716990172863006591796875);
+		rel_orientations[0].x = T(0.1541481912136077880859375);
+		rel_orientations[0].y = T(-0.31655871868133544921875);
+		rel_orientations[0].z = T(-0.6016261577606201171875);
 #endif
 
-	// Thumb MCP orientation
-	SwingTwistToQuaternion(opt.thumb.metacarpal.swing, //
-	                       opt.thumb.metacarpal.twist, //
-	                       rel_orientations.q[0][1]);
+		// Thumb MCP orientation
+		SwingTwistToQuaternion(opt.thumb.metacarpal.swing, //
+		                       opt.thumb.metacarpal.twist, //
+		                       rel_orientations[1]);
 
-	// Thumb curls
-	CurlToQuaternion(opt.thumb.rots[0], rel_orientations.q[0][2]);
-	CurlToQuaternion(opt.thumb.rots[1], rel_orientations.q[0][3]);
+		// Thumb curls
+		CurlToQuaternion(opt.thumb.rots[0], rel_orientations[2]);
+		CurlToQuaternion(opt.thumb.rots[1], rel_orientations[3]);
+		return;
+	}
 
-	// Finger orientations
-	for (int i = 0; i < 4; i++) {
-		SwingTwistToQuaternion(opt.finger[i].metacarpal.swing, //
-		                       opt.finger[i].metacarpal.twist, //
-		                       rel_orientations.q[i + 1][0]);
+	const OptimizerFinger<T> &f = opt.finger[finger - 1];
 
-		SwingToQuaternion(opt.finger[i].proximal_swing, //
-		                  rel_orientations.q[i + 1][1]);
+	SwingTwistToQuaternion(f.metacarpal.swing, //
+	                       f.metacarpal.twist, //
+	                       rel_orientations[0]);
 
-		CurlToQuaternion(opt.finger[i].rots[0], rel_orientations.q[i + 1][2]);
-		CurlToQuaternion(opt.finger[i].rots[1], rel_orientations.q[i + 1][3]);
-	}
+	SwingToQuaternion(f.proximal_swing, //
+	                  rel_orientations[1]);
+
+	CurlToQuaternion(f.rots[0], rel_orientations[2]);
+	CurlToQuaternion(f.rots[1], rel_orientations[3]);
 }
 
+template <typename T>
+static inline void
+eval_wrist_orientation(const OptimizerHand<T> &opt, Quat<T> &out_orientation_root)
+{
+	Quat<T> post_orientation_quat;
 
+	AngleAxisToQuaternion(opt.wrist_post_orientation_aax, post_orientation_quat);
 
-template <typename T>
-void
-eval_hand_with_orientation(const OptimizerHand<T> &opt,
-                           bool is_right,
-                           Translations55<T> &translations_absolute,
-                           Orientations54<T> &orientations_absolute)
+	QuaternionProduct(opt.wrist_pre_orientation_quat, post_orientation_quat, out_orientation_root);
+}
 
+/*!
+ * One finger only depends on the wrist, the hand size and its own parameters,
+ * which is what lets @ref BlockCostFunction differentiate fingers one by one.
+ */
+template <typename T>
+static inline void
+eval_finger_with_orientation(const OptimizerHand<T> &opt,
+                             bool is_right,
+                             int finger,
+                             const Quat<T> &orientation_root,
+                             Vec3<T> translations_absolute[kNumJointsInFinger],
+                             Quat<T> orientations_absolute[kNumOrientationsInFinger])
 {
-	XRT_TRACE_MARKER();
+	Vec3<T> rel_translations[kNumJointsInFinger];
+	Quat<T> rel_orientations[kNumOrientationsInFinger];
 
+	eval_finger_set_rel_orientations(opt, finger, rel_orientations);
 
-	Translations55<T> rel_translations; //[kNumFingers][kNumJointsInFinger];
-	Orientations54<T> rel_orientations; //[kNumFingers][kNumOrientationsInFinger];
+	eval_finger_set_rel_translations(finger, rel_translations);
 
-	eval_hand_set_rel_orientations(opt, rel_orientations);
+	// Get each joint's tracking-relative orientation by rotating its parent-relative orientation by the
+	// tracking-relative orientation of its parent.
+	const Quat<T> *last_orientation = &orientation_root;
+	for (size_t bone = 0; bone < kNumOrientationsInFinger; bone++) {
+		Quat<T> &out_orientation = orientations_absolute[bone];
+		Quat<T> &rel_orientation = rel_orientations[bone];
 
-	eval_hand_set_rel_translations(opt, rel_translations);
+		QuaternionProduct(*last_orientation, rel_orientation, out_orientation);
+		last_orientation = &out_orientation;
+	}
 
-	Quat<T> orientation_root;
+	// Get each joint's tracking-relative position by rotating its parent-relative translation by the
+	// tracking-relative orientation of its parent, then adding that to its parent's tracking-relative position.
+	const Vec3<T> *last_translation = &opt.wrist_location;
+	last_orientation = &orientation_root;
+	for (size_t bone = 0; bone < kNumJointsInFinger; bone++) {
+		Vec3<T> &out_translation = translations_absolute[bone];
+		Vec3<T> &rel_translation = rel_translations[bone];
 
-	Quat<T> post_orientation_quat;
+		UnitQuaternionRotateAndScalePoint(*last_orientation, rel_translation, opt.hand_size, out_translation);
 
-	AngleAxisToQuaternion(opt.wrist_post_orientation_aax, post_orientation_quat);
+		// If this is a right hand, mirror it.
+		if (is_right) {
+			out_translation.x *= -1;
+		}
 
-	QuaternionProduct(opt.wrist_pre_orientation_quat, post_orientation_quat, orientation_root);
+		out_translation.x += last_translation->x;
+		out_translation.y += last_translation->y;
+		out_translation.z += last_translation->z;
 
-	// Get each joint's tracking-relative orientation by rotating its parent-relative orientation by the
-	// tracking-relative orientation of its parent.
-	for (size_t finger = 0; finger < kNumFingers; finger++) {
-		Quat<T> *last_orientation = &orientation_root;
-		for (size_t bone = 0; bone < kNumOrientationsInFinger; bone++) {
-			Quat<T> &out_orientation = orientations_absolute.q[finger][bone];
-			Quat<T> &rel_orientation = rel_orientations.q[finger][bone];
+		// Next iteration, the orientation to rotate by should be the tracking-relative orientation of
+		// this joint.
 
-			QuaternionProduct(*last_orientation, rel_orientation, out_orientation);
-			last_orientation = &out_orientation;
+		// If bone < 4 so we don't go over the end of orientations_absolute. I hope this gets optimized
+		// out anyway.
+		if (bone < 4) {
+			last_orientation = &orientations_absolute[bone];
+			// Ditto for translation
+			last_translation = &out_translation;
 		}
 	}
+}
 
-	// Get each joint's tracking-relative position by rotating its parent-relative translation by the
-	// tracking-relative orientation of its parent, then adding that to its parent's tracking-relative position.
-	for (size_t finger = 0; finger < kNumFingers; finger++) {
-		const Vec3<T> *last_translation = &opt.wrist_location;
-		const Quat<T> *last_orientation = &orientation_root;
-		for (size_t bone = 0; bone < kNumJointsInFinger; bone++) {
-			Vec3<T> &out_translation = translations_absolute.t[finger][bone];
-			Vec3<T> &rel_translation = rel_translations.t[finger][bone];
-
-			UnitQuaternionRotateAndScalePoint(*last_orientation, rel_translation, opt.hand_size,
-			                                  out_translation);
-
-			// If this is a right hand, mirror it.
-			if (is_right) {
-				out_translation.x *= -1;
-			}
+template <typename T>
+void
+eval_hand_with_orientation(const OptimizerHand<T> &opt,
+                           bool is_right,
+                           Translations55<T> &translations_absolute,
+                           Orientations54<T> &orientations_absolute)
 
-			out_translation.x += last_translation->x;
-			out_translation.y += last_translation->y;
-			out_translation.z += last_translation->z;
+{
+	XRT_TRACE_MARKER();
 
-			// Next iteration, the orientation to rotate by should be the tracking-relative orientation of
-			// this joint.
+	Quat<T> orientation_root;
 
-			// If bone < 4 so we don't go over the end of orientations_absolute. I hope this gets optimized
-			// out anyway.
-			if (bone < 4) {
-				last_orientation = &orientations_absolute.q[finger][bone];
-				// Ditto for translation
-				last_translation = &out_translation;
-			}
-		}
+	eval_wrist_orientation(opt, orientation_root);
+
+	for (size_t finger = 0; finger < kNumFingers; finger++) {
+		eval_finger_with_orientation(opt, is_right, finger, orientation_root, translations_absolute.t[finger],
+		                             orientations_absolute.q[finger]);
 	}
 }
 
@@ -470,6 +529,30 @@ diff(const Vec3<T> &model_joint_pos,
 
 
 
+static const HandScalar kWeCareJoint[] = {1.3, 0.9, 0.9, 1.3};
+static const HandScalar kWeCareFinger[] = {1.0, 1.0, 0.8, 0.8, 0.8};
+static const HandScalar kWeCareWrist = 1.5;
+
+//! Moves joints from the left camera, where the hand is, into the camera of @p view.
+template <typename T>
+static inline void
+view_move(const KinematicHandLM &state, int view, Vec3<T> &out_direction, Quat<T> &out_orientation)
+{
+	if (view == 0) {
+		out_direction = Vec3<T>::Zero();
+		out_orientation = Quat<T>::Identity();
+	} else {
+		out_direction.x = T(state.left_in_right_translation.x);
+		out_direction.y = T(state.left_in_right_translation.y);
+		out_direction.z = T(state.left_in_right_translation.z);
+
+		out_orientation.w = T(state.left_in_right_orientation.w);
+		out_orientation.x = T(state.left_in_right_orientation.x);
+		out_orientation.y = T(state.left_in_right_orientation.y);
+		out_orientation.z = T(state.left_in_right_orientation.z);
+	}
+}
+
 template <typename T>
 void
 CostFunctor_PositionsPart(OptimizerHand<T> &hand, KinematicHandLM &state, ResidualHelper<T> &helper)
@@ -478,9 +561,6 @@ CostFunctor_PositionsPart(OptimizerHand<T> &hand, KinematicHandLM &state, Residu
 	Translations55<T> translations_absolute;
 	Orientations54<T> orientations_absolute;
 
-	HandScalar we_care_joint[] = {1.3, 0.9, 0.9, 1.3};
-	HandScalar we_care_finger[] = {1.0, 1.0, 0.8, 0.8, 0.8};
-
 	eval_hand_with_orientation(hand, state.is_right, translations_absolute, orientations_absolute);
 
 	for (int view = 0; view < 2; view++) {
@@ -490,31 +570,20 @@ CostFunctor_PositionsPart(OptimizerHand<T> &hand, KinematicHandLM &state, Residu
 		Vec3<T> move_direction;
 		Quat<T> move_orientation;
 
-		if (view == 0) {
-			move_direction = Vec3<T>::Zero();
-			move_orientation = Quat<T>::Identity();
-		} else {
-			move_direction.x = T(state.left_in_right_translation.x);
-			move_direction.y = T(state.left_in_right_translation.y);
-			move_direction.z = T(state.left_in_right_translation.z);
-
-			move_orientation.w = T(state.left_in_right_orientation.w);
-			move_orientation.x = T(state.left_in_right_orientation.x);
-			move_orientation.y = T(state.left_in_right_orientation.y);
-			move_orientation.z = T(state.left_in_right_orientation.z);
-		}
+		view_move(state, view, move_direction, move_orientation);
+
 		int joint_acc_idx = 0;
 
 		HandScalar *confidences = state.observation->views[view].confidences;
 
-		diff<T>(hand.wrist_location, move_direction, move_orientation, state.sgo[view], confidences, 1.5,
-		        joint_acc_idx, helper);
+		diff<T>(hand.wrist_location, move_direction, move_orientation, state.sgo[view], confidences,
+		        kWeCareWrist, joint_acc_idx, helper);
 
 		for (int finger_idx = 0; finger_idx < 5; finger_idx++) {
 			for (int joint_idx = 0; joint_idx < 4; joint_idx++) {
 				diff<T>(translations_absolute.t[finger_idx][joint_idx + 1], move_direction,
 				        move_orientation, state.sgo[view], confidences,
-				        we_care_finger[finger_idx] * we_care_joint[joint_idx], joint_acc_idx, helper);
+				        kWeCareFinger[finger_idx] * kWeCareJoint[joint_idx], joint_acc_idx, helper);
 			}
 		}
 	}
@@ -564,6 +633,168 @@ CostFunctor<optimize_hand_size>::operator()(const T *const x, T *residual) const
 	return true;
 }
 
+template <bool optimize_hand_size>
+bool
+BlockCostFunction<optimize_hand_size>::operator()(const Scalar *x, Scalar *residuals, Scalar *jacobian) const
+{
+	KinematicHandLM &state = *this->state;
+
+	// Trying a step, only the cost is needed.
+	if (jacobian == nullptr) {
+		CostFunctor<optimize_hand_size> cf(state, num_residuals);
+		return cf(x, residuals);
+	}
+
+	XRT_TRACE_MARKER();
+
+	// Where the blocks are in the parameter vector, see OptimizerHandUnpackFromVector.
+	constexpr int kWristIdx = 0;
+	constexpr int kWristDim = kHandTranslationDim + kHandOrientationDim;
+	constexpr int kThumbIdx = kWristIdx + kWristDim;
+	constexpr int kFingersIdx = kThumbIdx + kThumbDim;
+	constexpr int kHandSizeIdx = kFingersIdx + kFingerDim * 4;
+
+	// Where they are in the Jet of one finger.
+	constexpr int kBlockHandSize = kWristDim;
+	constexpr int kBlockFinger = kBlockHandSize + kHandSizeDim;
+
+	using BlockJet = ceres::Jet<HandScalar, kBlockDim>;
+	using WideJet = ceres::Jet<HandScalar, NUM_PARAMETERS>;
+
+	Eigen::Map<Eigen::Matrix<Scalar, Eigen::Dynamic, NUM_PARAMETERS>> J(jacobian, num_residuals, NUM_PARAMETERS);
+	J.setZero();
+
+
+	/*
+	 * Positions, one finger at a time.
+	 */
+
+	OptimizerHand<BlockJet> hand = {};
+	hand.wrist_pre_orientation_quat = Quat<BlockJet>(state.last_frame_pre_rotation);
+
+	hand.wrist_location.x = BlockJet(x[kWristIdx + 0], 0);
+	hand.wrist_location.y = BlockJet(x[kWristIdx + 1], 1);
+	hand.wrist_location.z = BlockJet(x[kWristIdx + 2], 2);
+	hand.wrist_post_orientation_aax.x = BlockJet(x[kWristIdx + 3], 3);
+	hand.wrist_post_orientation_aax.y = BlockJet(x[kWristIdx + 4], 4);
+	hand.wrist_post_orientation_aax.z = BlockJet(x[kWristIdx + 5], 5);
+
+	if constexpr (optimize_hand_size) {
+		hand.hand_size = LMToModel(BlockJet(x[kHandSizeIdx], kBlockHandSize), the_limit.hand_size);
+	} else {
+		hand.hand_size = BlockJet(state.target_hand_size);
+	}
+
+	Quat<BlockJet> orientation_root;
+	eval_wrist_orientation(hand, orientation_root);
+
+	// Copies one block of residuals and their derivatives into the full Jacobian.
+	auto write_rows = [&](const BlockJet *res, int count, int row, int finger_idx, int finger_dim) {
+		for (int r = 0; r < count; r++) {
+			residuals[row + r] = res[r].a;
+
+			for (int k = 0; k < kWristDim; k++) {
+				J(row + r, kWristIdx + k) = res[r].v[k];
+			}
+			if constexpr (optimize_hand_size) {
+				J(row + r, kHandSizeIdx) = res[r].v[kBlockHandSize];
+			}
+			for (int k = 0; k < finger_dim; k++) {
+				J(row + r, finger_idx + k) = res[r].v[kBlockFinger + k];
+			}
+		}
+	};
+
+	for (int finger = 0; finger < (int)kNumFingers; finger++) {
+		int finger_idx = finger == 0 ? kThumbIdx : kFingersIdx + (finger - 1) * kFingerDim;
+		int finger_dim = finger == 0 ? kThumbDim : kFingerDim;
+
+		BlockJet block[kFingerDim];
+		for (int k = 0; k < finger_dim; k++) {
+			block[k] = BlockJet(x[finger_idx + k], kBlockFinger + k);
+		}
+
+		if (finger == 0) {
+			OptimizerThumbUnpackFromVector(block, hand.thumb);
+		} else {
+			OptimizerFingerUnpackFromVector(block, finger - 1, hand.finger[finger - 1]);
+		}
+
+		Vec3<BlockJet> translations[kNumJointsInFinger];
+		Quat<BlockJet> orientations[kNumOrientationsInFinger];
+		eval_finger_with_orientation(hand, state.is_right, finger, orientation_root, translations, orientations);
+
+		int view_row = 0;
+		for (int view = 0; view < 2; view++) {
+			if (!state.observation->views[view].active) {
+				continue;
+			}
+
+			Vec3<BlockJet> move_direction;
+			Quat<BlockJet> move_orientation;
+			view_move(state, view, move_direction, move_orientation);
+
+			HandScalar *confidences = state.observation->views[view].confidences;
+
+			// The wrist only depends on the wrist, do it with the first finger.
+			if (finger == 0) {
+				BlockJet res[2];
+				ResidualHelper<BlockJet> helper(res);
+				int joint_acc_idx = 0;
+
+				diff<BlockJet>(hand.wrist_location, move_direction, move_orientation, state.sgo[view],
+				               confidences, kWeCareWrist, joint_acc_idx, helper);
+
+				write_rows(res, 2, view_row, finger_idx, 0);
+			}
+
+			BlockJet res[8];
+			ResidualHelper<BlockJet> helper(res);
+			int joint_acc_idx = 1 + finger * 4;
+
+			for (int joint_idx = 0; joint_idx < 4; joint_idx++) {
+				diff<BlockJet>(translations[joint_idx + 1], move_direction, move_orientation,
+				               state.sgo[view], confidences,
+				               kWeCareFinger[finger] * kWeCareJoint[joint_idx], joint_acc_idx, helper);
+			}
+
+			write_rows(res, 8, view_row + 2 + finger * 8, finger_idx, finger_dim);
+
+			view_row += kHandResidualOneSideSize;
+		}
+	}
+
+
+	/*
+	 * Stability, every residual only depends on one parameter.
+	 */
+
+	int row = state.num_observation_views * kHandResidualOneSideSize;
+
+	WideJet wide_x[NUM_PARAMETERS];
+	for (int i = 0; i < NUM_PARAMETERS; i++) {
+		wide_x[i] = WideJet(x[i], i);
+	}
+
+	OptimizerHand<WideJet> wide_hand = {};
+	Quat<WideJet> pre_rotation = state.last_frame_pre_rotation;
+	OptimizerHandInit<WideJet>(wide_hand, pre_rotation);
+	OptimizerHandUnpackFromVector(wide_x, optimize_hand_size, WideJet(state.target_hand_size), wide_hand);
+
+	WideJet stability[kHandResidualTemporalConsistencySize + kHRTC_HandSize];
+	ResidualHelper<WideJet> helper(stability);
+	computeResidualStability<optimize_hand_size, WideJet>(wide_hand, state.last_frame, state, helper);
+
+	for (size_t r = 0; r < helper.out_residual_idx; r++) {
+		residuals[row + r] = stability[r].a;
+		J.row(row + r) = stability[r].v.transpose();
+	}
+
+	assert(row + (int)helper.out_residual_idx == num_residuals);
+
+	return true;
+}
+
 // look at tests_quat_change_of_basis
 #if 0
 template <typename T>
@@ -807,6 +1038,77 @@ reprojection_error_2d(KinematicHandLM &state, const one_frame_input &observation
 	return final_err / (float)views_looked_at;
 }
 
+template <typename Summary>
+static void
+log_summary(KinematicHandLM &state, const Summary &summary, float gradient_tolerance)
+{
+	if (state.log_level > U_LOGGING_DEBUG) {
+		return;
+	}
+
+	double time_taken = (double)state.stats.duration_ns / (double)U_TIME_1MS_IN_NS;
+
+	const char *status;
+
+	switch (summary.status) {
+	case 0: {
+		status = "GRADIENT_TOO_SMALL";
+	} break;
+	case 1: {
+		status = "RELATIVE_STEP_SIZE_TOO_SMALL";
+	} break;
+	case 2: {
+		status = "COST_TOO_SMALL";
+	} break;
+	case 3: {
+		status = "HIT_MAX_ITERATIONS";
+	} break;
+	case 4: {
+		status = "COST_CHANGE_TOO_SMALL";
+	} break;
+	}
+
+	LM_DEBUG(state, "Status: %s, num_iterations %d, max_norm %E, gtol %E", status, summary.iterations,
+	         summary.gradient_max_norm, gradient_tolerance);
+	LM_DEBUG(state, "Took %f ms", time_taken);
+	if (summary.iterations < 3) {
+		LM_DEBUG(state, "Suspiciouisly low number of iterations!");
+	}
+}
+
+template <typename Solver>
+static void
+setup_solver(Solver &solver)
+{
+	solver.options.max_num_iterations = 50;
+	// We need to do a parameter sweep for the trust region and see what's fastest.
+	// solver.options.initial_trust_region_radius = 1e3;
+	solver.options.function_tolerance = 1e-6;
+}
+
+template <typename Solver, typename Function>
+static void
+solve(KinematicHandLM &state, Solver &solver, const Function &f)
+{
+	constexpr size_t input_size = Function::NUM_PARAMETERS;
+
+	// Starts from last frame's hand, which is already packed in there.
+	Eigen::Matrix<HandScalar, input_size, 1> inp = state.TinyOptimizerInput.template head<input_size>();
+
+	uint64_t start = os_monotonic_get_ns();
+	const auto &summary = solver.Solve(f, &inp);
+	uint64_t end = os_monotonic_get_ns();
+
+	//!@todo Is there a zero-copy way of doing this?
+	state.TinyOptimizerInput.template head<input_size>() = inp;
+
+	state.stats.iterations = summary.iterations;
+	state.stats.duration_ns = end - start;
+	state.stats.final_cost = summary.final_cost;
+
+	log_summary(state, summary, solver.options.gradient_tolerance);
+}
+
 template <bool optimize_hand_size>
 inline float
 opt_run(KinematicHandLM &state, one_frame_input &observation, xrt_hand_joint_set &out_viz_hand)
@@ -818,6 +1120,19 @@ opt_run(KinematicHandLM &state, one_frame_input &observation, xrt_hand_joint_set
 	LM_DEBUG(state, "Running with %zu inputs and %zu residuals, viewed in %d cameras", input_size, residual_size,
 	         state.num_observation_views);
 
+	if (state.use_block_solver) {
+		BlockCostFunction<optimize_hand_size> f = {};
+		f.state = &state;
+		f.num_residuals = (int)residual_size;
+
+		if constexpr (optimize_hand_size) {
+			solve(state, state.block_solver_hand_size, f);
+		} else {
+			solve(state, state.block_solver, f);
+		}
+		return 0;
+	}
+
 	CostFunctor<optimize_hand_size> cf(state, residual_size);
 
 	using AutoDiffCostFunctor =
@@ -829,52 +1144,10 @@ opt_run(KinematicHandLM &state, one_frame_input &observation, xrt_hand_joint_set
 	// Okay I have no idea if this should be {}-initialized or not. Previous me seems to have thought no, but it
 	// works either way.
 	ceres::TinySolver<AutoDiffCostFunctor> solver = {};
-	solver.options.max_num_iterations = 50;
-	// We need to do a parameter sweep for the trust region and see what's fastest.
-	// solver.options.initial_trust_region_radius = 1e3;
-	solver.options.function_tolerance = 1e-6;
-
-	Eigen::Matrix<HandScalar, input_size, 1> inp = state.TinyOptimizerInput.head<input_size>();
+	setup_solver(solver);
 
-	XRT_MAYBE_UNUSED uint64_t start = os_monotonic_get_ns();
-	XRT_MAYBE_UNUSED auto summary = solver.Solve(f, &inp);
-	XRT_MAYBE_UNUSED uint64_t end = os_monotonic_get_ns();
+	solve(state, solver, f);
 
-	//!@todo Is there a zero-copy way of doing this?
-	state.TinyOptimizerInput.head<input_size>() = inp;
-
-	if (state.log_level <= U_LOGGING_DEBUG) {
-
-		uint64_t diff = end - start;
-		double time_taken = (double)diff / (double)U_TIME_1MS_IN_NS;
-
-		const char *status;
-
-		switch (summary.status) {
-		case 0: {
-			status = "GRADIENT_TOO_SMALL";
-		} break;
-		case 1: {
-			status = "RELATIVE_STEP_SIZE_TOO_SMALL";
-		} break;
-		case 2: {
-			status = "COST_TOO_SMALL";
-		} break;
-		case 3: {
-			status = "HIT_MAX_ITERATIONS";
-		} break;
-		case 4: {
-			status = "COST_CHANGE_TOO_SMALL";
-		} break;
-		}
-
-		LM_DEBUG(state, "Status: %s, num_iterations %d, max_norm %E, gtol %E", status, summary.iterations,
-		         summary.gradient_max_norm, solver.options.gradient_tolerance);
-		LM_DEBUG(state, "Took %f ms", time_taken);
-		if (summary.iterations < 3) {
-			LM_DEBUG(state, "Suspiciouisly low number of iterations!");
-		}
-	}
 	return 0;
 }
 
@@ -989,12 +1262,28 @@ optimizer_create(xrt_pose left_in_right, bool is_right, u_logging_level log_leve
 	hand->left_in_right_orientation.y = left_in_right.orientation.y;
 	hand->left_in_right_orientation.z = left_in_right.orientation.z;
 
+	hand->use_block_solver = debug_get_bool_option_mercury_lm_block_solver();
+	setup_solver(hand->block_solver_hand_size);
+	setup_solver(hand->block_solver);
+
 	// Probably unnecessary.
 	hand_was_untracked(hand);
 
 	*out_kinematic_hand = hand;
 }
 
+void
+optimizer_use_block_solver(KinematicHandLM *hand, bool enable)
+{
+	hand->use_block_solver = enable;
+}
+
+void
+optimizer_get_stats(KinematicHandLM *hand, optimizer_stats &out_stats)
+{
+	out_stats = hand->stats;
+}
+
 void
 optimizer_destroy(KinematicHandLM **hand)
 {
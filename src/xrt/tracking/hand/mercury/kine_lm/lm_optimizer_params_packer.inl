@@ -141,6 +141,40 @@ ModelToLM(T model, minmax mm)
 	return asin((2 * (model - mm.min) / (mm.max - mm.min)) - 1);
 }
 
+template <typename T>
+void
+OptimizerThumbUnpackFromVector(const T *in, OptimizerThumb<T> &out)
+{
+	size_t acc_idx = 0;
+
+	out.metacarpal.swing.x = LMToModel(in[acc_idx++], the_limit.thumb_mcp_swing_x);
+	out.metacarpal.swing.y = LMToModel(in[acc_idx++], the_limit.thumb_mcp_swing_y);
+	out.metacarpal.twist = LMToModel(in[acc_idx++], the_limit.thumb_mcp_twist);
+
+	out.rots[0] = LMToModel(in[acc_idx++], the_limit.thumb_curls[0]);
+	out.rots[1] = LMToModel(in[acc_idx++], the_limit.thumb_curls[1]);
+}
+
+template <typename T>
+void
+OptimizerFingerUnpackFromVector(const T *in, int finger_idx, OptimizerFinger<T> &out)
+{
+	size_t acc_idx = 0;
+
+	out.metacarpal.swing.x = LMToModel(in[acc_idx++], the_limit.fingers[finger_idx].mcp_swing_x);
+
+	out.metacarpal.swing.y = LMToModel(in[acc_idx++], the_limit.fingers[finger_idx].mcp_swing_y);
+
+	out.metacarpal.twist = LMToModel(in[acc_idx++], the_limit.fingers[finger_idx].mcp_twist);
+
+
+	out.proximal_swing.x = LMToModel(in[acc_idx++], the_limit.fingers[finger_idx].pxm_swing_x);
+	out.proximal_swing.y = LMToModel(in[acc_idx++], the_limit.fingers[finger_idx].pxm_swing_y);
+
+	out.rots[0] = LMToModel(in[acc_idx++], the_limit.fingers[finger_idx].curls[0]);
+	out.rots[1] = LMToModel(in[acc_idx++], the_limit.fingers[finger_idx].curls[1]);
+}
+
 // Input vector,
 template <typename T>
 void
@@ -161,32 +195,12 @@ OptimizerHandUnpackFromVector(const T *in, bool use_hand_size, T hand_size, Opti
 
 #ifdef USE_EVERYTHING_ELSE
 
-	out.thumb.metacarpal.swing.x = LMToModel(in[acc_idx++], the_limit.thumb_mcp_swing_x);
-	out.thumb.metacarpal.swing.y = LMToModel(in[acc_idx++], the_limit.thumb_mcp_swing_y);
-	out.thumb.metacarpal.twist = LMToModel(in[acc_idx++], the_limit.thumb_mcp_twist);
-
-	out.thumb.rots[0] = LMToModel(in[acc_idx++], the_limit.thumb_curls[0]);
-	out.thumb.rots[1] = LMToModel(in[acc_idx++], the_limit.thumb_curls[1]);
+	OptimizerThumbUnpackFromVector(&in[acc_idx], out.thumb);
+	acc_idx += kThumbDim;
 
 	for (int finger_idx = 0; finger_idx < 4; finger_idx++) {
-
-		out.finger[finger_idx].metacarpal.swing.x =
-		    LMToModel(in[acc_idx++], the_limit.fingers[finger_idx].mcp_swing_x);
-
-		out.finger[finger_idx].metacarpal.swing.y =
-		    LMToModel(in[acc_idx++], the_limit.fingers[finger_idx].mcp_swing_y);
-
-		out.finger[finger_idx].metacarpal.twist =
-		    LMToModel(in[acc_idx++], the_limit.fingers[finger_idx].mcp_twist);
-
-
-		out.finger[finger_idx].proximal_swing.x =
-		    LMToModel(in[acc_idx++], the_limit.fingers[finger_idx].pxm_swing_x);
-		out.finger[finger_idx].proximal_swing.y =
-		    LMToModel(in[acc_idx++], the_limit.fingers[finger_idx].pxm_swing_y);
-
-		out.finger[finger_idx].rots[0] = LMToModel(in[acc_idx++], the_limit.fingers[finger_idx].curls[0]);
-		out.finger[finger_idx].rots[1] = LMToModel(in[acc_idx++], the_limit.fingers[finger_idx].curls[1]);
+		OptimizerFingerUnpackFromVector(&in[acc_idx], finger_idx, out.finger[finger_idx]);
+		acc_idx += kFingerDim;
 	}
 #endif
 
@@ -9,17 +9,47 @@
 
 #include "tracking/t_hand_tracking.h"
 #include "util/u_misc.h"
+#include "util/u_debug.h"
+#include "util/u_time.h"
 #include "util/u_trace_marker.h"
 #include "util/u_logging.h"
 #include "util/u_var.h"
 #include "os/os_threading.h"
+#include "os/os_time.h"
+#include "os/os_seqlock.h"
 
-#include "math/m_space.h"
-#include "math/m_relation_history.h"
+#include "math/m_api.h"
+#include "math/m_vec3.h"
+#include "math/m_predict.h"
 
 
 //!@todo Definitely needs a destroy function, will leak a ton.
 
+DEBUG_GET_ONCE_FLOAT_OPTION(ht_prediction_offset_ms, "HT_PREDICTION_OFFSET_MS", -40.0f)
+
+//! Never extrapolate further than this from the latest result, hands don't keep moving in straight lines.
+#define HT_ASYNC_MAX_PREDICTION_NS (100 * U_TIME_1MS_IN_NS)
+
+//! Results further apart than this are not used for estimating velocities.
+#define HT_ASYNC_MAX_VELOCITY_DT_NS (200 * U_TIME_1MS_IN_NS)
+
+#define HT_ASYNC_SLOT_COUNT 3
+
+//! Spins before a reader starts sleeping, to let a preempted writer finish.
+#define HT_ASYNC_MAX_READ_SPINS 1000
+
+/*!
+ * One published result, both hands with the velocity of each joint filled in.
+ */
+struct ht_async_slot
+{
+	//! Odd while being written.
+	xrt_atomic_s32_t seq;
+
+	uint64_t timestamp;
+	struct xrt_hand_joint_set hands[2];
+};
+
 struct ht_async_impl
 {
 	struct t_hand_tracking_async base;
@@ -31,18 +61,32 @@ struct ht_async_impl
 	bool use_prediction;
 	struct u_var_draggable_f32 prediction_offset_ms;
 
+	//! How much of the new velocity to take each frame, 1 is no smoothing.
+	float velocity_alpha;
+
 	struct
 	{
 		struct xrt_hand_joint_set hands[2];
 		uint64_t timestamp;
 	} working;
 
+	//! Last published result, only touched by the mainloop, used for velocities.
 	struct
 	{
-		struct os_mutex mutex;
 		struct xrt_hand_joint_set hands[2];
-		struct m_relation_history *relation_hist[2];
 		uint64_t timestamp;
+	} last;
+
+	/*!
+	 * Triple buffer of results. The mainloop writes the slot after the
+	 * latest one and then publishes it, so readers copying the latest slot
+	 * never wait and only have to retry if they get preempted for two whole
+	 * hand tracking frames. Any number of readers are fine.
+	 */
+	struct
+	{
+		struct ht_async_slot slots[HT_ASYNC_SLOT_COUNT];
+		xrt_atomic_s32_t latest;
 	} present;
 
 	// in here:
@@ -60,6 +104,111 @@ ht_async_impl(struct t_hand_tracking_async *base)
 	return (struct ht_async_impl *)base;
 }
 
+static void
+estimate_joint_velocity(const struct xrt_space_relation *last,
+                        float dt,
+                        float alpha,
+                        struct xrt_space_relation *rel)
+{
+	enum xrt_space_relation_flags both = last->relation_flags & rel->relation_flags;
+	enum xrt_space_relation_flags flags = rel->relation_flags;
+
+	if ((both & XRT_SPACE_RELATION_POSITION_VALID_BIT) != 0) {
+		struct xrt_vec3 v = m_vec3_div_scalar(m_vec3_sub(rel->pose.position, last->pose.position), dt);
+
+		// Smooth against the previous estimate if there is one.
+		if ((last->relation_flags & XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT) != 0) {
+			v = m_vec3_add(m_vec3_mul_scalar(v, alpha), m_vec3_mul_scalar(last->linear_velocity, 1.f - alpha));
+		}
+
+		rel->linear_velocity = v;
+		flags |= XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT;
+	}
+
+	if ((both & XRT_SPACE_RELATION_ORIENTATION_VALID_BIT) != 0) {
+		struct xrt_vec3 w;
+		math_quat_finite_difference(&last->pose.orientation, &rel->pose.orientation, dt, &w);
+
+		if ((last->relation_flags & XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT) != 0) {
+			w = m_vec3_add(m_vec3_mul_scalar(w, alpha), m_vec3_mul_scalar(last->angular_velocity, 1.f - alpha));
+		}
+
+		rel->angular_velocity = w;
+		flags |= XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT;
+	}
+
+	rel->relation_flags = flags;
+}
+
+/*!
+ * Fill in the velocity of every joint from the difference to the last result,
+ * the joints move independently of the wrist so they all get their own.
+ */
+static void
+estimate_hand_velocity(struct ht_async_impl *hta, int idx)
+{
+	struct xrt_hand_joint_set *hand = &hta->working.hands[idx];
+	struct xrt_hand_joint_set *last = &hta->last.hands[idx];
+	uint64_t dt_ns = hta->working.timestamp - hta->last.timestamp;
+
+	bool usable = hand->is_active && last->is_active && hta->working.timestamp > hta->last.timestamp &&
+	              dt_ns < HT_ASYNC_MAX_VELOCITY_DT_NS;
+
+	for (int i = 0; i < XRT_HAND_JOINT_COUNT; i++) {
+		struct xrt_space_relation *rel = &hand->values.hand_joint_set_default[i].relation;
+
+		// The provider doesn't give us velocities, don't trust any it might leave around.
+		rel->relation_flags &=
+		    ~(XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT | XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT);
+
+		if (usable) {
+			estimate_joint_velocity(&last->values.hand_joint_set_default[i].relation,
+			                        (float)time_ns_to_s(dt_ns), hta->velocity_alpha, rel);
+		}
+	}
+}
+
+static void
+publish(struct ht_async_impl *hta)
+{
+	// Only this thread writes, so the latest index can't change under us.
+	int32_t next = (os_seqlock_load_acquire(&hta->present.latest) + 1) % HT_ASYNC_SLOT_COUNT;
+	struct ht_async_slot *slot = &hta->present.slots[next];
+
+	// A reader that is still on this slot from two results ago will retry.
+	os_seqlock_write_begin(&slot->seq);
+
+	slot->timestamp = hta->working.timestamp;
+	slot->hands[0] = hta->working.hands[0];
+	slot->hands[1] = hta->working.hands[1];
+
+	os_seqlock_write_end(&slot->seq);
+
+	os_seqlock_store_release(&hta->present.latest, next);
+}
+
+static void
+read_latest(struct ht_async_impl *hta, int idx, struct xrt_hand_joint_set *out_hand, uint64_t *out_timestamp)
+{
+	for (uint32_t tries = 0;; tries++) {
+		os_seqlock_read_backoff(tries, HT_ASYNC_MAX_READ_SPINS);
+
+		struct ht_async_slot *slot = &hta->present.slots[os_seqlock_load_acquire(&hta->present.latest)];
+
+		int32_t begin = 0;
+		if (!os_seqlock_read_begin(&slot->seq, &begin)) {
+			continue;
+		}
+
+		*out_hand = slot->hands[idx];
+		*out_timestamp = slot->timestamp;
+
+		if (os_seqlock_read_end(&slot->seq, begin)) {
+			return;
+		}
+	}
+}
+
 static void *
 ht_async_mainloop(void *ptr)
 {
@@ -90,21 +239,16 @@ ht_async_mainloop(void *ptr)
 
 		xrt_frame_reference(&hta->frames[0], NULL);
 		xrt_frame_reference(&hta->frames[1], NULL);
-		os_mutex_lock(&hta->present.mutex);
-		hta->present.timestamp = hta->working.timestamp;
+
 		for (int i = 0; i < 2; i++) {
-			hta->present.hands[i] = hta->working.hands[i];
+			estimate_hand_velocity(hta, i);
+		}
 
-			struct xrt_space_relation wrist_rel =
-			    hta->working.hands[i].values.hand_joint_set_default[XRT_HAND_JOINT_WRIST].relation;
+		publish(hta);
 
-			m_relation_history_estimate_motion(hta->present.relation_hist[i], //
-			                                   &wrist_rel,                    //
-			                                   hta->working.timestamp,        //
-			                                   &wrist_rel);
-			m_relation_history_push(hta->present.relation_hist[i], &wrist_rel, hta->working.timestamp);
-		}
-		os_mutex_unlock(&hta->present.mutex);
+		hta->last.timestamp = hta->working.timestamp;
+		hta->last.hands[0] = hta->working.hands[0];
+		hta->last.hands[1] = hta->working.hands[1];
 
 		hta->hand_tracking_work_active = false;
 
@@ -164,45 +308,39 @@ ht_async_get_hand(struct t_hand_tracking_async *ht_async,
 		idx = 1;
 	}
 
-	os_mutex_lock(&hta->present.mutex);
+	uint64_t latest_timestamp_ns = 0;
+	read_latest(hta, idx, out_value, &latest_timestamp_ns);
 
-	struct xrt_hand_joint_set latest_hand = hta->present.hands[idx];
-
-	if (!hta->use_prediction) {
-		*out_value = latest_hand;
-		*out_timestamp_ns = hta->present.timestamp;
-		os_mutex_unlock(&hta->present.mutex);
+	if (!hta->use_prediction || !out_value->is_active) {
+		*out_timestamp_ns = latest_timestamp_ns;
 		return;
 	}
 
 	double prediction_offset_ns = (double)hta->prediction_offset_ms.val * (double)U_TIME_1MS_IN_NS;
 
-	desired_timestamp_ns += (uint64_t)prediction_offset_ns;
-
-	struct xrt_space_relation predicted_wrist;
-	m_relation_history_get(hta->present.relation_hist[idx], desired_timestamp_ns, &predicted_wrist);
+	desired_timestamp_ns += (int64_t)prediction_offset_ns;
 
-	os_mutex_unlock(&hta->present.mutex);
-
-	struct xrt_space_relation latest_wrist =
-	    latest_hand.values.hand_joint_set_default[XRT_HAND_JOINT_WRIST].relation;
-
-	*out_value = latest_hand;
+	int64_t delta_ns = (int64_t)(desired_timestamp_ns - latest_timestamp_ns);
+	if (delta_ns > (int64_t)HT_ASYNC_MAX_PREDICTION_NS) {
+		delta_ns = HT_ASYNC_MAX_PREDICTION_NS;
+	}
 
-	// apply the pose change from the latest wrist to the predicted wrist
-	// to all the joints on the hand.
+	// Asked for something older than what we have, just hand that out.
+	if (delta_ns <= 0) {
+		*out_timestamp_ns = latest_timestamp_ns;
+		return;
+	}
 
-	//!@optimize We could slightly reduce the total number of transforms by putting some of this in
-	//! ht_async_mainloop
+	// Every joint moves along its own velocity.
+	double delta_s = time_ns_to_s(delta_ns);
 	for (int i = 0; i < XRT_HAND_JOINT_COUNT; i++) {
-		struct xrt_relation_chain xrc = {0};
-		m_relation_chain_push_relation(&xrc, &latest_hand.values.hand_joint_set_default[i].relation);
-		m_relation_chain_push_inverted_relation(&xrc, &latest_wrist);
-		m_relation_chain_push_relation(&xrc, &predicted_wrist);
-		m_relation_chain_resolve(&xrc, &out_value->values.hand_joint_set_default[i].relation);
+		struct xrt_space_relation *rel = &out_value->values.hand_joint_set_default[i].relation;
+		struct xrt_space_relation latest = *rel;
+		m_predict_relation(&latest, delta_s, rel);
 	}
 
-	*out_timestamp_ns = desired_timestamp_ns;
+	// Where the joints are, which isn't the desired time if the prediction was clamped.
+	*out_timestamp_ns = latest_timestamp_ns + delta_ns;
 }
 
 void
@@ -217,13 +355,10 @@ ht_async_destroy(struct xrt_frame_node *node)
 {
 	struct ht_async_impl *hta = ht_async_impl(container_of(node, struct t_hand_tracking_async, node));
 	os_thread_helper_destroy(&hta->mainloop);
-	os_mutex_destroy(&hta->present.mutex);
 
 	t_ht_sync_destroy(&hta->provider);
 
-	for (int i = 0; i < 2; i++) {
-		m_relation_history_destroy(&hta->present.relation_hist[i]);
-	}
+	u_var_remove_root(hta);
 
 	free(hta);
 }
@@ -242,10 +377,6 @@ t_hand_tracking_async_default_create(struct xrt_frame_context *xfctx, struct t_h
 
 	hta->provider = sync;
 
-	for (int i = 0; i < 2; i++) {
-		m_relation_history_create(&hta->present.relation_hist[i]);
-	}
-
 	u_var_add_root(hta, "Hand-tracking async shim!", 0);
 
 	//!@todo We came up with this value just by seeing what worked - with Index and WMR, we'd be around 40ms late by
@@ -255,20 +386,20 @@ t_hand_tracking_async_default_create(struct xrt_frame_context *xfctx, struct t_h
 	// typical maximum time between the time at which we were asked for a sample and most recent processed sample
 	// timestamp.
 
-	hta->prediction_offset_ms.val = -40;
+	hta->prediction_offset_ms.val = debug_get_float_option_ht_prediction_offset_ms();
 	hta->prediction_offset_ms.step = 0.5;
 
 	hta->use_prediction = true;
+	hta->velocity_alpha = 0.6f;
 
 	// No need to enforce limits, although generally around -40 is what you want.
 	hta->prediction_offset_ms.min = -1000000;
 	hta->prediction_offset_ms.max = 1000000;
 
-	u_var_add_bool(hta, &hta->use_prediction, "Predict wrist movement");
+	u_var_add_bool(hta, &hta->use_prediction, "Predict joint movement");
 	u_var_add_draggable_f32(hta, &hta->prediction_offset_ms, "Amount to time-travel (ms)");
+	u_var_add_f32(hta, &hta->velocity_alpha, "Velocity smoothing (1 = none)");
 
-
-	os_mutex_init(&hta->present.mutex);
 	os_thread_helper_init(&hta->mainloop);
 	os_thread_helper_start(&hta->mainloop, ht_async_mainloop, hta);
 	xrt_frame_context_add(xfctx, &hta->base.node);
@@ -0,0 +1,487 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Headless in-process OpenXR instance on the simulated HMD, for tests.
+ *
+ * Replaces @ref xrt_instance_create and the SDL2 hack of the state tracker, so
+ * only include it in one file of a test executable.
+ */
+
+#pragma once
+
+#include "xrt/xrt_device.h"
+#include "xrt/xrt_instance.h"
+#include "os/os_time.h"
+#include "util/u_device.h"
+#include "util/u_system_helpers.h"
+#include "simulated/simulated_interface.h"
+#include "bindings/b_generated_bindings.h"
+
+#include "catch/catch.hpp"
+
+#include <oxr/oxr_objects.h>
+#include <oxr/oxr_api_funcs.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+
+/*
+ *
+ * The instance the state tracker gets, instead of the prober one.
+ *
+ */
+
+namespace {
+
+/*!
+ * How the controller inputs move, set by the test before each sync. Every
+ * @p period frames each input changes once, zero keeps them still.
+ */
+struct input_pattern
+{
+	uint64_t frame = 0;
+	uint32_t period = 0;
+};
+
+input_pattern g_pattern;
+
+//! The profile the fake controllers pretend to be.
+const profile_template &
+controller_template()
+{
+	for (const profile_template &templ : profile_templates) {
+		if (templ.name == XRT_DEVICE_INDEX_CONTROLLER) {
+			return templ;
+		}
+	}
+	return profile_templates[0];
+}
+
+void
+controller_update_inputs(struct xrt_device *xdev)
+{
+	const input_pattern &p = g_pattern;
+	int64_t timestamp = (int64_t)(p.frame + 1) * U_TIME_1MS_IN_NS;
+
+	for (uint32_t j = 0; j < xdev->input_count; j++) {
+		struct xrt_input *input = &xdev->inputs[j];
+
+		// Like most drivers, stamped every update even if nothing changed.
+		input->timestamp = timestamp;
+
+		// The first frame sets everything, the devices live longer than a session.
+		bool change = p.frame == 0 || (p.period != 0 && (p.frame + j) % p.period == 0);
+		if (!change) {
+			continue;
+		}
+
+		uint64_t step = (p.period != 0 ? p.frame / p.period : 0) + j;
+		float f = (float)step;
+		input->active = step % 11 != 0;
+
+		switch (XRT_GET_INPUT_TYPE(input->name)) {
+		case XRT_INPUT_TYPE_BOOLEAN: input->value.boolean = (step & 1) != 0; break;
+		case XRT_INPUT_TYPE_VEC1_ZERO_TO_ONE: input->value.vec1.x = (float)(step % 10) / 10.0f; break;
+		case XRT_INPUT_TYPE_VEC1_MINUS_ONE_TO_ONE: input->value.vec1.x = (float)(step % 10) / 5.0f - 1.0f; break;
+		case XRT_INPUT_TYPE_VEC2_MINUS_ONE_TO_ONE:
+			input->value.vec2.x = cosf(f) * 0.9f;
+			input->value.vec2.y = sinf(f) * 0.9f;
+			break;
+		default: break;
+		}
+	}
+}
+
+void
+controller_get_tracked_pose(struct xrt_device *xdev,
+                            enum xrt_input_name name,
+                            uint64_t at_timestamp_ns,
+                            struct xrt_space_relation *out_relation)
+{
+	*out_relation = XRT_SPACE_RELATION_ZERO;
+	out_relation->pose.orientation.w = 1.0f;
+	out_relation->relation_flags = XRT_SPACE_RELATION_BITMASK_ALL;
+}
+
+void
+controller_set_output(struct xrt_device *xdev, enum xrt_output_name name, const union xrt_output_value *value)
+{}
+
+void
+controller_destroy(struct xrt_device *xdev)
+{
+	u_device_free(xdev);
+}
+
+//! A controller with every input and output of the template, for one hand.
+struct xrt_device *
+controller_create(bool left)
+{
+	const profile_template &templ = controller_template();
+	const char *hand = left ? "/user/hand/left" : "/user/hand/right";
+
+	std::vector<xrt_input_name> inputs;
+	std::vector<xrt_output_name> outputs;
+	for (size_t i = 0; i < templ.binding_count; i++) {
+		const binding_template &b = templ.bindings[i];
+		if (strcmp(b.subaction_path, hand) != 0) {
+			continue;
+		}
+		if (b.input != 0 && std::find(inputs.begin(), inputs.end(), b.input) == inputs.end()) {
+			inputs.push_back(b.input);
+		}
+		if (b.output != 0 && std::find(outputs.begin(), outputs.end(), b.output) == outputs.end()) {
+			outputs.push_back(b.output);
+		}
+	}
+
+	struct xrt_device *xdev =
+	    U_DEVICE_ALLOCATE(struct xrt_device, U_DEVICE_ALLOC_TRACKING_NONE, inputs.size(), outputs.size());
+	xdev->name = templ.name;
+	xdev->device_type = left ? XRT_DEVICE_TYPE_LEFT_HAND_CONTROLLER : XRT_DEVICE_TYPE_RIGHT_HAND_CONTROLLER;
+	xdev->orientation_tracking_supported = true;
+	xdev->position_tracking_supported = true;
+	xdev->update_inputs = controller_update_inputs;
+	xdev->get_tracked_pose = controller_get_tracked_pose;
+	xdev->set_output = controller_set_output;
+	xdev->destroy = controller_destroy;
+	snprintf(xdev->str, XRT_DEVICE_NAME_LEN, "Fake %s controller", left ? "left" : "right");
+	snprintf(xdev->serial, XRT_DEVICE_NAME_LEN, "Fake %s controller", left ? "left" : "right");
+
+	for (size_t i = 0; i < inputs.size(); i++) {
+		xdev->inputs[i].name = inputs[i];
+		xdev->inputs[i].active = true;
+	}
+	for (size_t i = 0; i < outputs.size(); i++) {
+		xdev->outputs[i].name = outputs[i];
+	}
+
+	return xdev;
+}
+
+xrt_result_t
+instance_create_system(struct xrt_instance *xinst,
+                       struct xrt_system_devices **out_xsysd,
+                       struct xrt_system_compositor **out_xsysc)
+{
+	// Headless, there is no compositor to give.
+	if (out_xsysc != NULL) {
+		return XRT_ERROR_ALLOCATION;
+	}
+
+	struct u_system_devices *usysd = u_system_devices_allocate();
+	struct xrt_system_devices *xsysd = &usysd->base;
+
+	xsysd->xdevs[xsysd->xdev_count++] = simulated_hmd_create();
+	xsysd->xdevs[xsysd->xdev_count++] = controller_create(true);
+	xsysd->xdevs[xsysd->xdev_count++] = controller_create(false);
+	xsysd->roles.head = xsysd->xdevs[0];
+	xsysd->roles.left = xsysd->xdevs[1];
+	xsysd->roles.right = xsysd->xdevs[2];
+
+	*out_xsysd = xsysd;
+
+	return XRT_SUCCESS;
+}
+
+xrt_result_t
+instance_get_prober(struct xrt_instance *xinst, struct xrt_prober **out_xp)
+{
+	return XRT_ERROR_PROBER_NOT_SUPPORTED;
+}
+
+void
+instance_destroy(struct xrt_instance *xinst)
+{
+	delete xinst;
+}
+
+} // namespace
+
+extern "C" {
+
+xrt_result_t
+xrt_instance_create(struct xrt_instance_info *ii, struct xrt_instance **out_xinst)
+{
+	struct xrt_instance *xinst = new xrt_instance();
+	xinst->create_system = instance_create_system;
+	xinst->get_prober = instance_get_prober;
+	xinst->destroy = instance_destroy;
+	xinst->startup_timestamp = os_monotonic_get_ns();
+
+	*out_xinst = xinst;
+
+	return XRT_SUCCESS;
+}
+
+int
+oxr_sdl2_hack_create(void **out_hack)
+{
+	return 0;
+}
+
+void
+oxr_sdl2_hack_start(void *hack, struct xrt_instance *xinst, struct xrt_system_devices *xsysd)
+{}
+
+void
+oxr_sdl2_hack_stop(void **hack_ptr)
+{}
+}
+
+
+/*
+ *
+ * The app side.
+ *
+ */
+
+namespace {
+
+//! What the app sees of one action after a sync.
+struct action_state
+{
+	XrBool32 active;
+	XrBool32 changed;
+	XrTime last_change_time;
+	float x, y;
+
+	bool
+	operator==(const action_state &o) const
+	{
+		return active == o.active && changed == o.changed && last_change_time == o.last_change_time &&
+		       x == o.x && y == o.y;
+	}
+};
+
+/*!
+ * A headless instance with many actions, spread over a few action sets with
+ * different priorities and bound in every profile.
+ */
+struct app
+{
+	XrInstance instance = XR_NULL_HANDLE;
+	XrSystemId system_id = XR_NULL_SYSTEM_ID;
+	XrSession session = XR_NULL_HANDLE;
+
+	XrPath hands[2] = {};
+	std::vector<XrActionSet> sets;
+	std::vector<XrAction> actions;
+	std::vector<XrActionType> types;
+
+	//! Number of profiles the bindings were accepted for.
+	uint32_t profile_count = 0;
+
+	//! Headless is always enabled, @p extensions are enabled on top of it.
+	app(uint32_t action_count, uint32_t set_count, std::vector<const char *> extensions = {})
+	{
+		extensions.push_back(XR_MND_HEADLESS_EXTENSION_NAME);
+
+		XrInstanceCreateInfo ici = {};
+		ici.type = XR_TYPE_INSTANCE_CREATE_INFO;
+		snprintf(ici.applicationInfo.applicationName, XR_MAX_APPLICATION_NAME_SIZE, "tests_oxr_headless");
+		ici.applicationInfo.apiVersion = XR_CURRENT_API_VERSION;
+		ici.enabledExtensionCount = (uint32_t)extensions.size();
+		ici.enabledExtensionNames = extensions.data();
+		REQUIRE(oxr_xrCreateInstance(&ici, &instance) == XR_SUCCESS);
+
+		XrSystemGetInfo sgi = {};
+		sgi.type = XR_TYPE_SYSTEM_GET_INFO;
+		sgi.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+		REQUIRE(oxr_xrGetSystem(instance, &sgi, &system_id) == XR_SUCCESS);
+
+		REQUIRE(oxr_xrStringToPath(instance, "/user/hand/left", &hands[0]) == XR_SUCCESS);
+		REQUIRE(oxr_xrStringToPath(instance, "/user/hand/right", &hands[1]) == XR_SUCCESS);
+
+		create_actions(action_count, set_count);
+		suggest_bindings();
+	}
+
+	~app()
+	{
+		// Takes all children with it.
+		oxr_xrDestroyInstance(instance);
+	}
+
+	void
+	create_actions(uint32_t action_count, uint32_t set_count)
+	{
+		for (uint32_t i = 0; i < set_count; i++) {
+			XrActionSetCreateInfo asci = {};
+			asci.type = XR_TYPE_ACTION_SET_CREATE_INFO;
+			snprintf(asci.actionSetName, sizeof(asci.actionSetName), "set_%u", i);
+			snprintf(asci.localizedActionSetName, sizeof(asci.localizedActionSetName), "Set %u", i);
+			asci.priority = i;
+
+			XrActionSet set = XR_NULL_HANDLE;
+			REQUIRE(oxr_xrCreateActionSet(instance, &asci, &set) == XR_SUCCESS);
+			sets.push_back(set);
+		}
+
+		// Cycle through the types of the controller bindings.
+		const profile_template &templ = controller_template();
+		for (uint32_t i = 0; i < action_count; i++) {
+			const binding_template &b = templ.bindings[i % templ.binding_count];
+
+			XrActionCreateInfo aci = {};
+			aci.type = XR_TYPE_ACTION_CREATE_INFO;
+			snprintf(aci.actionName, sizeof(aci.actionName), "action_%u", i);
+			snprintf(aci.localizedActionName, sizeof(aci.localizedActionName), "Action %u", i);
+			aci.actionType = action_type(b);
+			aci.countSubactionPaths = 2;
+			aci.subactionPaths = hands;
+
+			XrAction action = XR_NULL_HANDLE;
+			REQUIRE(oxr_xrCreateAction(sets[i % set_count], &aci, &action) == XR_SUCCESS);
+			actions.push_back(action);
+			types.push_back(aci.actionType);
+		}
+	}
+
+	static XrActionType
+	action_type(const binding_template &b)
+	{
+		if (b.output != 0) {
+			return XR_ACTION_TYPE_VIBRATION_OUTPUT;
+		}
+
+		switch (XRT_GET_INPUT_TYPE(b.input)) {
+		case XRT_INPUT_TYPE_BOOLEAN: return XR_ACTION_TYPE_BOOLEAN_INPUT;
+		case XRT_INPUT_TYPE_VEC1_ZERO_TO_ONE:
+		case XRT_INPUT_TYPE_VEC1_MINUS_ONE_TO_ONE: return XR_ACTION_TYPE_FLOAT_INPUT;
+		case XRT_INPUT_TYPE_VEC2_MINUS_ONE_TO_ONE: return XR_ACTION_TYPE_VECTOR2F_INPUT;
+		default: return XR_ACTION_TYPE_POSE_INPUT;
+		}
+	}
+
+	//! Every action is bound to a binding of its type in every profile.
+	void
+	suggest_bindings()
+	{
+		for (const profile_template &templ : profile_templates) {
+			std::vector<XrActionSuggestedBinding> bindings;
+
+			for (size_t i = 0; i < actions.size(); i++) {
+				for (size_t k = 0; k < templ.binding_count; k++) {
+					const binding_template &b = templ.bindings[(i + k) % templ.binding_count];
+					if (action_type(b) != types[i] || b.paths[0] == nullptr) {
+						continue;
+					}
+
+					XrPath path = XR_NULL_PATH;
+					REQUIRE(oxr_xrStringToPath(instance, b.paths[0], &path) == XR_SUCCESS);
+					bindings.push_back({actions[i], path});
+					break;
+				}
+			}
+
+			XrPath profile = XR_NULL_PATH;
+			REQUIRE(oxr_xrStringToPath(instance, templ.path, &profile) == XR_SUCCESS);
+
+			XrInteractionProfileSuggestedBinding ipsb = {};
+			ipsb.type = XR_TYPE_INTERACTION_PROFILE_SUGGESTED_BINDING;
+			ipsb.interactionProfile = profile;
+			ipsb.countSuggestedBindings = (uint32_t)bindings.size();
+			ipsb.suggestedBindings = bindings.data();
+			if (oxr_xrSuggestInteractionProfileBindings(instance, &ipsb) == XR_SUCCESS) {
+				profile_count++;
+			}
+		}
+	}
+
+	//! Creates the session and attaches all sets, it is not begun.
+	void
+	create_session(bool incremental)
+	{
+		REQUIRE(session == XR_NULL_HANDLE);
+
+		XrSessionCreateInfo sci = {};
+		sci.type = XR_TYPE_SESSION_CREATE_INFO;
+		sci.systemId = system_id;
+		REQUIRE(oxr_xrCreateSession(instance, &sci, &session) == XR_SUCCESS);
+
+		XrSessionActionSetsAttachInfo sasai = {};
+		sasai.type = XR_TYPE_SESSION_ACTION_SETS_ATTACH_INFO;
+		sasai.countActionSets = (uint32_t)sets.size();
+		sasai.actionSets = sets.data();
+		REQUIRE(oxr_xrAttachSessionActionSets(session, &sasai) == XR_SUCCESS);
+
+		sess()->action_sync.incremental = incremental;
+	}
+
+	void
+	destroy_session()
+	{
+		oxr_xrDestroySession(session);
+		session = XR_NULL_HANDLE;
+	}
+
+	oxr_session *
+	sess()
+	{
+		return (oxr_session *)(uintptr_t)session;
+	}
+
+	//! Syncs the first @p count sets, all of them if zero.
+	XrResult
+	sync(uint32_t count = 0)
+	{
+		XrActiveActionSet active[16] = {};
+		count = count == 0 ? (uint32_t)sets.size() : count;
+		for (uint32_t i = 0; i < count; i++) {
+			active[i].actionSet = sets[i];
+		}
+
+		XrActionsSyncInfo asi = {};
+		asi.type = XR_TYPE_ACTIONS_SYNC_INFO;
+		asi.countActiveActionSets = count;
+		asi.activeActionSets = active;
+		return oxr_xrSyncActions(session, &asi);
+	}
+
+	//! The state of every input action, for any and both hands.
+	void
+	read_states(std::vector<action_state> &out)
+	{
+		for (size_t i = 0; i < actions.size(); i++) {
+			for (XrPath subaction_path : {(XrPath)XR_NULL_PATH, hands[0], hands[1]}) {
+				XrActionStateGetInfo gi = {};
+				gi.type = XR_TYPE_ACTION_STATE_GET_INFO;
+				gi.action = actions[i];
+				gi.subactionPath = subaction_path;
+
+				action_state s = {};
+				switch (types[i]) {
+				case XR_ACTION_TYPE_BOOLEAN_INPUT: {
+					XrActionStateBoolean d = {};
+					d.type = XR_TYPE_ACTION_STATE_BOOLEAN;
+					oxr_xrGetActionStateBoolean(session, &gi, &d);
+					s = {d.isActive, d.changedSinceLastSync, d.lastChangeTime, (float)d.currentState, 0};
+				} break;
+				case XR_ACTION_TYPE_FLOAT_INPUT: {
+					XrActionStateFloat d = {};
+					d.type = XR_TYPE_ACTION_STATE_FLOAT;
+					oxr_xrGetActionStateFloat(session, &gi, &d);
+					s = {d.isActive, d.changedSinceLastSync, d.lastChangeTime, d.currentState, 0};
+				} break;
+				case XR_ACTION_TYPE_VECTOR2F_INPUT: {
+					XrActionStateVector2f d = {};
+					d.type = XR_TYPE_ACTION_STATE_VECTOR2F;
+					oxr_xrGetActionStateVector2f(session, &gi, &d);
+					s = {d.isActive, d.changedSinceLastSync, d.lastChangeTime, d.currentState.x,
+					     d.currentState.y};
+				} break;
+				default: continue;
+				}
+				out.push_back(s);
+			}
+		}
+	}
+};
+
+} // namespace
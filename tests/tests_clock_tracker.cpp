@@ -0,0 +1,294 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Clock tracker tests on synthetic timestamp streams.
+ *
+ * The comparison with the old smoothing is hidden, run it with
+ * `tests_clock_tracker "[.benchmark]"`.
+ */
+
+#include "math/m_clock_tracker.h"
+
+#include "catch/catch.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+
+
+namespace {
+
+/*!
+ * A device clock sampled at a fixed rate, the host clock runs at a slightly
+ * different rate and the samples arrive with a random transport delay.
+ */
+struct stream
+{
+	double rate_hz = 1000.0;
+	double skew_ppm = 0.0;
+	timepoint_ns offset_ns = 3 * (timepoint_ns)U_TIME_1S_IN_NS;
+
+	//! Fixed part of the transport delay.
+	double min_delay_ns = 150e3;
+
+	//! Mean of the exponential part of the transport delay.
+	double jitter_ns = 0.0;
+
+	//! Chance of a sample getting stuck, for 2 to 20 ms.
+	double spike_chance = 0.0;
+
+	std::mt19937 rng{1337};
+	uint64_t index = 0;
+
+	//! Device time of sample @p i.
+	timepoint_ns
+	device_ts(uint64_t i) const
+	{
+		return (timepoint_ns)((double)i * 1e9 / rate_hz);
+	}
+
+	//! Host time of device time @p a plus the mean delay, what the tracker should give.
+	timepoint_ns
+	expected_b(timepoint_ns a) const
+	{
+		return offset_ns + a + (timepoint_ns)((double)a * skew_ppm * 1e-6) +
+		       (timepoint_ns)(min_delay_ns + jitter_ns);
+	}
+
+	void
+	next(timepoint_ns *out_a, timepoint_ns *out_b)
+	{
+		timepoint_ns a = device_ts(index++);
+		double delay = min_delay_ns;
+		if (jitter_ns > 0) {
+			delay += std::exponential_distribution<double>(1.0 / jitter_ns)(rng);
+		}
+		if (spike_chance > 0 && std::uniform_real_distribution<double>(0, 1)(rng) < spike_chance) {
+			delay += std::uniform_real_distribution<double>(2e6, 20e6)(rng);
+		}
+
+		*out_a = a;
+		*out_b = offset_ns + a + (timepoint_ns)((double)a * skew_ppm * 1e-6) + (timepoint_ns)delay;
+	}
+};
+
+//! The smoothing the drivers used before, kept to compare with.
+timepoint_ns
+old_clock_offset_a2b(double freq, timepoint_ns a, timepoint_ns b, time_duration_ns *inout_a2b)
+{
+	const double alpha = 1.0 - 12.5 / freq;
+	time_duration_ns old_a2b = *inout_a2b;
+	time_duration_ns got_a2b = b - a;
+	time_duration_ns new_a2b = old_a2b * alpha + got_a2b * (1.0 - alpha);
+	if (old_a2b == 0) {
+		new_a2b = got_a2b;
+	}
+	*inout_a2b = new_a2b;
+	return a + new_a2b;
+}
+
+struct error_stats
+{
+	double sum_sq = 0;
+	double max = 0;
+	uint64_t count = 0;
+
+	void
+	add(double err)
+	{
+		sum_sq += err * err;
+		max = std::max(max, std::fabs(err));
+		count++;
+	}
+
+	double
+	rms() const
+	{
+		return count > 0 ? std::sqrt(sum_sq / count) : 0;
+	}
+};
+
+/*!
+ * Runs @p seconds of the stream through the tracker, measures the error of
+ * the converted timestamps after @p settle_s seconds.
+ */
+error_stats
+run(stream &s, m_clock_tracker &ct, double seconds, double settle_s)
+{
+	error_stats err;
+	uint64_t count = (uint64_t)(seconds * s.rate_hz);
+	for (uint64_t i = 0; i < count; i++) {
+		timepoint_ns a, b;
+		s.next(&a, &b);
+		m_clock_tracker_update(&ct, a, b);
+
+		if (a >= (timepoint_ns)(settle_s * U_TIME_1S_IN_NS)) {
+			err.add((double)(m_clock_tracker_a2b(&ct, a) - s.expected_b(a)));
+		}
+	}
+	return err;
+}
+
+} // namespace
+
+
+TEST_CASE("m_clock_tracker exact")
+{
+	m_clock_tracker ct;
+	m_clock_tracker_init(&ct, 5.0);
+
+	CHECK(m_clock_tracker_a2b(&ct, 1234) == 1234);
+
+	stream s;
+	s.min_delay_ns = 0;
+	error_stats err = run(s, ct, 2.0, 0.0);
+	CHECK(err.max <= 1.0);
+	CHECK(m_clock_tracker_is_converged(&ct));
+	CHECK(ct.stats.outlier_count == 0);
+
+	// And back again.
+	timepoint_ns a = s.device_ts(s.index + 5);
+	CHECK(std::llabs(m_clock_tracker_b2a(&ct, m_clock_tracker_a2b(&ct, a)) - a) <= 1);
+}
+
+TEST_CASE("m_clock_tracker drift and jitter")
+{
+	m_clock_tracker ct;
+	m_clock_tracker_init(&ct, 5.0);
+
+	stream s;
+	s.skew_ppm = 80.0;
+	s.jitter_ns = 300e3;
+
+	error_stats err = run(s, ct, 30.0, 10.0);
+	INFO("rms " << err.rms() << " ns, max " << err.max << " ns, skew " << ct.stats.skew_ppm << " ppm");
+
+	CHECK(m_clock_tracker_is_converged(&ct));
+	CHECK(err.rms() < 20e3);
+	CHECK(err.max < 50e3);
+	CHECK(std::fabs(ct.stats.skew_ppm - s.skew_ppm) < 5.0);
+	CHECK(ct.stats.jitter_ns > 100e3);
+}
+
+TEST_CASE("m_clock_tracker outliers")
+{
+	m_clock_tracker ct;
+	m_clock_tracker_init(&ct, 5.0);
+
+	stream s;
+	s.skew_ppm = -40.0;
+	s.jitter_ns = 100e3;
+	s.spike_chance = 0.02;
+
+	error_stats err = run(s, ct, 30.0, 10.0);
+	INFO("rms " << err.rms() << " ns, max " << err.max << " ns");
+
+	CHECK(ct.stats.outlier_count > 0);
+	CHECK(ct.stats.reset_count == 0);
+	CHECK(err.max < 50e3);
+}
+
+TEST_CASE("m_clock_tracker clock jump")
+{
+	m_clock_tracker ct;
+	m_clock_tracker_init(&ct, 5.0);
+
+	stream s;
+	s.jitter_ns = 100e3;
+	run(s, ct, 5.0, 5.0);
+	REQUIRE(m_clock_tracker_is_converged(&ct));
+
+	// The host clock jumps 100 ms ahead, the tracker should restart.
+	s.offset_ns += 100 * U_TIME_1MS_IN_NS;
+	double settle_s = (double)s.device_ts(s.index) / 1e9 + 1.0;
+	error_stats err = run(s, ct, 5.0, settle_s);
+
+	CHECK(ct.stats.reset_count == 1);
+	CHECK(m_clock_tracker_is_converged(&ct));
+	CHECK(err.max < 100e3);
+}
+
+TEST_CASE("m_clock_tracker concurrent reads")
+{
+	m_clock_tracker ct;
+	m_clock_tracker_init(&ct, 5.0);
+
+	// No jitter and no skew, every published mapping must have the exact offset.
+	const timepoint_ns offset = 3 * (timepoint_ns)U_TIME_1S_IN_NS;
+	m_clock_tracker_update(&ct, 0, offset);
+
+	std::atomic<bool> done{false};
+	std::atomic<uint64_t> torn{0};
+	std::atomic<uint64_t> reads{0};
+
+	std::thread reader([&]() {
+		while (!done) {
+			m_clock_tracker_mapping m;
+			m_clock_tracker_get_mapping(&ct, &m);
+			if (!m.valid || m.b_ref - m.a_ref != offset) {
+				torn++;
+			}
+			reads++;
+		}
+	});
+
+	for (timepoint_ns a = 1; a < 200000 || reads < 1000; a++) {
+		m_clock_tracker_update(&ct, a * 1000, a * 1000 + offset);
+	}
+	done = true;
+	reader.join();
+
+	CHECK(torn == 0);
+}
+
+TEST_CASE("m_clock_tracker compared to old smoothing", "[.benchmark]")
+{
+	struct Case
+	{
+		const char *name;
+		double skew_ppm;
+		double jitter_ns;
+		double spike_chance;
+	};
+	const Case cases[] = {
+	    {"jitter", 0, 300e3, 0},
+	    {"drift", 100, 300e3, 0},
+	    {"spikes", 100, 300e3, 0.02},
+	};
+
+	std::cout << std::left << std::setw(10) << "stream" << std::right << std::setw(14) << "old rms (us)"
+	          << std::setw(14) << "old max (us)" << std::setw(14) << "new rms (us)" << std::setw(14)
+	          << "new max (us)" << std::endl;
+
+	for (const Case &c : cases) {
+		stream s_old, s_new;
+		for (stream *s : {&s_old, &s_new}) {
+			s->skew_ppm = c.skew_ppm;
+			s->jitter_ns = c.jitter_ns;
+			s->spike_chance = c.spike_chance;
+		}
+
+		error_stats old_err;
+		time_duration_ns a2b = 0;
+		for (uint64_t i = 0; i < 60 * 1000; i++) {
+			timepoint_ns a, b;
+			s_old.next(&a, &b);
+			timepoint_ns got = old_clock_offset_a2b(s_old.rate_hz, a, b, &a2b);
+			if (a >= 10 * (timepoint_ns)U_TIME_1S_IN_NS) {
+				old_err.add((double)(got - s_old.expected_b(a)));
+			}
+		}
+
+		m_clock_tracker ct;
+		m_clock_tracker_init(&ct, 5.0);
+		error_stats new_err = run(s_new, ct, 60.0, 10.0);
+
+		std::cout << std::left << std::setw(10) << c.name << std::right << std::fixed << std::setprecision(1)
+		          << std::setw(14) << old_err.rms() / 1e3 << std::setw(14) << old_err.max / 1e3
+		          << std::setw(14) << new_err.rms() / 1e3 << std::setw(14) << new_err.max / 1e3 << std::endl;
+	}
+}
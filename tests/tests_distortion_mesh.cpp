@@ -0,0 +1,316 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Distortion grid sampling and cache tests and benchmark.
+ *
+ * The benchmark is hidden, run it with `tests_distortion_mesh "[.benchmark]"`.
+ */
+
+#include "xrt/xrt_config_os.h"
+#include "xrt/xrt_device.h"
+#include "util/u_worker.h"
+#include "util/u_distortion_mesh.h"
+#include "math/m_api.h"
+
+#include "catch/catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+/*!
+ * A device with a radial distortion that is inverted with a fixed number of
+ * Newton steps per sample, the cost knob stands in for the expensive models.
+ */
+struct fake_device
+{
+	xrt_device base = {};
+	xrt_hmd_parts hmd = {};
+
+	float k1 = 0.22f;
+	float k2 = 0.24f;
+	int iterations = 4;
+	bool fail = false;
+
+	std::atomic<uint32_t> calls{0};
+
+	//! Set if the function was called from any thread but the creating one.
+	std::thread::id owner = std::this_thread::get_id();
+	std::atomic<bool> other_thread{false};
+
+	fake_device(const char *serial)
+	{
+		base.hmd = &hmd;
+		base.compute_distortion = compute;
+		hmd.distortion.compute_thread_safe = true;
+		snprintf(base.str, sizeof(base.str), "Fake HMD");
+		snprintf(base.serial, sizeof(base.serial), "%s", serial);
+	}
+
+	static bool
+	compute(xrt_device *xdev, int view, float u, float v, xrt_uv_triplet *result)
+	{
+		fake_device *d = (fake_device *)xdev;
+		d->calls++;
+		if (std::this_thread::get_id() != d->owner) {
+			d->other_thread = true;
+		}
+
+		if (d->fail && u > 0.5f) {
+			return false;
+		}
+
+		float x = u * 2.f - 1.f + (view == 0 ? 0.05f : -0.05f);
+		float y = v * 2.f - 1.f;
+		float target = std::sqrt(x * x + y * y);
+
+		// Solve r * (1 + k1 r^2 + k2 r^4) = target for r.
+		float r = target;
+		for (int i = 0; i < d->iterations; i++) {
+			float r2 = r * r;
+			float f = r * (1.f + d->k1 * r2 + d->k2 * r2 * r2) - target;
+			float df = 1.f + 3.f * d->k1 * r2 + 5.f * d->k2 * r2 * r2;
+			r -= f / df;
+		}
+
+		float scale = target > 0.f ? r / target : 1.f;
+		float aberration[3] = {0.99f, 1.f, 1.01f};
+		xrt_vec2 *out[3] = {&result->r, &result->g, &result->b};
+		for (int i = 0; i < 3; i++) {
+			out[i]->x = x * scale * aberration[i] * 0.5f + 0.5f;
+			out[i]->y = y * scale * aberration[i] * 0.5f + 0.5f;
+		}
+
+		return true;
+	}
+};
+
+//! Points the cache at a fresh directory and turns it on, once per process.
+void
+use_temp_cache_dir()
+{
+#ifdef XRT_OS_LINUX
+	static std::string dir;
+	if (!dir.empty()) {
+		return;
+	}
+
+	char tmpl[] = "/tmp/monado_tests_distortion_XXXXXX";
+	REQUIRE(mkdtemp(tmpl) != nullptr);
+	dir = tmpl;
+	setenv("XDG_CACHE_HOME", dir.c_str(), 1);
+
+	// Off by default, read once.
+	setenv("XRT_MESH_CACHE", "true", 1);
+#endif
+}
+
+std::vector<xrt_uv_triplet>
+sample_serial(fake_device &dev, int view, uint32_t cols, uint32_t rows, const xrt_matrix_2x2 *rot = nullptr)
+{
+	std::vector<xrt_uv_triplet> ret(cols * rows);
+	for (uint32_t r = 0; r < rows; r++) {
+		for (uint32_t c = 0; c < cols; c++) {
+			xrt_vec2 uv = {(float)c / (float)(cols - 1), (float)r / (float)(rows - 1)};
+			if (rot != nullptr) {
+				uv = {uv.x - 0.5f, uv.y - 0.5f};
+				math_matrix_2x2_transform_vec2(rot, &uv, &uv);
+				uv = {uv.x + 0.5f, uv.y + 0.5f};
+			}
+			fake_device::compute(&dev.base, view, uv.x, uv.y, &ret[r * cols + c]);
+		}
+	}
+	return ret;
+}
+
+bool
+same_bits(const std::vector<xrt_uv_triplet> &a, const std::vector<xrt_uv_triplet> &b)
+{
+	return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) == 0;
+}
+
+} // namespace
+
+
+TEST_CASE("u_distortion_mesh sample grid")
+{
+	use_temp_cache_dir();
+
+	fake_device dev("sample grid");
+	const uint32_t cols = 65;
+	const uint32_t rows = 65;
+
+	std::vector<xrt_uv_triplet> expected = sample_serial(dev, 1, cols, rows);
+	std::vector<xrt_uv_triplet> out(cols * rows);
+
+	u_worker_group *uwg = u_distortion_mesh_create_group(&dev.base);
+	REQUIRE(uwg != nullptr);
+
+	// Cold, evaluated in parallel.
+	dev.calls = 0;
+	REQUIRE(u_distortion_mesh_sample_grid(&dev.base, 1, cols, rows, nullptr, uwg, out.data()));
+	CHECK(same_bits(expected, out));
+	CHECK(dev.calls >= cols * rows);
+
+#ifdef XRT_OS_LINUX
+	// Warm, only the fingerprint is evaluated.
+	dev.calls = 0;
+	out.assign(out.size(), {});
+	REQUIRE(u_distortion_mesh_sample_grid(&dev.base, 1, cols, rows, nullptr, uwg, out.data()));
+	CHECK(same_bits(expected, out));
+	CHECK(dev.calls < 100);
+
+	// Changed parameters miss the cache.
+	dev.k1 = 0.25f;
+	expected = sample_serial(dev, 1, cols, rows);
+	dev.calls = 0;
+	REQUIRE(u_distortion_mesh_sample_grid(&dev.base, 1, cols, rows, nullptr, uwg, out.data()));
+	CHECK(same_bits(expected, out));
+	CHECK(dev.calls >= cols * rows);
+#endif
+
+	// A rotated grid gets its own cache entry.
+	const xrt_matrix_2x2 rot = {{{0, 1, -1, 0}}};
+	expected = sample_serial(dev, 1, cols, rows, &rot);
+	REQUIRE(u_distortion_mesh_sample_grid(&dev.base, 1, cols, rows, &rot, uwg, out.data()));
+	CHECK(same_bits(expected, out));
+
+	dev.fail = true;
+	CHECK_FALSE(u_distortion_mesh_sample_grid(&dev.base, 0, cols, rows, nullptr, uwg, out.data()));
+
+	u_worker_group_reference(&uwg, nullptr);
+}
+
+TEST_CASE("u_distortion_mesh only threads when the device allows it")
+{
+	use_temp_cache_dir();
+
+	fake_device dev("not thread safe");
+	dev.hmd.distortion.compute_thread_safe = false;
+	CHECK(u_distortion_mesh_create_group(&dev.base) == nullptr);
+
+	u_distortion_mesh_fill_in_compute(&dev.base);
+	REQUIRE(dev.hmd.distortion.mesh.vertices != nullptr);
+	CHECK_FALSE(dev.other_thread);
+	free(dev.hmd.distortion.mesh.vertices);
+	free(dev.hmd.distortion.mesh.indices);
+
+	// The caller may still end up doing every band itself, just check the group.
+	fake_device safe("thread safe");
+	u_worker_group *uwg = u_distortion_mesh_create_group(&safe.base);
+	CHECK(uwg != nullptr);
+	u_worker_group_reference(&uwg, nullptr);
+}
+
+TEST_CASE("u_distortion_mesh fill in compute")
+{
+	use_temp_cache_dir();
+
+	// The default XRT_MESH_SIZE.
+	const uint32_t num = 64;
+	const uint32_t verts_per_view = (num + 1) * (num + 1);
+	const uint32_t stride_in_floats = 2 + 3 * 2;
+
+	fake_device dev("fill in compute");
+
+	// Cold, then warm from the cache.
+	std::vector<float> meshes[2];
+	for (std::vector<float> &mesh : meshes) {
+		dev.hmd = {};
+		dev.hmd.distortion.compute_thread_safe = true;
+		u_distortion_mesh_fill_in_compute(&dev.base);
+
+		auto &m = dev.hmd.distortion.mesh;
+		REQUIRE(m.vertices != nullptr);
+		REQUIRE(m.vertex_count == verts_per_view * 2);
+		CHECK(m.stride == stride_in_floats * sizeof(float));
+		CHECK((dev.hmd.distortion.models & XRT_DISTORTION_MODEL_MESHUV) != 0);
+
+		mesh.assign(m.vertices, m.vertices + m.vertex_count * stride_in_floats);
+		free(m.vertices);
+		free(m.indices);
+	}
+
+	// Don't let Catch print the whole meshes.
+	bool equal = meshes[0] == meshes[1];
+	CHECK(equal);
+
+	// Spot check against the function, bottom right vertex of the second view.
+	xrt_uv_triplet expected;
+	fake_device::compute(&dev.base, 1, 1.f, 1.f, &expected);
+	const float *last = &meshes[0][(verts_per_view * 2 - 1) * stride_in_floats];
+	CHECK(last[0] == 1.f);
+	CHECK(last[1] == 1.f);
+	CHECK(memcmp(&last[2], &expected, sizeof(expected)) == 0);
+
+	SECTION("Failure leaves the mesh alone")
+	{
+		fake_device failing("fill in compute failing");
+		failing.fail = true;
+		u_distortion_mesh_fill_in_compute(&failing.base);
+		CHECK(failing.hmd.distortion.mesh.vertices == nullptr);
+		CHECK(failing.hmd.distortion.models == 0);
+	}
+}
+
+TEST_CASE("u_distortion_mesh benchmark", "[.benchmark]")
+{
+	using clock = std::chrono::steady_clock;
+
+	use_temp_cache_dir();
+
+	struct Grid
+	{
+		const char *name;
+		uint32_t size;
+	};
+	const Grid grids[] = {{"mesh", 65}, {"compute", 128}};
+
+	std::cout << std::left << std::setw(10) << "grid" << std::right << std::setw(12) << "iterations"
+	          << std::setw(14) << "serial (ms)" << std::setw(14) << "cold (ms)" << std::setw(14) << "warm (ms)"
+	          << std::endl;
+
+	int run = 0;
+	for (const Grid &grid : grids) {
+		for (int iterations : {4, 64, 512}) {
+			// A new serial per run gives a new cache key, so the first run is cold.
+			std::string serial = "benchmark " + std::to_string(run++);
+			fake_device dev(serial.c_str());
+			dev.iterations = iterations;
+
+			std::vector<xrt_uv_triplet> out(grid.size * grid.size);
+			u_worker_group *uwg = u_distortion_mesh_create_group(&dev.base);
+			double ms[3];
+
+			auto start = clock::now();
+			std::vector<xrt_uv_triplet> serial_out = sample_serial(dev, 0, grid.size, grid.size);
+			ms[0] = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+			for (int i = 1; i < 3; i++) {
+				start = clock::now();
+				REQUIRE(u_distortion_mesh_sample_grid(&dev.base, 0, grid.size, grid.size, nullptr, uwg,
+				                                      out.data()));
+				ms[i] = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+				CHECK(same_bits(serial_out, out));
+			}
+
+			std::cout << std::left << std::setw(10) << grid.name << std::right << std::setw(12) << iterations
+			          << std::fixed << std::setprecision(2) << std::setw(14) << ms[0] << std::setw(14)
+			          << ms[1] << std::setw(14) << ms[2] << std::endl;
+
+			u_worker_group_reference(&uwg, nullptr);
+		}
+	}
+}
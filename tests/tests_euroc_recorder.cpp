@@ -0,0 +1,277 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief EuRoC recorder round trip tests.
+ */
+
+#include "tracking/t_euroc_recorder.h"
+#include "euroc/euroc_interface.h"
+
+#include "os/os_time.h"
+#include "util/u_frame.h"
+#include "util/u_time.h"
+
+#include "catch/catch.hpp"
+
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+
+namespace {
+
+constexpr uint32_t kWidth = 64;
+constexpr uint32_t kHeight = 48;
+constexpr int kFrameCount = 20;
+constexpr uint64_t kFramePeriodNs = 50 * 1000 * 1000;
+
+/*!
+ * A new directory in the temp directory, removed with everything in it when
+ * this goes out of scope, so runs never see each other's files.
+ */
+struct TempDir
+{
+	std::string path;
+
+	TempDir()
+	{
+		std::string tmpl = (std::filesystem::temp_directory_path() / "monado_tests_euroc_XXXXXX").string();
+		REQUIRE(mkdtemp(&tmpl[0]) != nullptr);
+		path = tmpl;
+	}
+
+	~TempDir()
+	{
+		std::error_code ec;
+		std::filesystem::remove_all(path, ec);
+	}
+};
+
+uint8_t
+pixel(bool is_left, int frame, uint32_t x, uint32_t y)
+{
+	return (uint8_t)(x * 3 + y * 5 + frame * 7 + (is_left ? 0 : 11));
+}
+
+xrt_frame *
+make_frame(bool is_left, int frame)
+{
+	xrt_frame *xf = nullptr;
+	u_frame_create_one_off(XRT_FORMAT_L8, kWidth, kHeight, &xf);
+	REQUIRE(xf != nullptr);
+
+	for (uint32_t y = 0; y < kHeight; y++) {
+		for (uint32_t x = 0; x < kWidth; x++) {
+			xf->data[y * xf->stride + x] = pixel(is_left, frame, x, y);
+		}
+	}
+	xf->timestamp = (frame + 1) * kFramePeriodNs;
+
+	return xf;
+}
+
+/*!
+ * Checks frames coming out of the player against the pattern they were
+ * recorded with.
+ */
+struct CheckSink
+{
+	xrt_frame_sink base = {};
+	bool is_left;
+	std::mutex lock;
+	int count = 0;
+	int mismatches = 0;
+
+	CheckSink(bool is_left) : is_left(is_left)
+	{
+		base.push_frame = push;
+	}
+
+	static void
+	push(xrt_frame_sink *xfs, xrt_frame *xf)
+	{
+		CheckSink *cs = reinterpret_cast<CheckSink *>(xfs);
+		int frame = (int)(xf->timestamp / kFramePeriodNs) - 1;
+
+		bool same = xf->format == XRT_FORMAT_L8 && xf->width == kWidth && xf->height == kHeight;
+		for (uint32_t y = 0; same && y < kHeight; y++) {
+			for (uint32_t x = 0; x < kWidth; x++) {
+				same = same && xf->data[y * xf->stride + x] == pixel(cs->is_left, frame, x, y);
+			}
+		}
+
+		std::lock_guard lock{cs->lock};
+		cs->count++;
+		cs->mismatches += same ? 0 : 1;
+	}
+};
+
+/*!
+ * Stop the writers and wait for them to empty the queue, but leave the nodes
+ * around so the counters can still be read.
+ */
+void
+break_apart_nodes(xrt_frame_context *xfctx)
+{
+	for (xrt_frame_node *node = xfctx->nodes; node != nullptr; node = node->next) {
+		node->break_apart(node);
+	}
+}
+
+void
+record_and_play(const euroc_recorder_config &config)
+{
+	TempDir dir;
+	const std::string &path = dir.path;
+
+	// Record
+	{
+		xrt_frame_context xfctx = {};
+		xrt_slam_sinks *sinks = euroc_recorder_create_with_config(&xfctx, path.c_str(), true, &config);
+		REQUIRE(sinks != nullptr);
+
+		for (int i = 0; i < kFrameCount; i++) {
+			// A few IMU samples per frame, the player needs at least one.
+			for (int k = 0; k < 4; k++) {
+				xrt_imu_sample sample = {};
+				sample.timestamp_ns = i * kFramePeriodNs + k * (kFramePeriodNs / 4);
+				sample.accel_m_s2 = {0, 9.8, 0};
+				xrt_sink_push_imu(sinks->imu, &sample);
+			}
+
+			xrt_frame *left = make_frame(true, i);
+			xrt_frame *right = make_frame(false, i);
+			xrt_sink_push_frame(sinks->left, left);
+			xrt_sink_push_frame(sinks->right, right);
+
+			// The sinks took copies.
+			xrt_frame_reference(&left, nullptr);
+			xrt_frame_reference(&right, nullptr);
+
+			// Keep within the queue, the caller is never blocked.
+			euroc_recorder_stats stats = {};
+			for (int tries = 0; tries < 1000; tries++) {
+				euroc_recorder_get_stats(sinks, &stats);
+				if (stats.queued + 2 <= config.queue_size) {
+					break;
+				}
+				os_nanosleep(U_TIME_1MS_IN_NS);
+			}
+		}
+
+		// Destroying the recorder writes out the rest of the queue.
+		euroc_recorder_stats stats = {};
+		euroc_recorder_get_stats(sinks, &stats);
+		CHECK(stats.dropped == 0);
+
+		break_apart_nodes(&xfctx);
+		euroc_recorder_get_stats(sinks, &stats);
+		CHECK(stats.written == kFrameCount * 2);
+		CHECK(stats.failed == 0);
+		CHECK(stats.queued == 0);
+		CHECK(stats.max_queued <= config.queue_size);
+
+		xrt_frame_context_destroy_nodes(&xfctx);
+	}
+
+	// Play back
+	{
+		xrt_frame_context xfctx = {};
+		euroc_player_config ep_config = {};
+		euroc_player_fill_default_config_for(&ep_config, path.c_str());
+		CHECK(ep_config.dataset.is_stereo);
+		CHECK(ep_config.dataset.width == kWidth);
+		CHECK(ep_config.dataset.height == kHeight);
+		ep_config.playback.color = false;
+		ep_config.playback.max_speed = true;
+		ep_config.playback.use_source_ts = true;
+		ep_config.playback.play_from_start = true;
+		ep_config.playback.print_progress = false;
+
+		xrt_fs *xfs = euroc_player_create(&xfctx, path.c_str(), &ep_config);
+		REQUIRE(xfs != nullptr);
+
+		CheckSink left{true};
+		CheckSink right{false};
+		xrt_slam_sinks sinks = {};
+		sinks.left = &left.base;
+		sinks.right = &right.base;
+		REQUIRE(xrt_fs_slam_stream_start(xfs, &sinks));
+
+		for (int tries = 0; tries < 5000; tries++) {
+			std::scoped_lock lock{left.lock, right.lock};
+			if (left.count == kFrameCount && right.count == kFrameCount) {
+				break;
+			}
+			os_nanosleep(U_TIME_1MS_IN_NS);
+		}
+
+		xrt_frame_context_destroy_nodes(&xfctx);
+
+		CHECK(left.count == kFrameCount);
+		CHECK(right.count == kFrameCount);
+		CHECK(left.mismatches == 0);
+		CHECK(right.mismatches == 0);
+	}
+}
+
+} // namespace
+
+
+TEST_CASE("euroc_recorder round trip")
+{
+	euroc_recorder_config config = {};
+	euroc_recorder_default_config(&config);
+	config.thread_count = 3;
+	config.queue_size = 8;
+
+	SECTION("PNG")
+	{
+		config.image_format = EUROC_RECORDER_IMAGE_PNG;
+		config.png_level = 1;
+		record_and_play(config);
+	}
+
+	SECTION("PNM")
+	{
+		config.image_format = EUROC_RECORDER_IMAGE_PNM;
+		record_and_play(config);
+	}
+}
+
+TEST_CASE("euroc_recorder drops when full")
+{
+	TempDir dir;
+	const std::string &path = dir.path;
+
+	euroc_recorder_config config = {};
+	euroc_recorder_default_config(&config);
+	config.thread_count = 1;
+	config.queue_size = 2;
+
+	xrt_frame_context xfctx = {};
+	xrt_slam_sinks *sinks = euroc_recorder_create_with_config(&xfctx, path.c_str(), true, &config);
+	REQUIRE(sinks != nullptr);
+
+	// Push a burst much faster than a single writer can keep up with.
+	for (int i = 0; i < 200; i++) {
+		xrt_frame *xf = make_frame(true, i);
+		xrt_sink_push_frame(sinks->left, xf);
+		xrt_frame_reference(&xf, nullptr);
+	}
+
+	break_apart_nodes(&xfctx);
+
+	euroc_recorder_stats stats = {};
+	euroc_recorder_get_stats(sinks, &stats);
+	CHECK(stats.max_queued <= 2);
+	CHECK(stats.written + stats.dropped + stats.failed == 200);
+	CHECK(stats.failed == 0);
+
+	xrt_frame_context_destroy_nodes(&xfctx);
+}
@@ -0,0 +1,291 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Filter fifo tests and benchmark.
+ *
+ * The benchmark is hidden, run it with `tests_filter_fifo "[.benchmark]"`.
+ */
+
+#include "math/m_filter_fifo.h"
+
+#include "catch/catch.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+/*!
+ * The sample by sample walk the fifo used to do, as a reference.
+ */
+size_t
+naive_filter(m_ff_vec3_f32 *ff, uint64_t start_ns, uint64_t stop_ns, xrt_vec3 *out_average)
+{
+	size_t num = m_ff_vec3_f32_get_num(ff);
+	size_t num_sampled = 0;
+	double x = 0;
+	double y = 0;
+	double z = 0;
+
+	for (size_t i = 0; i < num && start_ns <= stop_ns; i++) {
+		xrt_vec3 sample;
+		uint64_t ts;
+		m_ff_vec3_f32_get(ff, i, &sample, &ts);
+
+		if (ts > stop_ns) {
+			continue;
+		}
+		if (ts < start_ns) {
+			break;
+		}
+
+		x += sample.x;
+		y += sample.y;
+		z += sample.z;
+		num_sampled++;
+	}
+
+	if (num_sampled > 0) {
+		x /= num_sampled;
+		y /= num_sampled;
+		z /= num_sampled;
+	}
+
+	*out_average = {(float)x, (float)y, (float)z};
+
+	return num_sampled;
+}
+
+} // namespace
+
+
+TEST_CASE("m_filter_fifo matches sample walk")
+{
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> value(-10.f, 10.f);
+	std::uniform_int_distribution<uint64_t> step(0, 3);
+
+	const size_t sizes[] = {1, 7, 100};
+
+	for (size_t size : sizes) {
+		INFO("size " << size);
+
+		m_ff_vec3_f32 *ff = nullptr;
+		m_ff_vec3_f32_alloc(&ff, size);
+
+		// Wrap around the ring and rebase the sums several times, with repeated timestamps.
+		uint64_t ts = 1;
+		for (size_t i = 0; i < size * 5 + 3; i++) {
+			xrt_vec3 sample = {value(rng), value(rng), value(rng)};
+			ts += step(rng);
+			m_ff_vec3_f32_push(ff, &sample, ts);
+
+			std::uniform_int_distribution<uint64_t> when(0, ts + 2);
+			for (int k = 0; k < 10; k++) {
+				uint64_t a = when(rng);
+				uint64_t b = when(rng);
+
+				xrt_vec3 expected = {};
+				xrt_vec3 actual = {};
+				size_t expected_num = naive_filter(ff, a, b, &expected);
+				size_t actual_num = m_ff_vec3_f32_filter(ff, a, b, &actual);
+
+				INFO("window " << a << " " << b);
+				REQUIRE(expected_num == actual_num);
+				CHECK(actual.x == Approx(expected.x).margin(1e-4));
+				CHECK(actual.y == Approx(expected.y).margin(1e-4));
+				CHECK(actual.z == Approx(expected.z).margin(1e-4));
+			}
+		}
+
+		m_ff_vec3_f32_free(&ff);
+		CHECK(ff == nullptr);
+	}
+}
+
+TEST_CASE("m_filter_fifo f64")
+{
+	m_ff_f64 *ff = nullptr;
+	m_ff_f64_alloc(&ff, 4);
+
+	for (int i = 1; i <= 6; i++) {
+		double v = i;
+		m_ff_f64_push(ff, &v, i * 10);
+	}
+
+	// Holds 3, 4, 5 and 6.
+	double avg = -1;
+	CHECK(m_ff_f64_filter(ff, 0, 100, &avg) == 4);
+	CHECK(avg == Approx(4.5));
+	CHECK(m_ff_f64_filter(ff, 35, 55, &avg) == 2);
+	CHECK(avg == Approx(4.5));
+	CHECK(m_ff_f64_filter(ff, 40, 40, &avg) == 1);
+	CHECK(avg == Approx(4.0));
+	CHECK(m_ff_f64_filter(ff, 70, 80, &avg) == 0);
+	CHECK(avg == 0.0);
+	CHECK(m_ff_f64_filter(ff, 50, 40, &avg) == 0);
+
+	m_ff_f64_free(&ff);
+}
+
+TEST_CASE("m_filter_fifo drops non-finite samples")
+{
+	m_ff_vec3_f32 *ff = nullptr;
+	m_ff_vec3_f32_alloc(&ff, 8);
+
+	xrt_vec3 two = {2, 2, 2};
+	m_ff_vec3_f32_push(ff, &two, 1);
+	m_ff_vec3_f32_push(ff, &two, 2);
+
+	xrt_vec3 bad = {NAN, 0, 0};
+	m_ff_vec3_f32_push(ff, &bad, 3);
+	xrt_vec3 inf = {0, INFINITY, 0};
+	m_ff_vec3_f32_push(ff, &inf, 4);
+
+	xrt_vec3 sample = {};
+	uint64_t sample_ts = 0;
+	CHECK(m_ff_vec3_f32_get(ff, 0, &sample, &sample_ts));
+	CHECK(sample_ts == 2);
+
+	// Before the sums are recomputed, so nothing can have been washed out.
+	xrt_vec3 one = {1, 1, 1};
+	m_ff_vec3_f32_push(ff, &one, 5);
+
+	xrt_vec3 avg = {};
+	CHECK(m_ff_vec3_f32_filter(ff, 5, 5, &avg) == 1);
+	CHECK(avg.x == 1.0f);
+	CHECK(m_ff_vec3_f32_filter(ff, 1, 5, &avg) == 3);
+	CHECK(avg.x == Approx(5.0f / 3.0f));
+	CHECK(avg.y == Approx(5.0f / 3.0f));
+
+	double bad_f64 = NAN;
+	double one_f64 = 1.0;
+	m_ff_f64 *ff_f64 = nullptr;
+	m_ff_f64_alloc(&ff_f64, 8);
+	m_ff_f64_push(ff_f64, &one_f64, 1);
+	m_ff_f64_push(ff_f64, &bad_f64, 2);
+	m_ff_f64_push(ff_f64, &one_f64, 3);
+
+	double avg_f64 = 0;
+	CHECK(m_ff_f64_filter(ff_f64, 1, 3, &avg_f64) == 2);
+	CHECK(avg_f64 == 1.0);
+
+	m_ff_f64_free(&ff_f64);
+	m_ff_vec3_f32_free(&ff);
+}
+
+TEST_CASE("m_filter_fifo recovers from NaN")
+{
+	m_ff_vec3_f32 *ff = nullptr;
+	m_ff_vec3_f32_alloc(&ff, 8);
+
+	xrt_vec3 bad = {NAN, 0, 0};
+	m_ff_vec3_f32_push(ff, &bad, 1);
+
+	xrt_vec3 one = {1, 1, 1};
+	uint64_t ts = 2;
+	for (; ts < 20; ts++) {
+		m_ff_vec3_f32_push(ff, &one, ts);
+	}
+
+	xrt_vec3 avg = {};
+	CHECK(m_ff_vec3_f32_filter(ff, ts - 4, ts, &avg) == 4);
+	CHECK(avg.x == 1.0f);
+	CHECK(avg.y == 1.0f);
+
+	m_ff_vec3_f32_free(&ff);
+}
+
+TEST_CASE("m_filter_fifo quat")
+{
+	m_ff_quat_f32 *ff = nullptr;
+	m_ff_quat_f32_alloc(&ff, 16);
+
+	// Rotations around Y from -10 to 10 degrees, every other one negated.
+	uint64_t ts = 100;
+	for (int deg = -10; deg <= 10; deg += 5) {
+		float half = (float)(deg * M_PI / 180.0 / 2.0);
+		float sign = (deg / 5) % 2 == 0 ? 1.f : -1.f;
+		xrt_quat q = {0.f, sign * std::sin(half), 0.f, sign * std::cos(half)};
+		m_ff_quat_f32_push(ff, &q, ts++);
+	}
+
+	xrt_quat avg = {};
+	CHECK(m_ff_quat_f32_filter(ff, 100, ts, &avg) == 5);
+
+	// Symmetric around identity, in either hemisphere.
+	CHECK(std::abs(avg.w) == Approx(1.0f));
+	CHECK(avg.x == Approx(0.0f).margin(1e-6));
+	CHECK(avg.y == Approx(0.0f).margin(1e-6));
+	CHECK(avg.z == Approx(0.0f).margin(1e-6));
+
+	// Only the last two, 5 and 10 degrees, so 7.5 degrees.
+	CHECK(m_ff_quat_f32_filter(ff, ts - 2, ts, &avg) == 2);
+	double angle = 2.0 * std::atan2(std::abs(avg.y), std::abs(avg.w)) * 180.0 / M_PI;
+	CHECK(angle == Approx(7.5).epsilon(1e-3));
+
+	// Nothing there.
+	CHECK(m_ff_quat_f32_filter(ff, ts + 10, ts + 20, &avg) == 0);
+	CHECK(avg.w == 1.0f);
+
+	m_ff_quat_f32_free(&ff);
+}
+
+TEST_CASE("m_filter_fifo benchmark", "[.benchmark]")
+{
+	using clock = std::chrono::steady_clock;
+
+	std::cout << std::left << std::setw(10) << "size" << std::right << std::setw(16) << "walk (ns)"
+	          << std::setw(16) << "filter (ns)" << std::setw(16) << "push (ns)" << std::endl;
+
+	const size_t sizes[] = {100, 1000, 10000, 100000};
+
+	for (size_t size : sizes) {
+		m_ff_vec3_f32 *ff = nullptr;
+		m_ff_vec3_f32_alloc(&ff, size);
+
+		// IMU at 1 kHz.
+		const uint64_t period_ns = 1000 * 1000;
+		uint64_t ts = 0;
+		xrt_vec3 sample = {0.1f, 9.8f, 0.2f};
+
+		auto start = clock::now();
+		for (size_t i = 0; i < size * 2; i++) {
+			ts += period_ns;
+			m_ff_vec3_f32_push(ff, &sample, ts);
+		}
+		double push_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / (size * 2);
+
+		// Average over the newest half of the fifo, what predict_pose does.
+		uint64_t window_start = ts - (size / 2) * period_ns;
+		const int iterations = 2000;
+		xrt_vec3 avg = {};
+		volatile float sink = 0;
+
+		start = clock::now();
+		for (int i = 0; i < iterations; i++) {
+			naive_filter(ff, window_start, ts, &avg);
+			sink = sink + avg.x;
+		}
+		double walk_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / iterations;
+
+		start = clock::now();
+		for (int i = 0; i < iterations; i++) {
+			m_ff_vec3_f32_filter(ff, window_start, ts, &avg);
+			sink = sink + avg.x;
+		}
+		double filter_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / iterations;
+
+		std::cout << std::left << std::setw(10) << size << std::right << std::fixed << std::setprecision(1)
+		          << std::setw(16) << walk_ns << std::setw(16) << filter_ns << std::setw(16) << push_ns
+		          << std::endl;
+
+		m_ff_vec3_f32_free(&ff);
+	}
+}
@@ -0,0 +1,247 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Format conversion kernel tests and benchmark.
+ *
+ * The benchmark is hidden, run it with `tests_format_convert "[.benchmark]"`.
+ */
+
+#include "util/u_format_convert.h"
+
+#include "catch/catch.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+enum class Kernel
+{
+	L8,
+	YUYV422,
+	YUYV422_L8,
+	UYVY422,
+	YUV888,
+	BAYER_GR8,
+};
+
+const Kernel kAllKernels[] = {
+    Kernel::L8, Kernel::YUYV422, Kernel::YUYV422_L8, Kernel::UYVY422, Kernel::YUV888, Kernel::BAYER_GR8,
+};
+
+const char *
+kernel_str(Kernel k)
+{
+	switch (k) {
+	case Kernel::L8: return "L8 -> R8G8B8";
+	case Kernel::YUYV422: return "YUYV422 -> R8G8B8";
+	case Kernel::YUYV422_L8: return "YUYV422 -> L8";
+	case Kernel::UYVY422: return "UYVY422 -> R8G8B8";
+	case Kernel::YUV888: return "YUV888 -> R8G8B8";
+	case Kernel::BAYER_GR8: return "BAYER_GR8 -> R8G8B8";
+	}
+	return "?";
+}
+
+//! Source bytes needed for one output row of @p w pixels.
+size_t
+src_row_size(Kernel k, uint32_t w)
+{
+	switch (k) {
+	case Kernel::L8: return w;
+	case Kernel::YUYV422:
+	case Kernel::YUYV422_L8:
+	case Kernel::UYVY422: return w * 2;
+	case Kernel::YUV888: return w * 3;
+	case Kernel::BAYER_GR8: return w * 2 * 2; // Two source rows of twice the width.
+	}
+	return 0;
+}
+
+size_t
+dst_row_size(Kernel k, uint32_t w)
+{
+	return k == Kernel::YUYV422_L8 ? w : w * 3;
+}
+
+void
+convert_row(const u_format_convert_funcs *funcs, Kernel k, const uint8_t *src, uint8_t *dst, uint32_t w)
+{
+	switch (k) {
+	case Kernel::L8: funcs->l8_to_r8g8b8(src, dst, w); break;
+	case Kernel::YUYV422: funcs->yuyv422_to_r8g8b8(src, dst, w); break;
+	case Kernel::YUYV422_L8: funcs->yuyv422_to_l8(src, dst, w); break;
+	case Kernel::UYVY422: funcs->uyvy422_to_r8g8b8(src, dst, w); break;
+	case Kernel::YUV888: funcs->yuv888_to_r8g8b8(src, dst, w); break;
+	case Kernel::BAYER_GR8: funcs->bayer_gr8_to_r8g8b8(src, src + (w * 2), dst, w); break;
+	}
+}
+
+std::vector<const u_format_convert_funcs *>
+simd_impls()
+{
+	std::vector<const u_format_convert_funcs *> ret;
+	for (int i = U_FORMAT_CONVERT_IMPL_SCALAR + 1; i < U_FORMAT_CONVERT_IMPL_COUNT; i++) {
+		const u_format_convert_funcs *funcs = u_format_convert_get_funcs((u_format_convert_impl)i);
+		if (funcs != nullptr) {
+			ret.push_back(funcs);
+		}
+	}
+	return ret;
+}
+
+} // namespace
+
+
+TEST_CASE("u_format_convert scalar reference")
+{
+	const u_format_convert_funcs *scalar = u_format_convert_get_funcs(U_FORMAT_CONVERT_IMPL_SCALAR);
+	REQUIRE(scalar != nullptr);
+	REQUIRE(u_format_convert_get_best() != nullptr);
+
+	// Limited range black, white and saturated red.
+	const uint8_t yuv[] = {16, 128, 128, 235, 128, 128, 81, 90, 240};
+	uint8_t rgb[9] = {};
+	scalar->yuv888_to_r8g8b8(yuv, rgb, 3);
+
+	CHECK(rgb[0] == 0);
+	CHECK(rgb[1] == 0);
+	CHECK(rgb[2] == 0);
+	CHECK(rgb[3] == 255);
+	CHECK(rgb[4] == 255);
+	CHECK(rgb[5] == 255);
+	CHECK(rgb[6] == 255);
+	CHECK(rgb[7] == 0);
+	CHECK(rgb[8] == 0);
+}
+
+TEST_CASE("u_format_convert bit exact")
+{
+	const u_format_convert_funcs *scalar = u_format_convert_get_funcs(U_FORMAT_CONVERT_IMPL_SCALAR);
+
+	std::mt19937 rng(1337);
+	std::uniform_int_distribution<int> byte(0, 255);
+
+	// Odd sizes to exercise the scalar tails, and some real widths.
+	std::vector<uint32_t> widths;
+	for (uint32_t w = 2; w <= 80; w += 2) {
+		widths.push_back(w);
+	}
+	widths.push_back(640);
+	widths.push_back(1280);
+
+	for (const u_format_convert_funcs *funcs : simd_impls()) {
+		for (Kernel k : kAllKernels) {
+			for (uint32_t w : widths) {
+				INFO(u_format_convert_impl_str(funcs->impl) << " " << kernel_str(k) << " width " << w);
+
+				std::vector<uint8_t> src(src_row_size(k, w));
+				for (uint8_t &v : src) {
+					v = (uint8_t)byte(rng);
+				}
+
+				// Guard bytes after the row catch stores past the end.
+				std::vector<uint8_t> expected(dst_row_size(k, w) + 32, 0xab);
+				std::vector<uint8_t> actual(dst_row_size(k, w) + 32, 0xab);
+
+				convert_row(scalar, k, src.data(), expected.data(), w);
+				convert_row(funcs, k, src.data(), actual.data(), w);
+
+				REQUIRE(expected == actual);
+			}
+		}
+	}
+}
+
+TEST_CASE("u_format_convert YUV888 exhaustive")
+{
+	const u_format_convert_funcs *scalar = u_format_convert_get_funcs(U_FORMAT_CONVERT_IMPL_SCALAR);
+
+	// One row per Y and U value with every V value, covers all 2^24 inputs.
+	constexpr uint32_t w = 256;
+	std::vector<uint8_t> src(w * 3);
+	std::vector<uint8_t> expected(w * 3);
+	std::vector<uint8_t> actual(w * 3);
+
+	for (const u_format_convert_funcs *funcs : simd_impls()) {
+		INFO(u_format_convert_impl_str(funcs->impl));
+
+		bool all_equal = true;
+		for (int y = 0; y < 256 && all_equal; y++) {
+			for (int u = 0; u < 256 && all_equal; u++) {
+				for (int v = 0; v < 256; v++) {
+					src[v * 3 + 0] = (uint8_t)y;
+					src[v * 3 + 1] = (uint8_t)u;
+					src[v * 3 + 2] = (uint8_t)v;
+				}
+
+				scalar->yuv888_to_r8g8b8(src.data(), expected.data(), w);
+				funcs->yuv888_to_r8g8b8(src.data(), actual.data(), w);
+				all_equal = expected == actual;
+
+				if (!all_equal) {
+					INFO("Y " << y << " U " << u);
+					CHECK(expected == actual);
+				}
+			}
+		}
+
+		CHECK(all_equal);
+	}
+}
+
+TEST_CASE("u_format_convert benchmark", "[.benchmark]")
+{
+	using clock = std::chrono::steady_clock;
+
+	struct Size
+	{
+		uint32_t w, h;
+	};
+	const Size sizes[] = {{640, 480}, {1280, 800}, {2560, 800}};
+
+	std::vector<const u_format_convert_funcs *> impls = simd_impls();
+	impls.insert(impls.begin(), u_format_convert_get_funcs(U_FORMAT_CONVERT_IMPL_SCALAR));
+
+	std::cout << std::left << std::setw(22) << "kernel" << std::setw(8) << "impl" << std::right << std::setw(12)
+	          << "640x480" << std::setw(12) << "1280x800" << std::setw(12) << "2560x800"
+	          << "  (MPix/s)" << std::endl;
+
+	for (Kernel k : kAllKernels) {
+		for (const u_format_convert_funcs *funcs : impls) {
+			std::cout << std::left << std::setw(22) << kernel_str(k) << std::setw(8)
+			          << u_format_convert_impl_str(funcs->impl) << std::right;
+
+			for (const Size &size : sizes) {
+				// Bayer rows come from two source rows.
+				size_t src_stride = src_row_size(k, size.w);
+				size_t dst_stride = dst_row_size(k, size.w);
+				std::vector<uint8_t> src(src_stride * size.h, 0x5a);
+				std::vector<uint8_t> dst(dst_stride * size.h);
+
+				// Run for at least ~200 ms.
+				int frames = 0;
+				auto start = clock::now();
+				std::chrono::duration<double> elapsed{};
+				do {
+					for (uint32_t y = 0; y < size.h; y++) {
+						convert_row(funcs, k, src.data() + y * src_stride, dst.data() + y * dst_stride,
+						            size.w);
+					}
+					frames++;
+					elapsed = clock::now() - start;
+				} while (elapsed.count() < 0.2);
+
+				double mpix = (double)size.w * size.h * frames / elapsed.count() / 1e6;
+				std::cout << std::setw(12) << std::fixed << std::setprecision(1) << mpix;
+			}
+			std::cout << std::endl;
+		}
+	}
+}
@@ -0,0 +1,198 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Frame pool tests.
+ */
+
+#include "util/u_frame_pool.h"
+
+#include "catch/catch.hpp"
+
+
+namespace {
+
+u_frame_pool_stats
+get_stats(u_frame_pool *ufp)
+{
+	u_frame_pool_stats stats = {};
+	u_frame_pool_get_stats(ufp, &stats);
+	return stats;
+}
+
+/*!
+ * What a camera pipeline does every frame, a stereo frame gets split into two
+ * views, one gets cloned and a converted frame is made.
+ */
+void
+run_pipeline_frame(u_frame_pool *ufp)
+{
+	xrt_frame *sbs = nullptr;
+	u_frame_pool_create_frame(ufp, XRT_FORMAT_L8, 1280, 400, &sbs);
+	REQUIRE(sbs != nullptr);
+
+	xrt_frame *left = nullptr;
+	xrt_frame *right = nullptr;
+	u_frame_pool_create_roi(ufp, sbs, {{0, 0}, {640, 400}}, &left);
+	u_frame_pool_create_roi(ufp, sbs, {{640, 0}, {640, 400}}, &right);
+
+	xrt_frame *copy = nullptr;
+	u_frame_pool_clone_frame(ufp, left, &copy);
+
+	xrt_frame *rgb = nullptr;
+	u_frame_pool_create_frame(ufp, XRT_FORMAT_R8G8B8, 640, 400, &rgb);
+
+	xrt_frame_reference(&rgb, nullptr);
+	xrt_frame_reference(&copy, nullptr);
+	xrt_frame_reference(&right, nullptr);
+	xrt_frame_reference(&left, nullptr);
+	xrt_frame_reference(&sbs, nullptr);
+}
+
+} // namespace
+
+
+TEST_CASE("u_frame_pool")
+{
+	u_frame_pool *ufp = u_frame_pool_create(2, 64 * 1024 * 1024);
+	REQUIRE(ufp != nullptr);
+
+	xrt_frame *a = nullptr;
+	u_frame_pool_create_frame(ufp, XRT_FORMAT_R8G8B8, 64, 32, &a);
+	REQUIRE(a != nullptr);
+	CHECK(a->reference.count == 1);
+	CHECK(a->width == 64);
+	CHECK(a->height == 32);
+	CHECK(a->stride >= 64 * 3);
+	CHECK(a->size >= a->stride * 32);
+	uint8_t *a_data = a->data;
+
+	SECTION("Released frames are reused")
+	{
+		a->timestamp = 42;
+		xrt_frame_reference(&a, nullptr);
+
+		xrt_frame *b = nullptr;
+		u_frame_pool_create_frame(ufp, XRT_FORMAT_R8G8B8, 64, 32, &b);
+		CHECK(b->data == a_data);
+		CHECK(b->timestamp == 0);
+		CHECK(get_stats(ufp).hits == 1);
+		CHECK(get_stats(ufp).misses == 1);
+		xrt_frame_reference(&b, nullptr);
+	}
+
+	SECTION("Similar sizes share a class")
+	{
+		xrt_frame_reference(&a, nullptr);
+
+		// 64 * 32 * 3 = 6144 bytes, 6100 rounds up to the same 6 KiB class.
+		xrt_frame *b = nullptr;
+		u_frame_pool_create_frame(ufp, XRT_FORMAT_L8, 6100, 1, &b);
+		CHECK(b->data == a_data);
+		CHECK(b->format == XRT_FORMAT_L8);
+		CHECK(b->size == 6100);
+
+		// Bigger than the class, gets new memory.
+		xrt_frame *c = nullptr;
+		u_frame_pool_create_frame(ufp, XRT_FORMAT_L8, 8000, 1, &c);
+		CHECK(get_stats(ufp).misses == 2);
+
+		xrt_frame_reference(&c, nullptr);
+		xrt_frame_reference(&b, nullptr);
+	}
+
+	SECTION("Frames in use are not handed out")
+	{
+		xrt_frame *b = nullptr;
+		u_frame_pool_create_frame(ufp, XRT_FORMAT_R8G8B8, 64, 32, &b);
+		CHECK(b->data != a_data);
+		CHECK(get_stats(ufp).outstanding_frames == 2);
+		xrt_frame_reference(&b, nullptr);
+		xrt_frame_reference(&a, nullptr);
+		CHECK(get_stats(ufp).outstanding_frames == 0);
+	}
+
+	SECTION("Free frames are limited")
+	{
+		xrt_frame *frames[4] = {};
+		for (xrt_frame *&xf : frames) {
+			u_frame_pool_create_frame(ufp, XRT_FORMAT_R8G8B8, 64, 32, &xf);
+		}
+		for (xrt_frame *&xf : frames) {
+			xrt_frame_reference(&xf, nullptr);
+		}
+		xrt_frame_reference(&a, nullptr);
+
+		u_frame_pool_stats stats = get_stats(ufp);
+		CHECK(stats.free_bytes == 2 * 6144);
+		CHECK(stats.allocated_bytes == 2 * 6144);
+
+		u_frame_pool_trim(ufp);
+		stats = get_stats(ufp);
+		CHECK(stats.free_bytes == 0);
+		CHECK(stats.allocated_bytes == 0);
+	}
+
+	SECTION("Frames outlive the pool")
+	{
+		u_frame_pool_reference(&ufp, nullptr);
+		CHECK(ufp == nullptr);
+
+		a->data[0] = 1;
+		xrt_frame_reference(&a, nullptr);
+	}
+
+	u_frame_pool_reference(&ufp, nullptr);
+}
+
+TEST_CASE("u_frame_pool steady state")
+{
+	u_frame_pool *ufp = u_frame_pool_create(4, 64 * 1024 * 1024);
+	REQUIRE(ufp != nullptr);
+
+	// Warm up.
+	run_pipeline_frame(ufp);
+	u_frame_pool_stats warm = get_stats(ufp);
+	CHECK(warm.misses == 5);
+
+	for (int i = 0; i < 1000; i++) {
+		run_pipeline_frame(ufp);
+	}
+
+	// Every frame after the first came out of the pool, no new allocations.
+	u_frame_pool_stats stats = get_stats(ufp);
+	CHECK(stats.misses == warm.misses);
+	CHECK(stats.hits == warm.hits + 1000 * 5);
+	CHECK(stats.allocated_bytes == warm.allocated_bytes);
+	CHECK(stats.outstanding_frames == 0);
+
+	u_frame_pool_reference(&ufp, nullptr);
+}
+
+TEST_CASE("u_frame_pool frame context")
+{
+	xrt_frame_context xfctx = {};
+
+	// Only contexts that opt in have a pool.
+	CHECK(u_frame_pool_get_for_context(&xfctx) == nullptr);
+
+	u_frame_pool *ufp = u_frame_pool_create_for_context(&xfctx);
+	REQUIRE(ufp != nullptr);
+	CHECK(u_frame_pool_create_for_context(&xfctx) == ufp);
+	CHECK(u_frame_pool_get_for_context(&xfctx) == ufp);
+
+	// Hold on to the pool and a frame past the context.
+	u_frame_pool *held = nullptr;
+	u_frame_pool_reference(&held, ufp);
+
+	xrt_frame *xf = nullptr;
+	u_frame_pool_create_frame(ufp, XRT_FORMAT_L8, 32, 32, &xf);
+
+	xrt_frame_context_destroy_nodes(&xfctx);
+	CHECK(xfctx.nodes == nullptr);
+
+	xrt_frame_reference(&xf, nullptr);
+	CHECK(get_stats(held).free_bytes > 0);
+
+	u_frame_pool_reference(&held, nullptr);
+}
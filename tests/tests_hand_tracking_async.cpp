@@ -0,0 +1,263 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Hand tracking async prediction tests.
+ *
+ * Replays a recorded-like sequence of hands through the async wrapper at
+ * camera rate and checks the predicted hands against the ground truth of
+ * the frames that come after.
+ */
+
+#include "tracking/t_hand_tracking.h"
+#include "math/m_api.h"
+#include "math/m_vec3.h"
+#include "util/u_frame.h"
+#include "util/u_time.h"
+
+#include "catch/catch.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+
+namespace {
+
+constexpr uint64_t kFramePeriodNs = U_TIME_1S_IN_NS / 30;
+constexpr int kFrameCount = 90;
+
+/*!
+ * Ground truth, the wrist moves sideways while the fingers open and close,
+ * the way a hand does while grabbing.
+ */
+xrt_hand_joint_set
+ground_truth(uint64_t timestamp_ns)
+{
+	double t = time_ns_to_s(timestamp_ns);
+	float curl = (float)(0.8 * std::sin(2.0 * M_PI * 0.7 * t));
+
+	xrt_hand_joint_set set = {};
+	set.is_active = true;
+
+	xrt_vec3 wrist = {(float)(0.3 * t), 1.2f, -0.4f};
+	xrt_vec3 axis = {1, 0, 0};
+	xrt_quat bend = {};
+	math_quat_from_angle_vector(curl, &axis, &bend);
+
+	for (int i = 0; i < XRT_HAND_JOINT_COUNT; i++) {
+		xrt_hand_joint_value *v = &set.values.hand_joint_set_default[i];
+
+		// Joints further out on the hand move more as it curls.
+		float reach = 0.01f * (float)i;
+		xrt_vec3 offset = {0, 0, -reach};
+		xrt_vec3 rotated = {};
+		math_quat_rotate_vec3(&bend, &offset, &rotated);
+
+		v->relation.pose.position = m_vec3_add(wrist, rotated);
+		v->relation.pose.orientation = bend;
+		v->relation.relation_flags = (xrt_space_relation_flags)(
+		    XRT_SPACE_RELATION_POSITION_VALID_BIT | XRT_SPACE_RELATION_POSITION_TRACKED_BIT |
+		    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT);
+		v->radius = 0.01f;
+	}
+
+	return set;
+}
+
+/*!
+ * Hands out the ground truth for the timestamp of the frames, waits for the
+ * test before returning so the test knows exactly what has been published.
+ */
+struct ReplaySync
+{
+	t_hand_tracking_sync base = {};
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	int started = 0;
+	int allowed = 0;
+
+	ReplaySync()
+	{
+		base.process = [](t_hand_tracking_sync *ht_sync, xrt_frame *left, xrt_frame *right,
+		                  xrt_hand_joint_set *out_left, xrt_hand_joint_set *out_right,
+		                  uint64_t *out_timestamp_ns) {
+			ReplaySync *rs = reinterpret_cast<ReplaySync *>(ht_sync);
+
+			std::unique_lock<std::mutex> lock(rs->mutex);
+			int index = rs->started++;
+			rs->cond.notify_all();
+			rs->cond.wait(lock, [&] { return rs->allowed > index; });
+
+			*out_left = ground_truth(left->timestamp);
+			*out_right = ground_truth(left->timestamp);
+			out_right->is_active = false;
+			*out_timestamp_ns = left->timestamp;
+		};
+		// Owned by the test.
+		base.destroy = [](t_hand_tracking_sync *) {};
+	}
+
+	//! Returns false if the frames were thrown away.
+	bool
+	wait_started(int count)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		return cond.wait_for(lock, std::chrono::milliseconds(20), [&] { return started >= count; });
+	}
+
+	void
+	allow(int count)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		allowed = count;
+		cond.notify_all();
+	}
+};
+
+void
+push_frames(t_hand_tracking_async *hta, uint64_t timestamp_ns)
+{
+	xrt_frame *left = nullptr;
+	xrt_frame *right = nullptr;
+	u_frame_create_one_off(XRT_FORMAT_L8, 4, 4, &left);
+	u_frame_create_one_off(XRT_FORMAT_L8, 4, 4, &right);
+	left->timestamp = timestamp_ns;
+	right->timestamp = timestamp_ns;
+
+	xrt_sink_push_frame(&hta->left, left);
+	xrt_sink_push_frame(&hta->right, right);
+
+	xrt_frame_reference(&left, nullptr);
+	xrt_frame_reference(&right, nullptr);
+}
+
+float
+position_error(const xrt_hand_joint_set &a, const xrt_hand_joint_set &b, int joint)
+{
+	return m_vec3_len(m_vec3_sub(a.values.hand_joint_set_default[joint].relation.pose.position,
+	                             b.values.hand_joint_set_default[joint].relation.pose.position));
+}
+
+} // namespace
+
+
+TEST_CASE("t_hand_tracking_async prediction")
+{
+	// Ask for exactly the time we want, the test has no camera latency.
+	setenv("HT_PREDICTION_OFFSET_MS", "0", 1);
+
+	ReplaySync sync;
+	xrt_frame_context xfctx = {};
+	t_hand_tracking_async *hta = t_hand_tracking_async_default_create(&xfctx, &sync.base);
+	REQUIRE(hta != nullptr);
+
+	const int tip = XRT_HAND_JOINT_LITTLE_TIP;
+	double latest_error = 0;
+	double predicted_error = 0;
+	int compared = 0;
+
+	uint64_t start_ns = U_TIME_1S_IN_NS;
+	for (int i = 0; i < kFrameCount; i++) {
+		uint64_t ts = start_ns + i * kFramePeriodNs;
+
+		// Frames get thrown away while the last result is being published.
+		do {
+			push_frames(hta, ts);
+		} while (!sync.wait_started(i + 1));
+
+		// Frame i is held in the provider, so frame i - 1 is the latest result.
+		if (i >= 3) {
+			uint64_t latest_ts = ts - kFramePeriodNs;
+
+			// Ground truth from this frame and the next one.
+			for (uint64_t ahead_ns : {kFramePeriodNs, 2 * kFramePeriodNs}) {
+				xrt_hand_joint_set predicted = {};
+				uint64_t out_ts = 0;
+				hta->get_hand(hta, XRT_INPUT_GENERIC_HAND_TRACKING_LEFT, latest_ts + ahead_ns, &predicted,
+				              &out_ts);
+				CHECK(out_ts == latest_ts + ahead_ns);
+
+				xrt_hand_joint_set truth = ground_truth(latest_ts + ahead_ns);
+				xrt_hand_joint_set latest = ground_truth(latest_ts);
+
+				predicted_error += position_error(predicted, truth, tip);
+				latest_error += position_error(latest, truth, tip);
+				compared++;
+			}
+
+			// Asked too far ahead, the timestamp says how far it was predicted.
+			xrt_hand_joint_set far = {};
+			uint64_t far_ts = 0;
+			hta->get_hand(hta, XRT_INPUT_GENERIC_HAND_TRACKING_LEFT, latest_ts + U_TIME_1S_IN_NS, &far, &far_ts);
+			CHECK(far_ts == latest_ts + 100 * U_TIME_1MS_IN_NS);
+
+			// Inactive hands are handed out as they are.
+			xrt_hand_joint_set right = {};
+			uint64_t right_ts = 0;
+			hta->get_hand(hta, XRT_INPUT_GENERIC_HAND_TRACKING_RIGHT, ts + kFramePeriodNs, &right, &right_ts);
+			CHECK_FALSE(right.is_active);
+			CHECK(right_ts == latest_ts);
+		}
+
+		sync.allow(i + 1);
+	}
+
+	predicted_error /= compared;
+	latest_error /= compared;
+	INFO("latest " << latest_error * 1000 << "mm, predicted " << predicted_error * 1000 << "mm");
+
+	// The finger tips move on their own, predicting only the wrist would barely help.
+	CHECK(predicted_error < latest_error * 0.5);
+
+	xrt_frame_context_destroy_nodes(&xfctx);
+}
+
+TEST_CASE("t_hand_tracking_async concurrent readers")
+{
+	setenv("HT_PREDICTION_OFFSET_MS", "0", 1);
+
+	ReplaySync sync;
+	xrt_frame_context xfctx = {};
+	t_hand_tracking_async *hta = t_hand_tracking_async_default_create(&xfctx, &sync.base);
+
+	// Let every frame through straight away.
+	sync.allow(1 << 30);
+
+	bool running = true;
+	int torn = 0;
+	std::thread reader([&] {
+		while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+			xrt_hand_joint_set set = {};
+			uint64_t ts = 0;
+			hta->get_hand(hta, XRT_INPUT_GENERIC_HAND_TRACKING_LEFT, 0, &set, &ts);
+			if (!set.is_active) {
+				continue;
+			}
+
+			// A result from a single frame has all joints agree with the timestamp.
+			xrt_hand_joint_set truth = ground_truth(ts);
+			for (int i = 0; i < XRT_HAND_JOINT_COUNT; i++) {
+				if (position_error(set, truth, i) > 1e-5f) {
+					torn++;
+					break;
+				}
+			}
+		}
+	});
+
+	for (int i = 0; i < 200; i++) {
+		push_frames(hta, U_TIME_1S_IN_NS + i * kFramePeriodNs);
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+
+	__atomic_store_n(&running, false, __ATOMIC_RELEASE);
+	reader.join();
+	CHECK(torn == 0);
+
+	xrt_frame_context_destroy_nodes(&xfctx);
+}
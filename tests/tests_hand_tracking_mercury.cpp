@@ -0,0 +1,218 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Mercury hand tracking pipelining and batching benchmark.
+ *
+ * Needs the hand tracking models installed, a recorded EuRoC style dataset
+ * and a matching stereo calibration, run it with:
+ *
+ *     MERCURY_BENCH_DATASET=<path with mav0 in it> \
+ *     MERCURY_BENCH_CALIBRATION=<calibration json> \
+ *     tests_hand_tracking_mercury "[.benchmark]"
+ */
+
+#include "hg_sync.hpp"
+#include "hg_interface.h"
+
+#include "os/os_time.h"
+#include "tracking/t_tracking.h"
+#include "util/u_frame.h"
+#include "util/u_latency_histogram.h"
+#include "util/u_time.h"
+
+#include "catch/catch.hpp"
+
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+using xrt::tracking::hand::mercury::HandTracking;
+
+struct StereoFrame
+{
+	xrt_frame *left = nullptr;
+	xrt_frame *right = nullptr;
+};
+
+xrt_frame *
+load_frame(const std::string &path, uint64_t timestamp_ns)
+{
+	cv::Mat img = cv::imread(path, cv::IMREAD_GRAYSCALE);
+	if (img.empty()) {
+		return nullptr;
+	}
+
+	xrt_frame *xf = nullptr;
+	u_frame_create_one_off(XRT_FORMAT_L8, img.cols, img.rows, &xf);
+	for (int y = 0; y < img.rows; y++) {
+		memcpy(xf->data + y * xf->stride, img.ptr(y), img.cols);
+	}
+	xf->timestamp = timestamp_ns;
+
+	return xf;
+}
+
+/*!
+ * Reads the timestamps and image names from `mav0/cam0/data.csv`, the right
+ * images have the same names in `mav0/cam1/data`.
+ */
+std::vector<StereoFrame>
+load_dataset(const std::string &path)
+{
+	std::vector<StereoFrame> frames;
+	std::ifstream csv(path + "/mav0/cam0/data.csv");
+
+	std::string line;
+	while (std::getline(csv, line)) {
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		size_t comma = line.find(',');
+		if (comma == std::string::npos) {
+			continue;
+		}
+
+		uint64_t ts = std::stoull(line.substr(0, comma));
+		std::string name = line.substr(comma + 1);
+		while (!name.empty() && (name.back() == '\r' || name.back() == ' ')) {
+			name.pop_back();
+		}
+
+		StereoFrame sf;
+		sf.left = load_frame(path + "/mav0/cam0/data/" + name, ts);
+		sf.right = load_frame(path + "/mav0/cam1/data/" + name, ts);
+		if (sf.left == nullptr || sf.right == nullptr) {
+			xrt_frame_reference(&sf.left, nullptr);
+			xrt_frame_reference(&sf.right, nullptr);
+			continue;
+		}
+
+		frames.push_back(sf);
+	}
+
+	return frames;
+}
+
+struct Result
+{
+	double fps;
+	double cpu_ms_per_frame;
+	u_latency_histogram latency;
+	int hands;
+};
+
+//! CPU time of all threads, the models run on the thread pool.
+uint64_t
+process_cpu_ns()
+{
+	struct timespec ts = {};
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * U_TIME_1S_IN_NS + (uint64_t)ts.tv_nsec;
+}
+
+/*!
+ * Feeds the frames back to back, like the async wrapper does when the camera
+ * is faster than the tracking. Latency is from starting to process a frame
+ * until its result is returned.
+ */
+Result
+run(t_stereo_camera_calibration *calib, const std::vector<StereoFrame> &frames, bool pipelined, bool batched)
+{
+	t_camera_extra_info extra = {};
+	t_hand_tracking_sync *sync = t_hand_tracking_sync_mercury_create(calib, extra);
+	REQUIRE(sync != nullptr);
+	HandTracking::fromC(sync).pipelined = pipelined;
+	HandTracking::fromC(sync).batch_keypoints = batched;
+
+	Result result = {};
+	std::vector<uint64_t> started_ns(frames.size());
+
+	uint64_t begin_ns = os_monotonic_get_ns();
+	uint64_t begin_cpu_ns = process_cpu_ns();
+	for (size_t i = 0; i < frames.size(); i++) {
+		xrt_hand_joint_set hands[2] = {};
+		uint64_t ts = 0;
+
+		started_ns[i] = os_monotonic_get_ns();
+		t_ht_sync_process(sync, frames[i].left, frames[i].right, &hands[0], &hands[1], &ts);
+		uint64_t now_ns = os_monotonic_get_ns();
+
+		// The result is for this frame, or the one before when pipelined.
+		size_t k = i;
+		if (frames[k].left->timestamp != ts && k > 0) {
+			k--;
+		}
+		if (frames[k].left->timestamp == ts) {
+			u_latency_histogram_add(&result.latency, now_ns - started_ns[k]);
+		}
+
+		result.hands += (int)hands[0].is_active + (int)hands[1].is_active;
+	}
+	double seconds = time_ns_to_s((time_duration_ns)(os_monotonic_get_ns() - begin_ns));
+	result.fps = (double)frames.size() / seconds;
+	result.cpu_ms_per_frame = (double)(process_cpu_ns() - begin_cpu_ns) / (1000.0 * 1000.0) / frames.size();
+
+	t_ht_sync_destroy(&sync);
+
+	return result;
+}
+
+double
+to_ms(uint64_t ns)
+{
+	return (double)ns / (1000.0 * 1000.0);
+}
+
+} // namespace
+
+
+TEST_CASE("mercury pipelined and batched benchmark", "[.benchmark]")
+{
+	const char *dataset = std::getenv("MERCURY_BENCH_DATASET");
+	const char *calibration = std::getenv("MERCURY_BENCH_CALIBRATION");
+	if (dataset == nullptr || calibration == nullptr) {
+		WARN("Set MERCURY_BENCH_DATASET and MERCURY_BENCH_CALIBRATION to run");
+		return;
+	}
+
+	t_stereo_camera_calibration *calib = nullptr;
+	REQUIRE(t_stereo_camera_calibration_load(calibration, &calib));
+
+	std::vector<StereoFrame> frames = load_dataset(dataset);
+	REQUIRE(!frames.empty());
+
+	std::cout << frames.size() << " frames" << std::endl;
+	std::cout << std::left << std::setw(12) << "mode" << std::setw(12) << "keypoints" << std::right
+	          << std::setw(10) << "fps" << std::setw(12) << "cpu (ms)" << std::setw(12) << "p50 (ms)"
+	          << std::setw(12) << "p99 (ms)" << std::setw(12) << "max (ms)" << std::setw(10) << "hands"
+	          << std::endl;
+
+	for (bool pipelined : {false, true}) {
+		for (bool batched : {false, true}) {
+			Result r = run(calib, frames, pipelined, batched);
+
+			std::cout << std::left << std::setw(12) << (pipelined ? "pipelined" : "serial")
+			          << std::setw(12) << (batched ? "batched" : "per crop") << std::right << std::fixed
+			          << std::setprecision(1) << std::setw(10) << r.fps << std::setw(12)
+			          << r.cpu_ms_per_frame << std::setw(12)
+			          << to_ms(u_latency_histogram_get_percentile(&r.latency, 0.5)) << std::setw(12)
+			          << to_ms(u_latency_histogram_get_percentile(&r.latency, 0.99)) << std::setw(12)
+			          << to_ms(r.latency.max_ns) << std::setw(10) << r.hands << std::endl;
+		}
+	}
+
+	for (StereoFrame &sf : frames) {
+		xrt_frame_reference(&sf.left, nullptr);
+		xrt_frame_reference(&sf.right, nullptr);
+	}
+	t_stereo_camera_calibration_reference(&calib, nullptr);
+}
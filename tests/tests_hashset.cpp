@@ -0,0 +1,110 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Hashset tests.
+ */
+
+#include "util/u_hashset.h"
+
+#include "catch/catch.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+struct item_with_str
+{
+	u_hashset_item item;
+	char str[32];
+};
+
+item_with_str *
+make_item(const char *str)
+{
+	auto *i = (item_with_str *)calloc(1, sizeof(item_with_str));
+	i->item.length = strlen(str);
+	memcpy(i->str, str, i->item.length);
+	return i;
+}
+
+void
+count_and_free(u_hashset_item *item, void *priv)
+{
+	(*(int *)priv)++;
+	free(item);
+}
+
+} // namespace
+
+
+TEST_CASE("u_hashset")
+{
+	u_hashset *hs = nullptr;
+	REQUIRE(u_hashset_create(&hs) == 0);
+
+	u_hashset_item *a = nullptr;
+	u_hashset_item *found = nullptr;
+	REQUIRE(u_hashset_create_and_insert_str_c(hs, "/user/hand/left", &a) == 0);
+	CHECK(std::string(a->c_str()) == "/user/hand/left");
+
+	// Duplicates are refused, lookups don't need a terminated string.
+	u_hashset_item *dup = nullptr;
+	CHECK(u_hashset_create_and_insert_str_c(hs, "/user/hand/left", &dup) == -1);
+	REQUIRE(u_hashset_find_str(hs, "/user/hand/leftover", 15, &found) == 0);
+	CHECK(found == a);
+	CHECK(u_hashset_find_c_str(hs, "/user/hand/lef", &found) == -1);
+
+	// Inserting an item with the same string replaces the old one.
+	item_with_str *b = make_item("/user/hand/left");
+	u_hashset_insert_item(hs, &b->item);
+	REQUIRE(u_hashset_find_c_str(hs, "/user/hand/left", &found) == 0);
+	CHECK(found == &b->item);
+	free(a);
+
+	// Grow well past the initial size, erasing every other one.
+	std::vector<u_hashset_item *> items;
+	for (int i = 0; i < 1000; i++) {
+		std::string str = "/interaction_profiles/" + std::to_string(i);
+		u_hashset_item *item = nullptr;
+		REQUIRE(u_hashset_create_and_insert_str(hs, str.c_str(), str.size(), &item) == 0);
+		items.push_back(item);
+	}
+	for (size_t i = 0; i < items.size(); i += 2) {
+		u_hashset_erase_item(hs, items[i]);
+		free(items[i]);
+	}
+
+	bool all_correct = true;
+	for (int i = 0; i < 1000; i++) {
+		std::string str = "/interaction_profiles/" + std::to_string(i);
+		int ret = u_hashset_find_c_str(hs, str.c_str(), &found);
+		if (i % 2 == 0) {
+			all_correct = all_correct && ret == -1;
+		} else {
+			all_correct = all_correct && ret == 0 && found == items[i];
+		}
+	}
+	CHECK(all_correct);
+
+	// Reinserting reuses the erased slots.
+	for (size_t i = 0; i < items.size(); i += 2) {
+		std::string str = "/interaction_profiles/" + std::to_string(i);
+		REQUIRE(u_hashset_create_and_insert_str(hs, str.c_str(), str.size(), &items[i]) == 0);
+	}
+	u_hashset_erase_c_str(hs, "/interaction_profiles/1");
+	CHECK(u_hashset_find_c_str(hs, "/interaction_profiles/1", &found) == -1);
+	free(items[1]);
+
+	int count = 0;
+	u_hashset_clear_and_call_for_each(hs, count_and_free, &count);
+	CHECK(count == 1000);
+	CHECK(u_hashset_find_c_str(hs, "/user/hand/left", &found) == -1);
+
+	u_hashset_destroy(&hs);
+	CHECK(hs == nullptr);
+}
@@ -0,0 +1,282 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief HSV filter row kernel tests and benchmark.
+ *
+ * The benchmark is hidden, run it with `tests_hsv_filter "[.benchmark]"`.
+ */
+
+#include "util/u_worker.h"
+#include "tracking/t_tracking.h"
+
+#include "catch/catch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+enum class Format
+{
+	YUV888,
+	YUYV422,
+};
+
+const Format kAllFormats[] = {Format::YUV888, Format::YUYV422};
+
+const char *
+format_str(Format f)
+{
+	switch (f) {
+	case Format::YUV888: return "YUV888";
+	case Format::YUYV422: return "YUYV422";
+	}
+	return "?";
+}
+
+size_t
+src_row_size(Format f, uint32_t w)
+{
+	return f == Format::YUV888 ? w * 3 : w * 2;
+}
+
+t_hsv_filter_row_func_t
+row_func(const t_hsv_filter_funcs *funcs, Format f)
+{
+	return f == Format::YUV888 ? funcs->yuv888 : funcs->yuyv422;
+}
+
+/*!
+ * The kernels only look bits up, so a random table exercises them just as well
+ * as a real one, which needs the OpenCV colour conversion to build.
+ */
+std::unique_ptr<t_hsv_filter_optimized_table>
+make_table(std::mt19937 &rng)
+{
+	std::uniform_int_distribution<int> bits(0, 15);
+	auto t = std::make_unique<t_hsv_filter_optimized_table>();
+	uint8_t *data = &t->v[0][0][0];
+	for (size_t i = 0; i < sizeof(t->v); i++) {
+		data[i] = (uint8_t)bits(rng);
+	}
+	return t;
+}
+
+//! One output row per channel with some guard bytes after each.
+struct Planes
+{
+	static constexpr size_t kGuard = 32;
+
+	std::vector<uint8_t> data[4];
+	uint8_t *rows[4];
+
+	Planes(size_t size)
+	{
+		for (int i = 0; i < 4; i++) {
+			data[i].assign(size + kGuard, 0xab);
+			rows[i] = data[i].data();
+		}
+	}
+
+	bool
+	operator==(const Planes &other) const
+	{
+		return std::equal(std::begin(data), std::end(data), std::begin(other.data));
+	}
+};
+
+std::vector<const t_hsv_filter_funcs *>
+simd_impls()
+{
+	std::vector<const t_hsv_filter_funcs *> ret;
+	for (int i = T_HSV_FILTER_IMPL_SCALAR + 1; i < T_HSV_FILTER_IMPL_COUNT; i++) {
+		const t_hsv_filter_funcs *funcs = t_hsv_filter_get_funcs((t_hsv_filter_impl)i);
+		if (funcs != nullptr) {
+			ret.push_back(funcs);
+		}
+	}
+	return ret;
+}
+
+} // namespace
+
+
+TEST_CASE("t_hsv_filter scalar reference")
+{
+	const t_hsv_filter_funcs *scalar = t_hsv_filter_get_funcs(T_HSV_FILTER_IMPL_SCALAR);
+	REQUIRE(scalar != nullptr);
+	REQUIRE(t_hsv_filter_get_best() != nullptr);
+
+	std::mt19937 rng(1337);
+	auto table = make_table(rng);
+
+	// Two YUYV pixels sharing chroma and the same two as YUV888.
+	const uint8_t yuyv[] = {16, 200, 240, 90};
+	const uint8_t yuv[] = {16, 200, 90, 240, 200, 90};
+
+	for (Format f : kAllFormats) {
+		INFO(format_str(f));
+
+		Planes planes(2);
+		row_func(scalar, f)(table.get(), f == Format::YUV888 ? yuv : yuyv, planes.rows, 2);
+
+		const uint8_t bits[2] = {
+		    t_hsv_filter_sample(table.get(), 16, 200, 90),
+		    t_hsv_filter_sample(table.get(), 240, 200, 90),
+		};
+		for (int c = 0; c < 4; c++) {
+			for (int x = 0; x < 2; x++) {
+				CHECK(planes.rows[c][x] == ((bits[x] & (1 << c)) ? 0xff : 0x00));
+			}
+			CHECK(planes.rows[c][2] == 0xab);
+		}
+	}
+}
+
+TEST_CASE("t_hsv_filter bit exact")
+{
+	const t_hsv_filter_funcs *scalar = t_hsv_filter_get_funcs(T_HSV_FILTER_IMPL_SCALAR);
+
+	std::mt19937 rng(1337);
+	std::uniform_int_distribution<int> byte(0, 255);
+	auto table = make_table(rng);
+
+	// Sizes that exercise the scalar tails, and some real widths.
+	std::vector<uint32_t> widths;
+	for (uint32_t w = 2; w <= 80; w += 2) {
+		widths.push_back(w);
+	}
+	widths.push_back(640);
+	widths.push_back(1280);
+
+	for (const t_hsv_filter_funcs *funcs : simd_impls()) {
+		for (Format f : kAllFormats) {
+			for (uint32_t w : widths) {
+				INFO(t_hsv_filter_impl_str(funcs->impl) << " " << format_str(f) << " width " << w);
+
+				std::vector<uint8_t> src(src_row_size(f, w));
+				for (uint8_t &v : src) {
+					v = (uint8_t)byte(rng);
+				}
+
+				Planes expected(w);
+				Planes actual(w);
+				row_func(scalar, f)(table.get(), src.data(), expected.rows, w);
+				row_func(funcs, f)(table.get(), src.data(), actual.rows, w);
+
+				REQUIRE(expected == actual);
+			}
+		}
+	}
+}
+
+TEST_CASE("t_hsv_filter benchmark", "[.benchmark]")
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr uint32_t w = 1280;
+	constexpr uint32_t h = 800;
+	constexpr uint32_t band_count = 8;
+
+	std::mt19937 rng(1337);
+	std::uniform_int_distribution<int> byte(0, 255);
+	auto table = make_table(rng);
+
+	std::vector<const t_hsv_filter_funcs *> impls = simd_impls();
+	impls.insert(impls.begin(), t_hsv_filter_get_funcs(T_HSV_FILTER_IMPL_SCALAR));
+
+	struct Band
+	{
+		t_hsv_filter_row_func_t func;
+		const t_hsv_filter_optimized_table *table;
+		const uint8_t *src;
+		size_t src_stride;
+		std::vector<uint8_t> *planes;
+		uint32_t y_start, y_end;
+	};
+
+	auto run_band = [](void *ptr) {
+		Band *b = (Band *)ptr;
+		for (uint32_t y = b->y_start; y < b->y_end; y++) {
+			uint8_t *const rows[4] = {
+			    b->planes[0].data() + y * w,
+			    b->planes[1].data() + y * w,
+			    b->planes[2].data() + y * w,
+			    b->planes[3].data() + y * w,
+			};
+			b->func(b->table, b->src + y * b->src_stride, rows, w);
+		}
+	};
+
+	const uint32_t thread_counts[] = {0, 1, 2, 4};
+
+	std::cout << std::left << std::setw(10) << "format" << std::setw(8) << "impl" << std::right;
+	for (uint32_t threads : thread_counts) {
+		std::cout << std::setw(8) << threads << "t";
+	}
+	std::cout << "  (MPix/s at " << w << "x" << h << ", 0t is no pool)" << std::endl;
+
+	for (Format f : kAllFormats) {
+		size_t src_stride = src_row_size(f, w);
+		std::vector<uint8_t> src(src_stride * h);
+		for (uint8_t &v : src) {
+			v = (uint8_t)byte(rng);
+		}
+		std::vector<uint8_t> planes[4];
+		for (auto &p : planes) {
+			p.resize(w * h);
+		}
+
+		for (const t_hsv_filter_funcs *funcs : impls) {
+			std::cout << std::left << std::setw(10) << format_str(f) << std::setw(8)
+			          << t_hsv_filter_impl_str(funcs->impl) << std::right;
+
+			for (uint32_t threads : thread_counts) {
+				u_worker_thread_pool *pool = nullptr;
+				u_worker_group *group = nullptr;
+				if (threads > 0) {
+					pool = u_worker_thread_pool_create(threads - 1, threads);
+					group = u_worker_group_create(pool);
+				}
+
+				Band bands[band_count];
+				uint32_t count = group != nullptr ? band_count : 1;
+				for (uint32_t i = 0; i < count; i++) {
+					bands[i] = {row_func(funcs, f), table.get(), src.data(), src_stride,
+					            planes,             h * i / count, h * (i + 1) / count};
+				}
+
+				// Run for at least ~200 ms.
+				int frames = 0;
+				auto start = clock::now();
+				std::chrono::duration<double> elapsed{};
+				do {
+					if (group == nullptr) {
+						run_band(&bands[0]);
+					} else {
+						for (uint32_t i = 0; i < count; i++) {
+							u_worker_group_push(group, run_band, &bands[i]);
+						}
+						u_worker_group_wait_all(group);
+					}
+					frames++;
+					elapsed = clock::now() - start;
+				} while (elapsed.count() < 0.2);
+
+				double mpix = (double)w * h * frames / elapsed.count() / 1e6;
+				std::cout << std::setw(9) << std::fixed << std::setprecision(1) << mpix;
+
+				u_worker_group_reference(&group, nullptr);
+				u_worker_thread_pool_reference(&pool, nullptr);
+			}
+			std::cout << std::endl;
+		}
+	}
+}
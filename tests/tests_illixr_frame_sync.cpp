@@ -0,0 +1,128 @@
+// Copyright 2022, The Board of Trustees of the University of Illinois.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief ILLIXR compositor to timewarp handoff tests.
+ */
+
+#include "util/u_time.h"
+
+#include "illixr/illixr_frame_sync.h"
+
+#include "catch/catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+static constexpr uint64_t kTimeoutNs = 50 * U_TIME_1MS_IN_NS;
+
+/*!
+ * Stands in for the switchboard: publishes signal_to_quad sequence numbers
+ * from its own thread, like timewarp does after consuming a frame.
+ */
+struct FakeSwitchboard
+{
+	struct illixr_frame_sync *ifs;
+	std::atomic<uint64_t> seq{0};
+
+	void
+	publish()
+	{
+		illixr_frame_sync_signal(ifs, ++seq);
+	}
+
+	std::thread
+	publishAfter(std::chrono::milliseconds delay)
+	{
+		return std::thread([this, delay] {
+			std::this_thread::sleep_for(delay);
+			publish();
+		});
+	}
+};
+
+TEST_CASE("illixr_frame_sync")
+{
+	struct illixr_frame_sync ifs = {};
+	REQUIRE(illixr_frame_sync_init(&ifs, kTimeoutNs) == 0);
+
+	FakeSwitchboard sb{&ifs};
+
+	SECTION("Wakes up on signal")
+	{
+		std::thread producer = sb.publishAfter(10ms);
+		CHECK(illixr_frame_sync_wait(&ifs));
+		producer.join();
+
+		CHECK(ifs.stats.wait.count == 1);
+		CHECK(ifs.stats.timeouts == 0);
+		CHECK(ifs.stats.wait.last_ms > 5.f);
+		CHECK(ifs.stats.wait.last_ms < 50.f);
+	}
+
+	SECTION("Signal before wait does not block")
+	{
+		sb.publish();
+		CHECK(illixr_frame_sync_wait(&ifs));
+		CHECK(ifs.stats.timeouts == 0);
+	}
+
+	SECTION("Times out without a producer")
+	{
+		CHECK_FALSE(illixr_frame_sync_wait(&ifs));
+		CHECK(ifs.stats.wait.count == 1);
+		CHECK(ifs.stats.timeouts == 1);
+		CHECK(ifs.stats.wait.last_ms >= 45.f);
+	}
+
+	SECTION("Stale sequence numbers are ignored")
+	{
+		sb.publish();
+		CHECK(illixr_frame_sync_wait(&ifs));
+
+		// Same and older sequence numbers must not count as a new frame.
+		illixr_frame_sync_signal(&ifs, sb.seq);
+		illixr_frame_sync_signal(&ifs, 0);
+		CHECK_FALSE(illixr_frame_sync_wait(&ifs));
+		CHECK(ifs.stats.timeouts == 1);
+	}
+
+	SECTION("Lock-step frame loop")
+	{
+		constexpr int kFrames = 100;
+		std::atomic<int> submitted{0};
+		std::atomic<bool> running{true};
+
+		// Timewarp consumes each submitted frame after a short delay.
+		std::thread producer([&] {
+			int consumed = 0;
+			while (running) {
+				if (submitted > consumed) {
+					std::this_thread::sleep_for(200us);
+					consumed++;
+					sb.publish();
+				} else {
+					std::this_thread::yield();
+				}
+			}
+		});
+
+		int ok = 0;
+		for (int i = 0; i < kFrames; i++) {
+			submitted++;
+			ok += illixr_frame_sync_wait(&ifs) ? 1 : 0;
+		}
+		running = false;
+		producer.join();
+
+		CHECK(ok == kFrames);
+		CHECK(ifs.stats.wait.count == kFrames);
+		CHECK(ifs.stats.timeouts == 0);
+		CHECK(ifs.stats.wait.max_ms < 50.f);
+	}
+
+	illixr_frame_sync_destroy(&ifs);
+}
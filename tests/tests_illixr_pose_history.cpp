@@ -0,0 +1,191 @@
+// Copyright 2022, The Board of Trustees of the University of Illinois.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief ILLIXR HMD pose prediction tests.
+ */
+
+#include "math/m_api.h"
+#include "math/m_vec3.h"
+#include "util/u_time.h"
+
+#include "illixr/illixr_pose_history.h"
+
+#include "catch/catch.hpp"
+
+#include <cmath>
+#include <vector>
+
+
+namespace {
+
+/*!
+ * A smooth head motion: yaw and pitch sway plus a small translation, roughly
+ * what a seated user looking around produces.
+ */
+xrt_pose
+trajectory(uint64_t ts)
+{
+	double t = time_ns_to_s((time_duration_ns)ts);
+
+	float yaw = (float)(0.6 * std::sin(M_PI * t));
+	float pitch = (float)(0.2 * std::sin(2.3 * t + 0.4));
+
+	xrt_quat q_yaw{0.f, std::sin(yaw / 2.f), 0.f, std::cos(yaw / 2.f)};
+	xrt_quat q_pitch{std::sin(pitch / 2.f), 0.f, 0.f, std::cos(pitch / 2.f)};
+
+	xrt_pose pose{};
+	math_quat_rotate(&q_yaw, &q_pitch, &pose.orientation);
+	pose.position.x = (float)(0.1 * std::sin(1.7 * t));
+	pose.position.y = (float)(1.6 + 0.02 * std::sin(3.1 * t));
+	pose.position.z = (float)(0.05 * std::cos(1.3 * t));
+
+	return pose;
+}
+
+float
+angle_between(const xrt_quat &a, const xrt_quat &b)
+{
+	// Angle of the difference rotation, atan2 stays precise for tiny angles where acos does not.
+	xrt_quat diff;
+	math_quat_unrotate(&a, &b, &diff);
+	double v = std::sqrt((double)diff.x * diff.x + (double)diff.y * diff.y + (double)diff.z * diff.z);
+	return (float)(2.0 * std::atan2(v, std::abs((double)diff.w)));
+}
+
+struct Errors
+{
+	double rot_sum = 0;
+	double pos_sum = 0;
+	float rot_max = 0;
+	float pos_max = 0;
+	int count = 0;
+
+	void
+	add(const xrt_pose &predicted, const xrt_pose &truth)
+	{
+		float rot = angle_between(predicted.orientation, truth.orientation);
+		float pos = m_vec3_len(predicted.position - truth.position);
+		rot_sum += rot;
+		pos_sum += pos;
+		rot_max = std::fmax(rot_max, rot);
+		pos_max = std::fmax(pos_max, pos);
+		count++;
+	}
+
+	double
+	rot_mean() const
+	{
+		return rot_sum / count;
+	}
+
+	double
+	pos_mean() const
+	{
+		return pos_sum / count;
+	}
+};
+
+} // namespace
+
+
+TEST_CASE("illixr_pose_history")
+{
+	struct illixr_pose_history iph;
+	illixr_pose_history_init(&iph);
+
+	// Start well away from zero, a zero timestamp is invalid for the history.
+	constexpr uint64_t start_ns = 10 * (uint64_t)U_TIME_1S_IN_NS;
+
+	SECTION("Repeated reads of the same sample are dropped")
+	{
+		xrt_pose pose = trajectory(start_ns);
+		CHECK(illixr_pose_history_push(&iph, &pose, start_ns));
+		CHECK_FALSE(illixr_pose_history_push(&iph, &pose, start_ns));
+		CHECK_FALSE(illixr_pose_history_push(&iph, &pose, start_ns - 1));
+		CHECK(iph.pushed == 1);
+		CHECK(iph.stale == 2);
+	}
+
+	SECTION("Velocities are estimated")
+	{
+		xrt_pose a = trajectory(start_ns);
+		xrt_pose b = trajectory(start_ns + 2 * U_TIME_1MS_IN_NS);
+		illixr_pose_history_push(&iph, &a, start_ns);
+		illixr_pose_history_push(&iph, &b, start_ns + 2 * U_TIME_1MS_IN_NS);
+
+		xrt_space_relation rel;
+		CHECK(illixr_pose_history_get(&iph, start_ns + 2 * U_TIME_1MS_IN_NS, &rel) ==
+		      M_RELATION_HISTORY_RESULT_EXACT);
+		CHECK((rel.relation_flags & XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT) != 0);
+		CHECK((rel.relation_flags & XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT) != 0);
+		CHECK((rel.relation_flags & XRT_SPACE_RELATION_POSITION_TRACKED_BIT) != 0);
+		CHECK((rel.relation_flags & XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT) != 0);
+	}
+
+	SECTION("Replay: prediction to display time")
+	{
+		// Replay a recorded trajectory as the compositor would see it: new
+		// fast poses at ~500 Hz with jittered timestamps, and at ~90 Hz a
+		// request for the pose one frame and a bit into the future.
+		constexpr uint64_t sample_period_ns = 2 * U_TIME_1MS_IN_NS;
+		constexpr uint64_t frame_period_ns = 11 * U_TIME_1MS_IN_NS;
+		constexpr uint64_t horizon_ns = 16 * U_TIME_1MS_IN_NS;
+		constexpr uint64_t duration_ns = 5 * (uint64_t)U_TIME_1S_IN_NS;
+
+		Errors predicted;
+		Errors unpredicted;
+		Errors interpolated;
+
+		uint64_t next_frame_ns = start_ns + 100 * U_TIME_1MS_IN_NS;
+		xrt_pose latest{};
+		uint64_t ts = start_ns;
+		for (int i = 0; ts < start_ns + duration_ns; i++) {
+			// Deterministic jitter of up to +-250us.
+			int64_t jitter = ((i * 7919) % 501 - 250) * 1000;
+			ts = start_ns + (uint64_t)i * sample_period_ns + jitter;
+
+			latest = trajectory(ts);
+			illixr_pose_history_push(&iph, &latest, ts);
+
+			if (ts < next_frame_ns) {
+				continue;
+			}
+			next_frame_ns += frame_period_ns;
+
+			uint64_t display_ns = ts + horizon_ns;
+			xrt_pose truth = trajectory(display_ns);
+
+			xrt_space_relation rel;
+			REQUIRE(illixr_pose_history_get(&iph, display_ns, &rel) == M_RELATION_HISTORY_RESULT_PREDICTED);
+			predicted.add(rel.pose, truth);
+			unpredicted.add(latest, truth);
+
+			// Somewhere in the recent past, as used for reprojection.
+			uint64_t past_ns = ts - 5 * U_TIME_1MS_IN_NS - 300 * 1000;
+			REQUIRE(illixr_pose_history_get(&iph, past_ns, &rel) == M_RELATION_HISTORY_RESULT_INTERPOLATED);
+			interpolated.add(rel.pose, trajectory(past_ns));
+		}
+
+		REQUIRE(predicted.count > 100);
+
+		INFO("predicted rot mean " << predicted.rot_mean() << " max " << predicted.rot_max);
+		INFO("unpredicted rot mean " << unpredicted.rot_mean() << " max " << unpredicted.rot_max);
+		INFO("predicted pos mean " << predicted.pos_mean() << " max " << predicted.pos_max);
+		INFO("unpredicted pos mean " << unpredicted.pos_mean() << " max " << unpredicted.pos_max);
+
+		// Prediction has to beat handing out the latest pose by a wide margin.
+		CHECK(predicted.rot_mean() < 0.25 * unpredicted.rot_mean());
+		CHECK(predicted.pos_mean() < 0.25 * unpredicted.pos_mean());
+
+		// Absolute bounds: ~0.3 degrees and 1 mm at a 16 ms horizon.
+		CHECK(predicted.rot_max < 0.005f);
+		CHECK(predicted.pos_max < 0.001f);
+
+		// Interpolation between samples is close to exact.
+		CHECK(interpolated.rot_max < 0.0005f);
+		CHECK(interpolated.pos_max < 0.0001f);
+	}
+
+	illixr_pose_history_destroy(&iph);
+}
@@ -0,0 +1,436 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief IPC batch tests and benchmark.
+ *
+ * The generated client calls talk to the generated server dispatch over a
+ * socketpair, the server has a fake compositor and device so no GPU is
+ * needed. The benchmark is hidden, run it with `tests_ipc_batch "[.benchmark]"`.
+ */
+
+#include "xrt/xrt_compositor.h"
+#include "xrt/xrt_device.h"
+#include "xrt/xrt_instance.h"
+#include "server/ipc_server.h"
+
+extern "C" {
+#include "client/ipc_client.h"
+#include "ipc_client_generated.h"
+#include "ipc_server_generated.h"
+}
+
+#include "catch/catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+/*
+ * Normally provided by the service target, the service main is never run
+ * here so they are never called.
+ */
+extern "C" {
+
+xrt_result_t
+xrt_instance_create(struct xrt_instance_info *ii, struct xrt_instance **out_xinst)
+{
+	return XRT_ERROR_IPC_FAILURE;
+}
+
+int
+oxr_sdl2_hack_create(void **out_hack)
+{
+	return 0;
+}
+
+void
+oxr_sdl2_hack_start(void *hack, struct xrt_instance *xinst, struct xrt_system_devices *xsysd)
+{}
+
+void
+oxr_sdl2_hack_stop(void **hack_ptr)
+{}
+}
+
+
+namespace {
+
+constexpr uint32_t kSwapchainCount = 2;
+
+struct FakeSwapchain
+{
+	xrt_swapchain base = {};
+	uint32_t next = 0;
+
+	FakeSwapchain()
+	{
+		base.image_count = 3;
+		base.acquire_image = [](xrt_swapchain *xsc, uint32_t *out_index) {
+			FakeSwapchain *fs = reinterpret_cast<FakeSwapchain *>(xsc);
+			*out_index = fs->next;
+			fs->next = (fs->next + 1) % xsc->image_count;
+			return XRT_SUCCESS;
+		};
+		base.wait_image = [](xrt_swapchain *, uint64_t, uint32_t) { return XRT_SUCCESS; };
+		base.release_image = [](xrt_swapchain *, uint32_t) { return XRT_SUCCESS; };
+	}
+};
+
+struct FakeCompositor
+{
+	xrt_compositor base = {};
+	int64_t frame_id = 0;
+	int64_t last_begun = -1;
+
+	FakeCompositor()
+	{
+		base.predict_frame = [](xrt_compositor *xc, int64_t *out_frame_id, uint64_t *out_wake_time_ns,
+		                        uint64_t *out_predicted_gpu_time_ns, uint64_t *out_predicted_display_time_ns,
+		                        uint64_t *out_predicted_display_period_ns) {
+			FakeCompositor *fc = reinterpret_cast<FakeCompositor *>(xc);
+			*out_frame_id = ++fc->frame_id;
+			*out_wake_time_ns = 0;
+			*out_predicted_gpu_time_ns = 0;
+			*out_predicted_display_time_ns = 1000 * fc->frame_id;
+			*out_predicted_display_period_ns = 1000;
+			return XRT_SUCCESS;
+		};
+		base.mark_frame = [](xrt_compositor *, int64_t frame_id, xrt_compositor_frame_point, uint64_t) {
+			return frame_id < 0 ? XRT_ERROR_IPC_FAILURE : XRT_SUCCESS;
+		};
+		base.begin_frame = [](xrt_compositor *xc, int64_t frame_id) {
+			reinterpret_cast<FakeCompositor *>(xc)->last_begun = frame_id;
+			return XRT_SUCCESS;
+		};
+	}
+};
+
+/*!
+ * A service with one client connected through a socketpair, the server side
+ * runs the generated dispatch on its own thread like the per client thread.
+ */
+struct Loopback
+{
+	std::unique_ptr<ipc_server> s = std::make_unique<ipc_server>();
+	std::unique_ptr<ipc_shared_memory> ism = std::make_unique<ipc_shared_memory>();
+	ipc_connection ipc_c = {};
+
+	FakeCompositor xc;
+	FakeSwapchain xscs[kSwapchainCount];
+	xrt_device xdev = {};
+	uint32_t updates = 0;
+
+	std::atomic<uint64_t> messages{0};
+	std::thread thread;
+
+	Loopback()
+	{
+		int fds[2];
+		REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+		s->ism = ism.get();
+		s->running = true;
+		s->log_level = U_LOGGING_WARN;
+		os_mutex_init(&s->global_state.lock);
+
+		xdev.update_inputs = [](xrt_device *) {};
+		s->idevs[0].xdev = &xdev;
+		s->idevs[0].io_active = true;
+
+		volatile ipc_client_state *ics = &s->threads[0].ics;
+		ics->server = s.get();
+		ics->xc = &xc.base;
+		ics->io_active = true;
+		ics->imc.socket_fd = fds[1];
+		ics->server_thread_index = 0;
+		ics->client_state.session_active = true;
+		for (uint32_t i = 0; i < kSwapchainCount; i++) {
+			ics->xscs[i] = &xscs[i].base;
+		}
+
+		ipc_c.imc.socket_fd = fds[0];
+		ipc_c.ism = ism.get();
+		ipc_c.log_level = U_LOGGING_WARN;
+		os_mutex_init(&ipc_c.mutex);
+
+		thread = std::thread([this, ics] {
+			uint8_t buf[IPC_BUF_SIZE];
+			while (true) {
+				ssize_t len = recv(ics->imc.socket_fd, buf, sizeof(buf), 0);
+				if (len < 4) {
+					break;
+				}
+				messages++;
+				if (ipc_dispatch(ics, (ipc_command_t *)buf) != XRT_SUCCESS) {
+					break;
+				}
+			}
+		});
+	}
+
+	~Loopback()
+	{
+		shutdown(ipc_c.imc.socket_fd, SHUT_RDWR);
+		thread.join();
+		close(ipc_c.imc.socket_fd);
+		close(s->threads[0].ics.imc.socket_fd);
+		os_mutex_destroy(&ipc_c.mutex);
+		os_mutex_destroy(&s->global_state.lock);
+	}
+};
+
+//! Every call on its own, how the client used to do it.
+void
+frame_per_call(Loopback &lb)
+{
+	ipc_connection *ipc_c = &lb.ipc_c;
+	int64_t frame_id = 0;
+	uint64_t wake = 0, display = 0, period = 0;
+
+	ipc_call_compositor_predict_frame(ipc_c, &frame_id, &wake, &display, &period);
+	ipc_call_compositor_wait_woke(ipc_c, frame_id);
+	ipc_call_compositor_begin_frame(ipc_c, frame_id);
+	ipc_call_device_update_input(ipc_c, 0);
+	for (uint32_t i = 0; i < kSwapchainCount; i++) {
+		uint32_t index = 0;
+		ipc_call_swapchain_acquire_image(ipc_c, i, &index);
+		ipc_call_swapchain_wait_image(ipc_c, i, UINT64_MAX, index);
+		ipc_call_swapchain_release_image(ipc_c, i, index);
+	}
+}
+
+//! Same calls with the releases deferred, what the client compositor does.
+void
+frame_deferred(Loopback &lb)
+{
+	ipc_connection *ipc_c = &lb.ipc_c;
+	int64_t frame_id = 0;
+	uint64_t wake = 0, display = 0, period = 0;
+
+	ipc_call_compositor_predict_frame(ipc_c, &frame_id, &wake, &display, &period);
+	ipc_call_compositor_wait_woke(ipc_c, frame_id);
+	ipc_call_compositor_begin_frame(ipc_c, frame_id);
+	ipc_call_device_update_input(ipc_c, 0);
+	for (uint32_t i = 0; i < kSwapchainCount; i++) {
+		uint32_t index = 0;
+		ipc_call_swapchain_acquire_image(ipc_c, i, &index);
+		ipc_call_swapchain_wait_image(ipc_c, i, UINT64_MAX, index);
+		ipc_defer_swapchain_release_image(ipc_c, i, index);
+	}
+}
+
+//! Everything that doesn't depend on an earlier reply batched together.
+void
+frame_batched(Loopback &lb)
+{
+	ipc_connection *ipc_c = &lb.ipc_c;
+	int64_t frame_id = 0;
+	uint64_t wake = 0, display = 0, period = 0;
+	uint32_t indices[kSwapchainCount] = {};
+	ipc_batch batch = {};
+
+	// Needed to know when to wake up.
+	ipc_call_compositor_predict_frame(ipc_c, &frame_id, &wake, &display, &period);
+
+	ipc_batch_compositor_wait_woke(&batch, frame_id);
+	ipc_batch_compositor_begin_frame(&batch, frame_id);
+	ipc_batch_device_update_input(&batch, 0);
+	for (uint32_t i = 0; i < kSwapchainCount; i++) {
+		ipc_batch_swapchain_acquire_image(&batch, i, &indices[i]);
+	}
+	ipc_batch_submit(ipc_c, &batch);
+
+	// Waits need the acquired index.
+	for (uint32_t i = 0; i < kSwapchainCount; i++) {
+		ipc_batch_swapchain_wait_image(&batch, i, UINT64_MAX, indices[i]);
+	}
+	ipc_batch_submit(ipc_c, &batch);
+
+	for (uint32_t i = 0; i < kSwapchainCount; i++) {
+		ipc_defer_swapchain_release_image(ipc_c, i, indices[i]);
+	}
+}
+
+} // namespace
+
+
+TEST_CASE("ipc_batch")
+{
+	Loopback lb;
+	ipc_connection *ipc_c = &lb.ipc_c;
+
+	SECTION("Out arguments and order")
+	{
+		ipc_batch batch = {};
+		int64_t frame_id = 0;
+		uint64_t wake = 0, display = 0, period = 0;
+		uint32_t a = 42, b = 42, c = 42;
+
+		CHECK(ipc_batch_compositor_predict_frame(&batch, &frame_id, &wake, &display, &period));
+		CHECK(ipc_batch_swapchain_acquire_image(&batch, 0, &a));
+		CHECK(ipc_batch_swapchain_acquire_image(&batch, 0, &b));
+		CHECK(ipc_batch_swapchain_acquire_image(&batch, 1, &c));
+		CHECK(ipc_batch_compositor_begin_frame(&batch, 7));
+
+		CHECK(ipc_batch_submit(ipc_c, &batch) == XRT_SUCCESS);
+		CHECK(lb.messages == 1);
+		CHECK(batch.call_count == 0);
+		CHECK(frame_id == 1);
+		CHECK(display == 1000);
+		CHECK(period == 1000);
+		CHECK(a == 0);
+		CHECK(b == 1);
+		CHECK(c == 0);
+		CHECK(lb.xc.last_begun == 7);
+	}
+
+	SECTION("Failing call stops the batch")
+	{
+		ipc_batch batch = {};
+		uint32_t a = 42, b = 42;
+
+		CHECK(ipc_batch_swapchain_acquire_image(&batch, 0, &a));
+		CHECK(ipc_batch_compositor_wait_woke(&batch, -1));
+		CHECK(ipc_batch_swapchain_acquire_image(&batch, 0, &b));
+		CHECK(ipc_batch_compositor_begin_frame(&batch, 7));
+
+		CHECK(ipc_batch_submit(ipc_c, &batch) == XRT_ERROR_IPC_FAILURE);
+		CHECK(a == 0);
+		CHECK(b == 42);
+		CHECK(lb.xc.last_begun == -1);
+		CHECK(lb.xscs[0].next == 1);
+
+		// The connection is still fine.
+		CHECK(ipc_call_swapchain_acquire_image(ipc_c, 0, &b) == XRT_SUCCESS);
+		CHECK(b == 1);
+	}
+
+	SECTION("Full batch")
+	{
+		ipc_batch batch = {};
+		uint32_t indices[IPC_BATCH_MAX_CALLS + 1] = {};
+
+		for (uint32_t i = 0; i < IPC_BATCH_MAX_CALLS; i++) {
+			CHECK(ipc_batch_swapchain_acquire_image(&batch, 0, &indices[i]));
+		}
+		CHECK_FALSE(ipc_batch_swapchain_acquire_image(&batch, 0, &indices[IPC_BATCH_MAX_CALLS]));
+		CHECK(batch.call_count == IPC_BATCH_MAX_CALLS);
+
+		CHECK(ipc_batch_submit(ipc_c, &batch) == XRT_SUCCESS);
+		CHECK(indices[IPC_BATCH_MAX_CALLS - 1] == (IPC_BATCH_MAX_CALLS - 1) % 3);
+	}
+
+	SECTION("Deferred calls go with the next call")
+	{
+		CHECK(ipc_defer_swapchain_release_image(ipc_c, 0, 0) == XRT_SUCCESS);
+		CHECK(ipc_defer_swapchain_release_image(ipc_c, 1, 0) == XRT_SUCCESS);
+		CHECK(lb.messages == 0);
+
+		uint32_t index = 42;
+		CHECK(ipc_call_swapchain_acquire_image(ipc_c, 1, &index) == XRT_SUCCESS);
+		CHECK(index == 0);
+		CHECK(lb.messages == 1);
+
+		// Calls without out arguments too.
+		CHECK(ipc_defer_swapchain_release_image(ipc_c, 0, 0) == XRT_SUCCESS);
+		ipc_app_state desc = {};
+		desc.pid = 1234;
+		CHECK(ipc_call_system_set_client_info(ipc_c, &desc) == XRT_SUCCESS);
+		CHECK(lb.messages == 2);
+		CHECK(lb.s->threads[0].ics.client_state.pid == 1234);
+	}
+
+	SECTION("Failing deferred call doesn't fail the next call")
+	{
+		CHECK(ipc_defer_compositor_wait_woke(ipc_c, -1) == XRT_SUCCESS);
+		CHECK(ipc_defer_compositor_begin_frame(ipc_c, 7) == XRT_SUCCESS);
+
+		// Sent in the same message, still run and its own result.
+		uint32_t index = 42;
+		CHECK(ipc_call_swapchain_acquire_image(ipc_c, 0, &index) == XRT_SUCCESS);
+		CHECK(index == 0);
+		CHECK(lb.messages == 1);
+		CHECK(lb.xc.last_begun == 7);
+
+		// Same when the call isn't batchable.
+		CHECK(ipc_defer_compositor_wait_woke(ipc_c, -1) == XRT_SUCCESS);
+		ipc_app_state desc = {};
+		desc.pid = 1234;
+		CHECK(ipc_call_system_set_client_info(ipc_c, &desc) == XRT_SUCCESS);
+		CHECK(lb.s->threads[0].ics.client_state.pid == 1234);
+	}
+
+	SECTION("Deferred calls flush when full")
+	{
+		for (uint32_t i = 0; i < IPC_BATCH_MAX_CALLS + 1; i++) {
+			CHECK(ipc_defer_swapchain_release_image(ipc_c, 0, 0) == XRT_SUCCESS);
+		}
+		CHECK(lb.messages == 1);
+		CHECK(ipc_c->deferred.call_count == 1);
+	}
+}
+
+TEST_CASE("ipc_batch fewer messages per frame")
+{
+	Loopback lb;
+
+	const int frames = 10;
+	for (int i = 0; i < frames; i++) {
+		frame_per_call(lb);
+	}
+	uint64_t per_call = lb.messages;
+
+	lb.messages = 0;
+	for (int i = 0; i < frames; i++) {
+		frame_batched(lb);
+	}
+	uint64_t batched = lb.messages;
+
+	CHECK(per_call == frames * 10);
+	CHECK(batched * 3 <= per_call);
+}
+
+TEST_CASE("ipc_batch benchmark", "[.benchmark]")
+{
+	using clock = std::chrono::steady_clock;
+
+	struct Mode
+	{
+		const char *name;
+		void (*frame)(Loopback &);
+	};
+	const Mode modes[] = {
+	    {"per call", frame_per_call},
+	    {"deferred", frame_deferred},
+	    {"batched", frame_batched},
+	};
+
+	// Client side each message is a sendmsg and a recvmsg, the service does
+	// an epoll_wait, a recv and a sendmsg.
+	std::cout << std::left << std::setw(12) << "mode" << std::right << std::setw(14) << "msgs/frame"
+	          << std::setw(16) << "syscalls/frame" << std::setw(14) << "us/frame" << std::endl;
+
+	for (const Mode &mode : modes) {
+		Loopback lb;
+		const int frames = 20000;
+
+		auto start = clock::now();
+		for (int i = 0; i < frames; i++) {
+			mode.frame(lb);
+		}
+		double us = std::chrono::duration<double, std::micro>(clock::now() - start).count() / frames;
+		double msgs = (double)lb.messages / frames;
+
+		std::cout << std::left << std::setw(12) << mode.name << std::right << std::fixed
+		          << std::setprecision(2) << std::setw(14) << msgs << std::setw(16) << msgs * 5
+		          << std::setw(14) << us << std::endl;
+	}
+}
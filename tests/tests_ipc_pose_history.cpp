@@ -0,0 +1,308 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Shared memory pose history tests and benchmark.
+ *
+ * The benchmark is hidden, run it with `tests_ipc_pose_history "[.benchmark]"`.
+ */
+
+#include "os/os_time.h"
+#include "util/u_time.h"
+#include "shared/ipc_pose_history.h"
+
+#include "catch/catch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+namespace {
+
+constexpr uint64_t kMs = U_TIME_1MS_IN_NS;
+
+std::unique_ptr<ipc_shared_memory>
+make_ism()
+{
+	// Value initialized, so zeroed like the real shared memory.
+	auto ism = std::make_unique<ipc_shared_memory>();
+	ism->poses.max_age_ns = 10 * kMs;
+	ism->poses.max_extrapolation_ns = 4 * kMs;
+	ism->poses.max_gap_ns = 8 * kMs;
+	return ism;
+}
+
+xrt_space_relation
+relation_at(float v)
+{
+	xrt_space_relation rel = XRT_SPACE_RELATION_ZERO;
+	rel.relation_flags = (xrt_space_relation_flags)(
+	    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | XRT_SPACE_RELATION_POSITION_VALID_BIT |
+	    XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT | XRT_SPACE_RELATION_POSITION_TRACKED_BIT |
+	    XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT);
+	rel.pose.orientation.w = 1.0f;
+	rel.pose.position = {v, v, v};
+	// One unit per millisecond.
+	rel.linear_velocity = {1000.0f, 1000.0f, 1000.0f};
+	return rel;
+}
+
+} // namespace
+
+
+TEST_CASE("ipc_pose_history")
+{
+	auto ism = make_ism();
+	const uint64_t now = 1000 * kMs;
+
+	CHECK(ipc_pose_history_find(ism.get(), 0, XRT_INPUT_GENERIC_HEAD_POSE) == nullptr);
+
+	ipc_shared_pose_history *iph = ipc_pose_history_claim(ism.get(), 0, XRT_INPUT_GENERIC_HEAD_POSE);
+	REQUIRE(iph != nullptr);
+	CHECK(ipc_pose_history_find(ism.get(), 0, XRT_INPUT_GENERIC_HEAD_POSE) == iph);
+	CHECK(ipc_pose_history_claim(ism.get(), 0, XRT_INPUT_GENERIC_HEAD_POSE) == iph);
+
+	xrt_space_relation out = {};
+
+	// Nothing published yet.
+	CHECK_FALSE(ipc_pose_history_get(ism.get(), iph, now, now, &out));
+
+	// Out of order, like requests from different clients.
+	xrt_space_relation r20 = relation_at(20);
+	xrt_space_relation r10 = relation_at(10);
+	ipc_pose_history_push(iph, now + 20 * kMs, now, &r20);
+	ipc_pose_history_push(iph, now + 10 * kMs, now, &r10);
+
+	SECTION("Exact")
+	{
+		REQUIRE(ipc_pose_history_get(ism.get(), iph, now + 10 * kMs, now, &out));
+		CHECK(out.pose.position.x == 10.0f);
+	}
+
+	SECTION("Gap too big to interpolate")
+	{
+		CHECK_FALSE(ipc_pose_history_get(ism.get(), iph, now + 15 * kMs, now, &out));
+	}
+
+	SECTION("Interpolate")
+	{
+		xrt_space_relation r14 = relation_at(14);
+		ipc_pose_history_push(iph, now + 14 * kMs, now, &r14);
+
+		REQUIRE(ipc_pose_history_get(ism.get(), iph, now + 17 * kMs, now, &out));
+		CHECK(out.pose.position.x == Approx(17.0f));
+		CHECK(out.pose.position.z == Approx(17.0f));
+	}
+
+	SECTION("Extrapolate")
+	{
+		REQUIRE(ipc_pose_history_get(ism.get(), iph, now + 23 * kMs, now, &out));
+		CHECK(out.pose.position.x == Approx(23.0f));
+
+		// Too far ahead.
+		CHECK_FALSE(ipc_pose_history_get(ism.get(), iph, now + 25 * kMs, now, &out));
+	}
+
+	SECTION("Too old")
+	{
+		CHECK_FALSE(ipc_pose_history_get(ism.get(), iph, now + 10 * kMs, now + 11 * kMs, &out));
+	}
+
+	SECTION("Ring wraps around")
+	{
+		for (uint32_t i = 0; i < IPC_SHARED_POSE_HISTORY_SIZE; i++) {
+			xrt_space_relation rel = relation_at(100.0f + i);
+			ipc_pose_history_push(iph, now + (100 + i) * kMs, now, &rel);
+		}
+
+		// The first two got overwritten.
+		CHECK_FALSE(ipc_pose_history_get(ism.get(), iph, now + 10 * kMs, now, &out));
+		REQUIRE(ipc_pose_history_get(ism.get(), iph, now + 105 * kMs, now, &out));
+		CHECK(out.pose.position.x == 105.0f);
+	}
+
+	SECTION("Histories per device are limited")
+	{
+		const xrt_input_name names[] = {XRT_INPUT_INDEX_GRIP_POSE, XRT_INPUT_INDEX_AIM_POSE,
+		                                XRT_INPUT_SIMPLE_GRIP_POSE, XRT_INPUT_SIMPLE_AIM_POSE};
+		static_assert(sizeof(names) / sizeof(names[0]) == IPC_SHARED_MAX_POSE_HISTORIES, "");
+
+		// One is already taken by the head.
+		for (uint32_t i = 0; i < IPC_SHARED_MAX_POSE_HISTORIES - 1; i++) {
+			CHECK(ipc_pose_history_claim(ism.get(), 0, names[i]) != nullptr);
+		}
+		CHECK(ipc_pose_history_claim(ism.get(), 0, names[IPC_SHARED_MAX_POSE_HISTORIES - 1]) == nullptr);
+		CHECK(ipc_pose_history_claim(ism.get(), 1, names[0]) != nullptr);
+	}
+}
+
+TEST_CASE("ipc_pose_history concurrent")
+{
+	auto ism = make_ism();
+	ism->poses.max_age_ns = UINT64_MAX / 2;
+	ism->poses.max_gap_ns = UINT64_MAX / 2;
+
+	ipc_shared_pose_history *iph = ipc_pose_history_claim(ism.get(), 0, XRT_INPUT_GENERIC_HEAD_POSE);
+	REQUIRE(iph != nullptr);
+
+	std::atomic<uint64_t> newest{0};
+	std::atomic<bool> stop{false};
+	std::atomic<int> torn{0};
+	std::atomic<uint64_t> reads{0};
+
+	// Every sample has all coordinates the same, torn reads would mix them.
+	std::thread writer([&] {
+		for (uint64_t i = 1; i <= 200000; i++) {
+			xrt_space_relation rel = relation_at((float)i);
+			rel.linear_velocity = {0, 0, 0};
+			ipc_pose_history_push(iph, i * 100, 0, &rel);
+			newest.store(i, std::memory_order_release);
+		}
+		// On a single core the writer can be done before any reader got to run.
+		while (reads == 0) {
+			std::this_thread::yield();
+		}
+		stop = true;
+	});
+
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 3; r++) {
+		readers.emplace_back([&] {
+			while (!stop) {
+				uint64_t at = newest.load(std::memory_order_acquire) * 100;
+				xrt_space_relation out = {};
+				if (!ipc_pose_history_get(ism.get(), iph, at, 0, &out)) {
+					continue;
+				}
+				xrt_vec3 p = out.pose.position;
+				if (p.x != p.y || p.y != p.z) {
+					torn++;
+				}
+				reads++;
+			}
+		});
+	}
+
+	writer.join();
+	for (std::thread &t : readers) {
+		t.join();
+	}
+
+	CHECK(torn == 0);
+	CHECK(reads > 0);
+}
+
+TEST_CASE("ipc_pose_history benchmark", "[.benchmark]")
+{
+	using clock = std::chrono::steady_clock;
+
+	auto ism = make_ism();
+	ipc_shared_pose_history *iph = ipc_pose_history_claim(ism.get(), 0, XRT_INPUT_GENERIC_HEAD_POSE);
+	ism->poses.max_age_ns = 20 * kMs;
+
+	// Publish at 500Hz 10ms ahead, like the service.
+	std::atomic<bool> stop{false};
+	std::thread publisher([&] {
+		while (!stop) {
+			uint64_t now = os_monotonic_get_ns();
+			xrt_space_relation rel = relation_at(1.0f);
+			ipc_pose_history_push(iph, now + 10 * kMs, now, &rel);
+			os_nanosleep(2 * kMs);
+		}
+	});
+
+	// What the call does, one socket per connection shared by the threads of
+	// a client under a mutex, and a thread on the other end answering.
+	int fds[2];
+	REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	std::thread server([&] {
+		uint8_t request[32];
+		while (read(fds[1], request, sizeof(request)) == (ssize_t)sizeof(request)) {
+			xrt_space_relation out = {};
+			uint64_t now = os_monotonic_get_ns();
+			ipc_pose_history_get(ism.get(), iph, now + 10 * kMs, now, &out);
+			if (write(fds[1], &out, sizeof(out)) != (ssize_t)sizeof(out)) {
+				break;
+			}
+		}
+	});
+	std::mutex socket_mutex;
+
+	auto run = [&](int thread_count, bool shared) {
+		const int calls = 20000;
+		std::vector<std::vector<double>> latencies(thread_count);
+		std::atomic<int> hits{0};
+
+		auto start = clock::now();
+		std::vector<std::thread> threads;
+		for (int t = 0; t < thread_count; t++) {
+			threads.emplace_back([&, t] {
+				std::vector<double> &lat = latencies[t];
+				lat.reserve(calls);
+				for (int i = 0; i < calls; i++) {
+					auto before = clock::now();
+					xrt_space_relation out = {};
+					if (shared) {
+						uint64_t now = os_monotonic_get_ns();
+						hits += ipc_pose_history_get(ism.get(), iph, now + 10 * kMs, now, &out) ? 1 : 0;
+					} else {
+						std::lock_guard lock{socket_mutex};
+						uint8_t request[32] = {};
+						if (write(fds[0], request, sizeof(request)) != (ssize_t)sizeof(request) ||
+						    read(fds[0], &out, sizeof(out)) != (ssize_t)sizeof(out)) {
+							return;
+						}
+					}
+					lat.push_back(std::chrono::duration<double, std::micro>(clock::now() - before).count());
+				}
+			});
+		}
+		for (std::thread &t : threads) {
+			t.join();
+		}
+		double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+		std::vector<double> all;
+		for (auto &lat : latencies) {
+			all.insert(all.end(), lat.begin(), lat.end());
+		}
+		std::sort(all.begin(), all.end());
+		double avg = 0;
+		for (double v : all) {
+			avg += v;
+		}
+		avg /= all.size();
+
+		std::cout << std::left << std::setw(10) << (shared ? "shared" : "socket") << std::right
+		          << std::setw(8) << thread_count << std::fixed << std::setprecision(0) << std::setw(14)
+		          << all.size() / seconds << std::setprecision(2) << std::setw(12) << avg << std::setw(12)
+		          << all[all.size() / 2] << std::setw(12) << all[all.size() * 99 / 100] << std::setw(10)
+		          << (shared ? 100.0 * hits / all.size() : 100.0) << std::endl;
+	};
+
+	std::cout << std::left << std::setw(10) << "path" << std::right << std::setw(8) << "threads" << std::setw(14)
+	          << "calls/s" << std::setw(12) << "avg (us)" << std::setw(12) << "p50 (us)" << std::setw(12)
+	          << "p99 (us)" << std::setw(10) << "hit %" << std::endl;
+
+	for (int threads : {1, 2, 4, 8}) {
+		run(threads, false);
+		run(threads, true);
+	}
+
+	stop = true;
+	publisher.join();
+	shutdown(fds[0], SHUT_RDWR);
+	server.join();
+	close(fds[0]);
+	close(fds[1]);
+}
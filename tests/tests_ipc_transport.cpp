@@ -0,0 +1,703 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief IPC transport tests and latency benchmark.
+ *
+ * Runs the real per client threads or the event loop of the service in
+ * process, with a simulated HMD and a fake compositor so no GPU is needed, and
+ * drives them through the generated client calls. The benchmark is hidden, run
+ * it with `tests_ipc_transport "[.benchmark]"`, the number of clients and
+ * threads per client can be set with `IPC_BENCH_CLIENTS` and
+ * `IPC_BENCH_THREADS`, `IPC_BENCH_WORKERS` serves them from the event loop.
+ */
+
+#include "xrt/xrt_compositor.h"
+#include "xrt/xrt_device.h"
+#include "xrt/xrt_instance.h"
+#include "os/os_time.h"
+#include "util/u_latency_histogram.h"
+#include "server/ipc_server.h"
+#include "simulated/simulated_interface.h"
+
+extern "C" {
+#include "client/ipc_client.h"
+#include "ipc_client_generated.h"
+}
+
+#include "catch/catch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+/*
+ * Normally provided by the service target, the service main is never run
+ * here so they are never called.
+ */
+extern "C" {
+
+xrt_result_t
+xrt_instance_create(struct xrt_instance_info *ii, struct xrt_instance **out_xinst)
+{
+	return XRT_ERROR_IPC_FAILURE;
+}
+
+int
+oxr_sdl2_hack_create(void **out_hack)
+{
+	return 0;
+}
+
+void
+oxr_sdl2_hack_start(void *hack, struct xrt_instance *xinst, struct xrt_system_devices *xsysd)
+{}
+
+void
+oxr_sdl2_hack_stop(void **hack_ptr)
+{}
+}
+
+
+namespace {
+
+enum Call
+{
+	CALL_GET_TRACKED_POSE,
+	CALL_UPDATE_INPUT,
+	CALL_PREDICT_FRAME,
+	CALL_BEGIN_FRAME,
+	CALL_ACQUIRE_IMAGE,
+	CALL_COUNT,
+};
+
+const char *const call_names[CALL_COUNT] = {
+    "get_tracked_pose", "update_input", "predict_frame", "begin_frame", "acquire_image",
+};
+
+/*!
+ * Holds image waits until opened, like a client waiting on the GPU.
+ */
+struct ImageGate
+{
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool closed = false;
+	uint32_t waiting = 0;
+
+	void
+	wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		waiting++;
+		cond.wait(lock, [this] { return !closed; });
+		waiting--;
+	}
+
+	void
+	open()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = false;
+		cond.notify_all();
+	}
+
+	//! Returns once @p count waits are being held, false if that doesn't happen.
+	bool
+	wait_for_waiting(uint32_t count)
+	{
+		for (int i = 0; i < 2000; i++) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (waiting == count) {
+					return true;
+				}
+			}
+			os_nanosleep(U_TIME_1MS_IN_NS);
+		}
+		return false;
+	}
+};
+
+struct FakeSwapchain
+{
+	xrt_swapchain base = {};
+	uint32_t next = 0;
+	ImageGate *gate = nullptr;
+
+	FakeSwapchain()
+	{
+		// Owned by the test, the service only ever drops its reference.
+		base.reference.count = 1;
+		base.image_count = 3;
+		base.destroy = [](xrt_swapchain *) {};
+		base.acquire_image = [](xrt_swapchain *xsc, uint32_t *out_index) {
+			FakeSwapchain *fs = reinterpret_cast<FakeSwapchain *>(xsc);
+			*out_index = fs->next;
+			fs->next = (fs->next + 1) % xsc->image_count;
+			return XRT_SUCCESS;
+		};
+		base.wait_image = [](xrt_swapchain *xsc, uint64_t, uint32_t) {
+			FakeSwapchain *fs = reinterpret_cast<FakeSwapchain *>(xsc);
+			if (fs->gate != nullptr) {
+				fs->gate->wait();
+			}
+			return XRT_SUCCESS;
+		};
+	}
+};
+
+/*!
+ * The service threads that have handled calls.
+ */
+struct ThreadSet
+{
+	std::mutex mutex;
+	std::set<std::thread::id> ids;
+
+	void
+	add()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ids.insert(std::this_thread::get_id());
+	}
+};
+
+struct FakeCompositor
+{
+	xrt_compositor base = {};
+	int64_t frame_id = 0;
+	ThreadSet *threads = nullptr;
+
+	FakeCompositor()
+	{
+		base.destroy = [](xrt_compositor *) {};
+		base.predict_frame = [](xrt_compositor *xc, int64_t *out_frame_id, uint64_t *out_wake_time_ns,
+		                        uint64_t *out_predicted_gpu_time_ns, uint64_t *out_predicted_display_time_ns,
+		                        uint64_t *out_predicted_display_period_ns) {
+			FakeCompositor *fc = reinterpret_cast<FakeCompositor *>(xc);
+			if (fc->threads != nullptr) {
+				fc->threads->add();
+			}
+			*out_frame_id = ++fc->frame_id;
+			*out_wake_time_ns = 0;
+			*out_predicted_gpu_time_ns = 0;
+			*out_predicted_display_time_ns = os_monotonic_get_ns();
+			*out_predicted_display_period_ns = 1000;
+			return XRT_SUCCESS;
+		};
+		base.begin_frame = [](xrt_compositor *, int64_t) { return XRT_SUCCESS; };
+	}
+};
+
+/*!
+ * One connected client, the service end runs the real per client thread or
+ * is served by the event loop.
+ */
+struct Client
+{
+	ipc_connection ipc_c = {};
+	FakeCompositor xc;
+	FakeSwapchain xsc;
+	std::thread thread;
+};
+
+/*!
+ * The service, with a simulated HMD as its only device, @p workers non-zero
+ * serves the clients from the event loop.
+ */
+struct Service
+{
+	std::unique_ptr<ipc_server> s = std::make_unique<ipc_server>();
+	std::unique_ptr<ipc_shared_memory> ism = std::make_unique<ipc_shared_memory>();
+	xrt_system_compositor xsysc = {};
+	xrt_device *xdev = nullptr;
+	std::vector<std::unique_ptr<Client>> clients;
+	ThreadSet threads;
+
+	explicit Service(uint32_t client_count, bool latency_stats = false, uint32_t workers = 0)
+	{
+		REQUIRE(client_count <= IPC_MAX_CLIENTS);
+
+		s->ism = ism.get();
+		s->xsysc = &xsysc;
+		s->running = true;
+		s->latency_stats = latency_stats;
+		s->log_level = U_LOGGING_WARN;
+		s->global_state.active_client_index = -1;
+		s->global_state.last_active_client_index = -1;
+		os_mutex_init(&s->global_state.lock);
+		os_mutex_init(&s->pose_publisher.lock);
+
+		xdev = simulated_hmd_create();
+		REQUIRE(xdev != nullptr);
+		s->idevs[0].xdev = xdev;
+		s->idevs[0].io_active = true;
+
+		ipc_shared_device *isdev = &ism->isdevs[0];
+		isdev->input_count = xdev->input_count;
+		isdev->first_input_index = 0;
+		for (uint32_t i = 0; i < xdev->input_count; i++) {
+			ism->inputs[i] = xdev->inputs[i];
+			ism->inputs[i].active = true;
+		}
+
+		for (uint32_t i = 0; i < IPC_MAX_CLIENTS; i++) {
+			s->threads[i].ics.server_thread_index = -1;
+		}
+
+		if (workers > 0) {
+			REQUIRE(ipc_server_event_loop_init(s.get(), workers) == 0);
+		}
+
+		for (uint32_t i = 0; i < client_count; i++) {
+			connect(i);
+		}
+	}
+
+	~Service()
+	{
+		for (auto &c : clients) {
+			shutdown(c->ipc_c.imc.socket_fd, SHUT_RDWR);
+			if (c->thread.joinable()) {
+				c->thread.join();
+			}
+		}
+
+		// Waits for the workers and disconnects anything left.
+		ipc_server_event_loop_fini(s.get());
+
+		for (auto &c : clients) {
+			close(c->ipc_c.imc.socket_fd);
+			os_mutex_destroy(&c->ipc_c.mutex);
+		}
+
+		xrt_device_destroy(&xdev);
+		os_mutex_destroy(&s->pose_publisher.lock);
+		os_mutex_destroy(&s->global_state.lock);
+	}
+
+	void
+	connect(uint32_t index)
+	{
+		int fds[2];
+		REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+		auto c = std::make_unique<Client>();
+		c->xc.threads = &threads;
+
+		// Set up the same way the mainloop does when accepting a client.
+		ipc_thread *it = &s->threads[index];
+		volatile ipc_client_state *ics = &it->ics;
+		ics->server = s.get();
+		ics->xc = &c->xc.base;
+		ics->xscs[0] = &c->xsc.base;
+		ics->swapchain_count = 1;
+		ics->io_active = true;
+		ics->imc.socket_fd = fds[1];
+		ics->server_thread_index = (int32_t)index;
+		ics->client_state.session_active = true;
+		it->state = IPC_THREAD_RUNNING;
+
+		c->ipc_c.imc.socket_fd = fds[0];
+		c->ipc_c.ism = ism.get();
+		c->ipc_c.client_id = index;
+		c->ipc_c.log_level = U_LOGGING_WARN;
+		os_mutex_init(&c->ipc_c.mutex);
+
+		if (s->event_loop.worker_count > 0) {
+			os_mutex_lock(&s->global_state.lock);
+			int ret = ipc_server_event_loop_add_client(s.get(), ics);
+			os_mutex_unlock(&s->global_state.lock);
+			REQUIRE(ret == 0);
+		} else {
+			c->thread = std::thread([ics] { ipc_server_client_thread((void *)ics); });
+		}
+
+		clients.push_back(std::move(c));
+	}
+
+	//! Hangs up all clients, returns once the event loop has freed all slots.
+	bool
+	hang_up_all_and_wait()
+	{
+		for (auto &c : clients) {
+			shutdown(c->ipc_c.imc.socket_fd, SHUT_RDWR);
+		}
+
+		for (int i = 0; i < 2000; i++) {
+			bool all_free = true;
+			for (size_t k = 0; k < clients.size(); k++) {
+				const ipc_thread &it = s->threads[k];
+				all_free = all_free && it.ics.server_thread_index < 0 && it.state == IPC_THREAD_READY;
+			}
+			if (all_free) {
+				return true;
+			}
+			os_nanosleep(U_TIME_1MS_IN_NS);
+		}
+
+		return false;
+	}
+};
+
+/*!
+ * Latencies seen by one client thread, one histogram per call.
+ */
+struct Stats
+{
+	u_latency_histogram calls[CALL_COUNT] = {};
+	uint64_t failures = 0;
+
+	void
+	merge(const Stats &other)
+	{
+		for (uint32_t i = 0; i < CALL_COUNT; i++) {
+			u_latency_histogram_merge(&calls[i], &other.calls[i]);
+		}
+		failures += other.failures;
+	}
+
+	uint64_t
+	total() const
+	{
+		uint64_t count = 0;
+		for (const u_latency_histogram &ulh : calls) {
+			count += ulh.count;
+		}
+		return count;
+	}
+};
+
+template <typename F>
+void
+timed(Stats &stats, Call call, F &&func)
+{
+	uint64_t start_ns = os_monotonic_get_ns();
+	xrt_result_t xret = func();
+	u_latency_histogram_add(&stats.calls[call], os_monotonic_get_ns() - start_ns);
+
+	if (xret != XRT_SUCCESS) {
+		stats.failures++;
+	}
+}
+
+//! The calls an application makes each frame, minus the swapchain waits.
+void
+run_frame(ipc_connection *ipc_c, Stats &stats)
+{
+	int64_t frame_id = 0;
+	uint64_t wake = 0, display = 0, period = 0;
+	uint32_t index = 0;
+	xrt_space_relation rel = {};
+
+	timed(stats, CALL_PREDICT_FRAME,
+	      [&] { return ipc_call_compositor_predict_frame(ipc_c, &frame_id, &wake, &display, &period); });
+	timed(stats, CALL_UPDATE_INPUT, [&] { return ipc_call_device_update_input(ipc_c, 0); });
+	timed(stats, CALL_GET_TRACKED_POSE, [&] {
+		return ipc_call_device_get_tracked_pose(ipc_c, 0, XRT_INPUT_GENERIC_HEAD_POSE, display, &rel);
+	});
+	timed(stats, CALL_BEGIN_FRAME, [&] { return ipc_call_compositor_begin_frame(ipc_c, frame_id); });
+	timed(stats, CALL_ACQUIRE_IMAGE, [&] { return ipc_call_swapchain_acquire_image(ipc_c, 0, &index); });
+}
+
+/*!
+ * Run @p frames frames on each of @p threads_per_client threads per client,
+ * returns the merged stats.
+ */
+Stats
+run(Service &service, uint32_t threads_per_client, uint32_t frames)
+{
+	std::vector<Stats> per_thread(service.clients.size() * threads_per_client);
+	std::vector<std::thread> threads;
+
+	for (size_t c = 0; c < service.clients.size(); c++) {
+		ipc_connection *ipc_c = &service.clients[c]->ipc_c;
+		for (uint32_t t = 0; t < threads_per_client; t++) {
+			Stats *stats = &per_thread[c * threads_per_client + t];
+			threads.emplace_back([ipc_c, stats, frames] {
+				for (uint32_t f = 0; f < frames; f++) {
+					run_frame(ipc_c, *stats);
+				}
+			});
+		}
+	}
+
+	for (std::thread &t : threads) {
+		t.join();
+	}
+
+	Stats merged;
+	for (const Stats &stats : per_thread) {
+		merged.merge(stats);
+	}
+
+	return merged;
+}
+
+uint32_t
+env_or(const char *name, uint32_t def)
+{
+	const char *str = std::getenv(name);
+	return str != nullptr ? (uint32_t)std::strtoul(str, nullptr, 10) : def;
+}
+
+double
+to_us(uint64_t ns)
+{
+	return (double)ns / 1000.0;
+}
+
+} // namespace
+
+
+TEST_CASE("u_latency_histogram")
+{
+	u_latency_histogram ulh = {};
+
+	CHECK(u_latency_histogram_get_percentile(&ulh, 0.5) == 0);
+
+	SECTION("Buckets")
+	{
+		// Small values share the first bucket.
+		CHECK(u_latency_histogram_bucket_index(0) == 0);
+		CHECK(u_latency_histogram_bucket_index(255) == 0);
+		CHECK(u_latency_histogram_bucket_index(256) == 1);
+
+		// Four per power of two.
+		CHECK(u_latency_histogram_bucket_index(1024) == u_latency_histogram_bucket_index(512) + 4);
+		CHECK(u_latency_histogram_bucket_index(UINT64_MAX) == U_LATENCY_HISTOGRAM_BUCKET_COUNT - 1);
+
+		// Every value is within its bucket and within 25% of its upper bound.
+		for (uint64_t v = 256; v < 100 * 1000 * 1000; v = v * 3 / 2 + 7) {
+			uint32_t index = u_latency_histogram_bucket_index(v);
+			uint64_t max = u_latency_histogram_bucket_max(index);
+			INFO("value " << v);
+			CHECK(v <= max);
+			CHECK(v > u_latency_histogram_bucket_max(index - 1));
+			CHECK((double)max <= (double)v * 1.25 + 1);
+		}
+	}
+
+	SECTION("Percentiles")
+	{
+		// 1 to 1000 microseconds.
+		for (uint64_t us = 1; us <= 1000; us++) {
+			u_latency_histogram_add(&ulh, us * 1000);
+		}
+
+		CHECK(ulh.count == 1000);
+		CHECK(ulh.max_ns == 1000 * 1000);
+
+		double p50 = (double)u_latency_histogram_get_percentile(&ulh, 0.5);
+		double p99 = (double)u_latency_histogram_get_percentile(&ulh, 0.99);
+		CHECK(p50 >= 500 * 1000);
+		CHECK(p50 <= 500 * 1000 * 1.25);
+		CHECK(p99 >= 990 * 1000);
+		CHECK(u_latency_histogram_get_percentile(&ulh, 1.0) == 1000 * 1000);
+
+		char buf[128];
+		u_latency_histogram_snprint(&ulh, buf, sizeof(buf));
+		CHECK(std::string(buf).find("n 1000") == 0);
+	}
+
+	SECTION("Merge")
+	{
+		u_latency_histogram other = {};
+		u_latency_histogram_add(&ulh, 1000);
+		u_latency_histogram_add(&other, 5000);
+		u_latency_histogram_add(&other, 3000);
+
+		u_latency_histogram_merge(&ulh, &other);
+		CHECK(ulh.count == 3);
+		CHECK(ulh.total_ns == 9000);
+		CHECK(ulh.max_ns == 5000);
+		CHECK(u_latency_histogram_get_percentile(&ulh, 0.0) == u_latency_histogram_bucket_max(
+		                                                           u_latency_histogram_bucket_index(1000)));
+	}
+}
+
+TEST_CASE("ipc_transport clients and threads")
+{
+	// Also covers the service recording latencies.
+	Service service(3, true);
+
+	Stats stats = run(service, 2, 50);
+	CHECK(stats.failures == 0);
+	for (uint32_t i = 0; i < CALL_COUNT; i++) {
+		INFO(call_names[i]);
+		CHECK(stats.calls[i].count == 3 * 2 * 50);
+	}
+
+	// Each client's calls are handled by its own thread, in order.
+	for (auto &c : service.clients) {
+		CHECK(c->xc.frame_id == 2 * 50);
+	}
+	CHECK(service.threads.ids.size() == 3);
+}
+
+TEST_CASE("ipc_transport event loop")
+{
+	// More clients than workers, also covers the service recording latencies.
+	Service service(8, true, 2);
+
+	Stats stats = run(service, 2, 50);
+	CHECK(stats.failures == 0);
+	for (uint32_t i = 0; i < CALL_COUNT; i++) {
+		INFO(call_names[i]);
+		CHECK(stats.calls[i].count == 8 * 2 * 50);
+	}
+
+	for (auto &c : service.clients) {
+		CHECK(c->xc.frame_id == 2 * 50);
+	}
+	// The pool has a spare thread, but only two are ever busy at once.
+	CHECK(service.threads.ids.size() <= 2 + 1);
+
+	// The workers tear the clients down and free the slots.
+	CHECK(service.hang_up_all_and_wait());
+}
+
+TEST_CASE("ipc_transport event loop 64 clients")
+{
+	const uint32_t client_count = 64;
+	const uint32_t workers = 4;
+	const uint32_t frames = 20;
+
+	Service service(client_count, false, workers);
+
+	Stats stats = run(service, 1, frames);
+	CHECK(stats.failures == 0);
+	CHECK(stats.total() == client_count * frames * CALL_COUNT);
+
+	// Every client got all of its frames, in order, from the few workers.
+	uint32_t in_order = 0;
+	for (auto &c : service.clients) {
+		in_order += c->xc.frame_id == frames ? 1 : 0;
+	}
+	CHECK(in_order == client_count);
+	CHECK(service.threads.ids.size() <= workers + 1);
+
+	CHECK(service.hang_up_all_and_wait());
+}
+
+TEST_CASE("ipc_transport event loop blocked in wait_image")
+{
+	// A call holds its worker until it returns, waits included.
+	const uint32_t blocked = 2;
+	const uint32_t workers = GENERATE(2u, 3u);
+	CAPTURE(workers);
+
+	Service service(blocked + 1, false, workers);
+	ImageGate gate;
+	gate.closed = true;
+	for (auto &c : service.clients) {
+		c->xsc.gate = &gate;
+	}
+
+	std::vector<std::thread> waiters;
+	for (uint32_t i = 0; i < blocked; i++) {
+		ipc_connection *ipc_c = &service.clients[i]->ipc_c;
+		waiters.emplace_back([ipc_c] { ipc_call_swapchain_wait_image(ipc_c, 0, UINT64_MAX, 0); });
+	}
+	REQUIRE(gate.wait_for_waiting(blocked));
+
+	std::atomic<bool> done{false};
+	ipc_connection *other = &service.clients[blocked]->ipc_c;
+	std::thread caller([other, &done] {
+		ipc_call_compositor_begin_frame(other, 1);
+		done = true;
+	});
+
+	if (workers > blocked) {
+		// A worker is left, the other client is served straight away.
+		for (int i = 0; i < 2000 && !done; i++) {
+			os_nanosleep(U_TIME_1MS_IN_NS);
+		}
+		CHECK(done);
+	} else {
+		// Every worker is waiting, the other client has to wait too.
+		os_nanosleep(50 * U_TIME_1MS_IN_NS);
+		CHECK_FALSE(done);
+	}
+
+	gate.open();
+	caller.join();
+	for (std::thread &t : waiters) {
+		t.join();
+	}
+	CHECK(done);
+
+	CHECK(service.hang_up_all_and_wait());
+}
+
+TEST_CASE("ipc_transport benchmark", "[.benchmark]")
+{
+	using clock = std::chrono::steady_clock;
+
+	uint32_t env_clients = env_or("IPC_BENCH_CLIENTS", 0);
+	uint32_t env_threads = env_or("IPC_BENCH_THREADS", 0);
+	uint32_t env_workers = env_or("IPC_BENCH_WORKERS", 0);
+	uint32_t frames = env_or("IPC_BENCH_FRAMES", 5000);
+
+	struct Config
+	{
+		uint32_t clients;
+		uint32_t threads;
+		uint32_t workers;
+	};
+	std::vector<Config> matrix = {{1, 1, 0}, {1, 4, 0}, {4, 1, 0}, {4, 4, 0}, {4, 1, 2},
+	                              {64, 1, 0}, {64, 1, 4}};
+	if (env_clients > 0 && env_threads > 0) {
+		matrix = {{env_clients, env_threads, env_workers}};
+	}
+
+	for (const Config &m : matrix) {
+		Service service(m.clients, false, m.workers);
+
+		// Fewer frames with many clients, keeps the runs about as long.
+		uint32_t client_frames = m.clients > 4 ? std::max(frames / 16, 1u) : frames;
+
+		auto start = clock::now();
+		Stats stats = run(service, m.threads, client_frames);
+		double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+		std::cout << m.clients << " clients x " << m.threads << " threads, ";
+		if (m.workers > 0) {
+			std::cout << "event loop with " << m.workers << " workers, ";
+		} else {
+			std::cout << "thread per client, ";
+		}
+		std::cout << service.threads.ids.size() << " service threads, " << std::fixed << std::setprecision(0)
+		          << (double)stats.total() / seconds << " calls/s" << std::endl;
+		std::cout << "  " << std::left << std::setw(18) << "call" << std::right << std::setw(12) << "p50 (us)"
+		          << std::setw(12) << "p99 (us)" << std::setw(12) << "p999 (us)" << std::setw(12) << "max (us)"
+		          << std::endl;
+
+		for (uint32_t i = 0; i < CALL_COUNT; i++) {
+			const u_latency_histogram *ulh = &stats.calls[i];
+			std::cout << "  " << std::left << std::setw(18) << call_names[i] << std::right << std::fixed
+			          << std::setprecision(1) << std::setw(12)
+			          << to_us(u_latency_histogram_get_percentile(ulh, 0.5)) << std::setw(12)
+			          << to_us(u_latency_histogram_get_percentile(ulh, 0.99)) << std::setw(12)
+			          << to_us(u_latency_histogram_get_percentile(ulh, 0.999)) << std::setw(12)
+			          << to_us(ulh->max_ns) << std::endl;
+		}
+
+		CHECK(stats.failures == 0);
+	}
+}
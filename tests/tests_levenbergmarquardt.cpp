@@ -19,10 +19,129 @@
 
 #include <thread>
 #include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
 #include "fenv.h"
 
 using namespace xrt::tracking::hand::mercury;
 
+namespace {
+
+xrt_pose
+make_left_in_right()
+{
+	xrt_pose left_in_right = XRT_POSE_IDENTITY;
+	left_in_right.position.x = -0.1f;
+	return left_in_right;
+}
+
+/*!
+ * The hand the optimizer starts out with, it doesn't move when no joint is
+ * looked at.
+ */
+xrt_hand_joint_set
+rest_hand()
+{
+	lm::KinematicHandLM *hand;
+	lm::optimizer_create(make_left_in_right(), false, U_LOGGING_WARN, &hand);
+
+	struct one_frame_input input = {};
+	for (int i = 0; i < 21; i++) {
+		input.views[0].rays[i] = {0, 0, -1};
+		input.views[1].rays[i] = {0, 0, -1};
+	}
+
+	xrt_hand_joint_set out = {};
+	float out_hand_size;
+	float out_reprojection_error;
+	lm::optimizer_run(hand, input, true, false, 0.09, 0.5, out, out_hand_size, out_reprojection_error);
+	lm::optimizer_destroy(&hand);
+
+	return out;
+}
+
+/*!
+ * Observations of a hand moving through the view with some noise on every
+ * joint, like the keypoint models give.
+ */
+std::vector<one_frame_input>
+make_observations(int count)
+{
+	xrt_hand_joint_set rest = rest_hand();
+	xrt_pose left_in_right = make_left_in_right();
+
+	std::mt19937 rng(3);
+	std::normal_distribution<float> noise(0.0f, 0.002f);
+
+	std::vector<one_frame_input> frames(count);
+	for (int i = 0; i < count; i++) {
+		float t = (float)i / 30.0f;
+		xrt_vec3 offset = {0.1f * std::sin(t), 0.05f * std::sin(2.0f * t), 0.05f * std::cos(t)};
+
+		for (int view = 0; view < 2; view++) {
+			one_frame_one_view &v = frames[i].views[view];
+			v.active = true;
+
+			for (int k = 0; k < 21; k++) {
+				// The wrist, then the four joints the models see of every finger.
+				int joint = k == 0 ? XRT_HAND_JOINT_WRIST : 2 + 5 * ((k - 1) / 4) + (k - 1) % 4;
+				xrt_vec3 p = rest.values.hand_joint_set_default[joint].relation.pose.position;
+				p = m_vec3_add(p, offset);
+				p = m_vec3_add(p, {noise(rng), noise(rng), noise(rng)});
+
+				if (view == 1) {
+					math_pose_transform_point(&left_in_right, &p, &p);
+				}
+
+				v.rays[k] = m_vec3_normalize(p);
+				v.confidences[k] = 1.0f;
+			}
+		}
+	}
+
+	return frames;
+}
+
+struct SolveResult
+{
+	std::vector<xrt_hand_joint_set> hands;
+	double total_ms = 0;
+	int total_iterations = 0;
+};
+
+SolveResult
+solve_all(const std::vector<one_frame_input> &frames, bool block_solver)
+{
+	lm::KinematicHandLM *hand;
+	lm::optimizer_create(make_left_in_right(), false, U_LOGGING_WARN, &hand);
+	lm::optimizer_use_block_solver(hand, block_solver);
+
+	SolveResult result;
+	for (size_t i = 0; i < frames.size(); i++) {
+		// It mutates the observation.
+		one_frame_input input = frames[i];
+
+		xrt_hand_joint_set out = {};
+		float out_hand_size;
+		float out_reprojection_error;
+		lm::optimizer_run(hand, input, i == 0, i < 30, 0.09, 0.5, out, out_hand_size, out_reprojection_error);
+
+		lm::optimizer_stats stats = {};
+		lm::optimizer_get_stats(hand, stats);
+		result.total_ms += (double)stats.duration_ns / (1000.0 * 1000.0);
+		result.total_iterations += stats.iterations;
+		result.hands.push_back(out);
+	}
+
+	lm::optimizer_destroy(&hand);
+
+	return result;
+}
+
+} // namespace
+
 TEST_CASE("LevenbergMarquardt")
 {
 	// This does very little at the moment:
@@ -58,3 +177,42 @@ TEST_CASE("LevenbergMarquardt")
 	CHECK(std::isfinite(out_reprojection_error));
 	CHECK(std::isfinite(out_hand_size));
 }
+
+TEST_CASE("LevenbergMarquardt block solver matches dense")
+{
+	std::vector<one_frame_input> frames = make_observations(90);
+
+	SolveResult dense = solve_all(frames, false);
+	SolveResult block = solve_all(frames, true);
+
+	// Same residuals and Jacobian, only summed in a different order.
+	float max_error = 0;
+	for (size_t i = 0; i < frames.size(); i++) {
+		for (int j = 0; j < XRT_HAND_JOINT_COUNT; j++) {
+			xrt_vec3 a = dense.hands[i].values.hand_joint_set_default[j].relation.pose.position;
+			xrt_vec3 b = block.hands[i].values.hand_joint_set_default[j].relation.pose.position;
+			max_error = std::max(max_error, m_vec3_len(m_vec3_sub(a, b)));
+		}
+	}
+
+	INFO("max joint difference " << max_error * 1000 << "mm");
+	CHECK(max_error < 0.001f);
+	CHECK(std::abs(block.total_iterations - dense.total_iterations) <= dense.total_iterations / 10);
+}
+
+TEST_CASE("LevenbergMarquardt benchmark", "[.benchmark]")
+{
+	std::vector<one_frame_input> frames = make_observations(1000);
+
+	std::cout << std::left << std::setw(10) << "solver" << std::right << std::setw(16) << "solve (ms)"
+	          << std::setw(16) << "iterations" << std::endl;
+
+	for (bool block_solver : {false, true}) {
+		SolveResult r = solve_all(frames, block_solver);
+
+		std::cout << std::left << std::setw(10) << (block_solver ? "block" : "dense") << std::right
+		          << std::fixed << std::setprecision(3) << std::setw(16) << r.total_ms / frames.size()
+		          << std::setprecision(1) << std::setw(16) << (double)r.total_iterations / frames.size()
+		          << std::endl;
+	}
+}
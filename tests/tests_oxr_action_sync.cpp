@@ -0,0 +1,174 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief xrSyncActions tests and benchmark, on a headless instance.
+ *
+ * The benchmark is hidden, run it with `tests_oxr_action_sync "[.benchmark]"`.
+ */
+
+#include "oxr_headless.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+
+namespace {
+
+/*!
+ * Runs the frames through a new session, returns the states after each sync.
+ * Every @p switch_every frames only half of the sets are synced for a frame.
+ */
+std::vector<action_state>
+run_frames(app &a, bool incremental, uint32_t period, uint64_t frames, uint64_t switch_every)
+{
+	std::vector<action_state> states;
+
+	a.create_session(incremental);
+	for (uint64_t f = 0; f < frames; f++) {
+		g_pattern.frame = f;
+		g_pattern.period = period;
+
+		bool half = switch_every > 0 && f % switch_every == switch_every - 1;
+		a.sync(half ? (uint32_t)a.sets.size() / 2 : 0);
+		a.read_states(states);
+	}
+	a.destroy_session();
+
+	return states;
+}
+
+//! Count of mismatches, not one check per state, there are lots.
+size_t
+count_differences(const std::vector<action_state> &a, const std::vector<action_state> &b)
+{
+	size_t count = a.size() > b.size() ? a.size() - b.size() : b.size() - a.size();
+	for (size_t i = 0; i < std::min(a.size(), b.size()); i++) {
+		count += a[i] == b[i] ? 0 : 1;
+	}
+	return count;
+}
+
+} // namespace
+
+
+TEST_CASE("oxr_action_sync incremental")
+{
+	app a(500, 5);
+	// Not all generated profiles are accepted by the state tracker.
+	CHECK(a.profile_count > NUM_PROFILE_TEMPLATES / 2);
+
+	for (uint32_t period : {0u, 1u, 3u, 8u}) {
+		CAPTURE(period);
+
+		std::vector<action_state> full = run_frames(a, false, period, 40, 0);
+		std::vector<action_state> incremental = run_frames(a, true, period, 40, 0);
+		REQUIRE(full.size() > 0);
+		CHECK(count_differences(full, incremental) == 0);
+
+		// Switching the synced sets goes back to a full update.
+		full = run_frames(a, false, period, 40, 7);
+		incremental = run_frames(a, true, period, 40, 7);
+		CHECK(count_differences(full, incremental) == 0);
+	}
+
+	// Some inputs change, at least one action has to see it.
+	std::vector<action_state> states = run_frames(a, true, 4, 10, 0);
+	bool any_changed = false;
+	for (const action_state &s : states) {
+		any_changed |= s.changed != XR_FALSE;
+	}
+	CHECK(any_changed);
+}
+
+TEST_CASE("oxr_action_sync skips unchanged")
+{
+	app a(500, 5);
+
+	g_pattern = {};
+	a.create_session(true);
+
+	// The first sync has nothing to compare to.
+	REQUIRE(a.sync() == XR_SESSION_NOT_FOCUSED);
+	uint64_t updates = a.sess()->action_sync.cache_updates;
+	CHECK(updates > 0);
+
+	// Nothing moves, only the timestamps.
+	for (uint64_t f = 1; f < 10; f++) {
+		g_pattern.frame = f;
+		a.sync();
+	}
+	CHECK(a.sess()->action_sync.cache_updates == updates);
+	CHECK(a.sess()->action_sync.cache_skips > 0);
+
+	// Every input changes, only poses stay the same.
+	g_pattern.period = 1;
+	g_pattern.frame = 10;
+	a.sync();
+	uint64_t changed_updates = a.sess()->action_sync.cache_updates - updates;
+	CHECK(changed_updates > 0);
+	CHECK(changed_updates <= updates);
+
+	// Other sets, everything is updated again.
+	g_pattern.period = 0;
+	g_pattern.frame = 11;
+	a.sync(2);
+	CHECK(a.sess()->action_sync.cache_updates > updates + changed_updates);
+
+	a.destroy_session();
+}
+
+TEST_CASE("oxr_action_sync benchmark", "[.benchmark]")
+{
+	using clock = std::chrono::steady_clock;
+
+	app a(500, 5);
+
+	std::cout << a.actions.size() << " actions in " << a.sets.size() << " sets, bound in " << a.profile_count
+	          << " profiles" << std::endl;
+	std::cout << std::left << std::setw(24) << "inputs changing" << std::right << std::setw(16) << "full (us)"
+	          << std::setw(20) << "incremental (us)" << std::endl;
+
+	for (uint32_t period : {0u, 64u, 8u, 1u}) {
+		double us[2] = {};
+		for (bool incremental : {false, true}) {
+			a.create_session(incremental);
+
+			uint64_t frame = 0;
+			auto run = [&](uint64_t count) {
+				for (uint64_t i = 0; i < count; i++) {
+					g_pattern.frame = frame++;
+					g_pattern.period = period;
+					a.sync();
+				}
+			};
+
+			// Warm up.
+			run(100);
+
+			uint64_t syncs = 0;
+			auto start = clock::now();
+			std::chrono::duration<double> elapsed{};
+			do {
+				run(100);
+				syncs += 100;
+				elapsed = clock::now() - start;
+			} while (elapsed.count() < 1.0);
+
+			us[incremental ? 1 : 0] = elapsed.count() * 1e6 / syncs;
+
+			a.destroy_session();
+		}
+
+		char name[32];
+		if (period == 0) {
+			snprintf(name, sizeof(name), "none");
+		} else {
+			snprintf(name, sizeof(name), "1 in %u per frame", period);
+		}
+
+		std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2)
+		          << std::setw(16) << us[0] << std::setw(20) << us[1] << std::endl;
+	}
+}
@@ -0,0 +1,679 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief OpenXR frame loop tests and benchmark, on the mock native compositor.
+ *
+ * The instance is headless, the test puts a mock compositor into the session
+ * so the whole of xrEndFrame runs without a GPU. The benchmark is hidden, run
+ * it with `tests_oxr_frame_loop "[.benchmark]"`, the layers can be given with
+ * `OXR_FRAME_LOOP_LAYERS=projection:1,quad:8` and the frame count with
+ * `OXR_FRAME_LOOP_FRAMES=5000`. Setting `OXR_FRAME_LOOP_BUDGET_US=150` makes
+ * the benchmark fail if the p99 of xrEndFrame goes over that, only the
+ * functional test runs as part of ctest.
+ */
+
+#include "oxr_headless.hpp"
+
+#include "util/u_handles.h"
+#include "mock/mock_compositor.h"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+
+namespace {
+
+//! Any format will do, the mock doesn't look at it.
+constexpr int64_t FORMAT = 43;
+
+
+/*
+ *
+ * Swapchains, like the per graphics API ones but with nothing to enumerate.
+ *
+ */
+
+XrResult
+swapchain_destroy(struct oxr_logger *log, struct oxr_swapchain *sc)
+{
+	// The loop releases every image it acquires.
+	xrt_swapchain_reference(&sc->swapchain, NULL);
+	return XR_SUCCESS;
+}
+
+XrResult
+swapchain_enumerate_images(struct oxr_logger *log,
+                           struct oxr_swapchain *sc,
+                           uint32_t count,
+                           XrSwapchainImageBaseHeader *images)
+{
+	return XR_SUCCESS;
+}
+
+XrResult
+swapchain_create(struct oxr_logger *log,
+                 struct oxr_session *sess,
+                 const XrSwapchainCreateInfo *createInfo,
+                 struct oxr_swapchain **out_swapchain)
+{
+	struct oxr_swapchain *sc = NULL;
+	XrResult ret = oxr_create_swapchain(log, sess, createInfo, &sc);
+	if (ret != XR_SUCCESS) {
+		return ret;
+	}
+
+	sc->destroy = swapchain_destroy;
+	sc->enumerate_images = swapchain_enumerate_images;
+
+	*out_swapchain = sc;
+
+	return XR_SUCCESS;
+}
+
+
+/*
+ *
+ * Timing.
+ *
+ */
+
+enum stage
+{
+	STAGE_WAIT,
+	STAGE_BEGIN,
+	STAGE_SWAPCHAINS,
+	STAGE_LOCATE,
+	STAGE_SYNC,
+	STAGE_END,
+	//! From layer_begin to the end of layer_commit, so locating and submitting the layers.
+	STAGE_LAYERS,
+	STAGE_POLL,
+	STAGE_COUNT,
+};
+
+const char *stage_names[STAGE_COUNT] = {
+    "xrWaitFrame", "xrBeginFrame", "swapchains", "xrLocateViews", "xrSyncActions", "xrEndFrame", " layers",
+    "xrPollEvent",
+};
+
+//! Samples of every stage, one per frame.
+struct timings
+{
+	std::vector<uint64_t> samples[STAGE_COUNT];
+
+	//! Set by the hooks, the part of xrEndFrame that talks to the compositor.
+	uint64_t layer_begin_ns = 0;
+	uint64_t layer_commit_ns = 0;
+
+	//! Percentile @p p of @p s in microseconds.
+	double
+	percentile(enum stage s, double p)
+	{
+		std::vector<uint64_t> &v = samples[s];
+		if (v.empty()) {
+			return 0;
+		}
+		std::sort(v.begin(), v.end());
+		size_t index = std::min(v.size() - 1, (size_t)(p * (double)v.size()));
+		return (double)v[index] / 1e3;
+	}
+};
+
+xrt_result_t
+timed_layer_begin(struct mock_compositor *mc,
+                  int64_t frame_id,
+                  uint64_t display_time_ns,
+                  enum xrt_blend_mode env_blend_mode)
+{
+	timings *t = (timings *)mc->userdata;
+	t->layer_begin_ns = os_monotonic_get_ns();
+
+	// Same as the default.
+	mc->layer_count = 0;
+
+	return XRT_SUCCESS;
+}
+
+xrt_result_t
+timed_layer_commit(struct mock_compositor *mc, int64_t frame_id, xrt_graphics_sync_handle_t sync_handle)
+{
+	timings *t = (timings *)mc->userdata;
+
+	// Same as the default.
+	u_graphics_sync_unref(&sync_handle);
+	mc->commit_count++;
+
+	t->layer_commit_ns = os_monotonic_get_ns();
+
+	return XRT_SUCCESS;
+}
+
+
+/*
+ *
+ * The frame loop.
+ *
+ */
+
+//! How many layers of each type are submitted every frame.
+struct layer_config
+{
+	uint32_t projection = 1;
+	uint32_t quad = 0;
+	uint32_t cylinder = 0;
+	uint32_t cube = 0;
+	uint32_t equirect2 = 0;
+
+	uint32_t
+	total() const
+	{
+		return projection + quad + cylinder + cube + equirect2;
+	}
+
+	std::string
+	to_string() const
+	{
+		std::ostringstream oss;
+		const char *sep = "";
+		auto add = [&](const char *name, uint32_t count) {
+			if (count > 0) {
+				oss << sep << name << ":" << count;
+				sep = ",";
+			}
+		};
+		add("projection", projection);
+		add("quad", quad);
+		add("cylinder", cylinder);
+		add("cube", cube);
+		add("equirect2", equirect2);
+		return oss.str();
+	}
+
+	//! Parses `type:count` pairs separated by commas, unknown types are ignored.
+	static layer_config
+	parse(const char *str)
+	{
+		layer_config c = {};
+		c.projection = 0;
+
+		std::istringstream iss(str);
+		std::string item;
+		while (std::getline(iss, item, ',')) {
+			size_t colon = item.find(':');
+			if (colon == std::string::npos) {
+				continue;
+			}
+			std::string name = item.substr(0, colon);
+			uint32_t count = (uint32_t)strtoul(item.c_str() + colon + 1, NULL, 10);
+			if (name == "projection") {
+				c.projection = count;
+			} else if (name == "quad") {
+				c.quad = count;
+			} else if (name == "cylinder") {
+				c.cylinder = count;
+			} else if (name == "cube") {
+				c.cube = count;
+			} else if (name == "equirect2") {
+				c.equirect2 = count;
+			}
+		}
+		return c;
+	}
+};
+
+//! The composition layer extensions this build supports, the app enables them all.
+std::vector<const char *>
+layer_extensions()
+{
+	std::vector<const char *> extensions;
+#ifdef OXR_HAVE_KHR_composition_layer_cube
+	extensions.push_back(XR_KHR_COMPOSITION_LAYER_CUBE_EXTENSION_NAME);
+#endif
+#ifdef OXR_HAVE_KHR_composition_layer_cylinder
+	extensions.push_back(XR_KHR_COMPOSITION_LAYER_CYLINDER_EXTENSION_NAME);
+#endif
+#ifdef OXR_HAVE_KHR_composition_layer_equirect2
+	extensions.push_back(XR_KHR_COMPOSITION_LAYER_EQUIRECT2_EXTENSION_NAME);
+#endif
+	return extensions;
+}
+
+/*!
+ * A running session on the mock compositor, with a swapchain for each view of
+ * every projection layer and for every other layer.
+ */
+struct frame_loop
+{
+	app &a;
+	layer_config config;
+
+	struct xrt_compositor_native *xcn = nullptr;
+	struct mock_compositor *mc = nullptr;
+
+	XrSpace local = XR_NULL_HANDLE;
+	XrSessionState state = XR_SESSION_STATE_UNKNOWN;
+
+	std::vector<XrSwapchain> swapchains;
+
+	XrView views[2] = {};
+	std::vector<XrCompositionLayerProjectionView> projection_views;
+	std::vector<XrCompositionLayerProjection> projections;
+	std::vector<XrCompositionLayerQuad> quads;
+#ifdef OXR_HAVE_KHR_composition_layer_cylinder
+	std::vector<XrCompositionLayerCylinderKHR> cylinders;
+#endif
+#ifdef OXR_HAVE_KHR_composition_layer_cube
+	std::vector<XrCompositionLayerCubeKHR> cubes;
+#endif
+#ifdef OXR_HAVE_KHR_composition_layer_equirect2
+	std::vector<XrCompositionLayerEquirect2KHR> equirect2s;
+#endif
+	std::vector<const XrCompositionLayerBaseHeader *> layers;
+
+	//! Frames where the app was told to render, and did.
+	uint64_t rendered_frames = 0;
+
+	frame_loop(app &a_, const layer_config &config_, timings *timed) : a(a_), config(config_)
+	{
+		a.create_session(true);
+
+		// Headless sessions have no compositor, give it one.
+		xcn = mock_create_native_compositor();
+		mc = mock_compositor(&xcn->base);
+		xcn->base.info.formats[0] = FORMAT;
+		xcn->base.info.format_count = 1;
+		if (timed != nullptr) {
+			mc->userdata = timed;
+			mc->compositor_hooks.layer_begin = timed_layer_begin;
+			mc->compositor_hooks.layer_commit = timed_layer_commit;
+		}
+
+		// Destroyed with the session.
+		a.sess()->compositor = &xcn->base;
+		a.sess()->create_swapchain = swapchain_create;
+
+		XrSessionBeginInfo sbi = {};
+		sbi.type = XR_TYPE_SESSION_BEGIN_INFO;
+		sbi.primaryViewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+		REQUIRE(oxr_xrBeginSession(a.session, &sbi) == XR_SUCCESS);
+
+		XrReferenceSpaceCreateInfo rsci = {};
+		rsci.type = XR_TYPE_REFERENCE_SPACE_CREATE_INFO;
+		rsci.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+		rsci.poseInReferenceSpace.orientation.w = 1.0f;
+		REQUIRE(oxr_xrCreateReferenceSpace(a.session, &rsci, &local) == XR_SUCCESS);
+
+		for (XrView &view : views) {
+			view = {};
+			view.type = XR_TYPE_VIEW;
+		}
+
+		create_layers();
+	}
+
+	~frame_loop()
+	{
+		// Swapchains and spaces go with the session.
+		if (oxr_xrRequestExitSession(a.session) == XR_SUCCESS) {
+			oxr_xrEndSession(a.session);
+		}
+		a.destroy_session();
+	}
+
+	XrSwapchain
+	create_swapchain(uint32_t face_count)
+	{
+		XrSwapchainCreateInfo sci = {};
+		sci.type = XR_TYPE_SWAPCHAIN_CREATE_INFO;
+		sci.usageFlags = XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT | XR_SWAPCHAIN_USAGE_SAMPLED_BIT;
+		sci.format = FORMAT;
+		sci.sampleCount = 1;
+		sci.width = 512;
+		sci.height = 512;
+		sci.faceCount = face_count;
+		sci.arraySize = 1;
+		sci.mipCount = 1;
+
+		XrSwapchain swapchain = XR_NULL_HANDLE;
+		REQUIRE(oxr_xrCreateSwapchain(a.session, &sci, &swapchain) == XR_SUCCESS);
+		swapchains.push_back(swapchain);
+
+		return swapchain;
+	}
+
+	static XrSwapchainSubImage
+	sub_image(XrSwapchain swapchain)
+	{
+		XrSwapchainSubImage si = {};
+		si.swapchain = swapchain;
+		si.imageRect.extent = {512, 512};
+		return si;
+	}
+
+	void
+	create_layers()
+	{
+		XrPosef pose = {};
+		pose.orientation.w = 1.0f;
+		pose.position.z = -1.0f;
+
+		// Reserved up front, the layers point into these.
+		projection_views.resize(config.projection * 2);
+		for (uint32_t i = 0; i < config.projection; i++) {
+			XrCompositionLayerProjection l = {};
+			l.type = XR_TYPE_COMPOSITION_LAYER_PROJECTION;
+			l.space = local;
+			l.viewCount = 2;
+			l.views = &projection_views[i * 2];
+			for (uint32_t k = 0; k < 2; k++) {
+				projection_views[i * 2 + k] = {};
+				projection_views[i * 2 + k].type = XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW;
+				projection_views[i * 2 + k].subImage = sub_image(create_swapchain(1));
+			}
+			projections.push_back(l);
+		}
+
+		for (uint32_t i = 0; i < config.quad; i++) {
+			XrCompositionLayerQuad l = {};
+			l.type = XR_TYPE_COMPOSITION_LAYER_QUAD;
+			l.space = local;
+			l.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+			l.subImage = sub_image(create_swapchain(1));
+			l.pose = pose;
+			l.size = {1.0f, 1.0f};
+			quads.push_back(l);
+		}
+
+#ifdef OXR_HAVE_KHR_composition_layer_cylinder
+		for (uint32_t i = 0; i < config.cylinder; i++) {
+			XrCompositionLayerCylinderKHR l = {};
+			l.type = XR_TYPE_COMPOSITION_LAYER_CYLINDER_KHR;
+			l.space = local;
+			l.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+			l.subImage = sub_image(create_swapchain(1));
+			l.pose = pose;
+			l.radius = 2.0f;
+			l.centralAngle = 1.0f;
+			l.aspectRatio = 1.0f;
+			cylinders.push_back(l);
+		}
+#endif
+
+#ifdef OXR_HAVE_KHR_composition_layer_cube
+		for (uint32_t i = 0; i < config.cube; i++) {
+			XrCompositionLayerCubeKHR l = {};
+			l.type = XR_TYPE_COMPOSITION_LAYER_CUBE_KHR;
+			l.space = local;
+			l.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+			l.swapchain = create_swapchain(6);
+			l.orientation.w = 1.0f;
+			cubes.push_back(l);
+		}
+#endif
+
+#ifdef OXR_HAVE_KHR_composition_layer_equirect2
+		for (uint32_t i = 0; i < config.equirect2; i++) {
+			XrCompositionLayerEquirect2KHR l = {};
+			l.type = XR_TYPE_COMPOSITION_LAYER_EQUIRECT2_KHR;
+			l.space = local;
+			l.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+			l.subImage = sub_image(create_swapchain(1));
+			l.pose = pose;
+			l.radius = 2.0f;
+			l.centralHorizontalAngle = 1.0f;
+			l.upperVerticalAngle = 0.5f;
+			l.lowerVerticalAngle = -0.5f;
+			equirect2s.push_back(l);
+		}
+#endif
+
+		// Projections at the back, like most apps.
+		for (const auto &l : projections) {
+			layers.push_back((const XrCompositionLayerBaseHeader *)&l);
+		}
+		for (const auto &l : quads) {
+			layers.push_back((const XrCompositionLayerBaseHeader *)&l);
+		}
+#ifdef OXR_HAVE_KHR_composition_layer_cylinder
+		for (const auto &l : cylinders) {
+			layers.push_back((const XrCompositionLayerBaseHeader *)&l);
+		}
+#endif
+#ifdef OXR_HAVE_KHR_composition_layer_cube
+		for (const auto &l : cubes) {
+			layers.push_back((const XrCompositionLayerBaseHeader *)&l);
+		}
+#endif
+#ifdef OXR_HAVE_KHR_composition_layer_equirect2
+		for (const auto &l : equirect2s) {
+			layers.push_back((const XrCompositionLayerBaseHeader *)&l);
+		}
+#endif
+	}
+
+	//! Drains the events, keeping track of the session state.
+	bool
+	poll()
+	{
+		XrEventDataBuffer event = {};
+		event.type = XR_TYPE_EVENT_DATA_BUFFER;
+		XrResult ret;
+		while ((ret = oxr_xrPollEvent(a.instance, &event)) == XR_SUCCESS) {
+			if (event.type == XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED) {
+				state = ((XrEventDataSessionStateChanged *)&event)->state;
+			}
+			event = {};
+			event.type = XR_TYPE_EVENT_DATA_BUFFER;
+		}
+		return ret == XR_EVENT_UNAVAILABLE;
+	}
+
+	/*!
+	 * One frame like an app would do it, layers are only submitted when the
+	 * app should render. Returns false if any call failed, there are too many
+	 * calls to check each one.
+	 */
+	bool
+	frame(timings *t)
+	{
+		bool ok = true;
+		uint64_t now = os_monotonic_get_ns();
+		uint64_t last = now;
+		auto mark = [&](enum stage s) {
+			now = os_monotonic_get_ns();
+			if (t != nullptr) {
+				t->samples[s].push_back(now - last);
+			}
+			last = now;
+		};
+
+		XrFrameState fs = {};
+		fs.type = XR_TYPE_FRAME_STATE;
+		ok &= XR_SUCCEEDED(oxr_xrWaitFrame(a.session, nullptr, &fs));
+		mark(STAGE_WAIT);
+
+		ok &= XR_SUCCEEDED(oxr_xrBeginFrame(a.session, nullptr));
+		mark(STAGE_BEGIN);
+
+		bool render = fs.shouldRender == XR_TRUE;
+		if (render) {
+			for (XrSwapchain swapchain : swapchains) {
+				uint32_t index = 0;
+				XrSwapchainImageWaitInfo wi = {};
+				wi.type = XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO;
+				wi.timeout = XR_INFINITE_DURATION;
+				ok &= oxr_xrAcquireSwapchainImage(swapchain, nullptr, &index) == XR_SUCCESS;
+				ok &= oxr_xrWaitSwapchainImage(swapchain, &wi) == XR_SUCCESS;
+				ok &= oxr_xrReleaseSwapchainImage(swapchain, nullptr) == XR_SUCCESS;
+			}
+			mark(STAGE_SWAPCHAINS);
+
+			XrViewLocateInfo vli = {};
+			vli.type = XR_TYPE_VIEW_LOCATE_INFO;
+			vli.viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+			vli.displayTime = fs.predictedDisplayTime;
+			vli.space = local;
+			XrViewState vs = {};
+			vs.type = XR_TYPE_VIEW_STATE;
+			uint32_t view_count = 0;
+			ok &= oxr_xrLocateViews(a.session, &vli, &vs, 2, &view_count, views) == XR_SUCCESS;
+			mark(STAGE_LOCATE);
+
+			for (size_t i = 0; i < projection_views.size(); i++) {
+				projection_views[i].pose = views[i % 2].pose;
+				projection_views[i].fov = views[i % 2].fov;
+			}
+		}
+
+		// Focus is polled below, don't count not being focused yet as an error.
+		ok &= XR_SUCCEEDED(a.sync());
+		mark(STAGE_SYNC);
+
+		XrFrameEndInfo fei = {};
+		fei.type = XR_TYPE_FRAME_END_INFO;
+		fei.displayTime = fs.predictedDisplayTime;
+		fei.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
+		fei.layerCount = render ? (uint32_t)layers.size() : 0;
+		fei.layers = render ? layers.data() : nullptr;
+		if (t != nullptr) {
+			t->layer_begin_ns = t->layer_commit_ns = 0;
+		}
+		ok &= oxr_xrEndFrame(a.session, &fei) == XR_SUCCESS;
+		mark(STAGE_END);
+
+		// Discarded frames never reach the compositor.
+		if (t != nullptr && t->layer_commit_ns != 0) {
+			t->samples[STAGE_LAYERS].push_back(t->layer_commit_ns - t->layer_begin_ns);
+		}
+
+		ok &= poll();
+		mark(STAGE_POLL);
+
+		if (render) {
+			rendered_frames++;
+		}
+
+		return ok;
+	}
+};
+
+} // namespace
+
+
+TEST_CASE("oxr_frame_loop mock compositor")
+{
+	app a(64, 2, layer_extensions());
+
+	layer_config config;
+	config.projection = 1;
+	config.quad = 2;
+#ifdef OXR_HAVE_KHR_composition_layer_cylinder
+	config.cylinder = 1;
+#endif
+#ifdef OXR_HAVE_KHR_composition_layer_cube
+	config.cube = 1;
+#endif
+#ifdef OXR_HAVE_KHR_composition_layer_equirect2
+	config.equirect2 = 1;
+#endif
+
+	g_pattern = {};
+	frame_loop loop(a, config, nullptr);
+	REQUIRE(loop.poll());
+	CHECK(loop.state == XR_SESSION_STATE_READY);
+
+	for (uint64_t f = 0; f < 20; f++) {
+		g_pattern.frame = f;
+		g_pattern.period = 3;
+		CAPTURE(f);
+		REQUIRE(loop.frame(nullptr));
+	}
+
+	// The first frame synchronizes, then the compositor shows and focuses us.
+	CHECK(loop.state == XR_SESSION_STATE_FOCUSED);
+	CHECK(a.sess()->state == XR_SESSION_STATE_FOCUSED);
+	CHECK(loop.rendered_frames > 0);
+	CHECK(loop.rendered_frames < 20);
+
+	// Every rendered frame got to the compositor, with all of its layers.
+	CHECK(loop.mc->commit_count == loop.rendered_frames);
+	CHECK(loop.mc->layer_count == config.total());
+	CHECK(loop.mc->frame_id == 20);
+
+	// Once focused the actions are live.
+	CHECK(a.sync() == XR_SUCCESS);
+}
+
+TEST_CASE("oxr_frame_loop benchmark", "[.benchmark]")
+{
+	std::vector<layer_config> configs;
+
+	const char *layers_env = getenv("OXR_FRAME_LOOP_LAYERS");
+	if (layers_env != nullptr) {
+		configs.push_back(layer_config::parse(layers_env));
+	} else {
+		layer_config c;
+		configs.push_back(c);
+		c.quad = 4;
+		configs.push_back(c);
+		c.quad = 16;
+		configs.push_back(c);
+		c.quad = 2;
+		c.cylinder = 2;
+		c.cube = 1;
+		c.equirect2 = 2;
+		configs.push_back(c);
+	}
+
+	const char *frames_env = getenv("OXR_FRAME_LOOP_FRAMES");
+	uint64_t frames = frames_env != nullptr ? strtoull(frames_env, NULL, 10) : 5000;
+
+	// Opt in, timings depend too much on the machine to always check them.
+	const char *budget_env = getenv("OXR_FRAME_LOOP_BUDGET_US");
+	double budget_us = budget_env != nullptr ? strtod(budget_env, NULL) : 0.0;
+
+	app a(200, 4, layer_extensions());
+
+	std::cout << a.actions.size() << " actions in " << a.sets.size() << " sets, " << frames
+	          << " frames per layer config, times in us" << std::endl;
+
+	for (const layer_config &config : configs) {
+		timings t;
+		frame_loop loop(a, config, &t);
+
+		uint64_t f = 0;
+		for (; f < frames / 10 + 1; f++) {
+			g_pattern.frame = f;
+			g_pattern.period = 8;
+			REQUIRE(loop.frame(nullptr));
+		}
+		REQUIRE(loop.state == XR_SESSION_STATE_FOCUSED);
+
+		for (uint64_t i = 0; i < frames; i++, f++) {
+			g_pattern.frame = f;
+			g_pattern.period = 8;
+			REQUIRE(loop.frame(&t));
+		}
+		CHECK(loop.mc->layer_count == config.total());
+
+		std::cout << std::endl << "layers " << config.to_string() << std::endl;
+		std::cout << std::left << std::setw(16) << "" << std::right << std::setw(10) << "p50" << std::setw(10)
+		          << "p90" << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+		for (uint32_t s = 0; s < STAGE_COUNT; s++) {
+			enum stage st = (enum stage)s;
+			std::cout << std::left << std::setw(16) << stage_names[s] << std::right << std::fixed
+			          << std::setprecision(2) << std::setw(10) << t.percentile(st, 0.5) << std::setw(10)
+			          << t.percentile(st, 0.9) << std::setw(10) << t.percentile(st, 0.99) << std::setw(10)
+			          << t.percentile(st, 1.0) << std::endl;
+		}
+
+		if (budget_us > 0.0) {
+			CAPTURE(config.to_string());
+			CHECK(t.percentile(STAGE_END, 0.99) <= budget_us);
+		}
+	}
+}
@@ -0,0 +1,192 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief OpenXR path store tests and benchmark.
+ *
+ * The benchmark is hidden, run it with `tests_oxr_path "[.benchmark]"`.
+ */
+
+#include "bindings/b_generated_bindings.h"
+
+#include "catch/catch.hpp"
+
+#include <oxr/oxr_objects.h>
+#include <oxr/oxr_logger.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+//! Only the path store of the instance is used, the rest stays zeroed.
+struct path_instance
+{
+	oxr_logger log = {};
+	oxr_instance *inst = nullptr;
+
+	path_instance()
+	{
+		oxr_log_init(&log, "test");
+		inst = (oxr_instance *)calloc(1, sizeof(oxr_instance));
+		oxr_path_init(&log, inst);
+	}
+
+	~path_instance()
+	{
+		oxr_path_destroy(&log, inst);
+		free(inst);
+	}
+
+	XrPath
+	get_or_create(const char *str)
+	{
+		// No Catch assertion here, it would dominate the benchmark.
+		XrPath path = XR_NULL_PATH;
+		if (oxr_path_get_or_create(&log, inst, str, strlen(str), &path) != XR_SUCCESS) {
+			return XR_NULL_PATH;
+		}
+		return path;
+	}
+};
+
+//! All the path strings of all binding profiles, in the order an app would suggest them.
+std::vector<const char *>
+all_binding_paths()
+{
+	std::vector<const char *> ret;
+	for (const profile_template &templ : profile_templates) {
+		ret.push_back(templ.path);
+		for (size_t i = 0; i < templ.binding_count; i++) {
+			const binding_template &b = templ.bindings[i];
+			ret.push_back(b.subaction_path);
+			for (const char *path : b.paths) {
+				if (path == nullptr) {
+					break;
+				}
+				ret.push_back(path);
+			}
+		}
+	}
+	return ret;
+}
+
+} // namespace
+
+
+TEST_CASE("oxr_path")
+{
+	path_instance pi;
+
+	XrPath a = pi.get_or_create("/user/hand/left");
+	XrPath b = pi.get_or_create("/user/hand/right");
+	CHECK(a != XR_NULL_PATH);
+	CHECK(b != XR_NULL_PATH);
+	CHECK(a != b);
+	CHECK(pi.get_or_create("/user/hand/left") == a);
+
+	// Not null terminated, a prefix of an existing path.
+	XrPath prefix = XR_NULL_PATH;
+	REQUIRE(oxr_path_get_or_create(&pi.log, pi.inst, "/user/hand/leftover", 15, &prefix) == XR_SUCCESS);
+	CHECK(prefix == a);
+
+	XrPath only = a;
+	REQUIRE(oxr_path_only_get(&pi.log, pi.inst, "/user/head", 10, &only) == XR_SUCCESS);
+	CHECK(only == XR_NULL_PATH);
+
+	const char *str = nullptr;
+	size_t length = 0;
+	REQUIRE(oxr_path_get_string(&pi.log, pi.inst, b, &str, &length) == XR_SUCCESS);
+	CHECK(std::string(str, length) == "/user/hand/right");
+	CHECK(str[length] == '\0');
+	CHECK(oxr_path_get_string(&pi.log, pi.inst, 100000, &str, &length) == XR_ERROR_PATH_INVALID);
+
+	// Every binding path round trips, ids stay stable while the store grows.
+	std::vector<const char *> strs = all_binding_paths();
+	std::vector<XrPath> paths;
+	for (const char *s : strs) {
+		paths.push_back(pi.get_or_create(s));
+		REQUIRE(paths.back() != XR_NULL_PATH);
+	}
+	for (size_t i = 0; i < strs.size(); i++) {
+		REQUIRE(oxr_path_get_string(&pi.log, pi.inst, paths[i], &str, &length) == XR_SUCCESS);
+		CHECK(strcmp(str, strs[i]) == 0);
+		CHECK(pi.get_or_create(strs[i]) == paths[i]);
+	}
+	CHECK(pi.get_or_create("/user/hand/left") == a);
+}
+
+TEST_CASE("oxr_path benchmark", "[.benchmark]")
+{
+	using clock = std::chrono::steady_clock;
+
+	std::vector<const char *> strs = all_binding_paths();
+
+	// Each "instance" creates the store, the app turns all strings into
+	// paths, the runtime resolves the profile templates to the same paths,
+	// then the strings are read back like the binding code does.
+	auto instance = [&]() {
+		path_instance pi;
+		XrPath sum = 0;
+		for (const char *s : strs) {
+			sum += pi.get_or_create(s);
+		}
+		for (const char *s : strs) {
+			XrPath path = pi.get_or_create(s);
+			const char *str = nullptr;
+			size_t length = 0;
+			oxr_path_get_string(&pi.log, pi.inst, path, &str, &length);
+			sum += path + length;
+		}
+		return sum;
+	};
+
+	// Warm up.
+	XrPath sum = instance();
+
+	int iterations = 0;
+	auto start = clock::now();
+	std::chrono::duration<double> elapsed{};
+	do {
+		sum += instance();
+		iterations++;
+		elapsed = clock::now() - start;
+	} while (elapsed.count() < 1.0);
+
+	double us = elapsed.count() * 1e6 / iterations;
+	std::cout << strs.size() << " binding path strings from " << NUM_PROFILE_TEMPLATES << " profiles" << std::endl;
+	std::cout << std::fixed << std::setprecision(2) << us << " us per instance, "
+	          << us * 1000 / (strs.size() * 2) << " ns per path lookup (" << sum << ")" << std::endl;
+
+	// Lookups only, all paths already interned.
+	path_instance pi;
+	for (const char *s : strs) {
+		pi.get_or_create(s);
+	}
+
+	std::vector<size_t> lengths;
+	for (const char *s : strs) {
+		lengths.push_back(strlen(s));
+	}
+
+	uint64_t lookups = 0;
+	start = clock::now();
+	do {
+		for (size_t i = 0; i < strs.size(); i++) {
+			XrPath path;
+			oxr_path_only_get(&pi.log, pi.inst, strs[i], lengths[i], &path);
+			sum += path;
+		}
+		lookups += strs.size();
+		elapsed = clock::now() - start;
+	} while (elapsed.count() < 1.0);
+
+	std::cout << std::fixed << std::setprecision(2) << elapsed.count() * 1e9 / lookups
+	          << " ns per interned lookup (" << sum << ")" << std::endl;
+}
@@ -0,0 +1,204 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief OpenXR state tracker pose cache tests and benchmark.
+ *
+ * The benchmark is hidden, run it with `tests_oxr_pose_cache "[.benchmark]"`.
+ */
+
+#include "xrt/xrt_device.h"
+#include "util/u_time.h"
+#include "simulated/simulated_interface.h"
+
+#include "catch/catch.hpp"
+
+#include <oxr/oxr_objects.h>
+#include <oxr/oxr_logger.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+
+namespace {
+
+//! Only the timekeeping of the instance is used, the rest stays zeroed.
+struct fixture
+{
+	oxr_logger log = {};
+	oxr_instance *inst = nullptr;
+	xrt_device *xdev = nullptr;
+	oxr_pose_cache cache = {};
+
+	fixture(bool enabled = true)
+	{
+		oxr_log_init(&log, "test");
+		inst = (oxr_instance *)calloc(1, sizeof(oxr_instance));
+		inst->timekeeping = time_state_create(0);
+		xdev = simulated_hmd_create();
+		oxr_pose_cache_init(&cache, enabled);
+	}
+
+	~fixture()
+	{
+		oxr_pose_cache_fini(&cache);
+		xrt_device_destroy(&xdev);
+		time_state_destroy(&inst->timekeeping);
+		free(inst);
+	}
+
+	xrt_space_relation
+	locate(XrTime time)
+	{
+		xrt_space_relation rel = {};
+		oxr_xdev_get_space_relation_cached(&log, inst, &cache, xdev, XRT_INPUT_GENERIC_HEAD_POSE, time, &rel);
+		return rel;
+	}
+
+	xrt_space_relation
+	locate_direct(XrTime time)
+	{
+		xrt_space_relation rel = {};
+		oxr_xdev_get_space_relation(&log, inst, xdev, XRT_INPUT_GENERIC_HEAD_POSE, time, &rel);
+		return rel;
+	}
+};
+
+//! Invalidates this cache from inside the device query, like xrSyncActions on another thread.
+oxr_pose_cache *g_invalidate_cache = nullptr;
+void (*g_real_get_tracked_pose)(xrt_device *, xrt_input_name, uint64_t, xrt_space_relation *) = nullptr;
+
+void
+get_tracked_pose_and_invalidate(xrt_device *xdev, xrt_input_name name, uint64_t at_ns, xrt_space_relation *out)
+{
+	oxr_pose_cache_invalidate(g_invalidate_cache);
+	g_real_get_tracked_pose(xdev, name, at_ns, out);
+}
+
+bool
+same_relation(const xrt_space_relation &a, const xrt_space_relation &b)
+{
+	return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+} // namespace
+
+
+TEST_CASE("oxr_pose_cache")
+{
+	fixture f;
+
+	const XrTime t = 1000 * U_TIME_1MS_IN_NS;
+
+	// Miss, then hit with the same relation the device gives.
+	xrt_space_relation first = f.locate(t);
+	CHECK(same_relation(first, f.locate_direct(t)));
+	CHECK(f.cache.misses == 1);
+
+	CHECK(same_relation(f.locate(t), first));
+	CHECK(f.cache.hits == 1);
+
+	// Another time is another entry.
+	f.locate(t + U_TIME_1MS_IN_NS);
+	CHECK(f.cache.misses == 2);
+	CHECK(f.cache.entry_count == 2);
+
+	// Invalidated, next locate asks the device again.
+	oxr_pose_cache_invalidate(&f.cache);
+	CHECK(f.cache.entry_count == 0);
+	f.locate(t);
+	CHECK(f.cache.misses == 3);
+
+	// Inserted relations are returned as is.
+	xrt_space_relation inserted = XRT_SPACE_RELATION_ZERO;
+	inserted.pose.position.y = 1.5f;
+	oxr_pose_cache_insert(&f.cache, f.xdev, XRT_INPUT_GENERIC_HEAD_POSE, t, &inserted);
+	CHECK(same_relation(f.locate(t), inserted));
+
+	// Overflowing replaces old entries, it keeps working.
+	for (XrTime i = 0; i < OXR_POSE_CACHE_SIZE * 2; i++) {
+		f.locate(t + i * U_TIME_1MS_IN_NS);
+	}
+	CHECK(f.cache.entry_count == OXR_POSE_CACHE_SIZE);
+	XrTime last = t + (OXR_POSE_CACHE_SIZE * 2 - 1) * U_TIME_1MS_IN_NS;
+	uint64_t hits = f.cache.hits;
+	CHECK(same_relation(f.locate(last), f.locate_direct(last)));
+	CHECK(f.cache.hits == hits + 1);
+}
+
+TEST_CASE("oxr_pose_cache invalidated while asking the device")
+{
+	fixture f;
+
+	const XrTime t = 1000 * U_TIME_1MS_IN_NS;
+
+	g_invalidate_cache = &f.cache;
+	g_real_get_tracked_pose = f.xdev->get_tracked_pose;
+	f.xdev->get_tracked_pose = get_tracked_pose_and_invalidate;
+
+	// The relation is returned but not kept, it predates the invalidate.
+	CHECK(same_relation(f.locate(t), f.locate_direct(t)));
+	CHECK(f.cache.entry_count == 0);
+
+	f.xdev->get_tracked_pose = g_real_get_tracked_pose;
+	f.locate(t);
+	CHECK(f.cache.entry_count == 1);
+}
+
+TEST_CASE("oxr_pose_cache disabled")
+{
+	fixture f(false);
+
+	const XrTime t = 1000 * U_TIME_1MS_IN_NS;
+
+	xrt_space_relation inserted = XRT_SPACE_RELATION_ZERO;
+	oxr_pose_cache_insert(&f.cache, f.xdev, XRT_INPUT_GENERIC_HEAD_POSE, t, &inserted);
+	CHECK(f.cache.entry_count == 0);
+
+	CHECK(same_relation(f.locate(t), f.locate_direct(t)));
+	f.locate(t);
+	CHECK(f.cache.hits == 0);
+	CHECK(f.cache.misses == 0);
+}
+
+TEST_CASE("oxr_pose_cache benchmark", "[.benchmark]")
+{
+	using clock = std::chrono::steady_clock;
+
+	std::cout << std::setw(8) << "spaces" << std::setw(16) << "no cache (ns)" << std::setw(16) << "cache (ns)"
+	          << "  (per frame, simulated HMD)" << std::endl;
+
+	for (int space_count : {1, 10, 50}) {
+		double ns[2];
+
+		for (int enabled = 0; enabled < 2; enabled++) {
+			fixture f(enabled != 0);
+
+			// Each frame locates all the spaces at a new predicted time.
+			XrTime time = 1000 * U_TIME_1MS_IN_NS;
+			uint64_t frames = 0;
+			float sum = 0;
+
+			auto start = clock::now();
+			std::chrono::duration<double> elapsed{};
+			do {
+				oxr_pose_cache_invalidate(&f.cache);
+				for (int i = 0; i < space_count; i++) {
+					sum += f.locate(time).pose.orientation.w;
+				}
+				time += 11 * U_TIME_1MS_IN_NS;
+				frames++;
+				elapsed = clock::now() - start;
+			} while (elapsed.count() < 0.5);
+
+			ns[enabled] = elapsed.count() * 1e9 / frames;
+			CHECK(sum != 0);
+		}
+
+		std::cout << std::setw(8) << space_count << std::fixed << std::setprecision(1) << std::setw(16)
+		          << ns[0] << std::setw(16) << ns[1] << std::endl;
+	}
+}
@@ -0,0 +1,346 @@
+// Copyright 2022, The Board of Trustees of the University of Illinois.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief m_relation_history concurrency tests and reader contention benchmark.
+ *
+ * The benchmark is hidden, run it with `tests_relation_history_contention "[.benchmark]"`.
+ *
+ */
+
+#include <math/m_api.h>
+#include <math/m_predict.h>
+#include <math/m_relation_history.h>
+#include <math/m_vec3.h>
+#include <util/u_time.h>
+#include <util/u_template_historybuf.hpp>
+
+#include "catch/catch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+using xrt::auxiliary::util::HistoryBuffer;
+
+namespace {
+
+constexpr uint64_t T0 = 20 * (uint64_t)U_TIME_1S_IN_NS;
+
+//! Position moves 1 m per second along each axis, so interpolation and prediction of it are exact.
+xrt_space_relation
+make_relation(uint64_t ts)
+{
+	xrt_space_relation relation = XRT_SPACE_RELATION_ZERO;
+	relation.relation_flags = (xrt_space_relation_flags)( //
+	    XRT_SPACE_RELATION_POSITION_TRACKED_BIT |         //
+	    XRT_SPACE_RELATION_POSITION_VALID_BIT |           //
+	    XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT |      //
+	    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT |        //
+	    XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT);    //
+	relation.linear_velocity = {1.f, 1.f, 1.f};
+	relation.pose.position.x = (float)time_ns_to_s((time_duration_ns)(ts - T0));
+	// Redundant copies, a torn read shows up as a mismatch.
+	relation.pose.position.y = relation.pose.position.x;
+	relation.pose.position.z = relation.pose.position.x;
+	return relation;
+}
+
+/*!
+ * The mutex protected history this was before it went lock-free, kept as the
+ * baseline for the benchmark.
+ */
+struct MutexRelationHistory
+{
+	struct Entry
+	{
+		xrt_space_relation relation;
+		uint64_t timestamp;
+	};
+
+	HistoryBuffer<Entry, 4096> impl;
+	std::mutex mutex;
+
+	bool
+	push(const xrt_space_relation &relation, uint64_t ts)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!impl.empty() && ts <= impl.back().timestamp) {
+			return false;
+		}
+		impl.push_back(Entry{relation, ts});
+		return true;
+	}
+
+	m_relation_history_result
+	get(uint64_t at_ns, xrt_space_relation *out_relation)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (impl.empty()) {
+			return M_RELATION_HISTORY_RESULT_INVALID;
+		}
+		const auto b = impl.begin();
+		const auto e = impl.end();
+		const auto it = std::lower_bound(
+		    b, e, at_ns, [](const Entry &entry, uint64_t timestamp) { return entry.timestamp < timestamp; });
+		if (it == e) {
+			double delta_s = time_ns_to_s((int64_t)at_ns - (int64_t)impl.back().timestamp);
+			m_predict_relation(&impl.back().relation, delta_s, out_relation);
+			return M_RELATION_HISTORY_RESULT_PREDICTED;
+		}
+		if (it->timestamp == at_ns) {
+			*out_relation = it->relation;
+			return M_RELATION_HISTORY_RESULT_EXACT;
+		}
+		if (it == b) {
+			double delta_s = time_ns_to_s((int64_t)at_ns - (int64_t)it->timestamp);
+			m_predict_relation(&it->relation, delta_s, out_relation);
+			return M_RELATION_HISTORY_RESULT_REVERSE_PREDICTED;
+		}
+		const Entry &pre = *(it - 1);
+		const Entry &suc = *it;
+		float t = (float)(at_ns - pre.timestamp) / (float)(suc.timestamp - pre.timestamp);
+		*out_relation = pre.relation;
+		out_relation->pose.position = m_vec3_lerp(pre.relation.pose.position, suc.relation.pose.position, t);
+		math_quat_slerp(&pre.relation.pose.orientation, &suc.relation.pose.orientation, t,
+		                &out_relation->pose.orientation);
+		return M_RELATION_HISTORY_RESULT_INTERPOLATED;
+	}
+};
+
+//! The lock-free history behind the same interface as the baseline.
+struct LockFreeRelationHistory
+{
+	xrt::auxiliary::math::RelationHistory impl;
+
+	bool
+	push(const xrt_space_relation &relation, uint64_t ts)
+	{
+		return impl.push(relation, ts);
+	}
+
+	m_relation_history_result
+	get(uint64_t at_ns, xrt_space_relation *out_relation)
+	{
+		return impl.get(at_ns, out_relation);
+	}
+};
+
+struct BenchResult
+{
+	double gets_per_s;
+	double p50_ns;
+	double p99_ns;
+};
+
+/*!
+ * One writer pushing at IMU rate (1 kHz, faster than real time so the ring
+ * wraps), @p reader_count threads calling get as fast as they can for recent
+ * timestamps, like the compositor, IPC and app threads do.
+ */
+template <typename History>
+BenchResult
+run_contention(int reader_count, std::chrono::milliseconds duration)
+{
+	using clock = std::chrono::steady_clock;
+
+	History history;
+	std::atomic<uint64_t> latest_ts{0};
+	std::atomic<bool> running{true};
+
+	// Prefill so readers always have data.
+	uint64_t ts = T0;
+	for (int i = 0; i < 4096; i++) {
+		history.push(make_relation(ts), ts);
+		ts += U_TIME_1MS_IN_NS;
+	}
+	latest_ts = ts - U_TIME_1MS_IN_NS;
+
+	std::thread writer([&] {
+		uint64_t wts = latest_ts + U_TIME_1MS_IN_NS;
+		while (running) {
+			history.push(make_relation(wts), wts);
+			latest_ts.store(wts, std::memory_order_relaxed);
+			wts += U_TIME_1MS_IN_NS;
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	});
+
+	std::vector<std::vector<uint32_t>> latencies(reader_count);
+	std::vector<uint64_t> counts(reader_count);
+	std::vector<std::thread> readers;
+	for (int r = 0; r < reader_count; r++) {
+		readers.emplace_back([&, r] {
+			std::mt19937 rng(r);
+			std::uniform_int_distribution<int64_t> offset(-20 * (int64_t)U_TIME_1MS_IN_NS,
+			                                              20 * (int64_t)U_TIME_1MS_IN_NS);
+			auto &lat = latencies[r];
+			lat.reserve(1 << 20);
+			uint64_t n = 0;
+			while (running) {
+				uint64_t at = latest_ts.load(std::memory_order_relaxed) + offset(rng);
+				xrt_space_relation out;
+				auto start = clock::now();
+				history.get(at, &out);
+				auto end = clock::now();
+				// Sample latencies to keep the memory bounded.
+				if ((n & 7) == 0 && lat.size() < lat.capacity()) {
+					lat.push_back((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+					                  .count());
+				}
+				n++;
+			}
+			counts[r] = n;
+		});
+	}
+
+	std::this_thread::sleep_for(duration);
+	running = false;
+	writer.join();
+	for (auto &t : readers) {
+		t.join();
+	}
+
+	std::vector<uint32_t> all;
+	uint64_t total = 0;
+	for (int r = 0; r < reader_count; r++) {
+		all.insert(all.end(), latencies[r].begin(), latencies[r].end());
+		total += counts[r];
+	}
+	std::sort(all.begin(), all.end());
+
+	BenchResult res;
+	res.gets_per_s = (double)total / std::chrono::duration<double>(duration).count();
+	res.p50_ns = all.empty() ? 0 : all[all.size() / 2];
+	res.p99_ns = all.empty() ? 0 : all[all.size() * 99 / 100];
+	return res;
+}
+
+} // namespace
+
+
+TEST_CASE("m_relation_history wraparound")
+{
+	xrt::auxiliary::math::RelationHistory rh;
+
+	uint64_t ts = T0;
+	for (int i = 0; i < 10000; i++) {
+		CHECK(rh.push(make_relation(ts), ts));
+		ts += U_TIME_1MS_IN_NS;
+	}
+	const uint64_t last = ts - U_TIME_1MS_IN_NS;
+
+	// The slot about to be overwritten is never handed out.
+	CHECK(rh.size() == 4095);
+
+	xrt_space_relation out;
+	uint64_t out_time;
+	CHECK(rh.get_latest(&out_time, &out));
+	CHECK(out_time == last);
+
+	CHECK(rh.get(last - 100 * U_TIME_1MS_IN_NS, &out) == M_RELATION_HISTORY_RESULT_EXACT);
+	CHECK(out.pose.position.x == Approx(make_relation(last - 100 * U_TIME_1MS_IN_NS).pose.position.x));
+
+	// Oldest readable entry is exact, one before it got dropped.
+	const uint64_t oldest = last - 4094 * (uint64_t)U_TIME_1MS_IN_NS;
+	CHECK(rh.get(oldest, &out) == M_RELATION_HISTORY_RESULT_EXACT);
+	CHECK(rh.get(oldest - U_TIME_1MS_IN_NS, &out) == M_RELATION_HISTORY_RESULT_REVERSE_PREDICTED);
+
+	rh.clear();
+	CHECK(rh.size() == 0);
+	CHECK(rh.get(last, &out) == M_RELATION_HISTORY_RESULT_INVALID);
+	CHECK_FALSE(rh.get_latest(&out_time, &out));
+
+	// Timestamps before the clear are fine again.
+	CHECK(rh.push(make_relation(T0), T0));
+	CHECK(rh.size() == 1);
+}
+
+TEST_CASE("m_relation_history concurrent readers")
+{
+	xrt::auxiliary::math::RelationHistory rh;
+	std::atomic<uint64_t> latest_ts{0};
+	std::atomic<bool> running{true};
+	std::atomic<uint64_t> bad{0};
+	std::atomic<uint64_t> reads{0};
+
+	// The writer pushes without sleeping so the ring wraps many times while
+	// readers are working on the oldest entries.
+	std::thread writer([&] {
+		uint64_t ts = T0;
+		for (int i = 0; i < 200000; i++) {
+			rh.push(make_relation(ts), ts);
+			latest_ts.store(ts, std::memory_order_release);
+			ts += U_TIME_1MS_IN_NS;
+		}
+		running = false;
+	});
+
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 4; r++) {
+		readers.emplace_back([&, r] {
+			std::mt19937 rng(r);
+			while (running) {
+				uint64_t latest = latest_ts.load(std::memory_order_acquire);
+				if (latest == 0) {
+					continue;
+				}
+				// Mostly the tail of the ring, where the writer overwrites.
+				std::uniform_int_distribution<uint64_t> back(0, 4200 * (uint64_t)U_TIME_1MS_IN_NS);
+				uint64_t at = latest - std::min(latest - T0, back(rng));
+
+				xrt_space_relation out;
+				auto res = rh.get(at, &out);
+				reads++;
+
+				const xrt_vec3 &p = out.pose.position;
+				if (p.x != p.y || p.x != p.z) {
+					bad++;
+					continue;
+				}
+				// Position is linear in time, so every result must land on the line.
+				float expected = make_relation(at).pose.position.x;
+				if (res == M_RELATION_HISTORY_RESULT_INVALID || std::abs(p.x - expected) > 1e-3f) {
+					bad++;
+				}
+			}
+		});
+	}
+
+	writer.join();
+	for (auto &t : readers) {
+		t.join();
+	}
+
+	CHECK(reads > 0);
+	CHECK(bad == 0);
+}
+
+TEST_CASE("m_relation_history contention benchmark", "[.benchmark]")
+{
+	constexpr auto duration = std::chrono::milliseconds(500);
+
+	std::cout << std::setw(8) << "readers" << std::setw(16) << "mutex get/s" << std::setw(12) << "mutex p99"
+	          << std::setw(16) << "lockfree get/s" << std::setw(12) << "lf p99" << std::setw(10) << "speedup"
+	          << std::endl;
+
+	for (int readers : {1, 2, 4, 8, 16}) {
+		BenchResult m = run_contention<MutexRelationHistory>(readers, duration);
+		BenchResult lf = run_contention<LockFreeRelationHistory>(readers, duration);
+
+		std::cout << std::setw(8) << readers << std::setw(16) << std::fixed << std::setprecision(0)
+		          << m.gets_per_s << std::setw(10) << m.p99_ns << "ns" << std::setw(16) << lf.gets_per_s
+		          << std::setw(10) << lf.p99_ns << "ns" << std::setw(9) << std::setprecision(2)
+		          << lf.gets_per_s / m.gets_per_s << "x" << std::endl;
+
+		CHECK(lf.gets_per_s > 0);
+	}
+}
@@ -0,0 +1,125 @@
+// Copyright 2022, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Format converter sink tests.
+ */
+
+#include "util/u_sink.h"
+#include "util/u_frame.h"
+#include "util/u_frame_pool.h"
+#include "util/u_worker.h"
+
+#include "catch/catch.hpp"
+
+#include <random>
+#include <vector>
+
+
+namespace {
+
+/*!
+ * Keeps a copy of the last frame pushed to it.
+ */
+struct CaptureSink
+{
+	xrt_frame_sink base = {};
+	std::vector<uint8_t> data;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint64_t timestamp = 0;
+	int count = 0;
+
+	CaptureSink()
+	{
+		base.push_frame = push;
+	}
+
+	static void
+	push(xrt_frame_sink *xfs, xrt_frame *xf)
+	{
+		CaptureSink *cs = reinterpret_cast<CaptureSink *>(xfs);
+		cs->count++;
+		cs->width = xf->width;
+		cs->height = xf->height;
+		cs->timestamp = xf->timestamp;
+		cs->data.clear();
+		for (uint32_t y = 0; y < xf->height; y++) {
+			const uint8_t *row = xf->data + y * xf->stride;
+			cs->data.insert(cs->data.end(), row, row + xf->width * 3);
+		}
+	}
+};
+
+xrt_frame *
+make_yuyv_frame(uint32_t w, uint32_t h, std::mt19937 &rng)
+{
+	xrt_frame *xf = nullptr;
+	u_frame_create_one_off(XRT_FORMAT_YUYV422, w, h, &xf);
+	REQUIRE(xf != nullptr);
+
+	std::uniform_int_distribution<int> byte(0, 255);
+	for (size_t i = 0; i < xf->size; i++) {
+		xf->data[i] = (uint8_t)byte(rng);
+	}
+	xf->timestamp = 1234;
+
+	return xf;
+}
+
+} // namespace
+
+
+TEST_CASE("u_sink_converter threaded")
+{
+	std::mt19937 rng(42);
+	u_worker_thread_pool *uwtp = u_worker_thread_pool_create(3, 4);
+	REQUIRE(uwtp != nullptr);
+
+	// Includes a height that doesn't split evenly and one too small to split.
+	const uint32_t heights[] = {480, 333, 8};
+
+	for (uint32_t h : heights) {
+		INFO("height " << h);
+
+		xrt_frame_context xfctx = {};
+		CaptureSink serial_sink;
+		CaptureSink threaded_sink;
+		xrt_frame_sink *serial = nullptr;
+		xrt_frame_sink *threaded = nullptr;
+
+		u_frame_pool_create_for_context(&xfctx);
+		u_sink_create_format_converter(&xfctx, XRT_FORMAT_R8G8B8, &serial_sink.base, &serial);
+		u_sink_create_format_converter_threaded(&xfctx, XRT_FORMAT_R8G8B8, uwtp, &threaded_sink.base,
+		                                        &threaded);
+		REQUIRE(serial != nullptr);
+		REQUIRE(threaded != nullptr);
+
+		for (int i = 0; i < 3; i++) {
+			xrt_frame *xf = make_yuyv_frame(640, h, rng);
+			xrt_sink_push_frame(serial, xf);
+			xrt_sink_push_frame(threaded, xf);
+			xrt_frame_reference(&xf, nullptr);
+
+			CHECK(threaded_sink.count == i + 1);
+			CHECK(threaded_sink.width == 640);
+			CHECK(threaded_sink.height == h);
+			CHECK(threaded_sink.timestamp == 1234);
+
+			// Don't let Catch print out the whole frames.
+			bool equal = serial_sink.data == threaded_sink.data;
+			CHECK(equal);
+		}
+
+		// Both converters share the pool of the context, only the first frame allocates.
+		u_frame_pool_stats stats = {};
+		u_frame_pool_get_stats(u_frame_pool_get_for_context(&xfctx), &stats);
+		CHECK(stats.misses == 1);
+		CHECK(stats.hits == 5);
+		CHECK(stats.outstanding_frames == 0);
+
+		xrt_frame_context_destroy_nodes(&xfctx);
+	}
+
+	u_worker_thread_pool_reference(&uwtp, nullptr);
+}
@@ -4,14 +4,20 @@
  * @file
  * @brief Thread pool tests.
  * @author Ryan Pavlik <ryan.pavlik@collabora.com>
+ *
+ * The benchmark is hidden, run it with `tests_worker "[.benchmark]"`.
  */
 
 #include <util/u_worker.hpp>
 
 #include "catch/catch.hpp"
 
-#include <thread>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
 
 using namespace std::chrono_literals;
 
@@ -130,3 +136,293 @@ TEST_CASE("TaskCollection")
 		CHECK(calledA[2]);
 	}
 }
+
+TEST_CASE("TaskCollection with many tasks")
+{
+	SharedThreadPool pool{1, 2};
+	SharedThreadGroup group{pool};
+
+	// Well past the old fixed limits of 16 functors and 64 tasks.
+	constexpr int kCount = 1000;
+	std::atomic<int> counter{0};
+	std::vector<TaskCollection::Functor> funcs(kCount, [&] { counter++; });
+
+	{
+		TaskCollection collection{group, funcs};
+	}
+
+	CHECK(counter == kCount);
+}
+
+TEST_CASE("u_worker_group")
+{
+	std::atomic<int> counter{0};
+	auto increment = [](void *ptr) { (*static_cast<std::atomic<int> *>(ptr))++; };
+
+	SECTION("Unbounded submission")
+	{
+		u_worker_thread_pool *pool = u_worker_thread_pool_create(1, 2);
+		u_worker_group *group = u_worker_group_create(pool);
+
+		constexpr int kCount = 10000;
+		for (int i = 0; i < kCount; i++) {
+			u_worker_group_push(group, increment, &counter);
+		}
+		u_worker_group_wait_all(group);
+		CHECK(counter == kCount);
+
+		u_worker_group_reference(&group, nullptr);
+		u_worker_thread_pool_reference(&pool, nullptr);
+	}
+
+	SECTION("Waiting without workers runs the tasks")
+	{
+		// Worker limit of zero, only the waiting thread can do the work.
+		u_worker_thread_pool *pool = u_worker_thread_pool_create(0, 1);
+		u_worker_group *group = u_worker_group_create(pool);
+
+		for (int i = 0; i < 100; i++) {
+			u_worker_group_push(group, increment, &counter);
+		}
+		u_worker_group_wait_all(group);
+		CHECK(counter == 100);
+
+		u_worker_group_reference(&group, nullptr);
+		u_worker_thread_pool_reference(&pool, nullptr);
+	}
+
+	SECTION("Waiting only runs the waited group's tasks")
+	{
+		u_worker_thread_pool *pool = u_worker_thread_pool_create(1, 2);
+		u_worker_group *group_a = u_worker_group_create(pool);
+		u_worker_group *group_b = u_worker_group_create(pool);
+
+		struct State
+		{
+			std::atomic<bool> blocking{false};
+			std::atomic<bool> release{false};
+			std::atomic<bool> b_done{false};
+		} state;
+
+		// Keeps the only worker busy.
+		u_worker_group_push(
+		    group_b,
+		    [](void *ptr) {
+			    State *s = static_cast<State *>(ptr);
+			    s->blocking = true;
+			    while (!s->release) {
+				    std::this_thread::sleep_for(1ms);
+			    }
+		    },
+		    &state);
+		while (!state.blocking) {
+			std::this_thread::sleep_for(1ms);
+		}
+
+		// Queued ahead of the task of the waited group.
+		u_worker_group_push(
+		    group_b,
+		    [](void *ptr) {
+			    State *s = static_cast<State *>(ptr);
+			    s->b_done = true;
+		    },
+		    &state);
+		u_worker_group_push(group_a, increment, &counter);
+
+		u_worker_group_wait_all(group_a);
+		CHECK(counter == 1);
+		CHECK_FALSE(state.b_done);
+
+		state.release = true;
+		u_worker_group_wait_all(group_b);
+		CHECK(state.b_done);
+
+		u_worker_group_reference(&group_a, nullptr);
+		u_worker_group_reference(&group_b, nullptr);
+		u_worker_thread_pool_reference(&pool, nullptr);
+	}
+
+	SECTION("Nested wait")
+	{
+		// Every worker ends up waiting on tasks it pushed, which only
+		// finishes if the waiting threads help out.
+		SharedThreadPool pool{1, 2};
+		SharedThreadGroup outer{pool};
+
+		constexpr int kOuter = 32;
+		constexpr int kInner = 16;
+		std::vector<TaskCollection::Functor> funcs(kOuter, [&] {
+			SharedThreadGroup inner{pool};
+			std::vector<TaskCollection::Functor> inner_funcs(kInner, [&] { counter++; });
+			TaskCollection collection{inner, inner_funcs};
+		});
+
+		{
+			TaskCollection collection{outer, funcs};
+		}
+
+		CHECK(counter == kOuter * kInner);
+	}
+}
+
+TEST_CASE("u_worker_group two stages overlap")
+{
+	// Like mercury pipelined: the kinematics of the last frame go to their own
+	// group, then the tracking thread runs the models of this frame and waits.
+	u_worker_thread_pool *pool = u_worker_thread_pool_create(3, 4);
+	u_worker_group *models = u_worker_group_create(pool);
+	u_worker_group *kinematics = u_worker_group_create(pool);
+
+	using clock = std::chrono::steady_clock;
+	struct Stage
+	{
+		std::atomic<bool> done{false};
+		std::thread::id thread;
+		clock::time_point start;
+		clock::time_point end;
+	} kine;
+
+	u_worker_group_push(
+	    kinematics,
+	    [](void *ptr) {
+		    Stage *s = static_cast<Stage *>(ptr);
+		    s->thread = std::this_thread::get_id();
+		    s->start = clock::now();
+		    std::this_thread::sleep_for(100ms);
+		    s->end = clock::now();
+		    s->done = true;
+	    },
+	    &kine);
+
+	for (int i = 0; i < 4; i++) {
+		u_worker_group_push(
+		    models, [](void *) { std::this_thread::sleep_for(20ms); }, nullptr);
+	}
+	u_worker_group_wait_all(models);
+	clock::time_point models_end = clock::now();
+
+	// The tracking thread only waited on the models.
+	CHECK_FALSE(kine.done);
+
+	while (!kine.done) {
+		std::this_thread::sleep_for(1ms);
+	}
+	CHECK(kine.thread != std::this_thread::get_id());
+	CHECK(kine.start < models_end);
+	CHECK(kine.end > models_end);
+
+	u_worker_group_reference(&models, nullptr);
+	u_worker_group_reference(&kinematics, nullptr);
+	u_worker_thread_pool_reference(&pool, nullptr);
+}
+
+TEST_CASE("u_worker_group for bands")
+{
+	struct Bands
+	{
+		std::atomic<int> calls{0};
+		std::atomic<int> hits[1000] = {};
+	} bands;
+
+	auto func = [](void *ptr, uint32_t start, uint32_t end) {
+		Bands *b = static_cast<Bands *>(ptr);
+		b->calls++;
+		for (uint32_t i = start; i < end; i++) {
+			b->hits[i]++;
+		}
+	};
+
+	auto each_hit_once = [&](uint32_t count) {
+		for (uint32_t i = 0; i < count; i++) {
+			if (bands.hits[i] != 1) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	u_worker_thread_pool *pool = u_worker_thread_pool_create(2, 3);
+	u_worker_group *group = u_worker_group_create(pool);
+
+	SECTION("Split over the group")
+	{
+		u_worker_group_for_bands(group, 1000, 7, 16, func, &bands);
+		CHECK(bands.calls == 7);
+		CHECK(each_hit_once(1000));
+	}
+
+	SECTION("Capped by the minimum band size")
+	{
+		u_worker_group_for_bands(group, 40, 8, 16, func, &bands);
+		CHECK(bands.calls == 2);
+		CHECK(each_hit_once(40));
+	}
+
+	SECTION("Capped by the maximum band count")
+	{
+		u_worker_group_for_bands(group, 1000, 1000, 1, func, &bands);
+		CHECK(bands.calls == U_WORKER_MAX_BANDS);
+		CHECK(each_hit_once(1000));
+	}
+
+	SECTION("No group runs it in one go")
+	{
+		u_worker_group_for_bands(nullptr, 1000, 8, 16, func, &bands);
+		CHECK(bands.calls == 1);
+		CHECK(each_hit_once(1000));
+	}
+
+	u_worker_group_reference(&group, nullptr);
+	u_worker_thread_pool_reference(&pool, nullptr);
+}
+
+TEST_CASE("u_worker benchmark", "[.benchmark]")
+{
+	using clock = std::chrono::steady_clock;
+
+	uint32_t hw = std::max(2u, std::thread::hardware_concurrency());
+	u_worker_thread_pool *pool = u_worker_thread_pool_create(hw - 1, hw);
+	u_worker_group *group = u_worker_group_create(pool);
+
+	std::atomic<uint64_t> sink{0};
+	auto tiny = [](void *ptr) {
+		// A few hundred nanoseconds of work.
+		uint64_t v = 0;
+		for (int i = 0; i < 64; i++) {
+			v = v * 6364136223846793005ull + 1442695040888963407ull;
+		}
+		(*static_cast<std::atomic<uint64_t> *>(ptr)) += v;
+	};
+
+	// Throughput: many tiny tasks pushed from outside the pool.
+	std::cout << std::setw(10) << "tasks" << std::setw(16) << "tasks/s" << std::endl;
+	for (int count : {1000, 10000, 100000}) {
+		auto start = clock::now();
+		for (int i = 0; i < count; i++) {
+			u_worker_group_push(group, tiny, &sink);
+		}
+		u_worker_group_wait_all(group);
+		std::chrono::duration<double> elapsed = clock::now() - start;
+
+		std::cout << std::setw(10) << count << std::setw(16) << std::fixed << std::setprecision(0)
+		          << count / elapsed.count() << std::endl;
+	}
+
+	// Latency: push one task and wait for it, what a frame loop sees.
+	constexpr int kRounds = 10000;
+	std::vector<double> latencies_us;
+	latencies_us.reserve(kRounds);
+	for (int i = 0; i < kRounds; i++) {
+		auto start = clock::now();
+		u_worker_group_push(group, tiny, &sink);
+		u_worker_group_wait_all(group);
+		std::chrono::duration<double, std::micro> elapsed = clock::now() - start;
+		latencies_us.push_back(elapsed.count());
+	}
+	std::sort(latencies_us.begin(), latencies_us.end());
+	std::cout << std::setprecision(2) << "push+wait latency us: p50 " << latencies_us[kRounds / 2] << " p99 "
+	          << latencies_us[kRounds * 99 / 100] << " max " << latencies_us.back() << std::endl;
+
+	u_worker_group_reference(&group, nullptr);
+	u_worker_thread_pool_reference(&pool, nullptr);
+}